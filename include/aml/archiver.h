@@ -64,6 +64,7 @@
 /* Relative to ARCHIVER_DIR/filesystem/ */
 #define	ARCHREQ_DIR "ArchReq"	/* Archive requests directory */
 #define	ARFIND_STATE "state"	/* arfind state file */
+#define	DIRSTATE "Dirstate"	/* Directory state file name */
 #define	EXAMLIST "Examlist"	/* Examine inode list file name */
 #define	FILE_PROPS "FileProps"	/* arfind file properties files */
 #define	SCANLIST "Scanlist"	/* Scanlist file name */
@@ -38,9 +38,11 @@
 
 #pragma	ident	"$Revision: 1.47 $"
 
+#include "sam/iotune.h"
+
 /* Macros. */
 #define	ARCHREQ_MAGIC 0122031022	/* ArchReq file magic number */
-#define	ARCHREQ_VERSION 70216		/* ArchReq file version (YMMDD) */
+#define	ARCHREQ_VERSION 261019	/* ArchReq file version (YYMMDD) */
 
 #define	ARCHREQ_MAX_SIZE 100000000	/* Growth limit - bytes */
 
@@ -131,6 +133,8 @@ struct ArchReq {
 		vsn_t	CiVsn;		/* VSN of volume being written */
 		fsize_t CiVolSpace;	/* Space available on volume */
 		DiskVolumeSeqnum_t CiSeqNum; /* Arcopy's sequence number */
+		struct IoTune CiTune;	/* Archive buffer, blocks of */
+					/* WriteCount bytes */
 	} ArCpi[1];			/* Arcopy instance ([n] = ArDrives) */
 
 	/* Dynamic array of FileInfo entries */
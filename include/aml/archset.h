@@ -38,7 +38,7 @@
 
 /* Macros. */
 #define	ARCHSETS_MAGIC 01222230524	/* Archive sets file magic number */
-#define	ARCHSETS_VERSION 80410		/* Archive sets file version (YMMDD) */
+#define	ARCHSETS_VERSION 261020	/* Archive sets file version (YYMMDD) */
 
 #define	ALL_SETS "allsets"		/* Name of defaults archive set */
 #define	NO_ARCHIVE "no_archive"		/* Name of "no_archive" archive set */
@@ -137,6 +137,7 @@ struct ArchSet {
 	enum SortMethods
 			AsSort;		/* File sort method for archive file */
 	short		AsDrives;	/* Maximum number of drives to use */
+	short		AsStreams;	/* Tar file streams per disk volume */
 	short		AsRearchStageCopy; /* Copy to stage from when */
 						/* rearchiving */
 	short		AsReserve;	/* VSN reserve methods */
@@ -219,6 +220,7 @@ struct ArchSet {
 #define	AS_tapenonstop	0x00200000	/* -tapenonstop */
 #define	AS_unarchage	0x00400000	/* -unarchage */
 #define	AS_honeycomb	0x00800000	/* Honeycomb archive */
+#define	AS_streams	0x01000000	/* -streams */
 
 #define	AS_rmonly (AS_fillvsns | AS_ovflmin | AS_reserve | AS_tapenonstop)
 #define	AS_diskArchSet	(AS_disk_archive | AS_honeycomb)
@@ -274,6 +276,8 @@ struct ArchSet {
 struct ArchSet *FindArchSet(char *name);
 struct ArchSet *ArchSetAttach(int mode);
 fsize_t GetArchmax(struct ArchSet *as, char *mtype);
+int GetArchDrives(struct ArchSet *as);
+int GetArchStreams(struct ArchSet *as);
 struct MediaParamsEntry *MediaParamsGetEntry(mtype_t mtype);
 
 #if defined(ARCHIVER_PRIVATE)
@@ -344,6 +348,8 @@ struct MediaParams {
 		fsize_t	MpOvflmin;	/* Min size file for volume overflow */
 		int	MpBufsize;	/* Size of archive buffer * device */
 					/* blksize */
+		int	MpBufsizeMax;	/* Maximum MpBufsize, sam-arcopy */
+					/* adjusts the buffer between them */
 		int	MpTimeout;	/* Timeout for writing file being */
 					/* archived */
 	} MpEntry[1];			/* First entry of 'MpCount' entries */
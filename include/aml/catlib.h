@@ -175,11 +175,46 @@ int _CatalogSlotInit(const char *SrcFile, const int SrcLine,
 	struct VolId *vid, uint32_t CatStatus, int NumofParts, char *BarCode,
 	char *AltBarCode);
 
+/*
+ * One slot for CatalogSlotInitList().
+ */
+struct CatalogSlotUpdate {
+	struct VolId CsVid;
+	uint32_t CsCatStatus;		/* Status bits to set */
+	int	CsTwoSided;		/* Two sided media in library */
+	char	CsBarCode[BARCODE_LEN + 1];
+	char	CsAltBarCode[BARCODE_LEN + 1];
+	int	CsStatus;		/* Returned status */
+	int	CsErrno;		/* Returned errno if CsStatus != 0 */
+};
+
+#define	CatalogSlotInitList(a, b) _CatalogSlotInitList( \
+	_SrcFile, __LINE__, (a), (b))
+int _CatalogSlotInitList(const char *SrcFile, const int SrcLine,
+	struct CatalogSlotUpdate *csu, int count);
+
 #define	CatalogSetField(a, b, c, d) _CatalogSetField( \
 	_SrcFile, __LINE__, (a), (b), (c), (d))
 int _CatalogSetField(const char *SrcFile, const int SrcLine,
 	struct VolId *vid, enum CeFields field, uint64_t value, uint32_t mask);
 
+/*
+ * One field update for CatalogSetFieldList().
+ */
+struct CatalogFieldUpdate {
+	struct VolId CfVid;
+	enum CeFields CfField;
+	uint64_t CfValue;
+	uint32_t CfMask;
+	int	CfStatus;		/* Returned status */
+	int	CfErrno;		/* Returned errno if CfStatus != 0 */
+};
+
+#define	CatalogSetFieldList(a, b) _CatalogSetFieldList( \
+	_SrcFile, __LINE__, (a), (b))
+int _CatalogSetFieldList(const char *SrcFile, const int SrcLine,
+	struct CatalogFieldUpdate *cfu, int count);
+
 #define	CatalogSetFieldByLoc(a, b, c, d, e, f) _CatalogSetFieldByLoc(_SrcFile, \
 	__LINE__, (a), (b), (c), (d), (e), (f))
 int _CatalogSetFieldByLoc(const char *SrcFile, const int SrcLine,
@@ -124,7 +124,8 @@ enum DV_numof {
 /* Definitions of open flags. */
 enum {
 	DISKVOLS_CREATE		= 1 << 0,	/* Create db */
-	DISKVOLS_RDONLY		= 1 << 1	/* Read only */
+	DISKVOLS_RDONLY		= 1 << 1,	/* Read only */
+	DISKVOLS_CACHE		= 1 << 2	/* Cache volume records */
 };
 
 typedef struct DiskVolumeInfo DiskVolumeInfo_t;
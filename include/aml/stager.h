@@ -121,6 +121,13 @@ struct StagerControlRsp {
  */
 #define	STAGER_DEFAULT_DIRECTIO_MIN	8
 
+/*
+ * Default number of readers recalling files from a disk archive
+ * volume, and from all disk archive volumes on a host.
+ */
+#define	STAGER_DEFAULT_DK_READERS	8
+#define	STAGER_DEFAULT_DK_HOST_READERS	64
+
 /*
  * Maximum path length.
  */
@@ -201,6 +208,8 @@ typedef struct sam_stager_config {
 	int			dio_min_size;	/* min directio stage size */
 	int			num_streams;	/* number of stream params */
 	sam_stager_streams_t	*streams;	/* stream parameters */
+	int			dk_readers;	/* readers per disk volume */
+	int			dk_host_readers; /* readers per host */
 } sam_stager_config_t;
 
 #define	STAGER_DISPLAY_ACTIVE	20	/* number of active stages to display */
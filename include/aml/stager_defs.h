@@ -163,7 +163,8 @@ enum {
 	SR_CLEAR =		1 << 6,		/* clearing stage requests */
 	SR_UNAVAIL =		1 << 7,		/* media unavailable */
 	SR_DCACHE_CLOSE	=	1 << 8,		/* close file descriptor */
-	SR_full	=		1 << 9		/* met full stream params */
+	SR_full	=		1 << 9,		/* met full stream params */
+	SR_ORDERED =		1 << 10		/* files in recall order */
 };
 
 /*
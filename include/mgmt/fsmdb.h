@@ -728,9 +728,61 @@ db_list_files(
 	uint32_t	which_details,	/* file properties to return */
 	restrict_t	restrictions,	/* filtering options */
 	boolean_t	includeStart,	/* include startFile in return */
-	uint32_t	*morefiles,	/* out - does dir have more files */
+	uint32_t	*morefiles,	/* out - non-zero if dir has more */
 	sqm_lst_t	**results);	/* out - list of strings */
 
+/*
+ *  Browse cursor.  Holds the position reached by a paged directory
+ *  listing so the next page continues from it without looking up
+ *  the snapshot and directory again.  A request continuing a listing
+ *  finds its cursor by the last file name returned.  Unused cursors
+ *  expire after BROWSE_TTL seconds.
+ *
+ *  Cursors are only kept for snapshots marked SNAPFLAG_READY.  Deleting
+ *  a snapshot clears the flag, then purges its cursors.  The purge
+ *  advances the browse generation, and a cursor is not kept if the
+ *  generation changed after its listing found the snapshot ready.
+ */
+#define	BROWSE_TTL	300
+#define	BROWSE_MAX	64		/* cursors kept */
+
+typedef struct browse_cursor_s {
+	char			fsname[MAXPATHLEN + 1];
+	char			snapname[MAXPATHLEN + 1];
+	char			startDir[MAXPATHLEN + 1];
+	char			lastFile[MAXPATHLEN + 1];
+	restrict_t		restrictions;
+	uint32_t		snapid;
+	uint32_t		snapdate;
+	uint64_t		dirid;
+	uint32_t		gen;		/* browse generation */
+	time_t			expires;
+	struct browse_cursor_s	*next;
+} browse_cursor_t;
+
+/*
+ *  Removes and returns the cursor continuing a listing after lastFile,
+ *  NULL if there is none.  The caller owns the returned cursor.
+ */
+browse_cursor_t *
+get_browse_cursor(char *fsname, char *snapname, char *startDir,
+	char *lastFile, restrict_t *restrictions);
+
+/*
+ *  Keeps a cursor for the next page, unless cursors were purged since
+ *  bc->gen was read.  Takes ownership of the cursor.
+ */
+void
+put_browse_cursor(browse_cursor_t *bc);
+
+/* Returns the browse generation, read before checking the snapshot */
+uint32_t
+browse_generation(void);
+
+/* Discards the cursors for a snapshot, or all if snapid is NULL */
+void
+purge_browse_cursors(char *fsname, uint32_t *snapid);
+
 /* returns the file ID and parent ID associated with the specified path */
 int
 get_file_path_id(fs_db_t *fsdb, DB_TXN *txn, char *path, uint64_t *fid,
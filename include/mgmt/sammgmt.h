@@ -546,7 +546,8 @@ typedef enum samstruct_type {
 	SAM_STK_PHYCONF_INFO,
 	SAM_STK_INFO_LIST,
 	SAM_FILE_DETAILS,
-	SAM_PUBLIC_KEY
+	SAM_PUBLIC_KEY,
+	SAM_LIST_CHUNK
 } samstruct_type_t;
 
 typedef struct result_struct {
@@ -1397,6 +1398,29 @@ typedef struct handle_request_arg {
 	op_req_t *req;
 } handle_request_arg_t;
 
+
+/*
+ * list streams
+ *
+ * A list returning procedure called as SAMRPC_STREAMED(proc) returns
+ * the first chunk of its list in a list_chunk_t. If the list did not
+ * fit, the server holds the rest and the client pulls it with
+ * samrpc_list_stream_next. A stream of 0 means no more chunks.
+ */
+typedef struct list_chunk {
+	int		stream;		/* stream id, 0 if list complete */
+	int		total;		/* entries in the whole list */
+	int		remaining;	/* entries after this chunk */
+	result_struct_t	list;		/* entries in this chunk */
+} list_chunk_t;
+
+typedef struct list_stream_arg {
+	ctx_t		*ctx;
+	int		stream;
+	int		max_entries;	/* 0 for the server default */
+	uint32_t	max_bytes;	/* 0 for the server default */
+} list_stream_arg_t;
+
 /*
  * *****************************
  *  the RPC function prototypes
@@ -2378,6 +2402,20 @@ extern  samrpc_result_t *samrpc_get_specific_tasks_6_svr();
 #define	samrpc_handle_request		1414
 extern	samrpc_result_t *samrpc_handle_request_5_0_svr();
 
+/* list streams */
+#define	SAMRPC_STREAM_FLAG	0x10000
+#define	SAMRPC_STREAMED(proc)	((proc) | SAMRPC_STREAM_FLAG)
+#define	SAMRPC_PROC(proc)	((proc) & ~SAMRPC_STREAM_FLAG)
+
+#define	samrpc_list_stream_next		1420
+extern	samrpc_result_t *samrpc_list_stream_next_6_svr();
+
+#define	samrpc_list_stream_close	1421
+extern	samrpc_result_t *samrpc_list_stream_close_6_svr();
+
+extern	boolean_t samrpc_list_stream_open();
+extern	void samrpc_list_stream_sent();
+
 
 /*
  * *******************
@@ -2808,6 +2846,10 @@ extern bool_t xdr_file_metric_rpt_arg_t();
 extern bool_t xdr_handle_request_arg_t();
 extern bool_t xdr_op_req_t();
 
+/* list streams */
+extern bool_t xdr_list_chunk_t();
+extern bool_t xdr_list_stream_arg_t();
+
 
 /* definition of macros for easier readability */
 
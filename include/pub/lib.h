@@ -48,6 +48,18 @@
 extern "C" {
 #endif
 
+/*
+ * Entry of the file lists taken by sam_archive_list(), sam_release_list(),
+ * sam_stage_list(), sam_ssum_list() and sam_cancelstage_list().  A file
+ * is named by path or, if path is NULL, by inode and generation number.
+ */
+typedef struct sam_fileop {
+	const char	*path;		/* Path name, NULL to use ino, gen */
+	uint_t		ino;		/* I-number */
+	int		gen;		/* Generation number */
+	int		error;		/* Returned - errno, 0 if done */
+} sam_fileop_t;
+
 int sam_archive(const char *name, const char *opns);
 int sam_unarchive(const char *name, int num_opts, ...);
 int sam_rearch(const char *name, int num_opts, ...);
@@ -64,6 +76,15 @@ int sam_stage(const char *name, const char *opns);
 int sam_setfa(const char *name, const char *opns);
 int sam_segment(const char *name, const char *opns);
 int sam_advise(const int fildes, const char *opns);
+int sam_archive_list(const char *fs, sam_fileop_t *list, int count,
+	const char *opns);
+int sam_cancelstage_list(const char *fs, sam_fileop_t *list, int count);
+int sam_release_list(const char *fs, sam_fileop_t *list, int count,
+	const char *opns);
+int sam_ssum_list(const char *fs, sam_fileop_t *list, int count,
+	const char *opns);
+int sam_stage_list(const char *fs, sam_fileop_t *list, int count,
+	const char *opns);
 
 #ifdef  __cplusplus
 }
@@ -46,12 +46,14 @@ typedef struct buffer_directive {
 	fsize_t size;
 	boolean_t lock;
 	uint32_t change_flag;
+	fsize_t max_size;	/* optional maximum bufsize */
 
 } buffer_directive_t;
 
 /* Buffer directive set flags */
 #define	BD_size		0x00000002
 #define	BD_lock		0x00000004
+#define	BD_max		0x00000008
 
 
 /*
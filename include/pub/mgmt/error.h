@@ -435,6 +435,7 @@ typedef enum samapi_errno {
 	SE_RPC_UNKNOWN_CLIENT			= 30809,
 	SE_RPC_INSECURE_CLIENT			= 30810,
 	SE_RPC_PING_FAILED			= 30811,
+	SE_RPC_STREAM_NOT_FOUND			= 30812,
 
 	SE_LOAD_API_BEGIN =  SAM_MGMT_START + 900,
 	SE_PREVIEW_SHM_NOT_FOUND		= 30901,
@@ -60,8 +60,10 @@
  * API_VERSION "1.5.6"	Thu Sep 21 3:28:15 EDT 2006
  * API_VERSION "1.5.9"	Mon Oct 2 2:28:15 EDT 2006
  * API_VERSION "1.6.2"	Thu Oct 16 10:39:30 EDT 2008
+ * API_VERSION "1.6.3"	Mon Oct 19 09:12:40 EDT 2026
+ * API_VERSION "1.6.4"	Mon Oct 19 14:20:05 EDT 2026
  */
-#define	API_VERSION "1.6.3"
+#define	API_VERSION "1.6.5"
 
 
 #include "pub/mgmt/types.h"
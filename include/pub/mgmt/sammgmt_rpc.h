@@ -33,6 +33,8 @@
 
 
 #include "pub/mgmt/types.h"
+#include "pub/mgmt/sqm_list.h"
+#include "pub/mgmt/device.h"
 #include "mgmt/log.h"		/* for PTRACE in all consumers */
 
 #define	DEF_TIMEOUT_SEC	65
@@ -60,4 +62,37 @@ int get_server_info(ctx_t *ctx, char hostname[MAXHOSTNAMELEN + 1]);
  */
 char *get_server_version_from_ctx(ctx_t *c);
 
+
+/*
+ * Streamed lists
+ *
+ * The _stream variants of list returning calls return a list_stream_t
+ * from which the list is read in chunks, so the client never holds
+ * more than one chunk of a large list. list_stream_next returns the
+ * next chunk, or NULL once the list has been read. Each chunk is freed
+ * as the list returned by the call that is streamed.
+ *
+ * The server bounds each chunk by a number of entries and an encoded
+ * size. list_stream_set_limits lowers these bounds for the chunks
+ * after the first, 0 keeps the server's default.
+ *
+ * A server older than API version 1.6.4 returns the whole list as a
+ * single chunk.
+ */
+typedef struct list_stream list_stream_t;
+
+int list_stream_next(list_stream_t *ls, sqm_lst_t **chunk);
+int list_stream_total(list_stream_t *ls);
+void list_stream_set_limits(list_stream_t *ls, int max_entries,
+    uint32_t max_bytes);
+int list_stream_close(list_stream_t *ls);
+
+int get_vsn_list_stream(ctx_t *ctx, const char *vsn_reg_exp, int start,
+    int size, vsn_sort_key_t sort_key, boolean_t ascending,
+    list_stream_t **ls);
+int get_all_catalog_entries_stream(ctx_t *ctx, equ_t lib_eq, int start,
+    int size, vsn_sort_key_t sort_key, boolean_t ascending,
+    list_stream_t **ls);
+int get_all_staging_files_stream(ctx_t *ctx, list_stream_t **ls);
+
 #endif	/* _SAMMGMT_RPC_H_ */
@@ -47,10 +47,13 @@ typedef struct node {
 	void *data;
 } node_t;
 
+typedef struct lst_arena lst_arena_t;
+
 typedef struct sqm_lst {
 	node_t *head;
 	node_t *tail;
 	int length;
+	lst_arena_t *arena;	/* NULL if the nodes are malloc'ed */
 } sqm_lst_t;
 
 typedef int (*lstsrch_t)(
@@ -73,6 +76,44 @@ typedef int (*lstsrch_t)(
  */
 sqm_lst_t *lst_create();
 
+/*
+ * List arenas
+ *
+ * The nodes of a list created in an arena, and the strings copied in
+ * with lst_strdup, are allocated from the arena. lst_remove, trim_list
+ * and the lst_free functions do not free them, only the list header is
+ * malloc'ed. They are all released at once by lst_arena_reset or
+ * lst_arena_destroy. Data that must be freed on its own is not stored
+ * in such a list, and lst_concat and lst_merge require both lists to
+ * come from the same arena.
+ */
+lst_arena_t *lst_arena_create(void);
+void *lst_arena_alloc(lst_arena_t *arena, size_t size);
+void lst_arena_reset(lst_arena_t *arena);
+void lst_arena_destroy(lst_arena_t *arena);
+
+/* create an empty list in arena, a malloc'ed list if arena is NULL */
+sqm_lst_t *lst_create_arena(lst_arena_t *arena);
+
+/*
+ * Result lists
+ *
+ * A server sets the arena of the request being processed, the lists it
+ * builds as results with lst_create_result are created in that arena.
+ * The arena is set for the calling thread only. lst_set_result_arena
+ * returns the previous arena, lst_create_result works as lst_create
+ * when none is set.
+ */
+lst_arena_t *lst_set_result_arena(lst_arena_t *arena);
+sqm_lst_t *lst_create_result(void);
+
+/*
+ * copy a string to be stored in lst. lst_strfree frees a copy that
+ * was not stored after all.
+ */
+char *lst_strdup(sqm_lst_t *lst, const char *str);
+void lst_strfree(sqm_lst_t *lst, char *str);
+
 /*
  * Insert data into the list before the specified node. If the list is
  * empty and the node is NULL, data will simply be inserted into the
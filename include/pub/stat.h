@@ -492,6 +492,26 @@ int sam_restore_file(const char *path, struct sam_stat *buf,
 int sam_restore_copy(const char *path, int copy, struct sam_stat *buf,
 	size_t bufsize, struct sam_section *vbuf, size_t vbufsize);
 
+/*
+ * Bulk directory status.
+ * sam_readdir_stat() returns the next batch of entries of a directory
+ * opened by sam_opendir_stat(), each with the information sam_lstat()
+ * would return for it.  The batch is valid until the next call on the
+ * same handle.  Returns the number of entries, 0 at end of directory,
+ * or -1 with errno set.  SS_STAGING is not reported for entries.
+ */
+struct sam_dirstat_ent {
+	char		*name;		/* Entry name */
+	int		error;		/* errno if the entry stat failed */
+	struct sam_stat	st;		/* Entry status, if error == 0 */
+};
+
+typedef struct sam_dirstat sam_dirstat_t;
+
+sam_dirstat_t *sam_opendir_stat(const char *path);
+int sam_readdir_stat(sam_dirstat_t *dsp, struct sam_dirstat_ent **entp);
+int sam_closedir_stat(sam_dirstat_t *dsp);
+
 /*
  * macro NUM_SEGS, takes in, fsbuff,  a ptr to a sam_stat struct, returns the
  * number of segments of the file associated with fsbuff.
@@ -49,9 +49,20 @@
  */
 enum {
 	DBFILE_CREATE = 1 << 0,		/* Create db */
-	DBFILE_RDONLY = 1 << 1		/* Read only */
+	DBFILE_RDONLY = 1 << 1,		/* Read only */
+	DBFILE_CACHE  = 1 << 2		/* Cache records, defer syncs */
 };
 
+/*
+ * With DBFILE_CACHE, Get is served from an in-process copy of the
+ * records.  Every Put or Del, cached or not, advances a generation
+ * count mapped from the file "<database file>.gen" in the environment
+ * home, which drops the copies held by all processes.  Syncs of a
+ * cached database are deferred for up to DBFILE_SYNC_SECS seconds;
+ * a flusher thread syncs what is left dirty, and Close syncs the rest.
+ */
+#define	DBFILE_SYNC_SECS 5
+
 /*
  * Forward declarations.
  */
@@ -83,6 +94,8 @@ struct DBFile {
 	int	(*EndIterator)(DBFile_t *);
 
 	int	(*Numof)(DBFile_t *, int *);
+
+	void	*cache;			/* Record cache if DBFILE_CACHE */
 };
 
 #endif /* SAM_DBFILE_H */
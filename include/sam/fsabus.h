@@ -0,0 +1,129 @@
+/*
+ *    SAM-QFS_notice_begin
+ *
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at pkg/OPENSOLARIS.LICENSE
+ * or https://illumos.org/license/CDDL.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at pkg/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+/*
+ * Copyright 2009 Sun Microsystems, Inc.  All rights reserved.
+ * Use is subject to license terms.
+ *
+ *    SAM-QFS_notice_end
+ */
+#if !defined(FSABUS_H)
+#define	FSABUS_H
+
+#include "sam/types.h"
+#include "sam/samevent.h"
+
+/*
+ * File system event bus.
+ *
+ * sam-fsalogd is the only reader of the kernel event buffer of a file
+ * system.  Besides writing the events to the log it copies them into
+ * the ring of each consumer registered in the log directory.  A ring
+ * is a file, <fs_name>.<consumer>.bus, mapped by the consumer and the
+ * daemon.  The daemon is the only writer of fr_in and the consumer the
+ * only writer of fr_out, so neither takes a lock.
+ *
+ * The daemon never waits for a consumer.  Events which match the
+ * filter of a full ring are dropped and reported to the consumer as a
+ * loss window at the ring position where they were dropped, the events
+ * can be read again from the log.  A ring outlives the consumer unless
+ * removed by sam_fsa_bus_close(), a restarted consumer continues at its
+ * cursor.
+ */
+#define	FSA_RING_MAGIC		0x46534152	/* "FSAR" */
+#define	FSA_RING_VERSION	1
+#define	FSA_RING_HDR_SIZE	256	/* Events start at this offset */
+#define	FSA_BUS_SUFFIX		".bus"
+#define	FSA_BUS_NAME_MAX	32	/* Longest consumer name */
+#define	FSA_BUS_CONSUMERS	32	/* Most rings served per fs */
+#define	FSA_BUS_SIZE		65536	/* Default ring events */
+#define	FSA_BUS_SIZE_MIN	1024
+#define	FSA_BUS_SIZE_MAX	(1 << 22)
+#define	FSA_BUS_RESCAN		10	/* Seconds between ring scans */
+#define	FSA_BUS_LOST		(-2)	/* sam_fsa_bus_read: loss window */
+
+typedef	struct sam_fsa_ring {		/* Ring file header		*/
+	MappedFile_t	fr_mf;		/* FSA_RING_MAGIC, valid	*/
+	uint32_t	fr_version;	/* FSA_RING_VERSION		*/
+	uint32_t	fr_size;	/* Events, a power of 2		*/
+
+	/* Written by the consumer */
+	uint32_t	fr_mask;	/* 1 << ev_num wanted, 0 all	*/
+	sam_ino_t	fr_min_ino;	/* Inode range wanted		*/
+	sam_ino_t	fr_max_ino;	/* 0 if no upper bound		*/
+	volatile uint32_t fr_out;	/* Events consumed		*/
+	volatile uint32_t fr_lost_ack;	/* Last loss window consumed	*/
+	uint32_t	fr_cpad[9];	/* Cursors on their own line	*/
+
+	/* Written by the daemon */
+	volatile uint32_t fr_in;	/* Events written		*/
+	volatile uint32_t fr_lost_gen;	/* Loss windows reported	*/
+	uint32_t	fr_lost_at;	/* Ring position of the window	*/
+	uint32_t	fr_lost_events;	/* Events dropped in window	*/
+	uint32_t	fr_lost_seqno;	/* First event dropped		*/
+	sam_time_t	fr_lost_time;
+	uint32_t	fr_hiwat;	/* Most events held		*/
+	uint32_t	fr_kern_lost;	/* Events lost by the kernel	*/
+	uint64_t	fr_seen;	/* Events offered		*/
+	uint64_t	fr_matched;	/* Events passing the filter	*/
+	uint64_t	fr_dropped;	/* Events dropped, ring full	*/
+	uint64_t	fr_full;	/* Loss windows opened		*/
+}	sam_fsa_ring_t;
+
+#define	FSA_RING_EVENT(r, pos) \
+	((sam_event_t *)(void *)((char *)(r) + FSA_RING_HDR_SIZE) + \
+	    ((pos) & ((r)->fr_size - 1)))
+
+typedef	struct {			/* Ring statistics		*/
+	uint32_t	fs_size;	/* Events			*/
+	uint32_t	fs_held;	/* Events not yet consumed	*/
+	uint32_t	fs_hiwat;	/* Most events held		*/
+	uint32_t	fs_kern_lost;	/* Events lost by the kernel	*/
+	uint64_t	fs_seen;	/* Events offered		*/
+	uint64_t	fs_matched;	/* Events passing the filter	*/
+	uint64_t	fs_dropped;	/* Events dropped, ring full	*/
+	uint64_t	fs_full;	/* Loss windows opened		*/
+}	sam_fsa_bus_stats_t;
+
+typedef	struct sam_fsa_bus sam_fsa_bus_t;	/* Consumer of a ring	*/
+typedef	struct sam_fsa_pub sam_fsa_pub_t;	/* Daemon of the rings	*/
+
+/* Consumer functions */
+int sam_fsa_bus_open(sam_fsa_bus_t **bus, char *path, char *fs_name,
+    char *consumer, int size);
+void sam_fsa_bus_filter(sam_fsa_bus_t *bus, uint32_t mask,
+    sam_ino_t min_ino, sam_ino_t max_ino);
+int sam_fsa_bus_read(sam_fsa_bus_t *bus, sam_event_t *events, int n);
+int sam_fsa_bus_lost(sam_fsa_bus_t *bus, uint32_t *seqno,
+    sam_time_t *time);
+int sam_fsa_bus_wait(sam_fsa_bus_t *bus, int msec);
+void sam_fsa_bus_stats(sam_fsa_bus_t *bus, sam_fsa_bus_stats_t *stats);
+int sam_fsa_bus_close(sam_fsa_bus_t **bus, boolean_t remove);
+
+/* Daemon functions */
+sam_fsa_pub_t *sam_fsa_pub_create(char *path, char *fs_name);
+void sam_fsa_pub_scan(sam_fsa_pub_t *pub, boolean_t force);
+void sam_fsa_pub_events(sam_fsa_pub_t *pub, sam_event_t *events, int n,
+    int kern_lost);
+void sam_fsa_pub_destroy(sam_fsa_pub_t *pub);
+
+#endif /* FSABUS_H */
@@ -53,6 +53,69 @@ typedef	struct {			/* FSA ondisk inventory entry	*/
 	short		status;		/* File status			*/
 }	sam_fsa_log_t;
 
+/*
+ * Indexed log format (log_format = indexed in fsalogd.cmd)
+ *
+ * The log is a sequence of blocks. Each block is a sam_fsa_blk_t, an
+ * optional inode bloom filter of fb_bloom_len bytes and fb_clen bytes
+ * of events compressed with zlib. The first block holds only the
+ * marker event written when the log is opened. The header records the
+ * time, inode and sequence number ranges of the block so readers skip
+ * blocks without reading them.
+ *
+ * When the log is closed the headers of all blocks, a sam_fsa_idx_t
+ * each, and a sam_fsa_trailer_t are appended. A log still being
+ * written, or one whose daemon died, is indexed by walking the block
+ * headers.
+ *
+ * Offsets in the inventory count uncompressed event bytes, as in a
+ * raw log.
+ */
+#define	FSA_FORMAT_RAW		0	/* log_format = raw */
+#define	FSA_FORMAT_INDEXED	1	/* log_format = indexed */
+
+#define	FSA_BLK_MAGIC		0x46534142	/* "FSAB" */
+#define	FSA_IDX_MAGIC		0x46534149	/* "FSAI" */
+#define	FSA_BLK_VERSION		1
+#define	FSA_BLK_EVENTS		4096	/* most events in a block */
+#define	FSA_BLOOM_MIN		64	/* smallest bloom filter, bytes */
+#define	FSA_BLOOM_MAX		8192	/* largest bloom filter, bytes */
+#define	FSA_BLOOM_HASHES	4
+
+/* Bit i of the bloom filter of nbits (a power of 2) bits for ino */
+#define	FSA_BLOOM_BIT(ino, i, nbits) \
+	(((uint32_t)(ino) * 0x9e3779b1U + \
+	    (uint32_t)(i) * ((uint32_t)(ino) * 0x85ebca6bU | 1)) & \
+	    ((nbits) - 1))
+
+typedef	struct {			/* Indexed log block header	*/
+	uint64_t	fb_first;	/* Number of first event in log	*/
+	uint32_t	fb_magic;	/* FSA_BLK_MAGIC		*/
+	uint16_t	fb_version;	/* FSA_BLK_VERSION		*/
+	uint16_t	fb_bloom_len;	/* Bloom filter bytes, 0 if none */
+	uint32_t	fb_events;	/* Number of events		*/
+	uint32_t	fb_clen;	/* Compressed length of events	*/
+	sam_time_t	fb_min_time;	/* Event time range		*/
+	sam_time_t	fb_max_time;
+	sam_ino_t	fb_min_ino;	/* Inode range (ev_id)		*/
+	sam_ino_t	fb_max_ino;
+	uint32_t	fb_min_seqno;	/* Sequence number range	*/
+	uint32_t	fb_max_seqno;
+}	sam_fsa_blk_t;
+
+typedef	struct {			/* Indexed log index entry	*/
+	sam_fsa_blk_t	fi_blk;		/* Copy of block header		*/
+	uint64_t	fi_offset;	/* File offset of block		*/
+}	sam_fsa_idx_t;
+
+typedef	struct {			/* Indexed log trailer		*/
+	uint64_t	ft_index;	/* File offset of index		*/
+	uint32_t	ft_magic;	/* FSA_IDX_MAGIC		*/
+	uint32_t	ft_blocks;	/* Number of index entries	*/
+}	sam_fsa_trailer_t;
+
+struct sam_fsa_blkrd;			/* Indexed log reader, fsalog.c	*/
+
 typedef	struct {			/* FSA inventory table		*/
 	uname_t		fs_name;	/* Family set name 		*/
 	int		l_fsn;		/* Family set name string length */
@@ -65,6 +128,8 @@ typedef	struct {			/* FSA inventory table		*/
 	char 		*path_inv;	/* Inventory file path/name	*/
 	char 		*path_log;	/* Log file path/name		*/
 	sam_time_t	last_time;	/* Time of last event read	*/
+	sam_ino_t	filter_ino;	/* Return only this inode, or 0	*/
+	struct sam_fsa_blkrd *blk;	/* Indexed log reader, or NULL	*/
 	sam_fsa_log_t	logs[1];	/* Log file table		*/
 }	sam_fsa_inv_t;
 
@@ -73,6 +138,8 @@ int sam_fsa_open_inv(sam_fsa_inv_t **inv, char *path,
     char *fs_name, char *appname);
 int sam_fsa_read_event(sam_fsa_inv_t **inv, sam_event_t *event);
 int sam_fsa_rollback(sam_fsa_inv_t **inv);
+int sam_fsa_seek_time(sam_fsa_inv_t **inv, sam_time_t time);
+void sam_fsa_set_filter(sam_fsa_inv_t *inv, sam_ino_t ino);
 int sam_fsa_print_inv(sam_fsa_inv_t *inv, FILE *file);
 int sam_fsa_close_inv(sam_fsa_inv_t **inv);
 
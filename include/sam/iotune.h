@@ -0,0 +1,100 @@
+/*
+ * iotune.h - Adaptive i/o buffer definitions.
+ */
+
+/*
+ *    SAM-QFS_notice_begin
+ *
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at pkg/OPENSOLARIS.LICENSE
+ * or https://illumos.org/license/CDDL.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at pkg/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+/*
+ * Copyright 2009 Sun Microsystems, Inc.  All rights reserved.
+ * Use is subject to license terms.
+ *
+ *    SAM-QFS_notice_end
+ */
+
+#ifndef SAM_IOTUNE_H
+#define	SAM_IOTUNE_H
+
+#ifdef sun
+#pragma ident "$Revision: 1.1 $"
+#endif
+
+/*
+ * A producer fills an i/o buffer that a consumer drains.  The producer
+ * stalls when the buffer has no room, the consumer when it has no data.
+ * IoTuneAdjust() looks at the stall time of each side once a second and
+ * adjusts the buffer depth and the read size of the producer:
+ *
+ *	Both sides stalled	The buffer does not absorb the bursts of
+ *				either side.  Double the depth, or at the
+ *				maximum depth, halve the read size.
+ *	Consumer stalled	The producer is the bottleneck.  Double the
+ *				read size, fewer reads carry the data.
+ *	Neither side stalled	After IOTUNE_QUIET such intervals, give back
+ *				a quarter of the depth.
+ *
+ * The depth and read size are in blocks of the buffer, and kept within
+ * their bounds.  A value with equal bounds is not changed; the stalls
+ * are recorded in any case.  The read size is at most half the depth.
+ *
+ * The structure may be in a file mapped by other processes, it holds
+ * no pointers.  The caller serializes the calls for a structure.
+ */
+#define	IOTUNE_BUCKETS	10		/* Histogram buckets, without +Inf */
+#define	IOTUNE_INTERVAL	1		/* Seconds between adjustments */
+#define	IOTUNE_QUIET	30		/* Quiet intervals before shrinking */
+#define	IOTUNE_STALL	5		/* Percent of interval is a stall */
+
+/*
+ * Stalls of one side of the buffer.
+ * Bucket n counts the stalls up to IoTuneBound(n) seconds, the last
+ * bucket the longer ones.
+ */
+struct IoTuneStalls {
+	uint64_t IsCount;		/* Stalls */
+	uint64_t IsTime;		/* Time stalled, ns */
+	uint64_t IsBuckets[IOTUNE_BUCKETS + 1];	/* Not cumulative */
+};
+
+struct IoTune {
+	int	ItDepth;		/* Buffer depth */
+	int	ItDepthMin;
+	int	ItDepthMax;
+	int	ItRead;			/* Read size */
+	int	ItReadMin;
+	int	ItReadMax;
+	int	ItAdjusts;		/* Changes made */
+	int	ItQuiet;		/* Intervals without a stall */
+	uint64_t ItStart;		/* Start of the interval, ns */
+	uint64_t ItProducerMark;	/* IsTime at start of the interval */
+	uint64_t ItConsumerMark;
+	struct IoTuneStalls ItProducer;	/* Waiting for room */
+	struct IoTuneStalls ItConsumer;	/* Waiting for data */
+};
+
+double IoTuneBound(int bucket);
+void IoTuneInit(struct IoTune *it, int depthMin, int depthMax,
+	int readMin, int readMax);
+void IoTuneStall(struct IoTuneStalls *is, uint64_t ns);
+boolean_t IoTuneAdjust(struct IoTune *it, uint64_t now);
+
+#endif /* SAM_IOTUNE_H */
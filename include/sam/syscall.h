@@ -76,6 +76,7 @@ typedef enum {
 	SC_trace_global = 22,	/* samgt global table */
 	SC_trace_tbl_wait = 23,	/* an individual cpu's data (wait for data) */
 	SC_projid = 24,		/* takes struct sam_projid_arg */
+	SC_fileops_list = 25,	/* takes struct sam_fileops_list_arg */
 	SC_USER_MAX = 99,
 
 	SC_FS_MIN = 100,
@@ -157,6 +158,29 @@ struct sam_fileops_arg {
 	SAM_POINTER(const char) ops;	/* File operation letters */
 };
 
+/*
+ * SC_fileops_list - archive, cancelstage, release, stage or ssum a list
+ * of files in one call.  An entry names its file by path or, if path is
+ * NULL, by id in the file system holding fs.  The error of each entry is
+ * returned in the entry.
+ */
+#define	SAM_FILEOPS_LIST_MAX	1024	/* Most entries per call */
+
+struct sam_fileops_ent {
+	SAM_POINTER(const char) path;	/* NULL - use id */
+	sam_id_t id;
+	int error;			/* Returned - errno, 0 if done */
+	int pad;			/* Same size in ILP32 and LP64 */
+};
+
+struct sam_fileops_list_arg {
+	SAM_POINTER(const char) fs;	/* File in the fs of the ids */
+	SAM_POINTER(const char) ops;	/* File operation letters */
+	SAM_POINTER(struct sam_fileops_ent) ents;
+	int cmd;			/* SC_archive, SC_stage, ... */
+	int count;			/* Entries */
+};
+
 struct sam_request_arg {
 	SAM_POINTER(const char) path;
 	SAM_POINTER(struct sam_rminfo) buf;	/* Buffer for rm info */
@@ -465,7 +489,12 @@ typedef struct sam_onoff_client_arg {	/* On / off client command args */
 } sam_onoff_client_arg_t;
 
 
-enum sam_ib_cmd {SAM_FREE_BLOCK, SAM_FIND_ORD, SAM_MOVE_ORD};
+/*
+ * SAM_MOVE_ORD_ONLY is SAM_MOVE_ORD which allocates only on new_ord,
+ * without the stripe rotation to the other devices.
+ */
+enum sam_ib_cmd {SAM_FREE_BLOCK, SAM_FIND_ORD, SAM_MOVE_ORD,
+	SAM_MOVE_ORD_ONLY};
 
 typedef struct {		/* inode on ord? */
 	enum sam_ib_cmd cmd;
@@ -483,14 +512,33 @@ typedef struct sam_stage_arg {
 	enum STAGER_cmd {
 		STAGER_setpid = 1,	/* Set samgt.stager_pid */
 		STAGER_getrequest = 2,	/* Get stage request from fs */
+		STAGER_getrequests = 3,	/* Get stage requests from fs */
 		STAGER_MAX
 	} stager_cmd;
 	union {
 		pid_t pid;		/* stagerd'd pid */
 		SAM_POINTER(sam_stage_request_t) request; /* stage request */
+		SAM_POINTER(struct sam_stage_batch) batch; /* stage requests */
 	} p;
 } sam_stage_arg_t;
 
+/*
+ * Stage requests of a SC_fileops_list stage, sent to sam-stagerd in
+ * one command.  STAGER_getrequests returns count requests, a single
+ * stage request is returned with count 1.
+ */
+#define	SAM_STAGE_BATCH_MAX	SAM_FILEOPS_LIST_MAX
+
+typedef struct sam_stage_batch {
+	int32_t count;		/* Requests in the batch */
+	int32_t max;		/* Requests allocated, kernel only */
+	sam_stage_request_t request[SAM_STAGE_BATCH_MAX];
+} sam_stage_batch_t;
+
+#define	SAM_STAGE_BATCH_SIZE(n) \
+	(sizeof (sam_stage_batch_t) - \
+	(SAM_STAGE_BATCH_MAX - (n)) * sizeof (sam_stage_request_t))
+
 typedef struct sam_fsstage_arg {
 	sam_handle_t handle;	/* file handle for stage */
 	int directio;		/* directio directive */
@@ -94,6 +94,13 @@ struct UdsMsgProcess {
 
 /*
  * Arguments to UdsRecvMsg.
+ *
+ * A server with UsThreads greater than 1 serves that many connections at
+ * once, each in its own thread with its own argument buffer.  The message
+ * functions must then be reentrant and return a response that stays valid
+ * in the calling thread until its next message.  UsBegin and UsEnd, if
+ * given, are called in the serving thread before and after the message
+ * function, e.g. to take and release the locks the message needs.
  */
 struct UdsServer {
 	char	*UsServerName;		/* Server's UDS socket name */
@@ -104,12 +111,41 @@ struct UdsServer {
 	struct UdsMsgProcess *UsTable;	/* Message processing table */
 	int	UsNumofTable;		/* Number of entries in table */
 	size_t	UsArgbufSize;		/* Size of message argument buffer. */
+	int	UsThreads;		/* Connections served at once, */
+					/* 0 serves one at a time */
+	void	(*UsBegin)(int type, void *arg); /* Optional functions */
+	void	(*UsEnd)(int type, void *arg);	/* around a message */
+};
+
+/*
+ * Batched client messages.
+ *
+ * UdsSendBatch() sends an array of these on one connection.  Requests
+ * are pipelined UDS_BATCH_WINDOW at a time and the server answers them
+ * in order, so each response is matched to its request by position.
+ * A batch is not a transaction.  The server processes each request as
+ * it reads it, so if the batch stops part way, the requests answered
+ * before the failure have taken effect, and a request sent but not
+ * answered may have.
+ */
+#define	UDS_BATCH_WINDOW 64
+
+struct UdsBatchMsg {
+	int	UbType;			/* Server message type */
+	void	*UbArg;			/* Argument to message */
+	int	UbArgSize;		/* Size of argument to send */
+	void	*UbRsp;			/* Where to put response */
+	int	UbRspSize;		/* Size of response buffer */
+	int	UbStatus;		/* Returned: 0 or UM_nak */
+	int	UbErrno;		/* Returned: errno from a nak */
 };
 
 /* Functions. */
 int UdsSendMsg(const char *SrcFile, const int SrcLine, struct UdsClient *clnt,
 	int SrvrMsgType, void *arg, int arg_size, void *rsp,
 	int rsp_size);
+int UdsSendBatch(const char *SrcFile, const int SrcLine,
+	struct UdsClient *clnt, struct UdsBatchMsg *msgs, int count);
 int UdsRecvMsg(struct UdsServer *srvr);
 
 #endif /* UDSCOM_H */
@@ -406,6 +406,7 @@ makeMediaParams(void)
 		strncpy(mp->MpMtype, dp->nm, sizeof (mp->MpMtype));
 		mp->MpType = dp->dt;
 		mp->MpBufsize = 16;
+		mp->MpBufsizeMax = 16;
 
 		/*
 		 * Set default write timeout based on media type.
@@ -518,6 +518,9 @@ printConf(void)
 		/* media: */
 		printf("%s%s", GetCustMsg(4640), mp->MpMtype);
 		printf(" bufsize: %d", mp->MpBufsize);
+		if (mp->MpBufsizeMax > mp->MpBufsize) {
+			printf("-%d", mp->MpBufsizeMax);
+		}
 		if (mp->MpFlags & MP_lockbuf) {
 			printf(" (locked)");
 		}
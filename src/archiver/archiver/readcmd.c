@@ -464,7 +464,7 @@ dirBackGndTime(void)
 
 
 /*
- * bufsize = buffer size value.
+ * bufsize = buffer size value [maximum] [lock].
  */
 static void
 dirBufsize(void)
@@ -490,7 +490,23 @@ dirBufsize(void)
 	}
 	checkRange(dirName, val, 2, 8192);
 	mp->MpBufsize = val;
-	if (ReadCfgGetToken() != 0) {
+	mp->MpBufsizeMax = val;
+	if (ReadCfgGetToken() != 0 && isdigit(*token)) {
+		/*
+		 * Maximum bufsize, sam-arcopy adjusts the buffer between
+		 * the two.
+		 */
+		errno = 0;
+		val = strtoll(token, &p, 0);
+		if (errno != 0 || *p != '\0') {
+			/* Invalid '%s' value '%s' */
+			ReadCfgError(CustMsg(14101), dirName, token);
+		}
+		checkRange(dirName, val, mp->MpBufsize, 8192);
+		mp->MpBufsizeMax = val;
+		(void) ReadCfgGetToken();
+	}
+	if (*token != '\0') {
 		if (strcmp(token, "lock") == 0) {
 			mp->MpFlags |= MP_lockbuf;
 		} else {
@@ -2788,7 +2804,7 @@ setDiskArchives(void)
 
 		asi = &ArchSetTable[i];
 		if (asi->AsFlags & AS_disk_archive) {
-			dkDrives += asi->AsDrives;
+			dkDrives += GetArchDrives(asi);
 		} else if (asi->AsFlags & AS_honeycomb) {
 			hcDrives += asi->AsDrives;
 			if (asi->AsArchmax != 0) {
@@ -69,6 +69,26 @@ static char *_SrcFile = __FILE__;   /* Using __FILE__ makes duplicate strings */
 /* Macros. */
 #define	VOL_INCR 17
 
+/*
+ * Volume selection cost model.
+ * Estimated seconds until an arcopy can start writing on a volume.
+ */
+#define	MOUNT_COST	60	/* Changer move, load and label check */
+#define	UNLOAD_COST	30	/* Unload to free a drive for the mount */
+#define	LOCATE_COST	5	/* Fixed cost of locating to end of data */
+#define	WIND_COST	100	/* Wind over the full length of a tape */
+
+/*
+ * Drive hold.
+ * A drive seen in use by the stager or another process is held for
+ * HOLD_TIME after the use.  An ArchReq that has been queued longer
+ * than HOLD_WAIT, or its queue time limit, ignores held drives.
+ */
+#define	HOLD_TIME	120
+#define	HOLD_WAIT	(30 * 60)
+
+#define	DECISION_MAX	16	/* Volume decisions kept for ScheduleTrace() */
+
 /* Wait flags - entries in the wait queue. */
 enum {
 	WF_acnors = 0x01,	/* sam-arcopy norestart error */
@@ -136,6 +156,20 @@ static struct VolOverflow {
 	} entry[1];
 } *volsOverflow = NULL;
 
+/*
+ * Recent volume decisions.
+ */
+static struct Decision {
+	time_t	DeTime;
+	char	DeArname[ARCHREQ_NAME_SIZE];
+	mtype_t	DeMtype;
+	vsn_t	DeVsn;
+	int	DeCost;			/* Estimated seconds to start */
+	int	DeCandidates;		/* Volumes costed */
+	char	*DeReason;
+} decisions[DECISION_MAX];
+static int decisionNext = 0;
+
 static ExecState_t dkState = ES_run;
 static ExecState_t rmState = ES_run;
 static boolean_t amldStart = FALSE;
@@ -155,6 +189,7 @@ static boolean_t runCopies = TRUE;
 static int archiveFiles(void);
 static void arcopyComplete(char *argv1, int stat);
 static struct ArchReq *cartridgeBusy(struct VolInfo *vi);
+static void checkDriveUse(void);
 static void checkQueueTime(void);
 static int cmp_aDkVolspace(const void *p1, const void *p2);
 static int cmp_dDkVolspace(const void *p1, const void *p2);
@@ -172,12 +207,15 @@ static FRstatus_t findRmVolume(struct ArchReq *ar, struct ArchSet *as,
 		fsize_t spaceRequired, int cpi);
 static fsize_t getOvflmin(struct ArchSet *as, char *mtype);
 static void initSchedule(void);
-static boolean_t isArchLibDriveFree(int aln);
+static boolean_t isArchLibDriveFree(int aln, boolean_t hold);
+static boolean_t isDriveHeld(struct ArchDriveEntry *ad, time_t now);
 static void moreCpiWork(struct ArchReq *ar, int cpi);
 static void requeueEntries(void);
 static int startArcopy(struct ArchReq *ar, int cpi);
 static void stopArcopys(struct ArchReq *ar, ExecControl_t ctrl);
+static void traceDecisions(void);
 static void traceDriveStatus(void);
+static int volumeCost(struct VolInfo *vi, char **reason);
 static boolean_t waitArchReq(struct ArchReq *ar);
 static void waitMessage(void);
 static void wakeup(void);
@@ -656,6 +694,7 @@ ScheduleTrace(void)
 {
 	PthreadMutexLock(&scheduleMutex);
 	traceDriveStatus();
+	traceDecisions();
 	QueueTrace(HERE, &schedQ);
 	QueueTrace(HERE, &archQ);
 	QueueTrace(HERE, &waitQ);
@@ -700,6 +739,7 @@ archiveFiles(void)
 	if (*TraceFlags & (1 << TR_queue)) {
 		QueueTrace(HERE, &schedQ);
 	}
+	checkDriveUse();
 	waiting = 0;
 	for (qe = schedQ.QuHead.QeFwd; qe != &schedQ.QuHead; qe = qeNext) {
 		struct ArchReq *ar;
@@ -977,7 +1017,6 @@ arcopyComplete(
 	}
 	ar = qe->QeAr;
 	ci = &ar->ArCpi[cpi];
-	*ci->CiVsn = '\0';
 	*AdState->AdArchReq[ci->CiArcopyNum] = '\0';
 
 	if (!(ci->CiFlags & CI_diskInstance)) {
@@ -988,6 +1027,12 @@ arcopyComplete(
 		ad = &al->AlDriveTable[ci->CiRmFn - al->AlRmFn];
 		ad->AdFlags &= ~AD_busy;
 
+		/*
+		 * The drive may stay open for the volume after the arcopy
+		 * exits.  That is not use by another process.
+		 */
+		memmove(ad->AdArchVsn, ci->CiVsn, sizeof (ad->AdArchVsn));
+
 		/*
 		 * Remove any overflow volumes.
 		 */
@@ -1001,6 +1046,7 @@ arcopyComplete(
 			}
 		}
 	}
+	*ci->CiVsn = '\0';
 
 	Trace(TR_MISC, "%s[%d](%s) finished.", AC_PROG, (int)ci->CiPid, argv1);
 	ci->CiPid = 0;
@@ -1073,6 +1119,82 @@ cartridgeBusy(
 }
 
 
+/*
+ * Check drive use.
+ * A drive that is open, and does not hold a volume being archived to,
+ * is being used by the stager or another removable media process.
+ * Note the time so the drive is held for that process.
+ * A drive still open for the volume a completed arcopy wrote is not
+ * held, until the drive has been closed or the volume changed.
+ */
+static void
+checkDriveUse(void)
+{
+	time_t	now;
+	int	aln;
+
+	now = time(NULL);
+	for (aln = 0; aln < ArchLibTable->count; aln++) {
+		struct ArchLibEntry *al;
+		int	adn;
+
+		al = &ArchLibTable->entry[aln];
+		if (al->AlFlags &
+		    (AL_disk | AL_honeycomb | AL_historian | AL_sim)) {
+			continue;
+		}
+		for (adn = 0; adn < al->AlDrivesNumof; adn++) {
+			struct ArchDriveEntry *ad;
+			struct QueueEntry *qe;
+
+			ad = &al->AlDriveTable[adn];
+			if (*ad->AdArchVsn != '\0' &&
+			    (ad->AdDevent == NULL ||
+			    ad->AdDevent->open_count == 0 ||
+			    strcmp(ad->AdArchVsn, ad->AdVi.VfVsn) != 0)) {
+				*ad->AdArchVsn = '\0';
+			}
+			if (!(ad->AdFlags & AD_avail) || ad->AdDevent == NULL ||
+			    ad->AdDevent->open_count == 0) {
+				continue;
+			}
+			for (qe = archQ.QuHead.QeFwd; qe != &archQ.QuHead;
+			    qe = qe->QeFwd) {
+				struct ArchReq *ar;
+				int	i;
+
+				ar = qe->QeAr;
+				for (i = 0; i < ar->ArDrives; i++) {
+					if (strcmp(ar->ArCpi[i].CiVsn,
+					    ad->AdVi.VfVsn) == 0 &&
+					    strcmp(ar->ArCpi[i].CiMtype,
+					    ad->AdVi.VfMtype) == 0) {
+						break;
+					}
+				}
+				if (i < ar->ArDrives) {
+					break;
+				}
+			}
+			if (qe != &archQ.QuHead || *ad->AdArchVsn != '\0') {
+				/*
+				 * Archiving to the volume, or not yet closed
+				 * after archiving to it.
+				 */
+				ad->AdUsedTime = 0;
+				continue;
+			}
+			if (ad->AdUsedTime == 0) {
+				Trace(TR_QUEUE, "Drive %s held, in use (%s.%s)",
+				    ad->AdName, ad->AdVi.VfMtype,
+				    ad->AdVi.VfVsn);
+			}
+			ad->AdUsedTime = now;
+		}
+	}
+}
+
+
 /*
  * Check queue time.
  */
@@ -1338,6 +1460,7 @@ findDkVolumes(
 	fsize_t spaceAvail;
 	char	arname[ARCHREQ_NAME_SIZE];
 	int	i;
+	int	streams;
 	int	volsTried;
 
 	Trace(TR_QUEUE, "ArchReq %s: assigning volumes, space:%s",
@@ -1400,7 +1523,14 @@ findDkVolumes(
 			volsAvail->count = 1;
 		}
 	}
-	volsAvail->count = min(volsAvail->count, drivesToUse);
+
+	/*
+	 * Each volume takes up to -streams copy instances, the copy
+	 * instances are assigned to the volumes in turn.
+	 */
+	streams = GetArchStreams(as);
+	volsAvail->count = min(volsAvail->count,
+	    (drivesToUse + streams - 1) / streams);
 	spaceAvail = 0;
 	for (i = 0; i < volsAvail->count; i++) {
 		vi = &volsAvail->entry[i];
@@ -1578,10 +1708,11 @@ findResources(
 
 	/*
 	 * Set number of drives allowed for the Archive Set.
+	 * Each tar file stream of a disk archive set counts as a drive.
 	 * The selected space for all the ArchReqs being scheduled
 	 * or archiving must be at least 'drivemin'.
 	 */
-	asDrives = (as->AsFlags & AS_drives) ? as->AsDrives : 1;
+	asDrives = GetArchDrives(as);
 	if (asDrives > ar->ArDrives) {
 		asDrives = ar->ArDrives;
 	}
@@ -1840,13 +1971,19 @@ findRmVolume(
 	struct ArcopyInstance *ci;
 	struct FileInfo *fi;
 	boolean_t fillvsns = FALSE;
+	boolean_t hold;
 	boolean_t noDrives;
 	fsize_t ovflmin = 0;
 	char	arname[ARCHREQ_NAME_SIZE];
+	char	*bestReason = NULL;
+	int	best;
+	int	bestCost = 0;
+	int	candidates;
 	int	drivesInuse;
 	int	*fii;
 	int	i;
 	int	volsTried;
+	time_t	holdWait;
 
 	/*
 	 * Collect volumes for assigning to the ArchReq.
@@ -1861,6 +1998,19 @@ findRmVolume(
 	msgFname = "";
 	noDrives = TRUE;
 	volsTried = 0;
+	best = -1;
+	candidates = 0;
+
+	/*
+	 * Honor drive holds unless the ArchReq has waited too long.
+	 * A volume request is from a running arcopy that has a drive.
+	 */
+	holdWait = HOLD_WAIT;
+	if (as->AsQueueTime < holdWait) {
+		holdWait = as->AsQueueTime;
+	}
+	hold = (ar->ArState != ARS_volRequest &&
+	    ar->ArTimeQueued + holdWait >= time(NULL)) ? TRUE : FALSE;
 	for (;;) {
 		if (volsAvail->count >= volsAvail->alloc) {
 			size_t	size;
@@ -1928,7 +2078,7 @@ findRmVolume(
 		 * Skip volume if no drives are free for the library holding
 		 * the volume.
 		 */
-		if (!isArchLibDriveFree(vi->VfAln)) {
+		if (!isArchLibDriveFree(vi->VfAln, hold)) {
 			drivesInuse++;
 			continue;
 		}
@@ -1955,6 +2105,9 @@ findRmVolume(
 				 * Not busy for this ArchReq.
 				 */
 				if (vi->VfFlags & VF_reserved) {
+					if (best != -1) {
+						break;
+					}
 					/* Reserved volume busy */
 					ArchReqMsg(HERE, ar, 4330);
 					return (FS_busy);
@@ -1970,16 +2123,52 @@ findRmVolume(
 			continue;
 		}
 		if (!(vi->VfFlags & VF_busy) && vi->VfSpace >= spaceRequired) {
+			char	*reason;
+			int	cost;
+
 			/*
-			 * First non-busy volume with enough space.
-			 * Use this volume.
+			 * Non-busy volume with enough space.
+			 * Use the cheapest one to start on, the first
+			 * one if equal.
 			 */
-			volsAvail->toUse = 1;
-			volsAvail->entry[0] = *vi;
-			return (FS_start);
+			cost = volumeCost(vi, &reason);
+			candidates++;
+			Trace(TR_QUEUE, "  %s.%s space:%s cost:%d %s",
+			    vi->VfMtype, vi->VfVsn,
+			    StrFromFsize(vi->VfSpace, 1, NULL, 0),
+			    cost, reason);
+			if (best == -1 || cost < bestCost) {
+				best = volsAvail->count - 1;
+				bestCost = cost;
+				bestReason = reason;
+				if (cost == 0) {
+					break;
+				}
+			}
 		}
 	}
 
+	if (best != -1) {
+		struct Decision *de;
+
+		volsAvail->toUse = 1;
+		volsAvail->entry[0] = volsAvail->entry[best];
+		vi = &volsAvail->entry[0];
+		Trace(TR_QUEUE, "ArchReq %s: volume %s.%s cost:%d of %d %s",
+		    arname, vi->VfMtype, vi->VfVsn, bestCost, candidates,
+		    bestReason);
+		de = &decisions[decisionNext];
+		decisionNext = (decisionNext + 1) % DECISION_MAX;
+		de->DeTime = time(NULL);
+		strncpy(de->DeArname, arname, sizeof (de->DeArname));
+		strncpy(de->DeMtype, vi->VfMtype, sizeof (de->DeMtype));
+		strncpy(de->DeVsn, vi->VfVsn, sizeof (de->DeVsn));
+		de->DeCost = bestCost;
+		de->DeCandidates = candidates;
+		de->DeReason = bestReason;
+		return (FS_start);
+	}
+
 	if (volsAvail->count == 0) {
 		/*
 		 * No volumes available to use -
@@ -2180,14 +2369,34 @@ initSchedule(void)
  */
 static boolean_t		/* TRUE if a drive is available */
 isArchLibDriveFree(
-	int aln)		/* Archive library to check */
+	int aln,		/* Archive library to check */
+	boolean_t hold)		/* Held drives are not available */
 {
+	struct ArchLibEntry *al;
 	struct QueueEntry *qe;
 	int	drivesAllow;
+	int	drivesAvail;
+
+	al = &ArchLibTable->entry[aln];
+	drivesAvail = al->AlDrivesAvail;
+	if (hold) {
+		time_t	now;
+		int	adn;
 
-	drivesAllow = ArchLibTable->entry[aln].AlDrivesAllow;
-	if (drivesAllow > ArchLibTable->entry[aln].AlDrivesAvail) {
-		drivesAllow = ArchLibTable->entry[aln].AlDrivesAvail;
+		now = time(NULL);
+		for (adn = 0; adn < al->AlDrivesNumof; adn++) {
+			if ((al->AlDriveTable[adn].AdFlags & AD_avail) &&
+			    isDriveHeld(&al->AlDriveTable[adn], now)) {
+				drivesAvail--;
+			}
+		}
+	}
+	drivesAllow = al->AlDrivesAllow;
+	if (drivesAllow > drivesAvail) {
+		drivesAllow = drivesAvail;
+	}
+	if (drivesAllow <= 0) {
+		return (FALSE);
 	}
 	for (qe = archQ.QuHead.QeFwd; qe != &archQ.QuHead; qe = qe->QeFwd) {
 		int	i;
@@ -2206,6 +2415,18 @@ isArchLibDriveFree(
 }
 
 
+/*
+ * Determine if a drive is held for another process.
+ */
+static boolean_t		/* TRUE if the drive is held */
+isDriveHeld(
+	struct ArchDriveEntry *ad,
+	time_t now)
+{
+	return (ad->AdUsedTime != 0 && now - ad->AdUsedTime < HOLD_TIME);
+}
+
+
 /*
  * Assign more work to a copy instance.
  */
@@ -2396,6 +2617,36 @@ stopArcopys(
 }
 
 
+/*
+ * Trace recent volume decisions.
+ */
+static void
+traceDecisions(void)
+{
+	FILE	*st;
+	int	i;
+
+	Trace(TR_MISC, "Volume decisions:");
+	if ((st = TraceOpen()) == NULL) {
+		return;
+	}
+	for (i = 0; i < DECISION_MAX; i++) {
+		struct Decision *de;
+		char ts[ISO_STR_FROM_TIME_BUF_SIZE];
+
+		de = &decisions[(decisionNext + i) % DECISION_MAX];
+		if (de->DeTime == 0) {
+			continue;
+		}
+		fprintf(st, " %s %s %s.%s cost:%ds of %d %s\n",
+		    TimeToIsoStr(de->DeTime, ts), de->DeArname,
+		    de->DeMtype, de->DeVsn, de->DeCost, de->DeCandidates,
+		    de->DeReason);
+	}
+	TraceClose(INT_MAX);
+}
+
+
 /*
  * Trace drive status.
  */
@@ -2403,12 +2654,14 @@ static void
 traceDriveStatus(void)
 {
 	FILE	*st;
+	time_t	now;
 	int	aln;
 
 	Trace(TR_MISC, "Drive status:");
 	if ((st = TraceOpen()) == NULL) {
 		return;
 	}
+	now = time(NULL);
 	for (aln = 0; aln < ArchLibTable->count; aln++) {
 		struct ArchLibEntry *al;
 		int	adn;
@@ -2439,7 +2692,8 @@ traceDriveStatus(void)
 			} else {
 				fprintf(st, "          ");
 			}
-			fprintf(st, "     Vol:");
+			fprintf(st, isDriveHeld(ad, now) ? " held" : "     ");
+			fprintf(st, "Vol:");
 			PrintVolInfo(st, &ad->AdVi);
 		}
 	}
@@ -2447,6 +2701,68 @@ traceDriveStatus(void)
 }
 
 
+/*
+ * Estimate the cost of starting to archive on a volume.
+ * Loaded volumes need no mount, but a drive held for another process
+ * must first be given up.  An unloaded volume needs a mount, and an
+ * unload if no drive in the library is empty.  Tape must then be
+ * positioned to the end of data.  Serpentine media reach the end of
+ * data with less winding than the space used suggests, the estimate
+ * still favors emptier volumes.
+ */
+static int			/* Estimated seconds */
+volumeCost(
+	struct VolInfo *vi,
+	char **reason)
+{
+	struct ArchLibEntry *al;
+	time_t	now;
+	int	adn;
+	int	cost;
+
+	al = &ArchLibTable->entry[vi->VfAln];
+	now = time(NULL);
+	cost = 0;
+	if (vi->VfFlags & VF_loaded) {
+		*reason = "loaded";
+		for (adn = 0; adn < al->AlDrivesNumof; adn++) {
+			struct ArchDriveEntry *ad;
+
+			ad = &al->AlDriveTable[adn];
+			if (strcmp(ad->AdVi.VfMtype, vi->VfMtype) == 0 &&
+			    strcmp(ad->AdVi.VfVsn, vi->VfVsn) == 0) {
+				if (isDriveHeld(ad, now)) {
+					*reason = "loaded, drive held";
+					cost += HOLD_TIME;
+				}
+				break;
+			}
+		}
+	} else {
+		*reason = "unload and mount";
+		cost += MOUNT_COST + UNLOAD_COST;
+		for (adn = 0; adn < al->AlDrivesNumof; adn++) {
+			struct ArchDriveEntry *ad;
+
+			ad = &al->AlDriveTable[adn];
+			if ((ad->AdFlags & AD_avail) &&
+			    !(ad->AdFlags & AD_busy) &&
+			    *ad->AdVi.VfVsn == '\0') {
+				*reason = "mount";
+				cost -= UNLOAD_COST;
+				break;
+			}
+		}
+	}
+	if ((sam_atomedia(vi->VfMtype) & DT_CLASS_MASK) == DT_TAPE &&
+	    vi->VfCapacity != 0 && vi->VfSpace <= vi->VfCapacity) {
+		cost += LOCATE_COST + (int)((WIND_COST *
+		    (vi->VfCapacity - vi->VfSpace)) / vi->VfCapacity);
+	}
+	return (cost);
+}
+
+
 /*
  * Check for suspended archiving.
  */
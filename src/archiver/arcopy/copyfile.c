@@ -54,6 +54,7 @@ static char *_SrcFile = __FILE__;   /* Using __FILE__ makes duplicate strings */
 /* Solaris headers. */
 #include <sys/mman.h>
 #include <sys/param.h>
+#include <sys/time.h>
 
 /* SAM-FS headers. */
 #include "pub/rminfo.h"
@@ -79,6 +80,7 @@ static char *_SrcFile = __FILE__;   /* Using __FILE__ makes duplicate strings */
 /* Private data. */
 static pthread_mutex_t bufInuse = PTHREAD_MUTEX_INITIALIZER;
 static boolean_t lockBuffer = FALSE;
+static boolean_t autoTune = FALSE;	/* Tune buffer, Instance->CiTune */
 static fsize_t fileOffset = 0;	/* Offset from beginning of archive file */
 static int s_fd;		/* Source file descriptor */
 
@@ -86,6 +88,7 @@ static int s_fd;		/* Source file descriptor */
 static char *bufFirst = NULL;	/* Start of buffer */
 static char *bufLast = NULL;	/* End of buffer */
 static size_t bufSize;		/* Integral multiple of media block size */
+static int blockCount;		/* bufSize / WriteCount */
 
 /* Circular buffer controls. */
 static ATOM_INT_T bufIn = 0;	/* Offset in buffer of next input */
@@ -101,6 +104,7 @@ static pthread_cond_t bufRead = PTHREAD_COND_INITIALIZER;
 static pthread_cond_t bufWrite = PTHREAD_COND_INITIALIZER;
 
 /* Control flags. */
+static boolean_t bufDrain = FALSE;
 static boolean_t bufEndArchive = FALSE;
 static boolean_t bufEmpty = FALSE;
 static boolean_t bufFull = FALSE;
@@ -113,6 +117,7 @@ static void copyLink(void);
 static void copyRmMedia(struct sam_disk_inode *dp);
 static void copyRegular(struct sam_disk_inode *dp);
 static void copySegment(struct sam_disk_inode *dp);
+static void tuneBuffer(boolean_t betweenFiles);
 static void wakeup(void);
 static boolean_t writeBlock(size_t nbytes);
 static void writeStop(void);
@@ -311,6 +316,7 @@ simread:
 		RoundBuffer(TAR_RECORDSIZE);
 	}
 	PthreadMutexUnlock(&bufInuse);
+	tuneBuffer(TRUE);
 
 	/*
 	 * Close the file and update its status.
@@ -339,7 +345,6 @@ simread:
 void
 CopyFileReconfig(void)
 {
-	static int blockCount;
 	char	*prevBufFirst;
 	size_t	prevBufSize;
 	int	blkCnt;
@@ -350,6 +355,7 @@ CopyFileReconfig(void)
 	prevBufSize = bufSize;
 	if (bufFirst == NULL) {
 		struct MediaParamsEntry *mp;
+		int	maxCount;
 
 		mp = MediaParamsGetEntry(VolsTable->entry[VolCur].Vi.VfMtype);
 		if (ArchiveSet->AsFlags & AS_bufsize) {
@@ -365,6 +371,24 @@ CopyFileReconfig(void)
 		    (mp != NULL && (mp->MpFlags & MP_lockbuf))) {
 			lockBuffer = TRUE;
 		}
+
+		/*
+		 * With a maximum bufsize, the buffer grows between the
+		 * two as tuneBuffer() finds, and the read size changes.
+		 * Otherwise only the stalls are recorded.
+		 */
+		maxCount = (mp != NULL) ? mp->MpBufsizeMax : blockCount;
+		autoTune = (maxCount > blockCount) ? TRUE : FALSE;
+		if (autoTune) {
+			IoTuneInit(&Instance->CiTune, blockCount, maxCount,
+			    1, maxCount / 2);
+		} else {
+			IoTuneInit(&Instance->CiTune, blockCount, blockCount,
+			    blockCount / 2, blockCount / 2);
+		}
+	}
+	if (Instance->CiTune.ItDepth > blockCount) {
+		blockCount = Instance->CiTune.ItDepth;
 	}
 	blkCnt = blockCount;
 	bSize = (longlong_t)blkCnt * (longlong_t)WriteCount;
@@ -376,6 +400,11 @@ CopyFileReconfig(void)
 		Trace(TR_MISC,
 		    "bufsize %d too big, adjusted to %d", blockCount, blkCnt);
 		blockCount = blkCnt;
+		Instance->CiTune.ItDepth = blkCnt;
+		Instance->CiTune.ItDepthMax = blkCnt;
+		if (Instance->CiTune.ItDepthMin > blkCnt) {
+			Instance->CiTune.ItDepthMin = blkCnt;
+		}
 	}
 	bufSize = blockCount * WriteCount;
 	if (bufSize <= prevBufSize) {
@@ -435,6 +464,9 @@ CopyFileReconfig(void)
 		SamFree(prevBufFirst);
 	}
 	ReadCount = bufSize / 2;
+	if (autoTune && Instance->CiTune.ItRead * WriteCount < ReadCount) {
+		ReadCount = Instance->CiTune.ItRead * WriteCount;
+	}
 	Trace(TR_ARDEBUG,
 	    "Block size %d, WriteCount %d, ReadCount %d, blockCount %d%s",
 	    BlockSize, WriteCount, ReadCount, blockCount,
@@ -471,6 +503,7 @@ WriteBuffer(
 		 */
 		for (;;) {
 			boolean_t was_full;
+			hrtime_t start;
 			int	l;
 			int	n;
 
@@ -493,7 +526,14 @@ WriteBuffer(
 					break;
 				}
 				bufEmpty = TRUE;
+				if (bufDrain) {
+					/* tuneBuffer() waits for this. */
+					PthreadCondSignal(&bufRead);
+				}
+				start = gethrtime();
 				PthreadCondWait(&bufWrite, &bufLock);
+				IoTuneStall(&Instance->CiTune.ItConsumer,
+				    gethrtime() - start);
 				if (Exec == ES_term) {
 					PthreadMutexUnlock(&bufLock);
 					goto out;
@@ -706,6 +746,7 @@ WaitRoom(
 	PthreadMutexLock(&bufLock);
 	PthreadMutexUnlock(&bufInuse);
 	for (;;) {
+		hrtime_t start;
 		ssize_t	n;
 
 		n = bufOut - bufIn;
@@ -720,7 +761,9 @@ WaitRoom(
 		 * Wait for the write thread to make some.
 		 */
 		bufFull = TRUE;
+		start = gethrtime();
 		PthreadCondWait(&bufRead, &bufLock);
+		IoTuneStall(&Instance->CiTune.ItProducer, gethrtime() - start);
 	}
 	PthreadMutexLock(&bufInuse);
 	PthreadMutexUnlock(&bufLock);
@@ -949,6 +992,7 @@ copyRegular(
 		ssize_t	l;
 		ssize_t	n;
 
+		tuneBuffer(FALSE);
 		l = ReadCount;
 		if (size < l) {
 			l = size;
@@ -1099,6 +1143,53 @@ copySegment(
 }
 
 
+/*
+ * Tune the buffer.
+ * The read size may change at any read.  The buffer grows only between
+ * files, with the write thread waiting for data, and does not shrink.
+ */
+static void
+tuneBuffer(
+	boolean_t betweenFiles)
+{
+	struct IoTune *it = &Instance->CiTune;
+	boolean_t grow;
+
+	if (!autoTune) {
+		return;
+	}
+	PthreadMutexLock(&bufLock);
+	if (IoTuneAdjust(it, gethrtime())) {
+		Trace(TR_ARDEBUG, "Buffer tuned: depth %d, read %d",
+		    it->ItDepth, it->ItRead);
+	}
+	ReadCount = it->ItRead * WriteCount;
+	if (ReadCount > bufSize / 2) {
+		/* Until the buffer grows. */
+		ReadCount = bufSize / 2;
+	}
+	grow = (betweenFiles && it->ItDepth > blockCount) ? TRUE : FALSE;
+	if (grow) {
+		/*
+		 * Wait for the write thread to take all full blocks.
+		 */
+		bufDrain = TRUE;
+		while (!bufEmpty && !bufWriteEnd && Exec == ES_run) {
+			PthreadCondWait(&bufRead, &bufLock);
+		}
+		bufDrain = FALSE;
+		grow = bufEmpty;
+	}
+	PthreadMutexUnlock(&bufLock);
+	if (grow) {
+		CopyFileReconfig();
+		PthreadMutexLock(&bufLock);
+		it->ItDepthMin = blockCount;
+		PthreadMutexUnlock(&bufLock);
+	}
+}
+
+
 /*
  * Write next block.
  */
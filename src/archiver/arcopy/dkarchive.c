@@ -268,6 +268,13 @@ DkGetVolumeSeqnum(
 		return (-1);
 	}
 
+	/*
+	 * Other streams to the volume may end while we hold the sequence
+	 * number, and set the recycle sequence number past it.  Show the
+	 * recycler the sequence number is in use before they can.
+	 */
+	Instance->CiSeqNum = DsVal;
+
 	if (SamrftFlock(RemoteArchive.rft, F_UNLCK) < 0) {
 		Trace(TR_ERR, "Disk volume seqnum file %s, flock failed %d",
 		    ScrPath, errno);
@@ -275,8 +282,6 @@ DkGetVolumeSeqnum(
 	}
 	(void) SamrftClose(RemoteArchive.rft);
 
-	Instance->CiSeqNum = DsVal;
-
 	return (DsVal);
 }
 
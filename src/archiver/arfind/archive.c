@@ -1219,7 +1219,7 @@ createArchReq(
 	ar->ArSeqnum = State->AfSeqNum++;
 	ar->ArVersion	= ARCHREQ_VERSION;
 	ar->ArState		= ARS_create;
-	ar->ArDrives	= (as->AsFlags & AS_drives) ? as->AsDrives : 1;
+	ar->ArDrives	= GetArchDrives(as);
 
 	ar->ArMinSpace	= FSIZE_MAX;
 	ar->ArPriority	= PR_MIN;
@@ -2205,8 +2205,12 @@ updateParams(
 	struct ArchReq *ar,
 	struct ArchSet *as)
 {
+	int	drives;
+
 	setStartValues(ar, as);
-	if ((as->AsFlags & AS_drives) && ar->ArDrives != as->AsDrives) {
+	drives = GetArchDrives(as);
+	if ((as->AsFlags & (AS_drives | AS_streams)) &&
+	    ar->ArDrives != drives) {
 		char	*fic;
 		int	copy;
 		int	i;
@@ -2217,7 +2221,7 @@ updateParams(
 		 * Adjust size of ArchReq for new drive count.
 		 * Relocate file information.
 		 */
-		incr = (as->AsDrives - ar->ArDrives) *
+		incr = (drives - ar->ArDrives) *
 		    sizeof (struct ArcopyInstance);
 		while (ar->ArSize + incr >= ar->Ar.MfLen) {
 			ar = ArchReqGrow(ar);
@@ -2228,7 +2232,7 @@ updateParams(
 		if (incr > 0) {
 			memset(fic, 0, incr);
 		}
-		ar->ArDrives = as->AsDrives;
+		ar->ArDrives = drives;
 		ar->ArSize += incr;
 
 		/*
@@ -46,6 +46,7 @@
 #include "common.h"
 #include "archset.h"
 #include "archreq.h"
+#include "dirstate.h"
 #include "examlist.h"
 #include "fileprops.h"
 #include "scanlist.h"
@@ -137,10 +138,24 @@ void SetArchdone(char *filePath, struct sam_disk_inode *dinode);
 struct FilePropsEntry *ClassifyFile(char *path, struct sam_perm_inode *pinode,
 	sam_time_t *accessTime);
 void ClassifyInit(void);
+boolean_t ClassifyNoarchDir(char *dirPath);
 
 /* control.c */
 char *Control(char *ident, char *value);
 
+/* dirstate.c */
+void DirStateChanged(sam_id_t dirId);
+void DirStateEnter(sam_id_t id, sam_timestruc_t change, uint32_t flags,
+	uint64_t seq);
+void DirStateInit(void);
+void DirStateInvalidate(void);
+boolean_t DirStateLookup(sam_id_t id, sam_ino_t parent, uint32_t *flags,
+	sam_timestruc_t *change, uint64_t *seq);
+void DirStateRmInode(sam_id_t id);
+boolean_t DirStateScanBegin(struct ScanListEntry *se);
+void DirStateScanEnd(struct ScanListEntry *se, boolean_t complete);
+void DirStateTrace(void);
+
 /* examinodes.c */
 void *ExamInodes(void *arg);
 void ExamInodesAddEntry(sam_id_t id, int mode, sam_time_t xeTime, char *caller);
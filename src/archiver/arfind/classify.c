@@ -36,8 +36,10 @@
 static char *_SrcFile = __FILE__;   /* Using __FILE__ makes duplicate strings */
 
 /* ANSI C headers. */
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 /* POSIX headers. */
 #include <sys/types.h>
@@ -55,6 +57,58 @@ static char *_SrcFile = __FILE__;   /* Using __FILE__ makes duplicate strings */
 #undef snprintf
 #endif /* defined(lint) */
 
+/*
+ * Compiled file properties.
+ * ClassifyInit() compiles the FileProps rules into a trie of the rule
+ * paths and a compact table of the search criteria.  Each trie node
+ * holds the candidate rules for files in that directory: the node's
+ * own rules merged with those of its parent directories, in FileProps
+ * order.  Classifying a file is then one walk of its path plus a check
+ * of just the candidate rules.
+ */
+struct ClRule {
+	uint32_t CrFlags;	/* FpFlags */
+	uid_t	CrUid;
+	gid_t	CrGid;
+	fsize_t	CrMinsize;
+	fsize_t	CrMaxsize;
+	char	*CrRegexp;	/* Compiled regular expression */
+
+	/*
+	 * A literal string that all matches of the regular expression
+	 * contain.  Paths without it are rejected without calling regex().
+	 */
+	char	*CrLit;
+	int	CrLitLen;
+	int	CrLitPos;	/* Where the literal must be */
+	boolean_t CrExact;	/* Literal is the whole regular expression */
+};
+
+/* Definitions for CrLitPos. */
+#define	LP_start 0x01		/* At start of path */
+#define	LP_end	0x02		/* At end of path */
+
+struct ClNode {
+	struct ClNode *CnChild;	/* First child */
+	struct ClNode *CnNext;	/* Next sibling */
+	int	*CnRules;	/* Candidate rules if path continues with '/' */
+	int	CnCount;	/* Number of candidate rules */
+	int	CnArchived;	/* First rule below that may archive, 0 none */
+	char	CnChar;		/* Path character */
+};
+
+/* Private data. */
+static struct FileProps *clFileProps = NULL;	/* FileProps compiled */
+static struct ClRule *clRules = NULL;
+static int clRulesCount = 0;
+static struct ClNode *clRoot = NULL;
+
+/* Private functions. */
+static void compileLiteral(struct ClRule *cr, char *re);
+static void freeNode(struct ClNode *node);
+static struct ClNode *lookupNode(char *path);
+static boolean_t matchName(struct ClRule *cr, char *path, size_t pathLen);
+static void mergeRules(struct ClNode *node, int *avail, int availCount);
 
 /*
  * Classify a file.
@@ -68,9 +122,13 @@ ClassifyFile(
 {
 	struct sam_disk_inode *dinode = (struct sam_disk_inode *)pinode;
 	struct FilePropsEntry *fp;
+	struct ClNode *node;
 	boolean_t accessTimeFixed;
+	fsize_t	size;
+	size_t	pathLen;
 	int	fmode;
 	int	i;
+	int	n;
 
 	/*
 	 * Classify files by type.
@@ -134,72 +192,40 @@ ClassifyFile(
 	/*
 	 * Regular files and symbolic links.
 	 * Search for matching file properties.
-	 * Skip metadata file properties.
+	 * Only the rules for the file's directories are candidates.
+	 * The inexpensive criteria are checked before the name.
 	 */
-	for (i = 1; i < FileProps->FpCount; i++) {
-		/*
-		 * Compare the directory path to the file properties path.
-		 * A empty file properties path will match all directories.
-		 */
-		fp = &FileProps->FpEntry[i];
-		if (fp->FpPathSize != 0) {
-			char	*pp, *dp;
+	node = lookupNode(path);
+	pathLen = strlen(path);
+	size = S_ISSEGS(dinode) ? *SEGFILE_SIZE(dinode) : dinode->rm.size;
+	for (n = 0; n < node->CnCount; n++) {
+		struct ClRule *cr;
+		uint32_t flags;
 
-			dp = path;
-			if (dp[fp->FpPathSize] != '/') {
-				continue;
-			}
-			pp = fp->FpPath;
-			while (*pp != '\0' && *pp == *dp) {
-				pp++;
-				dp++;
-			}
-			if (*pp != '\0' || *dp != '/') {
-				continue;
-			}
-		}
-		if (!(fp->FpFlags & FP_props)) {
+		i = node->CnRules[n];
+		cr = &clRules[i];
+		flags = cr->CrFlags;
+		if (!(flags & FP_props)) {
 			/* No file properties to check. */
 			break;
 		}
-		if ((fp->FpFlags & FP_name) &&
-		    regex(fp->FpRegexp, path, NULL) == NULL) {
-			continue;
-		}
-		Trace(TR_DEBUG, "Regexp match %s __loc1 %s", path, __loc1);
-		if ((fp->FpFlags & FP_uid) && dinode->uid != fp->FpUid) {
+		if (((flags & FP_uid) && dinode->uid != cr->CrUid) ||
+		    ((flags & FP_gid) && dinode->gid != cr->CrGid) ||
+		    ((flags & FP_minsize) && size < cr->CrMinsize) ||
+		    ((flags & FP_maxsize) && size >= cr->CrMaxsize)) {
 			continue;
 		}
-		if ((fp->FpFlags & FP_gid) && dinode->gid != fp->FpGid) {
+		if ((flags & FP_name) && !matchName(cr, path, pathLen)) {
 			continue;
 		}
-		if (fp->FpFlags & FP_minsize) {
-			if (!S_ISSEGS(dinode) &&
-			    dinode->rm.size < fp->FpMinsize) {
-				continue;
-			}
-			if (S_ISSEGS(dinode) &&
-			    *SEGFILE_SIZE(dinode) < fp->FpMinsize) {
-				continue;
-			}
-		}
-		if (fp->FpFlags & FP_maxsize) {
-			if (!S_ISSEGS(dinode) &&
-			    dinode->rm.size >= fp->FpMaxsize) {
-				continue;
-			}
-			if (S_ISSEGS(dinode) &&
-			    *SEGFILE_SIZE(dinode) >= fp->FpMaxsize) {
-				continue;
-			}
-		}
-		if (fp->FpFlags & FP_access) {
+		fp = &FileProps->FpEntry[i];
+		if (flags & FP_access) {
 			time_t	accessRef;
 
 			/*
 			 * Check access time.
 			 */
-			if (!(fp->FpFlags & FP_nftv)) {
+			if (!(flags & FP_nftv)) {
 				/*
 				 * Adjust file time for implausible times -
 				 * too far in the past or future.
@@ -228,7 +254,7 @@ ClassifyFile(
 				continue;
 			}
 		}
-		if (fp->FpFlags & FP_after) {
+		if (flags & FP_after) {
 			if (dinode->modify_time.tv_sec < fp->FpAfter &&
 			    dinode->creation_time < fp->FpAfter) {
 				continue;
@@ -236,10 +262,11 @@ ClassifyFile(
 		}
 		break;
 	}
-	if (i >= FileProps->FpCount) {
+	if (n >= node->CnCount) {
 		/* No rules found */
 		return (NULL);
 	}
+	fp = &FileProps->FpEntry[i];
 
 	/* do not archive XATTR files and directories, will be dumped */
 	if (fp->FpFlags & FP_noxattrarch && SAM_INODE_IS_XATTR(pinode))
@@ -302,20 +329,117 @@ ClassifyFile(
 }
 
 
+/*
+ * Determine if a directory is no_archive.
+ * The directory is no_archive if the first rule for files in it is a
+ * no_archive rule without search criteria, and no earlier rule for a
+ * path below it may archive files.
+ */
+boolean_t
+ClassifyNoarchDir(
+	char *dirPath)
+{
+	struct ClNode *best;
+	struct ClNode *node;
+	char	*p;
+	int	archived;
+	int	n;
+
+	if (clFileProps != FileProps) {
+		return (FALSE);
+	}
+
+	/*
+	 * Walk the path and the '/' that would follow it.
+	 */
+	best = clRoot;
+	node = clRoot;
+	archived = 0;
+	for (p = dirPath; ; p++) {
+		struct ClNode *child;
+		char	c;
+
+		c = (*p != '\0') ? *p : '/';
+		if (c == '/' && node->CnRules != NULL) {
+			best = node;
+		}
+		for (child = node->CnChild; child != NULL;
+		    child = child->CnNext) {
+			if (child->CnChar == c) {
+				break;
+			}
+		}
+		if (child == NULL) {
+			break;
+		}
+		node = child;
+		if (*p == '\0') {
+			archived = node->CnArchived;
+			break;
+		}
+	}
+
+	for (n = 0; n < best->CnCount; n++) {
+		struct ClRule *cr;
+		int	i;
+
+		i = best->CnRules[n];
+		cr = &clRules[i];
+		if (cr->CrFlags & FP_props) {
+			if (FileProps->FpEntry[i].FpPathSize == 0) {
+				/* Applies to files, not directories. */
+				continue;
+			}
+			return (FALSE);
+		}
+		if (!(cr->CrFlags & FP_noarch)) {
+			return (FALSE);
+		}
+		return (archived == 0 || archived > i);
+	}
+	return (FALSE);
+}
+
+
 /*
  * Initialize module.
+ * Compile the file properties.
  */
 void
 ClassifyInit(void)
 {
+	int	*avail;
+	int	availCount;
 	int	i;
 
-	/*
-	 * Compile regular expression for -name.
-	 */
+	if (clRoot != NULL) {
+		freeNode(clRoot);
+	}
+	if (clRules != NULL) {
+		for (i = 1; i < clRulesCount; i++) {
+			if (clRules[i].CrLit != NULL) {
+				SamFree(clRules[i].CrLit);
+			}
+		}
+		SamFree(clRules);
+	}
+	SamMalloc(clRules, FileProps->FpCount * sizeof (struct ClRule));
+	memset(clRules, 0, FileProps->FpCount * sizeof (struct ClRule));
+	clRulesCount = FileProps->FpCount;
+	SamMalloc(clRoot, sizeof (struct ClNode));
+	memset(clRoot, 0, sizeof (struct ClNode));
+	SamMalloc(avail, FileProps->FpCount * sizeof (int));
+	availCount = 0;
+
 	for (i = 1; i < FileProps->FpCount; i++) {
 		struct FilePropsEntry *fp;
+		struct ClRule *cr;
+		struct ClNode *node;
+		char	*p;
 
+		/*
+		 * Compile regular expression for -name.
+		 */
 		fp = &FileProps->FpEntry[i];
 		if (fp->FpFlags & FP_name) {
 			fp->FpRegexp = regcmp(fp->FpName, NULL);
@@ -326,5 +450,378 @@ ClassifyInit(void)
 		} else {
 			fp->FpRegexp = NULL;
 		}
+
+		cr = &clRules[i];
+		cr->CrFlags = fp->FpFlags;
+		cr->CrUid = fp->FpUid;
+		cr->CrGid = fp->FpGid;
+		cr->CrMinsize = fp->FpMinsize;
+		cr->CrMaxsize = fp->FpMaxsize;
+		cr->CrRegexp = fp->FpRegexp;
+		if (fp->FpFlags & FP_name) {
+			compileLiteral(cr, fp->FpName);
+		}
+
+		/*
+		 * Enter the path in the trie.
+		 * A empty file properties path will match all directories.
+		 */
+		if (fp->FpPathSize == 0) {
+			avail[availCount++] = i;
+			continue;
+		}
+		node = clRoot;
+		for (p = fp->FpPath; *p != '\0'; p++) {
+			struct ClNode *child;
+
+			for (child = node->CnChild; child != NULL;
+			    child = child->CnNext) {
+				if (child->CnChar == *p) {
+					break;
+				}
+			}
+			if (child == NULL) {
+				SamMalloc(child, sizeof (struct ClNode));
+				memset(child, 0, sizeof (struct ClNode));
+				child->CnChar = *p;
+				child->CnNext = node->CnChild;
+				node->CnChild = child;
+			}
+			node = child;
+			if (node->CnArchived == 0 &&
+			    (!(fp->FpFlags & FP_noarch) ||
+			    (fp->FpFlags & FP_props))) {
+				node->CnArchived = i;
+			}
+		}
+		SamRealloc(node->CnRules, (node->CnCount + 1) * sizeof (int));
+		node->CnRules[node->CnCount++] = i;
+	}
+	mergeRules(clRoot, avail, availCount);
+	SamFree(avail);
+	clFileProps = FileProps;
+}
+
+
+/* Private functions. */
+
+
+/*
+ * Find the literal string in a regular expression.
+ * Any regular expression element not understood here causes no literal
+ * to be used.  The literal only rejects paths that cannot match.
+ */
+static void
+compileLiteral(
+	struct ClRule *cr,
+	char *re)
+{
+	char	best[sizeof (((struct FilePropsEntry *)0)->FpName)];
+	char	run[sizeof (((struct FilePropsEntry *)0)->FpName)];
+	char	*p;
+	int	bestLen;
+	int	bestPos;
+	int	elements;	/* Number of non-literal elements */
+	int	runLen;
+	int	runPos;
+
+	bestLen = 0;
+	bestPos = 0;
+	elements = 0;
+	runLen = 0;
+	runPos = 0;
+	p = re;
+	if (*p == '^') {
+		runPos = LP_start;
+		p++;
+	}
+	for (;;) {
+		boolean_t lit;
+		boolean_t endRun;
+		char	c;
+
+		endRun = FALSE;
+		lit = FALSE;
+		c = '\0';
+		if (*p == '\0') {
+			endRun = TRUE;
+		} else if (*p == '$' && p[1] == '\0') {
+			runPos |= LP_end;
+			endRun = TRUE;
+			p++;
+		} else if (*p == '\\') {
+			if (p[1] == '\0' || isalnum(p[1])) {
+				return;
+			}
+			c = p[1];
+			lit = TRUE;
+			p += 2;
+		} else if (*p == '.') {
+			p++;
+		} else if (*p == '[') {
+			p++;
+			if (*p == '^') {
+				p++;
+			}
+			if (*p == ']') {
+				p++;
+			}
+			while (*p != '\0' && *p != ']') {
+				p++;
+			}
+			if (*p == '\0') {
+				return;
+			}
+			p++;
+		} else if (*p == '(') {
+			int	depth;
+
+			/*
+			 * Skip the group and any "$n" after it.
+			 */
+			depth = 1;
+			p++;
+			while (*p != '\0' && depth > 0) {
+				if (*p == '\\' && p[1] != '\0') {
+					p++;
+				} else if (*p == '(') {
+					depth++;
+				} else if (*p == ')') {
+					depth--;
+				}
+				p++;
+			}
+			if (depth > 0) {
+				return;
+			}
+			if (*p == '$' && isdigit(p[1])) {
+				p += 2;
+			}
+		} else if (strchr(")]*+{}^$", *p) != NULL) {
+			return;
+		} else {
+			c = *p++;
+			lit = TRUE;
+		}
+
+		/*
+		 * A literal character that may be absent ends the run.
+		 * One that may be repeated ends the run after it.
+		 */
+		if (*p == '*' || *p == '{') {
+			if (*p == '{') {
+				while (*p != '\0' && *p != '}') {
+					p++;
+				}
+				if (*p == '\0') {
+					return;
+				}
+			}
+			p++;
+			lit = FALSE;
+		} else if (*p == '+') {
+			p++;
+			if (lit) {
+				run[runLen++] = c;
+				lit = FALSE;
+			}
+		}
+		if (lit) {
+			run[runLen++] = c;
+			continue;
+		}
+
+		/*
+		 * Keep the best run.  An anchored run is cheapest to check,
+		 * otherwise prefer the longest.
+		 */
+		if (runLen > 0 && (bestLen == 0 ||
+		    (runPos != 0 && bestPos == 0) ||
+		    ((runPos != 0) == (bestPos != 0) && runLen > bestLen))) {
+			memmove(best, run, runLen);
+			bestLen = runLen;
+			bestPos = runPos;
+		}
+		if (endRun) {
+			break;
+		}
+		elements++;
+		runLen = 0;
+		runPos = 0;
+	}
+	if (bestLen == 0) {
+		return;
+	}
+	SamMalloc(cr->CrLit, bestLen + 1);
+	memmove(cr->CrLit, best, bestLen);
+	cr->CrLit[bestLen] = '\0';
+	cr->CrLitLen = bestLen;
+	cr->CrLitPos = bestPos;
+	cr->CrExact = (elements == 0);
+}
+
+
+/*
+ * Free trie node and its descendants.
+ */
+static void
+freeNode(
+	struct ClNode *node)
+{
+	struct ClNode *child;
+
+	while ((child = node->CnChild) != NULL) {
+		node->CnChild = child->CnNext;
+		freeNode(child);
+	}
+	if (node->CnRules != NULL) {
+		SamFree(node->CnRules);
+	}
+	SamFree(node);
+}
+
+
+/*
+ * Find the candidate rules for a path.
+ * Returns the trie node for the longest rule path that is a directory
+ * of the path.
+ */
+static struct ClNode *
+lookupNode(
+	char *path)
+{
+	struct ClNode *best;
+	struct ClNode *node;
+	char	*p;
+
+	if (clFileProps != FileProps) {
+		/* Not compiled, the empty file properties. */
+		static struct ClNode empty;
+
+		return (&empty);
+	}
+	best = clRoot;
+	node = clRoot;
+	for (p = path; *p != '\0'; p++) {
+		struct ClNode *child;
+
+		if (*p == '/' && node->CnRules != NULL) {
+			best = node;
+		}
+		for (child = node->CnChild; child != NULL;
+		    child = child->CnNext) {
+			if (child->CnChar == *p) {
+				break;
+			}
+		}
+		if (child == NULL) {
+			break;
+		}
+		node = child;
+	}
+	return (best);
+}
+
+
+/*
+ * Match the path name with a rule's regular expression.
+ */
+static boolean_t
+matchName(
+	struct ClRule *cr,
+	char *path,
+	size_t pathLen)
+{
+	if (cr->CrLitLen != 0) {
+		size_t	l;
+
+		l = cr->CrLitLen;
+		if (pathLen < l) {
+			return (FALSE);
+		}
+		switch (cr->CrLitPos) {
+		case LP_start | LP_end:
+			if (pathLen != l || memcmp(path, cr->CrLit, l) != 0) {
+				return (FALSE);
+			}
+			break;
+		case LP_start:
+			if (memcmp(path, cr->CrLit, l) != 0) {
+				return (FALSE);
+			}
+			break;
+		case LP_end:
+			if (memcmp(path + pathLen - l, cr->CrLit, l) != 0) {
+				return (FALSE);
+			}
+			break;
+		default:
+			if (strstr(path, cr->CrLit) == NULL) {
+				return (FALSE);
+			}
+			break;
+		}
+		if (cr->CrExact) {
+			Trace(TR_DEBUG, "Regexp match %s", path);
+			return (TRUE);
+		}
+	}
+	if (regex(cr->CrRegexp, path, NULL) == NULL) {
+		return (FALSE);
+	}
+	Trace(TR_DEBUG, "Regexp match %s __loc1 %s", path, __loc1);
+	return (TRUE);
+}
+
+
+/*
+ * Make the candidate rules for a trie node and its descendants.
+ * avail is the rules for the parent directories.
+ */
+static void
+mergeRules(
+	struct ClNode *node,
+	int *avail,
+	int availCount)
+{
+	struct ClNode *child;
+
+	if (node->CnCount != 0 || node == clRoot) {
+		int	*own;
+		int	*rules;
+		int	a, o, n;
+
+		/*
+		 * Merge the node's rules with the parents' rules.
+		 * Both are in FileProps order.
+		 */
+		own = node->CnRules;
+		rules = NULL;
+		if (availCount + node->CnCount != 0) {
+			SamMalloc(rules,
+			    (availCount + node->CnCount) * sizeof (int));
+		}
+		a = o = n = 0;
+		while (a < availCount || o < node->CnCount) {
+			if (o >= node->CnCount ||
+			    (a < availCount && avail[a] < own[o])) {
+				rules[n++] = avail[a++];
+			} else {
+				rules[n++] = own[o++];
+			}
+		}
+		if (own != NULL) {
+			SamFree(own);
+		}
+		node->CnRules = rules;
+		node->CnCount = n;
+	}
+
+	for (child = node->CnChild; child != NULL; child = child->CnNext) {
+		if (child->CnChar == '/' && node->CnRules != NULL) {
+			mergeRules(child, node->CnRules, node->CnCount);
+		} else {
+			mergeRules(child, avail, availCount);
+		}
 	}
 }
@@ -206,6 +206,7 @@ dirTrace(void)
 	ScanfsTrace();
 	ArchiveTrace();
 	IdToPathTrace();
+	DirStateTrace();
 	MapFileTrace();
 #if defined(TRACEREFS)
 	TraceRefs();
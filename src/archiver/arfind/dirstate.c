@@ -0,0 +1,542 @@
+/*
+ * dirstate.c - Remember the result of directory scans.
+ *
+ * The directory scanner records for each directory its change time and
+ * whether the last scan found any file in it, or in any directory below
+ * it, that needed to be examined.  File system events mark the
+ * directory of the file, and the directories above it, as changed.
+ * A later scan need not examine the files of an unchanged clean
+ * directory, nor enter an unchanged directory tree that is all clean.
+ */
+
+/*
+ *    SAM-QFS_notice_begin
+ *
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at pkg/OPENSOLARIS.LICENSE
+ * or https://illumos.org/license/CDDL.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at pkg/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+/*
+ * Copyright 2009 Sun Microsystems, Inc.  All rights reserved.
+ * Use is subject to license terms.
+ *
+ *    SAM-QFS_notice_end
+ */
+
+#pragma ident "$Revision: 1.1 $"
+
+static char *_SrcFile = __FILE__;   /* Using __FILE__ makes duplicate strings */
+
+/* ANSI C headers. */
+#include <errno.h>
+#include <limits.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/* POSIX headers. */
+#include <fcntl.h>
+#include <pthread.h>
+
+/* SAM-FS headers. */
+#include "sam/lib.h"
+
+/* Local headers. */
+#include "arfind.h"
+#include "dir_inode.h"
+
+/* Macros. */
+#define	DIRSTATE_START 4096	/* Initial number of entries */
+#define	DIRSTATE_DEPTH 1024	/* Parent directories marked changed */
+#define	DE_HASH(ino) (((ino) * 2654435761U) & (dirState->DsSize - 1))
+
+/* Private data. */
+static struct DirState *dirState = NULL;
+static pthread_mutex_t dirStateMutex = PTHREAD_MUTEX_INITIALIZER;
+static char ts[ISO_STR_FROM_TIME_BUF_SIZE];
+
+/* Private functions. */
+static void createDirState(void);
+static struct DirStateEntry *findEntry(sam_ino_t ino);
+static void growDirState(void);
+static void newGeneration(void);
+static uint32_t propsSignature(void);
+static void removeEntry(struct DirStateEntry *de);
+
+
+/*
+ * Begin a directory scan.
+ * RETURN: TRUE if unchanged directories may be skipped.
+ */
+boolean_t
+DirStateScanBegin(
+	struct ScanListEntry *se)
+{
+	boolean_t skip;
+	uint32_t props;
+
+	if (State->AfExamine != EM_scandirs) {
+		return (FALSE);
+	}
+	props = propsSignature();
+	PthreadMutexLock(&dirStateMutex);
+	if (dirState == NULL) {
+		createDirState();
+		dirState->DsProps = props;
+	}
+	if (dirState->DsProps != props) {
+		/*
+		 * Directories may be archived differently.
+		 */
+		Trace(TR_MISC, "Dirstate: file properties changed");
+		dirState->DsProps = props;
+		newGeneration();
+	}
+
+	/*
+	 * Scan all directories every background interval.
+	 */
+	skip = TRUE;
+	if ((se->SeFlags & SE_full) &&
+	    time(NULL) - dirState->DsFullScan >= State->AfBackGndInterval) {
+		skip = FALSE;
+	}
+	PthreadMutexUnlock(&dirStateMutex);
+	return (skip);
+}
+
+
+/*
+ * End a directory scan.
+ * Note the time of a full scan that did not skip any directory.
+ */
+void
+DirStateScanEnd(
+	struct ScanListEntry *se,
+	boolean_t complete)
+{
+	PthreadMutexLock(&dirStateMutex);
+	if (dirState != NULL && (se->SeFlags & SE_full) && complete) {
+		dirState->DsFullScan = time(NULL);
+	}
+	PthreadMutexUnlock(&dirStateMutex);
+}
+
+
+/*
+ * A file system event for an inode in a directory.
+ * Mark the directory changed, and the directories above it.
+ */
+void
+DirStateChanged(
+	sam_id_t dirId)
+{
+	struct DirStateEntry *de;
+	int	n;
+
+	PthreadMutexLock(&dirStateMutex);
+	if (dirState == NULL) {
+		goto out;
+	}
+	dirState->DsSeq++;
+	de = findEntry(dirId.ino);
+	if (de->DeId.ino == 0 || de->DeId.gen != dirId.gen) {
+		goto out;
+	}
+	de->DeFlags &= ~(DE_clean | DE_subclean);
+	de->DeSeq = dirState->DsSeq;
+	for (n = 0; n < DIRSTATE_DEPTH; n++) {
+		if (de->DeId.ino == SAM_ROOT_INO || de->DeParent == 0) {
+			break;
+		}
+		de = findEntry(de->DeParent);
+		if (de->DeId.ino == 0) {
+			break;
+		}
+		de->DeFlags &= ~DE_subclean;
+		de->DeSubSeq = dirState->DsSeq;
+	}
+
+out:
+	PthreadMutexUnlock(&dirStateMutex);
+}
+
+
+/*
+ * Enter the result of a directory scan.
+ * Changes since the directory was looked up clear the flags.
+ */
+void
+DirStateEnter(
+	sam_id_t id,
+	sam_timestruc_t change,
+	uint32_t flags,
+	uint64_t seq)
+{
+	struct DirStateEntry *de;
+
+	PthreadMutexLock(&dirStateMutex);
+	if (dirState == NULL || seq < dirState->DsGenSeq) {
+		/*
+		 * Invalidated during the scan.
+		 */
+		goto out;
+	}
+	de = findEntry(id.ino);
+	if (de->DeId.ino == 0 || de->DeId.gen != id.gen) {
+		/*
+		 * Removed during the scan.
+		 */
+		goto out;
+	}
+	if (de->DeSeq > seq) {
+		flags &= ~(DE_clean | DE_subclean);
+	}
+	if (de->DeSubSeq > seq) {
+		flags &= ~DE_subclean;
+	}
+	de->DeChange = change;
+	de->DeFlags = flags;
+	de->DeGen = dirState->DsGen;
+
+out:
+	PthreadMutexUnlock(&dirStateMutex);
+}
+
+
+/*
+ * Initialize module.
+ * Recover the directory state if the file system was not changed since
+ * the last execution.
+ */
+void
+DirStateInit(void)
+{
+	if (!Recover || State->AfExamine != EM_scandirs) {
+		return;
+	}
+	dirState = ArMapFileAttach(DIRSTATE, DIRSTATE_MAGIC, O_RDWR);
+	if (dirState == NULL) {
+		return;
+	}
+	if (dirState->DsVersion != DIRSTATE_VERSION) {
+		Trace(TR_DEBUG, "dirstate version mismatch."
+		    " Is: %d, should be: %d",
+		    dirState->DsVersion, DIRSTATE_VERSION);
+		(void) ArMapFileDetach(dirState);
+		dirState = NULL;
+		return;
+	}
+	Trace(TR_MISC, "Dirstate recovered: %d directories",
+	    dirState->DsCount);
+}
+
+
+/*
+ * Invalidate all entries.
+ * File system events were lost.
+ */
+void
+DirStateInvalidate(void)
+{
+	PthreadMutexLock(&dirStateMutex);
+	if (dirState != NULL) {
+		Trace(TR_MISC, "Dirstate: events lost");
+		newGeneration();
+	}
+	PthreadMutexUnlock(&dirStateMutex);
+}
+
+
+/*
+ * Look up a directory to be scanned.
+ * Enter the directory if not present.
+ * RETURN: TRUE if the entry is from a valid scan.
+ */
+boolean_t
+DirStateLookup(
+	sam_id_t id,
+	sam_ino_t parent,		/* Parent directory, 0 if not known */
+	uint32_t *flags,		/* Flags from the last scan */
+	sam_timestruc_t *change,	/* Change time at the last scan */
+	uint64_t *seq)			/* Sequence for DirStateEnter() */
+{
+	struct DirStateEntry *de;
+	boolean_t valid;
+
+	*flags = 0;
+	*seq = 0;
+	PthreadMutexLock(&dirStateMutex);
+	if (dirState == NULL) {
+		PthreadMutexUnlock(&dirStateMutex);
+		return (FALSE);
+	}
+	*seq = dirState->DsSeq;
+	de = findEntry(id.ino);
+	if (de->DeId.ino == 0 &&
+	    (dirState->DsCount + 1) * 4 > dirState->DsSize * 3) {
+		growDirState();
+		de = findEntry(id.ino);
+	}
+	if (de->DeId.ino == 0 || de->DeId.gen != id.gen) {
+		if (de->DeId.ino == 0) {
+			dirState->DsCount++;
+		}
+		memset(de, 0, sizeof (struct DirStateEntry));
+		de->DeId = id;
+	}
+	if (parent != 0) {
+		de->DeParent = parent;
+	}
+	valid = (de->DeGen == dirState->DsGen);
+	if (valid) {
+		*flags = de->DeFlags;
+		*change = de->DeChange;
+	}
+	PthreadMutexUnlock(&dirStateMutex);
+	return (valid);
+}
+
+
+/*
+ * Remove inode.
+ */
+void
+DirStateRmInode(
+	sam_id_t id)
+{
+	struct DirStateEntry *de;
+
+	PthreadMutexLock(&dirStateMutex);
+	if (dirState != NULL) {
+		de = findEntry(id.ino);
+		if (de->DeId.ino != 0) {
+			removeEntry(de);
+		}
+	}
+	PthreadMutexUnlock(&dirStateMutex);
+}
+
+
+/*
+ * Trace directory state.
+ */
+void
+DirStateTrace(void)
+{
+	FILE	*st;
+
+	if ((st = TraceOpen()) == NULL) {
+		return;
+	}
+	PthreadMutexLock(&dirStateMutex);
+	if (dirState != NULL) {
+		fprintf(st, "Dirstate count: %d size: %d generation: %u\n",
+		    dirState->DsCount, dirState->DsSize, dirState->DsGen);
+		fprintf(st, "Dirstate changes: %llu full scan: %s\n",
+		    (unsigned long long)dirState->DsSeq,
+		    TimeToIsoStr(dirState->DsFullScan, ts));
+	}
+	PthreadMutexUnlock(&dirStateMutex);
+	TraceClose(INT_MAX);
+}
+
+
+/* Private functions. */
+
+
+/*
+ * Create an empty directory state.
+ * Directory state mutex locked on entry by caller.
+ */
+static void
+createDirState(void)
+{
+	dirState = MapFileCreate(DIRSTATE, DIRSTATE_MAGIC,
+	    sizeof (struct DirState) +
+	    (DIRSTATE_START - 1) * sizeof (struct DirStateEntry));
+	if (dirState == NULL) {
+		LibFatal(create, DIRSTATE);
+	}
+	dirState->DsVersion = DIRSTATE_VERSION;
+	dirState->DsCount = 0;
+	dirState->DsSize = DIRSTATE_START;
+	dirState->DsGen = 1;
+	dirState->DsProps = 0;
+	dirState->DsFullScan = 0;
+	dirState->DsSeq = 0;
+	dirState->DsGenSeq = 0;
+	memset(dirState->DsEntry, 0,
+	    DIRSTATE_START * sizeof (struct DirStateEntry));
+	dirState->Ds.MfValid = 1;
+	Trace(TR_MISC, "Dirstate created: %u", dirState->Ds.MfLen);
+}
+
+
+/*
+ * Find the entry for an inode.
+ * RETURN: The entry, or the unused entry at which to enter the inode.
+ */
+static struct DirStateEntry *
+findEntry(
+	sam_ino_t ino)
+{
+	int	i;
+
+	for (i = DE_HASH(ino); /* Terminated inside */;
+	    i = (i + 1) & (dirState->DsSize - 1)) {
+		struct DirStateEntry *de;
+
+		de = &dirState->DsEntry[i];
+		if (de->DeId.ino == ino || de->DeId.ino == 0) {
+			return (de);
+		}
+	}
+	/* NOTREACHED */
+}
+
+
+/*
+ * Double the size of the table.
+ * Entries from earlier generations are not entered again.
+ */
+static void
+growDirState(void)
+{
+	struct DirStateEntry *old;
+	size_t	size;
+	int	oldSize;
+	int	i;
+
+	oldSize = dirState->DsSize;
+	size = oldSize * sizeof (struct DirStateEntry);
+	SamMalloc(old, size);
+	memmove(old, dirState->DsEntry, size);
+	dirState = MapFileGrow(dirState, size);
+	if (dirState == NULL) {
+		LibFatal(MapFileGrow, DIRSTATE);
+	}
+	dirState->DsSize = oldSize * 2;
+	dirState->DsCount = 0;
+	memset(dirState->DsEntry, 0, 2 * size);
+	for (i = 0; i < oldSize; i++) {
+		struct DirStateEntry *de;
+
+		if (old[i].DeId.ino == 0 || old[i].DeGen != dirState->DsGen) {
+			continue;
+		}
+		de = findEntry(old[i].DeId.ino);
+		*de = old[i];
+		dirState->DsCount++;
+	}
+	SamFree(old);
+	dirState->Ds.MfValid = 1;
+	Trace(TR_MISC, "Dirstate size: %d count: %d",
+	    dirState->DsSize, dirState->DsCount);
+}
+
+
+/*
+ * Start a new generation.
+ * All entries become invalid, including those of a scan in progress.
+ */
+static void
+newGeneration(void)
+{
+	dirState->DsGen++;
+	if (dirState->DsGen == 0) {
+		dirState->DsGen = 1;
+	}
+	dirState->DsSeq++;
+	dirState->DsGenSeq = dirState->DsSeq;
+	dirState->DsFullScan = 0;
+}
+
+
+/*
+ * Compute the signature of the file properties.
+ * The reconfiguration flags are not part of the signature.
+ */
+static uint32_t
+propsSignature(void)
+{
+	uint32_t sig;
+	int	i;
+
+	sig = 2166136261U;
+	sig = (sig ^ (State->AfFlags & ASF_archivemeta)) * 16777619U;
+	for (i = 0; i < FileProps->FpCount; i++) {
+		struct FilePropsEntry *fp;
+		uchar_t	*p, *pe;
+
+		fp = &FileProps->FpEntry[i];
+		sig = (sig ^ (fp->FpFlags & ~(FP_add | FP_change))) *
+		    16777619U;
+		p = (uchar_t *)&fp->FpBaseAsn;
+		pe = (uchar_t *)&fp->FpRegexp;
+		while (p < pe) {
+			sig = (sig ^ *p++) * 16777619U;
+		}
+	}
+	return (sig);
+}
+
+
+/*
+ * Remove an entry.
+ * Move the entries that follow it in the probe sequence to fill the gap.
+ */
+static void
+removeEntry(
+	struct DirStateEntry *de)
+{
+	int	mask;
+	int	i, j;
+
+	mask = dirState->DsSize - 1;
+	i = de - &dirState->DsEntry[0];
+	j = i;
+	for (;;) {
+		int	k;
+
+		memset(&dirState->DsEntry[i], 0, sizeof (struct DirStateEntry));
+		for (;;) {
+			j = (j + 1) & mask;
+			if (dirState->DsEntry[j].DeId.ino == 0) {
+				dirState->DsCount--;
+				return;
+			}
+			k = DE_HASH(dirState->DsEntry[j].DeId.ino);
+
+			/*
+			 * Move the entry if its home is not between the gap
+			 * and its position.
+			 */
+			if (i <= j) {
+				if (k <= i || k > j) {
+					break;
+				}
+			} else if (k <= i && k > j) {
+				break;
+			}
+		}
+		dirState->DsEntry[i] = dirState->DsEntry[j];
+		i = j;
+	}
+}
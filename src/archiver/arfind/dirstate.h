@@ -0,0 +1,77 @@
+/*
+ * dirstate.h - Arfind directory state definitions.
+ */
+
+/*
+ *    SAM-QFS_notice_begin
+ *
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at pkg/OPENSOLARIS.LICENSE
+ * or https://illumos.org/license/CDDL.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at pkg/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+/*
+ * Copyright 2009 Sun Microsystems, Inc.  All rights reserved.
+ * Use is subject to license terms.
+ *
+ *    SAM-QFS_notice_end
+ */
+
+#ifndef DIRSTATE_H
+#define	DIRSTATE_H
+
+#pragma ident "$Revision: 1.1 $"
+
+/* Macros. */
+#define	DIRSTATE_MAGIC 0531061017	/* Dirstate file magic number */
+#define	DIRSTATE_VERSION 61019		/* Dirstate file version (YMMDD) */
+
+/*
+ * The directory state.
+ * A memory mapped file.
+ * The result of the last scan of each directory, hashed by inode number.
+ * An entry is valid if its DeGen is DsGen.  DsSeq counts the directory
+ * changes reported by file system events.  DeSeq and DeSubSeq are the
+ * DsSeq of the last change in and below the directory.
+ */
+struct DirState {
+	MappedFile_t Ds;
+	int	DsVersion;		/* Version */
+	int	DsCount;		/* Number of entries used */
+	int	DsSize;			/* Number of entries, a power of 2 */
+	uint32_t DsGen;			/* Generation of the valid entries */
+	uint32_t DsProps;		/* Signature of the file properties */
+	sam_time_t DsFullScan;		/* Time of last scan of all dirs */
+	uint64_t DsSeq;			/* Directory changes reported */
+	uint64_t DsGenSeq;		/* DsSeq when DsGen advanced */
+
+	struct DirStateEntry {
+		sam_id_t DeId;		/* Directory, ino 0 if unused */
+		sam_ino_t DeParent;	/* Parent directory */
+		sam_timestruc_t DeChange; /* Directory change time */
+		uint32_t DeGen;		/* DsGen when scanned */
+		uint32_t DeFlags;
+		uint64_t DeSeq;		/* Last change in the directory */
+		uint64_t DeSubSeq;	/* Last change below the directory */
+	} DsEntry[1];
+};
+
+/* Flags. */
+#define	DE_clean	0x0001		/* No file needed examination */
+#define	DE_subclean	0x0002		/* Nor in any directory below */
+
+#endif /* DIRSTATE_H */
@@ -230,6 +230,9 @@ ExamInodes(
 				    fileEventNames[event], flags);
 #endif /* defined(FILE_TRACE) */
 
+				/* The directory must be scanned again. */
+				DirStateChanged(dinode->parent_id);
+
 				/* Done if archdone already set. */
 				if (dinode->status.b.archdone) {
 					if (event != AE_rename &&
@@ -188,6 +188,7 @@ FsAct(void)
 		    (long)bf->BfEvents, args.AfCount, args.AfOverflow);
 
 		if (args.AfOverflow != 0) {
+			DirStateInvalidate();
 			ScanfsFullScan();
 		}
 		State->AfFsactEvents += args.AfCount;
@@ -311,6 +312,7 @@ FsExamine(
 						ArchiveRmInode(ev->AeId);
 						IdToPathRmInode(ev->AeId);
 						ScanfsRmInode(ev->AeId);
+						DirStateRmInode(ev->AeId);
 						if (event == AE_remove) {
 							continue;
 						}
@@ -36,6 +36,7 @@
 static char *_SrcFile = __FILE__;   /* Using __FILE__ makes duplicate strings */
 
 /* ANSI C headers. */
+#include <errno.h>
 #include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -53,10 +54,13 @@ static char *_SrcFile = __FILE__;   /* Using __FILE__ makes duplicate strings */
 #include "arfind.h"
 #include "dir_inode.h"
 
+/* Private data. */
+static pthread_mutex_t statsMutex = PTHREAD_MUTEX_INITIALIZER;
+
 
 /*
  * Count each file by type.
- * Called from the file system scanners.
+ * Called from the file system scanners, which may run several threads.
  */
 void
 FsstatsCountFile(
@@ -77,6 +81,7 @@ FsstatsCountFile(
 	    dinode->id.gen);
 #endif /* defined(FILE_TRACE) */
 
+	PthreadMutexLock(&statsMutex);
 	if (S_ISSEGI(dinode)) {
 		static struct sam_ioctl_idseginfo ss;
 		struct sam_perm_inode dsPinode;
@@ -158,6 +163,7 @@ FsstatsCountFile(
 	default:
 		break;
 	}
+	PthreadMutexUnlock(&statsMutex);
 }
 
 
@@ -2,6 +2,9 @@
  * scandirs.c - Scan directories.
  *
  * Scan a filesystem by traversing directory trees.
+ * The directories found are placed on a work stack that is shared by a
+ * set of scanning threads.  The directory state is used to avoid
+ * examining the files of directories that have not changed.
  */
 
 /*
@@ -56,6 +59,7 @@ static char *_SrcFile = __FILE__;   /* Using __FILE__ makes duplicate strings */
 #include <sys/types.h>
 #include <dirent.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <sys/stat.h>
 
@@ -66,28 +70,56 @@ static char *_SrcFile = __FILE__;   /* Using __FILE__ makes duplicate strings */
 #include "arfind.h"
 #include "dir_inode.h"
 
-/* Private data. */
-static char *baseName;		/* Position in path buffer of base name */
-static struct PathBuffer pathBuf, *pb = &pathBuf;
+/* Macros. */
+#define	SCAN_THREADS 8		/* Threads scanning a directory tree */
 
 /*
- * Directory entry stack.
- * Directory entries for the directories found in the directory being scanned
- * are stacked and then removed for the recursive directory scan.
+ * A directory to be scanned.
+ * A directory is done when it and all directories found in it are done.
  */
-static char *dirEnts = NULL;	/* Unprocessed directory directory entries */
-static int dirEntsSize = 0;	/* Current size of dirEnts */
+struct DirWork {
+	struct DirWork *DwNext;		/* Next on the work stack */
+	struct DirWork *DwParent;	/* Directory in which it was found */
+	sam_id_t DwId;
+	sam_timestruc_t DwChange;	/* Change time when read */
+	uint64_t DwSeq;			/* Directory state change sequence */
+	int	DwBusy;			/* Self + directories not done */
+	boolean_t DwClean;		/* No file below needed examination */
+	boolean_t DwSelfClean;		/* No file in it needed examination */
+	boolean_t DwEnter;		/* Enter result in directory state */
+	boolean_t DwNoCache;		/* Not in the directory state */
+	char	DwPath[1];		/* Path relative to mount point */
+};
 
-/* Inode stat information. */
-static struct sam_perm_inode pinode;
-static struct sam_disk_inode *dinode = (struct sam_disk_inode *)&pinode;
+/*
+ * A scanning thread.
+ */
+static struct Scanner {
+	pthread_t SrThread;
+	struct PathBuffer SrPb;
+	struct sam_perm_inode SrPinode;	/* Inode stat information */
+	struct DirRead SrDr;
+	int	SrScanned;		/* Directories read */
+	int	SrUnchanged;		/* Directories not entered */
+	int	SrSkipped;		/* Directories, files not examined */
+} scanners[SCAN_THREADS];
 
-static int maxDirEntsSize = 0;	/* Maximum size of dirEnts */
+/* Private data. */
+static pthread_cond_t workWait = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t workMutex = PTHREAD_MUTEX_INITIALIZER;
+static struct DirWork *workStack;	/* Directories to scan */
+static int workActive;			/* Directories being scanned */
+static boolean_t workStop;		/* Scan interrupted */
+static boolean_t useState;		/* Skip unchanged directories */
+static struct ScanListEntry *scanSe;	/* The scan being performed */
 
 /* Private functions. */
-static void addDirent(sam_dirent_t *dp);
-static int scanDir(sam_dirent_t *dp, struct ScanListEntry *se);
-static boolean_t isNoarchDir(char *dirPath);
+static void dirDone(struct DirWork *dw, boolean_t selfClean);
+static struct DirWork *newWork(struct DirWork *parent, sam_id_t id,
+	char *path, char *name);
+static void scanDir(struct Scanner *sr, struct DirWork *dw);
+static void *scanThread(void *arg);
+static void scanWork(struct Scanner *sr);
 
 
 /*
@@ -98,8 +130,15 @@ void
 ScanDirs(
 	struct ScanListEntry *se)
 {
-	static struct sam_dirent dp;
+	struct Scanner *sr = &scanners[0];
+	struct sam_disk_inode *dinode;
+	struct PathBuffer *pb;
+	int	scanned, unchanged, skipped;
+	int	threads;
+	int	i;
 
+	pb = &sr->SrPb;
+	dinode = (struct sam_disk_inode *)&sr->SrPinode;
 	if (se->SeId.ino == SAM_ROOT_INO) {
 		struct ScanListEntry seAdd;
 
@@ -109,41 +148,76 @@ ScanDirs(
 		 */
 		pb->PbEnd = pb->PbPath;
 		*pb->PbPath = '\0';
-		if (GetPinode(se->SeId, &pinode) != 0) {
+		if (GetPinode(se->SeId, &sr->SrPinode) != 0) {
 			return;
 		}
 		memset(&seAdd, 0, sizeof (seAdd));
 		seAdd.SeFlags = se->SeFlags & SE_request;
 		seAdd.SeTime = TIME32_MAX;
 		EXAM_MODE(dinode) = EXAM_DIR;
-		(void) CheckFile(pb, &pinode, &seAdd);
+		(void) CheckFile(pb, &sr->SrPinode, &seAdd);
 		if (seAdd.SeTime != TIME32_MAX) {
 			ScanfsAddEntry(&seAdd);
 		}
 	}
 
-	/*
-	 * Reset directory stack.
-	 */
-	dirEntsSize = 0;
 	IdToPathId(se->SeId, pb);
 	Trace(TR_FILES, "Scan %s", ScanPathToMsg(pb->PbPath));
 #if defined(SCAN_TRACE)
 	Trace(TR_DEBUG, "Scanning %s %d.%d", ScanPathToMsg(pb->PbPath),
 	    se->SeId.ino, se->SeId.gen);
 #endif /* defined(SCAN_TRACE) */
-	baseName = pb->PbEnd;
-	dp.d_id = se->SeId;
 
-	if (scanDir(&dp, se) != 0) {
+	/*
+	 * Start the scan with the selected directory.
+	 */
+	scanSe = se;
+	useState = DirStateScanBegin(se);
+	workStop = FALSE;
+	workActive = 0;
+	workStack = newWork(NULL, se->SeId, pb->PbPath, NULL);
+	for (i = 0; i < SCAN_THREADS; i++) {
+		scanners[i].SrScanned = 0;
+		scanners[i].SrUnchanged = 0;
+		scanners[i].SrSkipped = 0;
+	}
+
+	/*
+	 * Only a directory tree is worth more threads.
+	 */
+	threads = (se->SeFlags & SE_subdir) ? SCAN_THREADS : 1;
+	for (i = 1; i < threads; i++) {
+		errno = pthread_create(&scanners[i].SrThread, NULL, scanThread,
+		    &scanners[i]);
+		if (errno != 0) {
+			LibFatal(pthread_create, "scanThread");
+		}
+	}
+	scanWork(sr);
+	for (i = 1; i < threads; i++) {
+		(void) pthread_join(scanners[i].SrThread, NULL);
+	}
+
+	scanned = unchanged = skipped = 0;
+	for (i = 0; i < threads; i++) {
+		scanned += scanners[i].SrScanned;
+		unchanged += scanners[i].SrUnchanged;
+		skipped += scanners[i].SrSkipped;
+	}
+	DirStateScanEnd(se, !workStop && unchanged == 0 && skipped == 0);
+	if ((se->SeFlags & SE_stats) && (workStop || unchanged != 0 ||
+	    skipped != 0)) {
 		/*
-		 * Interrupted.
+		 * Not all files were counted.
 		 */
+		State->AfStatsScan.total.numof = -1;
+	}
+	Trace(TR_MISC, "Scanned %d directories, %d unchanged, %d clean",
+	    scanned, unchanged, skipped);
 #if defined(SCAN_TRACE)
+	if (workStop) {
 		Trace(TR_DEBUG, "Interrupted - %s", ScanPathToMsg(pb->PbPath));
-#endif /* defined(SCAN_TRACE) */
 	}
-#if defined(SCAN_TRACE)
 	Trace(TR_DEBUG, "Scan finished");
 #endif /* defined(SCAN_TRACE) */
 }
@@ -155,17 +229,26 @@ ScanDirs(
 void
 ScanDirsInit(void)
 {
-	int	l;
+	int	i;
 
 	/*
-	 * Construct path for file action.
+	 * Construct path for file action for each scanner.
 	 * Place string terminator at beginning of buffer.
 	 */
-	pb->PbPath = pb->PbBuf;
-	l = strlen(MntPoint);
-	strncpy(pb->PbPath, MntPoint, sizeof (pb->PbBuf)-2);
-	pb->PbPath += l;
-	*pb->PbPath++ = '/';
+	for (i = 0; i < SCAN_THREADS; i++) {
+		struct PathBuffer *pb;
+		int	l;
+
+		pb = &scanners[i].SrPb;
+		pb->PbPath = pb->PbBuf;
+		l = strlen(MntPoint);
+		strncpy(pb->PbPath, MntPoint, sizeof (pb->PbBuf)-2);
+		pb->PbPath += l;
+		*pb->PbPath++ = '/';
+		*pb->PbPath = '\0';
+		pb->PbEnd = pb->PbPath;
+	}
+	DirStateInit();
 }
 
 
@@ -173,57 +256,170 @@ ScanDirsInit(void)
 
 
 /*
- * Recursively scan a directory.
- * Save each directory entry, and process at the end.
- * Skip directories until previous sub-directory reached.
- * RETURN: 1 if interrupted, 0 if normal exit.
+ * A directory is done.
+ * Enter the result for it, and for the directories above it that are
+ * now done.
+ */
+static void
+dirDone(
+	struct DirWork *dw,
+	boolean_t selfClean)
+{
+	PthreadMutexLock(&workMutex);
+	dw->DwSelfClean = selfClean;
+	if (!selfClean) {
+		dw->DwClean = FALSE;
+	}
+	while (dw != NULL && --dw->DwBusy == 0) {
+		struct DirWork *parent;
+
+		if (dw->DwEnter) {
+			uint32_t flags;
+
+			flags = 0;
+			if (dw->DwSelfClean) {
+				flags |= DE_clean;
+				if (dw->DwClean) {
+					flags |= DE_subclean;
+				}
+			}
+			DirStateEnter(dw->DwId, dw->DwChange, flags, dw->DwSeq);
+		}
+		parent = dw->DwParent;
+		if (parent != NULL && !dw->DwClean) {
+			parent->DwClean = FALSE;
+		}
+		SamFree(dw);
+		dw = parent;
+	}
+	PthreadMutexUnlock(&workMutex);
+}
+
+
+/*
+ * Make the work for a directory.
+ */
+static struct DirWork *
+newWork(
+	struct DirWork *parent,
+	sam_id_t id,
+	char *path,		/* Path of the directory or its parent */
+	char *name)		/* Name in parent, NULL if path is the dir */
+{
+	struct DirWork *dw;
+	size_t	size;
+
+	size = sizeof (struct DirWork) + strlen(path) + 1;
+	if (name != NULL) {
+		size += strlen(name);
+	}
+	SamMalloc(dw, size);
+	memset(dw, 0, sizeof (struct DirWork));
+	dw->DwParent = parent;
+	dw->DwId = id;
+	dw->DwBusy = 1;
+	dw->DwClean = TRUE;
+	dw->DwSelfClean = TRUE;
+	if (name == NULL) {
+		strcpy(dw->DwPath, path);
+	} else if (*path == '\0') {
+		strcpy(dw->DwPath, name);
+	} else {
+		snprintf(dw->DwPath, size - offsetof(struct DirWork, DwPath),
+		    "%s/%s", path, name);
+	}
+	if (parent != NULL) {
+		dw->DwNoCache = parent->DwNoCache;
+	}
+	return (dw);
+}
+
+
+/*
+ * Scan a directory.
+ * Examine the files in it, and add the directories found to the work
+ * stack.
  */
-static int
+static void
 scanDir(
-	sam_dirent_t *dpScan,	/* Directory to scan */
-	struct ScanListEntry *se)
+	struct Scanner *sr,
+	struct DirWork *dw)
 {
-	static struct DirRead dr;
+	struct DirRead *dr = &sr->SrDr;
+	struct PathBuffer *pb = &sr->SrPb;
+	struct sam_perm_inode *pinode = &sr->SrPinode;
+	struct sam_disk_inode *dinode = (struct sam_disk_inode *)pinode;
+	struct ScanListEntry *se = scanSe;
 	struct ScanListEntry seAdd;
+	struct DirWork *found;
+	sam_timestruc_t change;
 	sam_dirent_t *dp;
-	size_t	dirEntsMark;
-	size_t	next;
 	boolean_t rootDir;
-	char	*baseNameMark;
+	boolean_t selfClean;
+	boolean_t skipFiles;
+	boolean_t valid;
+	uint32_t flags;
+	char	*baseName;
 
-	if (Exec != ES_run && !(se->SeFlags & SE_request)) {
-		return (1);
+	/*
+	 * Look up the result of the last scan.
+	 */
+	valid = DirStateLookup(dw->DwId,
+	    (dw->DwParent != NULL) ? dw->DwParent->DwId.ino : 0,
+	    &flags, &change, &dw->DwSeq);
+	if (!valid) {
+		/*
+		 * Nothing is known below a new or moved directory.
+		 */
+		dw->DwNoCache = TRUE;
+	}
+	dw->DwEnter = TRUE;
+	if (!useState || dw->DwNoCache) {
+		flags = 0;
+	}
+	if ((flags & DE_subclean) &&
+	    GetDinode(dw->DwId, dinode) == 0 &&
+	    dinode->change_time.tv_sec == change.tv_sec &&
+	    dinode->change_time.tv_nsec == change.tv_nsec) {
+		/*
+		 * Nothing changed in or below the directory.
+		 */
+		sr->SrUnchanged++;
+		dw->DwEnter = FALSE;
+		dirDone(dw, TRUE);
+		return;
 	}
 
 	/*
 	 * Begin the directory read.
 	 */
-	if (OpenDir(dpScan->d_id, dinode, &dr) < 0) {
-		return (0);
+	strcpy(pb->PbPath, dw->DwPath);
+	baseName = pb->PbPath + strlen(pb->PbPath);
+	pb->PbEnd = baseName;
+	if (OpenDir(dw->DwId, dinode, dr) < 0) {
+		dw->DwEnter = FALSE;
+		dirDone(dw, FALSE);
+		return;
 	}
 
 	if ((se->SeFlags & SE_noarch) && dinode->status.b.noarch) {
-		Trace(TR_DEBUG, "Skipping -n %s%s", pb->PbPath, dpScan->d_name);
-		(void) close(dr.DrFd);
-		return (0);
+		Trace(TR_DEBUG, "Skipping -n %s", pb->PbPath);
+		(void) close(dr->DrFd);
+		dw->DwEnter = FALSE;
+		dirDone(dw, TRUE);
+		return;
 	}
 
-	/*
-	 * Extend the full path.
-	 */
-	baseNameMark = baseName;
-	rootDir = (dpScan->d_id.ino == SAM_ROOT_INO);
+	rootDir = (dw->DwId.ino == SAM_ROOT_INO);
 	if (!rootDir) {
-		memmove(baseName, dpScan->d_name, dpScan->d_namlen);
-		baseName += dpScan->d_namlen;
-		*baseName = '\0';
 		if (!(State->AfFlags & ASF_archivemeta) &&
 		    (se->SeFlags & SE_noarch) &&
-		    isNoarchDir(pb->PbPath)) {
+		    ClassifyNoarchDir(pb->PbPath)) {
 			Trace(TR_DEBUG, "Skipping noarch %s", pb->PbPath);
-			baseName = baseNameMark;
-			(void) close(dr.DrFd);
-			return (0);
+			(void) close(dr->DrFd);
+			dw->DwEnter = FALSE;
+			dirDone(dw, TRUE);
+			return;
 		}
 #if defined(FILE_TRACE)
 		Trace(TR_DEBUG, "Scanning %s", pb->PbPath);
@@ -234,17 +430,30 @@ scanDir(
 	} else {
 		PostOprMsg(4357, ".");
 	}
+	sr->SrScanned++;
+
+	/*
+	 * The files need not be examined if the directory is unchanged
+	 * and none of them needed examination.
+	 */
+	dw->DwChange = dinode->change_time;
+	skipFiles = ((flags & DE_clean) &&
+	    dinode->change_time.tv_sec == change.tv_sec &&
+	    dinode->change_time.tv_nsec == change.tv_nsec);
+	if (skipFiles) {
+		sr->SrSkipped++;
+	}
 
 	/*
-	 * Mark the directory entry stack.
 	 * Initialize worklist entry.
 	 */
-	dirEntsMark = dirEntsSize;
+	found = NULL;
+	selfClean = TRUE;
 	memset(&seAdd, 0, sizeof (seAdd));
 	seAdd.SeFlags = se->SeFlags & SE_request;
-	seAdd.SeId = dpScan->d_id;
+	seAdd.SeId = dw->DwId;
 	seAdd.SeTime = TIME32_MAX;
-	while ((dp = GetDirent(&dr)) != NULL) {
+	while ((dp = GetDirent(dr)) != NULL) {
 		char	*name;
 
 		name = (char *)dp->d_name;
@@ -269,14 +478,28 @@ scanDir(
 				continue;
 			}
 		}
-		if (S_ISDIR(dp->d_fmt)) {
-			if (se->SeFlags & SE_subdir) {
-				addDirent(dp);
-			}
-			if (!(State->AfFlags & ASF_archivemeta)) {
-				continue;
+		if (S_ISDIR(dp->d_fmt) && (se->SeFlags & SE_subdir)) {
+			if ((Ptrdiff(baseName, pb->PbPath) + dp->d_namlen) >=
+			    MAXPATHLEN) {
+				Trace(TR_DEBUGERR,
+				    "inode %d: pathname too long",
+				    dp->d_id.ino);
+				selfClean = FALSE;
+			} else {
+				struct DirWork *dwAdd;
+
+				dwAdd = newWork(dw, dp->d_id, dw->DwPath, name);
+				dwAdd->DwNext = found;
+				found = dwAdd;
 			}
 		}
+		if (skipFiles) {
+			continue;
+		}
+		if (S_ISDIR(dp->d_fmt) &&
+		    !(State->AfFlags & ASF_archivemeta)) {
+			continue;
+		}
 
 		/*
 		 * Append name to end of directory path.
@@ -288,7 +511,7 @@ scanDir(
 			 * Only send message and set archdone if
 			 * archdone not set.
 			 */
-			if (GetPinode(dp->d_id, &pinode) != 0) {
+			if (GetPinode(dp->d_id, pinode) != 0) {
 				if (FsFd < 0) {
 					break;
 				}
@@ -307,7 +530,8 @@ scanDir(
 		/*
 		 * Get a copy of the inode.
 		 */
-		if (GetPinode(dp->d_id, &pinode) != 0) {
+		if (GetPinode(dp->d_id, pinode) != 0) {
+			selfClean = FALSE;
 			if (FsFd < 0) {
 				break;
 			}
@@ -318,31 +542,24 @@ scanDir(
 		Trace(TR_DEBUG, "Checking %d.%d %s",
 		    dp->d_id.ino, dp->d_id.gen, pb->PbPath);
 #endif /* defined(FILE_TRACE) */
-		CheckFile(pb, &pinode, &seAdd);
+		CheckFile(pb, pinode, &seAdd);
+		if (!dinode->status.b.archdone &&
+		    !dinode->status.b.noarch && !dinode->status.b.damaged) {
+			selfClean = FALSE;
+		}
 		if (se->SeFlags & SE_stats) {
-			FsstatsCountFile(&pinode, pb->PbPath);
+			FsstatsCountFile(pinode, pb->PbPath);
 		}
 	}
 
 	if (errno != 0) {
 		Trace(TR_DEBUGERR, "readdir(%s)", pb->PbPath);
 	}
-	if (close(dr.DrFd) < 0) {
+	if (close(dr->DrFd) < 0) {
 		Trace(TR_DEBUGERR, "closedir(%s)", pb->PbPath);
 	}
-	if (FsFd < 0) {
-		goto out;
-	}
-
-	/*
-	 * Process all the directories found in this directory.
-	 */
-	for (next = dirEntsMark; next < dirEntsSize; /* Increment inside */) {
-		dp = (sam_dirent_t *)(void *)(dirEnts + next);
-		next += SAM_DIRSIZ(dp);
-		if (scanDir(dp, se) != 0) {
-			return (1);
-		}
+	if (!rootDir) {
+		*(baseName - 1) = '\0';
 	}
 	if (seAdd.SeTime != TIME32_MAX) {
 		/*
@@ -351,104 +568,87 @@ scanDir(
 		 * Avoid scanning the directory too soon.
 		 */
 		seAdd.SeTime = max(seAdd.SeTime, time(NULL) + EPSILON_TIME);
-		if (rootDir) {
-			ScanfsAddEntry(&seAdd);
-		} else {
-			*(baseName - 1)  = '\0';
-			ScanfsAddEntry(&seAdd);
-		}
+		ScanfsAddEntry(&seAdd);
+		selfClean = FALSE;
 	}
 
 	/*
-	 * Remove this directory from the path.
+	 * Add the directories found to the work stack.
 	 */
-out:
-	dirEntsSize = dirEntsMark;
-	baseName = baseNameMark;
-	*baseName = '\0';
-	return (FsFd < 0);
+	if (found != NULL) {
+		PthreadMutexLock(&workMutex);
+		while (found != NULL) {
+			struct DirWork *next;
+
+			next = found->DwNext;
+			found->DwNext = workStack;
+			workStack = found;
+			dw->DwBusy++;
+			found = next;
+		}
+		(void) pthread_cond_broadcast(&workWait);
+		PthreadMutexUnlock(&workMutex);
+	}
+	dirDone(dw, selfClean);
 }
 
 
-
 /*
- * Add a directory entry to the stack
+ * Thread - Scan directories.
  */
-static void
-addDirent(
-	sam_dirent_t *dp)
+static void *
+scanThread(
+	void *arg)
 {
-	static int dirEntsAlloc = 0;
-	int	len;
-
-	len = SAM_DIRSIZ(dp);
-	if (dirEntsSize + len >= dirEntsAlloc) {
-		/*
-		 * No room in table for entry.  Reallocate space for enlarged
-		 * stack.
-		 */
-		dirEntsAlloc += 4096;
-		SamRealloc(dirEnts, dirEntsAlloc);
-	}
-	memmove(&dirEnts[dirEntsSize], dp, len);
-	dirEntsSize += len;
-	if (dirEntsSize > maxDirEntsSize) {
-		maxDirEntsSize = dirEntsSize;
-	}
+	scanWork((struct Scanner *)arg);
+	return (NULL);
 }
 
 
 /*
- * Determine if a directory is no_archive.
+ * Scan directories from the work stack until all are done.
  */
-boolean_t
-isNoarchDir(
-	char *dirPath)
+static void
+scanWork(
+	struct Scanner *sr)
 {
-	struct FilePropsEntry *fp;
-	int	i;
+	PthreadMutexLock(&workMutex);
+	for (;;) {
+		struct DirWork *dw;
+		boolean_t stop;
 
-	for (i = 1; i < FileProps->FpCount; i++) {
-		/*
-		 * Compare the directory path to the file properties path.
-		 * An empty file properties path will match all directories.
-		 */
-		fp = &FileProps->FpEntry[i];
-		if (fp->FpPathSize != 0) {
-			char	*pp, *dp;
-
-			dp = dirPath;
-			if (dp[fp->FpPathSize] != '\0' &&
-			    dp[fp->FpPathSize] != '/') {
-				continue;
-			}
-			pp = fp->FpPath;
-			while (*pp != '\0' && *pp == *dp) {
-				pp++;
-				dp++;
-			}
-			if ((*pp != '\0' && *pp != '/') ||
-			    (*dp != '\0' && *dp != '/')) {
-				continue;
-			}
+		while (workStack == NULL && workActive != 0) {
+			PthreadCondWait(&workWait, &workMutex);
+		}
+		if (workStack == NULL) {
+			break;
+		}
+		dw = workStack;
+		workStack = dw->DwNext;
+		workActive++;
+		if ((Exec != ES_run && !(scanSe->SeFlags & SE_request)) ||
+		    FsFd < 0) {
+			workStop = TRUE;
+		}
+		stop = workStop;
+		PthreadMutexUnlock(&workMutex);
 
+		if (stop) {
 			/*
-			 * Directory matches first part of path
-			 * of files to be archived.
+			 * Interrupted.
+			 * Discard the directory.
 			 */
-			if (fp->FpFlags & FP_props) {
-				/*
-				 * Have to examine files in directory.
-				 */
-				return (FALSE);
-			}
-			break;
-		} else if (!(fp->FpFlags & FP_props)) {
-			break;
+			dw->DwEnter = FALSE;
+			dirDone(dw, FALSE);
+		} else {
+			scanDir(sr, dw);
+		}
+
+		PthreadMutexLock(&workMutex);
+		workActive--;
+		if (workActive == 0 && workStack == NULL) {
+			(void) pthread_cond_broadcast(&workWait);
 		}
 	}
-	if (i < FileProps->FpCount && (fp->FpFlags & FP_noarch)) {
-		return (TRUE);
-	}
-	return (FALSE);
+	PthreadMutexUnlock(&workMutex);
 }
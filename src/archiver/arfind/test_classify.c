@@ -0,0 +1,695 @@
+/*
+ * test_classify.c - differential test of the compiled ClassifyFile().
+ *
+ * Random file properties and files are classified by ClassifyFile() and
+ * by the linear walk of all the file properties that it replaced.  Both
+ * must select the same file properties and leave the same inode times.
+ * ClassifyNoarchDir() is checked on fixed no_archive and archived
+ * directories, and against a linear walk for the random rules.
+ *
+ * usage: test_classify [rulesets [seed]]
+ */
+
+/*
+ *    SAM-QFS_notice_begin
+ *
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at pkg/OPENSOLARIS.LICENSE
+ * or https://illumos.org/license/CDDL.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at pkg/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+/*
+ * Copyright 2009 Sun Microsystems, Inc.  All rights reserved.
+ * Use is subject to license terms.
+ *
+ *    SAM-QFS_notice_end
+ */
+
+#pragma ident "$Revision: 1.1 $"
+
+static char *_SrcFile = __FILE__;   /* Using __FILE__ makes duplicate strings */
+
+/* ANSI C headers. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* POSIX headers. */
+#include <sys/types.h>
+#include <sys/stat.h>
+
+/* Solaris headers. */
+#include <libgen.h>
+
+/* Local headers. */
+#define	DEC_INIT
+#include "arfind.h"
+#include "dir_inode.h"
+#if defined(lint)
+#include "sam/lint.h"
+#endif /* defined(lint) */
+
+/* Macros. */
+#define	FILES_PER_SET 200	/* Files classified for each rule set */
+#define	MAX_RULES 24		/* Most file properties in a set */
+#define	NOW 1000000000		/* TIME_NOW() of the inodes */
+
+/*
+ * Rule paths and file path components.  Prefixes of each other, so
+ * that a rule for "a" must not apply to "ab/x".
+ */
+static char *dirs[] = {
+	"a", "b", "ab", "a/b", "a/bc", "ab/a", "data", "data/tmp",
+	"data/tmp/a"
+};
+static char *names[] = {
+	"a", "b", "ab", "x", "xy", "xxc", "core", "f.c", "f.o", "tmp",
+	"data", "y+y"
+};
+
+/*
+ * -name expressions in regcmp(3C) syntax.  Anchored and unanchored
+ * literals, expressions the literal scan gives up on, and an invalid
+ * expression that ClassifyInit() removes.
+ */
+static char *regexps[] = {
+	"\\.c$", "\\.o$", "^a/", "^a/b/x$", "core$", "x", "tmp/",
+	"^data/tmp/.*\\.o$", "[ab]x*y", "y+", "y\\+y", "a.b", ".*",
+	"(x)$0c", "x{1,2}c", "^ab", "b/", "^[^d]", "xy$", "["
+};
+
+/*
+ * Fixed file properties and directories for ClassifyNoarchDir().
+ */
+static struct {
+	char	*path;
+	uint32_t flags;
+} noarchRules[] = {
+	{ "a/b", 0 },
+	{ "a", FP_noarch },
+	{ "data/tmp", FP_noarch },
+	{ "data", 0 }
+};
+static struct {
+	char	*dir;
+	boolean_t noarch;
+} noarchDirs[] = {
+	{ "a", FALSE },			/* a/b is archived */
+	{ "a/b", FALSE },
+	{ "a/c", TRUE },
+	{ "data", FALSE },
+	{ "data/tmp", TRUE },
+	{ "data/tmp/a", TRUE },
+	{ "data/tmpx", FALSE },
+	{ "x", FALSE }
+};
+
+/* Private data. */
+static struct ArfindState state;
+static long mismatches = 0;
+
+/* Private functions. */
+static struct FilePropsEntry *linearClassify(char *path,
+	struct sam_perm_inode *pinode, sam_time_t *checkTime);
+static boolean_t linearNoarchDir(char *dirPath);
+static void makeDir(char *path);
+static void makeFile(char *path, struct sam_perm_inode *pinode);
+static struct FileProps *makeRules(void);
+static void testNoarchDirs(void);
+static int pick(int n);
+static void printRules(void);
+static int ruleIndex(struct FilePropsEntry *fp);
+
+
+int
+main(
+	int argc,
+	char **argv)
+{
+	long	seed;
+	int	sets;
+	int	s;
+
+	sets = (argc > 1) ? atoi(argv[1]) : 10000;
+	seed = (argc > 2) ? atol(argv[2]) : (long)time(NULL);
+	printf("%d rule sets, seed %ld\n", sets, seed);
+	srand48(seed);
+	State = &state;
+	testNoarchDirs();
+
+	for (s = 0; s < sets && mismatches < 10; s++) {
+		int	f;
+		int	i;
+
+		FileProps = makeRules();
+		ClassifyInit();
+		state.AfExamine = pick(2) ? EM_noscan : EM_scan;
+
+		for (f = 0; f < FILES_PER_SET; f++) {
+			struct sam_perm_inode linear;
+			struct sam_perm_inode compiled;
+			struct FilePropsEntry *fpL;
+			struct FilePropsEntry *fpC;
+			sam_time_t checkL;
+			sam_time_t checkC;
+			char	path[MAXPATHLEN];
+
+			makeFile(path, &linear);
+			compiled = linear;
+			checkL = checkC = NOW + 100000;
+			fpL = linearClassify(path, &linear, &checkL);
+			fpC = ClassifyFile(path, &compiled, &checkC);
+			if (fpL == fpC && checkL == checkC &&
+			    memcmp(&linear, &compiled, sizeof (linear)) == 0) {
+				continue;
+			}
+			printf("\nMismatch, set %d path %s uid %d gid %d\n",
+			    s, path, (int)linear.di.uid, (int)linear.di.gid);
+			printf("  linear   rule %d checkTime %ld\n",
+			    ruleIndex(fpL), (long)checkL);
+			printf("  compiled rule %d checkTime %ld\n",
+			    ruleIndex(fpC), (long)checkC);
+			printRules();
+			mismatches++;
+		}
+
+		for (f = 0; f < FILES_PER_SET; f++) {
+			boolean_t noarchL;
+			boolean_t noarchC;
+			char	path[MAXPATHLEN];
+
+			makeDir(path);
+			noarchL = linearNoarchDir(path);
+			noarchC = ClassifyNoarchDir(path);
+			if (noarchL == noarchC) {
+				continue;
+			}
+			printf("\nMismatch, set %d directory %s\n", s, path);
+			printf("  linear   noarch %d\n", noarchL);
+			printf("  compiled noarch %d\n", noarchC);
+			printRules();
+			mismatches++;
+		}
+
+		for (i = 1; i < FileProps->FpCount; i++) {
+			if (FileProps->FpEntry[i].FpRegexp != NULL) {
+				free(FileProps->FpEntry[i].FpRegexp);
+			}
+		}
+		free(FileProps);
+	}
+	if (mismatches != 0) {
+		printf("FAILED: %ld mismatches\n", mismatches);
+		return (EXIT_FAILURE);
+	}
+	printf("%d rule sets, %d files: OK\n", s, s * FILES_PER_SET);
+	return (EXIT_SUCCESS);
+}
+
+
+/*
+ * Classify a file by walking all the file properties in order.
+ * The regular file part of ClassifyFile() before it was compiled.
+ */
+static struct FilePropsEntry *
+linearClassify(
+	char *path,
+	struct sam_perm_inode *pinode,	/* Permanent inode */
+	sam_time_t *checkTime)
+{
+	struct sam_disk_inode *dinode = (struct sam_disk_inode *)pinode;
+	struct FilePropsEntry *fp;
+	boolean_t accessTimeFixed;
+	int	i;
+
+	accessTimeFixed = FALSE;
+	for (i = 1; i < FileProps->FpCount; i++) {
+		fp = &FileProps->FpEntry[i];
+		if (fp->FpPathSize != 0) {
+			char	*pp, *dp;
+
+			dp = path;
+			if (dp[fp->FpPathSize] != '/') {
+				continue;
+			}
+			pp = fp->FpPath;
+			while (*pp != '\0' && *pp == *dp) {
+				pp++;
+				dp++;
+			}
+			if (*pp != '\0' || *dp != '/') {
+				continue;
+			}
+		}
+		if (!(fp->FpFlags & FP_props)) {
+			break;
+		}
+		if ((fp->FpFlags & FP_name) &&
+		    regex(fp->FpRegexp, path, NULL) == NULL) {
+			continue;
+		}
+		if ((fp->FpFlags & FP_uid) && dinode->uid != fp->FpUid) {
+			continue;
+		}
+		if ((fp->FpFlags & FP_gid) && dinode->gid != fp->FpGid) {
+			continue;
+		}
+		if (fp->FpFlags & FP_minsize) {
+			if (!S_ISSEGS(dinode) &&
+			    dinode->rm.size < fp->FpMinsize) {
+				continue;
+			}
+			if (S_ISSEGS(dinode) &&
+			    *SEGFILE_SIZE(dinode) < fp->FpMinsize) {
+				continue;
+			}
+		}
+		if (fp->FpFlags & FP_maxsize) {
+			if (!S_ISSEGS(dinode) &&
+			    dinode->rm.size >= fp->FpMaxsize) {
+				continue;
+			}
+			if (S_ISSEGS(dinode) &&
+			    *SEGFILE_SIZE(dinode) >= fp->FpMaxsize) {
+				continue;
+			}
+		}
+		if (fp->FpFlags & FP_access) {
+			time_t	accessRef;
+
+			if (!(fp->FpFlags & FP_nftv)) {
+				if (dinode->access_time.tv_sec <
+				    dinode->creation_time) {
+					dinode->access_time.tv_sec =
+					    dinode->creation_time;
+				}
+				if (dinode->access_time.tv_sec >
+				    TIME_NOW(dinode)) {
+					dinode->access_time.tv_sec =
+					    dinode->change_time.tv_sec;
+				}
+				if (dinode->access_time.tv_sec < 0) {
+					dinode->access_time.tv_sec = 0;
+				}
+				accessTimeFixed = TRUE;
+			}
+			accessRef = dinode->access_time.tv_sec + fp->FpAccess;
+			if (accessRef > TIME_NOW(dinode)) {
+				if (State->AfExamine >= EM_noscan &&
+				    accessRef < *checkTime) {
+					*checkTime = accessRef;
+				}
+				continue;
+			}
+		}
+		if (fp->FpFlags & FP_after) {
+			if (dinode->modify_time.tv_sec < fp->FpAfter &&
+			    dinode->creation_time < fp->FpAfter) {
+				continue;
+			}
+		}
+		break;
+	}
+	if (i >= FileProps->FpCount) {
+		return (NULL);
+	}
+	if (fp->FpFlags & FP_noxattrarch && SAM_INODE_IS_XATTR(pinode)) {
+		return (NULL);
+	}
+	if (fp->FpFlags & FP_noarch) {
+		return (fp);
+	}
+	if (fp->FpFlags & FP_default &&
+	    !(FileProps->FpEntry[0].FpFlags & FP_noarch)) {
+		fp = &FileProps->FpEntry[0];
+	}
+	if (!(fp->FpFlags & FP_nftv)) {
+		if (dinode->modify_time.tv_sec < dinode->creation_time) {
+			dinode->modify_time.tv_sec = dinode->creation_time;
+		}
+		if (dinode->modify_time.tv_sec > TIME_NOW(dinode)) {
+			dinode->modify_time.tv_sec = dinode->change_time.tv_sec;
+		}
+		if (dinode->modify_time.tv_sec < 0) {
+			dinode->modify_time.tv_sec = 0;
+		}
+		if (!accessTimeFixed) {
+			if (dinode->access_time.tv_sec <
+			    dinode->modify_time.tv_sec) {
+				dinode->access_time.tv_sec =
+				    dinode->modify_time.tv_sec;
+			}
+			if (dinode->access_time.tv_sec <
+			    dinode->creation_time) {
+				dinode->access_time.tv_sec =
+				    dinode->creation_time;
+			}
+			if (dinode->access_time.tv_sec > TIME_NOW(dinode)) {
+				dinode->access_time.tv_sec =
+				    dinode->change_time.tv_sec;
+			}
+			if (dinode->access_time.tv_sec < 0) {
+				dinode->access_time.tv_sec = 0;
+			}
+		}
+	}
+	return (fp);
+}
+
+
+/*
+ * Determine if a directory is no_archive by walking all the file
+ * properties in order.  The first rule for files in the directory must
+ * be no_archive without search criteria, and no earlier rule for a
+ * path below the directory may archive files.
+ */
+static boolean_t
+linearNoarchDir(
+	char *dirPath)
+{
+	struct FilePropsEntry *fp;
+	size_t	len;
+	int	i;
+	int	j;
+
+	for (i = 1; i < FileProps->FpCount; i++) {
+		fp = &FileProps->FpEntry[i];
+		if (fp->FpPathSize != 0 &&
+		    (strncmp(dirPath, fp->FpPath, fp->FpPathSize) != 0 ||
+		    (dirPath[fp->FpPathSize] != '\0' &&
+		    dirPath[fp->FpPathSize] != '/'))) {
+			continue;
+		}
+		if (fp->FpFlags & FP_props) {
+			if (fp->FpPathSize == 0) {
+				continue;
+			}
+			return (FALSE);
+		}
+		if (!(fp->FpFlags & FP_noarch)) {
+			return (FALSE);
+		}
+		break;
+	}
+	if (i >= FileProps->FpCount) {
+		return (FALSE);
+	}
+
+	len = strlen(dirPath);
+	for (j = 1; j < i; j++) {
+		fp = &FileProps->FpEntry[j];
+		if (fp->FpPathSize > len &&
+		    strncmp(fp->FpPath, dirPath, len) == 0 &&
+		    fp->FpPath[len] == '/' &&
+		    (!(fp->FpFlags & FP_noarch) ||
+		    (fp->FpFlags & FP_props))) {
+			return (FALSE);
+		}
+	}
+	return (TRUE);
+}
+
+
+/*
+ * Make a random directory path.
+ */
+static void
+makeDir(
+	char *path)
+{
+	if (pick(2) == 0) {
+		strcpy(path, dirs[pick(sizeof (dirs) / sizeof (char *))]);
+		return;
+	}
+	strcpy(path, names[pick(sizeof (names) / sizeof (char *))]);
+	if (pick(2) == 0) {
+		strcat(path, "/");
+		strcat(path, names[pick(sizeof (names) / sizeof (char *))]);
+	}
+}
+
+
+/*
+ * Make a random regular file or symbolic link and its path.
+ * Times are around NOW, some of them implausible.
+ */
+static void
+makeFile(
+	char *path,
+	struct sam_perm_inode *pinode)
+{
+	static fsize_t sizes[] = { 0, 1, 999, 1000, 1001, 1048576 };
+	struct sam_disk_inode *dinode = &pinode->di;
+	int	depth;
+	int	i;
+
+	/*
+	 * The linear walk may look past the end of a short path.
+	 */
+	memset(path, 0, MAXPATHLEN);
+	depth = 1 + pick(4);
+	for (i = 0; i < depth; i++) {
+		if (i != 0) {
+			strcat(path, "/");
+		}
+		strcat(path, names[pick(sizeof (names) / sizeof (char *))]);
+	}
+
+	memset(pinode, 0, sizeof (*pinode));
+	dinode->version = SAM_INODE_VERSION;
+	dinode->mode = (pick(8) == 0) ? S_IFLNK : S_IFREG;
+	dinode->uid = pick(3);
+	dinode->gid = pick(3);
+	dinode->rm.size = sizes[pick(sizeof (sizes) / sizeof (fsize_t))];
+	if (pick(8) == 0) {
+		/* Data segment, the file size is in the first extent. */
+		dinode->status.b.seg_ino = 1;
+		*SEGFILE_SIZE(dinode) =
+		    (uint32_t)sizes[pick(sizeof (sizes) / sizeof (fsize_t))];
+	}
+	if (pick(8) == 0) {
+		pinode->di2.p2flags |= P2FLAGS_XATTR;
+	}
+	TIME_NOW(dinode) = NOW;
+	dinode->creation_time = NOW - pick(3000);
+	dinode->change_time.tv_sec = NOW - pick(3000);
+	dinode->modify_time.tv_sec = NOW - 2000 + pick(4000);
+	dinode->access_time.tv_sec = NOW - 2000 + pick(4000);
+	if (pick(16) == 0) {
+		dinode->access_time.tv_sec = -1 - pick(100);
+	}
+	if (pick(16) == 0) {
+		dinode->modify_time.tv_sec = -1 - pick(100);
+	}
+}
+
+
+/*
+ * Make a random set of file properties.
+ * Entry 0 is the metadata entry, ClassifyFile() may substitute it for
+ * a default data entry.
+ */
+static struct FileProps *
+makeRules(void)
+{
+	struct FileProps *fps;
+	size_t	size;
+	int	count;
+	int	i;
+
+	count = 2 + pick(MAX_RULES - 1);
+	size = sizeof (struct FileProps) +
+	    (count - 1) * sizeof (struct FilePropsEntry);
+	fps = (struct FileProps *)malloc(size);
+	if (fps == NULL) {
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+	memset(fps, 0, size);
+	fps->FpCount = count;
+	fps->FpEntry[0].FpFlags = FP_metadata;
+	if (pick(4) == 0) {
+		fps->FpEntry[0].FpFlags |= FP_noarch;
+	}
+
+	for (i = 1; i < count; i++) {
+		struct FilePropsEntry *fp;
+
+		fp = &fps->FpEntry[i];
+		if (pick(3) != 0) {
+			strcpy(fp->FpPath, dirs[pick(sizeof (dirs) /
+			    sizeof (char *))]);
+			fp->FpPathSize = strlen(fp->FpPath);
+		}
+		if (pick(3) == 0) {
+			fp->FpFlags |= FP_name;
+			strcpy(fp->FpName, regexps[pick(sizeof (regexps) /
+			    sizeof (char *))]);
+		}
+		if (pick(5) == 0) {
+			fp->FpFlags |= FP_uid;
+			fp->FpUid = pick(3);
+		}
+		if (pick(5) == 0) {
+			fp->FpFlags |= FP_gid;
+			fp->FpGid = pick(3);
+		}
+		if (pick(5) == 0) {
+			fp->FpFlags |= FP_minsize;
+			fp->FpMinsize = 1000;
+		}
+		if (pick(5) == 0) {
+			fp->FpFlags |= FP_maxsize;
+			fp->FpMaxsize = 1000 + pick(2);
+		}
+		if (pick(5) == 0) {
+			fp->FpFlags |= FP_access;
+			fp->FpAccess = pick(3000);
+		}
+		if (pick(6) == 0) {
+			fp->FpFlags |= FP_after;
+			fp->FpAfter = NOW - 1500 + pick(3000);
+		}
+		if (pick(6) == 0) {
+			fp->FpFlags |= FP_nftv;
+		}
+		if (pick(4) == 0) {
+			fp->FpFlags |= FP_noarch;
+		} else if (pick(3) == 0) {
+			fp->FpFlags |= FP_default;
+		}
+		if (pick(6) == 0) {
+			fp->FpFlags |= FP_noxattrarch;
+		}
+	}
+	return (fps);
+}
+
+
+/*
+ * Check ClassifyNoarchDir() on the fixed no_archive and archived
+ * directories.
+ */
+static void
+testNoarchDirs(void)
+{
+	struct FileProps *fps;
+	size_t	size;
+	int	count;
+	int	i;
+
+	count = 1 + sizeof (noarchRules) / sizeof (noarchRules[0]);
+	size = sizeof (struct FileProps) +
+	    (count - 1) * sizeof (struct FilePropsEntry);
+	fps = (struct FileProps *)malloc(size);
+	if (fps == NULL) {
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+	memset(fps, 0, size);
+	fps->FpCount = count;
+	fps->FpEntry[0].FpFlags = FP_metadata;
+	for (i = 1; i < count; i++) {
+		struct FilePropsEntry *fp;
+
+		fp = &fps->FpEntry[i];
+		strcpy(fp->FpPath, noarchRules[i - 1].path);
+		fp->FpPathSize = strlen(fp->FpPath);
+		fp->FpFlags = noarchRules[i - 1].flags;
+	}
+	FileProps = fps;
+	ClassifyInit();
+
+	for (i = 0; i < sizeof (noarchDirs) / sizeof (noarchDirs[0]); i++) {
+		boolean_t noarch;
+
+		noarch = ClassifyNoarchDir(noarchDirs[i].dir);
+		if (noarch != noarchDirs[i].noarch) {
+			printf("Directory %s: noarch %d, expected %d\n",
+			    noarchDirs[i].dir, noarch, noarchDirs[i].noarch);
+			mismatches++;
+		}
+	}
+	free(fps);
+}
+
+
+/*
+ * Random integer 0 .. n-1.
+ */
+static int
+pick(
+	int n)
+{
+	return ((int)(lrand48() % n));
+}
+
+
+/*
+ * Print the file properties.
+ */
+static void
+printRules(void)
+{
+	int	i;
+
+	for (i = 1; i < FileProps->FpCount; i++) {
+		struct FilePropsEntry *fp;
+
+		fp = &FileProps->FpEntry[i];
+		printf("  %2d %-12s %08x", i,
+		    (fp->FpPathSize != 0) ? fp->FpPath : "\"\"",
+		    fp->FpFlags);
+		if (fp->FpFlags & FP_name) {
+			printf(" -name %s", fp->FpName);
+		}
+		if (fp->FpFlags & FP_uid) {
+			printf(" -uid %d", (int)fp->FpUid);
+		}
+		if (fp->FpFlags & FP_gid) {
+			printf(" -gid %d", (int)fp->FpGid);
+		}
+		if (fp->FpFlags & FP_minsize) {
+			printf(" -minsize %lld", (long long)fp->FpMinsize);
+		}
+		if (fp->FpFlags & FP_maxsize) {
+			printf(" -maxsize %lld", (long long)fp->FpMaxsize);
+		}
+		if (fp->FpFlags & FP_access) {
+			printf(" -access %d", fp->FpAccess);
+		}
+		if (fp->FpFlags & FP_after) {
+			printf(" -after %ld", (long)fp->FpAfter);
+		}
+		printf("\n");
+	}
+}
+
+
+/*
+ * Index of the file properties selected, -1 if none.
+ */
+static int
+ruleIndex(
+	struct FilePropsEntry *fp)
+{
+	if (fp == NULL) {
+		return (-1);
+	}
+	return ((int)(fp - FileProps->FpEntry));
+}
@@ -66,6 +66,10 @@ struct ArchLib {
 			uname_t	AdName;		/* Name for display */
 			dev_ent_t *AdDevent;	/* Device entry */
 			struct VolInfo AdVi;	/* Loaded VSN */
+			time_t	AdUsedTime;	/* Last in use by another */
+						/* process */
+			vsn_t	AdArchVsn;	/* Written by an arcopy, */
+						/* drive not yet closed */
 		} *AlDriveTable;
 	} entry[1];
 };
@@ -192,3 +192,34 @@ GetArchmax(
 	}
 	return (archmax);
 }
+
+
+/*
+ * Get copy instances for an Archive Set.
+ * Each drive of a disk archive set writes -streams tar files at once,
+ * each tar file by its own sam-arcopy.
+ */
+int
+GetArchDrives(
+	struct ArchSet *as)
+{
+	int	drives;
+
+	drives = (as->AsFlags & AS_drives) ? as->AsDrives : 1;
+	return (drives * GetArchStreams(as));
+}
+
+
+/*
+ * Get tar file streams per volume for an Archive Set.
+ * Only disk archive sets write more than one.
+ */
+int
+GetArchStreams(
+	struct ArchSet *as)
+{
+	if ((as->AsFlags & AS_streams) && (as->AsFlags & AS_disk_archive)) {
+		return (as->AsStreams);
+	}
+	return (1);
+}
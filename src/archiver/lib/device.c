@@ -152,6 +152,12 @@ DeviceCheck(void)
 					if (ad->AdDevent->status.b.ready) {
 						GetDriveVolInfo(ad->AdDevent,
 						    &ad->AdVi);
+					} else if (!(ad->AdFlags & AD_busy)) {
+						/*
+						 * Empty drive.
+						 */
+						memset(&ad->AdVi, 0,
+						    sizeof (struct VolInfo));
 					}
 				}
 			}
@@ -1021,6 +1021,75 @@ _CatalogSlotInit(
 }
 
 
+/*
+ * Initialize a list of slots.
+ * The slots are sent to the catalog server as one batch.  The batch
+ * is not atomic: each slot is applied as the server reads it, and if
+ * the batch stops part way the slots before the failure stay applied.
+ * The status of each slot is returned in CsStatus, -1 if it failed or
+ * was not answered.  A slot sent but not answered may have been applied.
+ * Returns 0 if all slots were initialized, else -1.
+ */
+int
+_CatalogSlotInitList(
+	const char *SrcFile,
+	const int SrcLine,
+	struct CatalogSlotUpdate *csu,
+	int count)
+{
+	struct UdsBatchMsg *msgs;
+	struct CsrSlotInit *args;
+	struct CsrGeneralRsp *rsps;
+	int status;
+	int i;
+
+	if (count <= 0) {
+		return (0);
+	}
+	msgs = malloc(count * sizeof (*msgs));
+	args = malloc(count * sizeof (*args));
+	rsps = malloc(count * sizeof (*rsps));
+	if (msgs == NULL || args == NULL || rsps == NULL) {
+		free(msgs);
+		free(args);
+		free(rsps);
+		return (-1);
+	}
+	for (i = 0; i < count; i++) {
+		memmove(&args[i].SiVid, &csu[i].CsVid, sizeof (args[i].SiVid));
+		memmove(args[i].SiBarcode, csu[i].CsBarCode,
+		    sizeof (args[i].SiBarcode));
+		memmove(args[i].SiAltBarcode, csu[i].CsAltBarCode,
+		    sizeof (args[i].SiAltBarcode));
+		args[i].SiStatus   = csu[i].CsCatStatus;
+		args[i].SiTwoSided = csu[i].CsTwoSided;
+		msgs[i].UbType = CSR_SlotInit;
+		msgs[i].UbArg = &args[i];
+		msgs[i].UbArgSize = sizeof (args[i]);
+		msgs[i].UbRsp = &rsps[i];
+		msgs[i].UbRspSize = sizeof (rsps[i]);
+	}
+	status = UdsSendBatch(SrcFile, SrcLine, &clnt, msgs, count);
+	for (i = 0; i < count; i++) {
+		if (msgs[i].UbStatus != 0) {
+			csu[i].CsStatus = -1;
+			csu[i].CsErrno = msgs[i].UbErrno;
+		} else {
+			csu[i].CsStatus = rsps[i].GrStatus;
+			csu[i].CsErrno = rsps[i].GrErrno;
+			if (rsps[i].GrStatus != 0) {
+				status = -1;
+			}
+		}
+	}
+	free(msgs);
+	free(args);
+	free(rsps);
+	(void) CatalogSync();
+	return (status);
+}
+
+
 /*
  * Set fields using media type and vsn.
  */
@@ -1053,6 +1122,69 @@ _CatalogSetField(
 }
 
 
+/*
+ * Set fields for a list of volumes.
+ * The updates are sent to the catalog server as one batch.  As with
+ * CatalogSlotInitList(), the batch is not atomic; the status of each
+ * update is returned in CfStatus.
+ * Returns 0 if all fields were set, else -1.
+ */
+int
+_CatalogSetFieldList(
+	const char *SrcFile,
+	const int SrcLine,
+	struct CatalogFieldUpdate *cfu,
+	int count)
+{
+	struct UdsBatchMsg *msgs;
+	struct CsrSetField *args;
+	struct CsrGeneralRsp *rsps;
+	int status;
+	int i;
+
+	if (count <= 0) {
+		return (0);
+	}
+	msgs = malloc(count * sizeof (*msgs));
+	args = malloc(count * sizeof (*args));
+	rsps = malloc(count * sizeof (*rsps));
+	if (msgs == NULL || args == NULL || rsps == NULL) {
+		free(msgs);
+		free(args);
+		free(rsps);
+		return (-1);
+	}
+	for (i = 0; i < count; i++) {
+		memmove(&args[i].SfVid, &cfu[i].CfVid, sizeof (args[i].SfVid));
+		args[i].SfField = cfu[i].CfField;
+		args[i].a.v.SfVal  = cfu[i].CfValue;
+		args[i].a.v.SfMask = cfu[i].CfMask;
+		msgs[i].UbType = CSR_SetField;
+		msgs[i].UbArg = &args[i];
+		msgs[i].UbArgSize = sizeof (args[i]);
+		msgs[i].UbRsp = &rsps[i];
+		msgs[i].UbRspSize = sizeof (rsps[i]);
+	}
+	status = UdsSendBatch(SrcFile, SrcLine, &clnt, msgs, count);
+	for (i = 0; i < count; i++) {
+		if (msgs[i].UbStatus != 0) {
+			cfu[i].CfStatus = -1;
+			cfu[i].CfErrno = msgs[i].UbErrno;
+		} else {
+			cfu[i].CfStatus = rsps[i].GrStatus;
+			cfu[i].CfErrno = rsps[i].GrErrno;
+			if (rsps[i].GrStatus != 0) {
+				status = -1;
+			}
+		}
+	}
+	free(msgs);
+	free(args);
+	free(rsps);
+	return (status);
+}
+
+
 /*
  * Set fields using equipment number, slot and partition.
  */
@@ -0,0 +1,390 @@
+/*
+ * catload.c - load generator for the catalog server.
+ *
+ * Replays a mix of archiver, stager and robot catalog requests from
+ * several client processes, and reports the request latencies.
+ *
+ * catload [-c clients] [-n requests] eq
+ *
+ * Each client sends 'requests' requests for volumes of library 'eq':
+ *	archiver - MediaClosed and SetField of the space, by location.
+ *	stager	 - SetField of the mount time, by media type and VSN.
+ *	robot	 - SetField of the occupied status, by location.
+ * Each request writes the values the catalog entry already has, apart
+ * from the modification time set by MediaClosed.  Even so, use a library
+ * that is not in production use.
+ */
+
+/*
+ *    SAM-QFS_notice_begin
+ *
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at pkg/OPENSOLARIS.LICENSE
+ * or https://illumos.org/license/CDDL.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at pkg/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+/*
+ * Copyright 2009 Sun Microsystems, Inc.  All rights reserved.
+ * Use is subject to license terms.
+ *
+ *    SAM-QFS_notice_end
+ */
+
+#pragma ident "$Revision: 1.1 $"
+
+static char *_SrcFile = __FILE__;   /* Using __FILE__ makes duplicate strings */
+
+/* ANSI C headers. */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* POSIX headers. */
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/* SAM-FS headers. */
+#include "sam/types.h"
+#include "sam/custmsg.h"
+#include "aml/device.h"
+#include "sam/exit.h"
+#include "sam/lib.h"
+#include "aml/catalog.h"
+#include "aml/catlib.h"
+
+#if defined(lint)
+#include "sam/lint.h"
+#endif /* defined(lint) */
+
+/* Request kinds. */
+enum Kind {
+	K_archiver,
+	K_stager,
+	K_robot,
+	K_max
+};
+
+static char *kindNames[] = { "archiver", "stager", "robot", "all" };
+
+/*
+ * Request sample.
+ */
+struct Sample {
+	int	SaKind;
+	int	SaStatus;		/* Request status */
+	hrtime_t SaTime;		/* Request latency, ns */
+};
+
+/* Private functions. */
+static void client(int eq, int requests, int fd);
+static int compareSamples(const void *p1, const void *p2);
+static void report(char *name, struct Sample *sa, int count);
+static hrtime_t sendRequest(int kind, struct CatalogEntry *ce, int *status);
+
+
+int
+main(
+	int argc,
+	char **argv)
+{
+	struct Sample *samples;
+	hrtime_t start;
+	double	secs;
+	int	*fds;
+	int	c;
+	int	clients = 8;
+	int	eq;
+	int	kind;
+	int	n;
+	int	ns;
+	int	requests = 1000;
+
+	while ((c = getopt(argc, argv, "c:n:")) != EOF) {
+		switch (c) {
+		case 'c':
+			clients = atoi(optarg);
+			break;
+		case 'n':
+			requests = atoi(optarg);
+			break;
+		default:
+			clients = 0;
+			break;
+		}
+	}
+	if (optind != argc - 1 || clients <= 0 || requests <= 0) {
+		fprintf(stderr, "usage: %s [-c clients] [-n requests] eq\n",
+		    argv[0]);
+		exit(EXIT_USAGE);
+	}
+	eq = atoi(argv[optind]);
+
+	/*
+	 * Start the clients.
+	 * Each returns its samples through a pipe.
+	 */
+	fds = malloc(clients * sizeof (int));
+	samples = malloc(clients * requests * sizeof (struct Sample));
+	if (fds == NULL || samples == NULL) {
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+	start = gethrtime();
+	for (n = 0; n < clients; n++) {
+		int	pfd[2];
+
+		if (pipe(pfd) == -1) {
+			perror("pipe");
+			exit(EXIT_FAILURE);
+		}
+		switch (fork()) {
+		case -1:
+			perror("fork");
+			exit(EXIT_FAILURE);
+			/* NOTREACHED */
+
+		case 0:
+			(void) close(pfd[0]);
+			client(eq, requests, pfd[1]);
+			exit(EXIT_SUCCESS);
+			/* NOTREACHED */
+
+		default:
+			(void) close(pfd[1]);
+			fds[n] = pfd[0];
+			break;
+		}
+	}
+
+	/*
+	 * Collect the samples.
+	 */
+	ns = 0;
+	for (n = 0; n < clients; n++) {
+		char	*p;
+		size_t	size;
+
+		p = (char *)&samples[ns];
+		size = requests * sizeof (struct Sample);
+		while (size > 0) {
+			ssize_t	r;
+
+			if ((r = read(fds[n], p, size)) <= 0) {
+				break;
+			}
+			p += r;
+			size -= r;
+		}
+		if (size == 0) {
+			ns += requests;
+		} else {
+			fprintf(stderr, "Client %d failed\n", n);
+		}
+		(void) close(fds[n]);
+	}
+	while (wait(NULL) > 0) {
+		;
+	}
+	secs = (double)(gethrtime() - start) / NANOSEC;
+
+	/*
+	 * Report each kind, then all requests.
+	 */
+	printf("%d clients, %d requests, %.1f s, %.0f requests/s\n",
+	    clients, ns, secs, (secs > 0) ? ns / secs : 0);
+	printf("%-10s %8s %7s %10s %10s %10s\n", "", "requests", "errors",
+	    "p50 us", "p99 us", "max us");
+	qsort(samples, ns, sizeof (struct Sample), compareSamples);
+	for (kind = 0, n = 0; kind < K_max; kind++) {
+		int	first;
+
+		first = n;
+		while (n < ns && samples[n].SaKind == kind) {
+			n++;
+		}
+		report(kindNames[kind], &samples[first], n - first);
+	}
+	for (n = 0; n < ns; n++) {
+		samples[n].SaKind = K_max;
+	}
+	qsort(samples, ns, sizeof (struct Sample), compareSamples);
+	report(kindNames[K_max], samples, ns);
+	return (EXIT_SUCCESS);
+}
+
+
+/*
+ * Client process.
+ * Send the requests, then write the samples to fd.
+ */
+static void
+client(
+	int eq,
+	int requests,
+	int fd)
+{
+	struct CatalogEntry *entries;
+	struct Sample *samples;
+	size_t	size;
+	int	n;
+	int	numof;
+
+	if (CatalogInit("catload") == -1) {
+		LibFatal(CatalogInit, "");
+	}
+	entries = CatalogGetEntriesByLibrary(eq, &numof);
+	if (entries == NULL || numof == 0) {
+		fprintf(stderr, "No catalog entries for eq %d\n", eq);
+		exit(EXIT_FAILURE);
+	}
+	samples = malloc(requests * sizeof (struct Sample));
+	if (samples == NULL) {
+		perror("malloc");
+		exit(EXIT_FAILURE);
+	}
+	srand48(getpid());
+
+	for (n = 0; n < requests; n++) {
+		struct CatalogEntry ced;
+		struct CatalogEntry *ce;
+		double	r;
+
+		/*
+		 * Archiver 40%, stager 30%, robot 30%.
+		 * Use the current values of the entry.
+		 */
+		r = drand48();
+		samples[n].SaKind = (r < 0.4) ? K_archiver :
+		    (r < 0.7) ? K_stager : K_robot;
+		ce = &entries[(int)(drand48() * numof)];
+		if (CatalogGetCeByLoc(ce->CeEq, ce->CeSlot, ce->CePart,
+		    &ced) != NULL) {
+			ce = &ced;
+		}
+		if (samples[n].SaKind == K_stager && *ce->CeVsn == '\0') {
+			samples[n].SaKind = K_robot;
+		}
+		samples[n].SaTime = sendRequest(samples[n].SaKind, ce,
+		    &samples[n].SaStatus);
+	}
+	CatalogTerm();
+
+	size = requests * sizeof (struct Sample);
+	if (write(fd, samples, size) != size) {
+		perror("write");
+		exit(EXIT_FAILURE);
+	}
+	(void) close(fd);
+}
+
+
+/*
+ * Compare samples by kind and time.
+ */
+static int
+compareSamples(
+	const void *p1,
+	const void *p2)
+{
+	struct Sample *sa1 = (struct Sample *)p1;
+	struct Sample *sa2 = (struct Sample *)p2;
+
+	if (sa1->SaKind != sa2->SaKind) {
+		return (sa1->SaKind - sa2->SaKind);
+	}
+	if (sa1->SaTime < sa2->SaTime) {
+		return (-1);
+	}
+	return (sa1->SaTime > sa2->SaTime);
+}
+
+
+/*
+ * Report sorted samples.
+ */
+static void
+report(
+	char *name,
+	struct Sample *sa,
+	int count)
+{
+	int	errors;
+	int	n;
+
+	if (count == 0) {
+		return;
+	}
+	errors = 0;
+	for (n = 0; n < count; n++) {
+		if (sa[n].SaStatus != 0) {
+			errors++;
+		}
+	}
+	printf("%-10s %8d %7d %10.1f %10.1f %10.1f\n", name, count, errors,
+	    sa[(count - 1) / 2].SaTime / 1000.0,
+	    sa[((count - 1) * 99) / 100].SaTime / 1000.0,
+	    sa[count - 1].SaTime / 1000.0);
+}
+
+
+/*
+ * Send a request.
+ * Returns the request latency.
+ */
+static hrtime_t
+sendRequest(
+	int kind,
+	struct CatalogEntry *ce,
+	int *status)
+{
+	struct VolId vid;
+	hrtime_t start;
+
+	start = gethrtime();
+	switch (kind) {
+	case K_archiver:
+		*status = CatalogMediaClosed(ce);
+		if (*status == 0) {
+			*status = CatalogSetFieldByLoc(ce->CeEq, ce->CeSlot,
+			    ce->CePart, CEF_Space, ce->CeSpace, 0);
+		}
+		break;
+
+	case K_stager:
+		memset(&vid, 0, sizeof (vid));
+		vid.ViFlags = VI_logical;
+		memmove(vid.ViMtype, ce->CeMtype, sizeof (vid.ViMtype));
+		memmove(vid.ViVsn, ce->CeVsn, sizeof (vid.ViVsn));
+		*status = CatalogSetField(&vid, CEF_MountTime,
+		    ce->CeMountTime, 0);
+		break;
+
+	case K_robot:
+		*status = CatalogSetFieldByLoc(ce->CeEq, ce->CeSlot,
+		    ce->CePart, CEF_Status, ce->CeStatus & CES_occupied,
+		    CES_occupied);
+		break;
+
+	default:
+		*status = -1;
+		break;
+	}
+	return (gethrtime() - start);
+}
@@ -50,6 +50,7 @@ static char *_SrcFile = __FILE__; /* Using __FILE__ makes duplicate strings */
 /* POSIX headers. */
 #include <sys/types.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <unistd.h>
 #include <sys/shm.h>
 #include <sys/stat.h>
@@ -88,6 +89,47 @@ static char *_SrcFile = __FILE__; /* Using __FILE__ makes duplicate strings */
 #undef snprintf
 #endif /* defined(lint) */
 
+/*
+ * Requests are served by CATSERVER_THREADS threads.
+ * A request that changes only one catalog holds that catalog's lock and
+ * the catalog table lock shared.  Requests that search or change several
+ * catalogs, or grow one, hold the catalog table lock exclusive.
+ */
+#define	CATSERVER_THREADS 8
+
+/*
+ * Changed catalogs are written to disk together every
+ * CATALOG_SYNC_INTERVAL seconds.
+ */
+#define	CATALOG_SYNC_INTERVAL 2
+
+/* Lock held by a request. */
+#define	RC_all		(-1)	/* Catalog table exclusive */
+#define	RC_shared	(-2)	/* Catalog table shared */
+
+/*
+ * Request context.
+ * Each serving thread has its own response and working buffers.
+ */
+struct RequestContext {
+	union {
+		struct CsrGeneralRsp RcGeneral;
+		struct CsrGetInfoRsp RcGetInfo;
+	} RcRsp;
+	char	RcVolString[256];	/* StringFromVolId() result */
+	struct CatalogEntry *RcCe;	/* NextCartridgeEntry() position */
+	struct CatalogEntry *RcCeEnd;
+	int	RcCatalog;		/* Catalog locked, or RC_* */
+};
+
+/*
+ * Catalog lock.
+ */
+struct CatalogLock {
+	pthread_mutex_t ClMutex;
+	boolean_t ClDirty;		/* Changed since last sync */
+};
+
 /* Private functions. */
 static void CatchSignals(int SigNum);
 static void CheckForCleaning(struct CatalogEntry *ce);
@@ -95,6 +137,7 @@ static int CompareVsns(const void *p1, const void *p2);
 static void FreeEntry(struct CatalogEntry *ce);
 static struct CatalogEntry *GetFreeEntry(int cat_num);
 static int GetFreeSlot(int cat_num);
+static struct RequestContext *GetRequestContext(void);
 static int GrowCatalog(int cat_num, int increase);
 static void LibLogit(int status, char *msg);
 static void MakeCatalogTable(void);
@@ -103,11 +146,16 @@ static void MakeEmptyCatalog(char *cf_name, enum CH_type ch_type, void **mp,
 static void MoveCartridge(struct CatalogEntry *ce, int cat_num, int slot);
 static struct CatalogEntry *NextCartridgeEntry(struct CatalogEntry *cea,
 	int en);
+static void RequestBegin(int type, void *arg);
+static int RequestCatalog(int type, void *arg);
+static void RequestEnd(int type, void *arg);
 static int SortAndCheckForDuplicateVsns(char *mtype, char *vsn,
 	struct CatalogEntry *cea, boolean_t checkall, boolean_t markit);
 static void SrvrLogit(char *msg);
 static char *VolStringFromCe(struct CatalogEntry *ce);
 static char *StringFromVolId(struct VolId *vid);
+static void SyncCatalogs(void);
+static void *SyncThread(void *arg);
 static void TraceRequest(struct UdsMsgHeader *hdr, struct CsrGeneralRsp *rsp,
 	const char *fmt, ...);
 static void *ShmatSamfs(int	mode);
@@ -206,7 +254,7 @@ union argbuf {
 
 static struct UdsServer srvr =
 	{ SERVER_NAME, SERVER_MAGIC, SrvrLogit, 0, Table, USR_MAX,
-	sizeof (union argbuf) };
+	sizeof (union argbuf), CATSERVER_THREADS, RequestBegin, RequestEnd };
 
 static sam_defaults_t *defaults;
 static char *CatalogDir = SAM_CATALOG_DIR;
@@ -223,6 +271,12 @@ static boolean_t IsDaemon = FALSE;
 static int Historian = 0;
 static int LastMid = 0;
 
+static pthread_key_t ContextKey;
+static pthread_rwlock_t CatalogsLock = PTHREAD_RWLOCK_INITIALIZER;
+static struct CatalogLock *CatalogLocks;
+static pthread_mutex_t TraceMutex = PTHREAD_MUTEX_INITIALIZER;
+static int syncs = 0;
+
 /* Public functions. */
 int CvrtCatalog(char *cf_name, int version, void **mp, size_t *size);
 
@@ -238,6 +292,8 @@ main(
 {
 	struct sigaction sig_action;
 	sigset_t block_set;
+	pthread_t tid;
+	int	nc;
 
 	/*
 	 * Check initiator.
@@ -274,6 +330,21 @@ main(
 	defaults = GetDefaults();
 	MakeCatalogTable();
 
+	/*
+	 * Prepare for serving requests in several threads.
+	 */
+	errno = pthread_key_create(&ContextKey, free);
+	if (errno != 0) {
+		LibFatal(pthread_key_create, NULL);
+		exit(EXIT_FAILURE);
+	}
+	SamMalloc(CatalogLocks,
+	    CatalogTable->CtNumofFiles * sizeof (struct CatalogLock));
+	for (nc = 0; nc < CatalogTable->CtNumofFiles; nc++) {
+		(void) pthread_mutex_init(&CatalogLocks[nc].ClMutex, NULL);
+		CatalogLocks[nc].ClDirty = FALSE;
+	}
+
 	/*
 	 * Catch signals.
 	 */
@@ -282,6 +353,18 @@ main(
 	sig_action.sa_flags = 0;
 	(void) sigaction(SIGHUP, &sig_action, NULL);
 	(void) sigaction(SIGINT, &sig_action, NULL);
+
+	/*
+	 * Start the catalog sync thread with all signals blocked.
+	 */
+	sigfillset(&block_set);
+	sigprocmask(SIG_SETMASK, &block_set, NULL);
+	errno = pthread_create(&tid, NULL, SyncThread, NULL);
+	if (errno != 0) {
+		LibFatal(pthread_create, "SyncThread");
+		exit(EXIT_FAILURE);
+	}
+
 	/*
 	 * Reset our signal mask to not block anything.
 	 */
@@ -297,13 +380,22 @@ main(
 			exit(EXIT_FAILURE);
 		}
 	}
+	/*
+	 * Wait for the requests in progress, and write the catalogs.
+	 */
+	(void) pthread_rwlock_wrlock(&CatalogsLock);
+	for (nc = 0; nc < CatalogTable->CtNumofFiles; nc++) {
+		CatalogLocks[nc].ClDirty = TRUE;
+	}
+	SyncCatalogs();
+
 	/*
 	 * Invalidate catalogs.
 	 */
 	CatalogTable->Ct.MfValid = 0;
 
-	Trace(TR_MISC, "Messages processed %d, errors %d",
-	    msgs_processed, errors);
+	Trace(TR_MISC, "Messages processed %d, errors %d, syncs %d",
+	    msgs_processed, errors, syncs);
 	SendCustMsg(HERE, 18005, srvr.UsStop);
 	return (EXIT_SUCCESS);
 }
@@ -317,24 +409,24 @@ AssignFreeSlot(
 	void *arg,
 	struct UdsMsgHeader *hdr)
 {
-	static struct CsrGeneralRsp rsp;
+	struct CsrGeneralRsp *rsp = &GetRequestContext()->RcRsp.RcGeneral;
 	struct CsrAssignFreeSlot *a = (struct CsrAssignFreeSlot *)arg;
 	struct CatalogEntry *ce;
 	int cat_num;
 	int slot;
 
-	rsp.GrStatus = -1;
+	rsp->GrStatus = -1;
 	if ((cat_num = FindCatalog(a->AsEq)) == -1)  goto out;
 	slot = GetFreeSlot(cat_num);
 	ce = GetFreeEntry(cat_num);
 	if (ce == NULL)  goto out;
 	ce->CeSlot = slot;
-	rsp.GrStatus = slot;	/* Return slot to caller */
+	rsp->GrStatus = slot;	/* Return slot to caller */
 
 out:
-	TraceRequest(hdr, &rsp,
-	    "AssignFreeSlot(%d) = %d", a->AsEq, rsp.GrStatus);
-	return (&rsp);
+	TraceRequest(hdr, rsp,
+	    "AssignFreeSlot(%d) = %d", a->AsEq, rsp->GrStatus);
+	return (rsp);
 }
 
 
@@ -348,11 +440,11 @@ Export(
 {
 	vsn_t	VsnHist;
 	mtype_t	MtypeHist;
-	static struct CsrGeneralRsp rsp;
+	struct CsrGeneralRsp *rsp = &GetRequestContext()->RcRsp.RcGeneral;
 	struct CsrExport *a = (struct CsrExport *)arg;
 	struct CatalogEntry *ce;
 
-	rsp.GrStatus = -1;
+	rsp->GrStatus = -1;
 	if (a->SeVid.ViFlags == VI_cart) {
 		ce = CS_CatalogGetCeByLoc(a->SeVid.ViEq, a->SeVid.ViSlot,
 		    a->SeVid.ViPart);
@@ -422,11 +514,11 @@ Export(
 	}
 	(void) ArchiverCatalogChange();
 
-	rsp.GrStatus = 0;
+	rsp->GrStatus = 0;
 
 out:
-	TraceRequest(hdr, &rsp, "Export(%s)", StringFromVolId(&a->SeVid));
-	return (&rsp);
+	TraceRequest(hdr, rsp, "Export(%s)", StringFromVolId(&a->SeVid));
+	return (rsp);
 }
 
 
@@ -440,11 +532,11 @@ FormatPartitions(
 {
 	int cat_num, np;
 	vsn_t	vsn;
-	static struct CsrGeneralRsp rsp;
+	struct CsrGeneralRsp *rsp = &GetRequestContext()->RcRsp.RcGeneral;
 	struct CsrFormatPartitions *a = (struct CsrFormatPartitions *)arg;
 	struct CatalogEntry *ce;
 
-	rsp.GrStatus = -1;
+	rsp->GrStatus = -1;
 	if ((cat_num = FindCatalog(a->FrVid.ViEq)) == -1) {
 		goto out;
 	}
@@ -482,12 +574,12 @@ FormatPartitions(
 		ce->CeSlot = a->FrVid.ViSlot;
 		ce->CePart = (short)np;
 	}
-	rsp.GrStatus = 0;
+	rsp->GrStatus = 0;
 
 out:
-	TraceRequest(hdr, &rsp, "FormatPartitions(%s, %d)",
+	TraceRequest(hdr, rsp, "FormatPartitions(%s, %d)",
 	    StringFromVolId(&a->FrVid), a->FrNumParts);
-	return (&rsp);
+	return (rsp);
 }
 
 
@@ -500,11 +592,11 @@ GetInfo(
 	void *arg,
 	struct UdsMsgHeader *hdr)
 {
-	static struct CsrGetInfoRsp rsp;
+	struct CsrGetInfoRsp *rsp = &GetRequestContext()->RcRsp.RcGetInfo;
 
-	strcpy(rsp.CatTableName, CatalogTableName);
+	strcpy(rsp->CatTableName, CatalogTableName);
 	TraceRequest(hdr, NULL, "GetInfo: Client connection made.");
-	return (&rsp);
+	return (rsp);
 }
 
 
@@ -516,12 +608,12 @@ LabelComplete(
 	void *arg,
 	struct UdsMsgHeader *hdr)
 {
-	static struct CsrGeneralRsp rsp;
+	struct CsrGeneralRsp *rsp = &GetRequestContext()->RcRsp.RcGeneral;
 	struct CsrVolumeLoaded *a = (struct CsrVolumeLoaded *)arg;
 	struct CatalogEntry *ce, *cea, *cet;
 	int en;
 
-	rsp.GrStatus = -1;
+	rsp->GrStatus = -1;
 	cea = &a->VlCe;
 	ce = CS_CatalogGetCeByLoc(cea->CeEq, cea->CeSlot, cea->CePart);
 	if (ce == NULL) {
@@ -588,7 +680,7 @@ LabelComplete(
 	ce->CeStatus |= CES_labeled | CES_empty |
 	    (cea->CeStatus & (CES_bad_media | CES_recycle));
 
-	rsp.GrStatus = 0;
+	rsp->GrStatus = 0;
 
 out:
 	/*
@@ -607,8 +699,8 @@ out:
 		ce = NextCartridgeEntry(ce, en++);
 	}
 
-	TraceRequest(hdr, &rsp, "LabelComplete(%s)", VolStringFromCe(cea));
-	return (&rsp);
+	TraceRequest(hdr, rsp, "LabelComplete(%s)", VolStringFromCe(cea));
+	return (rsp);
 }
 
 
@@ -620,7 +712,7 @@ LabelFailed(
 	void *arg,
 	struct UdsMsgHeader *hdr)
 {
-	static struct CsrGeneralRsp rsp;
+	struct CsrGeneralRsp *rsp = &GetRequestContext()->RcRsp.RcGeneral;
 	struct CsrLabelFailed *a = (struct CsrLabelFailed *)arg;
 	struct CatalogEntry *cet, *ce;
 
@@ -628,7 +720,7 @@ LabelFailed(
 	 * Remove the dummy entry if created at the
 	 * beginning of the label process.
 	 */
-	rsp.GrStatus = 0;
+	rsp->GrStatus = 0;
 	cet = CS_CatalogGetCeByMedia(a->LfVid.ViMtype, a->LfNewVsn);
 	ce = CS_CatalogGetCeByMedia(a->LfVid.ViMtype, a->LfVid.ViVsn);
 	/*
@@ -643,10 +735,10 @@ LabelFailed(
 		FreeEntry(cet);
 	}
 
-	TraceRequest(hdr, &rsp, "LabelFailed(%s, %s)",
+	TraceRequest(hdr, rsp, "LabelFailed(%s, %s)",
 	    StringFromVolId(&a->LfVid), a->LfNewVsn);
 
-	return (&rsp);
+	return (rsp);
 }
 
 
@@ -658,7 +750,7 @@ LabelVolume(
 	void *arg,
 	struct UdsMsgHeader *hdr)
 {
-	static struct CsrGeneralRsp rsp;
+	struct CsrGeneralRsp *rsp = &GetRequestContext()->RcRsp.RcGeneral;
 	struct CsrLabelVolume *a = (struct CsrLabelVolume *)arg;
 	struct CatalogEntry *ce, *cet;
 
@@ -666,7 +758,7 @@ LabelVolume(
 	 * Get the catalog entry.
 	 * See if an entry exists for the New VSN.
 	 */
-	rsp.GrStatus = -1;
+	rsp->GrStatus = -1;
 	a->LvVid.ViFlags = VI_labeled;
 	ce = CS_CatalogGetCeByMedia(a->LvVid.ViMtype, a->LvVid.ViVsn);
 	cet = CS_CatalogGetCeByMedia(a->LvVid.ViMtype, a->LvNewVsn);
@@ -702,12 +794,12 @@ LabelVolume(
 		UpdateRemoteCe(ce, RMT_CAT_CHG_FLGS_LBL);
 	}
 
-	rsp.GrStatus = 0;
+	rsp->GrStatus = 0;
 
 out:
-	TraceRequest(hdr, &rsp, "LabelVolume(%s %s)",
+	TraceRequest(hdr, rsp, "LabelVolume(%s %s)",
 	    StringFromVolId(&a->LvVid), a->LvNewVsn);
-	return (&rsp);
+	return (rsp);
 }
 
 
@@ -719,12 +811,12 @@ LibraryExport(
 	void *arg,
 	struct UdsMsgHeader *hdr)
 {
-	static struct CsrGeneralRsp rsp;
+	struct CsrGeneralRsp *rsp = &GetRequestContext()->RcRsp.RcGeneral;
 	struct CsrLibraryExport *a = (struct CsrLibraryExport *)arg;
 	struct CatalogHdr *ch;
 	int cat_num, ne;
 
-	rsp.GrStatus = -1;
+	rsp->GrStatus = -1;
 	if (a->LeEq != Catalogs[Historian].CmHdr->ChEq) {
 		if ((cat_num = FindCatalog(a->LeEq)) == -1)  goto out;
 		ch = Catalogs[cat_num].CmHdr;
@@ -740,15 +832,15 @@ LibraryExport(
 				}
 			}
 		}
-		rsp.GrStatus = 0;
+		rsp->GrStatus = 0;
 		(void) ArchiverCatalogChange();
 	} else {
 		errno = EINVAL;
 	}
 
 out:
-	TraceRequest(hdr, &rsp, "LibraryExport(%d)", a->LeEq);
-	return (&rsp);
+	TraceRequest(hdr, rsp, "LibraryExport(%d)", a->LeEq);
+	return (rsp);
 }
 
 
@@ -762,11 +854,11 @@ MediaClosed(
 	void *arg,
 	struct UdsMsgHeader *hdr)
 {
-	static struct CsrGeneralRsp rsp;
+	struct CsrGeneralRsp *rsp = &GetRequestContext()->RcRsp.RcGeneral;
 	struct CsrMediaClosed *a = (struct CsrMediaClosed *)arg;
 	struct CatalogEntry *ce, *cea;
 
-	rsp.GrStatus = -1;
+	rsp->GrStatus = -1;
 	cea = &a->SfCe;
 	ce = CS_CatalogGetCeByLoc(cea->CeEq, cea->CeSlot, cea->CePart);
 	if (ce == NULL)  goto out;
@@ -780,12 +872,12 @@ MediaClosed(
 	if (RemoteServer) {
 		UpdateRemoteCe(ce, 0);
 	}
-	rsp.GrStatus = 0;
+	rsp->GrStatus = 0;
 
 out:
-	TraceRequest(hdr, &rsp, "MediaClosed(%s, %llu, %llu)",
+	TraceRequest(hdr, rsp, "MediaClosed(%s, %llu, %llu)",
 	    VolStringFromCe(cea), cea->CeSpace, cea->m.CeLastPos);
-	return (&rsp);
+	return (rsp);
 }
 
 
@@ -797,13 +889,13 @@ MoveSlot(
 	void *arg,
 	struct UdsMsgHeader *hdr)
 {
-	static struct CsrGeneralRsp rsp;
+	struct CsrGeneralRsp *rsp = &GetRequestContext()->RcRsp.RcGeneral;
 	struct CsrMoveSlot *a = (struct CsrMoveSlot *)arg;
 	struct CatalogEntry *ce, *ced;
 	int en;
 	int src;
 
-	rsp.GrStatus = -1;
+	rsp->GrStatus = -1;
 	if ((ce = CS_CatalogGetEntry(&a->MsVid)) == NULL)  goto out;
 
 	/*
@@ -826,12 +918,12 @@ MoveSlot(
 		else  ce = NULL;
 		ce_tochange->CeSlot = a->MsDestSlot;
 	}
-	rsp.GrStatus = 0;
+	rsp->GrStatus = 0;
 
 out:
-	TraceRequest(hdr, &rsp, "MoveSlot(%s, %d)", StringFromVolId(&a->MsVid),
+	TraceRequest(hdr, rsp, "MoveSlot(%s, %d)", StringFromVolId(&a->MsVid),
 	    a->MsDestSlot);
-	return (&rsp);
+	return (rsp);
 }
 
 
@@ -844,13 +936,13 @@ ReconcileCatalog(
 	void *arg,
 	struct UdsMsgHeader *hdr)
 {
-	static struct CsrGeneralRsp rsp;
+	struct CsrGeneralRsp *rsp = &GetRequestContext()->RcRsp.RcGeneral;
 	struct CsrReconcileCatalog *a = (struct CsrReconcileCatalog *)arg;
 	struct CatalogHdr *ch;
 	int cat_num, ne;
 	int num_dups = 0;
 
-	rsp.GrStatus = -1;
+	rsp->GrStatus = -1;
 	if ((cat_num = FindCatalog(a->RcEq)) == -1)  goto out;
 	ch = Catalogs[cat_num].CmHdr;
 	for (ne = 0; ne < ch->ChNumofEntries; ne++) {
@@ -862,11 +954,11 @@ ReconcileCatalog(
 		}
 	}
 	num_dups = SortAndCheckForDuplicateVsns(NULL, NULL, NULL, TRUE, TRUE);
-	rsp.GrStatus = 0;
+	rsp->GrStatus = 0;
 
 out:
-	TraceRequest(hdr, &rsp, "ReconcileCatalog(%d) %d", a->RcEq, num_dups);
-	return (&rsp);
+	TraceRequest(hdr, rsp, "ReconcileCatalog(%d) %d", a->RcEq, num_dups);
+	return (rsp);
 }
 
 
@@ -878,12 +970,12 @@ RemoteSamUpdate(
 	void *arg,
 	struct UdsMsgHeader *hdr)
 {
-	static struct CsrGeneralRsp rsp;
+	struct CsrGeneralRsp *rsp = &GetRequestContext()->RcRsp.RcGeneral;
 	struct CsrRemoteSamUpdate *a = (struct CsrRemoteSamUpdate *)arg;
 	struct CatalogEntry *ce = NULL, *cea;
 	int en, cat_num;
 
-	rsp.GrStatus = -1;
+	rsp->GrStatus = -1;
 	cea = &a->RsCe;
 	if ((cat_num = FindCatalog(cea->CeEq)) == -1) {
 		goto out;
@@ -919,7 +1011,7 @@ RemoteSamUpdate(
 		 * Just move the historian entry to the library catalog.
 		 */
 		MoveCartridge(ce, cat_num, -1);
-		rsp.GrStatus = 0;
+		rsp->GrStatus = 0;
 	} else {
 		memmove(ce->CeMtype, cea->CeMtype, sizeof (ce->CeMtype));
 		memmove(ce->CeVsn, cea->CeVsn, sizeof (ce->CeVsn));
@@ -934,7 +1026,7 @@ RemoteSamUpdate(
 		ce->m.CePtocFwa = cea->m.CePtocFwa;
 		ce->CePart = cea->CePart;
 		(void) ArchiverCatalogChange();
-		rsp.GrStatus = 0;
+		rsp->GrStatus = 0;
 	}
 
 out:
@@ -948,8 +1040,8 @@ out:
 		ce = NextCartridgeEntry(ce, en++);
 	}
 
-	TraceRequest(hdr, &rsp, "RemoteSamUpdate(%s)", VolStringFromCe(cea));
-	return (&rsp);
+	TraceRequest(hdr, rsp, "RemoteSamUpdate(%s)", VolStringFromCe(cea));
+	return (rsp);
 }
 
 
@@ -961,11 +1053,11 @@ ReserveVolume(
 	void *arg,
 	struct UdsMsgHeader *hdr)
 {
-	static struct CsrGeneralRsp rsp;
+	struct CsrGeneralRsp *rsp = &GetRequestContext()->RcRsp.RcGeneral;
 	struct CsrReserveVolume *a = (struct CsrReserveVolume *)arg;
 	struct CatalogEntry *ce;
 
-	rsp.GrStatus = -1;
+	rsp->GrStatus = -1;
 	if ((ce = CS_CatalogGetEntry(&a->RvVid)) == NULL) {
 		goto out;
 	}
@@ -985,12 +1077,12 @@ ReserveVolume(
 			/*
 			 * No error if same reservation.
 			 */
-			rsp.GrStatus = 0;
+			rsp->GrStatus = 0;
 		}
 		goto out;
 	}
 
-	rsp.GrStatus = 0;
+	rsp->GrStatus = 0;
 	ce->r.CerTime = a->RvTime;
 	memmove(ce->r.CerAsname, a->RvAsname, sizeof (ce->r.CerAsname));
 	memmove(ce->r.CerOwner, a->RvOwner, sizeof (ce->r.CerOwner));
@@ -1000,10 +1092,10 @@ ReserveVolume(
 	    ce->r.CerOwner, ce->r.CerFsname);
 
 out:
-	TraceRequest(hdr, &rsp, "ReserveVolume(%s, %s/%s/%s)",
+	TraceRequest(hdr, rsp, "ReserveVolume(%s, %s/%s/%s)",
 	    StringFromVolId(&a->RvVid), a->RvAsname,
 	    a->RvOwner, a->RvFsname);
-	return (&rsp);
+	return (rsp);
 }
 
 /*
@@ -1014,12 +1106,12 @@ SetAudit(
 	void *arg,
 	struct UdsMsgHeader *hdr)
 {
-	static struct CsrGeneralRsp rsp;
+	struct CsrGeneralRsp *rsp = &GetRequestContext()->RcRsp.RcGeneral;
 	struct CsrSetAudit *a = (struct CsrSetAudit *)arg;
 	struct CatalogHdr *ch;
 	int cat_num, ne;
 
-	rsp.GrStatus = -1;
+	rsp->GrStatus = -1;
 	if ((cat_num = FindCatalog(a->SaEq)) == -1)  goto out;
 	ch = Catalogs[cat_num].CmHdr;
 
@@ -1033,11 +1125,11 @@ SetAudit(
 				ce->CeStatus |= CES_needs_audit;
 		}
 	}
-	rsp.GrStatus = 0;
+	rsp->GrStatus = 0;
 
 out:
-	TraceRequest(hdr, &rsp, "SetAudit(%d)", a->SaEq);
-	return (&rsp);
+	TraceRequest(hdr, rsp, "SetAudit(%d)", a->SaEq);
+	return (rsp);
 }
 
 
@@ -1049,12 +1141,12 @@ SetCleaning(
 	void *arg,
 	struct UdsMsgHeader *hdr)
 {
-	static struct CsrGeneralRsp rsp;
+	struct CsrGeneralRsp *rsp = &GetRequestContext()->RcRsp.RcGeneral;
 	struct CsrSetCleaning *a = (struct CsrSetCleaning *)arg;
 	struct CatalogHdr *ch;
 	int cat_num, ne;
 
-	rsp.GrStatus = -1;
+	rsp->GrStatus = -1;
 	if ((cat_num = FindCatalog(a->ScEq)) == -1)  goto out;
 	ch = Catalogs[cat_num].CmHdr;
 
@@ -1066,11 +1158,11 @@ SetCleaning(
 			CheckForCleaning(ce);
 		}
 	}
-	rsp.GrStatus = 0;
+	rsp->GrStatus = 0;
 
 out:
-	TraceRequest(hdr, &rsp, "SetCleaning(%d)", a->ScEq);
-	return (&rsp);
+	TraceRequest(hdr, rsp, "SetCleaning(%d)", a->ScEq);
+	return (rsp);
 }
 
 
@@ -1084,12 +1176,12 @@ SetRemoteServer(
 	void *arg,
 	struct UdsMsgHeader *hdr)
 {
-	static struct CsrGeneralRsp rsp;
+	struct CsrGeneralRsp *rsp = &GetRequestContext()->RcRsp.RcGeneral;
 
 	RemoteServer = TRUE;
 
 	TraceRequest(hdr, NULL, "SetRemoteServer");
-	return (&rsp);
+	return (rsp);
 }
 
 
@@ -1101,17 +1193,17 @@ SlotInit(
 	void *arg,
 	struct UdsMsgHeader *hdr)
 {
-	static struct CsrGeneralRsp rsp;
+	struct CsrGeneralRsp *rsp = &GetRequestContext()->RcRsp.RcGeneral;
 	struct CsrSlotInit *a = (struct CsrSlotInit *)arg;
 	struct CatalogEntry *ce = NULL, *cea;
 	int cat_num;
 
-	rsp.GrStatus = -1;
+	rsp->GrStatus = -1;
 	if ((cat_num = FindCatalog(a->SiVid.ViEq)) == -1) {
 		goto out;
 	}
 	if (*a->SiBarcode != '\0') {
-		TraceRequest(hdr, &rsp, "SlotInit(%s, %08x, %d, %s, %s)",
+		TraceRequest(hdr, rsp, "SlotInit(%s, %08x, %d, %s, %s)",
 		    StringFromVolId(&a->SiVid), a->SiStatus, a->SiTwoSided,
 		    a->SiBarcode, a->SiAltBarcode);
 		/*
@@ -1154,7 +1246,7 @@ SlotInit(
 				}
 			}
 			ce = NULL;
-			rsp.GrStatus = 0;
+			rsp->GrStatus = 0;
 			goto out;
 		}
 
@@ -1175,7 +1267,7 @@ SlotInit(
 					MoveCartridge(ce, cat_num,
 					    a->SiVid.ViSlot);
 					ce = NULL;
-					rsp.GrStatus = 0;
+					rsp->GrStatus = 0;
 					goto out;
 				} else {
 					ce->CeStatus &= ~CES_reconcile;
@@ -1284,11 +1376,11 @@ SlotInit(
 		if (!(ce->CeStatus & CES_cleaning))
 			CheckForCleaning(ce);
 
-		rsp.GrStatus = 0;
+		rsp->GrStatus = 0;
 		goto out;
 
 	} else {
-		rsp.GrStatus = 0;
+		rsp->GrStatus = 0;
 		ce = CS_CatalogGetCeByLoc(a->SiVid.ViEq, a->SiVid.ViSlot,
 		    a->SiVid.ViPart);
 		if (ce == NULL && a->SiStatus & CES_inuse) {
@@ -1331,14 +1423,14 @@ SlotInit(
 				 */
 				ce->CeStatus |= CES_reconcile;
 				ce = NULL;
-				rsp.GrStatus = 0;
+				rsp->GrStatus = 0;
 			}
 		}
 	}
 
 
 out:
-	if (rsp.GrStatus == 0) {
+	if (rsp->GrStatus == 0) {
 		int en;
 		uint32_t mask;
 
@@ -1368,10 +1460,10 @@ out:
 		}
 	}
 
-	TraceRequest(hdr, &rsp, "SlotInit(%s, %08x, %d, %s, %s)",
+	TraceRequest(hdr, rsp, "SlotInit(%s, %08x, %d, %s, %s)",
 	    StringFromVolId(&a->SiVid), a->SiStatus, a->SiTwoSided,
 	    a->SiBarcode, a->SiAltBarcode);
-	return (&rsp);
+	return (rsp);
 }
 
 
@@ -1383,12 +1475,12 @@ SetField(
 	void *arg,
 	struct UdsMsgHeader *hdr)
 {
-	static struct CsrGeneralRsp rsp;
+	struct CsrGeneralRsp *rsp = &GetRequestContext()->RcRsp.RcGeneral;
 	struct CsrSetField *a = (struct CsrSetField *)arg;
 	struct CatalogEntry *ce;
 	int		en;
 
-	rsp.GrStatus = -1;
+	rsp->GrStatus = -1;
 	if ((ce = CS_CatalogGetEntry(&a->SfVid)) == NULL) {
 		goto out;
 	}
@@ -1482,23 +1574,23 @@ SetField(
 			FreeEntry(ce_tofree);
 		}
 	}
-	rsp.GrStatus = 0;
+	rsp->GrStatus = 0;
 
 out:
 	if (a->SfField == CEF_MediaType ||
 	    a->SfField == CEF_Vsn ||
 	    a->SfField == CEF_BarCode) {
-		TraceRequest(hdr, &rsp, "SetField(%s, %d, %s)",
+		TraceRequest(hdr, rsp, "SetField(%s, %d, %s)",
 		    StringFromVolId(&a->SfVid), a->SfField, a->a.SfString);
 	} else if (a->SfField == CEF_Status) {
-		TraceRequest(hdr, &rsp, "SetField(%s, status, %08llx, %08x)",
+		TraceRequest(hdr, rsp, "SetField(%s, status, %08llx, %08x)",
 		    StringFromVolId(&a->SfVid), a->a.v.SfVal,
 		    a->a.v.SfMask);
 	} else {
-		TraceRequest(hdr, &rsp, "SetField(%s, %d, %llu)",
+		TraceRequest(hdr, rsp, "SetField(%s, %d, %llu)",
 		    StringFromVolId(&a->SfVid), a->SfField, a->a.v.SfVal);
 	}
-	return (&rsp);
+	return (rsp);
 }
 
 
@@ -1510,11 +1602,11 @@ UnReserveVolume(
 	void *arg,
 	struct UdsMsgHeader *hdr)
 {
-	static struct CsrGeneralRsp rsp;
+	struct CsrGeneralRsp *rsp = &GetRequestContext()->RcRsp.RcGeneral;
 	struct CsrUnReserveVolume *a = (struct CsrUnReserveVolume *)arg;
 	struct CatalogEntry *ce;
 
-	rsp.GrStatus = -1;
+	rsp->GrStatus = -1;
 	if ((ce = CS_CatalogGetEntry(&a->UrVid)) == NULL) {
 		goto out;
 	}
@@ -1522,7 +1614,7 @@ UnReserveVolume(
 		errno = ER_VOLUME_NOT_RESERVED;
 		goto out;
 	}
-	rsp.GrStatus = 0;
+	rsp->GrStatus = 0;
 	ce->r.CerTime = 0;
 	/* Volume %s unreserved from %s/%s/%s */
 	SendCustMsg(HERE, 18035, VolStringFromCe(ce),
@@ -1532,9 +1624,9 @@ UnReserveVolume(
 	memset(ce->r.CerFsname, 0, sizeof (ce->r.CerFsname));
 
 out:
-	TraceRequest(hdr, &rsp, "UnReserveVolume(%s)",
+	TraceRequest(hdr, rsp, "UnReserveVolume(%s)",
 	    StringFromVolId(&a->UrVid));
-	return (&rsp);
+	return (rsp);
 }
 
 
@@ -1548,14 +1640,14 @@ VolumeLoaded(
 	void *arg,
 	struct UdsMsgHeader *hdr)
 {
-	static struct CsrGeneralRsp rsp;
+	struct CsrGeneralRsp *rsp = &GetRequestContext()->RcRsp.RcGeneral;
 	struct CsrVolumeLoaded *a = (struct CsrVolumeLoaded *)arg;
 	struct CatalogEntry *ce, *cea;
 	int en;
 	int ret;
 
 	cea = &a->VlCe;
-	rsp.GrStatus = -1;
+	rsp->GrStatus = -1;
 	ce = CS_CatalogGetCeByLoc(cea->CeEq, cea->CeSlot, cea->CePart);
 
 	/*
@@ -1735,7 +1827,7 @@ VolumeLoaded(
 	} else {
 		ce->CeAccess++;
 	}
-	rsp.GrStatus = 0;
+	rsp->GrStatus = 0;
 
 out:
 	/*
@@ -1755,8 +1847,8 @@ out:
 		ce = NextCartridgeEntry(ce, en++);
 	}
 
-	TraceRequest(hdr, &rsp, "VolumeLoaded(%s)", VolStringFromCe(cea));
-	return (&rsp);
+	TraceRequest(hdr, rsp, "VolumeLoaded(%s)", VolStringFromCe(cea));
+	return (rsp);
 }
 
 
@@ -1768,12 +1860,12 @@ VolumeUnloaded(
 	void *arg,
 	struct UdsMsgHeader *hdr)
 {
-	static struct CsrGeneralRsp rsp;
+	struct CsrGeneralRsp *rsp = &GetRequestContext()->RcRsp.RcGeneral;
 	struct CsrVolumeUnloaded *a = (struct CsrVolumeUnloaded *)arg;
 	struct CatalogEntry *ce = NULL;
 	int		en;
 
-	rsp.GrStatus = -1;
+	rsp->GrStatus = -1;
 	if ((a->SfVid.ViFlags & VI_logical) == VI_logical) {
 		ce = CS_CatalogGetCeByMedia(a->SfVid.ViMtype, a->SfVid.ViVsn);
 	} else if ((a->SfVid.ViFlags & VI_cart) == VI_cart) {
@@ -1798,7 +1890,7 @@ VolumeUnloaded(
 		    a->SfVid.ViMtype, a->SfBarcode);
 	}
 	if (ce == NULL) {
-		TraceRequest(hdr, &rsp,
+		TraceRequest(hdr, rsp,
 		    "VolumeUnloaded(%s, flags=0x%x, bc=%s):no entry found",
 		    StringFromVolId(&a->SfVid), a->SfVid.ViFlags, a->SfBarcode);
 	}
@@ -1808,7 +1900,7 @@ VolumeUnloaded(
 	 */
 	en = 0;
 	while (ce != NULL) {
-		rsp.GrStatus = 0;
+		rsp->GrStatus = 0;
 		ce->CeStatus |= CES_occupied;
 		ce->CeStatus &= ~CES_unavail;
 		if (RemoteServer) {
@@ -1820,9 +1912,9 @@ VolumeUnloaded(
 		ce = NextCartridgeEntry(ce, en++);
 	}
 
-	TraceRequest(hdr, &rsp, "VolumeUnloaded(%s, %s)",
+	TraceRequest(hdr, rsp, "VolumeUnloaded(%s, %s)",
 	    StringFromVolId(&a->SfVid), a->SfBarcode);
-	return (&rsp);
+	return (rsp);
 }
 
 
@@ -2029,6 +2121,24 @@ GetFreeSlot(
 }
 
 
+/*
+ * Return the request context of the calling thread.
+ */
+static struct RequestContext *
+GetRequestContext(void)
+{
+	struct RequestContext *rc;
+
+	rc = (struct RequestContext *)pthread_getspecific(ContextKey);
+	if (rc == NULL) {
+		SamMalloc(rc, sizeof (struct RequestContext));
+		memset(rc, 0, sizeof (struct RequestContext));
+		(void) pthread_setspecific(ContextKey, rc);
+	}
+	return (rc);
+}
+
+
 /*
  * Increase the size of a catalog.
  */
@@ -2191,7 +2301,7 @@ NextCartridgeEntry(
 	struct CatalogEntry *cea,
 	int en)
 {
-	static struct CatalogEntry *ce, *ce_end;
+	struct RequestContext *rc = GetRequestContext();
 
 	if (0 == en) {
 		struct CatalogHdr *ch;
@@ -2201,17 +2311,17 @@ NextCartridgeEntry(
 			return (NULL);
 		}
 		ch = Catalogs[nc].CmHdr;
-		ce = &ch->ChTable[0];
-		ce_end = &ch->ChTable[ch->ChNumofEntries];
+		rc->RcCe = &ch->ChTable[0];
+		rc->RcCeEnd = &ch->ChTable[ch->ChNumofEntries];
 	}
 
 	/*
 	 * Find next entry with matching slot.
 	 */
-	while (ce < ce_end) {
+	while (rc->RcCe < rc->RcCeEnd) {
 		struct CatalogEntry *cet;
 
-		cet = ce++;
+		cet = rc->RcCe++;
 		if (cet != cea && (cet->CeStatus & CES_inuse) &&
 		    cet->CeSlot == cea->CeSlot) {
 			return (cet);
@@ -2221,6 +2331,124 @@ NextCartridgeEntry(
 }
 
 
+/*
+ * Begin a request.
+ * Take the locks the request needs.
+ */
+static void
+RequestBegin(
+	int type,
+	void *arg)
+{
+	struct RequestContext *rc = GetRequestContext();
+
+	(void) pthread_rwlock_rdlock(&CatalogsLock);
+	rc->RcCatalog = RequestCatalog(type, arg);
+	if (rc->RcCatalog == RC_all) {
+		(void) pthread_rwlock_unlock(&CatalogsLock);
+		(void) pthread_rwlock_wrlock(&CatalogsLock);
+	} else if (rc->RcCatalog >= 0) {
+		(void) pthread_mutex_lock(&CatalogLocks[rc->RcCatalog].ClMutex);
+	}
+}
+
+
+/*
+ * Return the catalog a request is confined to.
+ * Lookups by media type and VSN, duplicate VSN checks, changes that may
+ * grow a catalog, and all requests while serving remote clients are not
+ * confined.  Called with the catalog table lock held shared.
+ */
+static int			/* Catalog number, RC_shared, or RC_all */
+RequestCatalog(
+	int type,
+	void *arg)
+{
+	union argbuf *a = (union argbuf *)arg;
+	struct VolId *vid = NULL;
+	int		eq;
+	int		nc;
+
+	if (type == CSR_GetInfo) {
+		return (RC_shared);
+	}
+	if (RemoteServer) {
+		return (RC_all);
+	}
+	switch (type) {
+	case CSR_MediaClosed:
+		eq = a->CsrMediaClosed.SfCe.CeEq;
+		break;
+	case CSR_MoveSlot:
+		vid = &a->CsrMoveSlot.MsVid;
+		break;
+	case CSR_ReserveVolume:
+		vid = &a->CsrReserveVolume.RvVid;
+		break;
+	case CSR_SetAudit:
+		eq = a->CsrSetAudit.SaEq;
+		break;
+	case CSR_SetField:
+		if (a->CsrSetField.SfField == CEF_MediaType ||
+		    a->CsrSetField.SfField == CEF_Vsn) {
+			return (RC_all);
+		}
+		vid = &a->CsrSetField.SfVid;
+		break;
+	case CSR_UnReserveVolume:
+		vid = &a->CsrUnReserveVolume.UrVid;
+		break;
+	case CSR_VolumeUnloaded:
+		if ((a->CsrVolumeUnloaded.SfVid.ViFlags & VI_logical) ==
+		    VI_logical) {
+			return (RC_all);
+		}
+		eq = a->CsrVolumeUnloaded.SfVid.ViEq;
+		break;
+	default:
+		return (RC_all);
+	}
+	if (vid != NULL) {
+		if (vid->ViFlags == VI_logical) {
+			return (RC_all);
+		}
+		eq = vid->ViEq;
+	}
+	if ((nc = FindCatalog(eq)) == -1) {
+		return (RC_all);
+	}
+	return (nc);
+}
+
+
+/*
+ * End a request.
+ * Note the catalogs changed, and release the locks.
+ */
+/*ARGSUSED*/
+static void
+RequestEnd(
+	int type,
+	void *arg)
+{
+	struct RequestContext *rc = GetRequestContext();
+
+	if (rc->RcCatalog == RC_all) {
+		int		nc;
+
+		for (nc = 0; nc < CatalogTable->CtNumofFiles; nc++) {
+			CatalogLocks[nc].ClDirty = TRUE;
+		}
+	} else if (rc->RcCatalog >= 0) {
+		struct CatalogLock *cl = &CatalogLocks[rc->RcCatalog];
+
+		cl->ClDirty = TRUE;
+		(void) pthread_mutex_unlock(&cl->ClMutex);
+	}
+	(void) pthread_rwlock_unlock(&CatalogsLock);
+}
+
+
 /*
  * If checkall, check each entry in each catalog against all
  * catalog entries. Mark any duplicates found and
@@ -2338,7 +2566,9 @@ static void
 SrvrLogit(
 	char *msg)
 {
+	(void) pthread_mutex_lock(&TraceMutex);
 	errors++;
+	(void) pthread_mutex_unlock(&TraceMutex);
 	Trace(TR_ERR, "%s", msg);
 }
 
@@ -2365,11 +2595,11 @@ static char *
 StringFromVolId(
 	struct VolId *vid)
 {
-	static char buf[256];
+	char *buf = GetRequestContext()->RcVolString;
 	char *p, *p_end;
 
 	p = buf;
-	p_end = buf + sizeof (buf) - 1;
+	p_end = buf + sizeof (GetRequestContext()->RcVolString) - 1;
 
 	/*
 	 * Include valid fields.
@@ -2404,6 +2634,56 @@ StringFromVolId(
 }
 
 
+/*
+ * Write the changed catalogs to disk.
+ * Called with the catalog table lock held.
+ */
+static void
+SyncCatalogs(void)
+{
+	int		nc;
+
+	for (nc = 0; nc < CatalogTable->CtNumofFiles; nc++) {
+		struct CatalogLock *cl = &CatalogLocks[nc];
+		boolean_t dirty;
+
+		(void) pthread_mutex_lock(&cl->ClMutex);
+		dirty = cl->ClDirty;
+		cl->ClDirty = FALSE;
+		(void) pthread_mutex_unlock(&cl->ClMutex);
+		if (!dirty) {
+			continue;
+		}
+		if (msync((caddr_t)Catalogs[nc].CmHdr, Catalogs[nc].CmSize,
+		    MS_SYNC) == -1) {
+			Trace(TR_ERR, "msync(%s) failed",
+			    CatalogTable->CtFname[nc]);
+		}
+		syncs++;
+	}
+}
+
+
+/*
+ * Catalog sync thread.
+ * The changes of all requests made during an interval are written
+ * with one msync() per catalog.
+ */
+/*ARGSUSED0*/
+static void *
+SyncThread(
+	void *arg)
+{
+	while (!srvr.UsStop) {
+		(void) sleep(CATALOG_SYNC_INTERVAL);
+		(void) pthread_rwlock_rdlock(&CatalogsLock);
+		SyncCatalogs();
+		(void) pthread_rwlock_unlock(&CatalogsLock);
+	}
+	return (NULL);
+}
+
+
 /*
  * Trace server request.
  * Returns errno to caller.
@@ -2426,17 +2706,26 @@ TraceRequest(
 	} else {
 		*msg = '\0';
 	}
-	TraceName = hdr->UhName;
-	TracePid = hdr->UhPid;
 	if (rsp != NULL && rsp->GrStatus == -1) {
 		rsp->GrErrno = errno;
-		_Trace(TR_err, hdr->UhSrcFile, hdr->UhSrcLine, "%s", msg);
+	}
+
+	/*
+	 * Requests are traced concurrently, so TraceName and TracePid
+	 * are left alone and the client is named in the message.
+	 */
+	if (rsp != NULL && rsp->GrStatus == -1) {
+		_Trace(TR_err, hdr->UhSrcFile, hdr->UhSrcLine, "%.*s[%ld]: %s",
+		    (int)sizeof (hdr->UhName), hdr->UhName, (long)hdr->UhPid,
+		    msg);
 	} else {
-		_Trace(TR_misc, hdr->UhSrcFile, hdr->UhSrcLine, "%s", msg);
+		_Trace(TR_misc, hdr->UhSrcFile, hdr->UhSrcLine, "%.*s[%ld]: %s",
+		    (int)sizeof (hdr->UhName), hdr->UhName, (long)hdr->UhPid,
+		    msg);
 	}
-	TraceName = program_name;
-	TracePid = getpid();
+	(void) pthread_mutex_lock(&TraceMutex);
 	msgs_processed++;
+	(void) pthread_mutex_unlock(&TraceMutex);
 }
 
 
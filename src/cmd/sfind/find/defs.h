@@ -50,6 +50,10 @@ typedef unsigned int boolean;
 #define		true    1
 #define		false	0
 
+/* Storage class of the state kept while a file is being evaluated.
+   Each walker thread evaluates its own files (see walk.c). */
+#define		WALK_LOCAL	__thread
+
 /* Pointer to function returning boolean. */
 typedef boolean (*PFB)();
 
@@ -179,6 +183,10 @@ struct predicate
   /* True if this predicate node requires a stat system call to execute. */
   boolean need_stat;
 
+  /* For an action run by several walker threads, the function that
+     implements it; `pred_func' is then pred_serial. */
+  PFB action_func;
+
   /* Information needed by the predicate processor.
      Next to each member are listed the predicates that use it. */
   union
@@ -231,18 +239,25 @@ extern struct predicate *last_pred;
 extern boolean do_dir_first;
 extern int maxdepth;
 extern int mindepth;
-extern int curdepth;
+extern WALK_LOCAL int curdepth;
 extern time_t cur_day_start;
 extern boolean full_days;
 extern boolean no_leaf_check;
 extern boolean stay_on_filesystem;
-extern boolean stop_at_current_level;
-extern boolean have_stat;
-extern boolean have_seg_stat;
-extern int seg_buf_capacity;
+extern WALK_LOCAL boolean stop_at_current_level;
+extern WALK_LOCAL boolean have_stat;
+extern WALK_LOCAL boolean have_seg_stat;
+extern WALK_LOCAL int seg_buf_capacity;
 extern int exit_status;
 extern int path_length;
 extern int (*StatFunc)(const char *path, struct sam_stat *buf, size_t bufsize);
 extern boolean output_data_segments;
-extern char *current_pathname;
-extern struct sam_stat *segment_stat_ptr;
+extern WALK_LOCAL char *current_pathname;
+extern WALK_LOCAL struct sam_stat *segment_stat_ptr;
+extern int walk_threads;
+extern boolean walk_ordered;
+
+void apply_predicate(char *pathname, struct sam_stat *stat_buf_ptr,
+		     struct predicate *eval_tree_ptr);
+void serialize_actions (struct predicate *tree);
+void walk_path (char *pathname, struct predicate *eval_tree_ptr);
@@ -68,6 +68,8 @@ boolean parse_open ();
 boolean parse_close ();
 
 static void scan_directory ();
+static void scan_directory_stat ();
+static void stat_ent_path ();
 static int process_path ();
 
 /* All predicates for each path to process. */
@@ -89,7 +91,7 @@ int maxdepth;
 int mindepth;
 
 /* Current depth; 0 means current path is a command line arg. */
-int curdepth;
+WALK_LOCAL int curdepth;
 
 /* Seconds between 00:00 1/1/70 and either one day before now
    (the default), or the start of today (if -daystart is given). */
@@ -107,19 +109,19 @@ boolean stay_on_filesystem;
 
 /* If true, don't descend past current directory.
    Can be set by -prune, -maxdepth, and -xdev. */
-boolean stop_at_current_level;
+WALK_LOCAL boolean stop_at_current_level;
 
 /* If true, we have called stat on the current path. */
-boolean have_stat;
+WALK_LOCAL boolean have_stat;
 
 /* Pointer to stat buffer for data segment stat */
-struct sam_stat *segment_stat_ptr;
+WALK_LOCAL struct sam_stat *segment_stat_ptr;
 
 /* Number of segs for which *segment_stat_ptr can hold stat information. */
-int seg_buf_capacity = 0;
+WALK_LOCAL int seg_buf_capacity = 0;
 
 /* True if sam_segment_vsn stat has been performed on the current path. */
-boolean have_seg_stat = false;
+WALK_LOCAL boolean have_seg_stat = false;
 
 /* True if use selects the segments option to apply sfind to segmented file's
  * individual data segments.
@@ -138,13 +140,20 @@ int path_length;
 int (*StatFunc)(const char *path, struct sam_stat *buf, size_t bufsize);
 
 /* Pointer for storing the pathname of the file followed by /segment_number */
-char *seg_pathname = (char *) NULL;
+WALK_LOCAL char *seg_pathname = (char *) NULL;
 
 /* Pointer to the current pathname being tested by sfind. */
-char *current_pathname = (char *) NULL;
+WALK_LOCAL char *current_pathname = (char *) NULL;
 
 /* Length of the buffer seg_pathname */
-int seg_pathname_buf_size = 0;
+WALK_LOCAL int seg_pathname_buf_size = 0;
+
+/* Number of threads walking the tree; 1 walks it in this thread. */
+int walk_threads;
+
+/* If true, files are evaluated in the order a single thread would
+   visit them (see walk.c). */
+boolean walk_ordered;
 
 int
 main (argc, argv)
@@ -175,6 +184,8 @@ main (argc, argv)
   have_seg_stat             = false;
   seg_buf_capacity          = 0;
   output_data_segments      = false;
+  walk_threads              = 1;
+  walk_ordered              = false;
 
 #ifdef DEBUG
   printf ("cur_day_start = %s", ctime (&cur_day_start));
@@ -248,6 +259,14 @@ main (argc, argv)
   /* Determine the point, if any, at which to stat the file. */
   mark_stat (eval_tree);
 
+  /* A directory can only follow its contents (-depth) when the files
+     are evaluated in order.  Otherwise actions run by several walker
+     threads are run one at a time. */
+  if (walk_threads > 1 && do_dir_first == false)
+    walk_ordered = true;
+  if (walk_threads > 1 && walk_ordered == false)
+    serialize_actions (eval_tree);
+
 #ifdef DEBUG
   printf ("Optimized Eval Tree:\n");
   print_tree (eval_tree, 0);
@@ -258,13 +277,19 @@ main (argc, argv)
     {
       curdepth = 0;
       path_length = strlen (argv[i]);
-      process_path (argv[i], false);
+      if (walk_threads > 1)
+	walk_path (argv[i], eval_tree);
+      else
+	process_path (argv[i], false, NULL);
     }
   if (i == 1)
     {
       curdepth = 0;
       path_length = 1;
-      process_path (".", false);
+      if (walk_threads > 1)
+	walk_path (".", eval_tree);
+      else
+	process_path (".", false, NULL);
     }
 
   free_memory_used_for_testing_segments();
@@ -277,12 +302,16 @@ main (argc, argv)
    unexamined subdirectories, and therefore it is not a directory.
    This allows us to avoid stat as long as possible for leaf files.
 
+   STATP, if nonzero, is the status of PATHNAME already read with
+   *StatFunc.
+
    Return nonzero iff PATHNAME is a directory. */
 
 static int
-process_path (pathname, leaf)
+process_path (pathname, leaf, statp)
      char *pathname;
      boolean leaf;
+     struct sam_stat *statp;
 {
   struct sam_stat stat_buf;
   int pathlen;			/* Length of PATHNAME. */
@@ -295,7 +324,12 @@ process_path (pathname, leaf)
 
   have_seg_stat = false;
 
-  if (leaf)
+  if (statp)
+    {
+      stat_buf = *statp;
+      have_stat = true;
+    }
+  else if (leaf)
     have_stat = false;
   else
     {
@@ -367,6 +401,12 @@ scan_directory (pathname, pathlen, statp)
   char *name_space;		/* Names of files in PATHNAME. */
   int subdirs_left;		/* Number of unexamined subdirs in PATHNAME. */
 
+  if (StatFunc == sam_lstat)
+    {
+      scan_directory_stat (pathname, pathlen, statp);
+      return;
+    }
+
   subdirs_left = statp->st_nlink - 2; /* Account for name and ".". */
 
   errno = 0;
@@ -427,11 +467,11 @@ scan_directory (pathname, pathlen, statp)
 	       subdirectories as there are additional links, we know
 	       that the rest of the entries are non-directories --
 	       in other words, leaf files. */
-	    subdirs_left -= process_path (cur_path, subdirs_left == 0);
+	    subdirs_left -= process_path (cur_path, subdirs_left == 0, NULL);
 	  else
 	    /* There might be weird (NFS?) filesystems mounted,
 	       which don't have Unix-like directory link counts. */
-	    process_path (cur_path, false);
+	    process_path (cur_path, false, NULL);
 	  curdepth--;
 	}
       if (cur_path)
@@ -440,6 +480,179 @@ scan_directory (pathname, pathlen, statp)
     }
 }
 
+/* An entry saved by scan_directory_stat to be processed after the
+   directory is closed. */
+struct stat_ent
+{
+  unsigned name;		/* Offset of the name in the name space. */
+  int error;			/* errno if its status could not be read. */
+  struct sam_stat st;
+};
+
+/* Append entry name NAMEP to the path being searched in *CUR_PATH,
+   which holds PATHNAME; PATHNAME_LEN is the length of PATHNAME plus
+   '/' and '\0'. */
+
+static void
+stat_ent_path (pathname, pathname_len, namep, cur_path, cur_path_size)
+     char *pathname;
+     unsigned pathname_len;
+     char *namep;
+     char **cur_path;
+     unsigned *cur_path_size;
+{
+  unsigned file_len = pathname_len + strlen (namep);
+
+  if (file_len > *cur_path_size)
+    {
+      while (file_len > *cur_path_size)
+	*cur_path_size += 1024;
+      if (*cur_path)
+	free (*cur_path);
+      *cur_path = xmalloc (*cur_path_size);
+      strcpy (*cur_path, pathname);
+      (*cur_path)[pathname_len - 2] = '/';
+    }
+  strcpy (*cur_path + pathname_len - 1, namep);
+}
+
+/* Scan directory PATHNAME reading the entries together with their
+   status, and recurse through process_path for each entry.
+   PATHLEN is the length of PATHNAME.
+   STATP is the results of *StatFunc on it.  Used when not following
+   symbolic links, where the entry status is what *StatFunc would return.
+
+   Entries which are not directories are processed as they are read,
+   they do not descend.  Only the subdirectories and the entries whose
+   status could not be read are saved, and processed once the directory
+   is closed, so that a deep tree does not hold a descriptor per level
+   and a large directory is not held in memory. */
+
+static void
+scan_directory_stat (pathname, pathlen, statp)
+     char *pathname;
+     int pathlen;
+     struct sam_stat *statp;
+{
+  sam_dirstat_t *dsp;		/* Bulk status handle for PATHNAME. */
+  struct sam_dirstat_ent *ents;	/* Current batch of entries. */
+  struct stat_ent *saved;	/* Entries to process after closing. */
+  int saved_size;		/* Entries allocated for `saved'. */
+  int nsaved;
+  char *name_space;		/* Names of the saved entries. */
+  unsigned name_size;		/* Bytes allocated for `name_space'. */
+  unsigned name_len;		/* Bytes used in `name_space'. */
+  int subdirs_left;		/* Number of unexamined subdirs in PATHNAME. */
+  int i, n;
+  char *cur_path;		/* Full path of each file to process. */
+  unsigned cur_path_size;	/* Bytes allocated for `cur_path'. */
+  register unsigned pathname_len; /* PATHLEN plus trailing '/'. */
+
+  errno = 0;
+  dsp = sam_opendir_stat (pathname);
+  if (dsp == NULL)
+    {
+      fflush (stdout);
+      error (0, errno, "%s", pathname);
+      exit_status = 1;
+      return;
+    }
+
+  if (pathname[pathlen - 1] == '/')
+    pathname_len = pathlen + 1; /* For '\0'; already have '/'. */
+  else
+    pathname_len = pathlen + 2; /* For '/' and '\0'. */
+  cur_path_size = 0;
+  cur_path = NULL;
+  subdirs_left = statp->st_nlink - 2; /* Account for name and ".". */
+
+  saved = NULL;
+  saved_size = 0;
+  nsaved = 0;
+  name_space = NULL;
+  name_size = 0;
+  name_len = 0;
+  while ((n = sam_readdir_stat (dsp, &ents)) > 0)
+    for (i = 0; i < n; i++)
+      {
+	char *namep = ents[i].name;
+	unsigned len;
+
+	if (namep[0] == '.'
+	    && (namep[1] == '\0' || (namep[1] == '.' && namep[2] == '\0')))
+	  continue;
+
+	if (ents[i].error == 0 && !S_ISDIR (ents[i].st.st_mode))
+	  {
+	    stat_ent_path (pathname, pathname_len, namep,
+			   &cur_path, &cur_path_size);
+	    curdepth++;
+	    (void) process_path (cur_path, false, &ents[i].st);
+	    curdepth--;
+	    continue;
+	  }
+
+	if (nsaved == saved_size)
+	  {
+	    saved_size = saved_size ? saved_size * 2 : 64;
+	    saved = (struct stat_ent *)
+	      xrealloc ((char *) saved, saved_size * sizeof (struct stat_ent));
+	  }
+	len = strlen (namep) + 1;
+	if (name_len + len > name_size)
+	  {
+	    while (name_len + len > name_size)
+	      name_size += 1024;
+	    name_space = xrealloc (name_space, name_size);
+	  }
+	strcpy (name_space + name_len, namep);
+	saved[nsaved].name = name_len;
+	saved[nsaved].error = ents[i].error;
+	if (ents[i].error == 0)
+	  saved[nsaved].st = ents[i].st;
+	name_len += len;
+	nsaved++;
+      }
+  if (n < 0)
+    {
+      fflush (stdout);
+      error (0, errno, "%s", pathname);
+      exit_status = 1;
+    }
+  (void) sam_closedir_stat (dsp);
+
+  /* Subdirectories first, so that the link count can show that the
+     entries whose status could not be read are leaves; see
+     scan_directory.  Those are stat'ed again by process_path, which
+     reports the error. */
+  for (i = 0; i < nsaved; i++)
+    if (saved[i].error == 0)
+      {
+	stat_ent_path (pathname, pathname_len, name_space + saved[i].name,
+		       &cur_path, &cur_path_size);
+	curdepth++;
+	subdirs_left -= process_path (cur_path, false, &saved[i].st);
+	curdepth--;
+      }
+  for (i = 0; i < nsaved; i++)
+    if (saved[i].error != 0)
+      {
+	stat_ent_path (pathname, pathname_len, name_space + saved[i].name,
+		       &cur_path, &cur_path_size);
+	curdepth++;
+	subdirs_left -= process_path (cur_path,
+				      !no_leaf_check && subdirs_left == 0,
+				      NULL);
+	curdepth--;
+      }
+  if (cur_path)
+    free (cur_path);
+  if (name_space)
+    free (name_space);
+  if (saved)
+    free ((char *) saved);
+}
+
 /* Return true if there are no side effects in any of the predicates in
    predicate list PRED, false if there are any. */
 
@@ -134,6 +134,8 @@ static boolean parse_used ();
 static boolean parse_user ();
 static boolean parse_version ();
 static boolean parse_xdev ();
+static boolean parse_threads ();
+static boolean parse_ordered ();
 static boolean parse_xtype ();
 
 boolean pred_amin ();
@@ -457,6 +459,8 @@ static struct parser_table_t const parse_table[] =
   {"rpermanent", parse_permanent},	/* SUN */
   {"project", parse_project},
   {"xattr", parse_xattr},		/* SUN */
+  {"threads", parse_threads},		/* SUN */
+  {"ordered", parse_ordered},		/* SUN */
   {0, 0}
 };
 
@@ -2470,6 +2474,34 @@ int *arg_ptr)
 	return(true);
 }
 
+static boolean
+parse_threads (argv, arg_ptr)
+     char *argv[];
+     int *arg_ptr;
+{
+  int threads_len;
+
+  if ((argv == NULL) || (argv[*arg_ptr] == NULL))
+    return (false);
+  threads_len = strspn (argv[*arg_ptr], "0123456789");
+  if ((threads_len == 0) || (argv[*arg_ptr][threads_len] != '\0'))
+    return (false);
+  walk_threads = atoi (argv[*arg_ptr]);
+  if (walk_threads < 1)
+    return (false);
+  (*arg_ptr)++;
+  return (true);
+}
+
+static boolean
+parse_ordered (argv, arg_ptr)
+     char *argv[];
+     int *arg_ptr;
+{
+  walk_ordered = true;
+  return (true);
+}
+
 static boolean
 parse_data_segments (argv, arg_ptr)
 	 char *argv[];
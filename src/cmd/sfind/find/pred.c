@@ -47,6 +47,9 @@ struct passwd *getpwuid ();
 struct group *getgrgid ();
 #endif
 
+/* Buffer size for getpwuid_r and getgrgid_r. */
+#define ID_BUFLEN 4096
+
 #include "wait.h"
 
 #if defined(DIRENT) || defined(_POSIX_VERSION)
@@ -94,6 +97,7 @@ struct group *getgrgid ();
 #endif /* !_POSIX_SOURCE */
 
 #include <sys/stat.h>
+#include <pthread.h>
 #include <pub/stat.h>
 #include <pub/rminfo.h>
 #include "defs.h"
@@ -148,6 +152,7 @@ boolean pred_print0 ();
 /* no pred_printf */
 boolean pred_prune ();
 boolean pred_regex ();
+boolean pred_serial ();
 boolean pred_size ();
 boolean pred_true ();
 boolean pred_type ();
@@ -296,6 +301,7 @@ struct pred_assoc pred_table[] =
   {pred_print0, "print0  "},
   {pred_prune, "prune   "},
   {pred_regex, "regex   "},
+  {pred_serial, "serial  "},
   {pred_size, "size    "},
   {pred_true, "true    "},
   {pred_type, "type    "},
@@ -1327,7 +1333,21 @@ pred_nogroup (pathname, stat_buf, pred_ptr)
 
   return gid_unused[(unsigned) stat_buf->st_gid];
 #else
-  return getgrgid (stat_buf->st_gid) == NULL;
+  struct group gr;
+  struct group *g;
+  char buf[ID_BUFLEN];
+  int err;
+
+  /* Walker threads may test this concurrently. */
+#if defined(sun) && !defined(_POSIX_PTHREAD_SEMANTICS)
+  errno = 0;
+  g = getgrgid_r (stat_buf->st_gid, &gr, buf, sizeof (buf));
+  err = errno;
+#else
+  err = getgrgid_r (stat_buf->st_gid, &gr, buf, sizeof (buf), &g);
+#endif
+  /* A group too large for the buffer exists. */
+  return g == NULL && err != ERANGE;
 #endif
 }
 
@@ -1342,7 +1362,19 @@ pred_nouser (pathname, stat_buf, pred_ptr)
 
   return uid_unused[(unsigned) stat_buf->st_uid];
 #else
-  return getpwuid (stat_buf->st_uid) == NULL;
+  struct passwd pw;
+  struct passwd *p;
+  char buf[ID_BUFLEN];
+  int err;
+
+#if defined(sun) && !defined(_POSIX_PTHREAD_SEMANTICS)
+  errno = 0;
+  p = getpwuid_r (stat_buf->st_uid, &pw, buf, sizeof (buf));
+  err = errno;
+#else
+  err = getpwuid_r (stat_buf->st_uid, &pw, buf, sizeof (buf), &p);
+#endif
+  return p == NULL && err != ERANGE;
 #endif
 }
 
@@ -1509,6 +1541,26 @@ struct predicate *pred_ptr)
 	}
 }
 
+/* Serializes the actions run by walker threads. */
+static pthread_mutex_t action_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Run the action of PRED_PTR holding the action lock, so output and
+   commands from different walker threads are not interleaved. */
+
+boolean
+pred_serial (pathname, stat_buf, pred_ptr)
+     char *pathname;
+     struct sam_stat *stat_buf;
+     struct predicate *pred_ptr;
+{
+  boolean ret;
+
+  pthread_mutex_lock (&action_mutex);
+  ret = (*pred_ptr->action_func) (pathname, stat_buf, pred_ptr);
+  pthread_mutex_unlock (&action_mutex);
+  return (ret);
+}
+
 boolean
 pred_print (pathname, stat_buf, pred_ptr)
      char *pathname;
@@ -2695,7 +2747,7 @@ Predicate *pred_ptr)
 {
 	int c;
 	int n_vsns;
-	static struct sam_section vsns[MAX_VOLUMES];
+	static WALK_LOCAL struct sam_section vsns[MAX_VOLUMES];
 	
 	if (!SS_ISSAMFS(sb->attr))  return(false);
 	for (c = 0; c < MAX_ARCHIVE; c++) {	
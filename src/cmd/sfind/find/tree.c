@@ -30,10 +30,20 @@
 
 boolean pred_and ();
 boolean pred_comma ();
+boolean pred_exec ();
+boolean pred_fprint ();
+boolean pred_fprint0 ();
+boolean pred_fprintf ();
+boolean pred_fstype ();
+boolean pred_ls ();
 boolean pred_name ();
+boolean pred_ok ();
 boolean pred_or ();
 boolean pred_path ();
+boolean pred_print ();
+boolean pred_print0 ();
 boolean pred_regex ();
+boolean pred_serial ();
 
 static struct predicate *scan_rest ();
 static void merge_pred ();
@@ -445,3 +455,31 @@ mark_stat (tree)
       return (false);
     }
 }
+
+/* Make the actions in expression tree TREE run one at a time when
+   files are evaluated by several walker threads.  -regex and -fstype
+   are included, as the pattern buffer and the file system type cache
+   are not reentrant. */
+
+void
+serialize_actions (tree)
+     struct predicate *tree;
+{
+  PFB func;
+
+  if (tree == NULL)
+    return;
+  serialize_actions (tree->pred_left);
+  serialize_actions (tree->pred_right);
+
+  func = tree->pred_func;
+  if (func == pred_exec || func == pred_ok
+      || func == pred_print || func == pred_print0
+      || func == pred_fprint || func == pred_fprint0
+      || func == pred_fprintf || func == pred_ls
+      || func == pred_regex || func == pred_fstype)
+    {
+      tree->action_func = func;
+      tree->pred_func = pred_serial;
+    }
+}
@@ -83,6 +83,7 @@ get_new_pred ()
   last_pred->p_prec = NO_PREC;
   last_pred->side_effects = false;
   last_pred->need_stat = true;
+  last_pred->action_func = NULL;
   last_pred->args.str = NULL;
   last_pred->pred_next = NULL;
   last_pred->pred_left = NULL;
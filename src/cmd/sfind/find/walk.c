@@ -0,0 +1,697 @@
+/* walk.c -- walk a directory tree with several threads.
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 2, or (at your option)
+   any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.  */
+
+/* For the avoidance of doubt, except that if any license choice other
+   than GPL or LGPL is available it will apply instead, Sun elects to
+   use only the General Public License version 2 (GPLv2) at this time
+   for any software where a choice of GPL license versions is made
+   available with the language indicating that GPLv2 or any later
+   version may be used, or where a choice of which version of the GPL
+   is applied is otherwise unspecified. */
+
+/* With -threads N, the tree below each command line argument is walked
+   by N threads.  Each thread has a queue of directories waiting to be
+   read.  A thread takes the directory it queued last, and when its own
+   queue is empty takes the oldest directory queued by another thread.
+
+   By default each thread evaluates the files it reads, so files are
+   evaluated in no particular order.  The actions (see
+   serialize_actions) are run one at a time.
+
+   With -ordered (implied by -depth), the threads only read directories
+   and stat the entries ahead of this thread, which evaluates the files
+   in the same order as the single threaded walk.  A directory read
+   ahead is kept until it is evaluated; at most WALK_BUFMAX entries are
+   kept, after which this thread reads the directories it needs
+   itself.  */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <pub/stat.h>
+
+#include "defs.h"
+#include "savedir.h"
+
+char *xstrdup ();
+void free_memory_used_for_testing_segments ();
+
+/* Entries kept read ahead of the ordered evaluation. */
+#define WALK_BUFMAX (256 * 1024)
+
+enum walk_state
+{
+  WD_QUEUED,			/* Waiting in a queue. */
+  WD_RUNNING,			/* Being read. */
+  WD_DONE			/* Read, entries in `ents'. */
+};
+
+/* A directory entry read ahead for the ordered walk. */
+struct walk_ent
+{
+  char *name;
+  struct sam_stat st;
+  struct walk_dir *sub;		/* Subdirectory queued for reading. */
+};
+
+/* A directory to be read. */
+struct walk_dir
+{
+  char *path;
+  int depth;			/* Depth of the directory itself. */
+  enum walk_state state;
+  boolean cancelled;		/* Entries are no longer wanted. */
+  struct walk_ent *ents;	/* Ordered walk: the entries read. */
+  int nents;
+  int ents_size;
+};
+
+/* A thread's queue of directories. */
+struct walk_queue
+{
+  pthread_mutex_t lock;
+  struct walk_dir **dirs;	/* Circular, `head' is the oldest. */
+  int head;
+  int count;
+  int size;
+};
+
+/* Protects the counts and directory states below. */
+static pthread_mutex_t walk_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t walk_work_cv = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t walk_done_cv = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t walk_space_cv = PTHREAD_COND_INITIALIZER;
+
+static unsigned walk_gen;	/* Bumped when a directory is queued. */
+static int walk_pending;	/* Directories queued or being read. */
+static long walk_buffered;	/* Entries read and not yet evaluated. */
+static boolean walk_finished;
+
+static struct walk_queue *walk_queues;	/* 0 is this thread's. */
+static int walk_nqueues;
+static WALK_LOCAL int walk_self;	/* Index of the thread's queue. */
+
+static struct predicate *walk_tree;
+static dev_t walk_root_dev;
+
+static void *walk_worker (void *arg);
+static void walk_run (struct walk_dir *d);
+static void walk_read (struct walk_dir *d);
+static void walk_entry (struct walk_dir *d, char *path, char *name,
+			struct sam_stat *statp);
+static boolean walk_visit (char *path, int depth, struct sam_stat *statp);
+static boolean walk_descend (int depth, struct sam_stat *statp);
+static void walk_consume (struct walk_dir *d);
+static void walk_cancel (struct walk_dir *d);
+static struct walk_dir *walk_new (char *path, int depth);
+static void walk_free (struct walk_dir *d);
+static void walk_push (struct walk_dir *d);
+static struct walk_dir *walk_take (void);
+static boolean walk_unqueue (struct walk_dir *d);
+static char *walk_join (char *dir, char *name, char **bufp, unsigned *sizep);
+
+/* Walk the tree PATHNAME, evaluating EVAL_TREE_PTR for each file. */
+
+void
+walk_path (char *pathname, struct predicate *eval_tree_ptr)
+{
+  struct sam_stat stat_buf;
+  struct walk_dir *root;
+  pthread_t *tids;
+  int i;
+
+  walk_tree = eval_tree_ptr;
+  have_seg_stat = false;
+  if ((*StatFunc)(pathname, &stat_buf, sizeof(stat_buf)) != 0)
+    {
+      fflush (stdout);
+      error (0, errno, "StatFunc(%s)", pathname);
+      exit_status = 1;
+      return;
+    }
+  walk_root_dev = stat_buf.st_dev;
+
+  if (!walk_visit (pathname, 0, &stat_buf))
+    {
+      if (S_ISDIR (stat_buf.st_mode) && do_dir_first == false
+	  && 0 >= mindepth)
+	{
+	  curdepth = 0;
+	  apply_predicate (pathname, &stat_buf, walk_tree);
+	}
+      return;
+    }
+
+  walk_nqueues = walk_threads + 1;
+  walk_queues = (struct walk_queue *)
+    xmalloc (walk_nqueues * sizeof (struct walk_queue));
+  for (i = 0; i < walk_nqueues; i++)
+    {
+      pthread_mutex_init (&walk_queues[i].lock, NULL);
+      walk_queues[i].dirs = NULL;
+      walk_queues[i].head = 0;
+      walk_queues[i].count = 0;
+      walk_queues[i].size = 0;
+    }
+  walk_self = 0;
+  walk_pending = 0;
+  walk_buffered = 0;
+  walk_finished = false;
+
+  root = walk_new (pathname, 0);
+  walk_push (root);
+
+  tids = (pthread_t *) xmalloc (walk_threads * sizeof (pthread_t));
+  for (i = 0; i < walk_threads; i++)
+    if (pthread_create (&tids[i], NULL, walk_worker,
+			(void *) (long) (i + 1)) != 0)
+      error (1, errno, "cannot create walker thread");
+
+  if (walk_ordered)
+    {
+      walk_consume (root);
+      if (do_dir_first == false && 0 >= mindepth)
+	{
+	  curdepth = 0;
+	  apply_predicate (pathname, &stat_buf, walk_tree);
+	}
+    }
+
+  /* Wait for the queued directories to be read (or discarded). */
+  pthread_mutex_lock (&walk_lock);
+  while (walk_pending > 0)
+    pthread_cond_wait (&walk_done_cv, &walk_lock);
+  walk_finished = true;
+  pthread_cond_broadcast (&walk_work_cv);
+  pthread_cond_broadcast (&walk_space_cv);
+  pthread_mutex_unlock (&walk_lock);
+
+  for (i = 0; i < walk_threads; i++)
+    pthread_join (tids[i], NULL);
+  free (tids);
+  for (i = 0; i < walk_nqueues; i++)
+    {
+      pthread_mutex_destroy (&walk_queues[i].lock);
+      if (walk_queues[i].dirs)
+	free (walk_queues[i].dirs);
+    }
+  free (walk_queues);
+  walk_queues = NULL;
+}
+
+/* Walker thread.  ARG is the index of its queue. */
+
+static void *
+walk_worker (void *arg)
+{
+  struct walk_dir *d;
+  unsigned gen;
+
+  walk_self = (int) (long) arg;
+  for (;;)
+    {
+      pthread_mutex_lock (&walk_lock);
+      while (walk_ordered && walk_buffered > WALK_BUFMAX && !walk_finished)
+	pthread_cond_wait (&walk_space_cv, &walk_lock);
+      gen = walk_gen;
+      pthread_mutex_unlock (&walk_lock);
+
+      d = walk_take ();
+      if (d == NULL)
+	{
+	  boolean finished;
+
+	  pthread_mutex_lock (&walk_lock);
+	  while (gen == walk_gen && !walk_finished)
+	    pthread_cond_wait (&walk_work_cv, &walk_lock);
+	  finished = walk_finished;
+	  pthread_mutex_unlock (&walk_lock);
+	  if (finished)
+	    break;
+	  continue;
+	}
+
+      pthread_mutex_lock (&walk_lock);
+      if (d->cancelled)
+	{
+	  walk_pending--;
+	  pthread_cond_broadcast (&walk_done_cv);
+	  pthread_mutex_unlock (&walk_lock);
+	  walk_free (d);
+	  continue;
+	}
+      d->state = WD_RUNNING;
+      pthread_mutex_unlock (&walk_lock);
+      walk_run (d);
+    }
+  free_memory_used_for_testing_segments ();
+  return (NULL);
+}
+
+/* Read directory D, which the caller has set running. */
+
+static void
+walk_run (struct walk_dir *d)
+{
+  int i;
+
+  walk_read (d);
+
+  if (walk_ordered == false)
+    {
+      walk_free (d);
+      pthread_mutex_lock (&walk_lock);
+      walk_pending--;
+      pthread_cond_broadcast (&walk_done_cv);
+      pthread_mutex_unlock (&walk_lock);
+      return;
+    }
+
+  /* Queue the subdirectories, the first one last so it is read first. */
+  for (i = d->nents - 1; i >= 0; i--)
+    if (d->ents[i].sub)
+      walk_push (d->ents[i].sub);
+
+  pthread_mutex_lock (&walk_lock);
+  d->state = WD_DONE;
+  walk_buffered += d->nents;
+  if (d->cancelled)
+    walk_cancel (d);
+  walk_pending--;
+  pthread_cond_broadcast (&walk_done_cv);
+  pthread_mutex_unlock (&walk_lock);
+}
+
+/* Read the entries of directory D and stat them. */
+
+static void
+walk_read (struct walk_dir *d)
+{
+  char *path = NULL;		/* Full path of each entry. */
+  unsigned path_size = 0;	/* Bytes allocated for `path'. */
+
+  if (StatFunc == sam_lstat)
+    {
+      sam_dirstat_t *dsp;
+      struct sam_dirstat_ent *ents;
+      int i, n;
+
+      dsp = sam_opendir_stat (d->path);
+      if (dsp == NULL)
+	{
+	  fflush (stdout);
+	  error (0, errno, "%s", d->path);
+	  exit_status = 1;
+	  return;
+	}
+      while ((n = sam_readdir_stat (dsp, &ents)) > 0)
+	for (i = 0; i < n; i++)
+	  {
+	    char *namep = ents[i].name;
+
+	    if (namep[0] == '.' && (namep[1] == '\0'
+				    || (namep[1] == '.' && namep[2] == '\0')))
+	      continue;
+	    walk_join (d->path, namep, &path, &path_size);
+	    if (ents[i].error)
+	      {
+		fflush (stdout);
+		error (0, ents[i].error, "StatFunc(%s)", path);
+		exit_status = 1;
+		continue;
+	      }
+	    walk_entry (d, path, namep, &ents[i].st);
+	  }
+      if (n < 0)
+	{
+	  fflush (stdout);
+	  error (0, errno, "%s", d->path);
+	  exit_status = 1;
+	}
+      (void) sam_closedir_stat (dsp);
+    }
+  else
+    {
+      struct sam_stat stat_buf;
+      char *name_space;
+      char *namep;
+
+      errno = 0;
+      name_space = savedir (d->path, 512);
+      if (name_space == NULL)
+	{
+	  fflush (stdout);
+	  if (errno)
+	    error (0, errno, "%s", d->path);
+	  else
+	    error (0, 0, "virtual memory exhausted");
+	  exit_status = 1;
+	  return;
+	}
+      for (namep = name_space; *namep; namep += strlen (namep) + 1)
+	{
+	  walk_join (d->path, namep, &path, &path_size);
+	  if ((*StatFunc)(path, &stat_buf, sizeof(stat_buf)) != 0)
+	    {
+	      fflush (stdout);
+	      error (0, errno, "StatFunc(%s)", path);
+	      exit_status = 1;
+	      continue;
+	    }
+	  walk_entry (d, path, namep, &stat_buf);
+	}
+      free (name_space);
+    }
+  if (path)
+    free (path);
+}
+
+/* Handle entry NAME of directory D, PATH being its full path and STATP
+   its status.  Evaluate it, or keep it for the ordered walk. */
+
+static void
+walk_entry (struct walk_dir *d, char *path, char *name,
+	    struct sam_stat *statp)
+{
+  struct walk_ent *ep;
+
+  if (walk_ordered == false)
+    {
+      if (walk_visit (path, d->depth + 1, statp))
+	{
+	  struct walk_dir *sub = walk_new (path, d->depth + 1);
+
+	  walk_push (sub);
+	}
+      return;
+    }
+
+  if (d->nents == d->ents_size)
+    {
+      d->ents_size = d->ents_size ? d->ents_size * 2 : 64;
+      d->ents = (struct walk_ent *)
+	xrealloc ((char *) d->ents, d->ents_size * sizeof (struct walk_ent));
+    }
+  ep = &d->ents[d->nents++];
+  ep->name = xstrdup (name);
+  ep->st = *statp;
+  ep->sub = NULL;
+  if (walk_descend (d->depth + 1, statp))
+    ep->sub = walk_new (path, d->depth + 1);
+}
+
+/* Evaluate the file PATH at DEPTH with status STATP, as process_path
+   does.  Return true if it is a directory to be descended. */
+
+static boolean
+walk_visit (char *path, int depth, struct sam_stat *statp)
+{
+  curdepth = depth;
+  have_stat = true;
+  have_seg_stat = false;
+
+  if (!S_ISDIR (statp->st_mode))
+    {
+      if (curdepth >= mindepth)
+	apply_predicate (path, statp, walk_tree);
+      return (false);
+    }
+
+  stop_at_current_level = maxdepth >= 0 && curdepth >= maxdepth;
+  if (stay_on_filesystem && statp->st_dev != walk_root_dev)
+    stop_at_current_level = true;
+
+  if (do_dir_first && curdepth >= mindepth)
+    apply_predicate (path, statp, walk_tree);
+
+  return (!stop_at_current_level);
+}
+
+/* Return true if the entry at DEPTH with status STATP is a directory
+   that will be descended unless it is pruned. */
+
+static boolean
+walk_descend (int depth, struct sam_stat *statp)
+{
+  if (!S_ISDIR (statp->st_mode))
+    return (false);
+  if (maxdepth >= 0 && depth >= maxdepth)
+    return (false);
+  if (stay_on_filesystem && statp->st_dev != walk_root_dev)
+    return (false);
+  return (true);
+}
+
+/* Ordered walk: evaluate the entries of directory D in order,
+   descending into the subdirectories.  D is freed. */
+
+static void
+walk_consume (struct walk_dir *d)
+{
+  char *path = NULL;
+  unsigned path_size = 0;
+  int i;
+
+  pthread_mutex_lock (&walk_lock);
+  while (d->state != WD_DONE)
+    {
+      /* Read it here if no walker has taken it yet. */
+      if (d->state == WD_QUEUED && walk_unqueue (d))
+	{
+	  d->state = WD_RUNNING;
+	  pthread_mutex_unlock (&walk_lock);
+	  walk_run (d);
+	  pthread_mutex_lock (&walk_lock);
+	  continue;
+	}
+      pthread_cond_wait (&walk_done_cv, &walk_lock);
+    }
+  pthread_mutex_unlock (&walk_lock);
+
+  for (i = 0; i < d->nents; i++)
+    {
+      struct walk_ent *ep = &d->ents[i];
+      boolean descend;
+
+      walk_join (d->path, ep->name, &path, &path_size);
+      descend = walk_visit (path, d->depth + 1, &ep->st);
+      if (ep->sub)
+	{
+	  if (descend)
+	    walk_consume (ep->sub);
+	  else
+	    {
+	      pthread_mutex_lock (&walk_lock);
+	      walk_cancel (ep->sub);
+	      pthread_mutex_unlock (&walk_lock);
+	    }
+	  ep->sub = NULL;
+	}
+      if (S_ISDIR (ep->st.st_mode) && do_dir_first == false
+	  && d->depth + 1 >= mindepth)
+	{
+	  curdepth = d->depth + 1;
+	  apply_predicate (path, &ep->st, walk_tree);
+	}
+    }
+  if (path)
+    free (path);
+
+  pthread_mutex_lock (&walk_lock);
+  walk_buffered -= d->nents;
+  pthread_cond_broadcast (&walk_space_cv);
+  pthread_mutex_unlock (&walk_lock);
+  walk_free (d);
+}
+
+/* Discard directory D and the subdirectories queued from it.
+   Called with walk_lock held.  A directory not read yet is freed by
+   the thread that takes or reads it. */
+
+static void
+walk_cancel (struct walk_dir *d)
+{
+  int i;
+
+  if (d->state != WD_DONE)
+    {
+      d->cancelled = true;
+      return;
+    }
+  for (i = 0; i < d->nents; i++)
+    if (d->ents[i].sub)
+      {
+	walk_cancel (d->ents[i].sub);
+	d->ents[i].sub = NULL;
+      }
+  walk_buffered -= d->nents;
+  pthread_cond_broadcast (&walk_space_cv);
+  walk_free (d);
+}
+
+static struct walk_dir *
+walk_new (char *path, int depth)
+{
+  struct walk_dir *d;
+
+  d = (struct walk_dir *) xmalloc (sizeof (struct walk_dir));
+  d->path = xstrdup (path);
+  d->depth = depth;
+  d->state = WD_QUEUED;
+  d->cancelled = false;
+  d->ents = NULL;
+  d->nents = 0;
+  d->ents_size = 0;
+  return (d);
+}
+
+static void
+walk_free (struct walk_dir *d)
+{
+  int i;
+
+  for (i = 0; i < d->nents; i++)
+    free (d->ents[i].name);
+  if (d->ents)
+    free (d->ents);
+  free (d->path);
+  free (d);
+}
+
+/* Queue directory D on this thread's queue. */
+
+static void
+walk_push (struct walk_dir *d)
+{
+  struct walk_queue *q = &walk_queues[walk_self];
+
+  pthread_mutex_lock (&walk_lock);
+  walk_pending++;
+  pthread_mutex_unlock (&walk_lock);
+
+  pthread_mutex_lock (&q->lock);
+  if (q->count == q->size)
+    {
+      struct walk_dir **dirs;
+      int n = q->size ? q->size * 2 : 256;
+      int i;
+
+      dirs = (struct walk_dir **) xmalloc (n * sizeof (struct walk_dir *));
+      for (i = 0; i < q->count; i++)
+	dirs[i] = q->dirs[(q->head + i) % q->size];
+      if (q->dirs)
+	free (q->dirs);
+      q->dirs = dirs;
+      q->head = 0;
+      q->size = n;
+    }
+  q->dirs[(q->head + q->count) % q->size] = d;
+  q->count++;
+  pthread_mutex_unlock (&q->lock);
+
+  pthread_mutex_lock (&walk_lock);
+  walk_gen++;
+  pthread_cond_signal (&walk_work_cv);
+  pthread_mutex_unlock (&walk_lock);
+}
+
+/* Take a directory: the newest on this thread's queue, else the
+   oldest on another thread's queue.  Return NULL if all are empty. */
+
+static struct walk_dir *
+walk_take (void)
+{
+  struct walk_dir *d = NULL;
+  struct walk_queue *q;
+  int i;
+
+  q = &walk_queues[walk_self];
+  pthread_mutex_lock (&q->lock);
+  if (q->count > 0)
+    {
+      q->count--;
+      d = q->dirs[(q->head + q->count) % q->size];
+    }
+  pthread_mutex_unlock (&q->lock);
+
+  for (i = 1; d == NULL && i < walk_nqueues; i++)
+    {
+      q = &walk_queues[(walk_self + i) % walk_nqueues];
+      pthread_mutex_lock (&q->lock);
+      if (q->count > 0)
+	{
+	  d = q->dirs[q->head];
+	  q->head = (q->head + 1) % q->size;
+	  q->count--;
+	}
+      pthread_mutex_unlock (&q->lock);
+    }
+  return (d);
+}
+
+/* Remove directory D from whichever queue holds it, for the caller to
+   read.  Called with walk_lock held.  Return false if no queue does. */
+
+static boolean
+walk_unqueue (struct walk_dir *d)
+{
+  int i, j;
+
+  for (i = 0; i < walk_nqueues; i++)
+    {
+      struct walk_queue *q = &walk_queues[i];
+
+      pthread_mutex_lock (&q->lock);
+      for (j = 0; j < q->count; j++)
+	if (q->dirs[(q->head + j) % q->size] == d)
+	  {
+	    /* Close the gap with the newer entries. */
+	    for (; j < q->count - 1; j++)
+	      q->dirs[(q->head + j) % q->size] =
+		q->dirs[(q->head + j + 1) % q->size];
+	    q->count--;
+	    pthread_mutex_unlock (&q->lock);
+	    return (true);
+	  }
+      pthread_mutex_unlock (&q->lock);
+    }
+  return (false);
+}
+
+/* Build DIR/NAME in *BUFP, of *SIZEP bytes, growing it as needed. */
+
+static char *
+walk_join (char *dir, char *name, char **bufp, unsigned *sizep)
+{
+  unsigned dirlen = strlen (dir);
+  unsigned len = dirlen + strlen (name) + 2;
+
+  if (len > *sizep)
+    {
+      while (len > *sizep)
+	*sizep += 1024;
+      if (*bufp)
+	free (*bufp);
+      *bufp = xmalloc (*sizep);
+    }
+  strcpy (*bufp, dir);
+  if (dirlen == 0 || dir[dirlen - 1] != '/')
+    (*bufp)[dirlen++] = '/';
+  strcpy (*bufp + dirlen, name);
+  return (*bufp);
+}
@@ -542,12 +542,12 @@ main (argc, argv)
   if (i < argc)
 	dir_defaulted = 0;
   for (; i < argc; i++)
-	gobble_file (argv[i], 1, "");
+	gobble_file (argv[i], 1, "", NULL);
 
   if (dir_defaulted)
 	{
 	  if (immediate_dirs)
-		gobble_file (".", 1, "");
+		gobble_file (".", 1, "", NULL);
 	  else
 		queue_directory (".", 0);
 	}
@@ -930,29 +930,64 @@ print_dir (name, realname)
   register struct dirent *next;
   register int total_blocks = 0;
 
-  errno = 0;
-  reading = opendir (name);
-  if (!reading)
+  if (format_needs_stat)
 	{
-	  error (0, errno, "%s", name);
-	  exit_status = 1;
-	  return;
+	  /* The entries will all be stat'ed, read them in bulk with
+		 their status.  */
+	  sam_dirstat_t *dsp;
+	  struct sam_dirstat_ent *ents;
+	  int i, n;
+
+	  errno = 0;
+	  dsp = sam_opendir_stat (name);
+	  if (!dsp)
+		{
+		  error (0, errno, "%s", name);
+		  exit_status = 1;
+		  return;
+		}
+
+	  clear_files ();
+
+	  while ((n = sam_readdir_stat (dsp, &ents)) > 0)
+		for (i = 0; i < n; i++)
+		  if (file_interesting (ents[i].name))
+			total_blocks += gobble_file (ents[i].name, 0, name,
+				ents[i].error ? NULL : &ents[i].st);
+
+	  if (n < 0 || sam_closedir_stat (dsp))
+		{
+		  error (0, errno, "%s", name);
+		  exit_status = 1;
+		  /* Don't return; print whatever we got. */
+		}
 	}
+  else
+	{
+	  errno = 0;
+	  reading = opendir (name);
+	  if (!reading)
+		{
+		  error (0, errno, "%s", name);
+		  exit_status = 1;
+		  return;
+		}
 
-  /* Read the directory entries, and insert the subfiles into the `files'
-	 table.  */
+	  /* Read the directory entries, and insert the subfiles into the
+		 `files' table.  */
 
-  clear_files ();
+	  clear_files ();
 
-  while ((next = readdir (reading)) != NULL)
-	if (file_interesting (next))
-	  total_blocks += gobble_file (next->d_name, 0, name);
+	  while ((next = readdir (reading)) != NULL)
+		if (file_interesting (next->d_name))
+		  total_blocks += gobble_file (next->d_name, 0, name, NULL);
 
-  if (CLOSEDIR (reading))
-	{
-	  error (0, errno, "%s", name);
-	  exit_status = 1;
-	  /* Don't return; print whatever we got. */
+	  if (CLOSEDIR (reading))
+		{
+		  error (0, errno, "%s", name);
+		  exit_status = 1;
+		  /* Don't return; print whatever we got. */
+		}
 	}
 
   /* Sort the directory contents.  */
@@ -998,23 +1033,23 @@ add_ignore_pattern (pattern)
   ignore_patterns = ignore;
 }
 
-/* Return nonzero if the file in `next' should be listed. */
+/* Return nonzero if the file named `d_name' should be listed. */
 
 static int
-file_interesting (next)
-	 register struct dirent *next;
+file_interesting (d_name)
+	 register char *d_name;
 {
   register struct ignore_pattern *ignore;
 
   for (ignore = ignore_patterns; ignore; ignore = ignore->next)
-	if (fnmatch (ignore->pattern, next->d_name, FNM_PERIOD) == 0)
+	if (fnmatch (ignore->pattern, d_name, FNM_PERIOD) == 0)
 	  return 0;
 
   if (really_all_files
-	  || next->d_name[0] != '.'
+	  || d_name[0] != '.'
 	  || (all_files
-	  && next->d_name[1] != '\0'
-	  && (next->d_name[1] != '.' || next->d_name[2] != '\0')))
+	  && d_name[1] != '\0'
+	  && (d_name[1] != '.' || d_name[2] != '\0')))
 	return 1;
 
   return 0;
@@ -1042,13 +1077,15 @@ clear_files ()
 
 /* Add a file to the current table of files.
    Verify that the file exists, and print an error message if it does not.
+   If `statp' is nonzero it is the sam_lstat information for the file.
    Return the number of blocks that the file occupies.  */
 
 static int
-gobble_file (name, explicit_arg, dirname)
+gobble_file (name, explicit_arg, dirname, statp)
 	 char *name;
 	 int explicit_arg;
 	 char *dirname;
+	 struct sam_stat *statp;
 {
   register int blocks;
   register int val;
@@ -1075,7 +1112,12 @@ gobble_file (name, explicit_arg, dirname)
 		  attach (path, dirname, name);
 		}
 
-	  if (trace_links)
+	  if (statp && !(trace_links && S_ISLNK (statp->st_mode)))
+		{
+		  files[files_index].stat = *statp;
+		  val = 0;
+		}
+	  else if (trace_links)
 		{
 		  val = sam_stat(path, &files[files_index].stat,
 				sizeof(struct sam_stat));
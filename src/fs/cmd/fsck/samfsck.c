@@ -246,6 +246,25 @@ struct dup_inoblk *dup_last = NULL;
 int dup_length = 512;
 int cur_length = 0;
 
+/*
+ * Index over the duplicate block list.  Entries are chained by
+ * (ordinal, large dau) so a lookup probes one bucket instead of
+ * walking the whole list. dup_lo/dup_hi bound the duplicated blocks
+ * on each ordinal so a whole extent can be cleared with one compare.
+ */
+#define	DUP_NIL		(-1)
+#define	DUP_HASHMIN	1024
+#define	DUP_HASH(bn, ord) \
+	((int)((((uint64_t)(bn) ^ ((uint64_t)(ord) << 56)) * \
+	0x9e3779b97f4a7c15ULL) >> 40) & (dup_hsize - 1))
+int *dup_hash = NULL;		/* Bucket heads, index into dup list */
+int *dup_hnext = NULL;		/* Chain link for each dup list entry */
+int dup_hsize = 0;		/* Number of buckets, power of 2 */
+int dup_hcount = 0;		/* Number of entries in the index */
+int dup_hmax = 0;		/* Number of allocated dup_hnext links */
+sam_daddr_t dup_lo[UCHAR_MAX + 1];	/* Lowest dup block per ordinal */
+sam_daddr_t dup_hi[UCHAR_MAX + 1];	/* Highest dup block per ordinal */
+
 /* Hard link parent list */
 #define	HLP_COUNT 4
 struct hlp_list {
@@ -389,8 +408,12 @@ int check_bn(sam_ino_t ino, sam_daddr_t bn, int ord);
 int get_bn(struct sam_perm_inode *dp, offset_t offset, sam_daddr_t *bn,
 	int *ord, int correct);
 int check_duplicate(sam_ino_t ino, int dt, int bt, sam_daddr_t bn, int ord);
+int check_duplicate_range(sam_ino_t ino, int dt, sam_daddr_t bn,
+	sam_daddr_t len, int ord);
 void init_dup(void);
 void extend_dup(void);
+static void dup_hash_add(int idx, sam_daddr_t key, int ord);
+static void dup_hash_grow(void);
 void write_map(int ord);
 void update_block_counts_object(int ord);
 void build_sm_block(sam_daddr_t bn, int ord, int mask);
@@ -2986,13 +3009,8 @@ count_inode_blocks(struct sam_perm_inode *dp)	/* Inode entry */
 				bn0 = bn;
 				ord = dp->di.extent_ord[0];
 				dt = dp->di.status.b.meta;
-				while (dp->di.extent[1] > (bn - bn0)) {
-					if (check_duplicate(ino, dt, LG,
-					    bn, ord) > 0) {
-						inval_blks++;
-					}
-					bn += LG_DEV_BLOCK(mp, dt);
-				}
+				inval_blks += check_duplicate_range(ino, dt,
+				    bn0, (sam_daddr_t)dp->di.extent[1], ord);
 			}
 		} else {
 			for (ii = 0; ii < NOEXT; ii++) {
@@ -3646,7 +3664,7 @@ print_duplicate_list(sam_ino_t ino)
 
 /*
  * ----- check_duplicate - check duplicate
- * Scan the existing duplicates and if a match on first or second pass,
+ * Look up the existing duplicates and if a match on first or second pass,
  * add this ino, else make a new entry.  Remove the inode on third
  * pass and report the number of inodes left holding the block.
  */
@@ -3660,7 +3678,10 @@ check_duplicate(
 	int ord)		/* Disk ordinal */
 {
 	struct dup_inoblk *smp;
-	int add;
+	struct dup_inoblk *room;
+	sam_daddr_t key;
+	int matched;
+	int idx;
 	int i;
 	int count;
 
@@ -3668,76 +3689,65 @@ check_duplicate(
 	if (check_bn(ino, bn, ord)) {
 		return (1);
 	}
-	add = 0;
-	for (smp = (struct dup_inoblk *)dup_mm; smp <= dup_last; smp++) {
+	key = bn & ~((sam_daddr_t)SM_DEV_BLOCK(mp, dt) - 1);
+	room = NULL;
+	matched = 0;
+	if (key >= dup_lo[ord] && key <= dup_hi[ord]) {
+		idx = dup_hash[DUP_HASH(key, ord)];
+	} else {
+		idx = DUP_NIL;
+	}
+	for (; idx != DUP_NIL; idx = dup_hnext[idx]) {
+		smp = (struct dup_inoblk *)dup_mm + idx;
+		if (smp->bn != key || smp->ord != ord) {
+			continue;
+		}
+		matched = 1;
 
 		if (pass == FIRST_PASS || pass == SECOND_PASS) {
 
-			if (smp->bn == DUP_END) {	/* End of list */
-				smp->count = 0;
-				smp->free = 0;
-				if (add) {
-					break;
-				}
-				if (pass == FIRST_PASS) {
-					break;
-				}
-				return (0);
-			} else if ((smp->bn ==
-			    (bn & ~((sam_daddr_t)SM_DEV_BLOCK(mp, dt) - 1))) &&
-			    (smp->ord == ord)) {
-				if (bt == SM) {
-					if (!(smp->free & (1 << ((bn  &
-					    ((sam_daddr_t)SM_DEV_BLOCK(mp, dt) - 1)) >>
-					    DIF_SM_SHIFT(mp, dt))))) {
-						return (0);
-					}
-				}
-				count = (int)smp->count;
-				/* Ino already added */
-				for (i = 0; i < count; i++) {
-					if (smp->ino[i] == ino) {
-						return (0);
-					}
+			if (bt == SM) {
+				if (!(smp->free & (1 << ((bn  &
+				    ((sam_daddr_t)SM_DEV_BLOCK(mp, dt) - 1)) >>
+				    DIF_SM_SHIFT(mp, dt))))) {
+					return (0);
 				}
-				/* If room in entry */
-				if (count < SM_INOCOUNT) {
-					break;
+			}
+			count = (int)smp->count;
+			/* Ino already added */
+			for (i = 0; i < count; i++) {
+				if (smp->ino[i] == ino) {
+					return (0);
 				}
-				/* Make new entry because cur entry is full */
-				add = 1;
-
+			}
+			/* If room in entry; only the newest can have room */
+			if (count < SM_INOCOUNT) {
+				room = smp;
 			}
 
 		} else if (pass == THIRD_PASS) {
 
-			if (smp->bn == DUP_END) {
-				return (0);		/* End of list */
-			}
-			if ((smp->bn == (bn & ~(SM_DEV_BLOCK(mp, dt) - 1))) &&
-			    (smp->ord == ord)) {
-				if (bt == SM) {
-					if (!(smp->free & (1 << ((bn  &
-					    (SM_DEV_BLOCK(mp, dt) - 1)) >>
-					    DIF_SM_SHIFT(mp, dt))))) {
-						return (0);
-					}
+			if (bt == SM) {
+				if (!(smp->free & (1 << ((bn  &
+				    (SM_DEV_BLOCK(mp, dt) - 1)) >>
+				    DIF_SM_SHIFT(mp, dt))))) {
+					return (0);
 				}
-				for (i = 0; i < (int)smp->count; i++) {
-					/* Inode found */
-					if (smp->ino[i] == ino) {
-						smp->ino[i] = 0;
-						/* last on the list */
-						if ((int)--smp->count == 0) {
-							smp->bn = 0;
-							smp->ord = 0;
-							smp->free = 0;
-							smp->btype = 0;
-							smp->dtype = 0;
-						}
-						/* Dup inodes left */
-						return ((int)smp->count);
+			}
+			for (i = 0; i < (int)smp->count; i++) {
+				/* Inode found */
+				if (smp->ino[i] == ino) {
+					smp->ino[i] = 0;
+					/* last on the list */
+					if ((int)--smp->count == 0) {
+						smp->bn = 0;
+						smp->ord = 0;
+						smp->free = 0;
+						smp->btype = 0;
+						smp->dtype = 0;
 					}
+					/* Dup inodes left */
+					return ((int)smp->count);
 				}
 			}
 		}
@@ -3745,6 +3755,20 @@ check_duplicate(
 	if (pass == THIRD_PASS) {
 		return (0);				/* Not a dup block */
 	}
+	if (room != NULL) {
+		smp = room;
+	} else {
+		/*
+		 * Second pass only adds inodes to blocks found duplicated
+		 * in the first pass; a new entry when the current one is full.
+		 */
+		if (pass == SECOND_PASS && !matched) {
+			return (0);
+		}
+		smp = dup_last;
+		smp->count = 0;
+		smp->free = 0;
+	}
 
 	count = (int)smp->count;
 #ifdef	ABORT
@@ -3776,6 +3800,7 @@ check_duplicate(
 	} else {
 		smp->free = SM_BITS(mp, dt);
 	}
+	dup_hash_add((int)(smp - (struct dup_inoblk *)dup_mm), key, ord);
 	cur_length += sizeof (struct dup_inoblk);
 	if ((cur_length + sizeof (struct dup_inoblk)) >= dup_length) {
 		extend_dup();
@@ -3794,6 +3819,131 @@ check_duplicate(
 }
 
 
+/*
+ * ----- check_duplicate_range - check duplicates for a direct map extent
+ * Claim len large blocks starting at bn in one step.  If the whole extent
+ * is valid and lies outside every duplicated block on the ordinal, no
+ * per-block lookups are needed.
+ */
+
+int				/* Number of invalid blocks */
+check_duplicate_range(
+	sam_ino_t ino,		/* I-number */
+	int dt,			/* Data or meta device */
+	sam_daddr_t bn,		/* First block number */
+	sam_daddr_t len,	/* Length in blocks */
+	int ord)		/* Disk ordinal */
+{
+	sam_daddr_t bn0;
+	int inval = 0;
+
+	if (len == 0) {
+		return (0);
+	}
+	if (ord >= 0 && ord < fs_count &&
+	    bn >= (sam_daddr_t)nblock.eq[ord].fs.system &&
+	    (bn + len) <= (sam_daddr_t)nblock.eq[ord].fs.capacity) {
+		if (bn > dup_hi[ord] || (bn + len) <= dup_lo[ord]) {
+			return (0);
+		}
+	}
+	for (bn0 = bn; len > (bn - bn0); bn += LG_DEV_BLOCK(mp, dt)) {
+		if (check_duplicate(ino, dt, LG, bn, ord) > 0) {
+			inval++;
+		}
+	}
+	return (inval);
+}
+
+
+/*
+ * ----- dup_hash_add - Index a new dup list entry.
+ * Entries are appended to the tail of their chain so that the newest
+ * entry for a block, the only one that may have room, is found last.
+ */
+
+static void
+dup_hash_add(
+	int idx,		/* Index of entry in dup list */
+	sam_daddr_t key,	/* Large dau block number */
+	int ord)		/* Disk ordinal */
+{
+	int *linkp;
+
+	if (idx >= dup_hmax || (dup_hcount + 1) > (dup_hsize << 1)) {
+		dup_hash_grow();
+	}
+	dup_hnext[idx] = DUP_NIL;
+	for (linkp = &dup_hash[DUP_HASH(key, ord)]; *linkp != DUP_NIL;
+	    linkp = &dup_hnext[*linkp]) {
+		;
+	}
+	*linkp = idx;
+	if (dup_lo[ord] > dup_hi[ord]) {
+		dup_lo[ord] = dup_hi[ord] = key;
+	} else if (key < dup_lo[ord]) {
+		dup_lo[ord] = key;
+	} else if (key > dup_hi[ord]) {
+		dup_hi[ord] = key;
+	}
+	dup_hcount++;
+}
+
+
+/*
+ * ----- dup_hash_grow - Grow the dup list index and rehash.
+ */
+
+static void
+dup_hash_grow(void)
+{
+	struct dup_inoblk *smp;
+	int nlinks;
+	int i;
+
+	nlinks = dup_length / sizeof (struct dup_inoblk);
+	if (nlinks > dup_hmax) {
+		dup_hnext = (int *)realloc(dup_hnext, nlinks * sizeof (int));
+		if (dup_hnext == NULL) {
+			error(0, 0, catgets(catfd, SET, 1606,
+			    "malloc: %s\n"), "duplicate block index");
+			clean_exit(ES_malloc);
+		}
+		dup_hmax = nlinks;
+	}
+	if ((dup_hcount + 1) <= (dup_hsize << 1)) {
+		return;
+	}
+	dup_hsize = (dup_hsize == 0) ? DUP_HASHMIN : (dup_hsize << 1);
+	free(dup_hash);
+	dup_hash = (int *)malloc(dup_hsize * sizeof (int));
+	if (dup_hash == NULL) {
+		error(0, 0, catgets(catfd, SET, 1606,
+		    "malloc: %s\n"), "duplicate block index");
+		clean_exit(ES_malloc);
+	}
+	for (i = 0; i < dup_hsize; i++) {
+		dup_hash[i] = DUP_NIL;
+	}
+
+	/* Rechain in list order to keep the newest entry last */
+	for (smp = (struct dup_inoblk *)dup_mm, i = 0; smp < dup_last;
+	    smp++, i++) {
+		int *linkp;
+
+		dup_hnext[i] = DUP_NIL;
+		if (smp->count == 0) {
+			continue;
+		}
+		linkp = &dup_hash[DUP_HASH(smp->bn, smp->ord)];
+		while (*linkp != DUP_NIL) {
+			linkp = &dup_hnext[*linkp];
+		}
+		*linkp = i;
+	}
+}
+
+
 /*
  * ----- init_dup - Initialize the duplicate block file.
  */
@@ -3802,6 +3952,7 @@ void
 init_dup(void)
 {
 	struct dup_inoblk *smp;
+	int i;
 
 	sprintf(dup_name, "%s/%d.dup_blks", scratch_dir, (int)getpid());
 	if ((dup_fd = open(dup_name, O_CREAT|O_TRUNC|O_RDWR, 0600)) < 0) {
@@ -3830,6 +3981,13 @@ init_dup(void)
 	smp = (struct dup_inoblk *)dup_mm;
 	smp->bn = DUP_END;
 	dup_last = (struct dup_inoblk *)dup_mm;
+
+	/* Empty bounds on every ordinal; dup_hash_add sets them */
+	for (i = 0; i <= UCHAR_MAX; i++) {
+		dup_lo[i] = 1;
+		dup_hi[i] = 0;
+	}
+	dup_hash_grow();
 }
 
 
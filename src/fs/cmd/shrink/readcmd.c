@@ -73,6 +73,12 @@ static void number_of_streams(void);
 static void block_size(void);
 static void stage_files(void);
 static void stage_partial(void);
+static void io_budget(void);
+static void tolerance(void);
+static void fragments(void);
+static void max_files(void);
+static void progress_interval(void);
+static int get_number(int min, int max);
 static void read_config_msg(char *msg, int lineno, char *line);
 
 /*
@@ -87,6 +93,11 @@ static DirProc_t dirProcTable[] = {
 	{ "block_size",			block_size,		DP_value },
 	{ "stage_files",		stage_files,		DP_set },
 	{ "stage_partial",		stage_partial,		DP_set },
+	{ "io_budget",			io_budget,		DP_value },
+	{ "tolerance",			tolerance,		DP_value },
+	{ "fragments",			fragments,		DP_value },
+	{ "max_files",			max_files,		DP_value },
+	{ "progress_interval",		progress_interval,	DP_value },
 	{ NULL,	NULL }
 };
 
@@ -233,6 +244,100 @@ stage_partial(void)
 }
 
 
+static void
+io_budget(void)
+{
+	int n;
+
+	if (not_for_this_fs) {
+		return;
+	}
+	if ((n = get_number(0, INT_MAX)) >= 0) {
+		control.io_budget = n;
+	}
+}
+
+
+static void
+tolerance(void)
+{
+	int n;
+
+	if (not_for_this_fs) {
+		return;
+	}
+	if ((n = get_number(1, 50)) >= 0) {
+		control.tolerance = n;
+	}
+}
+
+
+static void
+fragments(void)
+{
+	int n;
+
+	if (not_for_this_fs) {
+		return;
+	}
+	if ((n = get_number(2, 8)) >= 0) {
+		control.fragments = n;
+	}
+}
+
+
+static void
+max_files(void)
+{
+	int n;
+
+	if (not_for_this_fs) {
+		return;
+	}
+	if ((n = get_number(1, 10000000)) >= 0) {
+		control.max_files = n;
+	}
+}
+
+
+static void
+progress_interval(void)
+{
+	int n;
+
+	if (not_for_this_fs) {
+		return;
+	}
+	if ((n = get_number(1, INT_MAX)) >= 0) {
+		control.progress_interval = n;
+	}
+}
+
+
+/*
+ * Get a numeric value, limited to min..max. -1 if not a number.
+ */
+static int
+get_number(int min, int max)
+{
+	char *endptr;
+	long n;
+
+	n = strtol(token, &endptr, 10);
+	if ((endptr && *endptr != '\0') || n < 0) {
+		ReadCfgError(8020, token, fs_name);
+		return (-1);
+	}
+	if (n < min) {
+		n = min;
+	}
+	if (n > max) {
+		n = max;
+	}
+	return ((int)n);
+}
+
+
 /*
  *  Message handler for ReadCfg module.
  */
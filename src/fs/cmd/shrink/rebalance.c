@@ -0,0 +1,658 @@
+/*
+ * rebalance.c - Rebalance and defrag the data devices for sam-shrink.
+ *
+ * The .inodes scan of sam-shrink ranks each file. Rebalance queues the
+ * files whose data is on a device fuller than the mean of the devices
+ * of its type, largest file first. Defrag queues the files with the
+ * most fragments. The queue keeps the max_files best ranked files in a
+ * heap. After the scan the worker threads take the files in rank order
+ * and move them with SAM_MOVE_ORD_ONLY, the SAM_MOVE_ORD call of the
+ * remove command allocating only on the chosen device, paced to the
+ * I/O budget.
+ */
+
+/*
+ *    SAM-QFS_notice_begin
+ *
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at pkg/OPENSOLARIS.LICENSE
+ * or https://illumos.org/license/CDDL.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at pkg/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+/*
+ * Copyright 2009 Sun Microsystems, Inc.  All rights reserved.
+ * Use is subject to license terms.
+ *
+ *    SAM-QFS_notice_end
+ */
+
+#pragma ident "$Revision: 1.1 $"
+
+static char *_SrcFile = __FILE__; /* Using __FILE__ makes duplicate strings */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#include <sys/types.h>
+#include <sys/param.h>
+#include <sys/time.h>
+
+#include "sam/types.h"
+#include "sam/param.h"
+#include "sam/custmsg.h"
+#include "sam/mount.h"
+#include "sam/lib.h"
+#include "sam/exit.h"
+#include "sam/sam_trace.h"
+#include "sam/syscall.h"
+
+#include "pub/devstat.h"
+
+/* SAM-FS headers. */
+#include "sam/fs/ino.h"
+
+#include "shrink.h"
+
+/*
+ * A file queued to move.
+ */
+typedef struct rb_file {
+	sam_id_t	id;		/* Inode.Generation number */
+	uint64_t	key;		/* Rank, highest moved first */
+	uint32_t	blocks;		/* SAM_BLK blocks allocated */
+	ushort_t	ord;		/* Device the file is moved off */
+} rb_file_t;
+
+/*
+ * A device of the file system.
+ */
+typedef struct rb_dev {
+	fsize_t		capacity;	/* Total bytes */
+	fsize_t		space;		/* Free bytes, after moves planned */
+	fsize_t		target;		/* Free bytes at the mean of type */
+	fsize_t		slack;		/* Tolerance in bytes */
+	boolean_t	data;		/* Data device which is on */
+} rb_dev_t;
+
+extern control_t control;
+extern pthread_mutex_t log_lock;
+
+static pthread_mutex_t rb_lock = PTHREAD_MUTEX_INITIALIZER;
+static rb_dev_t *devs;		/* Devices, by ordinal */
+static rb_file_t *heap;		/* Min heap of the files queued */
+static int heap_n;		/* Files queued */
+static int heap_next;		/* Next file to move, once sorted */
+static hrtime_t io_next;	/* Earliest start of the next move */
+static time_t progress_time;	/* Last progress report */
+
+static void rb_push(rb_file_t *fp);
+static void rb_sift_down(int i, int n);
+static int rb_fragments(sam_perm_inode_t *ip);
+static int rb_pick(rb_file_t *fp, fsize_t bytes);
+static void *rb_move_thread(void *c);
+static void rb_throttle(fsize_t bytes);
+static void rb_write_log(rb_file_t *fp, char *tag, int dst, int error);
+static void rb_progress(boolean_t force);
+
+#define	PERCENT(capacity, space) \
+	((capacity) ? (int)(100 - ((space) * 100) / (capacity)) : 0)
+
+
+/*
+ * sam_rebalance_init - Set the free space target of each data device
+ * and allocate the queue. Devices are balanced against the devices of
+ * the same type, as SAM_MOVE_ORD does not move data between types.
+ */
+void
+sam_rebalance_init(void)
+{
+	struct sam_fs_part *pt;
+	int count = control.mp->fs_count;
+	int ord, o;
+
+	devs = (rb_dev_t *)calloc(count, sizeof (rb_dev_t));
+	heap = (rb_file_t *)malloc(control.max_files * sizeof (rb_file_t));
+	if (devs == NULL || heap == NULL) {
+		/* malloc: %s */
+		SendCustMsg(HERE, 1606, "Rebalance queue");
+		exit(EXIT_NOMEM);
+	}
+	for (ord = 0, pt = control.part; ord < count; ord++, pt++) {
+		devs[ord].capacity = pt->pt_capacity;
+		devs[ord].space = pt->pt_space;
+		devs[ord].slack = (pt->pt_capacity / 100) * control.tolerance;
+		devs[ord].data = (pt->pt_type == DT_DATA ||
+		    pt->pt_type == DT_RAID) && pt->pt_state == DEV_ON &&
+		    pt->pt_capacity != 0;
+	}
+	for (ord = 0; ord < count; ord++) {
+		fsize_t capacity = 0;
+		fsize_t space = 0;
+
+		if (!devs[ord].data) {
+			continue;
+		}
+		for (o = 0; o < count; o++) {
+			if (devs[o].data &&
+			    control.part[o].pt_type ==
+			    control.part[ord].pt_type) {
+				capacity += devs[o].capacity;
+				space += devs[o].space;
+			}
+		}
+		devs[ord].target = (fsize_t)((double)devs[ord].capacity *
+		    ((double)space / (double)capacity));
+		Trace(TR_MISC, "rebalance: ord %d eq %d %d%% full, "
+		    "mean %d%%", ord, control.part[ord].pt_eq,
+		    PERCENT(devs[ord].capacity, devs[ord].space),
+		    (int)(100 - (space * 100) / capacity));
+	}
+}
+
+
+/*
+ * sam_rank_file - Queue the file if it is to be moved.
+ * Called by the scan threads for each regular file with blocks.
+ */
+void
+sam_rank_file(sam_perm_inode_t *ip)
+{
+	rb_file_t file;
+	ushort_t n[L_FSET];
+	int ord = -1;
+	int de;
+
+	/*
+	 * The file is moved off the device holding most of its direct
+	 * extents.
+	 */
+	memset(n, 0, sizeof (n));
+	for (de = 0; de < NDEXT; de++) {
+		if (ip->di.extent[de] == 0 ||
+		    ip->di.extent_ord[de] >= control.mp->fs_count) {
+			continue;
+		}
+		if (++n[ip->di.extent_ord[de]] > (ord < 0 ? 0 : n[ord])) {
+			ord = ip->di.extent_ord[de];
+		}
+	}
+	if (ord < 0 || !devs[ord].data) {
+		return;
+	}
+
+	file.id = ip->di.id;
+	file.blocks = ip->di.blocks;
+	file.ord = (ushort_t)ord;
+	if (control.command == SHRINK_rebalance) {
+		if (devs[ord].space + devs[ord].slack >= devs[ord].target) {
+			return;
+		}
+		file.key = ip->di.blocks;
+	} else {
+		int frags = rb_fragments(ip);
+
+		if (frags < control.fragments) {
+			return;
+		}
+		file.key = ((uint64_t)frags << 32) | ip->di.blocks;
+	}
+	pthread_mutex_lock(&rb_lock);
+	rb_push(&file);
+	pthread_mutex_unlock(&rb_lock);
+}
+
+
+/*
+ * sam_rebalance_files - Move the files queued by the scan, highest
+ * rank first.
+ */
+int				/* 0 if done, 1 if shut down */
+sam_rebalance_files(char *fs_name)
+{
+	rb_file_t tmp;
+	int streams;
+	int n, t;
+
+	/*
+	 * Sort the heap, highest rank first.
+	 */
+	for (n = heap_n - 1; n > 0; n--) {
+		tmp = heap[0];
+		heap[0] = heap[n];
+		heap[n] = tmp;
+		rb_sift_down(0, n);
+	}
+	Trace(TR_MISC, "rebalance: %d files queued", heap_n);
+
+	heap_next = 0;
+	io_next = gethrtime();
+	progress_time = time(NULL);
+	streams = control.streams;
+	if (streams > heap_n) {
+		streams = heap_n;
+	}
+	for (t = 0; t < streams; t++) {
+		if (pthread_create(&control.thr[t].tid, NULL,
+		    rb_move_thread, &control.thr[t])) {
+			/* %s: Error pthread_create */
+			SendCustMsg(HERE, 25004, fs_name);
+			exit(EXIT_FAILURE);
+		}
+	}
+	for (t = 0; t < streams; t++) {
+		if ((pthread_join(control.thr[t].tid, NULL)) != 0) {
+			/* %s: Error pthread_join */
+			SendCustMsg(HERE, 25003, fs_name);
+			exit(EXIT_FAILURE);
+		}
+	}
+	rb_progress(TRUE);
+	free(heap);
+	heap = NULL;
+	return (control.shutdown ? 1 : 0);
+}
+
+
+/*
+ * rb_push - Queue a file, replacing the lowest ranked file if the
+ * queue is full. rb_lock held.
+ */
+static void
+rb_push(rb_file_t *fp)
+{
+	int i, p;
+
+	if (heap_n == control.max_files) {
+		if (fp->key > heap[0].key) {
+			heap[0] = *fp;
+			rb_sift_down(0, heap_n);
+		}
+		return;
+	}
+	for (i = heap_n++; i > 0; i = p) {
+		p = (i - 1) / 2;
+		if (heap[p].key <= fp->key) {
+			break;
+		}
+		heap[i] = heap[p];
+	}
+	heap[i] = *fp;
+}
+
+
+/*
+ * rb_sift_down - Restore the heap below entry i of the first n.
+ */
+static void
+rb_sift_down(int i, int n)
+{
+	rb_file_t tmp = heap[i];
+	int c;
+
+	while ((c = 2 * i + 1) < n) {
+		if (c + 1 < n && heap[c + 1].key < heap[c].key) {
+			c++;
+		}
+		if (tmp.key <= heap[c].key) {
+			break;
+		}
+		heap[i] = heap[c];
+		i = c;
+	}
+	heap[i] = tmp;
+}
+
+
+/*
+ * rb_fragments - Count the fragments of the large direct extents of a
+ * file. The DAU is not known here, the smallest step between extents
+ * of the file on one device is taken as contiguous. A change of device
+ * after a run of stripe extents is the stripe rotation of the allocator
+ * and is not a fragment if the extent follows the last one on that
+ * device.
+ */
+static int
+rb_fragments(sam_perm_inode_t *ip)
+{
+	short last[L_FSET];	/* Last extent on each device */
+	uint32_t step = 0;
+	int stripe;
+	int frags = 0;
+	int prev = -1;
+	int run = 0;
+	boolean_t first_run = TRUE;
+	int de;
+
+	memset(last, 0xff, sizeof (last));
+	for (de = NSDEXT; de < NDEXT; de++) {
+		int o = ip->di.extent_ord[de];
+
+		if (ip->di.extent[de] == 0 || o >= L_FSET) {
+			continue;
+		}
+		if (last[o] >= 0 &&
+		    ip->di.extent[de] > ip->di.extent[last[o]] &&
+		    (step == 0 ||
+		    ip->di.extent[de] - ip->di.extent[last[o]] < step)) {
+			step = ip->di.extent[de] - ip->di.extent[last[o]];
+		}
+		last[o] = (short)de;
+	}
+
+	/*
+	 * The stripe width the file was allocated with, as sam_alloc_block.
+	 */
+	stripe = ip->di.status.b.stripe_width ?
+	    (uchar_t)ip->di.stripe : control.mp->fi_stripe[DD];
+	memset(last, 0xff, sizeof (last));
+	for (de = NSDEXT; de < NDEXT; de++) {
+		int o = ip->di.extent_ord[de];
+
+		if (ip->di.extent[de] == 0 || o >= L_FSET) {
+			continue;
+		}
+		if (prev < 0) {
+			frags++;
+			run = 1;
+		} else if (o == ip->di.extent_ord[prev]) {
+			if (ip->di.extent[de] != ip->di.extent[prev] + step) {
+				frags++;
+			}
+			run++;
+		} else {
+			/*
+			 * The first run may be short, the stride of the file
+			 * was counted from its small extents.
+			 */
+			if (stripe == 0 ||
+			    (first_run ? run > stripe : run != stripe) ||
+			    (last[o] >= 0 && ip->di.extent[de] !=
+			    ip->di.extent[last[o]] + step)) {
+				frags++;
+			}
+			first_run = FALSE;
+			run = 1;
+		}
+		last[o] = (short)de;
+		prev = de;
+	}
+	return (frags);
+}
+
+
+/*
+ * rb_pick - Choose the device to move a file to, -1 to leave the file.
+ * rb_lock held.
+ */
+static int
+rb_pick(rb_file_t *fp, fsize_t bytes)
+{
+	rb_dev_t *src = &devs[fp->ord];
+	dtype_t type = control.part[fp->ord].pt_type;
+	int count = control.mp->fs_count;
+	int dst = -1;
+	int ord;
+
+	if (control.command == SHRINK_rebalance) {
+		/*
+		 * While the device of the file is fuller than its target,
+		 * move to the device of the type with the most free space
+		 * over its target, if the move keeps that device within
+		 * the tolerance of its target.
+		 */
+		sfsize_t best = 0;
+
+		if (src->space >= src->target) {
+			return (-1);
+		}
+		for (ord = 0; ord < count; ord++) {
+			rb_dev_t *dp = &devs[ord];
+			sfsize_t surplus;
+
+			if (ord == fp->ord || !dp->data ||
+			    control.part[ord].pt_type != type) {
+				continue;
+			}
+			surplus = (sfsize_t)(dp->space + dp->slack) -
+			    (sfsize_t)(dp->target + bytes);
+			if (surplus >= best) {
+				best = surplus;
+				dst = ord;
+			}
+		}
+	} else {
+		/*
+		 * Reallocate on the device with the most free space, which
+		 * may be the device of the file.
+		 */
+		for (ord = 0; ord < count; ord++) {
+			rb_dev_t *dp = &devs[ord];
+
+			if (!dp->data || control.part[ord].pt_type != type ||
+			    dp->space < 2 * bytes) {
+				continue;
+			}
+			if (dst < 0 || dp->space > devs[dst].space) {
+				dst = ord;
+			}
+		}
+	}
+	return (dst);
+}
+
+
+/*
+ * rb_move_thread - Move the queued files, highest rank first.
+ */
+/* ARGSUSED */
+static void *
+rb_move_thread(void *c)
+{
+	sam_fseq_arg_t fseq_arg;
+
+	for (;;) {
+		rb_file_t *fp;
+		fsize_t bytes;
+		int error = 0;
+		int dst;
+
+		pthread_mutex_lock(&rb_lock);
+		if (control.shutdown || heap_next >= heap_n) {
+			pthread_mutex_unlock(&rb_lock);
+			break;
+		}
+		fp = &heap[heap_next++];
+		bytes = (fsize_t)fp->blocks * SAM_BLK;
+		if ((dst = rb_pick(fp, bytes)) >= 0) {
+			devs[fp->ord].space += bytes;
+			devs[dst].space -= bytes;
+		}
+		pthread_mutex_unlock(&rb_lock);
+		if (dst < 0) {
+			continue;
+		}
+
+		if (control.do_not_execute) {
+			rb_write_log(fp, "NO", dst, 0);
+			continue;
+		}
+		rb_throttle(bytes);
+		fseq_arg.cmd = SAM_MOVE_ORD_ONLY;
+		fseq_arg.fseq = control.mp->fi_eq;
+		fseq_arg.eq = control.part[fp->ord].pt_eq;
+		fseq_arg.ord = fp->ord;
+		fseq_arg.id = fp->id;
+		fseq_arg.on_ord = 0;
+		fseq_arg.new_ord = dst;
+		if (sam_syscall(SC_fseq_ord, &fseq_arg,
+		    sizeof (fseq_arg)) < 0) {
+			error = errno;
+		}
+
+		pthread_mutex_lock(&rb_lock);
+		if (error == 0) {
+			control.moved_files++;
+			control.moved_bytes += bytes;
+		} else {
+			devs[fp->ord].space -= bytes;
+			devs[dst].space += bytes;
+		}
+		pthread_mutex_unlock(&rb_lock);
+
+		/*
+		 * Files may have been deleted since the scan.
+		 */
+		if (error != 0 && error != ENOENT) {
+			Trace(TR_ERR, "Can't move inode %d.%d: %s",
+			    fp->id.ino, fp->id.gen, strerror(error));
+			pthread_mutex_lock(&log_lock);
+			control.total_errors++;
+			pthread_mutex_unlock(&log_lock);
+			if (control.display_all_files) {
+				rb_write_log(fp, "ER", dst, error);
+			}
+		} else if (error == 0 && control.display_all_files) {
+			rb_write_log(fp, control.command == SHRINK_rebalance ?
+			    "RB" : "DF", dst, 0);
+		}
+		rb_progress(FALSE);
+	}
+	return (NULL);
+}
+
+
+/*
+ * rb_throttle - Wait until bytes may be moved within the I/O budget.
+ * Each move takes its share of the budget before it starts, time not
+ * used by a move is not carried over.
+ */
+static void
+rb_throttle(fsize_t bytes)
+{
+	struct timespec ts;
+	hrtime_t now, start;
+
+	if (control.io_budget == 0) {
+		return;
+	}
+	pthread_mutex_lock(&rb_lock);
+	now = gethrtime();
+	start = (io_next > now) ? io_next : now;
+	io_next = start + (hrtime_t)((double)bytes * NANOSEC /
+	    ((double)control.io_budget * 1048576));
+	pthread_mutex_unlock(&rb_lock);
+	if (start > now) {
+		ts.tv_sec = (start - now) / NANOSEC;
+		ts.tv_nsec = (start - now) % NANOSEC;
+		while (nanosleep(&ts, &ts) < 0 && errno == EINTR &&
+		    control.shutdown == 0) {
+			;
+		}
+	}
+}
+
+
+/*
+ * rb_write_log - Write a moved file to the log.
+ * The third field is the device ordinal moved to, or the errno.
+ */
+static void
+rb_write_log(
+	rb_file_t *fp,		/* File */
+	char *tag,		/* RB, DF, NO or ER */
+	int dst,		/* Ordinal moved to */
+	int error)		/* Errno */
+{
+	char pathname[MAXPATHLEN + 4];
+	char *p = &pathname[0];
+
+	(void) getfullpathname(control.mountpoint, fp->id, &p);
+	pthread_mutex_lock(&log_lock);
+	fprintf(control.log, "%s %d.%d %d S0 %s\n", tag, fp->id.ino,
+	    fp->id.gen, error ? error : dst, p);
+	Trace(TR_MISC, "%s %d.%d %d S0 %s", tag, fp->id.ino,
+	    fp->id.gen, error ? error : dst, p);
+	if ((control.log_time + 60) < time(NULL)) {
+		fflush(control.log);
+	}
+	pthread_mutex_unlock(&log_lock);
+}
+
+
+/*
+ * rb_progress - Write the progress to the log every progress_interval
+ * seconds, or now if forced. The fill of each device is read from the
+ * file system, not taken from the moves planned.
+ */
+static void
+rb_progress(boolean_t force)
+{
+	struct sam_fs_part *parts;
+	char msgbuf[512];
+	char ctime_buf[512];
+	char *ascii;
+	time_t now = time(NULL);
+	int count = control.mp->fs_count;
+	int ord;
+
+	pthread_mutex_lock(&rb_lock);
+	if (!force && now < progress_time + control.progress_interval) {
+		pthread_mutex_unlock(&rb_lock);
+		return;
+	}
+	progress_time = now;
+	snprintf(msgbuf, sizeof (msgbuf),
+	    "%s progress: %d of %d files, %lld MB moved, %d errors",
+	    control.command == SHRINK_rebalance ? "Rebalance" : "Defrag",
+	    heap_next, heap_n, (long long)(control.moved_bytes >> 20),
+	    control.total_errors);
+	pthread_mutex_unlock(&rb_lock);
+
+	parts = (struct sam_fs_part *)malloc(count *
+	    sizeof (struct sam_fs_part));
+	if (parts != NULL &&
+	    GetFsParts(control.mp->fi_name, count, parts) < 0) {
+		Trace(TR_ERR, "rebalance: can't read devices of %s",
+		    control.mp->fi_name);
+		free(parts);
+		parts = NULL;
+	}
+
+	ascii = ctime_r(&now, ctime_buf, sizeof (ctime_buf));
+	*(ascii+strlen(ascii)-1) = '\0';
+	pthread_mutex_lock(&log_lock);
+	fprintf(control.log, "%s %s\n", ascii, msgbuf);
+	Trace(TR_MISC, "%s", msgbuf);
+	for (ord = 0; parts != NULL && ord < count; ord++) {
+		if (devs[ord].data) {
+			fprintf(control.log, "    eq %d %d%% full\n",
+			    parts[ord].pt_eq, PERCENT(parts[ord].pt_capacity,
+			    parts[ord].pt_space));
+		}
+	}
+	fflush(control.log);
+	control.log_time = now;
+	pthread_mutex_unlock(&log_lock);
+	if (parts != NULL) {
+		free(parts);
+	}
+}
@@ -143,7 +143,6 @@ static int sam_process_file(struct sam_fs_info *mp, sam_perm_inode_t *ip);
 static void sam_write_log(sam_perm_inode_t *ip, boolean_t released,
 	char *cmd, int error);
 
-static int getfullpathname(char *fsname, sam_id_t id, char **fullpath);
 extern int read_cmd_file(char *cfgFname);
 
 /* Defines */
@@ -186,7 +185,8 @@ main(int argc, char *argv[])
 	struct sam_fs_part *part, *pt;	/* Array of partitions */
 	int		command;
 	int		size_part;
-	equ_t		eq;
+	equ_t		eq = 0;
+	char		*ceq = "-";	/* Eq argument, none for rebalance */
 	int		ord;
 	dtype_t	oldpt;
 	int		error = 0;
@@ -198,16 +198,12 @@ main(int argc, char *argv[])
 	Daemon = strcmp(GetParentName(), SAM_FSD) == 0;
 	CustmsgInit(Daemon, NULL);
 	TraceInit(SAM_SHRINK, TI_shrink);
-#ifndef DEBUG
-	if (!Daemon) {
-		Trace(TR_ERR, "sam-shrink process not started by sam-fsd");
-		exit(EXIT_FAILURE);
-	}
-#endif
 
 	/*
-	 * Parse arguments. sam-shrink is started with three arguments:
-	 * filesystem_name [remove | release] eq
+	 * Parse arguments. sam-shrink is started by sam-fsd with three
+	 * arguments: filesystem_name [remove | release] eq
+	 * or by the administrator with two:
+	 * filesystem_name [rebalance | defrag]
 	 */
 	if (argc == 4) {
 		fs_name = argv[1];
@@ -218,12 +214,33 @@ main(int argc, char *argv[])
 		} else {
 			sam_usage(argv[0]);
 		}
-		eq = atoi(argv[3]);
+		ceq = argv[3];
+		eq = atoi(ceq);
+	} else if (argc == 3) {
+		fs_name = argv[1];
+		if (strcmp(argv[2], "rebalance") == 0) {
+			command = SHRINK_rebalance;
+		} else if (strcmp(argv[2], "defrag") == 0) {
+			command = SHRINK_defrag;
+		} else {
+			sam_usage(argv[0]);
+		}
 	} else {
 		sam_usage(argv[0]);
 	}
+#ifndef DEBUG
+	if (!Daemon && !IS_REBALANCE(command)) {
+		Trace(TR_ERR, "sam-shrink process not started by sam-fsd");
+		exit(EXIT_FAILURE);
+	}
+#endif
+	if (IS_REBALANCE(command) && geteuid() != 0) {
+		/* You must be root to run %s\n */
+		fprintf(stderr, GetCustMsg(13920), program_name);
+		exit(EXIT_FAILURE);
+	}
 	Trace(TR_MISC, "sam-shrink process started, %s %s %s",
-	    fs_name, argv[2], argv[3]);
+	    fs_name, argv[2], ceq);
 
 	/*
 	 * If Daemon, swtich into /var/opt/SUNWsamfs/shrink/fs_name.
@@ -231,6 +248,7 @@ main(int argc, char *argv[])
 	 */
 	control.log = NULL;
 	control.streams = 0;
+	control.io_budget = -1;
 	if (Daemon) {
 		char fileName[64];
 
@@ -249,7 +267,14 @@ main(int argc, char *argv[])
 		}
 		control.log = sam_open_log_file();
 	} else {
-		control.log = stdout;
+		if (IS_REBALANCE(command) &&
+		    read_cmd_file(SAM_CONFIG_PATH"/shrink.cmd") > 0) {
+			/* Error in shrink command file %s */
+			SendCustMsg(HERE, 25000, SAM_CONFIG_PATH"/shrink.cmd");
+			exit(EXIT_FAILURE);
+		}
+		control.log = (*control.log_pathname != '\0') ?
+		    sam_open_log_file() : stdout;
 	}
 
 	/*
@@ -282,28 +307,34 @@ main(int argc, char *argv[])
 		SendCustMsg(HERE, 7006, fs_name);
 		exit(EXIT_FAILURE);
 	}
-	for (ord = 0, pt = part; ord < mnt_info.fs_count; ord++, pt++) {
-		if (eq == pt->pt_eq) {
-			if (pt->pt_state != DEV_NOALLOC) {
-				/* Invalid device state '%s' */
-				SendCustMsg(HERE, 17251,
-				    dev_state[pt->pt_state]);
-				exit(EXIT_FAILURE);
+	control.mp = &mnt_info;		/* Pointer to mount info */
+	control.part = part;
+	control.command = command;
+	if (IS_REBALANCE(command)) {
+		ord = 0;
+	} else {
+		for (ord = 0, pt = part; ord < mnt_info.fs_count;
+		    ord++, pt++) {
+			if (eq == pt->pt_eq) {
+				if (pt->pt_state != DEV_NOALLOC) {
+					/* Invalid device state '%s' */
+					SendCustMsg(HERE, 17251,
+					    dev_state[pt->pt_state]);
+					exit(EXIT_FAILURE);
+				}
+				oldpt = pt->pt_type;
+				break;
 			}
-			oldpt = pt->pt_type;
-			break;
 		}
-	}
-	if (ord >= mnt_info.fs_count) {
-		/* %s is not a valid equipment ordinal. */
-		SendCustMsg(HERE, 2350, argv[3]);
-		exit(EXIT_FAILURE);
+		if (ord >= mnt_info.fs_count) {
+			/* %s is not a valid equipment ordinal. */
+			SendCustMsg(HERE, 2350, argv[3]);
+			exit(EXIT_FAILURE);
+		}
 	}
 	control.eq = eq;		/* Equipment */
 	control.ord = (ushort_t)ord;	/* Equipment ordinal */
 	control.ord2 = -1;
-	control.command = command;	/* Release or Remove command */
-	control.mp = &mnt_info;		/* Pointer to mount info */
 
 	if ((command == DK_CMD_remove) && is_stripe_group(oldpt)) {
 		int xord;
@@ -395,6 +426,24 @@ main(int argc, char *argv[])
 	}
 	pblock.read_threads = control.streams;
 	pblock.queue_size = control.streams;
+	if (IS_REBALANCE(command)) {
+		if (control.io_budget < 0) {
+			control.io_budget = REBALANCE_IO_BUDGET;
+		}
+		if (control.tolerance == 0) {
+			control.tolerance = REBALANCE_TOLERANCE;
+		}
+		if (control.fragments == 0) {
+			control.fragments = REBALANCE_FRAGMENTS;
+		}
+		if (control.max_files == 0) {
+			control.max_files = REBALANCE_MAX_FILES;
+		}
+		if (control.progress_interval == 0) {
+			control.progress_interval = REBALANCE_PROGRESS;
+		}
+		sam_rebalance_init();
+	}
 
 	/*
 	 * Get the mount point.
@@ -406,21 +455,34 @@ main(int argc, char *argv[])
 	}
 	Trace(TR_MISC, "sam-shrink command options: fs=%s mp=%s cmd=%d eq=%d "
 	    "ord=%d ord2=%d do_not_execute=%d display_all_files=%d "
-	    "stage_files=%d stage_partial=%d streams=%d block_size=%dMB log=%s",
+	    "stage_files=%d stage_partial=%d streams=%d block_size=%dMB log=%s "
+	    "io_budget=%d tolerance=%d fragments=%d max_files=%d",
 	    fs_name, control.mountpoint, control.command, control.eq,
 	    control.ord, control.ord2, control.do_not_execute,
 	    control.display_all_files, control.stage_files,
 	    control.stage_partial, control.streams, control.block_size,
-	    control.log_pathname);
+	    control.log_pathname, control.io_budget, control.tolerance,
+	    control.fragments, control.max_files);
 
 	/*
 	 * Shrink the specified ordinal.
 	 */
-	sam_shrink_header(1, argv[2], argv[3]);
+	sam_shrink_header(1, argv[2], ceq);
 	if (sam_shrink_fs(fs_name, &pblock)) {
 		Trace(TR_ERR, "sam-shrink process failed: %s %s %s",
-		    fs_name, argv[2], argv[3]);
-		sam_shrink_header(2, argv[2], argv[3]);
+		    fs_name, argv[2], ceq);
+		sam_shrink_header(2, argv[2], ceq);
+		return (0);
+	}
+	if (IS_REBALANCE(command)) {
+		/*
+		 * The devices stay on.
+		 */
+		Trace(TR_MISC, "sam-shrink %s completed: files moved=%d "
+		    "MB moved=%lld total errors=%d", argv[2],
+		    control.moved_files, control.moved_bytes >> 20,
+		    control.total_errors);
+		sam_shrink_header(5, argv[2], ceq);
 		return (0);
 	}
 	if ((SetFsPartCmd(fs_name, argv[3], DK_CMD_off)) < 0) {
@@ -489,6 +551,13 @@ sam_shrink_header(
 		    fs_name, eq, control.busy_files, control.unarchived_files,
 		    control.total_errors);
 		break;
+	case 5:
+		sprintf(msgbuf,
+		    "%s process completed for %s: files moved=%d, "
+		    "MB moved=%lld, total_errors=%d", cmd, fs_name,
+		    control.moved_files, control.moved_bytes >> 20,
+		    control.total_errors);
+		break;
 	default:
 		break;
 	}
@@ -511,7 +580,8 @@ sam_usage(char *name)
 {
 	char msg[1024];
 
-	sprintf(msg, "Usage: %s fsname remove|release eq\n", name);
+	sprintf(msg, "Usage: %s fsname remove|release eq\n"
+	    "       %s fsname rebalance|defrag\n", name, name);
 	if (Daemon) {
 		sam_syslog(LOG_ERR, msg);
 	} else {
@@ -657,6 +727,13 @@ sam_shrink_fs(
 			exit(EXIT_FAILURE);
 		}
 	}
+
+	/*
+	 * Rebalance and defrag move the files queued by the scan.
+	 */
+	if (err == 0 && IS_REBALANCE(control.command)) {
+		err = sam_rebalance_files(fs_name);
+	}
 	return (err);
 }
 
@@ -1055,6 +1132,10 @@ sam_check_inodes(work_t *wp)
 		if (ip->di.blocks == 0) {
 			continue;
 		}
+		if (IS_REBALANCE(control.command)) {
+			sam_rank_file(ip);
+			continue;
+		}
 		if (sam_ord_found(ip)) {
 			/*
 			 * Files selected for releasing/removal may have been
@@ -1344,7 +1425,7 @@ sam_clean_thr(int sig)
  * the "pathname" returned will be the string "Cannot find pathname for ..."
  * as shown below.
  */
-static int			/* 0 if successful, -1 if cannot get pathname */
+int				/* 0 if successful, -1 if cannot get pathname */
 getfullpathname(
 	char *fsname,		/* Mount point */
 	sam_id_t id,		/* Inode.Generation number */
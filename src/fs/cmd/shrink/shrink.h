@@ -45,6 +45,22 @@
 #define	MAX_THREADS	1024		/* Maximum number of threads */
 #define	MAX_QUEUE	1024		/* Maximum size of I/O request queue */
 
+/*
+ * Commands of sam-shrink besides DK_CMD_remove and DK_CMD_release.
+ * Rebalance and defrag are started by the administrator, they move
+ * files between the data devices which stay on.
+ */
+#define	SHRINK_rebalance	0x100	/* Even out the data devices */
+#define	SHRINK_defrag		0x101	/* Reallocate fragmented files */
+#define	IS_REBALANCE(cmd) \
+	((cmd) == SHRINK_rebalance || (cmd) == SHRINK_defrag)
+
+#define	REBALANCE_IO_BUDGET	100	/* Default MB per second moved */
+#define	REBALANCE_TOLERANCE	5	/* Default percent from mean */
+#define	REBALANCE_FRAGMENTS	8	/* Default fragments to defrag */
+#define	REBALANCE_MAX_FILES	100000	/* Default files queued */
+#define	REBALANCE_PROGRESS	60	/* Default seconds per report */
+
 /*
  * There is only one control structure. It describes the thread pool.
  * The control structure holds the head and tail of the I/O request work
@@ -87,6 +103,14 @@ typedef struct control {
 	int display_all_files;		/* Display all processed files in log */
 	FILE *log;			/* Stream for logging */
 	struct sam_fs_info *mp;		/* File system mount table */
+	struct sam_fs_part *part;	/* Devices of the file system */
+	int io_budget;			/* Rebalance MB/sec, 0 no limit */
+	int tolerance;			/* Rebalance percent from mean */
+	int fragments;			/* Defrag files with this many */
+	int max_files;			/* Most files queued to move */
+	int progress_interval;		/* Seconds between progress logs */
+	int moved_files;		/* Files moved by rebalance/defrag */
+	int64_t moved_bytes;		/* Bytes moved by rebalance/defrag */
 	thr_t thr[MAX_THREADS];		/* Array of thread information */
 } control_t;
 
@@ -126,4 +150,13 @@ typedef struct parameter_block {
 	int active_threads;		/* Active number of threads */
 } pblock_t;
 
+/* rebalance.c */
+struct sam_perm_inode;
+void sam_rebalance_init(void);
+void sam_rank_file(struct sam_perm_inode *ip);
+int sam_rebalance_files(char *fs_name);
+
+/* shrink.c */
+int getfullpathname(char *fsname, sam_id_t id, char **fullpath);
+
 #endif	/* _SAM_FS_SHRINK_H */
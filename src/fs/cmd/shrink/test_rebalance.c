@@ -0,0 +1,208 @@
+/*
+ * test_rebalance.c - test of the files selected by sam-shrink defrag.
+ *
+ * Files laid out by the stripe rotation of the allocator must not be
+ * counted as fragmented, files scattered on a device must be.  The
+ * files are ranked and moved with do_not_execute set, the files moved
+ * are the files selected.
+ *
+ * usage: test_rebalance
+ */
+
+/*
+ *    SAM-QFS_notice_begin
+ *
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at pkg/OPENSOLARIS.LICENSE
+ * or https://illumos.org/license/CDDL.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at pkg/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+/*
+ * Copyright 2009 Sun Microsystems, Inc.  All rights reserved.
+ * Use is subject to license terms.
+ *
+ *    SAM-QFS_notice_end
+ */
+
+#pragma ident "$Revision: 1.1 $"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include <sys/types.h>
+#include <sys/param.h>
+
+#include "sam/types.h"
+#include "sam/param.h"
+#include "sam/mount.h"
+
+#include "pub/devstat.h"
+
+/* SAM-FS headers. */
+#include "sam/fs/ino.h"
+
+#include "shrink.h"
+
+#define	DEVICES	2		/* Data devices of the file system */
+#define	STEP	16		/* Extent step of contiguous DAUs */
+#define	FILES	8		/* Most file ids */
+
+pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+control_t control;
+
+static struct sam_fs_info mnt_info;
+static struct sam_fs_part parts[DEVICES];
+static int selected[FILES];
+
+static void makeFile(sam_perm_inode_t *ip, int ino, int stripe,
+	const uchar_t *ords, const uint32_t *extents);
+
+
+/*
+ * The files selected are the files the move threads look up.
+ */
+/* ARGSUSED */
+int
+getfullpathname(char *fsname, sam_id_t id, char **fullpath)
+{
+	if (id.ino < FILES) {
+		selected[id.ino]++;
+	}
+	strcpy(*fullpath, "-");
+	return (0);
+}
+
+
+int
+main(void)
+{
+	/*
+	 * Large extents of the files.  "a" and "b" are contiguous on each
+	 * device, "c" is scattered on device 0.
+	 */
+	static const uchar_t alt1[NLDEXT] = { 0, 1, 0, 1, 0, 1, 0, 1 };
+	static const uchar_t alt2[NLDEXT] = { 0, 0, 1, 1, 0, 0, 1, 1 };
+	static const uchar_t one[NLDEXT] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+	static const uint32_t a[NLDEXT] = {
+		1000, 2000, 1000 + STEP, 2000 + STEP,
+		1000 + 2 * STEP, 2000 + 2 * STEP,
+		1000 + 3 * STEP, 2000 + 3 * STEP };
+	static const uint32_t b[NLDEXT] = {
+		1000, 1000 + STEP, 2000, 2000 + STEP,
+		1000 + 2 * STEP, 1000 + 3 * STEP,
+		2000 + 2 * STEP, 2000 + 3 * STEP };
+	static const uint32_t c[NLDEXT] = {
+		1000, 1000 + STEP, 5000, 5000 + STEP,
+		9000, 9000 + STEP, 13000, 13000 + STEP };
+	static const uint32_t d[NLDEXT] = {
+		1000, 2000, 5000, 2000 + STEP,
+		9000, 2000 + 2 * STEP, 13000, 2000 + 3 * STEP };
+	static const int expect[FILES] = { 0, 0, 0, 1, 1, 1, 0, 0 };
+	sam_perm_inode_t ino;
+	int failed = 0;
+	int ord;
+	int i;
+
+	mnt_info.fs_count = DEVICES;
+	for (ord = 0; ord < DEVICES; ord++) {
+		parts[ord].pt_eq = ord + 11;
+		parts[ord].pt_type = DT_DATA;
+		parts[ord].pt_state = DEV_ON;
+		parts[ord].pt_capacity = 1LL << 40;
+		parts[ord].pt_space = 1LL << 39;
+	}
+	control.mp = &mnt_info;
+	control.part = parts;
+	control.command = SHRINK_defrag;
+	control.fragments = 2;
+	control.tolerance = REBALANCE_TOLERANCE;
+	control.max_files = REBALANCE_MAX_FILES;
+	control.progress_interval = REBALANCE_PROGRESS;
+	control.do_not_execute = TRUE;
+	control.streams = 1;
+	if ((control.log = fopen("/dev/null", "w")) == NULL) {
+		perror("/dev/null");
+		return (EXIT_FAILURE);
+	}
+	sam_rebalance_init();
+
+	/*
+	 * 1: Striped 1 by the file system, contiguous.
+	 * 2: Striped 2 by setfa -s, contiguous.
+	 * 3: The layout of 1 on a file system which is not striped.
+	 * 4: Not striped, scattered.
+	 * 5: Striped 1, scattered on device 0.
+	 */
+	mnt_info.fi_stripe[DD] = 1;
+	makeFile(&ino, 1, -1, alt1, a);
+	sam_rank_file(&ino);
+	makeFile(&ino, 2, 2, alt2, b);
+	sam_rank_file(&ino);
+	makeFile(&ino, 5, -1, alt1, d);
+	sam_rank_file(&ino);
+	mnt_info.fi_stripe[DD] = 0;
+	makeFile(&ino, 3, -1, alt1, a);
+	sam_rank_file(&ino);
+	makeFile(&ino, 4, -1, one, c);
+	sam_rank_file(&ino);
+
+	(void) sam_rebalance_files("test");
+	for (i = 1; i < FILES; i++) {
+		if ((selected[i] != 0) != expect[i]) {
+			printf("File %d %s\n", i,
+			    expect[i] ? "not selected" : "selected");
+			failed++;
+		}
+	}
+	if (failed != 0) {
+		printf("FAILED: %d files\n", failed);
+		return (EXIT_FAILURE);
+	}
+	printf("PASSED\n");
+	return (EXIT_SUCCESS);
+}
+
+
+/*
+ * Make a file with large extents.  stripe < 0 for the stripe of the
+ * file system.
+ */
+static void
+makeFile(
+	sam_perm_inode_t *ip,
+	int ino,
+	int stripe,
+	const uchar_t *ords,
+	const uint32_t *extents)
+{
+	int	i;
+
+	memset(ip, 0, sizeof (*ip));
+	ip->di.id.ino = ino;
+	ip->di.id.gen = 1;
+	ip->di.blocks = 64;
+	if (stripe >= 0) {
+		ip->di.status.b.stripe_width = 1;
+		ip->di.stripe = stripe;
+	}
+	for (i = 0; i < NLDEXT; i++) {
+		ip->di.extent[NSDEXT + i] = extents[i];
+		ip->di.extent_ord[NSDEXT + i] = ords[i];
+	}
+}
@@ -346,6 +346,9 @@ int sam_rmmap_block(sam_node_t *ip, offset_t offset, offset_t count,
 	sam_map_t flag, struct sam_ioblk *iop);
 int sam_build_stagerd_req(sam_node_t *ip, int copy, sam_stage_request_t *req,
 	int *req_ext_cnt, sam_stage_request_t **req_ext, cred_t *credp);
+void sam_stage_list_begin(sam_stage_list_t *slp,
+	struct sam_fileops_ent *ents, int count);
+void sam_stage_list_end(sam_stage_list_t *slp);
 
 
 /* syscall.c function prototypes. */
@@ -412,6 +415,10 @@ int sam_zero_dau(sam_node_t *ip, offset_t boff, offset_t len,
 int sam_send_stage_cmd(sam_mount_t *mp, enum SCD_daemons scdi, void *cmd,
 	int size);
 int sam_send_scd_cmd(enum SCD_daemons scdi, void *cmd, int size);
+int sam_send_stage_batch(sam_mount_t *mp, sam_stage_batch_t *batch);
+sam_stage_batch_t *sam_alloc_stage_batch(int max);
+void sam_free_stage_batch(sam_stage_batch_t *batch);
+int sam_wait_stage_batch(void *arg);
 int	sam_wait_scd_cmd(enum SCD_daemons scdi, enum uio_seg segflag,
 			void *cmd, int size);
 int sam_send_stageall_cmd(sam_node_t *ip);
@@ -145,6 +145,7 @@ typedef struct {
 #endif	/* METADATA_SERVER */
 #ifdef sun
 	uint_t	tsd_fsflush_key;	/* TSD key for fsflush check */
+	uint_t	tsd_stage_list_key;	/* TSD key for list stage batch */
 #endif
 } sam_global_tbl_t;
 
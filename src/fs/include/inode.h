@@ -434,6 +434,7 @@ struct sam_blkd_frlock {
  *    size
  *    cl_closing
  *    last_unmap
+ *    alloc_pin
  *
  *  The following fields are protected by rm_mutex.
  *	rm_mutex also serializes shared-reader inode updates.
@@ -630,6 +631,7 @@ typedef struct sam_node {
 	int		seg_held;	/* Seg parent held by segment inode */
 	int		getino_waiters;	/* Cnt of threads waiting on ino info */
 	boolean_t	waiting_getino;	/* TRUE if NOTIFY_getino outstanding */
+	boolean_t	alloc_pin;	/* Allocate on di.unit only, no stripe */
 	short		stage_err;	/* Stage errno */
 
 	uchar_t		hash_flags;	/* Flags for hash table scan */
@@ -104,6 +104,8 @@ struct sam_syscall_daemon {
 	int size;		/* Size of command */
 	int timeout;		/* Ret EAGAIN if no daemon in timeout seconds */
 	uint64_t sequence;	/* Incremented when daemon takes a command */
+	sam_stage_batch_t *batch; /* Stage requests in place of cmd */
+	int batch_next;		/* Next request of batch to take */
 	union {
 		struct sam_fsd_cmd fsd;
 		struct sam_stageall stageall;
@@ -111,4 +113,18 @@ struct sam_syscall_daemon {
 	} cmd;
 };
 
+/*
+ * ----- Stage requests of a SC_fileops_list call.  The list is thread
+ * specific data while the files are staged, sam_stagerd_file adds the
+ * stage requests to the batch and the batch is sent to sam-stagerd in
+ * one command when the list is done.
+ */
+typedef struct sam_stage_list {
+	struct sam_mount *mp;		/* File system of the requests */
+	struct sam_fileops_ent *ents;	/* Entries of the list */
+	int ent;			/* List entry being staged */
+	int *req_ent;			/* List entry of each request */
+	sam_stage_batch_t *batch;	/* Requests not yet sent */
+} sam_stage_list_t;
+
 #endif	/* _SAM_FS_SCD_H */
@@ -176,11 +176,12 @@ sam_alloc_block(
 
 			/*
 			 * Increment to the next unit if stride is GE stripe.
+			 * A pinned allocation stays on its unit.
 			 */
 			stripe = (ip->di.status.b.stripe_width &&
 			    !S_ISDIR(ip->di.mode)) ?
 			    ip->di.stripe : mp->mt.fi_stripe[block->dt];
-			if (stripe) {
+			if (stripe && !ip->alloc_pin) {
 				ip->di.stride++;
 				if (ip->di.stride >= stripe) {
 					ip->di.stride = 0;
@@ -227,6 +228,9 @@ skip_this_unit:
 			 */
 			if (skipping_ord || mp->mi.m_fs[unit].skip_ord ||
 			    mp->mi.m_fs[unit].map_empty) {
+				if (ip->alloc_pin) {
+					return (SAM_ENOSPC(ip));
+				}
 				if (ip->di.blocks &&
 				    (mp->mt.fi_config1 &
 				    MC_MISMATCHED_GROUPS)) {
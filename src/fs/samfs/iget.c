@@ -581,6 +581,7 @@ sam_clear_incore_inode(sam_node_t *ip)
 	ip->seg_held = 0;
 	ip->getino_waiters = 0;
 	ip->waiting_getino = FALSE;
+	ip->alloc_pin = FALSE;
 	ip->stage_err = 0;
 	ip->hash_flags = 0;
 	ip->aclp = NULL;
@@ -455,6 +455,7 @@ _fini(void)
 	sam_zero_block = NULL;
 	sam_zero_block_size = 0;
 	tsd_destroy(&samgt.tsd_fsflush_key);
+	tsd_destroy(&samgt.tsd_stage_list_key);
 
 	sam_fini_kstats();
 
@@ -628,6 +629,7 @@ samfs_init(
 
 	samgt.buf_freelist = NULL;
 	tsd_create(&samgt.tsd_fsflush_key, sam_tsd_destroy);
+	tsd_create(&samgt.tsd_stage_list_key, NULL);
 
 	sam_zero_block_size = SAM_BLK * 2;
 	sam_zero_block = (char *)kmem_zalloc(sam_zero_block_size, KM_SLEEP);
@@ -2471,7 +2471,12 @@ sam_fseq_ord(
 		goto out;
 	}
 
-	ib_args.cmd = args.cmd;
+	/*
+	 * SAM_MOVE_ORD_ONLY is SAM_MOVE_ORD with the allocation pinned
+	 * to new_ord.
+	 */
+	ib_args.cmd = (args.cmd == SAM_MOVE_ORD_ONLY) ?
+	    SAM_MOVE_ORD : args.cmd;
 	ib_args.ord = args.ord;
 	ib_args.first_ord = ip->di.extent_ord[0];
 	ib_args.new_ord = args.new_ord;
@@ -2491,6 +2496,13 @@ sam_fseq_ord(
 		 */
 		opt = mp->mi.m_fs[ib_args.ord].part.pt_type;
 
+		if (args.cmd == SAM_MOVE_ORD_ONLY &&
+		    (ib_args.new_ord < 0 ||
+		    ib_args.new_ord >= mp->mt.fs_count ||
+		    is_stripe_group(opt))) {
+			error = EINVAL;
+			goto outrele;
+		}
 		if (is_stripe_group(opt)) {
 			/*
 			 * Old ordinal is a stripe group so
@@ -2568,6 +2580,7 @@ sam_fseq_ord(
 				    (npt & ~DT_STRIPE_GROUP_MASK);
 			}
 			ip->di.unit = (uchar_t)ib_args.new_ord;
+			ip->alloc_pin = (args.cmd == SAM_MOVE_ORD_ONLY);
 		} else {
 			error = sam_reset_unit(ip->mp, &(ip->di));
 			if (error != 0) {
@@ -2657,6 +2670,9 @@ sam_fseq_ord(
 	}
 
 skip_indirects:
+	if (ib_args.cmd == SAM_MOVE_ORD) {
+		ip->alloc_pin = FALSE;
+	}
 	if (doipupdate) {
 
 		TRANS_INODE(ip->mp, ip);
@@ -2697,6 +2713,7 @@ outunlock:
 
 	ASSERT(ib_args.cmd == SAM_MOVE_ORD);
 
+	ip->alloc_pin = FALSE;
 	if (remove_lease) {
 		save_error = error;
 		error = sam_proc_rm_lease(ip, CL_EXCLUSIVE, RW_WRITER);
@@ -742,6 +742,7 @@ sam_stagealld_call(cred_t *credp)
  * Stagerd requests:
  *		STAGER_setpid:      set sam-stagerd's pid into the global table
  *		STAGER_getrequest:  block until a stage is required
+ *		STAGER_getrequests: block until stages are required
  */
 
 static int			/* ERRNO if error, 0 if successful. */
@@ -771,6 +772,13 @@ sam_stagerd_call(
 		return (sam_wait_scd_cmd(SCD_stager, UIO_USERSPACE,
 		    request, sizeof (sam_stage_request_t)));
 
+	case STAGER_getrequests:
+		request = (void *)(long)args.p.batch.p32;
+		if (curproc->p_model != DATAMODEL_ILP32) {
+			request = (void *)args.p.batch.p64;
+		}
+		return (sam_wait_stage_batch(request));
+
 	case STAGER_setpid:
 		mutex_enter(&samgt.global_mutex);
 		samgt.stagerd_pid = args.p.pid;
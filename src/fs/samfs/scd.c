@@ -86,9 +86,13 @@
 #include "trace.h"
 
 static int sam_send_cmd(sam_mount_t *mp, struct sam_syscall_daemon *scd,
-	void *cmd, int size, int scdi);
+	void *cmd, int size, int scdi, sam_stage_batch_t *batch);
 static int sam_wait_cmd(struct sam_syscall_daemon *scd, enum uio_seg segflag,
 	void *cmd, int size, int scdi);
+#ifdef sun
+static int sam_take_batch_request(struct sam_syscall_daemon *scd,
+	enum uio_seg segflag, void *cmd, int size);
+#endif /* sun */
 static void sam_init_daemon(struct sam_syscall_daemon *scd);
 static void sam_finish_daemon(struct sam_syscall_daemon *scd);
 static boolean_t sam_is_failover_stage(int scdi, sam_mount_t *mp);
@@ -116,10 +120,62 @@ sam_send_stage_cmd(
 {
 	struct sam_syscall_daemon *scd = &sam_scd_table[scdi];
 
-	return (sam_send_cmd(mp, scd, cmd, size, (int)scdi));
+	return (sam_send_cmd(mp, scd, cmd, size, (int)scdi, NULL));
+}
+
+
+#ifdef sun
+
+/*
+ * ----- sam_send_stage_batch -
+ *
+ * Send the stage requests of a batch to sam-stagerd in one command.
+ * The daemon frees the batch when it takes the requests.  On error
+ * the batch still belongs to the caller.
+ */
+
+int				/* ERRNO if error, 0 if successful. */
+sam_send_stage_batch(
+	sam_mount_t *mp,		/* Pointer to Mount table */
+	sam_stage_batch_t *batch)	/* Stage requests, count > 0 */
+{
+	struct sam_syscall_daemon *scd = &sam_scd_table[SCD_stager];
+
+	return (sam_send_cmd(mp, scd, NULL,
+	    batch->count * sizeof (sam_stage_request_t), (int)SCD_stager,
+	    batch));
+}
+
+
+/*
+ * ----- sam_alloc_stage_batch - allocate a batch of max stage requests.
+ */
+
+sam_stage_batch_t *
+sam_alloc_stage_batch(int max)
+{
+	sam_stage_batch_t *batch;
+
+	batch = kmem_alloc(SAM_STAGE_BATCH_SIZE(max), KM_SLEEP);
+	batch->count = 0;
+	batch->max = max;
+	return (batch);
 }
 
 
+/*
+ * ----- sam_free_stage_batch - free a batch of stage requests.
+ */
+
+void
+sam_free_stage_batch(sam_stage_batch_t *batch)
+{
+	kmem_free(batch, SAM_STAGE_BATCH_SIZE(batch->max));
+}
+
+#endif /* sun */
+
+
 /*
  * ----- sam_send_scd_cmd - send command to the global system call daemon.
  *
@@ -136,7 +192,7 @@ sam_send_scd_cmd(
 {
 	struct sam_syscall_daemon *scd = &sam_scd_table[scdi];
 
-	return (sam_send_cmd(NULL, scd, cmd, size, (int)scdi));
+	return (sam_send_cmd(NULL, scd, cmd, size, (int)scdi, NULL));
 }
 
 
@@ -145,7 +201,8 @@ sam_send_scd_cmd(
  *
  * The file system waits until the one command slot is free. Then
  * the file system copies the command into the global table and
- * signals the possible waiting daemon.
+ * signals the possible waiting daemon.  A stage batch is not copied,
+ * the slot points to it until the daemon takes the requests.
  */
 
 static int				/* ERRNO if error, 0 if successful. */
@@ -154,7 +211,8 @@ sam_send_cmd(
 	struct sam_syscall_daemon *scd,	/* system call daemon record */
 	void *cmd,			/* Pointer to command */
 	int size,			/* Size of command */
-	int scdi)			/* Daemon index */
+	int scdi,			/* Daemon index */
+	sam_stage_batch_t *batch)	/* Stage batch in place of cmd */
 {
 	int ret;
 	int error = 0;
@@ -225,7 +283,12 @@ sam_send_cmd(
 	}
 	scd->package = 1;
 	scd->size = size;
-	bcopy(cmd, &scd->cmd, size);
+	if (batch != NULL) {
+		scd->batch = batch;
+		scd->batch_next = 0;
+	} else {
+		bcopy(cmd, &scd->cmd, size);
+	}
 	scd->put_wait--;
 	scd->sequence++;
 	cv_signal(&scd->get_cv);
@@ -323,6 +386,13 @@ sam_wait_cmd(
 		mutex_exit(&scd->mutex);
 		return (error);
 	}
+#ifdef sun
+	if (scd->batch != NULL) {
+		error = sam_take_batch_request(scd, segflag, cmd, size);
+		mutex_exit(&scd->mutex);
+		return (error);
+	}
+#endif /* sun */
 	size = MIN(size, scd->size);
 	if (size) {
 		if (segflag == UIO_USERSPACE) {
@@ -344,6 +414,105 @@ sam_wait_cmd(
 
 #ifdef	sun
 
+/*
+ * ----- sam_take_batch_request - take one request of a stage batch.
+ *
+ * The daemon asked for one stage request, the requests of the batch
+ * are returned one per call.  The slot is free when the last request
+ * is taken.  Daemon mutex set on entry and exit.
+ */
+
+static int				/* ERRNO if error, 0 if successful. */
+sam_take_batch_request(
+	struct sam_syscall_daemon *scd,	/* system call daemon record */
+	enum uio_seg segflag,		/* Location of buffer */
+	void *cmd,			/* Return request for daemon here */
+	int size)			/* Size of requested information */
+{
+	sam_stage_batch_t *batch = scd->batch;
+	sam_stage_request_t *req;
+	int error = 0;
+
+	req = &batch->request[scd->batch_next++];
+	size = MIN(size, sizeof (*req));
+	if (segflag == UIO_USERSPACE) {
+		if (copyout(req, cmd, size)) {
+			error = EFAULT;
+		}
+	} else {
+		bcopy(req, cmd, size);
+	}
+	if (scd->batch_next >= batch->count) {
+		sam_free_stage_batch(batch);
+		scd->batch = NULL;
+		scd->size = 0;
+		cv_signal(&scd->put_cv);
+	}
+	return (error);
+}
+
+
+/*
+ * ----- sam_wait_stage_batch - sam-stagerd waits for stage requests.
+ *
+ * As sam_wait_scd_cmd, but all the requests of a stage batch are
+ * returned in one call.  A single stage request is returned as a
+ * batch of one.  The batch is copied out after the slot is freed.
+ */
+
+int				/* ERRNO if error, 0 if successful. */
+sam_wait_stage_batch(
+	void *arg)		/* User sam_stage_batch_t */
+{
+	struct sam_syscall_daemon *scd = &sam_scd_table[SCD_stager];
+	sam_stage_batch_t *ubatch = (sam_stage_batch_t *)arg;
+	sam_stage_batch_t *batch;
+	int32_t count;
+	int next;
+	int error = 0;
+
+	mutex_enter(&scd->mutex);
+	scd->active = SCDAF_active;
+	TRACE(T_SAM_DAE_ACTIVE, NULL, scd->active, SCD_stager, 2);
+
+	while (scd->size == 0) {
+		if (cv_wait_sig(&scd->get_cv, &scd->mutex) == 0) {
+			mutex_exit(&scd->mutex);
+			return (EINTR);
+		}
+	}
+	if (scd->package == -1) {
+		mutex_exit(&scd->mutex);
+		return (ENOPKG);
+	}
+	batch = scd->batch;
+	next = scd->batch_next;
+	if (batch == NULL) {
+		count = 1;
+		if (copyout(&count, &ubatch->count, sizeof (count)) ||
+		    copyout(&scd->cmd.stager_arg, &ubatch->request[0],
+		    sizeof (sam_stage_request_t))) {
+			error = EFAULT;
+		}
+	}
+	scd->batch = NULL;
+	scd->size = 0;
+	cv_signal(&scd->put_cv);
+	mutex_exit(&scd->mutex);
+
+	if (batch != NULL) {
+		count = batch->count - next;
+		if (copyout(&count, &ubatch->count, sizeof (count)) ||
+		    copyout(&batch->request[next], &ubatch->request[0],
+		    count * sizeof (sam_stage_request_t))) {
+			error = EFAULT;
+		}
+		sam_free_stage_batch(batch);
+	}
+	return (error);
+}
+
+
 /*
  * ----- sam_clear_cmd - clear daemon command.
  *
@@ -360,6 +529,10 @@ sam_clear_cmd(enum SCD_daemons scdi)
 
 	mutex_enter(&scd->mutex);
 	cv_broadcast(&scd->put_cv);
+	if (scd->batch != NULL) {
+		sam_free_stage_batch(scd->batch);
+		scd->batch = NULL;
+	}
 	scd->size = 0;
 	scd->package = -1;
 	cv_signal(&scd->get_cv);
@@ -520,6 +693,8 @@ sam_init_daemon(struct sam_syscall_daemon *scd)
 	scd->active = SCDAF_starting;
 	scd->timeout = 0;
 	scd->sequence = 1;
+	scd->batch = NULL;
+	scd->batch_next = 0;
 }
 
 
@@ -532,6 +707,13 @@ sam_finish_daemon(struct sam_syscall_daemon *scd)
 	mutex_enter(&scd->mutex);
 	scd->package = -1;
 	scd->active = SCDAF_down;
+#ifdef sun
+	if (scd->batch != NULL) {
+		sam_free_stage_batch(scd->batch);
+		scd->batch = NULL;
+		scd->size = 0;
+	}
+#endif /* sun */
 	cv_signal(&scd->get_cv);
 	mutex_exit(&scd->mutex);
 }
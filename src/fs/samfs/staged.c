@@ -78,6 +78,7 @@
 #include "debug.h"
 #include "syslogerr.h"
 #include "trace.h"
+#include "kstats.h"
 
 int sam_stagerd_file(sam_node_t *ip, offset_t length, cred_t *credp);
 
@@ -86,6 +87,8 @@ int sam_stagerd_file(sam_node_t *ip, offset_t length, cred_t *credp);
 static int sam_build_stager_multivolume_copy(sam_node_t *ip, sam_id_t id,
 				int copy, sam_stage_request_t *req,
 				sam_stage_request_t *req_ext);
+static boolean_t sam_stage_list_add(sam_node_t *ip, sam_stage_request_t *req,
+				sam_stage_request_t *req_ext, int req_ext_cnt);
 
 int sam_stage_n_umem = 1;
 
@@ -189,23 +192,26 @@ sam_stagerd_file(
 		req->owner = bip->di.uid;
 		req->group = bip->di.gid;
 		req->filesys.stage_off = ip->stage_off;
+		for (i = 0; i < req_ext_cnt; i++) {
+			req_ext[i].pid = curproc->p_pid;
+			req_ext[i].user = crgetuid(credp);
+			req_ext[i].owner = bip->di.uid;
+			req_ext[i].group = bip->di.gid;
+			req_ext[i].filesys.stage_off = ip->stage_off;
+		}
 		RW_UNLOCK_OS(&ip->inode_rwl, RW_WRITER);
 
 		TRACES(T_SAM_FIFO_STAGE, SAM_ITOV(ip),
 		    (char *)req->arcopy[0].section[0].vsn);
-		error = sam_send_stage_cmd(ip->mp, SCD_stager, req,
-		    sizeof (*req));
+		if (length != 0 ||
+		    !sam_stage_list_add(ip, req, req_ext, req_ext_cnt)) {
+			error = sam_send_stage_cmd(ip->mp, SCD_stager, req,
+			    sizeof (*req));
 
-		/*
-		 *	Send any request extension, used for multivolume.
-		 */
-		for (i = 0; i < req_ext_cnt; i++) {
-			if (error == 0) {
-				req_ext[i].pid = curproc->p_pid;
-				req_ext[i].user = crgetuid(credp);
-				req_ext[i].owner = bip->di.uid;
-				req_ext[i].group = bip->di.gid;
-				req_ext[i].filesys.stage_off = ip->stage_off;
+			/*
+			 * Send any request extension, used for multivolume.
+			 */
+			for (i = 0; i < req_ext_cnt && error == 0; i++) {
 				error = sam_send_stage_cmd(ip->mp,
 				    SCD_stager, &req_ext[i],
 				    sizeof (*req));
@@ -235,6 +241,127 @@ out:
 }
 
 
+/*
+ * ----- sam_stage_list_begin - begin a SC_fileops_list stage.
+ *
+ * The stage requests of the list are added to a batch which is sent
+ * to sam-stagerd in one command by sam_stage_list_end.
+ */
+
+void
+sam_stage_list_begin(
+	sam_stage_list_t *slp,		/* List stage, on the stack */
+	struct sam_fileops_ent *ents,	/* Entries of the list */
+	int count)			/* Number of entries */
+{
+	slp->mp = NULL;
+	slp->ents = ents;
+	slp->ent = 0;
+	slp->req_ent = kmem_alloc(count * sizeof (int), KM_SLEEP);
+	slp->batch = sam_alloc_stage_batch(count);
+	tsd_set(samgt.tsd_stage_list_key, slp);
+}
+
+
+/*
+ * ----- sam_stage_list_add - add stage requests to the list batch.
+ *
+ * The caller adds only stages not waited on.  Shared file system stages
+ * are sent now, they must see a failover.  The requests of a file are
+ * added together or not at all.
+ */
+
+static boolean_t		/* B_TRUE if added to the batch */
+sam_stage_list_add(
+	sam_node_t *ip,			/* Inode, staging set */
+	sam_stage_request_t *req,	/* Stage request */
+	sam_stage_request_t *req_ext,	/* Multivolume extension */
+	int req_ext_cnt)		/* Number of extension requests */
+{
+	sam_stage_list_t *slp;
+	sam_stage_batch_t *batch;
+	int i;
+
+	slp = (sam_stage_list_t *)tsd_get(samgt.tsd_stage_list_key);
+	if (slp == NULL || SAM_IS_SHARED_FS(ip->mp)) {
+		return (B_FALSE);
+	}
+	if (slp->mp == NULL) {
+		slp->mp = ip->mp;
+	}
+	batch = slp->batch;
+	if (slp->mp != ip->mp ||
+	    batch->count + 1 + req_ext_cnt > batch->max) {
+		return (B_FALSE);
+	}
+	slp->req_ent[batch->count] = slp->ent;
+	batch->request[batch->count++] = *req;
+	for (i = 0; i < req_ext_cnt; i++) {
+		slp->req_ent[batch->count] = slp->ent;
+		batch->request[batch->count++] = req_ext[i];
+	}
+	return (B_TRUE);
+}
+
+
+/*
+ * ----- sam_stage_list_end - end a SC_fileops_list stage.
+ *
+ * Send the batch to sam-stagerd.  If the batch is not sent, the stage
+ * of each file in it fails as in sam_stagerd_file and the error is
+ * returned in the list entry of the file.
+ */
+
+void
+sam_stage_list_end(sam_stage_list_t *slp)
+{
+	sam_stage_batch_t *batch = slp->batch;
+	sam_stage_request_t *req;
+	sam_node_t *ip;
+	int max = batch->max;
+	int error = 0;
+	int i;
+
+	tsd_set(samgt.tsd_stage_list_key, NULL);
+	if (batch->count > 0) {
+		if ((error = sam_send_stage_batch(slp->mp, batch)) == 0) {
+			batch = NULL;		/* Freed by sam-stagerd */
+		}
+	}
+	for (i = 0; batch != NULL && i < batch->count; i++) {
+		req = &batch->request[i];
+		if (i > 0 && req->id.ino == req[-1].id.ino &&
+		    req->id.gen == req[-1].id.gen) {
+			continue;		/* Multivolume extension */
+		}
+		slp->ents[slp->req_ent[i]].error = error;
+		if (sam_get_ino(slp->mp->mi.m_vfsp, IG_EXISTS, &req->id,
+		    &ip)) {
+			continue;
+		}
+		RW_LOCK_OS(&ip->inode_rwl, RW_WRITER);
+		SAM_COUNT64(sam, stage_errors);
+		ip->stage_err = (short)error;
+		ip->flags.b.staging = 0;
+		ip->di.status.b.stage_failed = 1;
+		ip->flags.b.stage_n = ip->di.status.b.direct;
+		ip->flags.b.stage_all = ip->di.status.b.stage_all;
+		(void) sam_drop_ino(ip, CRED());
+		mutex_enter(&ip->rm_mutex);
+		if (ip->rm_wait) {
+			cv_broadcast(&ip->rm_cv);
+		}
+		mutex_exit(&ip->rm_mutex);
+		RW_UNLOCK_OS(&ip->inode_rwl, RW_WRITER);
+		VN_RELE(SAM_ITOV(ip));
+	}
+	if (batch != NULL) {
+		sam_free_stage_batch(batch);
+	}
+	kmem_free(slp->req_ent, max * sizeof (int));
+}
+
+
 /*
  * ----- sam_build_stagerd_req - stage an archived file via stager daemon.
  *
@@ -178,6 +178,9 @@ static int sam_stat_segment_file(int cmd, void *arg);
 static int sam_proc_foreign_stat(vnode_t *vp, int cmd,
 					void *args, cred_t *credp);
 static int sam_file_operations(int cmd, void *arg);
+static int sam_file_operations_vp(int cmd, vnode_t *rvp,
+	struct sam_fileops_arg *ap, cred_t *credp);
+static int sam_file_operations_list(void *arg, int size);
 static int sam_archive_copy(void *arg);
 static int sam_vsn_stat_segment(void *arg);
 static int sam_read_rminfo(void *arg);
@@ -250,6 +253,10 @@ __sam_syscall(
 			error = sam_file_operations(cmd, arg);
 			break;
 
+		case SC_fileops_list:
+			error = sam_file_operations_list(arg, size);
+			break;
+
 		case SC_projid:
 			error = sam_set_projid(arg, size);
 			break;
@@ -1337,8 +1344,6 @@ sam_file_operations(int cmd, void *arg)
 {
 	struct sam_fileops_arg args;
 	vnode_t *vp, *rvp;
-	sam_node_t *ip;
-	cred_t *credp;
 	int error;
 	void *path;
 
@@ -1358,6 +1363,186 @@ sam_file_operations(int cmd, void *arg)
 		VN_RELE(vp);
 		return (ENOTTY);
 	}
+	error = sam_file_operations_vp(cmd, rvp, &args, CRED());
+	VN_RELE(vp);
+	return (error);
+}
+
+
+/*
+ * ----- sam_file_operations_list - archive, cancelstage, release, stage,
+ * ssum syscall call for a list of files.
+ *
+ * The whole list is done in one call, the error of each entry is
+ * returned in the entry.  Naming a file by id skips the directory
+ * search permissions, so ids are only taken from the superuser as in
+ * the .ioctl id calls.  The stage requests of a list not waited on are
+ * sent to sam-stagerd in one batch when the list is done.
+ */
+
+static int		/* ERRNO if error, 0 if successful. */
+sam_file_operations_list(void *arg, int size)
+{
+	struct sam_fileops_list_arg args;
+	struct sam_fileops_arg fargs;
+	struct sam_fileops_ent *ents, *ep;
+	sam_stage_list_t stage_list;
+	sam_stage_list_t *slp = NULL;
+	char ops[SAM_MAX_OPS_LEN];
+	size_t opslen;
+	vnode_t *fsvp = NULL;
+	vnode_t *vp, *rvp;
+	struct vfs *vfsp = NULL;
+	sam_node_t *ip;
+	cred_t *credp;
+	size_t len;
+	void *ptr;
+	int error = 0;
+	int i;
+
+	if (size != sizeof (args) ||
+	    copyin(arg, (caddr_t)&args, sizeof (args))) {
+		return (EFAULT);
+	}
+	switch (args.cmd) {
+	case SC_archive:
+	case SC_cancelstage:
+	case SC_release:
+	case SC_stage:
+	case SC_ssum:
+		break;
+	default:
+		return (EINVAL);
+	}
+	if (args.count <= 0 || args.count > SAM_FILEOPS_LIST_MAX) {
+		return (EINVAL);
+	}
+	credp = CRED();
+
+	ptr = (void *)(long)args.fs.p32;
+	if (curproc->p_model != DATAMODEL_ILP32) {
+		ptr = (void *)args.fs.p64;
+	}
+	if (ptr != NULL) {
+		if ((error = lookupname(ptr, UIO_USERSPACE, FOLLOW,
+		    NULLVPP, &fsvp))) {
+			return (error);
+		}
+		if (sam_set_realvp(fsvp, &rvp)) {
+			VN_RELE(fsvp);
+			return (ENOTTY);
+		}
+		vfsp = rvp->v_vfsp;
+		if (secpolicy_fs_config(credp, vfsp)) {
+			VN_RELE(fsvp);
+			return (EPERM);
+		}
+	}
+
+	len = args.count * sizeof (struct sam_fileops_ent);
+	ents = kmem_alloc(len, KM_SLEEP);
+	ptr = (void *)(long)args.ents.p32;
+	if (curproc->p_model != DATAMODEL_ILP32) {
+		ptr = (void *)args.ents.p64;
+	}
+	if (copyin(ptr, (caddr_t)ents, len)) {
+		error = EFAULT;
+		goto out;
+	}
+
+	fargs.ops = args.ops;
+	if (args.cmd == SC_stage) {
+		void *uops;
+
+		uops = (void *)(long)args.ops.p32;
+		if (curproc->p_model != DATAMODEL_ILP32) {
+			uops = (void *)args.ops.p64;
+		}
+		if (copyinstr(uops, ops, sizeof (ops), &opslen) == 0 &&
+		    strchr(ops, 'w') == NULL) {
+			slp = &stage_list;
+			sam_stage_list_begin(slp, ents, args.count);
+		}
+	}
+	for (i = 0; i < args.count; i++) {
+		void *path;
+
+		ep = &ents[i];
+		if (slp != NULL) {
+			slp->ent = i;
+		}
+		fargs.path = ep->path;
+		path = (void *)(long)ep->path.p32;
+		if (curproc->p_model != DATAMODEL_ILP32) {
+			path = (void *)ep->path.p64;
+		}
+		if (path != NULL) {
+			if ((ep->error = lookupname(path, UIO_USERSPACE,
+			    NO_FOLLOW, NULLVPP, &vp)) == 0) {
+				if (sam_set_realvp(vp, &rvp)) {
+					ep->error = ENOTTY;
+				} else {
+					ep->error = sam_file_operations_vp(
+					    args.cmd, rvp, &fargs, credp);
+				}
+				VN_RELE(vp);
+			}
+		} else if (vfsp == NULL) {
+			ep->error = EINVAL;
+		} else if ((ep->error = sam_get_ino(vfsp, IG_EXISTS,
+		    &ep->id, &ip)) == 0) {
+			/*
+			 * Segment data inodes are done through their index.
+			 */
+			if (S_ISSEGS(&ip->di)) {
+				ep->error = EINVAL;
+			} else {
+				ep->error = sam_file_operations_vp(args.cmd,
+				    SAM_ITOV(ip), &fargs, credp);
+			}
+			VN_RELE(SAM_ITOV(ip));
+		}
+		if (ep->error == EINTR) {
+			/*
+			 * Signal received, the rest of the list is not done.
+			 */
+			for (i++; i < args.count; i++) {
+				ents[i].error = EINTR;
+			}
+			break;
+		}
+	}
+	if (slp != NULL) {
+		sam_stage_list_end(slp);
+	}
+	if (copyout((caddr_t)ents, ptr, len)) {
+		error = EFAULT;
+	}
+
+out:
+	kmem_free(ents, len);
+	if (fsvp != NULL) {
+		VN_RELE(fsvp);
+	}
+	return (error);
+}
+
+
+/*
+ * ----- sam_file_operations_vp - archive, cancelstage, release, stage,
+ * ssum, setfa, segment the SAM-QFS file rvp.
+ */
+
+static int		/* ERRNO if error, 0 if successful. */
+sam_file_operations_vp(
+	int cmd,			/* SC_archive, SC_stage, ... */
+	vnode_t *rvp,			/* SAM-QFS vnode, held */
+	struct sam_fileops_arg *ap,	/* Path and operations */
+	cred_t *credp)			/* Credentials */
+{
+	sam_node_t *ip;
+	int error;
+
 	ip = SAM_VTOI(rvp);
 	RW_LOCK_OS(&ip->inode_rwl, RW_WRITER);
 
@@ -1370,7 +1555,6 @@ sam_file_operations(int cmd, void *arg)
 	    !S_ISLNK(ip->di.mode) &&
 	    cmd != SC_archive && cmd != SC_stage && cmd != SC_cancelstage) {
 		RW_UNLOCK_OS(&ip->inode_rwl, RW_WRITER);
-		VN_RELE(vp);
 		return (EINVAL);
 	}
 #endif
@@ -1380,7 +1564,6 @@ sam_file_operations(int cmd, void *arg)
 	 * Except - owner cannot do "archive -n" or "release -n"
 	 * non-owner with "r" or "x" permission can stage.
 	 */
-	credp = CRED();
 	if (cmd != SC_stage && secpolicy_vnode_owner(credp, ip->di.uid)) {
 		error = EPERM;
 	} else if (cmd != SC_stage && ip->mp->mt.fi_mflag & MS_RDONLY) {
@@ -1401,7 +1584,7 @@ do_stage:
 				callback.p.syscall.func =
 				    sam_proc_file_operations;
 				callback.p.syscall.cmd = cmd;
-				callback.p.syscall.args = &args;
+				callback.p.syscall.args = ap;
 				callback.p.syscall.credp = credp;
 				error = sam_callback_segment(ip,
 				    CALLBACK_syscall, &callback,
@@ -1409,7 +1592,7 @@ do_stage:
 			}
 			if (error == 0) {
 				error = sam_proc_file_operations(rvp, cmd,
-				    &args, credp);
+				    ap, credp);
 				if ((cmd == SC_stage) &&
 				    SAM_IS_SHARED_SERVER(ip->mp) &&
 				    (error == EREMCHG)) {
@@ -1433,7 +1616,6 @@ do_stage:
 		}
 	}
 	RW_UNLOCK_OS(&ip->inode_rwl, RW_WRITER);
-	VN_RELE(vp);
 	return (error);
 }
 
@@ -66,6 +66,7 @@ static char *_SrcFile = __FILE__; /* Using __FILE__ makes duplicate strings */
 
 /* Solaris includes. */
 #include <door.h>
+#include <zlib.h>
 
 /* SAM-FS includes. */
 #define DEC_INIT
@@ -81,6 +82,8 @@ static char *_SrcFile = __FILE__; /* Using __FILE__ makes duplicate strings */
 #include "sam/syscall.h"
 #include "sam/uioctl.h"
 #include "sam/samevent.h"
+#include "sam/fsalog.h"
+#include "sam/fsabus.h"
 
 /* Logs are rolled over every 8 hours */
 #define	FSA_ROLLOVER_INTERVAL	28800
@@ -97,6 +100,7 @@ static char *_SrcFile = __FILE__; /* Using __FILE__ makes duplicate strings */
 
 /* Private data. */
 static	struct sam_event_buffer	*eb = NULL;
+static	sam_fsa_pub_t		*bus = NULL;	/* Event bus, NULL if off */
 
 /* Utlity functions.		*/
 extern	int	read_cmd_file(char *FileName);
@@ -110,6 +114,8 @@ static	void	fsalogdTraceInit(void);
 static	void	fsalogdInit(void);
 static	int	Open_FSA_log_file(char *);
 static	int	Write_FSA_log_file(char *, sam_event_t *, int);
+static	int	Flush_FSA_block(char *);
+static	int	Close_FSA_log_file(char *);
 static	void	check_log_expire(void);
 static	void	print_event(FILE *, sam_event_t *);
 
@@ -132,6 +138,9 @@ int		Log_Expire;		/* Log modification expiration 	*/
 int		Event_Interval;		/* Event interval time		*/
 int		Event_Buffer_Size;	/* Event buffer size		*/
 int		Event_Open_Retry;	/* Open syscall retry count	*/
+int		Log_Format;		/* FSA_FORMAT_RAW or _INDEXED	*/
+int		Log_Bloom = 1;		/* Inode bloom filter per block	*/
+int		Event_Bus = 1;		/* Copy events to consumer rings */
 
 static	thr_data_t	main_thr;
 static	pthread_mutex_t	door_mutex;	/* Locked when door open'ed	*/
@@ -148,6 +157,21 @@ static	int	check_expire	= 0;	/* Flag to check log expiration */
 static	time_t	logtime;		/* Log open time		*/
 static	int	fsa;			/* FSAlog file descriptor	*/
 
+/*
+ * Indexed log writer, see fsalog.h.  Events are gathered in a block
+ * which is written when full and at the end of each door call.
+ * Protected by door_mutex.
+ */
+static	sam_event_t	*blk_events = NULL; /* Events of the open block	*/
+static	int		blk_n;		/* Number of events in block	*/
+static	uint64_t	blk_first;	/* Number of first event	*/
+static	off_t		blk_offset;	/* File offset of block		*/
+static	char		*blk_buf = NULL; /* Block as written		*/
+static	size_t		blk_buf_size;
+static	sam_fsa_idx_t	*blk_idx = NULL; /* Index of the log		*/
+static	int		blk_n_idx;	/* Number of blocks written	*/
+static	int		blk_a_idx;	/* Number of entries allocated	*/
+
 typedef	struct	{			/* FSA event name table entry	*/
 	char	*label;			/* Event label string		*/
 	short	pino;			/* Parent inode used flag	*/
@@ -293,6 +317,10 @@ int	main(
 		exit(EXIT_FAILURE);
 	}
 
+	if (Event_Bus) {
+		bus = sam_fsa_pub_create(Logfile_Path, mnt_info.fi_name);
+	}
+
 	check_log_expire();
 	Event_Processor(mnt_info.fi_name);
 	exit(abort_daemon ? EXIT_FAILURE : EXIT_SUCCESS);
@@ -374,7 +402,7 @@ Event_Processor(
 			Trace(TR_MISC, "SIGHUP recieved");
 			caught_HUP   = 0;
 			(void) pthread_mutex_lock(&(door_mutex));
-			close(fsa);
+			(void) Close_FSA_log_file(fs_name);
 			fsa = Open_FSA_log_file(fs_name);
 			(void) pthread_mutex_unlock(&(door_mutex));
 			if (fsa < 0) {
@@ -390,6 +418,13 @@ Event_Processor(
 			check_log_expire();
 		}
 	}
+
+	/* door_mutex is held, write the index of an indexed log */
+	if (fsa >= 0) {
+		(void) Close_FSA_log_file(fs_name);
+	}
+	sam_fsa_pub_destroy(bus);
+	bus = NULL;
 }
 
 
@@ -491,7 +526,7 @@ read_events(
 
 	if (log_rollover || time(0l) - logtime > Log_Rollover) {
 		log_rollover = 0;
-		close(fsa);
+		(void) Close_FSA_log_file(fs_name);
 		fsa = Open_FSA_log_file(fs_name);
 		if (fsa < 0) {
 			Trace(TR_FATAL, "[%s] rollover failure, %s",
@@ -505,6 +540,10 @@ read_events(
 		goto sortie;
 	}
 
+	if (bus != NULL) {
+		sam_fsa_pub_scan(bus, FALSE);
+	}
+
 	if (eb->eb_buf_full[0] != eb->eb_buf_full[1]) {
 		EventBufFull += eb->eb_buf_full[0] - eb->eb_buf_full[1];
 		eb->eb_buf_full[1] = eb->eb_buf_full[0];
@@ -514,7 +553,7 @@ read_events(
 
 	/*
 	 * 	Process file system activity events:
-	 *	    1. write buffer to log file.
+	 *	    1. write buffer to log file and event bus rings.
 	 *	    2. scan events for invalid events.
 	 */
 	while (eb->eb_out != eb->eb_in) {
@@ -524,6 +563,10 @@ read_events(
 		n_ev = (in - eb->eb_out);
 		wst  = Write_FSA_log_file(fs_name, &eb->eb_event[eb->eb_out],
 		    n_ev);
+		if (bus != NULL) {
+			sam_fsa_pub_events(bus, &eb->eb_event[eb->eb_out],
+			    n_ev, eb->eb_ev_lost[0]);
+		}
 		if (in == eb->eb_limit)
 			in = 0;
 
@@ -562,9 +605,9 @@ read_events(
 				null_event.ev_param = FSA_STATUS_EXIT;
 				wst = Write_FSA_log_file(fs_name, &null_event,
 				    1);
+				wst |= Close_FSA_log_file(fs_name);
 				eb->eb_dstatus = wst ?
 				    FSA_STATUS_ABORT : FSA_STATUS_EXIT;
-				close(fsa);
 				Trace(TR_MISC,
 				    "[%s] Unmount received", fs_name);
 				exit(EXIT_SUCCESS);
@@ -572,15 +615,21 @@ read_events(
 		}
 	}
 
+	/* Make the events of this call visible to readers */
+	if (Flush_FSA_block(fs_name)) {
+		eb->eb_dstatus = FSA_STATUS_ABORT;
+		abort_daemon   = 1;
+	}
+
 	if (eb->eb_umount) {
 		memset(&null_event, 0, sizeof (sam_event_t));
 		null_event.ev_num   = ev_none;
 		null_event.ev_time  = time(0l);
 		null_event.ev_param = FSA_STATUS_EXIT;
 		wst = Write_FSA_log_file(fs_name, &null_event, 1);
+		wst |= Close_FSA_log_file(fs_name);
 		eb->eb_dstatus = wst ?
 		    FSA_STATUS_ABORT : FSA_STATUS_EXIT;
-		close(fsa);
 		Trace(TR_MISC, "[%s] Umount received", fs_name);
 		exit(EXIT_SUCCESS);
 	}
@@ -758,6 +807,11 @@ sigCatcher(int signal_caught)
  *
  *	At open, an initial null event is written to the log file.
  *
+ *	An indexed log is never appended to, its blocks would follow
+ *	the index of the previous log.  If a log of the same name
+ *	exists the name and the time of the log are advanced by a
+ *	minute.
+ *
  *	On Entry:
  *	    fs_name = Family set name.
  *
@@ -777,18 +831,32 @@ Open_FSA_log_file(char *fs_name)	/* SAMFS family set name */
 	sam_event_t	null_event;	/* Time stamp event		*/
 	int		l;
 
+	int		oflag;		/* Log file open flags		*/
+	int		tries;
+
 	l = strlen(Logfile_Path) + strlen(fs_name) + 42;
 	SamMalloc(fsa_path, l);
 
+	oflag = O_WRONLY|O_APPEND|O_CREAT;
+	if (Log_Format == FSA_FORMAT_INDEXED) {
+		oflag |= O_EXCL;
+	}
+
 	logtime = time(0l);
-	strftime(file, 40, "%Y%m%d%H%M.log", localtime(&logtime));
+	for (tries = 0; ; tries++) {
+		strftime(file, 40, "%Y%m%d%H%M.log", localtime(&logtime));
 
-	strcpy(fsa_path, Logfile_Path);
-	strcat(fsa_path, fs_name);
-	strcat(fsa_path, ".");
-	strcat(fsa_path, file);
+		strcpy(fsa_path, Logfile_Path);
+		strcat(fsa_path, fs_name);
+		strcat(fsa_path, ".");
+		strcat(fsa_path, file);
 
-	fsa = open(fsa_path, O_WRONLY|O_APPEND|O_CREAT, mode);
+		fsa = open(fsa_path, oflag, mode);
+		if (fsa != -1 || errno != EEXIST || tries >= 60) {
+			break;
+		}
+		logtime += 60;
+	}
 
 	if (fsa == -1) {
 		sam_syslog(LOG_ERR,
@@ -800,12 +868,19 @@ Open_FSA_log_file(char *fs_name)	/* SAMFS family set name */
 		Trace(TR_MISC, "[%s] log file now: %s", fs_name, fsa_path);
 	}
 
+	blk_n = 0;
+	blk_first = 0;
+	blk_offset = 0;
+	blk_n_idx = 0;
+
 	memset(&null_event, 0, sizeof (sam_event_t));
 	null_event.ev_num   = ev_none;
 	null_event.ev_time  = logtime;
 	null_event.ev_param = FSA_STATUS_RUNNING;
 
-	if (Write_FSA_log_file(fs_name, &null_event, 1)) {
+	/* The marker is alone in the first block of an indexed log */
+	if (Write_FSA_log_file(fs_name, &null_event, 1) ||
+	    Flush_FSA_block(fs_name)) {
 		close(fsa);
 		fsa = -1;
 	}
@@ -818,7 +893,9 @@ Open_FSA_log_file(char *fs_name)	/* SAMFS family set name */
 /*
  *	Write_FSA_log_file - Write to the File System Activity Log.
  *
- *	Writes entries to the file system activity log.
+ *	Writes entries to the file system activity log.  Entries of an
+ *	indexed log are added to the open block, which is written when
+ *	full or by Flush_FSA_block().
  *
  *	On Entry:
  *	    fs_name  = Family set name (used for error messages).
@@ -839,6 +916,26 @@ Write_FSA_log_file(
 	int		n;		/* Write(2) status		*/
 	int		len;		/* Buffer length in bytes	*/
 
+	if (Log_Format == FSA_FORMAT_INDEXED) {
+		if (blk_events == NULL) {
+			SamMalloc(blk_events,
+			    FSA_BLK_EVENTS * sizeof (sam_event_t));
+		}
+		while (n_events > 0) {
+			n = MIN(n_events, FSA_BLK_EVENTS - blk_n);
+			memcpy(&blk_events[blk_n], ebuf,
+			    n * sizeof (sam_event_t));
+			blk_n += n;
+			ebuf += n;
+			n_events -= n;
+			if (blk_n == FSA_BLK_EVENTS &&
+			    Flush_FSA_block(fs_name)) {
+				return (1);
+			}
+		}
+		return (0);
+	}
+
 	len = n_events * sizeof (sam_event_t);
 	n   = write(fsa, ebuf, len);
 
@@ -856,6 +953,174 @@ Write_FSA_log_file(
 	return (n != len);
 }
 
+
+/*
+ *	Flush_FSA_block - Write the open block of an indexed log.
+ *
+ *	The block header, bloom filter and compressed events are
+ *	written with a single write(2), so a reader finds either the
+ *	whole block or a short one which it ignores until complete.
+ *
+ *	On Return:
+ *	    Returns true if write failed.
+ */
+
+static int
+Flush_FSA_block(
+	char		*fs_name)	/* SAMFS family set name	*/
+
+{
+	sam_fsa_blk_t	*bh;		/* Block header			*/
+	uchar_t		*bloom;		/* Bloom filter			*/
+	uLongf		clen;		/* Compressed length		*/
+	size_t		len;		/* Block length in bytes	*/
+	uint32_t	nbits;
+	sam_event_t	*ev;
+	int		n;		/* Write(2) status		*/
+	int		i, j;
+
+	if (Log_Format != FSA_FORMAT_INDEXED || blk_n == 0) {
+		return (0);
+	}
+
+	if (blk_buf == NULL) {
+		blk_buf_size = sizeof (sam_fsa_blk_t) + FSA_BLOOM_MAX +
+		    compressBound(FSA_BLK_EVENTS * sizeof (sam_event_t));
+		SamMalloc(blk_buf, blk_buf_size);
+	}
+
+	bh = (sam_fsa_blk_t *)(void *)blk_buf;
+	memset(bh, 0, sizeof (sam_fsa_blk_t));
+	bh->fb_magic = FSA_BLK_MAGIC;
+	bh->fb_version = FSA_BLK_VERSION;
+	bh->fb_first = blk_first;
+	bh->fb_events = blk_n;
+	bh->fb_min_time = bh->fb_max_time = blk_events[0].ev_time;
+	bh->fb_min_ino = bh->fb_max_ino = blk_events[0].ev_id.ino;
+	bh->fb_min_seqno = bh->fb_max_seqno = blk_events[0].ev_seqno;
+	for (i = 1; i < blk_n; i++) {
+		ev = &blk_events[i];
+		bh->fb_min_time = MIN(bh->fb_min_time, ev->ev_time);
+		bh->fb_max_time = MAX(bh->fb_max_time, ev->ev_time);
+		bh->fb_min_ino = MIN(bh->fb_min_ino, ev->ev_id.ino);
+		bh->fb_max_ino = MAX(bh->fb_max_ino, ev->ev_id.ino);
+		bh->fb_min_seqno = MIN(bh->fb_min_seqno, ev->ev_seqno);
+		bh->fb_max_seqno = MAX(bh->fb_max_seqno, ev->ev_seqno);
+	}
+
+	/* About 16 bits per event, a few percent false positives */
+	if (Log_Bloom && blk_n > 1) {
+		for (len = FSA_BLOOM_MIN; len < FSA_BLOOM_MAX &&
+		    len < 2 * blk_n; len *= 2)
+			;
+		bh->fb_bloom_len = len;
+		bloom = (uchar_t *)blk_buf + sizeof (sam_fsa_blk_t);
+		memset(bloom, 0, len);
+		nbits = len * NBBY;
+		for (i = 0; i < blk_n; i++) {
+			for (j = 0; j < FSA_BLOOM_HASHES; j++) {
+				n = FSA_BLOOM_BIT(blk_events[i].ev_id.ino, j,
+				    nbits);
+				bloom[n / NBBY] |= 1 << (n % NBBY);
+			}
+		}
+	}
+
+	len = sizeof (sam_fsa_blk_t) + bh->fb_bloom_len;
+	clen = blk_buf_size - len;
+	if (compress2((Bytef *)blk_buf + len, &clen, (Bytef *)blk_events,
+	    blk_n * sizeof (sam_event_t), Z_BEST_SPEED) != Z_OK) {
+		sam_syslog(LOG_ERR, "%s: log block compression failed",
+		    fs_name);
+		Trace(TR_ERR, "[%s] log block compression failed", fs_name);
+		return (1);
+	}
+	bh->fb_clen = clen;
+	len += clen;
+
+	n = write(fsa, blk_buf, len);
+	if (n < 0) {
+		sam_syslog(LOG_ERR, "%s: log file write error: %m", fs_name);
+		Trace(TR_ERR, "[%s] log file write error: %s",
+		    fs_name, strerror(errno));
+	}
+	if (n >= 0 && n != len) {
+		sam_syslog(LOG_ERR, "%s: log file write truncated: %m",
+		    fs_name);
+		Trace(TR_ERR, "[%s] log file write truncated", fs_name);
+	}
+	if (n != len) {
+		return (1);
+	}
+
+	if (blk_n_idx == blk_a_idx) {
+		blk_a_idx += 256;
+		SamRealloc(blk_idx, blk_a_idx * sizeof (sam_fsa_idx_t));
+	}
+	blk_idx[blk_n_idx].fi_blk = *bh;
+	blk_idx[blk_n_idx].fi_offset = blk_offset;
+	blk_n_idx++;
+
+	blk_offset += len;
+	blk_first += blk_n;
+	blk_n = 0;
+	return (0);
+}
+
+
+/*
+ *	Close_FSA_log_file - Close the File System Activity Log.
+ *
+ *	The open block, index and trailer of an indexed log are
+ *	written before it is closed.
+ *
+ *	On Return:
+ *	    Returns true if write failed.
+ */
+
+static int
+Close_FSA_log_file(
+	char		*fs_name)	/* SAMFS family set name	*/
+
+{
+	sam_fsa_trailer_t *ft;		/* Index trailer		*/
+	size_t		len;		/* Index length in bytes	*/
+	int		n;		/* Write(2) status		*/
+	int		rst = 0;
+
+	if (Log_Format == FSA_FORMAT_INDEXED) {
+		rst = Flush_FSA_block(fs_name);
+	}
+
+	if (rst == 0 && Log_Format == FSA_FORMAT_INDEXED) {
+		/* Room for the trailer after the index */
+		if (blk_n_idx + 1 > blk_a_idx) {
+			blk_a_idx += 256;
+			SamRealloc(blk_idx,
+			    blk_a_idx * sizeof (sam_fsa_idx_t));
+		}
+		len = blk_n_idx * sizeof (sam_fsa_idx_t);
+		ft = (sam_fsa_trailer_t *)(void *)((char *)blk_idx + len);
+		ft->ft_index = blk_offset;
+		ft->ft_magic = FSA_IDX_MAGIC;
+		ft->ft_blocks = blk_n_idx;
+		len += sizeof (sam_fsa_trailer_t);
+
+		n = write(fsa, blk_idx, len);
+		if (n != len) {
+			sam_syslog(LOG_ERR, "%s: log index write error: %m",
+			    fs_name);
+			Trace(TR_ERR, "[%s] log index write error: %s",
+			    fs_name, strerror(errno));
+			rst = 1;
+		}
+	}
+
+	close(fsa);
+	fsa = -1;
+	return (rst);
+}
+
 /*
  * Checks each logfile in 'Logfile_Path' directory.  If the
  * logfile timestamp is older than the calculated expired
@@ -57,6 +57,8 @@ static char *_SrcFile = __FILE__; /* Using __FILE__ makes duplicate strings */
 #include "sam/readcfg.h"
 #include "sam/names.h"
 #include "sam/sam_malloc.h"
+#include "sam/samevent.h"
+#include "sam/fsalog.h"
 
 #include "sam/lint.h"
 
@@ -71,6 +73,9 @@ static void cmd_log_expire(void);
 static void cmd_event_interval(void);
 static void cmd_event_buffer(void);
 static void cmd_open_retry(void);
+static void cmd_log_format(void);
+static void cmd_log_bloom(void);
+static void cmd_event_bus(void);
 static void read_config_msg(char *msg, int lineno, char *line);
 
 /*
@@ -84,6 +89,9 @@ static DirProc_t dirProcTable[] = {
 	{ "event_interval",		cmd_event_interval,	DP_value },
 	{ "event_buffer_size",		cmd_event_buffer,	DP_value },
 	{ "event_open_retry",		cmd_open_retry,		DP_value },
+	{ "log_format",			cmd_log_format,		DP_value },
+	{ "log_bloom",			cmd_log_bloom,		DP_value },
+	{ "event_bus",			cmd_event_bus,		DP_value },
 	{ NULL,	NULL }
 };
 
@@ -103,6 +111,9 @@ extern	int	Log_Expire;		/* Log inactivity expiration	*/
 extern	int	Event_Interval;		/* Event interval time		*/
 extern	int	Event_Buffer_Size;	/* Event buffer size		*/
 extern	int	Event_Open_Retry;	/* Open syscall retry count	*/
+extern	int	Log_Format;		/* FSA_FORMAT_RAW or _INDEXED	*/
+extern	int	Log_Bloom;		/* Inode bloom filter per block	*/
+extern	int	Event_Bus;		/* Copy events to consumer rings */
 
 
 /*
@@ -243,6 +254,54 @@ cmd_open_retry(void)
 }
 
 
+static void
+cmd_log_format(void)
+{
+	if (not_for_this_fs) {
+		return;
+	}
+	if (strcmp(token, "raw") == 0) {
+		Log_Format = FSA_FORMAT_RAW;
+	} else if (strcmp(token, "indexed") == 0) {
+		Log_Format = FSA_FORMAT_INDEXED;
+	} else {
+		ReadCfgError(8020, token, fs_name);
+	}
+}
+
+
+static void
+cmd_log_bloom(void)
+{
+	if (not_for_this_fs) {
+		return;
+	}
+	if (strcmp(token, "on") == 0) {
+		Log_Bloom = 1;
+	} else if (strcmp(token, "off") == 0) {
+		Log_Bloom = 0;
+	} else {
+		ReadCfgError(8020, token, fs_name);
+	}
+}
+
+
+static void
+cmd_event_bus(void)
+{
+	if (not_for_this_fs) {
+		return;
+	}
+	if (strcmp(token, "on") == 0) {
+		Event_Bus = 1;
+	} else if (strcmp(token, "off") == 0) {
+		Event_Bus = 0;
+	} else {
+		ReadCfgError(8020, token, fs_name);
+	}
+}
+
+
 /*
  *  Message handler for ReadCfg module.
  */
@@ -89,6 +89,8 @@ static int check_args_consistency(struct sam_archive_copy_arg *arg);
 static int parse_args(struct sam_archive_copy_arg *arg,
 			int num_opts, va_list opts_list);
 static int check_permissions();
+static int fileops_list(int cmd, const char *fs, sam_fileop_t *list,
+			int count, const char *ops);
 
 /* Public data. */
 #pragma weak cs_simple
@@ -449,6 +451,89 @@ sam_advise(
 }
 
 
+/*
+ *	List operations.
+ *	The file operations for each file of a list.  The list is submitted
+ *	SAM_FILEOPS_LIST_MAX entries per system call.  Files named by id
+ *	are in the file system holding fs, and require the superuser.
+ *	Returns the number of entries with an error, -1 if the list could
+ *	not be submitted.
+ */
+int
+sam_archive_list(
+	const char *fs,		/* File in the file system of the ids */
+	sam_fileop_t *list,	/* Files */
+	int count,		/* Number of files */
+	const char *ops)	/* Operations */
+{
+	return (fileops_list(SC_archive, fs, list, count, ops));
+}
+
+
+int
+sam_cancelstage_list(
+	const char *fs,		/* File in the file system of the ids */
+	sam_fileop_t *list,	/* Files */
+	int count)		/* Number of files */
+{
+	return (fileops_list(SC_cancelstage, fs, list, count, "\0"));
+}
+
+
+int
+sam_release_list(
+	const char *fs,		/* File in the file system of the ids */
+	sam_fileop_t *list,	/* Files */
+	int count,		/* Number of files */
+	const char *ops)	/* Operations */
+{
+	return (fileops_list(SC_release, fs, list, count, ops));
+}
+
+
+int
+sam_stage_list(
+	const char *fs,		/* File in the file system of the ids */
+	sam_fileop_t *list,	/* Files */
+	int count,		/* Number of files */
+	const char *ops)	/* Operations */
+{
+	return (fileops_list(SC_stage, fs, list, count, ops));
+}
+
+
+int
+sam_ssum_list(
+	const char *fs,		/* File in the file system of the ids */
+	sam_fileop_t *list,	/* Files */
+	int count,		/* Number of files */
+	const char *ops)	/* Operations */
+{
+	int failed = 0;
+	int i;
+
+	if (strchr(ops, 'G') == NULL) {
+		return (fileops_list(SC_ssum, fs, list, count, ops));
+	}
+
+	/*
+	 * The checksum is generated by reading the file, one at a time.
+	 */
+	for (i = 0; i < count; i++) {
+		list[i].error = 0;
+		if (list[i].path == NULL) {
+			list[i].error = EINVAL;
+		} else if (sam_ssum(list[i].path, ops) < 0) {
+			list[i].error = errno;
+		}
+		if (list[i].error != 0) {
+			failed++;
+		}
+	}
+	return (failed);
+}
+
+
 /*
  *	listio read
  */
@@ -557,6 +642,72 @@ compute_checksum(const char *path, csum_t *csum)
 	return (0);
 }
 
+/*
+ *	Submit a file operations list.
+ */
+static int
+fileops_list(
+	int cmd,		/* SC_archive, SC_stage, ... */
+	const char *fs,		/* File in the file system of the ids */
+	sam_fileop_t *list,	/* Files */
+	int count,		/* Number of files */
+	const char *ops)	/* Operations */
+{
+	struct sam_fileops_list_arg arg;
+	struct sam_fileops_ent *ents;
+	int failed = 0;
+	int done;
+	int n;
+	int i;
+
+	if (count <= 0) {
+		return (0);
+	}
+	n = (count < SAM_FILEOPS_LIST_MAX) ? count : SAM_FILEOPS_LIST_MAX;
+	if ((ents = malloc(n * sizeof (struct sam_fileops_ent))) == NULL) {
+		return (-1);
+	}
+	memset(&arg, 0, sizeof (arg));
+	arg.fs.ptr = fs;
+	arg.ops.ptr = ops;
+	arg.ents.ptr = ents;
+	arg.cmd = cmd;
+
+	for (done = 0; done < count; done += n) {
+		sam_fileop_t *lp = &list[done];
+
+		n = count - done;
+		if (n > SAM_FILEOPS_LIST_MAX) {
+			n = SAM_FILEOPS_LIST_MAX;
+		}
+		memset(ents, 0, n * sizeof (struct sam_fileops_ent));
+		for (i = 0; i < n; i++) {
+			ents[i].path.ptr = lp[i].path;
+			ents[i].id.ino = lp[i].ino;
+			ents[i].id.gen = lp[i].gen;
+		}
+		arg.count = n;
+		if (sam_syscall(SC_fileops_list, &arg, sizeof (arg)) < 0) {
+			int err = errno;
+
+			for (i = done; i < count; i++) {
+				list[i].error = err;
+			}
+			free(ents);
+			errno = err;
+			return (-1);
+		}
+		for (i = 0; i < n; i++) {
+			lp[i].error = ents[i].error;
+			if (ents[i].error != 0) {
+				failed++;
+			}
+		}
+	}
+	free(ents);
+	return (failed);
+}
+
 /*
  *	Ascertain super-user privilege level to execute command
  */
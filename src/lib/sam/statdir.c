@@ -0,0 +1,625 @@
+/*
+ * statdir.c - Bulk status of the entries of a SAMFS directory.
+ *
+ *	The directory is read in large blocks with the F_GETDENTS ioctl
+ *	and each entry is stat'ed by inode id with F_IDSTAT, so no path
+ *	lookup is made per entry.  F_IDSTAT is privileged; when it is not
+ *	available, or the directory is not on a SAM-FS file system, the
+ *	entries are stat'ed by path with sam_lstat().
+ */
+
+/*
+ *    SAM-QFS_notice_begin
+ *
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at pkg/OPENSOLARIS.LICENSE
+ * or https://illumos.org/license/CDDL.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at pkg/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+
+#pragma ident "$Revision: 1.1 $"
+
+
+/* Feature test switches. */
+	/* None. */
+
+/* ANSI C headers. */
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* POSIX headers. */
+#include <sys/types.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* Solaris headers. */
+#ifdef sun
+#include <sys/ioctl.h>
+#include <sys/mkdev.h>
+#endif /* sun */
+
+/* SAM-FS headers. */
+#ifdef	linux
+#include "sam/linux_types.h"
+#endif	/* linux */
+#include "pub/stat.h"
+#include "sam/types.h"
+#include "sam/lib.h"
+#ifdef sun
+#include "sam/fioctl.h"
+#include "sam/uioctl.h"
+#include "sam/fs/dirent.h"
+#include "sam/fs/ino.h"
+#include "sam/fs/sblk.h"
+#endif /* sun */
+
+/* Local headers. */
+	/* None. */
+
+/* Macros. */
+#define	SD_BUFSIZE	(64 * 1024)	/* F_GETDENTS buffer size */
+#define	SD_BATCH	1024		/* Maximum entries returned per call */
+
+/* Types. */
+	/* None. */
+
+/* Structures. */
+struct sam_dirstat {
+	int	sd_fd;			/* Directory fd for F_GETDENTS */
+	DIR	*sd_dirp;		/* readdir() stream if not F_GETDENTS */
+	int	sd_idstat;		/* Stat entries with F_IDSTAT */
+	int	sd_eof;			/* End of directory reached */
+	char	*sd_path;		/* "dir/" followed by the entry name */
+	size_t	sd_pathlen;		/* Length of "dir/" */
+	size_t	sd_pathsize;		/* Space allocated for sd_path */
+	struct sam_stat sd_dir;		/* Status of the directory */
+#ifdef sun
+	offset_t sd_offset;		/* Directory offset for F_GETDENTS */
+	uint32_t sd_magic;		/* File system magic */
+	int	sd_stripe;		/* Default stripe width, -1 if unknown */
+	int	sd_valid;		/* Bytes of sd_buf valid */
+	int	sd_next;		/* Offset of next entry in sd_buf */
+	char	*sd_buf;		/* F_GETDENTS buffer */
+#endif /* sun */
+	struct sam_dirstat_ent sd_ents[SD_BATCH];
+};
+
+/* Private data. */
+#ifdef sun
+static int noIdstat = 0;	/* F_IDSTAT refused for this process */
+#endif /* sun */
+
+/* Private functions. */
+static int readGeneric(sam_dirstat_t *dsp);
+static void statByPath(sam_dirstat_t *dsp, struct sam_dirstat_ent *ep);
+#ifdef sun
+static int readDents(sam_dirstat_t *dsp);
+static void statById(sam_dirstat_t *dsp, struct sam_dirstat_ent *ep,
+	sam_id_t id);
+static void fillStat(sam_dirstat_t *dsp, struct sam_perm_inode *pip,
+	struct sam_stat *sb);
+#endif /* sun */
+
+/* Public data. */
+	/* None. */
+
+/* Function macros. */
+	/* None. */
+
+/* Signal catching functions. */
+	/* None. */
+
+
+/*
+ * Open directory for bulk status.
+ */
+sam_dirstat_t *
+sam_opendir_stat(
+	const char *path)
+{
+	sam_dirstat_t *dsp;
+	size_t l;
+
+	if ((dsp = malloc(sizeof (*dsp))) == NULL) {
+		return (NULL);
+	}
+	memset(dsp, 0, sizeof (*dsp) - sizeof (dsp->sd_ents));
+	dsp->sd_fd = -1;
+
+	l = strlen(path);
+	dsp->sd_pathsize = l + 2 + MAXNAMELEN;
+	if ((dsp->sd_path = malloc(dsp->sd_pathsize)) == NULL) {
+		free(dsp);
+		return (NULL);
+	}
+	memmove(dsp->sd_path, path, l);
+	if (l == 0 || path[l - 1] != '/') {
+		dsp->sd_path[l++] = '/';
+	}
+	dsp->sd_path[l] = '\0';
+	dsp->sd_pathlen = l;
+
+	if (sam_stat(path, &dsp->sd_dir, sizeof (dsp->sd_dir)) < 0) {
+		goto out;
+	}
+	if (!S_ISDIR(dsp->sd_dir.st_mode)) {
+		errno = ENOTDIR;
+		goto out;
+	}
+
+#ifdef sun
+	if (SS_ISSAMFS(dsp->sd_dir.attr)) {
+		struct sam_ioctl_idstat idstat;
+		struct sam_perm_inode pi;
+
+		if ((dsp->sd_fd = open(path, O_RDONLY)) < 0) {
+			goto out;
+		}
+		if ((dsp->sd_buf = malloc(SD_BUFSIZE)) == NULL) {
+			goto out;
+		}
+		dsp->sd_stripe = -1;
+
+		/*
+		 * Stat the directory by id to see whether F_IDSTAT is
+		 * allowed.  The directory also supplies the mount default
+		 * stripe width when it has none set of its own.
+		 */
+		if (!noIdstat) {
+			memset(&idstat, 0, sizeof (idstat));
+			idstat.id.ino = dsp->sd_dir.st_ino;
+			idstat.id.gen = dsp->sd_dir.gen;
+			idstat.size = sizeof (pi);
+			idstat.dp.ptr = (void *)&pi;
+			if (ioctl(dsp->sd_fd, F_IDSTAT, &idstat) == 0) {
+				dsp->sd_idstat = 1;
+				dsp->sd_magic = idstat.magic;
+				if (!pi.di.status.b.stripe_width) {
+					dsp->sd_stripe =
+					    dsp->sd_dir.stripe_width;
+				}
+			} else if (errno == EPERM || errno == EACCES ||
+			    errno == ENOTTY) {
+				noIdstat = 1;
+			}
+		}
+		return (dsp);
+	}
+#endif /* sun */
+
+	if ((dsp->sd_dirp = opendir(path)) == NULL) {
+		goto out;
+	}
+	return (dsp);
+
+out:
+	{
+		int saveErrno = errno;
+
+		(void) sam_closedir_stat(dsp);
+		errno = saveErrno;
+	}
+	return (NULL);
+}
+
+
+/*
+ * Read next batch of directory entries with their status.
+ */
+int
+sam_readdir_stat(
+	sam_dirstat_t *dsp,
+	struct sam_dirstat_ent **entp)
+{
+	*entp = dsp->sd_ents;
+	if (dsp->sd_eof) {
+		return (0);
+	}
+#ifdef sun
+	if (dsp->sd_fd >= 0) {
+		return (readDents(dsp));
+	}
+#endif /* sun */
+	return (readGeneric(dsp));
+}
+
+
+/*
+ * Close bulk status directory.
+ */
+int
+sam_closedir_stat(
+	sam_dirstat_t *dsp)
+{
+	int ret = 0;
+
+	if (dsp->sd_dirp != NULL && closedir(dsp->sd_dirp) < 0) {
+		ret = -1;
+	}
+	if (dsp->sd_fd >= 0 && close(dsp->sd_fd) < 0) {
+		ret = -1;
+	}
+#ifdef sun
+	if (dsp->sd_buf != NULL) {
+		free(dsp->sd_buf);
+	}
+#endif /* sun */
+	free(dsp->sd_path);
+	free(dsp);
+	return (ret);
+}
+
+
+/* Private functions. */
+
+
+/*
+ * Read directory with readdir() and stat each entry by path.
+ * The name is kept in the path buffer, so one entry is returned.
+ */
+static int
+readGeneric(
+	sam_dirstat_t *dsp)
+{
+	struct sam_dirstat_ent *ep;
+	struct dirent *dp;
+	size_t l;
+
+	errno = 0;
+	if ((dp = readdir(dsp->sd_dirp)) == NULL) {
+		if (errno != 0) {
+			return (-1);
+		}
+		dsp->sd_eof = 1;
+		return (0);
+	}
+	l = strlen(dp->d_name);
+	if (dsp->sd_pathlen + l + 1 > dsp->sd_pathsize) {
+		char *p;
+
+		p = realloc(dsp->sd_path, dsp->sd_pathlen + l + 1);
+		if (p == NULL) {
+			return (-1);
+		}
+		dsp->sd_path = p;
+		dsp->sd_pathsize = dsp->sd_pathlen + l + 1;
+	}
+	ep = &dsp->sd_ents[0];
+	ep->name = dsp->sd_path + dsp->sd_pathlen;
+	memmove(ep->name, dp->d_name, l + 1);
+	statByPath(dsp, ep);
+	return (1);
+}
+
+
+/*
+ * Stat entry by path.
+ */
+static void
+statByPath(
+	sam_dirstat_t *dsp,
+	struct sam_dirstat_ent *ep)
+{
+	char *name;
+
+	name = dsp->sd_path + dsp->sd_pathlen;
+	if (ep->name != name) {
+		(void) strcpy(name, ep->name);
+	}
+	ep->error = 0;
+	if (sam_lstat(dsp->sd_path, &ep->st, sizeof (ep->st)) < 0) {
+		ep->error = errno;
+	}
+}
+
+
+#ifdef sun
+
+/*
+ * Read directory with F_GETDENTS and stat entries by id.
+ * Returns the entries remaining in the directory buffer, refilling
+ * it when empty.
+ */
+static int
+readDents(
+	sam_dirstat_t *dsp)
+{
+	int n;
+
+	n = 0;
+	while (n == 0) {
+		if (dsp->sd_next >= dsp->sd_valid) {
+			sam_ioctl_getdents_t gd;
+
+			gd.dir.ptr = (struct sam_dirent *)(void *)dsp->sd_buf;
+			gd.size = SD_BUFSIZE;
+			gd.offset = dsp->sd_offset;
+			gd.eof = 0;
+			dsp->sd_valid = ioctl(dsp->sd_fd, F_GETDENTS, &gd);
+			if (dsp->sd_valid < 0) {
+				dsp->sd_valid = 0;
+				return (-1);
+			}
+			if (dsp->sd_valid == 0) {
+				dsp->sd_eof = 1;
+				return (0);
+			}
+			dsp->sd_offset = gd.offset;
+			dsp->sd_next = 0;
+		}
+
+		while (n < SD_BATCH && dsp->sd_next < dsp->sd_valid) {
+			struct sam_dirstat_ent *ep;
+			struct sam_dirent *dp;
+			size_t l;
+
+			dp = (struct sam_dirent *)(void *)
+			    (dsp->sd_buf + dsp->sd_next);
+			if (dp->d_reclen == 0) {
+				dsp->sd_next = dsp->sd_valid;
+				break;
+			}
+			dsp->sd_next += SAM_DIRSIZ(dp);
+			if (dp->d_fmt == 0) {
+				continue;
+			}
+			l = dp->d_namlen;
+			if (dsp->sd_pathlen + l + 1 > dsp->sd_pathsize) {
+				char *p;
+
+				p = realloc(dsp->sd_path,
+				    dsp->sd_pathlen + l + 1);
+				if (p == NULL) {
+					return (-1);
+				}
+				dsp->sd_path = p;
+				dsp->sd_pathsize = dsp->sd_pathlen + l + 1;
+			}
+			ep = &dsp->sd_ents[n++];
+			ep->name = (char *)dp->d_name;
+			ep->name[l] = '\0';
+
+			/*
+			 * "." and ".." may name a directory on another
+			 * file system, stat them by path.
+			 */
+			if (!dsp->sd_idstat || dp->d_id.gen == 0 ||
+			    strcmp(ep->name, ".") == 0 ||
+			    strcmp(ep->name, "..") == 0) {
+				statByPath(dsp, ep);
+			} else {
+				statById(dsp, ep, dp->d_id);
+			}
+		}
+	}
+	return (n);
+}
+
+
+/*
+ * Stat entry by id.
+ * Mount points (EXDEV), entries changed since the directory was read
+ * and any other failure are stat'ed by path instead.
+ */
+static void
+statById(
+	sam_dirstat_t *dsp,
+	struct sam_dirstat_ent *ep,
+	sam_id_t id)
+{
+	struct sam_ioctl_idstat idstat;
+	struct sam_perm_inode pi;
+
+	idstat.id = id;
+	idstat.size = sizeof (pi);
+	idstat.dp.ptr = (void *)&pi;
+	if (ioctl(dsp->sd_fd, F_IDSTAT, &idstat) < 0) {
+		if (errno == EPERM || errno == EACCES) {
+			dsp->sd_idstat = 0;
+		}
+		statByPath(dsp, ep);
+		return;
+	}
+	if (pi.di.mode == 0 || pi.di.id.ino != id.ino ||
+	    pi.di.id.gen != id.gen) {
+		statByPath(dsp, ep);
+		return;
+	}
+
+	/*
+	 * The mount default stripe width is only known from the kernel,
+	 * take it from the first entry which has no stripe width set.
+	 */
+	if (dsp->sd_stripe < 0 && !pi.di.status.b.stripe_width) {
+		statByPath(dsp, ep);
+		if (ep->error == 0) {
+			dsp->sd_stripe = ep->st.stripe_width;
+		}
+		return;
+	}
+	ep->error = 0;
+	fillStat(dsp, &pi, &ep->st);
+}
+
+
+/*
+ * Fill in sam_stat from permanent inode.
+ * Follows sam_proc_stat() in the file system.
+ */
+static void
+fillStat(
+	sam_dirstat_t *dsp,
+	struct sam_perm_inode *pip,
+	struct sam_stat *sb)
+{
+	struct sam_disk_inode *dip = &pip->di;
+	mode_t fmt;
+	int copy, mask;
+
+	memset(sb, 0, sizeof (*sb));
+
+	sb->st_ino = dip->id.ino;
+	fmt = S_ISREQ(dip->mode) ? S_IFREG : (dip->mode & S_IFMT);
+	if ((dip->rm.ui.flags & RM_CHAR_DEV_FILE) && fmt == S_IFCHR) {
+		fmt = S_IFREG;
+	}
+	sb->st_mode = fmt | dip->mode;
+	sb->st_nlink = dip->nlink;
+	sb->st_uid = dip->uid;
+	sb->st_gid = dip->gid;
+	if (S_ISLNK(dip->mode) && (dip->ext_attrs & ext_sln)) {
+		sb->st_size = dip->psize.symlink;
+	} else {
+		sb->st_size = dip->rm.size;
+	}
+	sb->st_atime = dip->access_time.tv_sec;
+	sb->st_mtime = dip->modify_time.tv_sec;
+	sb->st_ctime = dip->change_time.tv_sec;
+	sb->st_dev = dsp->sd_dir.st_dev;
+	if (S_ISBLK(dip->mode) || S_ISCHR(dip->mode)) {
+#ifdef _LP64
+		sb->rdev = expldev((dev32_t)dip->psize.rdev);
+#else
+		sb->rdev = (dev_t)dip->psize.rdev;
+#endif /* _LP64 */
+	}
+
+	/*
+	 * Add SAMFS info.
+	 */
+	sb->attr = (dip->status.bits & SAM_ATTR_MASK) | SS_SAMFS;
+	if (dip->arch_status != 0) {
+		sb->attr |= SS_ARCHIVED;
+	}
+	for (copy = 0; copy < MAX_ARCHIVE; copy++) {
+		if (!dip->status.b.archdone &&
+		    (dip->ar_flags[copy] & AR_arch_i)) {
+			sb->attr |= SS_ARCHIVE_A;
+		}
+		if (dip->ar_flags[copy] & AR_rearch) {
+			sb->attr |= SS_ARCHIVE_R;
+		}
+	}
+	if (S_ISREQ(dip->mode)) {
+		sb->attr |= SS_REMEDIA;
+	}
+	if (dip->rm.ui.flags & RM_CHAR_DEV_FILE) {
+		sb->attr |= SS_AIO;
+	}
+	if (dip->rm.ui.flags & RM_DATA_VERIFY) {
+		sb->attr |= SS_DATA_V;
+	}
+	if (SS_ISOBJECT_FS(dsp->sd_dir.attr)) {
+		sb->attr |= SS_OBJECT_FS;
+		sb->stripe_width = dip->status.b.stripe_width ?
+		    dip->rm.info.obj.stripe_width : dsp->sd_stripe;
+		if (dip->rm.info.obj.stripe_shift) {
+			sb->obj_depth =
+			    (1 << (dip->rm.info.obj.stripe_shift - 10));
+		}
+	} else {
+		sb->allocahead = dip->rm.info.dk.allocahead;
+		sb->stripe_width = dip->status.b.stripe_width ?
+		    dip->stripe : dsp->sd_stripe;
+	}
+	sb->old_attr = (uint_t)sb->attr;
+	sb->stripe_group = dip->stripe_group;
+	sb->attribute_time = dip->attribute_time;
+	sb->creation_time = dip->creation_time;
+	sb->residence_time = dip->residence_time;
+	sb->cs_algo = dip->cs_algo;
+	sb->flags |= dip->status.b.stage_failed ? SS_STAGEFAIL : 0;
+	sb->gen = dip->id.gen;
+	if (!S_ISREQ(dip->mode)) {
+		sb->partial_size = dip->psize.partial;
+	}
+	if (dip->status.b.segment) {
+		sb->stage_ahead = dip->stage_ahead;
+		sb->segment_size = dip->rm.info.dk.seg_size;
+	}
+	sb->st_blocks =
+	    (u_longlong_t)dip->blocks * (u_longlong_t)(SAM_BLK/DEV_BSIZE);
+	sb->admin_id = dip->admin_id;
+
+	/*
+	 * Archive copy info.
+	 */
+	sb->cs_val[0] = ((u_longlong_t)pip->csum.csum_val[0] << 32) |
+	    (u_longlong_t)pip->csum.csum_val[1];
+	sb->cs_val[1] = ((u_longlong_t)pip->csum.csum_val[2] << 32) |
+	    (u_longlong_t)pip->csum.csum_val[3];
+	for (copy = 0, mask = 1; copy < MAX_ARCHIVE; copy++, mask += mask) {
+		char *p;
+
+		sb->copy[copy].flags = dip->ar_flags[copy] & ~AR_required;
+		if (((dip->arch_status & mask) == 0) &&
+		    (pip->ar.image[copy].vsn[0] == 0)) {
+			continue;
+		}
+		sb->copy[copy].flags = dip->ar_flags[copy] & CF_AR_FLAGS_MASK;
+		if (dip->arch_status & mask) {
+			sb->copy[copy].flags |= CF_ARCHIVED;
+		}
+		if (pip->ar.image[copy].arch_flags & SAR_pax_hdr) {
+			sb->copy[copy].flags |= CF_PAX_ARCH_FMT;
+		}
+		sb->copy[copy].n_vsns = pip->ar.image[copy].n_vsns;
+		sb->copy[copy].creation_time =
+		    pip->ar.image[copy].creation_time;
+
+		p = sam_mediatoa(dip->media[copy]);
+		if (*p == '\0') {
+			p = "??";
+		}
+		sb->copy[copy].media[0] = *p++;
+		sb->copy[copy].media[1] = *p;
+
+		(void) strncpy(sb->copy[copy].vsn, pip->ar.image[copy].vsn,
+		    sizeof (sb->copy[copy].vsn));
+		sb->copy[copy].position =
+		    (uint32_t)pip->ar.image[copy].position;
+		sb->copy[copy].offset = pip->ar.image[copy].file_offset;
+		if ((pip->ar.image[copy].arch_flags & SAR_size_block) == 0) {
+			sb->copy[copy].offset >>= 9;
+		}
+	}
+
+	/*
+	 * Project id and WORM retention.
+	 */
+	if (dsp->sd_magic == SAM_MAGIC_V1 || dsp->sd_magic == SAM_MAGIC_V2 ||
+	    !(pip->di2.p2flags & P2FLAGS_PROJID_VALID)) {
+		sb->projid = SAM_NOPROJECT;
+	} else {
+		sb->projid = pip->di2.projid;
+	}
+	if (dip->status.b.worm_rdonly && dip->version >= SAM_INODE_VERS_2) {
+		if (pip->di2.p2flags & P2FLAGS_WORM_V2) {
+			sb->rperiod_start_time = pip->di2.rperiod_start_time;
+			sb->rperiod_duration = pip->di2.rperiod_duration;
+		} else {
+			sb->rperiod_start_time = dip->modify_time.tv_sec;
+			sb->rperiod_duration = dip->attribute_time;
+		}
+	}
+}
+
+#endif /* sun */
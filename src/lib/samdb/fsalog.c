@@ -8,6 +8,8 @@
  *	Contents:
  *	    sam_fsa_open_inv	- Open inventory to event log path.
  *	    sam_fsa_read_next_event	- Read next event entry from log file.
+ *	    sam_fsa_seek_time	- Position inventory at a time.
+ *	    sam_fsa_set_filter	- Read the events of one inode only.
  *	    sam_fsa_print_inv	- Print log file inventory (for debug).
  *	    sam_fsa_close_inv	- Closes the inventory.
  */
@@ -58,6 +60,7 @@ static char *_SrcFile = __FILE__; /* Using __FILE__ makes duplicate strings */
 #include <unistd.h>
 #include <sys/param.h>
 #include <sys/stat.h>
+#include <zlib.h>
 
 #include "sam/types.h"	/* SAM-FS includes. */
 #include "sam/param.h"
@@ -87,6 +90,33 @@ static int inv_open_log(sam_fsa_inv_t *, int ord);
 static int inv_open_next_log(sam_fsa_inv_t **);
 static int inv_close_log(sam_fsa_inv_t *, boolean_t);
 static boolean_t is_event_logfile(sam_fsa_inv_t *, char *);
+static int inv_read_event(sam_fsa_inv_t **, sam_event_t *);
+static int raw_seek_time(sam_fsa_inv_t *, sam_time_t);
+
+/*
+ * Reader of an indexed log, see fsalog.h.  Holds the headers of the
+ * blocks found so far and the events of the last block read.
+ */
+typedef struct sam_fsa_blkrd {
+	sam_fsa_idx_t	*idx;		/* Headers of the blocks found */
+	int		n_idx;		/* Number of blocks found */
+	int		a_idx;		/* Number of entries allocated */
+	off_t		end;		/* File offset after the last block */
+	boolean_t	sealed;		/* Index read from the trailer */
+	int		cur;		/* Block in events, -1 if none */
+	sam_event_t	*events;	/* Events of block cur */
+	char		*cbuf;		/* Compressed events of block cur */
+	uint32_t	cbuf_len;
+} sam_fsa_blkrd_t;
+
+static int blk_open(sam_fsa_inv_t *);
+static int blk_update(sam_fsa_inv_t *);
+static int blk_find(sam_fsa_blkrd_t *, uint64_t);
+static int blk_load(sam_fsa_inv_t *, int);
+static boolean_t blk_may_hold(sam_fsa_inv_t *, int, sam_ino_t);
+static ssize_t blk_read(sam_fsa_inv_t *, sam_event_t *);
+static int blk_seek_time(sam_fsa_inv_t *, sam_time_t);
+static void blk_close(sam_fsa_inv_t *);
 
 /*
  * sam_fsa_open_inv - opens inventory for event log path
@@ -196,6 +226,22 @@ int
 sam_fsa_read_event(
 	sam_fsa_inv_t **invp, /* Log file inventory table */
 	sam_event_t *event) /* SAM file system event buffer */
+{
+	int rst;
+
+	do {
+		rst = inv_read_event(invp, event);
+	} while (rst == 1 && (*invp)->filter_ino != 0 &&
+	    event->ev_id.ino != (*invp)->filter_ino);
+
+	return (rst);
+}
+
+/* Reads the next event, of any inode */
+static int
+inv_read_event(
+	sam_fsa_inv_t **invp, /* Log file inventory table */
+	sam_event_t *event) /* SAM file system event buffer */
 {
 	int err;
 	ssize_t rst; /* Read status (read(2)) */
@@ -211,7 +257,11 @@ sam_fsa_read_event(
 	}
 
 retry:
-	rst = read((*invp)->fd_log, event, sizeof (sam_event_t));
+	if ((*invp)->blk != NULL) {
+		rst = blk_read(*invp, event);
+	} else {
+		rst = read((*invp)->fd_log, event, sizeof (sam_event_t));
+	}
 
 	if (rst == 0) {
 		/* end of file, is there a next file? */
@@ -272,8 +322,9 @@ sam_fsa_rollback(sam_fsa_inv_t **invp) {
 		sam_fsa_log_t *entry = &inv->logs[inv->c_log];
 		if (entry->offset > 0) {
 			entry->offset -= sizeof (sam_event_t);
-			if (lseek(inv->fd_log, entry->offset,
-			    SEEK_SET) == (off_t)-1) {
+			/* an indexed log is read at the table offset */
+			if (inv->blk == NULL && lseek(inv->fd_log,
+			    entry->offset, SEEK_SET) == (off_t)-1) {
 				Trace(TR_ERR, "rollback failed: "
 				    "seek(%lld) failed",
 				    (int64_t)entry->offset);
@@ -286,6 +337,106 @@ sam_fsa_rollback(sam_fsa_inv_t **invp) {
 	return (0);
 }
 
+/*
+ * sam_fsa_seek_time - Positions the inventory at the first event logged
+ *    at or after time.  Logs older than the one holding time are marked
+ *    done, younger ones are read again from their start.
+ *
+ *    An indexed log is positioned from the time ranges of its blocks,
+ *    a raw log by reading its events up to time.
+ *
+ * precond -
+ * 	inv is valid allocated using sam_fsa_open_inv
+ *
+ * return -
+ * 	0 on success, -1 on error
+ */
+int
+sam_fsa_seek_time(
+	sam_fsa_inv_t **invp,	/* Log file inventory table */
+	sam_time_t time)	/* Time of the first event to read */
+{
+	sam_fsa_inv_t *inv;
+	sam_fsa_log_t *log;
+	int ord = -1;
+	int i;
+
+	if (invp == NULL || *invp == NULL) {
+		Trace(TR_ERR, "seek failed: null pointer");
+		return (-1);
+	}
+
+	if (inv_close_log(*invp, FALSE) < 0 || inv_update(invp) < 0) {
+		return (-1);
+	}
+	inv = *invp;
+
+	/* Youngest log started at or before time, else the oldest log */
+	for (i = 0; i < inv->n_logs; i++) {
+		log = &inv->logs[i];
+		if (log->status != fstat_missing && log->init_time <= time &&
+		    (ord < 0 || log->init_time > inv->logs[ord].init_time)) {
+			ord = i;
+		}
+	}
+	if (ord < 0) {
+		for (i = 0; i < inv->n_logs; i++) {
+			log = &inv->logs[i];
+			if (log->status != fstat_missing && (ord < 0 ||
+			    log->init_time < inv->logs[ord].init_time)) {
+				ord = i;
+			}
+		}
+	}
+	if (ord < 0) {
+		return (0);	/* No logs */
+	}
+
+	for (i = 0; i < inv->n_logs; i++) {
+		log = &inv->logs[i];
+		if (log->status == fstat_missing) {
+			continue;
+		}
+		if (log->init_time < inv->logs[ord].init_time) {
+			log->status = fstat_done;
+		} else {
+			log->status = fstat_none;
+			log->offset = 0;
+			log->last_time = 0;
+		}
+	}
+	inv->last_time = 0;
+
+	if (inv_open_log(inv, ord) < 0) {
+		return (-1);
+	}
+	if (inv->blk != NULL) {
+		if (blk_seek_time(inv, time) < 0) {
+			return (-1);
+		}
+	} else if (raw_seek_time(inv, time) < 0) {
+		return (-1);
+	}
+
+	return (inv_save(inv));
+}
+
+/*
+ * sam_fsa_set_filter - Makes sam_fsa_read_event return only the events
+ *    of inode ino, or all events if ino is 0.  The events of other inodes
+ *    are consumed.  Blocks of an indexed log which cannot hold ino are
+ *    skipped without being read.
+ */
+void
+sam_fsa_set_filter(
+	sam_fsa_inv_t *inv,	/* Log file inventory table */
+	sam_ino_t ino)		/* Inode of the events to read */
+{
+	if (inv != NULL) {
+		inv->filter_ino = ino;
+	}
+}
+
 /*
  * sam_fsa_print_inv - Print FSA log file inventory.
  *
@@ -623,7 +774,11 @@ inv_add_file(sam_fsa_inv_t **invp, char *name, int dir_fd)
 	sam_fsa_inv_t *inv;
 	int rst;
 	int new_fd;
-	sam_event_t event;
+	sam_time_t init_time;
+	union {
+		sam_event_t	ev;
+		sam_fsa_blk_t	blk;
+	} first;
 
 	new_fd = openat(dir_fd, name, O_RDONLY, 0);
 	if (new_fd == -1) {
@@ -634,26 +789,38 @@ inv_add_file(sam_fsa_inv_t **invp, char *name, int dir_fd)
 
 	inv = *invp;
 
-	/* Read first marker event */
-	rst = read(new_fd, &event, sizeof (sam_event_t));
+	/* Read first marker event, or the block holding it */
+	rst = read(new_fd, &first, sizeof (first));
 	if (rst < 0) {
 		Trace(TR_ERR, "read(%s) failed", name);
-	}
-	if (rst > 0 && rst != sizeof (sam_event_t)) {
-		Trace(TR_ERR, "read(%s) failed: incomplete read", name);
-	}
-	if (rst != sizeof (sam_event_t)) {
 		rst = -1;
 		goto out;
 	}
-	rst = 0;
-
-	if (event.ev_num != ev_none &&
-	    event.ev_param != FSA_STATUS_RUNNING) {
-		Trace(TR_ERR, "%s: incorrect marker event", name);
+	if (rst >= sizeof (sam_fsa_blk_t) &&
+	    first.blk.fb_magic == FSA_BLK_MAGIC) {
+		if (first.blk.fb_first != 0 || first.blk.fb_events == 0) {
+			Trace(TR_ERR, "%s: incorrect first block", name);
+			rst = -1;
+			goto out;
+		}
+		init_time = first.blk.fb_min_time;
+	} else if (rst >= sizeof (sam_event_t)) {
+		if (first.ev.ev_num != ev_none &&
+		    first.ev.ev_param != FSA_STATUS_RUNNING) {
+			Trace(TR_ERR, "%s: incorrect marker event", name);
+			rst = -1;
+			goto out;
+		}
+		init_time = first.ev.ev_time;
+	} else {
+		if (rst > 0) {
+			Trace(TR_ERR, "read(%s) failed: incomplete read",
+			    name);
+		}
 		rst = -1;
 		goto out;
 	}
+	rst = 0;
 
 	/* Realloc if table full */
 	if (inv->n_logs == inv->n_alloc) {
@@ -666,7 +833,7 @@ inv_add_file(sam_fsa_inv_t **invp, char *name, int dir_fd)
 	/* Add newly found file to the inventory. */
 	memset((char *)&inv->logs[inv->n_logs], 0, sizeof (sam_fsa_log_t));
 	strcpy(inv->logs[inv->n_logs].name, name);
-	inv->logs[inv->n_logs].init_time = event.ev_time;
+	inv->logs[inv->n_logs].init_time = init_time;
 	inv->logs[inv->n_logs].status = fstat_none;
 	inv->n_logs++;
 
@@ -811,7 +978,14 @@ inv_open_log(
 		}
 	}
 
-	if (inv->logs[ord].status == fstat_part) {
+	if (blk_open(inv) < 0) {
+		close(inv->fd_log);
+		inv->fd_log = -1;
+		return (-1);
+	}
+
+	/* An indexed log is read at the table offset */
+	if (inv->blk == NULL && inv->logs[ord].status == fstat_part) {
 		offset = lseek(inv->fd_log, inv->logs[ord].offset, SEEK_SET);
 		if (offset == (off_t)-1) {
 			Trace(TR_ERR, "seek failed", 0);
@@ -855,7 +1029,11 @@ inv_close_log(
 	}
 
 	/* Get current offset */
-	offset = lseek(inv->fd_log, (off_t)0, SEEK_CUR);
+	if (inv->blk != NULL) {
+		offset = inv->logs[inv->c_log].offset;
+	} else {
+		offset = lseek(inv->fd_log, (off_t)0, SEEK_CUR);
+	}
 	if (offset == (off_t)-1) {
 		Trace(TR_ERR, "seek failed", 0);
 		rst = -1;
@@ -876,6 +1054,7 @@ inv_close_log(
 	}
 
 out:
+	blk_close(inv);
 	if (inv->fd_log >= 0) {
 		close(inv->fd_log);
 	}
@@ -887,3 +1066,377 @@ out:
 
 	return (rst);
 }
+
+
+/*
+ * --	raw_seek_time - Positions the current raw log at the first event
+ *	logged at or after time.
+ */
+static int
+raw_seek_time(
+	sam_fsa_inv_t *inv,	/* Log file inventory table */
+	sam_time_t time)	/* Time of the first event to read */
+{
+	sam_event_t buf[256];
+	off_t offset = 0;
+	ssize_t rst;
+	int n;
+	int i;
+
+	for (;;) {
+		rst = read(inv->fd_log, buf, sizeof (buf));
+		if (rst < 0) {
+			Trace(TR_ERR, "read(%s) failed", inv->path_log);
+			return (-1);
+		}
+		n = rst / sizeof (sam_event_t);
+		for (i = 0; i < n && buf[i].ev_time < time; i++)
+			;
+		offset += i * sizeof (sam_event_t);
+		if (i < n || rst < sizeof (buf)) {
+			break;
+		}
+	}
+
+	if (lseek(inv->fd_log, offset, SEEK_SET) == (off_t)-1) {
+		Trace(TR_ERR, "seek failed", 0);
+		return (-1);
+	}
+	inv->logs[inv->c_log].offset = offset;
+	return (0);
+}
+
+/*
+ * --	blk_open - Sets up the reader of the current log if it is indexed.
+ *
+ *	Returns:
+ *		Zero if no error, else -1;
+ */
+static int
+blk_open(sam_fsa_inv_t *inv)
+{
+	sam_fsa_blkrd_t *rd;
+	sam_fsa_blk_t bh;
+
+	if (pread(inv->fd_log, &bh, sizeof (bh), 0) != sizeof (bh) ||
+	    bh.fb_magic != FSA_BLK_MAGIC) {
+		return (0);	/* Raw log */
+	}
+
+	SamMalloc(rd, sizeof (sam_fsa_blkrd_t));
+	memset(rd, 0, sizeof (sam_fsa_blkrd_t));
+	SamMalloc(rd->events, FSA_BLK_EVENTS * sizeof (sam_event_t));
+	rd->cur = -1;
+	inv->blk = rd;
+
+	if (blk_update(inv) < 0) {
+		blk_close(inv);
+		return (-1);
+	}
+	return (0);
+}
+
+/*
+ * --	blk_close - Frees the reader of an indexed log.
+ */
+static void
+blk_close(sam_fsa_inv_t *inv)
+{
+	sam_fsa_blkrd_t *rd = inv->blk;
+
+	if (rd != NULL) {
+		NOTNULL_FREE(rd->idx);
+		NOTNULL_FREE(rd->events);
+		NOTNULL_FREE(rd->cbuf);
+		SamFree(rd);
+		inv->blk = NULL;
+	}
+}
+
+/*
+ * --	blk_update - Adds the blocks written since the last call to the
+ *	block table of the current log.
+ *
+ *	A closed log is described by the index at its end.  The blocks of
+ *	a log still being written are found by walking their headers, a
+ *	block not yet completely written is left for the next call.
+ *
+ *	Returns:
+ *		Zero if no error, else -1;
+ */
+static int
+blk_update(sam_fsa_inv_t *inv)
+{
+	sam_fsa_blkrd_t *rd = inv->blk;
+	sam_fsa_trailer_t ft;
+	sam_fsa_blk_t bh;
+	struct stat sb;
+	uint64_t n_ev;
+	size_t len;
+	off_t next;
+	int i;
+
+	if (rd->sealed) {
+		return (0);
+	}
+	if (fstat(inv->fd_log, &sb) == -1) {
+		Trace(TR_ERR, "stat(%s) failed", inv->path_log);
+		return (-1);
+	}
+
+	if (rd->n_idx == 0 && sb.st_size >= sizeof (ft) &&
+	    pread(inv->fd_log, &ft, sizeof (ft),
+	    sb.st_size - sizeof (ft)) == sizeof (ft) &&
+	    ft.ft_magic == FSA_IDX_MAGIC && ft.ft_index +
+	    (off_t)ft.ft_blocks * sizeof (sam_fsa_idx_t) + sizeof (ft) ==
+	    sb.st_size) {
+		len = ft.ft_blocks * sizeof (sam_fsa_idx_t);
+		SamMalloc(rd->idx, len + 1);
+		rd->a_idx = ft.ft_blocks;
+		if (pread(inv->fd_log, rd->idx, len, ft.ft_index) == len) {
+			n_ev = 0;
+			for (i = 0; i < ft.ft_blocks; i++) {
+				if (rd->idx[i].fi_blk.fb_magic !=
+				    FSA_BLK_MAGIC ||
+				    rd->idx[i].fi_blk.fb_first != n_ev) {
+					break;
+				}
+				n_ev += rd->idx[i].fi_blk.fb_events;
+			}
+			if (i == ft.ft_blocks) {
+				rd->n_idx = ft.ft_blocks;
+				rd->end = ft.ft_index;
+				rd->sealed = TRUE;
+				return (0);
+			}
+		}
+		Trace(TR_ERR, "%s: invalid index, reading block headers",
+		    inv->path_log);
+	}
+
+	n_ev = 0;
+	if (rd->n_idx > 0) {
+		n_ev = rd->idx[rd->n_idx - 1].fi_blk.fb_first +
+		    rd->idx[rd->n_idx - 1].fi_blk.fb_events;
+	}
+	while (rd->end + sizeof (bh) <= sb.st_size) {
+		if (pread(inv->fd_log, &bh, sizeof (bh), rd->end) !=
+		    sizeof (bh)) {
+			Trace(TR_ERR, "read(%s) failed", inv->path_log);
+			return (-1);
+		}
+		if (bh.fb_magic != FSA_BLK_MAGIC) {
+			break;		/* Index of a closed log */
+		}
+		next = rd->end + sizeof (bh) + bh.fb_bloom_len + bh.fb_clen;
+		if (next > sb.st_size) {
+			break;		/* Block being written */
+		}
+		if (bh.fb_version != FSA_BLK_VERSION || bh.fb_first != n_ev ||
+		    bh.fb_events > FSA_BLK_EVENTS) {
+			Trace(TR_ERR, "%s: invalid block at offset %lld",
+			    inv->path_log, (long long)rd->end);
+			break;
+		}
+		if (rd->n_idx == rd->a_idx) {
+			rd->a_idx = (rd->a_idx == 0) ? 64 : 2 * rd->a_idx;
+			SamRealloc(rd->idx, rd->a_idx * sizeof (sam_fsa_idx_t));
+		}
+		rd->idx[rd->n_idx].fi_blk = bh;
+		rd->idx[rd->n_idx].fi_offset = rd->end;
+		rd->n_idx++;
+		n_ev += bh.fb_events;
+		rd->end = next;
+	}
+	return (0);
+}
+
+/*
+ * --	blk_find - Returns the block holding event number ev, -1 if the
+ *	event is not in the block table.
+ */
+static int
+blk_find(sam_fsa_blkrd_t *rd, uint64_t ev)
+{
+	sam_fsa_blk_t *bh;
+	int lo = 0;
+	int hi = rd->n_idx - 1;
+	int mid;
+
+	if (rd->cur >= 0) {
+		bh = &rd->idx[rd->cur].fi_blk;
+		if (ev >= bh->fb_first && ev < bh->fb_first + bh->fb_events) {
+			return (rd->cur);
+		}
+	}
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		bh = &rd->idx[mid].fi_blk;
+		if (ev < bh->fb_first) {
+			hi = mid - 1;
+		} else if (ev >= bh->fb_first + bh->fb_events) {
+			lo = mid + 1;
+		} else {
+			return (mid);
+		}
+	}
+	return (-1);
+}
+
+/*
+ * --	blk_load - Reads and uncompresses the events of block b.
+ *
+ *	Returns:
+ *		Zero if no error, else -1;
+ */
+static int
+blk_load(sam_fsa_inv_t *inv, int b)
+{
+	sam_fsa_blkrd_t *rd = inv->blk;
+	sam_fsa_idx_t *ix = &rd->idx[b];
+	uLongf len;
+
+	if (rd->cur == b) {
+		return (0);
+	}
+	rd->cur = -1;
+
+	if (ix->fi_blk.fb_clen > rd->cbuf_len) {
+		rd->cbuf_len = ix->fi_blk.fb_clen;
+		SamRealloc(rd->cbuf, rd->cbuf_len);
+	}
+	if (pread(inv->fd_log, rd->cbuf, ix->fi_blk.fb_clen, ix->fi_offset +
+	    sizeof (sam_fsa_blk_t) + ix->fi_blk.fb_bloom_len) !=
+	    ix->fi_blk.fb_clen) {
+		Trace(TR_ERR, "read(%s) failed", inv->path_log);
+		return (-1);
+	}
+
+	len = FSA_BLK_EVENTS * sizeof (sam_event_t);
+	if (uncompress((Bytef *)rd->events, &len, (Bytef *)rd->cbuf,
+	    ix->fi_blk.fb_clen) != Z_OK ||
+	    len != ix->fi_blk.fb_events * sizeof (sam_event_t)) {
+		Trace(TR_ERR, "%s: corrupt block at offset %lld",
+		    inv->path_log, (long long)ix->fi_offset);
+		return (-1);
+	}
+
+	rd->cur = b;
+	return (0);
+}
+
+/*
+ * --	blk_may_hold - Returns FALSE if block b holds no event of inode
+ *	ino, from its inode range and bloom filter.
+ */
+static boolean_t
+blk_may_hold(sam_fsa_inv_t *inv, int b, sam_ino_t ino)
+{
+	sam_fsa_idx_t *ix = &inv->blk->idx[b];
+	uchar_t bloom[FSA_BLOOM_MAX];
+	uint32_t nbits;
+	uint32_t bit;
+	int len = ix->fi_blk.fb_bloom_len;
+	int i;
+
+	if (ino < ix->fi_blk.fb_min_ino || ino > ix->fi_blk.fb_max_ino) {
+		return (FALSE);
+	}
+	if (len == 0 || len > FSA_BLOOM_MAX || (len & (len - 1)) != 0 ||
+	    pread(inv->fd_log, bloom, len, ix->fi_offset +
+	    sizeof (sam_fsa_blk_t)) != len) {
+		return (TRUE);
+	}
+
+	nbits = len * NBBY;
+	for (i = 0; i < FSA_BLOOM_HASHES; i++) {
+		bit = FSA_BLOOM_BIT(ino, i, nbits);
+		if ((bloom[bit / NBBY] & (1 << (bit % NBBY))) == 0) {
+			return (FALSE);
+		}
+	}
+	return (TRUE);
+}
+
+/*
+ * --	blk_read - Reads the event at the table offset of the current
+ *	indexed log.  With an inode filter set, blocks which cannot hold
+ *	the inode are skipped.
+ *
+ *	Returns:
+ *		Size of the event, 0 if none available, -1 if error.
+ */
+static ssize_t
+blk_read(sam_fsa_inv_t *inv, sam_event_t *event)
+{
+	sam_fsa_blkrd_t *rd = inv->blk;
+	sam_fsa_log_t *log = &inv->logs[inv->c_log];
+	sam_fsa_blk_t *bh;
+	uint64_t ev;
+	int b;
+
+	for (;;) {
+		ev = log->offset / sizeof (sam_event_t);
+		if ((b = blk_find(rd, ev)) < 0) {
+			if (blk_update(inv) < 0) {
+				return (-1);
+			}
+			if ((b = blk_find(rd, ev)) < 0) {
+				return (0);
+			}
+		}
+		bh = &rd->idx[b].fi_blk;
+		if (inv->filter_ino == 0 || b == rd->cur ||
+		    blk_may_hold(inv, b, inv->filter_ino)) {
+			break;
+		}
+		log->offset = (bh->fb_first + bh->fb_events) *
+		    sizeof (sam_event_t);
+	}
+
+	if (blk_load(inv, b) < 0) {
+		return (-1);
+	}
+	*event = rd->events[ev - bh->fb_first];
+	return (sizeof (sam_event_t));
+}
+
+/*
+ * --	blk_seek_time - Positions the current indexed log at the first
+ *	event logged at or after time.
+ */
+static int
+blk_seek_time(
+	sam_fsa_inv_t *inv,	/* Log file inventory table */
+	sam_time_t time)	/* Time of the first event to read */
+{
+	sam_fsa_blkrd_t *rd = inv->blk;
+	sam_fsa_log_t *log = &inv->logs[inv->c_log];
+	sam_fsa_blk_t *bh;
+	int b;
+	int i;
+
+	for (b = 0; b < rd->n_idx; b++) {
+		if (rd->idx[b].fi_blk.fb_max_time >= time) {
+			break;
+		}
+	}
+	if (b == rd->n_idx) {
+		log->offset = 0;
+		if (rd->n_idx > 0) {
+			bh = &rd->idx[rd->n_idx - 1].fi_blk;
+			log->offset = (bh->fb_first + bh->fb_events) *
+			    sizeof (sam_event_t);
+		}
+		return (0);
+	}
+
+	if (blk_load(inv, b) < 0) {
+		return (-1);
+	}
+	bh = &rd->idx[b].fi_blk;
+	for (i = 0; i < bh->fb_events && rd->events[i].ev_time < time; i++)
+		;
+	log->offset = (bh->fb_first + i) * sizeof (sam_event_t);
+	return (0);
+}
@@ -1374,6 +1374,7 @@ ar_global_directive_t *g)	/* globals to write */
 
 	node_t *node;
 	buffer_directive_t *buf;
+	fsize_t size;
 	drive_directive_t *drv;
 
 	char *global_dir_head = "\n#\n#\tGlobal Directives\n#\n#";
@@ -1480,42 +1481,31 @@ ar_global_directive_t *g)	/* globals to write */
 			already_done = cond_print(f, global_dir_head,
 			    already_done);
 
-			if (buf->change_flag & BD_lock && buf->lock) {
-				if (buf->size != fsize_reset &&
-				    buf->change_flag & BD_size) {
-					/*
-					 * if lock is set and size is set
-					 * print them.
-					 */
-					fprintf(f, "\nbufsize = %s %llu lock",
-					    buf->media_type, buf->size);
-
-				} else {
-					/*
-					 * if lock is set and size is not
-					 * print the default size with lock
-					 */
-					fprintf(f, "\nbufsize = %s %d lock",
-					    buf->media_type,
-					    DEFAULT_AR_BUFSIZE);
-				}
-
-			} else if (buf->size != fsize_reset &&
-			    buf->change_flag & BD_size) {
-
-
+			if (buf->change_flag & BD_size &&
+			    buf->size != fsize_reset) {
+				size = buf->size;
+			} else if (buf->change_flag & BD_lock && buf->lock) {
+				/*
+				 * if lock is set and size is not
+				 * print the default size with lock
+				 */
+				size = DEFAULT_AR_BUFSIZE;
+			} else {
 				/*
-				 * if lock is not set and size is set
-				 * print the size
+				 * if lock is not set and size
+				 * is not set print nothing
 				 */
-				fprintf(f, "\nbufsize = %s %llu",
-				    buf->media_type, buf->size);
+				continue;
+			}
 
+			fprintf(f, "\nbufsize = %s %llu", buf->media_type, size);
+			if (buf->change_flag & BD_max &&
+			    buf->max_size >= size) {
+				fprintf(f, " %llu", buf->max_size);
+			}
+			if (buf->change_flag & BD_lock && buf->lock) {
+				fprintf(f, " lock");
 			}
-			/*
-			 * if lock is not set and size
-			 * is not set print nothing
-			 */
 
 		}
 	}
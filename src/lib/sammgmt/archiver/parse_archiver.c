@@ -1258,7 +1258,7 @@ dirArchmeta(void)
 
 
 /*
- * bufsize = buffer size value.
+ * bufsize = buffer size value [maximum] [lock].
  */
 static void
 dirBufsize(void)
@@ -1308,14 +1308,31 @@ dirBufsize(void)
 	buf->size = (fsize_t)val;
 	buf->change_flag |= BD_size;
 
-	if (ReadCfgGetToken() != 0) {
+	if (ReadCfgGetToken() != 0 && isdigit(*(unsigned char *)token)) {
+		/*
+		 * Maximum bufsize, sam-arcopy adjusts the buffer between
+		 * the two.
+		 */
+		errno = 0;
+		val = strtoull(token, &p, 0);
+		if (errno != 0 || *p != '\0') {
+			free(buf);
+			/* Invalid '%s' value '%s' */
+			ReadCfgError(CustMsg(14101), dirName, token);
+		}
+		checkRange(dirName, val, (int64_t)buf->size, 1024);
+		buf->max_size = (fsize_t)val;
+		buf->change_flag |= BD_max;
+		(void) ReadCfgGetToken();
+	}
+	if (*token != '\0') {
 		if (strcmp(token, "lock") == 0) {
 			buf->lock = B_TRUE;
 			buf->change_flag |= BD_lock;
 		} else {
 			free(buf);
 
-			/* bufsize option must be 'lock' */
+			/* bufsize option must be a maximum bufsize or 'lock' */
 			ReadCfgError(CustMsg(4521));
 		}
 	}
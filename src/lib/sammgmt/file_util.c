@@ -227,7 +227,7 @@ list_dir(
 		return (samrerr(SE_NOSUCHPATH, filepath));
 	}
 
-	*direntries = lst_create(); /* Return results in this list */
+	*direntries = lst_create_result(); /* Return results in this list */
 	if (*direntries == NULL) {
 		closedir(curdir);
 		return (-1);	/* If allocation failed, samerr is set */
@@ -263,7 +263,8 @@ list_dir(
 		if (check_restrict_stat(entry->d_name, &sout, &filter))
 			continue; /* Not this entry */
 
-		data = copystr(entry->d_name); /* Copy data to allocated mem */
+		/* Copy data to allocated mem */
+		data = lst_strdup(*direntries, entry->d_name);
 		if (data == NULL) {
 			rval = -1;
 			break;	/* samerr already set */
@@ -647,7 +648,7 @@ list_directory(
 		return (samrerr(SE_NOSUCHPATH, listDir));
 	}
 
-	*direntries = lst_create(); /* Return results in this list */
+	*direntries = lst_create_result(); /* Return results in this list */
 	if (*direntries == NULL) {
 		closedir(curdir);
 		return (-1);	/* If allocation failed, samerr is set */
@@ -700,7 +701,7 @@ list_directory(
 		}
 
 		/* copy to allocated struct */
-		data = copystr(fname);
+		data = lst_strdup(lstp, fname);
 		if (data == NULL) {
 			rval = -1;
 			break;	/* samerr already set */
@@ -714,7 +715,7 @@ list_directory(
 		if (maxentries <= 0) {
 			rval = lst_append(lstp, data);
 			if (rval != 0) {
-				free(data);
+				lst_strfree(lstp, data);
 				break;
 			}
 			continue;
@@ -737,7 +738,7 @@ list_directory(
 			}
 
 			if ((rval != 0) || (st == 0)) {
-				free(data);
+				lst_strfree(lstp, data);
 				data = NULL;
 			}
 			break;
@@ -748,12 +749,12 @@ list_directory(
 			if (lstp->length < maxentries) {
 				rval = lst_append(lstp, data);
 				if (rval != 0) {
-					free(data);
+					lst_strfree(lstp, data);
 					break;
 				}
 			} else {
 				/* no room for this entry */
-				free(data);
+				lst_strfree(lstp, data);
 				(*morefiles)++;
 			}
 		}
@@ -761,7 +762,9 @@ list_directory(
 		/* Keep list to designated limits */
 		if (lstp->length > maxentries) {
 			/* pop off the last entry */
+			data = lstp->tail->data;
 			lst_remove(lstp, lstp->tail);
+			lst_strfree(lstp, data);
 			(*morefiles)++;
 		}
 	}
@@ -31,12 +31,171 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 #include "pub/mgmt/sqm_list.h"
 #include "pub/mgmt/error.h"
 #include "mgmt/util.h"
 
+/*
+ * List arenas
+ *
+ * Large result lists are made of one node and one small string per
+ * entry, building them costs two malloc calls per entry and freeing
+ * them two free calls per entry. A list created in an arena takes its
+ * nodes, and the strings copied in by lst_strdup, from a few large
+ * blocks instead. They are never freed one by one, the lst_free
+ * functions release only the list header and the blocks are released
+ * all at once by lst_arena_reset or lst_arena_destroy.
+ *
+ * Arenas are not MT safe, an arena is used by one thread at a time.
+ */
+
+#define	ARENA_ALIGN	8
+#define	ARENA_ROUND(x)	(((x) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+#define	ARENA_MINBLK	(8 * 1024)	/* size of the first block */
+#define	ARENA_MAXBLK	(1024 * 1024)	/* block sizes double up to this */
+
+typedef struct arena_blk {
+	struct arena_blk *next;	/* older block */
+	size_t	size;		/* usable bytes in this block */
+	size_t	off;		/* bytes allocated in this block */
+} arena_blk_t;
+
+#define	ARENA_HDR	ARENA_ROUND(sizeof (arena_blk_t))
+
+struct lst_arena {
+	arena_blk_t *blk;	/* block being allocated from */
+	size_t	blksize;	/* size of the next block */
+};
+
+/*
+ * arena of the lists created by lst_create_result, set per thread so
+ * that threads other than the one serving the request use malloc
+ */
+static pthread_key_t result_arena_key;
+static pthread_once_t result_arena_once = PTHREAD_ONCE_INIT;
+
+static void
+result_arena_init(void)
+{
+	(void) pthread_key_create(&result_arena_key, NULL);
+}
+
+
+lst_arena_t *
+lst_arena_create(void)
+{
+
+	lst_arena_t *arena = (lst_arena_t *)mallocer(sizeof (lst_arena_t));
+
+	if (arena != NULL) {
+		arena->blk = NULL;
+		arena->blksize = ARENA_MINBLK;
+	}
+	return (arena);
+}
+
+
+void *
+lst_arena_alloc(
+lst_arena_t *arena,	/* allocate from this arena */
+size_t size)		/* bytes wanted */
+{
+
+	arena_blk_t *blk;
+	void *ptr;
+
+	size = ARENA_ROUND(size);
+	blk = arena->blk;
+	if (blk == NULL || blk->off + size > blk->size) {
+		size_t bsize = arena->blksize;
+
+		if (bsize < size) {
+			bsize = size;
+		}
+		blk = (arena_blk_t *)mallocer(ARENA_HDR + bsize);
+		if (blk == NULL) {
+			return (NULL);
+		}
+		blk->size = bsize;
+		blk->off = 0;
+		blk->next = arena->blk;
+		arena->blk = blk;
+		if (arena->blksize < ARENA_MAXBLK) {
+			arena->blksize *= 2;
+		}
+	}
+	ptr = (char *)blk + ARENA_HDR + blk->off;
+	blk->off += size;
+	return (ptr);
+}
+
+
+/*
+ * release everything allocated from the arena. The last block is
+ * kept for the next use of the arena.
+ */
+void
+lst_arena_reset(
+lst_arena_t *arena)
+{
+
+	arena_blk_t *blk, *next;
+
+	if (arena == NULL || arena->blk == NULL)
+		return;
+	blk = arena->blk->next;
+	while (blk != NULL) {
+		next = blk->next;
+		free(blk);
+		blk = next;
+	}
+	arena->blk->next = NULL;
+	arena->blk->off = 0;
+}
+
+
+void
+lst_arena_destroy(
+lst_arena_t *arena)
+{
+
+	arena_blk_t *blk, *next;
+
+	if (arena == NULL)
+		return;
+	blk = arena->blk;
+	while (blk != NULL) {
+		next = blk->next;
+		free(blk);
+		blk = next;
+	}
+	free(arena);
+}
+
+
+/*
+ * set the arena of the lists created by lst_create_result in the
+ * calling thread, NULL to create them with malloc. Returns the
+ * previous arena.
+ */
+lst_arena_t *
+lst_set_result_arena(
+lst_arena_t *arena)
+{
+
+	lst_arena_t *prev;
+
+	(void) pthread_once(&result_arena_once, result_arena_init);
+	prev = (lst_arena_t *)pthread_getspecific(result_arena_key);
+	(void) pthread_setspecific(result_arena_key, arena);
+	return (prev);
+}
+
+
 sqm_lst_t *
-lst_create(void)
+lst_create_arena(
+lst_arena_t *arena)	/* NULL for a list allocated with malloc */
 {
 
 	sqm_lst_t *lstp = (sqm_lst_t *)mallocer(sizeof (sqm_lst_t));
@@ -44,11 +203,90 @@ lst_create(void)
 	if (NULL != lstp) {
 		lstp->length = 0;
 		lstp->head = lstp->tail = NULL;
+		lstp->arena = arena;
 	}
 	return (lstp);
 }
 
 
+sqm_lst_t *
+lst_create(void)
+{
+
+	return (lst_create_arena(NULL));
+}
+
+
+sqm_lst_t *
+lst_create_result(void)
+{
+
+	(void) pthread_once(&result_arena_once, result_arena_init);
+	return (lst_create_arena(
+	    (lst_arena_t *)pthread_getspecific(result_arena_key)));
+}
+
+
+/*
+ * copy a string to be stored in lst
+ */
+char *
+lst_strdup(
+sqm_lst_t *lst,		/* the string will be stored in this list */
+const char *str)	/* string to copy */
+{
+
+	char *cp;
+	size_t len;
+
+	if (ISNULL(lst, str)) {
+		return (NULL);
+	}
+	if (lst->arena == NULL) {
+		return (copystr((char *)str));
+	}
+	len = strlen(str) + 1;
+	if ((cp = lst_arena_alloc(lst->arena, len)) == NULL) {
+		setsamerr(SE_NO_MEM);
+		return (NULL);
+	}
+	(void) memcpy(cp, str, len);
+	return (cp);
+}
+
+
+/*
+ * free a string returned by lst_strdup that was not stored in lst
+ */
+void
+lst_strfree(
+sqm_lst_t *lst,
+char *str)
+{
+
+	if (lst != NULL && lst->arena == NULL) {
+		free(str);
+	}
+}
+
+
+static node_t *
+node_alloc(
+sqm_lst_t *lst)
+{
+
+	node_t *node;
+
+	if (lst->arena == NULL) {
+		return ((node_t *)mallocer(sizeof (node_t)));
+	}
+	if ((node = lst_arena_alloc(lst->arena, sizeof (node_t))) == NULL) {
+		setsamerr(SE_NO_MEM);
+	}
+	return (node);
+}
+
+
 /*
  * Insert data into the list before the specified node. If the list is
  * empty and the node is NULL, data will simply be inserted into the
@@ -78,7 +316,7 @@ void *data)		/* data stored in the new node */
 	if (ISNULL(node)) {
 		return (-1);
 	}
-	if (NULL == (new_node = (node_t *)mallocer(sizeof (node_t))))
+	if (NULL == (new_node = node_alloc(lst)))
 		return (-1);
 	new_node->data = data;
 
@@ -135,7 +373,7 @@ void *data)		/* data stored in the new node */
 		return (-1);
 	}
 
-	if (NULL == (new_node = (node_t *)mallocer(sizeof (node_t))))
+	if (NULL == (new_node = node_alloc(lst)))
 		return (-1);
 	new_node->data = data;
 	new_node->next = NULL;
@@ -165,7 +403,7 @@ void *data)	/* data stored in the new node */
 
 	if (ISNULL(lst, data))
 		return (-1);
-	if (NULL == (new_node = (node_t *)mallocer(sizeof (node_t))))
+	if (NULL == (new_node = node_alloc(lst)))
 		return (-1);
 	new_node->data = (void *)data;
 	new_node->next = NULL;
@@ -214,7 +452,8 @@ node_t *rm_node)	/* pointer to the node to be removed */
 			lst->tail = crt;
 	}
 	lst->length--;
-	free(rm_node);
+	if (lst->arena == NULL)
+		free(rm_node);
 	return (0);
 }
 
@@ -252,7 +491,7 @@ sqm_lst_t *lst)	/* free this list (but not the data) */
 
 	if (lst == NULL)
 		return;
-	node = lst->head;
+	node = (lst->arena == NULL) ? lst->head : NULL;
 	while (node != NULL) {
 		rmnode = node;
 		node = node->next;
@@ -271,7 +510,7 @@ sqm_lst_t *lst)	/* free this list and its data */
 
 	if (lst == NULL)
 		return;
-	node = lst->head;
+	node = (lst->arena == NULL) ? lst->head : NULL;
 	while (node != NULL) {
 		if (node->data != NULL) {
 			free(node->data);
@@ -559,7 +798,7 @@ void (*free_type)(void *))	/* function to free the data members */
 
 	if (lst == NULL)
 		return;
-	node = lst->head;
+	node = (lst->arena == NULL) ? lst->head : NULL;
 	while (node != NULL) {
 		if (node->data != NULL) {
 			free_type(node->data);
@@ -632,9 +871,11 @@ int count) {
 
 		if (i < start) {
 			tmp = n;
-			free(n->data);
 			n = n->next;
-			free(tmp);
+			if (l->arena == NULL) {
+				free(tmp->data);
+				free(tmp);
+			}
 			continue;
 		} else if (i == start) {
 			l->head = n;
@@ -663,10 +904,12 @@ int count) {
 			 * free the unneeded elements and the nodes
 			 * that extend past the requested portion of the list
 			 */
-			free(n->data);
 			tmp = n;
 			n = n->next;
-			free(tmp);
+			if (l->arena == NULL) {
+				free(tmp->data);
+				free(tmp);
+			}
 			continue;
 		} else {
 			length++;
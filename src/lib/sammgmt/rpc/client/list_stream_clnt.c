@@ -0,0 +1,413 @@
+/*
+ *    SAM-QFS_notice_begin
+ *
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at pkg/OPENSOLARIS.LICENSE
+ * or https://illumos.org/license/CDDL.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at pkg/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+/*
+ * Copyright 2009 Sun Microsystems, Inc.  All rights reserved.
+ * Use is subject to license terms.
+ *
+ *    SAM-QFS_notice_end
+ */
+
+#pragma ident	"$Revision: 1.1 $"
+
+#include "mgmt/sammgmt.h"
+#include "mgmt/util.h"
+#include "pub/mgmt/sammgmt_rpc.h"
+
+/*
+ * list_stream_clnt.c
+ *
+ * RPC client side of streamed lists, see list_stream_svr.c
+ *
+ * The call that opens a stream returns the first chunk, the chunk is
+ * held in the list_stream_t until list_stream_next is called. Chunks
+ * after the first are pulled from the server one call at a time.
+ */
+
+/* first API version serving streamed lists */
+#define	LIST_STREAM_VERSION	"1.6.4"
+
+struct list_stream {
+	ctx_t		*ctx;
+	int		stream;		/* server stream, 0 if none */
+	int		total;		/* entries in the whole list */
+	int		max_entries;	/* 0 for the server default */
+	uint32_t	max_bytes;	/* 0 for the server default */
+	result_struct_t	first;		/* first chunk, not yet returned */
+};
+
+
+/*
+ * open_stream
+ *
+ * make a streamed call of the list returning procedure proc.
+ */
+static int
+open_stream(
+ctx_t *ctx,			/* client connection */
+char *func_name,		/* name of the streamed call */
+rpcproc_t proc,			/* list returning procedure */
+xdrproc_t xdr_arg,		/* xdr function of the argument */
+caddr_t arg,			/* argument of the procedure */
+list_stream_t **ls		/* return - stream of the list */
+)
+{
+
+	int ret_val;
+	samrpc_result_t result;
+	result_struct_t *res;
+	list_chunk_t *chunk;
+	sqm_lst_t *lst;
+	char *version;
+	char *err_msg;
+	enum clnt_stat stat;
+	struct timeval tm;
+
+	PTRACE(3, "%s calling RPC...", func_name);
+
+	/* older servers do not know the stream flag */
+	version = get_server_version_from_ctx(ctx);
+	if (version != NULL && strcmp(version, LIST_STREAM_VERSION) >= 0) {
+		proc = SAMRPC_STREAMED(proc);
+	}
+	free(version);
+
+	memset((char *)&result, 0, sizeof (result));
+
+	GET_TIMEOUT(ctx->handle->clnt, tm);
+	if ((stat = clnt_call(ctx->handle->clnt, proc, xdr_arg, arg,
+	    (xdrproc_t)xdr_samrpc_result_t, (caddr_t)&result, tm))
+	    != RPC_SUCCESS) {
+		SET_RPC_ERROR(ctx, func_name, stat);
+	}
+
+	CHECK_FUNCTION_FAILURE(result, func_name);
+
+	ret_val = result.status;
+	res = &result.samrpc_result_u.result;
+
+	*ls = (list_stream_t *)mallocer(sizeof (list_stream_t));
+	if (*ls == NULL) {
+		xdr_free(xdr_samrpc_result_t, (char *)&result);
+		PTRACE(2, "%s exit %s", func_name, samerrmsg);
+		return (-1);
+	}
+	(void) memset(*ls, 0, sizeof (list_stream_t));
+	(*ls)->ctx = ctx;
+
+	if (res->result_type == SAM_LIST_CHUNK) {
+		chunk = (list_chunk_t *)res->result_data;
+		(*ls)->stream = chunk->stream;
+		(*ls)->total = chunk->total;
+		(*ls)->first = chunk->list;
+		free(chunk);
+	} else {
+		/* the whole list */
+		(*ls)->first = *res;
+		lst = (sqm_lst_t *)res->result_data;
+		(*ls)->total = (lst != NULL) ? lst->length : 0;
+	}
+
+	/*
+	 * xdr does not preserve the tail of the list
+	 * set the tail
+	 */
+	lst = (sqm_lst_t *)(*ls)->first.result_data;
+	SET_LIST_TAIL(lst);
+
+	PTRACE(2, "%s returning with status [%d]...", func_name, ret_val);
+	PTRACE(2, "%s exit", func_name);
+	return (ret_val);
+}
+
+
+/*
+ * list_stream_next
+ *
+ * get the next chunk of a streamed list, NULL if the whole list has
+ * been returned.
+ */
+int
+list_stream_next(
+list_stream_t *ls,		/* stream of the list */
+sqm_lst_t **chunk_list		/* return - entries of the next chunk */
+)
+{
+
+	int ret_val;
+	list_stream_arg_t arg;
+	samrpc_result_t result;
+	ctx_t *ctx;
+	list_chunk_t *chunk;
+	char *func_name = "rpc:list stream next";
+	char *err_msg;
+	enum clnt_stat stat;
+
+	PTRACE(2, "%s entry", func_name);
+
+	if (ISNULL(ls, chunk_list)) {
+		PTRACE(2, "%s exit %s", func_name, samerrmsg);
+		return (-1);
+	}
+
+	ctx = ls->ctx;
+	if (ls->first.result_data != NULL || ls->stream == 0) {
+		*chunk_list = (sqm_lst_t *)ls->first.result_data;
+		ls->first.result_data = NULL;
+		PTRACE(2, "%s exit", func_name);
+		return (0);
+	}
+
+	CHECK_CLIENT_HANDLE(ctx, func_name);
+
+	PTRACE(3, "%s calling RPC...", func_name);
+
+	memset((char *)&result, 0, sizeof (result));
+	arg.ctx = ctx;
+	arg.stream = ls->stream;
+	arg.max_entries = ls->max_entries;
+	arg.max_bytes = ls->max_bytes;
+
+	SAMRPC_CLNT_CALL(samrpc_list_stream_next, list_stream_arg_t);
+
+	CHECK_FUNCTION_FAILURE(result, func_name);
+
+	ret_val = result.status;
+	chunk = (list_chunk_t *)result.samrpc_result_u.result.result_data;
+	if (chunk == NULL) {
+		*chunk_list = NULL;
+		ls->stream = 0;
+	} else {
+		*chunk_list = (sqm_lst_t *)chunk->list.result_data;
+		ls->stream = chunk->stream;
+		free(chunk);
+	}
+
+	/*
+	 * xdr does not preserve the tail of the list
+	 * set the tail
+	 */
+	SET_LIST_TAIL((*chunk_list));
+
+	PTRACE(2, "%s returning with status [%d]...", func_name, ret_val);
+	PTRACE(2, "%s exit", func_name);
+	return (ret_val);
+}
+
+
+/*
+ * list_stream_total
+ *
+ * number of entries in the whole list.
+ */
+int
+list_stream_total(
+list_stream_t *ls)		/* stream of the list */
+{
+
+	return ((ls != NULL) ? ls->total : -1);
+}
+
+
+/*
+ * list_stream_set_limits
+ *
+ * set the entries and encoded bytes of the chunks after the first.
+ */
+void
+list_stream_set_limits(
+list_stream_t *ls,		/* stream of the list */
+int max_entries,		/* entries per chunk, 0 for default */
+uint32_t max_bytes		/* bytes per chunk, 0 for default */
+)
+{
+
+	if (ls != NULL) {
+		ls->max_entries = max_entries;
+		ls->max_bytes = max_bytes;
+	}
+}
+
+
+/*
+ * list_stream_close
+ *
+ * free a stream, releasing the rest of the list on the server if it
+ * has not been read to the end.
+ */
+int
+list_stream_close(
+list_stream_t *ls)		/* stream of the list */
+{
+
+	int ret_val = 0;
+	list_stream_arg_t arg;
+	samrpc_result_t result;
+	ctx_t *ctx;
+	char *func_name = "rpc:list stream close";
+	char *err_msg;
+	enum clnt_stat stat;
+
+	PTRACE(2, "%s entry", func_name);
+
+	if (ls == NULL) {
+		return (0);
+	}
+
+	/* the first chunk if it was not read */
+	xdr_free(xdr_result_struct_t, (char *)&ls->first);
+
+	ctx = ls->ctx;
+	arg.stream = ls->stream;
+	free(ls);
+
+	if (arg.stream != 0) {
+		CHECK_CLIENT_HANDLE(ctx, func_name);
+
+		PTRACE(3, "%s calling RPC...", func_name);
+
+		memset((char *)&result, 0, sizeof (result));
+		arg.ctx = ctx;
+		arg.max_entries = 0;
+		arg.max_bytes = 0;
+
+		SAMRPC_CLNT_CALL(samrpc_list_stream_close, list_stream_arg_t);
+
+		CHECK_FUNCTION_FAILURE(result, func_name);
+
+		ret_val = result.status;
+	}
+
+	PTRACE(2, "%s returning with status [%d]...", func_name, ret_val);
+	PTRACE(2, "%s exit", func_name);
+	return (ret_val);
+}
+
+
+/*
+ * get_vsn_list_stream
+ *
+ * streamed get_vsn_list
+ */
+int
+get_vsn_list_stream(
+ctx_t *ctx,			/* client connection		*/
+const char *vsn_reg_exp,	/* vsn's regular expr		*/
+int start,			/* starting index in the list */
+int size,		/* num of entries to return, -1: all remaining */
+vsn_sort_key_t sort_key,	/* sort key */
+boolean_t ascending,		/* ascending order */
+list_stream_t **ls		/* return - stream of matched vsns */
+)
+{
+
+	string_sort_arg_t arg;
+	char *func_name = "rpc:get vsn list stream";
+
+	PTRACE(2, "%s entry", func_name);
+
+	CHECK_CLIENT_HANDLE(ctx, func_name);
+	if (ISNULL(vsn_reg_exp, ls)) {
+		PTRACE(2, "%s exit %s", func_name, samerrmsg);
+		return (-1);
+	}
+
+	arg.ctx = ctx;
+	arg.str = (char *)vsn_reg_exp;
+	arg.start = start;
+	arg.size = size;
+	arg.sort_key = sort_key;
+	arg.ascending = ascending;
+
+	return (open_stream(ctx, func_name, samrpc_get_vsn_list,
+	    (xdrproc_t)xdr_string_sort_arg_t, (caddr_t)&arg, ls));
+}
+
+
+/*
+ * get_all_catalog_entries_stream
+ *
+ * streamed get_all_catalog_entries
+ */
+int
+get_all_catalog_entries_stream(
+ctx_t *ctx,			/* client connection	*/
+equ_t lib_eq,			/* equipment ordinal	*/
+int start,			/* starting index in the list */
+int size,		/* num of entries to return, -1: all remaining */
+vsn_sort_key_t sort_key,	/* sort key */
+boolean_t ascending,		/* ascending order */
+list_stream_t **ls		/* return - stream of catalog entries */
+)
+{
+
+	equ_sort_arg_t arg;
+	char *func_name = "rpc:get all catalog entries stream";
+
+	PTRACE(2, "%s entry", func_name);
+
+	CHECK_CLIENT_HANDLE(ctx, func_name);
+	if (ISNULL(ls)) {
+		PTRACE(2, "%s exit %s", func_name, samerrmsg);
+		return (-1);
+	}
+
+	arg.ctx = ctx;
+	arg.eq = lib_eq;
+	arg.start = start;
+	arg.size = size;
+	arg.sort_key = sort_key;
+	arg.ascending = ascending;
+
+	return (open_stream(ctx, func_name, samrpc_get_all_catalog_entries,
+	    (xdrproc_t)xdr_equ_sort_arg_t, (caddr_t)&arg, ls));
+}
+
+
+/*
+ * get_all_staging_files_stream
+ *
+ * streamed get_all_staging_files
+ */
+int
+get_all_staging_files_stream(
+ctx_t *ctx,			/* client connection */
+list_stream_t **ls		/* return - stream of staging files */
+)
+{
+
+	ctx_arg_t arg;
+	char *func_name = "rpc:get all staging files stream";
+
+	PTRACE(2, "%s entry", func_name);
+
+	CHECK_CLIENT_HANDLE(ctx, func_name);
+	if (ISNULL(ls)) {
+		PTRACE(2, "%s exit %s", func_name, samerrmsg);
+		return (-1);
+	}
+
+	arg.ctx = ctx;
+
+	return (open_stream(ctx, func_name, samrpc_get_all_staging_files,
+	    (xdrproc_t)xdr_ctx_arg_t, (caddr_t)&arg, ls));
+}
@@ -0,0 +1,529 @@
+/*
+ *    SAM-QFS_notice_begin
+ *
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at pkg/OPENSOLARIS.LICENSE
+ * or https://illumos.org/license/CDDL.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at pkg/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+/*
+ * Copyright 2009 Sun Microsystems, Inc.  All rights reserved.
+ * Use is subject to license terms.
+ *
+ *    SAM-QFS_notice_end
+ */
+
+#pragma ident	"$Revision: 1.1 $"
+
+#include "mgmt/sammgmt.h"
+#include "mgmt/util.h"
+#include "sam/custmsg.h"
+#include <stdlib.h>
+#include <time.h>
+
+static char *_SrcFile = __FILE__; /* Using __FILE__ makes duplicate strings */
+
+extern int server_timestamp;
+extern bool_t timestamp_updated;
+extern samrpc_result_t rpc_result;
+
+/*
+ * list_stream_svr.c
+ *
+ * Streamed list results.
+ *
+ * A list returning procedure called with SAMRPC_STREAM_FLAG set in
+ * the procedure number is run as usual. Before the reply is sent the
+ * dispatcher hands the result to samrpc_list_stream_open which keeps
+ * the list and replies with its first chunk only. The client pulls the
+ * remaining chunks with samrpc_list_stream_next.
+ *
+ * A chunk is bounded by a number of entries and by its encoded size,
+ * so neither the reply buffer nor the client's decoded list grows with
+ * the size of the list. The nodes of a chunk are unlinked from the
+ * held list and freed with the reply, so the memory held by a stream
+ * shrinks as it is read. A list built in the request arena (see
+ * list.c) takes the arena with it and releases it when the stream is
+ * freed.
+ *
+ * Streams not read for LIST_STREAM_TTL seconds are dropped, as is the
+ * least recently read stream when more than LIST_STREAM_MAX are open
+ * or more than LIST_STREAM_HELD entries are held in all streams.
+ *
+ * The server is single threaded (see sammgmt_svc.c) so the stream
+ * list is not locked.
+ */
+
+#define	LIST_STREAM_TTL		300		/* idle seconds */
+#define	LIST_STREAM_MAX		16		/* open streams */
+#define	LIST_STREAM_HELD	(4 * 1024 * 1024) /* entries in all streams */
+#define	LIST_STREAM_ENTRIES	4096		/* default entries per chunk */
+#define	LIST_STREAM_MAX_ENTRIES	65536		/* most entries per chunk */
+#define	LIST_STREAM_BYTES	(1024 * 1024)	/* default chunk size */
+#define	LIST_STREAM_MAX_BYTES	(8 * 1024 * 1024) /* largest chunk size */
+
+typedef struct list_stream {
+	int		id;
+	samstruct_type_t type;		/* result type of the list */
+	sqm_lst_t	*lst;		/* entries not yet returned */
+	lst_arena_t	*arena;		/* arena of lst, NULL if malloc'ed */
+	int		total;		/* entries in the whole list */
+	time_t		expires;
+	struct list_stream *next;	/* most recently read first */
+} list_stream_t;
+
+static list_stream_t *streams = NULL;
+static int nstreams = 0;
+static int held = 0;			/* entries held in all streams */
+static int last_id = 0;
+static list_stream_t *drained = NULL;	/* freed once its reply is sent */
+
+/*
+ * The result types whose data is a sqm_lst_t encoded with XDR_PTR2LST
+ * in xdr_result_struct_t. Only these can be streamed.
+ */
+static samstruct_type_t list_types[] = {
+	SAM_AR_SET_CRITERIA_LIST,
+	SAM_AR_FS_DIRECTIVE_LIST,
+	SAM_AR_NAMES_LIST,
+	SAM_AR_SET_COPY_PARAMS_LIST,
+	SAM_AR_VSN_POOL_LIST,
+	SAM_AR_VSN_MAP_LIST,
+	SAM_AR_ARFIND_STATE_LIST,
+	SAM_AR_ARCHREQ_LIST,
+	SAM_AR_ARCH_SET_LIST,
+	SAM_DEV_AU_LIST,
+	SAM_DEV_LIBRARY_LIST,
+	SAM_DEV_DRIVE_LIST,
+	SAM_DEV_CATALOG_ENTRY_LIST,
+	SAM_DEV_STRING_LIST,
+	SAM_FS_FS_LIST,
+	SAM_FS_STRING_LIST,
+	SAM_FS_FSCK_LIST,
+	SAM_FS_FAILED_MOUNT_OPTS_LIST,
+	SAM_LIC_STRING_LIST,
+	SAM_LD_PENDING_LOAD_INFO_LIST,
+	SAM_RC_NO_RC_VSNS_LIST,
+	SAM_RC_ROBOT_CFG_LIST,
+	SAM_RL_FS_DIRECTIVE_LIST,
+	SAM_RL_FS_LIST,
+	SAM_ST_STAGING_FILE_INFO_LIST,
+	SAM_FAULTS_LIST,
+	SAM_DISKVOL_LIST,
+	SAM_CLIENT_LIST,
+	SAM_NOTIFY_SUMMARY_LIST,
+	SAM_JOB_HISTORY_LIST,
+	SAM_HOST_INFO_LIST,
+	SAM_STRING_LIST,
+	SAM_INT_LIST,
+	SAM_STK_LSM_LIST,
+	SAM_STK_POOL_LIST,
+	SAM_STK_PANEL_LIST,
+	SAM_STK_VSN_LIST
+};
+
+
+static boolean_t
+is_list_type(
+samstruct_type_t type)
+{
+	int i;
+
+	for (i = 0; i < sizeof (list_types) / sizeof (list_types[0]); i++) {
+		if (list_types[i] == type) {
+			return (B_TRUE);
+		}
+	}
+	return (B_FALSE);
+}
+
+
+/*
+ * Encoded size of a list of type holding the entries from first
+ * through last.
+ */
+static uint_t
+encoded_size(
+samstruct_type_t type,
+node_t *first,
+node_t *last)
+{
+	sqm_lst_t lst;
+	result_struct_t res;
+	node_t *next = NULL;
+	uint_t size;
+
+	if (last != NULL) {
+		next = last->next;
+		last->next = NULL;
+	}
+	lst.head = first;
+	lst.tail = last;
+	lst.length = 0;
+	lst.arena = NULL;
+	res.result_type = type;
+	res.result_data = &lst;
+
+	size = xdr_sizeof((xdrproc_t)xdr_result_struct_t, &res);
+
+	if (last != NULL) {
+		last->next = next;
+	}
+	return (size);
+}
+
+
+/*
+ * Unlink up to max_entries entries, or max_bytes of encoded entries,
+ * from the head of the stream's list. At least one entry is taken if
+ * the list is not empty.
+ */
+static sqm_lst_t *
+take_chunk(
+list_stream_t *ls,
+int max_entries,
+uint_t max_bytes)
+{
+	sqm_lst_t *chunk;
+	node_t *node;
+	node_t *last = NULL;
+	uint_t empty, bytes;
+	int n = 0;
+
+	chunk = (sqm_lst_t *)mallocer(sizeof (sqm_lst_t));
+	if (chunk == NULL) {
+		return (NULL);
+	}
+
+	empty = encoded_size(ls->type, NULL, NULL);
+	bytes = empty;
+	for (node = ls->lst->head; node != NULL && n < max_entries;
+	    node = node->next) {
+		bytes += encoded_size(ls->type, node, node) - empty;
+		if (n > 0 && bytes > max_bytes) {
+			break;
+		}
+		last = node;
+		n++;
+	}
+
+	chunk->head = (n > 0) ? ls->lst->head : NULL;
+	chunk->tail = last;
+	chunk->length = n;
+	chunk->arena = ls->lst->arena;
+	if (last != NULL) {
+		ls->lst->head = last->next;
+		last->next = NULL;
+	}
+	if (ls->lst->head == NULL) {
+		ls->lst->tail = NULL;
+	}
+	ls->lst->length -= n;
+	held -= n;
+
+	return (chunk);
+}
+
+
+static void
+unlink_stream(
+list_stream_t *ls)
+{
+	list_stream_t **lpp;
+
+	for (lpp = &streams; *lpp != NULL; lpp = &(*lpp)->next) {
+		if (*lpp == ls) {
+			*lpp = ls->next;
+			nstreams--;
+			break;
+		}
+	}
+}
+
+
+static void
+free_stream(
+list_stream_t *ls)
+{
+	result_struct_t res;
+
+	unlink_stream(ls);
+
+	held -= ls->lst->length;
+	res.result_type = ls->type;
+	res.result_data = ls->lst;
+	xdr_free((xdrproc_t)xdr_result_struct_t, (char *)&res);
+	lst_arena_destroy(ls->arena);
+	free(ls);
+}
+
+
+/*
+ * Drop expired streams. If a stream of count entries is being opened,
+ * also drop the least recently read streams until there is room for it.
+ */
+static void
+expire_streams(
+int count)
+{
+	list_stream_t *ls, *next;
+	time_t now = time(NULL);
+
+	for (ls = streams; ls != NULL; ls = next) {
+		next = ls->next;
+		if (ls->expires <= now) {
+			Trace(TR_MISC, "list stream %d expired", ls->id);
+			free_stream(ls);
+		}
+	}
+
+	if (count < 0) {
+		return;
+	}
+	while (streams != NULL &&
+	    (nstreams >= LIST_STREAM_MAX || held + count > LIST_STREAM_HELD)) {
+		for (ls = streams; ls->next != NULL; ls = ls->next)
+			;
+		Trace(TR_MISC, "list stream %d dropped", ls->id);
+		free_stream(ls);
+	}
+}
+
+
+static list_stream_t *
+find_stream(
+int id)
+{
+	list_stream_t **lpp;
+	list_stream_t *ls;
+
+	for (lpp = &streams; *lpp != NULL; lpp = &(*lpp)->next) {
+		ls = *lpp;
+		if (ls->id == id) {
+			/* most recently read first */
+			*lpp = ls->next;
+			ls->next = streams;
+			streams = ls;
+			ls->expires = time(NULL) + LIST_STREAM_TTL;
+			return (ls);
+		}
+	}
+	samerrno = SE_RPC_STREAM_NOT_FOUND;
+	(void) snprintf(samerrmsg, MAX_MSG_LEN, GetCustMsg(samerrno), id);
+	return (NULL);
+}
+
+
+/*
+ * Replace the stream's list in res by a list_chunk_t holding the next
+ * chunk. Once its list has been returned the stream is dropped, it is
+ * freed after the reply is sent as the last chunk may be in its arena.
+ */
+static int
+set_chunk(
+samrpc_result_t *res,
+list_stream_t *ls,
+int max_entries,
+uint_t max_bytes)
+{
+	list_chunk_t *chunk;
+
+	chunk = (list_chunk_t *)mallocer(sizeof (list_chunk_t));
+	if (chunk == NULL) {
+		return (-1);
+	}
+	chunk->list.result_type = ls->type;
+	chunk->list.result_data = take_chunk(ls, max_entries, max_bytes);
+	if (chunk->list.result_data == NULL) {
+		free(chunk);
+		return (-1);
+	}
+	chunk->total = ls->total;
+	chunk->remaining = ls->lst->length;
+	chunk->stream = (chunk->remaining > 0) ? ls->id : 0;
+
+	res->samrpc_result_u.result.result_type = SAM_LIST_CHUNK;
+	res->samrpc_result_u.result.result_data = chunk;
+
+	if (chunk->stream == 0) {
+		unlink_stream(ls);
+		if (drained != NULL) {
+			free_stream(drained);
+		}
+		drained = ls;
+	}
+	return (0);
+}
+
+
+/*
+ * Called by the dispatcher for a streamed call once the procedure has
+ * set its result. A list result is replaced by its first chunk. Other
+ * results, and a list which cannot be held, are returned unchanged;
+ * the client then takes the whole list as a single chunk.
+ *
+ * A list built in arena, the arena of the request, is held with the
+ * arena. Returns B_TRUE if the stream took the arena; the dispatcher
+ * must then use another one for the following requests.
+ */
+boolean_t
+samrpc_list_stream_open(
+samrpc_result_t *res,
+lst_arena_t *arena)
+{
+	list_stream_t *ls;
+	sqm_lst_t *lst;
+
+	if (res->status == -1 ||
+	    !is_list_type(res->samrpc_result_u.result.result_type)) {
+		return (B_FALSE);
+	}
+	lst = (sqm_lst_t *)res->samrpc_result_u.result.result_data;
+	if (lst == NULL || (lst->arena != NULL && lst->arena != arena)) {
+		return (B_FALSE);
+	}
+
+	expire_streams(lst->length);
+
+	ls = (list_stream_t *)mallocer(sizeof (list_stream_t));
+	if (ls == NULL) {
+		return (B_FALSE);
+	}
+	if (++last_id <= 0) {
+		last_id = 1;
+	}
+	ls->id = last_id;
+	ls->type = res->samrpc_result_u.result.result_type;
+	ls->lst = lst;
+	ls->arena = lst->arena;
+	ls->total = lst->length;
+	ls->expires = time(NULL) + LIST_STREAM_TTL;
+	ls->next = streams;
+	streams = ls;
+	nstreams++;
+	held += lst->length;
+
+	Trace(TR_DEBUG, "list stream %d opened with %d entries",
+	    ls->id, ls->total);
+	if (set_chunk(res, ls, LIST_STREAM_ENTRIES, LIST_STREAM_BYTES) != 0) {
+		/* give the list back whole */
+		streams = ls->next;
+		nstreams--;
+		held -= lst->length;
+		free(ls);
+		return (B_FALSE);
+	}
+	return ((ls->arena != NULL) ? B_TRUE : B_FALSE);
+}
+
+
+/*
+ * Called by the dispatcher once the reply has been sent.
+ */
+void
+samrpc_list_stream_sent(void)
+{
+
+	if (drained != NULL) {
+		free_stream(drained);
+		drained = NULL;
+	}
+}
+
+
+/*
+ * Return the next chunk of a stream. The entry and byte limits of the
+ * client are honored up to the server's own limits.
+ */
+samrpc_result_t *
+samrpc_list_stream_next_6_svr(
+list_stream_arg_t *arg,	/* arguments to api */
+struct svc_req *req	/* ARGSUSED */
+)
+{
+	int ret = -1;
+	int max_entries;
+	uint_t max_bytes;
+	list_stream_t *ls;
+
+	Trace(TR_DEBUG, "Get next chunk of list stream %d", arg->stream);
+
+	/* free previous result */
+	xdr_free(xdr_samrpc_result_t, (char *)&rpc_result);
+
+	/*
+	 * The timestamp is not checked, the list was taken when the
+	 * stream was opened.
+	 */
+	max_entries = arg->max_entries;
+	if (max_entries <= 0) {
+		max_entries = LIST_STREAM_ENTRIES;
+	} else if (max_entries > LIST_STREAM_MAX_ENTRIES) {
+		max_entries = LIST_STREAM_MAX_ENTRIES;
+	}
+	max_bytes = arg->max_bytes;
+	if (max_bytes == 0) {
+		max_bytes = LIST_STREAM_BYTES;
+	} else if (max_bytes > LIST_STREAM_MAX_BYTES) {
+		max_bytes = LIST_STREAM_MAX_BYTES;
+	}
+
+	expire_streams(-1);
+	if ((ls = find_stream(arg->stream)) != NULL) {
+		ret = 0;
+	}
+	SAMRPC_SET_RESULT(ret, SAM_VOID, 0);
+	if (ret == 0 &&
+	    set_chunk(&rpc_result, ls, max_entries, max_bytes) != 0) {
+		ret = -1;
+		SAMRPC_SET_RESULT(ret, SAM_VOID, 0);
+	}
+
+	Trace(TR_DEBUG, "Get next chunk of list stream return[%d]", ret);
+	return (&rpc_result);
+}
+
+
+/*
+ * Drop a stream before it has been read to the end.
+ */
+samrpc_result_t *
+samrpc_list_stream_close_6_svr(
+list_stream_arg_t *arg,	/* arguments to api */
+struct svc_req *req	/* ARGSUSED */
+)
+{
+	int ret = 0;
+	list_stream_t *ls;
+
+	Trace(TR_DEBUG, "Close list stream %d", arg->stream);
+
+	/* free previous result */
+	xdr_free(xdr_samrpc_result_t, (char *)&rpc_result);
+
+	/* a stream which has expired is already closed */
+	for (ls = streams; ls != NULL; ls = ls->next) {
+		if (ls->id == arg->stream) {
+			free_stream(ls);
+			break;
+		}
+	}
+	SAMRPC_SET_RESULT(ret, SAM_VOID, 0);
+
+	Trace(TR_DEBUG, "Close list stream return[%d]", ret);
+	return (&rpc_result);
+}
@@ -114,6 +114,7 @@ static int _rpcpmstart;		/* Started by a port monitor ? */
 #define	_SERVED 1
 
 static int _rpcsvccount = 0;		/* Number of requests being serviced */
+static lst_arena_t *req_arena = NULL;	/* arena of the result lists */
 
 /* Global data */
 int server_timestamp = 0;	/* ensure server talks to correct client */
@@ -557,16 +558,27 @@ sammgmtprog_1(struct svc_req *rqstp, SVCXPRT *transp)
 		/* command dispatcher */
 		handle_request_arg_t samrpc_handle_request_5_0_svr;
 
+		/* list streams */
+		list_stream_arg_t samrpc_list_stream_next_6_svr;
+		list_stream_arg_t samrpc_list_stream_close_6_svr;
+
 	} argument;
 
 	char *result;
+	bool_t streamed;
 
 	bool_t (*_xdr_argument)(), (*_xdr_result)();
 	char *(*local)();
 
 	_rpcsvccount++;
 
-	switch (rqstp->rq_proc) {
+	/*
+	 * A list returning procedure called with the stream flag set
+	 * returns its list in chunks, see list_stream_svr.c
+	 */
+	streamed = (rqstp->rq_proc & SAMRPC_STREAM_FLAG) != 0;
+
+	switch (SAMRPC_PROC(rqstp->rq_proc)) {
 	case NULLPROC:
 		(void) svc_sendreply(transp, xdr_void,
 			(char *)NULL);
@@ -2470,6 +2482,21 @@ sammgmtprog_1(struct svc_req *rqstp, SVCXPRT *transp)
 		local = (char *(*)()) samrpc_handle_request_5_0_svr;
 		break;
 
+	/*
+	 * list streams
+	 */
+	case samrpc_list_stream_next:
+		_xdr_argument = xdr_list_stream_arg_t;
+		_xdr_result = xdr_samrpc_result_t;
+		local = (char *(*)()) samrpc_list_stream_next_6_svr;
+		break;
+
+	case samrpc_list_stream_close:
+		_xdr_argument = xdr_list_stream_arg_t;
+		_xdr_result = xdr_samrpc_result_t;
+		local = (char *(*)()) samrpc_list_stream_close_6_svr;
+		break;
+
 	default:
 		svcerr_noproc(transp);
 		_rpcsvccount--;
@@ -2508,11 +2535,29 @@ sammgmtprog_1(struct svc_req *rqstp, SVCXPRT *transp)
 
 		return;
 	}
+
+	/*
+	 * Result lists are built in the request arena and released at
+	 * once when the reply has been sent, see list.c
+	 */
+	if (req_arena == NULL) {
+		req_arena = lst_arena_create();
+	}
+	(void) lst_set_result_arena(req_arena);
 	result = (*local)(&argument, rqstp);
+	(void) lst_set_result_arena(NULL);
+	if (streamed && result == (char *)&rpc_result) {
+		if (samrpc_list_stream_open(&rpc_result, req_arena)) {
+			/* the stream holds the arena until it is read */
+			req_arena = NULL;
+		}
+	}
 
 	if (result != NULL && !svc_sendreply(transp, _xdr_result, result)) {
 		svcerr_systemerr(transp);
 	}
+	samrpc_list_stream_sent();
+	lst_arena_reset(req_arena);
 	if (!svc_freeargs(transp, _xdr_argument, (caddr_t)&argument)) {
 		_msgout("unable to free arguments");
 		exit(1);
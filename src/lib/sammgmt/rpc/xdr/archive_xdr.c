@@ -1034,7 +1034,16 @@ buffer_directive_t *objp)
 	if (!xdr_boolean_t(xdrs, &objp->lock))
 		return (FALSE);
 	if (!xdr_uint32_t(xdrs, &objp->change_flag))
-	if (!xdr_uint32_t(xdrs, &objp->change_flag))
+		return (FALSE);
+#ifdef SAMRPC_CLIENT
+	if (xdrs->x_op == XDR_DECODE || xdrs->x_op == XDR_ENCODE) {
+		if ((xdrs->x_public != NULL) &&
+		    (strcmp(xdrs->x_public, "1.6.4") <= 0)) {
+			return (TRUE); /* versions 1.6.4 or lower */
+		}
+	}
+#endif /* samrpc_client */
+	if (!xdr_fsize_t(xdrs, &objp->max_size))
 		return (FALSE);
 	return (TRUE);
 }
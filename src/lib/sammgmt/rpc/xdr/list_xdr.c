@@ -119,8 +119,10 @@ xdr_string_list(
 XDR *xdrs,
 sqm_lst_t *objp)
 {
-	if ((xdrs->x_op == XDR_FREE) && (objp == NULL)) {
-		return (TRUE); /* nothing to be freed */
+	if ((xdrs->x_op == XDR_FREE) &&
+	    (objp == NULL || objp->arena != NULL)) {
+		/* nothing to be freed, or released with the arena */
+		return (TRUE);
 	}
 	if (!xdr_pointer(xdrs, (char **)&objp->head,
 	    sizeof (node_t), (xdrproc_t)xdr_string_node))
@@ -448,6 +448,10 @@ result_struct_t *objp)
 		case SAM_PUBLIC_KEY:
 			XDR_PTR2STRUCT(objp->result_data, public_key_result_t);
 			break;
+
+		case SAM_LIST_CHUNK:
+			XDR_PTR2STRUCT(objp->result_data, list_chunk_t);
+			break;
 		default:
 			/* do nothing */
 			break;
@@ -581,3 +585,44 @@ int_ptrarr_result_t *objp)
 	return (TRUE);
 
 }
+
+
+/*
+ * A chunk of a streamed list. The entries are encoded as the result
+ * the procedure would have returned, so the list routines of its
+ * result type are used unchanged.
+ */
+bool_t
+xdr_list_chunk_t(
+XDR *xdrs,
+list_chunk_t *objp)
+{
+
+	if (!xdr_int(xdrs, &objp->stream))
+		return (FALSE);
+	if (!xdr_int(xdrs, &objp->total))
+		return (FALSE);
+	if (!xdr_int(xdrs, &objp->remaining))
+		return (FALSE);
+	if (!xdr_result_struct_t(xdrs, &objp->list))
+		return (FALSE);
+
+	return (TRUE);
+}
+
+bool_t
+xdr_list_stream_arg_t(
+XDR *xdrs,
+list_stream_arg_t *objp)
+{
+
+	XDR_PTR2CTX(objp->ctx);
+	if (!xdr_int(xdrs, &objp->stream))
+		return (FALSE);
+	if (!xdr_int(xdrs, &objp->max_entries))
+		return (FALSE);
+	if (!xdr_uint32_t(xdrs, &objp->max_bytes))
+		return (FALSE);
+
+	return (TRUE);
+}
@@ -138,11 +138,11 @@ extern void MinToStr(time_t chgtime, long num_mins,
 		if (buf[len - 1] == ',') {			\
 			buf[len - 1] = '\0';			\
 		}						\
-		ptr = copystr(buf);				\
+		ptr = lst_strdup(lstp, buf);			\
 		if (ptr != NULL) {				\
 			rval = lst_append(lstp, ptr);		\
 			if (rval != 0) {			\
-				free(ptr);			\
+				lst_strfree(lstp, ptr);		\
 				ptr = NULL;			\
 			}					\
 		} else {					\
@@ -432,6 +432,7 @@ filedetails_from_stat(
 	char		buf[MAXPATHLEN +1];
 	char		*usedir = NULL;
 	sqm_lst_t		*detlist = NULL;
+	lst_arena_t	*arena;
 
 	if (ISNULL(fsname, results)) {
 		return (-1);
@@ -463,8 +464,14 @@ filedetails_from_stat(
 		usedir = startDir;
 	}
 
+	/*
+	 * the file names are moved to the details, which are freed one
+	 * by one, so the list is not built in the result arena.
+	 */
+	arena = lst_set_result_arena(NULL);
 	st = list_directory(NULL, howmany, usedir, startFile, restrictions,
 	    morefiles, &flist);
+	(void) lst_set_result_arena(arena);
 
 	if (st != 0) {
 		return (-1);
@@ -1096,7 +1103,7 @@ filedetails_to_string(
 		return (-1);
 	}
 
-	*results = lst_create();	/* Return results in this list */
+	*results = lst_create_result();	/* Return results in this list */
 	if (*results == NULL) {
 		Trace(TR_ERR, "%s failed: %d %s",
 		    funcnam, samerrno, samerrmsg);
@@ -37,6 +37,7 @@ static char *_SrcFile = __FILE__; /* Using __FILE__ makes duplicate strings */
 /*
  * ANSI C headers.
  */
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -349,12 +350,41 @@ setBufsizeParams(void)
 
 		buf->size = (uint64_t)val;
 
-		if (ReadCfgGetToken() != 0) {
+		/*
+		 * Optional maximum buffer size, the copy process
+		 * adjusts the buffer between the two.
+		 */
+		buf->max_size = 0;
+		buf->change_flag &= ~BD_max;
+		if (ReadCfgGetToken() != 0 &&
+		    isdigit(*(unsigned char *)token)) {
+			errno = 0;
+			val = strtoull(token, &p, 0);
+			if (errno != 0 || *p != '\0') {
+				/* Invalid '%s' value '%s' */
+				free(buf);
+				ReadCfgError(CustMsg(14101), dirName, token);
+			}
+			if (val < buf->size) {
+				free(buf);
+				ReadCfgError(CustMsg(14103), dirName,
+				    (long long)buf->size);
+			} else if (val > 1024) {
+				free(buf);
+				ReadCfgError(CustMsg(14104), dirName,
+				    (long long)1024);
+			}
+			buf->max_size = (uint64_t)val;
+			buf->change_flag |= BD_max;
+			(void) ReadCfgGetToken();
+		}
+
+		if (*token != '\0') {
 			if (strcmp(token, "lock") == 0) {
 				buf->lock = TRUE;
 				buf->change_flag |= BD_lock;
 			} else {
-				/* bufsize option must be 'lock' */
+				/* bufsize option must be a maximum or 'lock' */
 				free(buf);
 				ReadCfgError(CustMsg(4521));
 			}
@@ -843,28 +873,27 @@ const stager_cfg_t *s)	/* cfg to write */
 
 	if (s->stage_buf_list != NULL && s->stage_buf_list->length != 0) {
 		buffer_directive_t *b;
+		int size;
 		for (node = s->stage_buf_list->head;
 		    node != NULL; node = node->next) {
 			b = (buffer_directive_t *)node->data;
-			// if lock is set
-			if (b->change_flag & BD_lock && b->lock) {
-				// if buf size is set as well
-				if (b->size != fsize_reset &&
-				    b->change_flag & BD_size) {
-					fprintf(f, "\nbufsize = %s %d lock",
-					    b->media_type, (int)b->size);
-				} else {
-					fprintf(f, "\nbufsize = %s %d lock",
-					    b->media_type,
-					    DEFAULT_AR_BUFSIZE);
-				}
-			// if lock is not set but size is set
-			} else if (b->size != fsize_reset &&
+			// if buf size is set, else the default if lock is set
+			if (b->size != fsize_reset &&
 			    b->change_flag & BD_size) {
-				fprintf(f, "\nbufsize = %s %d",
-				    b->media_type, (int)b->size);
+				size = (int)b->size;
+			} else if (b->change_flag & BD_lock && b->lock) {
+				size = DEFAULT_AR_BUFSIZE;
+			} else {
+				// if they both are not set, do nothing
+				continue;
+			}
+			fprintf(f, "\nbufsize = %s %d", b->media_type, size);
+			if (b->change_flag & BD_max && b->max_size >= size) {
+				fprintf(f, " %d", (int)b->max_size);
+			}
+			if (b->change_flag & BD_lock && b->lock) {
+				fprintf(f, " lock");
 			}
-			// if they both are not set, do nothing
 		}
 	}
 
@@ -962,6 +991,33 @@ const buffer_directive_t *b)
 		    samerrmsg);
 		return (-1);
 	}
+	if (!(b->change_flag & BD_max)) {
+		Trace(TR_DEBUG, "checked bufsize");
+		return (0);
+	}
+	if (b->max_size < b->size) {
+		samerrno = SE_FSIZE_TOO_SMALL;
+		/* %s value must be greater than %lld */
+		snprintf(samerrmsg, MAX_MSG_LEN,
+		    GetCustMsg(SE_FSIZE_TOO_SMALL), "bufsize maximum",
+		    (long long)b->size);
+
+		Trace(TR_DEBUG, "checking bufsize failed: %s",
+		    samerrmsg);
+		return (-1);
+
+	} else if (b->max_size > 1024) {
+		samerrno = SE_FSIZE_TOO_LARGE;
+
+		/* %s value must be less than %lld */
+		snprintf(samerrmsg, MAX_MSG_LEN,
+		    GetCustMsg(SE_FSIZE_TOO_LARGE),
+		    "bufsize maximum", (long long)1024);
+
+		Trace(TR_DEBUG, "checking bufsize failed: %s",
+		    samerrmsg);
+		return (-1);
+	}
 
 	Trace(TR_DEBUG, "checked bufsize");
 	return (0);
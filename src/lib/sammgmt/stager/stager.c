@@ -484,6 +484,11 @@ buffer_directive_t *stage_buffer)	/* buffer directive need to be set */
 			if (stage_buffer->change_flag & BD_lock) {
 				buffer_directive->lock = stage_buffer->lock;
 			}
+			if (stage_buffer->change_flag & BD_max) {
+				buffer_directive->max_size =
+				    stage_buffer->max_size;
+				buffer_directive->change_flag |= BD_max;
+			}
 			match_flag = 1;
 			break;
 		}
@@ -320,6 +320,9 @@ BufDirective2bufdir(JNIEnv *env, jobject bufdObj) {
 	bd->lock = getBoolFld(env, cls, bufdObj, "lock");
 	bd->change_flag =
 	    (uint32_t)getJLongFld(env, cls, bufdObj, "chgFlags");
+	/* BufDirective has no maximum, keep the one in the cmd file */
+	bd->max_size = 0;
+	bd->change_flag &= ~BD_max;
 	PTRACE(2, "jni:BufDirective2bufdir() done");
 	return (bd);
 }
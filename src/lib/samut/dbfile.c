@@ -43,6 +43,18 @@ static char *_SrcFile = __FILE__; /* Using __FILE__ makes duplicate strings */
 #include <string.h>
 #include <sys/varargs.h>
 #include <limits.h>
+#include <time.h>
+
+/* POSIX headers. */
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/param.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#ifdef sun
+#include <atomic.h>
+#endif /* sun */
 
 /* Berkeley DB headers. */
 #include <db.h>
@@ -55,6 +67,41 @@ static char *_SrcFile = __FILE__; /* Using __FILE__ makes duplicate strings */
 /* Private data. */
 static char *tracePrefix = "DB";
 
+/*
+ * Record cache.
+ */
+#define	DBCACHE_HASH 64
+
+typedef struct DBCacheEntry {
+	struct DBCacheEntry *next;
+	unsigned int	keySize;
+	unsigned int	dataSize;
+	void		*data;		/* Copy of the record */
+	char		key[1];		/* Copy of the key */
+} DBCacheEntry_t;
+
+typedef struct DBCache {
+	pthread_mutex_t	mutex;
+	pthread_cond_t	cv;		/* Wakes the flusher on close */
+	pthread_t	flusher;	/* Syncs deferred Puts */
+	boolean_t	flushing;	/* Flusher running */
+	DBFile_t	*dbfile;
+	volatile uint64_t *gen;		/* Mapped generation count */
+	boolean_t	enabled;	/* Get served from cache */
+	uint64_t	seen;		/* Generation of cached records */
+	boolean_t	dirty;		/* Puts not yet synced */
+	time_t		synced;		/* Time of last sync */
+	void		*rsp;		/* Record returned by Get */
+	size_t		rspSize;
+	DBCacheEntry_t	*tab[DBCACHE_HASH];
+} DBCache_t;
+
+#ifdef sun
+#define	DBCACHE_BUMP(c) atomic_inc_64((c)->gen)
+#else /* sun */
+#define	DBCACHE_BUMP(c) (void) __sync_fetch_and_add((c)->gen, 1)
+#endif /* sun */
+
 /* Private functions. */
 static int dbFileOpen(DBFile_t *dbfile, char *file, char *database,
 	int flags);
@@ -72,6 +119,18 @@ static int dbFileEndIterator(DBFile_t *dbfile);
 /* ErrMsg - return error message string */
 static int dbFileNumof(DBFile_t *dbfile, int *numof);
 
+static DBCache_t *cacheOpen(DBFile_t *dbfile, char *file, boolean_t enabled);
+static void cacheClose(DBCache_t *cache);
+static void *cacheFlusher(void *arg);
+static void cacheEmpty(DBCache_t *cache);
+static void cacheLock(DBFile_t *dbfile);
+static void cacheUnlock(DBFile_t *dbfile);
+static DBCacheEntry_t *cacheFind(DBCache_t *cache, void *dbkey,
+	unsigned int dbkey_size);
+static void cacheAdd(DBCache_t *cache, void *dbkey, unsigned int dbkey_size,
+	void *dbdata, unsigned int dbdata_size);
+static unsigned int cacheHash(void *dbkey, unsigned int dbkey_size);
+
 static DB_ENV *setupEnv(char *homedir, char *datadir, char *progname);
 static void dbError(const DB_ENV *dbenv, const char *errpfx, const char *msg);
 
@@ -308,6 +367,10 @@ dbFileOpen(
 	if (ret != 0 && ret != ENOENT) {
 		db->err(db, ret, "%s: open", file);
 	}
+	if (ret == 0) {
+		dbfile->cache = cacheOpen(dbfile, file,
+		    (flags & DBFILE_CACHE) ? B_TRUE : B_FALSE);
+	}
 
 	Trace(TR_DBFILE, "%s [%x] open complete %d", tracePrefix, dbfile, ret);
 	return (ret);
@@ -349,14 +412,34 @@ dbFilePut(
 	data.size = dbdata_size;
 	data.data = dbdata;
 
+	cacheLock(dbfile);
 	ret = db->put(db, NULL, &key, &data, flags);
-	if (ret != 0) {
-		if (ret != DB_KEYEXIST) {
+	if (dbfile->cache != NULL) {
+		DBCache_t *cache = (DBCache_t *)dbfile->cache;
+		time_t now = time(NULL);
+
+		/*
+		 * Invalidate all cached copies and batch the sync.
+		 * The flusher syncs what is left dirty.
+		 */
+		DBCACHE_BUMP(cache);
+		if (ret != 0 && ret != DB_KEYEXIST) {
 			db->close(db, 0);
 			db = dbfile->db = NULL;
+			cache->dirty = B_FALSE;
+		} else if (cache->flushing == B_FALSE ||
+		    now - cache->synced >= DBFILE_SYNC_SECS) {
+			db->sync(db, 0);
+			cache->dirty = B_FALSE;
+			cache->synced = now;
+		} else {
+			cache->dirty = B_TRUE;
 		}
-	}
-	if (db != NULL) {
+		cacheUnlock(dbfile);
+	} else if (ret != 0 && ret != DB_KEYEXIST) {
+		db->close(db, 0);
+		db = dbfile->db = NULL;
+	} else {
 		db->sync(db, 0);
 	}
 
@@ -390,13 +473,63 @@ dbFileGet(
 
 	db = dbfile->db;
 
+	if (dbfile->cache != NULL &&
+	    ((DBCache_t *)dbfile->cache)->enabled) {
+		DBCache_t *cache = (DBCache_t *)dbfile->cache;
+		DBCacheEntry_t *ce;
+
+		pthread_mutex_lock(&cache->mutex);
+		if (cache->seen != *cache->gen) {
+			cacheEmpty(cache);
+			cache->seen = *cache->gen;
+		}
+		ce = cacheFind(cache, dbkey, dbkey_size);
+		if (ce == NULL) {
+			memset(&key,  0, sizeof (DBT));
+			memset(&data, 0, sizeof (DBT));
+			key.size = dbkey_size;
+			key.data = dbkey;
+			ret = db->get(db, NULL, &key, &data, 0);
+			if (ret != 0) {
+				pthread_mutex_unlock(&cache->mutex);
+				*dbdata = NULL;
+				return (ret);
+			}
+			cacheAdd(cache, dbkey, dbkey_size, data.data, data.size);
+			*dbdata = data.data;
+		} else {
+			/*
+			 * Return a copy, callers may change the record.
+			 */
+			if (ce->dataSize > cache->rspSize) {
+				void *rsp = realloc(cache->rsp, ce->dataSize);
+
+				if (rsp == NULL) {
+					pthread_mutex_unlock(&cache->mutex);
+					*dbdata = NULL;
+					return (ENOMEM);
+				}
+				cache->rsp = rsp;
+				cache->rspSize = ce->dataSize;
+			}
+			memcpy(cache->rsp, ce->data, ce->dataSize);
+			*dbdata = cache->rsp;
+		}
+		pthread_mutex_unlock(&cache->mutex);
+		Trace(TR_DBFILE, "%s [%x] get complete cached %d data: %x",
+		    tracePrefix, dbfile, ce != NULL, *dbdata);
+		return (0);
+	}
+
 	memset(&key,  0, sizeof (DBT));
 	memset(&data, 0, sizeof (DBT));
 
 	key.size = dbkey_size;
 	key.data = dbkey;
 
+	cacheLock(dbfile);
 	ret = db->get(db, NULL, &key, &data, 0);
+	cacheUnlock(dbfile);
 	if (ret != 0) {
 		/* FIXME Log error */
 		*dbdata = NULL;
@@ -437,7 +570,12 @@ dbFileDel(
 	key.size = dbkey_size;
 	key.data = dbkey;
 
+	cacheLock(dbfile);
 	ret = db->del(db, NULL, &key, 0);
+	if (dbfile->cache != NULL) {
+		DBCACHE_BUMP((DBCache_t *)dbfile->cache);
+	}
+	cacheUnlock(dbfile);
 
 	Trace(TR_DBFILE, "%s [%x] del complete %d",
 	    tracePrefix, dbfile, ret);
@@ -456,6 +594,11 @@ dbFileClose(
 
 	Trace(TR_DBFILE, "%s [%x] close", tracePrefix, dbfile);
 
+	if (dbfile->cache != NULL) {
+		cacheClose((DBCache_t *)dbfile->cache);
+		dbfile->cache = NULL;
+	}
+
 	db = dbfile->db;
 	if (db == NULL) {
 		return (-1);
@@ -486,7 +629,9 @@ dbFileBeginIterator(
 
 	db = dbfile->db;
 
+	cacheLock(dbfile);
 	ret = db->cursor(db, NULL, (DBC **)&dbfile->dbc, 0);
+	cacheUnlock(dbfile);
 
 	Trace(TR_DBFILE, "%s [%x] beginiterator complete %d",
 	    tracePrefix, dbfile, ret);
@@ -521,7 +666,9 @@ dbFileGetIterator(
 	memset(&key,  0, sizeof (DBT));
 	memset(&data, 0, sizeof (DBT));
 
+	cacheLock(dbfile);
 	ret = dbc->get(dbc, &key, &data, DB_NEXT);
+	cacheUnlock(dbfile);
 	if (ret != 0) {
 		/* Log error */
 		return (ret);
@@ -556,7 +703,9 @@ dbFileEndIterator(
 
 	dbc = dbfile->dbc;
 
+	cacheLock(dbfile);
 	ret = dbc->close(dbc);
+	cacheUnlock(dbfile);
 
 	Trace(TR_DBFILE, "%s [%x] enditerator complete %d",
 	    tracePrefix, dbfile, ret);
@@ -585,7 +734,9 @@ dbFileNumof(
 
 	db = dbfile->db;
 
+	cacheLock(dbfile);
 	ret = db->stat(db, NULL, &stat, DB_FAST_STAT);
+	cacheUnlock(dbfile);
 
 	*numof = 0;
 	if (ret == 0) {
@@ -598,6 +749,241 @@ dbFileNumof(
 	return (ret);
 }
 
+/*
+ * Open record cache.
+ * Map the generation count shared by all users of the database file.
+ * It is mapped for uncached handles too, so that their updates
+ * invalidate the caches of other processes.
+ * Returns NULL if the count cannot be mapped, the database is then
+ * used uncached.
+ */
+static DBCache_t *
+cacheOpen(
+	DBFile_t *dbfile,
+	char *file,
+	boolean_t enabled)	/* Serve Get from cache */
+{
+	DB_ENV *dbenv = (DB_ENV *)dbfile->dbenv;
+	const char *home;
+	char path[MAXPATHLEN];
+	DBCache_t *cache;
+	void *mp;
+	int fd;
+
+	if (dbenv->get_home(dbenv, &home) != 0 || home == NULL) {
+		return (NULL);
+	}
+	snprintf(path, sizeof (path), "%s/%s.gen", home, file);
+	fd = open(path, O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		Trace(TR_DBFILE, "%s [%x] cache disabled, open %s failed %d",
+		    tracePrefix, dbfile, path, errno);
+		return (NULL);
+	}
+	if (ftruncate(fd, sizeof (uint64_t)) < 0) {
+		(void) close(fd);
+		return (NULL);
+	}
+	mp = mmap(NULL, sizeof (uint64_t), PROT_READ | PROT_WRITE,
+	    MAP_SHARED, fd, 0);
+	(void) close(fd);
+	if (mp == MAP_FAILED) {
+		return (NULL);
+	}
+
+	cache = (DBCache_t *)malloc(sizeof (DBCache_t));
+	if (cache == NULL) {
+		(void) munmap(mp, sizeof (uint64_t));
+		return (NULL);
+	}
+	memset(cache, 0, sizeof (DBCache_t));
+	(void) pthread_mutex_init(&cache->mutex, NULL);
+	(void) pthread_cond_init(&cache->cv, NULL);
+	cache->dbfile = dbfile;
+	cache->gen = (volatile uint64_t *)mp;
+	cache->enabled = enabled;
+	cache->seen = *cache->gen;
+	cache->synced = time(NULL);
+
+	/*
+	 * Without a flusher, Puts are synced as they are done.
+	 */
+	if (enabled && pthread_create(&cache->flusher, NULL,
+	    cacheFlusher, cache) == 0) {
+		cache->flushing = B_TRUE;
+	}
+
+	Trace(TR_DBFILE, "%s [%x] cache generation %s: %lld",
+	    tracePrefix, dbfile, path, cache->seen);
+	return (cache);
+}
+
+/*
+ * Close record cache.
+ * A deferred sync is done by the database close that follows.
+ */
+static void
+cacheClose(
+	DBCache_t *cache)
+{
+	if (cache->flushing) {
+		pthread_mutex_lock(&cache->mutex);
+		cache->flushing = B_FALSE;
+		(void) pthread_cond_signal(&cache->cv);
+		pthread_mutex_unlock(&cache->mutex);
+		(void) pthread_join(cache->flusher, NULL);
+	}
+	cacheEmpty(cache);
+	(void) munmap((void *)cache->gen, sizeof (uint64_t));
+	(void) pthread_cond_destroy(&cache->cv);
+	(void) pthread_mutex_destroy(&cache->mutex);
+	if (cache->rsp != NULL) {
+		free(cache->rsp);
+	}
+	free(cache);
+}
+
+/*
+ * Record cache flusher thread.
+ * Syncs deferred Puts, so that the database is never more than
+ * DBFILE_SYNC_SECS seconds behind even if the process goes idle.
+ * The handle is not opened with DB_THREAD, all its other users take
+ * the cache mutex too.
+ */
+static void *
+cacheFlusher(
+	void *arg)
+{
+	DBCache_t *cache = (DBCache_t *)arg;
+	struct timespec ts;
+
+	pthread_mutex_lock(&cache->mutex);
+	while (cache->flushing) {
+		ts.tv_sec = time(NULL) + DBFILE_SYNC_SECS;
+		ts.tv_nsec = 0;
+		(void) pthread_cond_timedwait(&cache->cv, &cache->mutex, &ts);
+		if (cache->dirty && cache->dbfile->db != NULL) {
+			DB *db = (DB *)cache->dbfile->db;
+
+			db->sync(db, 0);
+			cache->dirty = B_FALSE;
+			cache->synced = time(NULL);
+		}
+	}
+	pthread_mutex_unlock(&cache->mutex);
+	return (NULL);
+}
+
+/*
+ * Drop all cached records.
+ */
+static void
+cacheEmpty(
+	DBCache_t *cache)
+{
+	int i;
+
+	for (i = 0; i < DBCACHE_HASH; i++) {
+		while (cache->tab[i] != NULL) {
+			DBCacheEntry_t *ce = cache->tab[i];
+
+			cache->tab[i] = ce->next;
+			free(ce);
+		}
+	}
+}
+
+/*
+ * Serialize a handle operation with the flusher.
+ */
+static void
+cacheLock(
+	DBFile_t *dbfile)
+{
+	if (dbfile->cache != NULL) {
+		pthread_mutex_lock(&((DBCache_t *)dbfile->cache)->mutex);
+	}
+}
+
+static void
+cacheUnlock(
+	DBFile_t *dbfile)
+{
+	if (dbfile->cache != NULL) {
+		pthread_mutex_unlock(&((DBCache_t *)dbfile->cache)->mutex);
+	}
+}
+
+/*
+ * Find cached record.
+ */
+static DBCacheEntry_t *
+cacheFind(
+	DBCache_t *cache,
+	void *dbkey,
+	unsigned int dbkey_size)
+{
+	DBCacheEntry_t *ce;
+
+	for (ce = cache->tab[cacheHash(dbkey, dbkey_size)]; ce != NULL;
+	    ce = ce->next) {
+		if (ce->keySize == dbkey_size &&
+		    memcmp(ce->key, dbkey, dbkey_size) == 0) {
+			break;
+		}
+	}
+	return (ce);
+}
+
+/*
+ * Add record to cache.
+ * Key and record are copied into one allocation.
+ */
+static void
+cacheAdd(
+	DBCache_t *cache,
+	void *dbkey,
+	unsigned int dbkey_size,
+	void *dbdata,
+	unsigned int dbdata_size)
+{
+	DBCacheEntry_t *ce;
+	size_t size;
+	int h;
+
+	size = STRUCT_RND(sizeof (DBCacheEntry_t) + dbkey_size);
+	ce = (DBCacheEntry_t *)malloc(size + dbdata_size);
+	if (ce == NULL) {
+		return;		/* Not cached */
+	}
+	ce->keySize = dbkey_size;
+	ce->dataSize = dbdata_size;
+	memcpy(ce->key, dbkey, dbkey_size);
+	ce->data = (char *)ce + size;
+	memcpy(ce->data, dbdata, dbdata_size);
+
+	h = cacheHash(dbkey, dbkey_size);
+	ce->next = cache->tab[h];
+	cache->tab[h] = ce;
+}
+
+/*
+ * Hash a key.
+ */
+static unsigned int
+cacheHash(
+	void *dbkey,
+	unsigned int dbkey_size)
+{
+	unsigned char *p = (unsigned char *)dbkey;
+	unsigned int h = 0;
+
+	while (dbkey_size-- > 0) {
+		h = (h * 31) + *p++;
+	}
+	return (h % DBCACHE_HASH);
+}
+
 /*
  * Setup SAM database environment.
  */
@@ -125,7 +125,7 @@ static int statPath(SamrftImpl_t *rftd, char *path, struct stat *sb);
 /*
  * Called by daemons to construct a disk volume, VSN or client, dictionary
  * handle.  If successful, the dictionary handle will be saved in static
- * variables.
+ * variables.  VSN and client lookups through the handle are cached.
  */
 DiskVolsDictionary_t *
 DiskVolsNewHandle(
@@ -144,7 +144,8 @@ DiskVolsNewHandle(
 		if (dict == NULL) {
 			ret = DiskVolsInit(&vsnDict, dbtype, progname);
 			if (ret == 0) {
-				ret = vsnDict->Open(vsnDict, flags);
+				ret = vsnDict->Open(vsnDict,
+				    flags | DISKVOLS_CACHE);
 			}
 			if (ret != 0) {
 				Trace(TR_DEBUG,
@@ -164,7 +165,8 @@ DiskVolsNewHandle(
 		if (dict == NULL) {
 			ret = DiskVolsInit(&cliDict, dbtype, progname);
 			if (ret == 0) {
-				ret = cliDict->Open(cliDict, flags);
+				ret = cliDict->Open(cliDict,
+				    flags | DISKVOLS_CACHE);
 			}
 			if (ret != 0) {
 				Trace(TR_DEBUG,
@@ -1093,6 +1095,9 @@ diskVolsOpen(
 	if (flags & DISKVOLS_RDONLY) {
 		dbfile_flags |= DBFILE_RDONLY;
 	}
+	if (flags & DISKVOLS_CACHE) {
+		dbfile_flags |= DBFILE_CACHE;
+	}
 
 	if (IS_VSN(dict)) {
 		ret = dbfile->Open(dbfile, DISKVOLS_FILENAME,
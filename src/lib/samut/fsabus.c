@@ -0,0 +1,736 @@
+/*
+ * fsabus.c - File system event bus, see fsabus.h.
+ *
+ *	Consumer functions:
+ *	    sam_fsa_bus_open	- Open or create the ring of a consumer.
+ *	    sam_fsa_bus_filter	- Set the events wanted.
+ *	    sam_fsa_bus_read	- Read events from the ring.
+ *	    sam_fsa_bus_lost	- Consume a loss window.
+ *	    sam_fsa_bus_wait	- Wait for events.
+ *	    sam_fsa_bus_stats	- Return ring statistics.
+ *	    sam_fsa_bus_close	- Close, and optionally remove, the ring.
+ *
+ *	Daemon functions:
+ *	    sam_fsa_pub_create	- Start serving the rings of a fs.
+ *	    sam_fsa_pub_scan	- Attach new rings, detach removed ones.
+ *	    sam_fsa_pub_events	- Copy events into the rings.
+ *	    sam_fsa_pub_destroy	- Detach all rings.
+ */
+
+/*
+ *    SAM-QFS_notice_begin
+ *
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at pkg/OPENSOLARIS.LICENSE
+ * or https://illumos.org/license/CDDL.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at pkg/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+/*
+ * Copyright 2009 Sun Microsystems, Inc.  All rights reserved.
+ * Use is subject to license terms.
+ *
+ *    SAM-QFS_notice_end
+ */
+
+#pragma ident "$Revision: 1.1 $"
+
+static char *_SrcFile = __FILE__; /* Using __FILE__ makes duplicate strings */
+
+/* ANSI C headers. */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* POSIX headers. */
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#ifdef sun
+#include <atomic.h>
+#endif /* sun */
+
+/* SAM-FS headers. */
+#include "sam/types.h"
+#include "sam/lib.h"
+#include "sam/sam_malloc.h"
+#include "sam/sam_trace.h"
+#include "sam/fsabus.h"
+
+/* Consumer of a ring. */
+struct sam_fsa_bus {
+	sam_fsa_ring_t	*ring;
+	char		*path;		/* Ring file */
+};
+
+/* Ring served by the daemon. */
+typedef struct pub_ring {
+	sam_fsa_ring_t	*ring;
+	uint32_t	size;		/* Events, validated at attach */
+	ino_t		ino;		/* Inode of the ring file */
+	boolean_t	mark;		/* Found by the current scan */
+	char		name[MAXNAMELEN];
+	uint32_t	pending;	/* Dropped, window not yet reported */
+	uint32_t	at;		/* Ring position of the drops */
+	uint32_t	seqno;		/* First event dropped */
+	sam_time_t	time;
+} pub_ring_t;
+
+/*
+ * Ring event at pos, indexed by the size validated at attach and not
+ * by the header, which the consumer can write.
+ */
+#define	PUB_RING_EVENT(pr, pos) \
+	((sam_event_t *)(void *)((char *)(pr)->ring + FSA_RING_HDR_SIZE) + \
+	    ((pos) & ((pr)->size - 1)))
+
+struct sam_fsa_pub {
+	char		*path;		/* Log directory */
+	char		*fs_name;
+	int		l_fsn;
+	time_t		scan_time;	/* Time of the last scan */
+	time_t		dir_mtime;	/* Directory time at the last scan */
+	int		n_rings;
+	pub_ring_t	rings[FSA_BUS_CONSUMERS];
+};
+
+/* Private functions. */
+static char *ring_path(char *path, char *fs_name, char *name,
+    char *suffix);
+static sam_fsa_ring_t *ring_create(char *file, int size);
+static void pub_attach(sam_fsa_pub_t *pub, char *name, ino_t ino);
+static void pub_detach(sam_fsa_pub_t *pub, int i);
+static void pub_report(sam_fsa_pub_t *pub, pub_ring_t *pr);
+
+
+/*
+ * Open the ring of consumer in the log directory path of fs_name.  An
+ * existing ring of the same size is reused, the consumer continues at
+ * its cursor.  Otherwise a new ring of size events (FSA_BUS_SIZE if 0)
+ * is created, sam-fsalogd starts writing to it within FSA_BUS_RESCAN
+ * seconds.
+ * Returns 0 if successful, -1 with errno set if not.
+ */
+int
+sam_fsa_bus_open(
+	sam_fsa_bus_t **busp,	/* Returned consumer */
+	char *path,		/* Log directory */
+	char *fs_name,		/* File system */
+	char *consumer,		/* Consumer name */
+	int size)		/* Ring events, 0 for the default */
+{
+	sam_fsa_bus_t *bus;
+	sam_fsa_ring_t *r;
+	char *file;
+	int n;
+
+	if (strlen(consumer) == 0 || strlen(consumer) > FSA_BUS_NAME_MAX ||
+	    strpbrk(consumer, "./") != NULL) {
+		Trace(TR_ERR, "invalid bus consumer name '%s'", consumer);
+		errno = EINVAL;
+		return (-1);
+	}
+	if (size == 0) {
+		size = FSA_BUS_SIZE;
+	}
+	for (n = FSA_BUS_SIZE_MIN; n < size && n < FSA_BUS_SIZE_MAX; n *= 2)
+		;
+	size = n;
+
+	file = ring_path(path, fs_name, consumer, FSA_BUS_SUFFIX);
+	r = MapFileAttach(file, FSA_RING_MAGIC, O_RDWR);
+	if (r != NULL && (r->fr_version != FSA_RING_VERSION ||
+	    r->fr_size != size || r->fr_mf.MfValid == 0)) {
+		(void) MapFileDetach(r);
+		r = NULL;
+	}
+	if (r == NULL) {
+		r = ring_create(file, size);
+		if (r == NULL) {
+			SamFree(file);
+			return (-1);
+		}
+	}
+
+	SamMalloc(bus, sizeof (sam_fsa_bus_t));
+	bus->ring = r;
+	bus->path = file;
+	*busp = bus;
+	return (0);
+}
+
+
+/*
+ * Set the events wanted by the consumer.  mask has bit 1 << ev_num set
+ * for each event wanted, 0 for all events.  Only events of inodes in
+ * min_ino to max_ino are copied into the ring, max_ino 0 for no upper
+ * bound.  Applies to the events sam-fsalogd receives next.
+ */
+void
+sam_fsa_bus_filter(
+	sam_fsa_bus_t *bus,
+	uint32_t mask,
+	sam_ino_t min_ino,
+	sam_ino_t max_ino)
+{
+	bus->ring->fr_mask = mask;
+	bus->ring->fr_min_ino = min_ino;
+	bus->ring->fr_max_ino = max_ino;
+}
+
+
+/*
+ * Read up to n events from the ring.
+ * Returns the number of events read, 0 if none available, FSA_BUS_LOST
+ * if events were dropped at this position, see sam_fsa_bus_lost().
+ */
+int
+sam_fsa_bus_read(
+	sam_fsa_bus_t *bus,
+	sam_event_t *events,
+	int n)
+{
+	sam_fsa_ring_t *r = bus->ring;
+	uint32_t out;
+	uint32_t in;
+	uint32_t avail;
+	uint32_t first;
+
+	out = r->fr_out;
+	in = r->fr_in;
+	membar_consumer();
+
+	/* Stop at an unconsumed loss window */
+	if (r->fr_lost_gen != r->fr_lost_ack) {
+		membar_consumer();
+		if (out == r->fr_lost_at) {
+			return (FSA_BUS_LOST);
+		}
+		if (r->fr_lost_at - out < in - out) {
+			in = r->fr_lost_at;
+		}
+	}
+
+	avail = MIN(in - out, (uint32_t)n);
+	if (avail == 0) {
+		return (0);
+	}
+	first = MIN(avail, r->fr_size - (out & (r->fr_size - 1)));
+	memcpy(events, FSA_RING_EVENT(r, out), first * sizeof (sam_event_t));
+	if (first < avail) {
+		memcpy(&events[first], FSA_RING_EVENT(r, out + first),
+		    (avail - first) * sizeof (sam_event_t));
+	}
+
+	/* Events copied before the slots are given back */
+	membar_exit();
+	r->fr_out = out + avail;
+	return (avail);
+}
+
+
+/*
+ * Consume the loss window reached by sam_fsa_bus_read().  The events
+ * dropped can be read from the log, starting with event seqno logged
+ * at time.
+ * Returns the number of events dropped, 0 if there is no window.
+ */
+int
+sam_fsa_bus_lost(
+	sam_fsa_bus_t *bus,
+	uint32_t *seqno,	/* Returned first event dropped */
+	sam_time_t *time)	/* Returned time of first event dropped */
+{
+	sam_fsa_ring_t *r = bus->ring;
+	uint32_t gen;
+	int n;
+
+	gen = r->fr_lost_gen;
+	if (gen == r->fr_lost_ack) {
+		return (0);
+	}
+	membar_consumer();
+	n = r->fr_lost_events;
+	if (seqno != NULL) {
+		*seqno = r->fr_lost_seqno;
+	}
+	if (time != NULL) {
+		*time = r->fr_lost_time;
+	}
+	membar_exit();
+	r->fr_lost_ack = gen;
+	return (n);
+}
+
+
+/*
+ * Wait up to msec milliseconds, -1 for ever, for events or a loss
+ * window.  sam-fsalogd writes events at each event interval, the ring
+ * is polled.
+ * Returns 1 if there is something to read, 0 if not.
+ */
+int
+sam_fsa_bus_wait(
+	sam_fsa_bus_t *bus,
+	int msec)
+{
+	sam_fsa_ring_t *r = bus->ring;
+	int tick;
+
+	for (;;) {
+		if (r->fr_in != r->fr_out || r->fr_lost_gen != r->fr_lost_ack) {
+			return (1);
+		}
+		if (msec == 0) {
+			return (0);
+		}
+		tick = (msec > 0 && msec < 100) ? msec : 100;
+		(void) poll(NULL, 0, tick);
+		if (msec > 0) {
+			msec -= tick;
+		}
+	}
+}
+
+
+/*
+ * Return the statistics of the ring.
+ */
+void
+sam_fsa_bus_stats(
+	sam_fsa_bus_t *bus,
+	sam_fsa_bus_stats_t *stats)
+{
+	sam_fsa_ring_t *r = bus->ring;
+
+	stats->fs_size = r->fr_size;
+	stats->fs_held = r->fr_in - r->fr_out;
+	stats->fs_hiwat = r->fr_hiwat;
+	stats->fs_kern_lost = r->fr_kern_lost;
+	stats->fs_seen = r->fr_seen;
+	stats->fs_matched = r->fr_matched;
+	stats->fs_dropped = r->fr_dropped;
+	stats->fs_full = r->fr_full;
+}
+
+
+/*
+ * Close the ring.  If remove, the ring is removed and sam-fsalogd stops
+ * writing to it.  Otherwise events are kept for the next open, up to the
+ * ring size.
+ * Returns 0 if successful, -1 if not.
+ */
+int
+sam_fsa_bus_close(
+	sam_fsa_bus_t **busp,
+	boolean_t remove)
+{
+	sam_fsa_bus_t *bus = *busp;
+	int rst = 0;
+
+	if (bus == NULL) {
+		return (0);
+	}
+	if (remove) {
+		bus->ring->fr_mf.MfValid = 0;
+		if (unlink(bus->path) == -1) {
+			Trace(TR_ERR, "unlink(%s) failed", bus->path);
+			rst = -1;
+		}
+	}
+	(void) MapFileDetach(bus->ring);
+	SamFree(bus->path);
+	SamFree(bus);
+	*busp = NULL;
+	return (rst);
+}
+
+
+/*
+ * Start serving the rings of fs_name in log directory path.
+ */
+sam_fsa_pub_t *
+sam_fsa_pub_create(
+	char *path,		/* Log directory */
+	char *fs_name)		/* File system */
+{
+	sam_fsa_pub_t *pub;
+
+	SamMalloc(pub, sizeof (sam_fsa_pub_t));
+	memset(pub, 0, sizeof (sam_fsa_pub_t));
+	SamStrdup(pub->path, path);
+	SamStrdup(pub->fs_name, fs_name);
+	pub->l_fsn = strlen(fs_name);
+	sam_fsa_pub_scan(pub, TRUE);
+	return (pub);
+}
+
+
+/*
+ * Report the drops of rings whose consumer caught up, attach the rings
+ * created in the log directory and detach the rings removed.  The
+ * directory is read if its time changed, every FSA_BUS_RESCAN seconds,
+ * or if force.
+ */
+void
+sam_fsa_pub_scan(
+	sam_fsa_pub_t *pub,
+	boolean_t force)
+{
+	struct stat sb;
+	struct dirent *ent;
+	DIR *dirp;
+	time_t now;
+	int len;
+	int i;
+
+	for (i = 0; i < pub->n_rings; i++) {
+		pub_report(pub, &pub->rings[i]);
+	}
+
+	now = time(NULL);
+	if (stat(pub->path, &sb) == -1) {
+		return;
+	}
+	if (!force && sb.st_mtime == pub->dir_mtime &&
+	    now - pub->scan_time < FSA_BUS_RESCAN) {
+		return;
+	}
+	pub->dir_mtime = sb.st_mtime;
+	pub->scan_time = now;
+
+	if ((dirp = opendir(pub->path)) == NULL) {
+		Trace(TR_ERR, "opendir(%s) failed", pub->path);
+		return;
+	}
+	for (i = 0; i < pub->n_rings; i++) {
+		pub->rings[i].mark = FALSE;
+	}
+
+	while ((ent = readdir(dirp)) != NULL) {
+		len = strlen(ent->d_name);
+		if (strncmp(ent->d_name, pub->fs_name, pub->l_fsn) != 0 ||
+		    ent->d_name[pub->l_fsn] != '.' ||
+		    len <= pub->l_fsn + strlen(FSA_BUS_SUFFIX) + 1 ||
+		    strcmp(&ent->d_name[len - strlen(FSA_BUS_SUFFIX)],
+		    FSA_BUS_SUFFIX) != 0) {
+			continue;
+		}
+		for (i = 0; i < pub->n_rings; i++) {
+			if (strcmp(pub->rings[i].name, ent->d_name) == 0 &&
+			    pub->rings[i].ino == ent->d_ino) {
+				pub->rings[i].mark = TRUE;
+				break;
+			}
+		}
+		if (i == pub->n_rings) {
+			pub_attach(pub, ent->d_name, ent->d_ino);
+		}
+	}
+	(void) closedir(dirp);
+
+	for (i = pub->n_rings - 1; i >= 0; i--) {
+		if (!pub->rings[i].mark ||
+		    pub->rings[i].ring->fr_mf.MfValid == 0) {
+			pub_detach(pub, i);
+		}
+	}
+}
+
+
+/*
+ * Copy n events into the rings whose filter they pass.  kern_lost is
+ * the count of events lost by the kernel, passed on to consumers.
+ */
+void
+sam_fsa_pub_events(
+	sam_fsa_pub_t *pub,
+	sam_event_t *events,	/* Events received */
+	int n,			/* Number of events */
+	int kern_lost)		/* Events lost by the kernel */
+{
+	pub_ring_t *pr;
+	sam_fsa_ring_t *r;
+	sam_event_t *ev;
+	uint32_t mask;
+	sam_ino_t min_ino;
+	sam_ino_t max_ino;
+	uint32_t in;
+	uint32_t out;
+	uint32_t matched;
+	uint32_t dropped;
+	int i;
+	int j;
+
+	for (i = 0; i < pub->n_rings; i++) {
+		pr = &pub->rings[i];
+		r = pr->ring;
+		if (r->fr_mf.MfValid == 0) {
+			continue;
+		}
+		pub_report(pub, pr);
+
+		mask = r->fr_mask;
+		min_ino = r->fr_min_ino;
+		max_ino = r->fr_max_ino;
+		in = r->fr_in;
+		out = r->fr_out;
+		matched = 0;
+		dropped = 0;
+
+		for (j = 0; j < n; j++) {
+			ev = &events[j];
+			if ((mask != 0 && (mask & (1 << ev->ev_num)) == 0) ||
+			    ev->ev_id.ino < min_ino ||
+			    (max_ino != 0 && ev->ev_id.ino > max_ino)) {
+				continue;
+			}
+			matched++;
+
+			/* No event past drops not yet reported */
+			if (pr->pending == 0 && in - out < pr->size) {
+				*PUB_RING_EVENT(pr, in) = *ev;
+				in++;
+				continue;
+			}
+			if (pr->pending == 0) {
+				pr->at = in;
+				pr->seqno = ev->ev_seqno;
+				pr->time = ev->ev_time;
+				r->fr_full++;
+				Trace(TR_MISC, "[%s] bus ring %s full, "
+				    "dropping events", pub->fs_name, pr->name);
+			}
+			pr->pending++;
+			dropped++;
+		}
+
+		/* Events written before they are made visible */
+		membar_producer();
+		r->fr_in = in;
+		r->fr_hiwat = MAX(r->fr_hiwat, in - out);
+		r->fr_seen += n;
+		r->fr_matched += matched;
+		r->fr_dropped += dropped;
+		r->fr_kern_lost = kern_lost;
+		pub_report(pub, pr);
+	}
+}
+
+
+/*
+ * Detach all rings.
+ */
+void
+sam_fsa_pub_destroy(
+	sam_fsa_pub_t *pub)
+{
+	if (pub == NULL) {
+		return;
+	}
+	while (pub->n_rings > 0) {
+		pub_detach(pub, pub->n_rings - 1);
+	}
+	SamFree(pub->path);
+	SamFree(pub->fs_name);
+	SamFree(pub);
+}
+
+
+/*
+ * Return path/fs_name.name suffix.
+ */
+static char *
+ring_path(
+	char *path,
+	char *fs_name,
+	char *name,
+	char *suffix)
+{
+	char *file;
+	size_t len;
+
+	len = strlen(path) + strlen(fs_name) + strlen(name) +
+	    strlen(suffix) + 3;
+	SamMalloc(file, len);
+	snprintf(file, len, "%s/%s.%s%s", path, fs_name, name, suffix);
+	return (file);
+}
+
+
+/*
+ * Create a ring of size events.  The ring is built under a temporary
+ * name so sam-fsalogd never sees it partly initialized.
+ */
+static sam_fsa_ring_t *
+ring_create(
+	char *file,
+	int size)
+{
+	sam_fsa_ring_t *r;
+	char *tmp;
+	size_t len;
+	int saveErrno;
+	int fd;
+
+	len = FSA_RING_HDR_SIZE + (size_t)size * sizeof (sam_event_t);
+	SamMalloc(tmp, strlen(file) + 5);
+	snprintf(tmp, strlen(file) + 5, "%s.new", file);
+
+	(void) unlink(tmp);
+	if ((fd = open(tmp, O_RDWR | O_CREAT | O_EXCL, 0644)) == -1) {
+		Trace(TR_ERR, "open(%s) failed", tmp);
+		goto err;
+	}
+	if (ftruncate(fd, len) == -1) {
+		Trace(TR_ERR, "ftruncate(%s) failed", tmp);
+		goto err;
+	}
+	r = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (r == MAP_FAILED) {
+		Trace(TR_ERR, "mmap(%s) failed", tmp);
+		goto err;
+	}
+	(void) close(fd);
+
+	r->fr_mf.MfMagic = FSA_RING_MAGIC;
+	r->fr_mf.MfLen = len;
+	r->fr_version = FSA_RING_VERSION;
+	r->fr_size = size;
+	r->fr_mf.MfValid = 1;
+
+	if (rename(tmp, file) == -1) {
+		Trace(TR_ERR, "rename(%s) failed", tmp);
+		saveErrno = errno;
+		(void) munmap((char *)r, len);
+		(void) unlink(tmp);
+		SamFree(tmp);
+		errno = saveErrno;
+		return (NULL);
+	}
+	SamFree(tmp);
+	return (r);
+
+err:
+	saveErrno = errno;
+	if (fd >= 0) {
+		(void) close(fd);
+		(void) unlink(tmp);
+	}
+	SamFree(tmp);
+	errno = saveErrno;
+	return (NULL);
+}
+
+
+/*
+ * Attach the ring in file name.
+ */
+static void
+pub_attach(
+	sam_fsa_pub_t *pub,
+	char *name,
+	ino_t ino)
+{
+	pub_ring_t *pr;
+	sam_fsa_ring_t *r;
+	uint32_t size;
+	char *file;
+
+	if (pub->n_rings == FSA_BUS_CONSUMERS) {
+		Trace(TR_ERR, "[%s] bus ring %s ignored, %d rings served",
+		    pub->fs_name, name, FSA_BUS_CONSUMERS);
+		return;
+	}
+
+	SamMalloc(file, strlen(pub->path) + strlen(name) + 2);
+	sprintf(file, "%s/%s", pub->path, name);
+	r = MapFileAttach(file, FSA_RING_MAGIC, O_RDWR);
+	SamFree(file);
+	if (r == NULL) {
+		Trace(TR_ERR, "[%s] bus ring %s attach failed", pub->fs_name,
+		    name);
+		return;
+	}
+	size = r->fr_size;
+	if (r->fr_version != FSA_RING_VERSION || r->fr_mf.MfValid == 0 ||
+	    size == 0 || (size & (size - 1)) != 0 || r->fr_mf.MfLen !=
+	    FSA_RING_HDR_SIZE + (size_t)size * sizeof (sam_event_t)) {
+		Trace(TR_ERR, "[%s] bus ring %s invalid", pub->fs_name, name);
+		(void) MapFileDetach(r);
+		return;
+	}
+
+	pr = &pub->rings[pub->n_rings++];
+	memset(pr, 0, sizeof (pub_ring_t));
+	pr->ring = r;
+	pr->size = size;
+	pr->ino = ino;
+	pr->mark = TRUE;
+	strncpy(pr->name, name, sizeof (pr->name) - 1);
+	Trace(TR_MISC, "[%s] bus ring %s attached, %d events, %d held",
+	    pub->fs_name, name, size, r->fr_in - r->fr_out);
+}
+
+
+/*
+ * Detach ring i.
+ */
+static void
+pub_detach(
+	sam_fsa_pub_t *pub,
+	int i)
+{
+	pub_ring_t *pr = &pub->rings[i];
+
+	Trace(TR_MISC, "[%s] bus ring %s detached, %lld events dropped",
+	    pub->fs_name, pr->name, (long long)pr->ring->fr_dropped);
+	(void) MapFileDetach(pr->ring);
+	pub->rings[i] = pub->rings[--pub->n_rings];
+}
+
+
+/*
+ * Report the events dropped from a ring once the consumer has consumed
+ * the previous loss window.
+ */
+static void
+pub_report(
+	sam_fsa_pub_t *pub,
+	pub_ring_t *pr)
+{
+	sam_fsa_ring_t *r = pr->ring;
+
+	if (pr->pending == 0 || r->fr_lost_gen != r->fr_lost_ack) {
+		return;
+	}
+	r->fr_lost_at = pr->at;
+	r->fr_lost_events = pr->pending;
+	r->fr_lost_seqno = pr->seqno;
+	r->fr_lost_time = pr->time;
+	membar_producer();
+	r->fr_lost_gen++;
+	Trace(TR_MISC, "[%s] bus ring %s dropped %d events", pub->fs_name,
+	    pr->name, pr->pending);
+	pr->pending = 0;
+}
@@ -0,0 +1,218 @@
+/*
+ * iotune.c - Adaptive i/o buffer depth and read size.
+ *
+ * The tuning rules are described in sam/iotune.h.
+ */
+
+/*
+ *    SAM-QFS_notice_begin
+ *
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at pkg/OPENSOLARIS.LICENSE
+ * or https://illumos.org/license/CDDL.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at pkg/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+/*
+ * Copyright 2009 Sun Microsystems, Inc.  All rights reserved.
+ * Use is subject to license terms.
+ *
+ *    SAM-QFS_notice_end
+ */
+
+#pragma ident "$Revision: 1.1 $"
+
+/* ANSI C headers. */
+#include <string.h>
+
+/* POSIX headers. */
+#include <sys/types.h>
+
+/* SAM-FS headers. */
+#include "sam/types.h"
+#include "sam/iotune.h"
+
+/* Private functions. */
+static int readLimit(struct IoTune *it);
+
+
+/*
+ * Upper bound of a stall histogram bucket.
+ * Returns seconds: 10us, 40us, ... about 2.6 s.
+ */
+double
+IoTuneBound(
+	int bucket)
+{
+	return (1e-5 * (double)(1 << (2 * bucket)));
+}
+
+
+/*
+ * Initialize tuning.
+ * The depth starts at its lower bound, the read size at its upper bound.
+ */
+void
+IoTuneInit(
+	struct IoTune *it,
+	int depthMin,
+	int depthMax,
+	int readMin,
+	int readMax)
+{
+	memset(it, 0, sizeof (struct IoTune));
+	if (depthMax < depthMin) {
+		depthMax = depthMin;
+	}
+	if (readMax < readMin) {
+		readMax = readMin;
+	}
+	it->ItDepthMin = it->ItDepth = depthMin;
+	it->ItDepthMax = depthMax;
+	it->ItReadMin = readMin;
+	it->ItReadMax = readMax;
+	it->ItRead = readLimit(it);
+}
+
+
+/*
+ * Record a stall.
+ */
+void
+IoTuneStall(
+	struct IoTuneStalls *is,
+	uint64_t ns)
+{
+	int	i;
+
+	for (i = 0; i < IOTUNE_BUCKETS; i++) {
+		if (ns <= (uint64_t)(IoTuneBound(i) * 1e9)) {
+			break;
+		}
+	}
+	is->IsBuckets[i]++;
+	is->IsCount++;
+	is->IsTime += ns;
+}
+
+
+/*
+ * Adjust the depth and read size at the end of an interval.
+ * Returns TRUE if either was changed.
+ */
+boolean_t
+IoTuneAdjust(
+	struct IoTune *it,
+	uint64_t now)		/* ns, gethrtime() */
+{
+	uint64_t elapsed;
+	boolean_t changed;
+	int	consumer;
+	int	depth;
+	int	producer;
+	int	read;
+
+	if (it->ItStart == 0 || now < it->ItStart) {
+		it->ItStart = now;
+		it->ItProducerMark = it->ItProducer.IsTime;
+		it->ItConsumerMark = it->ItConsumer.IsTime;
+		return (FALSE);
+	}
+	elapsed = now - it->ItStart;
+	if (elapsed < (uint64_t)IOTUNE_INTERVAL * 1000000000) {
+		return (FALSE);
+	}
+
+	/*
+	 * Percent of the interval each side stalled.
+	 */
+	producer = (int)(((it->ItProducer.IsTime - it->ItProducerMark) *
+	    100) / elapsed);
+	consumer = (int)(((it->ItConsumer.IsTime - it->ItConsumerMark) *
+	    100) / elapsed);
+	it->ItStart = now;
+	it->ItProducerMark = it->ItProducer.IsTime;
+	it->ItConsumerMark = it->ItConsumer.IsTime;
+
+	depth = it->ItDepth;
+	read = it->ItRead;
+	if (producer >= IOTUNE_STALL && consumer >= IOTUNE_STALL) {
+		it->ItQuiet = 0;
+		if (depth < it->ItDepthMax) {
+			depth *= 2;
+		} else {
+			read /= 2;
+		}
+	} else if (consumer >= IOTUNE_STALL) {
+		it->ItQuiet = 0;
+		read *= 2;
+	} else if (producer < IOTUNE_STALL) {
+		if (++it->ItQuiet >= IOTUNE_QUIET) {
+			it->ItQuiet = 0;
+			depth -= depth / 4;
+		}
+	}
+
+	if (depth > it->ItDepthMax) {
+		depth = it->ItDepthMax;
+	}
+	if (depth < it->ItDepthMin) {
+		depth = it->ItDepthMin;
+	}
+	if (depth == it->ItDepth && read == it->ItRead) {
+		return (FALSE);
+	}
+	changed = (depth != it->ItDepth);
+	it->ItDepth = depth;
+	if (read > readLimit(it)) {
+		read = readLimit(it);
+	}
+	if (read < it->ItReadMin) {
+		read = it->ItReadMin;
+	}
+	if (read != it->ItRead) {
+		changed = TRUE;
+	}
+	it->ItRead = read;
+	if (!changed) {
+		return (FALSE);
+	}
+	it->ItAdjusts++;
+	return (TRUE);
+}
+
+
+/* Private functions. */
+
+
+/*
+ * Largest read size for the depth.
+ */
+static int
+readLimit(
+	struct IoTune *it)
+{
+	int	limit;
+
+	limit = it->ItDepth / 2;
+	if (limit > it->ItReadMax) {
+		limit = it->ItReadMax;
+	}
+	if (limit < it->ItReadMin) {
+		limit = it->ItReadMin;
+	}
+	return (limit);
+}
@@ -164,6 +164,9 @@ MapFileAttach(
 	} else {
 		return (mp);
 	}
+	saveErrno = errno;
+	(void) munmap(mp, st.st_size);
+	errno = saveErrno;
 	return (NULL);
 }
 
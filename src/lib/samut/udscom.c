@@ -50,6 +50,9 @@
 
 /* POSIX headers. */
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <limits.h>
+#include <pthread.h>
 #include <signal.h>
 #include <unistd.h>
 
@@ -65,13 +68,31 @@
 #undef unlink
 #endif /* defined(lint) */
 
+#if !defined(IOV_MAX)
+#define	IOV_MAX 16
+#endif /* !defined(IOV_MAX) */
+
+/* Private types. */
+struct ServeArg {
+	struct UdsServer *SaSrvr;	/* Server definitions */
+	int	SaSock;			/* Listening socket */
+};
+
 /* Private functions. */
 static void catchSigpipe(int sig);
+static int connectServer(struct UdsClient *clnt);
+static void makeHeader(struct UdsMsgHeader *hdr, struct UdsClient *clnt,
+	const char *srcFile, const int srcLine, int srvrMsgType, int arg_size);
+static int readResponse(int sock, struct UdsClient *clnt, void *rsp,
+	int rsp_size, int *nakErrno);
 static void samlog(void (*LogFunc)(char *msg), struct UmNak *nak,
 	struct UdsMsgHeader *hdr, const char *fmt, ...);
-static void readClientMessage(int sfd, struct UdsServer *srvr, char *argbuf);
+static int readClientMessage(int sfd, struct UdsServer *srvr, char *argbuf);
+static int serveConnections(struct UdsServer *srvr, int sock, char *argbuf);
+static void *serveThread(void *arg);
 static ssize_t sockRead(int fildes, void *buf, size_t nbyte);
 static ssize_t sockWrite(int fildes, void *buf, size_t nbyte);
+static ssize_t sockWritev(int fildes, struct iovec *iov, int iovcnt);
 
 
 /*
@@ -90,50 +111,18 @@ UdsSendMsg(
 {
 	struct UdsMsgHeader hdr;
 	struct UmNak nak;
-	struct sockaddr_un name;
-	int len;
 	int n;
 	int sock;
 
-	/*
-	 * Create the address of the server.
-	 */
-	memset(&name, 0, sizeof (name));
-	name.sun_family = AF_UNIX;
-	sprintf(name.sun_path, "%s/uds/%s", SAM_VARIABLE_PATH,
-	    clnt->UcServerName);
-	len = sizeof (name.sun_family) + strlen(name.sun_path);
-
-	/*
-	 * Create the socket.
-	 */
-retry:
-	if ((sock = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
-		if (errno == ENOMEM || errno == ENOBUFS) {
-			sleep(1);
-			goto retry;
-		}
-		return (-1);
-	}
-
-	/*
-	 * Connect to the server.
-	 */
-	if (connect(sock, (struct sockaddr *)&name, len) < 0) {
-		(void) close(sock);
+	if ((sock = connectServer(clnt)) < 0) {
 		return (-1);
 	}
 
 	/*
 	 * Send header.
 	 */
-	hdr.UhMagic   = clnt->UcMagic;
-	hdr.UhType    = UM_max + srvrMsgType;
-	strncpy(hdr.UhName, clnt->UcClientName, sizeof (hdr.UhName)-1);
-	hdr.UhPid    = getpid();
-	strncpy(hdr.UhSrcFile, srcFile, sizeof (hdr.UhSrcFile)-1);
-	hdr.UhSrcLine = srcLine;
-	hdr.UhArgSize = (arg != NULL) ? arg_size : 0;
+	makeHeader(&hdr, clnt, srcFile, srcLine, srvrMsgType,
+	    (arg != NULL) ? arg_size : 0);
 
 #ifdef TEST
 /*
@@ -238,6 +227,96 @@ retry:
 }
 
 
+/*
+ * Send a batch of messages from a client to a server.
+ * All messages are sent on one connection.  Each window of requests
+ * is written with a single writev(), then the responses are read back
+ * in order before the next window is sent.  This bounds the data
+ * queued in either direction so the client and the server cannot both
+ * block writing.
+ * The server ends the connection after a NAK, so a NAK stops the batch.
+ * Per message status is returned in UbStatus and UbErrno, -1 for
+ * messages that were not answered.
+ * Returns 0 if all messages were acked, else -1.
+ */
+int
+UdsSendBatch(
+	const char *srcFile,
+	const int srcLine,
+	struct UdsClient *clnt,	/* Client definitions */
+	struct UdsBatchMsg *msgs, /* Messages to send */
+	int count)		/* Number of messages */
+{
+	struct UdsMsgHeader hdrs[UDS_BATCH_WINDOW];
+	struct iovec iov[2 * UDS_BATCH_WINDOW];
+	int first;
+	int i;
+	int sock;
+
+	for (i = 0; i < count; i++) {
+		msgs[i].UbStatus = -1;
+		msgs[i].UbErrno = 0;
+	}
+	if (count <= 0) {
+		return (0);
+	}
+	if ((sock = connectServer(clnt)) < 0) {
+		return (-1);
+	}
+	for (first = 0; first < count; first += UDS_BATCH_WINDOW) {
+		int	niov;
+		int	num;
+
+		num = count - first;
+		if (num > UDS_BATCH_WINDOW) {
+			num = UDS_BATCH_WINDOW;
+		}
+
+		/*
+		 * Send the window of requests.
+		 */
+		niov = 0;
+		for (i = 0; i < num; i++) {
+			struct UdsBatchMsg *ub = &msgs[first + i];
+
+			makeHeader(&hdrs[i], clnt, srcFile, srcLine,
+			    ub->UbType, (ub->UbArg != NULL) ? ub->UbArgSize : 0);
+			iov[niov].iov_base = (caddr_t)&hdrs[i];
+			iov[niov].iov_len = sizeof (hdrs[i]);
+			niov++;
+			if (hdrs[i].UhArgSize != 0) {
+				iov[niov].iov_base = (caddr_t)ub->UbArg;
+				iov[niov].iov_len = ub->UbArgSize;
+				niov++;
+			}
+		}
+		if (sockWritev(sock, iov, niov) < 0) {
+			(void) close(sock);
+			return (-1);
+		}
+
+		/*
+		 * Collect the responses.
+		 */
+		for (i = 0; i < num; i++) {
+			struct UdsBatchMsg *ub = &msgs[first + i];
+
+			ub->UbStatus = readResponse(sock, clnt, ub->UbRsp,
+			    ub->UbRspSize, &ub->UbErrno);
+			if (ub->UbStatus != 0) {
+				if (ub->UbStatus == UM_nak) {
+					errno = ub->UbErrno;
+				}
+				(void) close(sock);
+				return (-1);
+			}
+		}
+	}
+	(void) close(sock);
+	return (0);
+}
+
+
 /*
  * Receive Client message.
  */
@@ -247,8 +326,10 @@ UdsRecvMsg(
 {
 	struct sigaction sig_action;
 	struct sockaddr_un name;
+	pthread_t *tids = NULL;
 	char *argbuf = NULL;
 	unsigned int len;
+	int ntids = 0;
 	int sock = -1;
 	int r = 0;
 
@@ -303,39 +384,77 @@ UdsRecvMsg(
 	/*
 	 * Listen for connections.
 	 */
-	if (listen(sock, 5) < 0) {
+	if (listen(sock, (srvr->UsThreads > 5) ? srvr->UsThreads : 5) < 0) {
 		r = -1;
 		goto out;
 	}
 
-	while (!srvr->UsStop) {
-		int ns;
-#if defined(SIM_ERROR)
-		static int msgcount = 0;
-#endif /* defined(SIM_ERROR) */
+	/*
+	 * Start the threads for the additional connections.
+	 * They take no signals, the caller's thread handles them.
+	 */
+	if (srvr->UsThreads > 1) {
+		struct ServeArg *sa;
+		sigset_t allSigs;
+		sigset_t oldSigs;
 
-		/*
-		 * Accept a connection.
-		 * Read and process message.
-		 */
-		if ((ns = accept(sock, (struct sockaddr *)&name, &len)) < 0) {
+		tids = malloc((srvr->UsThreads - 1) * sizeof (pthread_t));
+		if (tids == NULL) {
 			r = -1;
 			goto out;
 		}
+		(void) sigfillset(&allSigs);
+		(void) pthread_sigmask(SIG_SETMASK, &allSigs, &oldSigs);
+		while (ntids < srvr->UsThreads - 1) {
+			if ((sa = malloc(sizeof (struct ServeArg))) == NULL) {
+				break;
+			}
+			sa->SaSrvr = srvr;
+			sa->SaSock = sock;
+			if (pthread_create(&tids[ntids], NULL, serveThread,
+			    sa) != 0) {
+				free(sa);
+				break;
+			}
+			ntids++;
+		}
+		(void) pthread_sigmask(SIG_SETMASK, &oldSigs, NULL);
+	}
+	r = serveConnections(srvr, sock, argbuf);
 
-#if defined(SIM_ERROR)
-		fprintf(stderr, "\rMessage %d ", msgcount);
-		msgcount++;
-#endif /* defined(SIM_ERROR) */
+	/*
+	 * Stop the other serving threads before the socket is closed.
+	 * A thread blocked in accept() is not woken by close(), so
+	 * connect once for each thread.  The thread accepts, sees
+	 * UsStop, and returns.
+	 */
+	if (ntids > 0) {
+		int	saveErrno = errno;
+		int	i;
 
-		readClientMessage(ns, srvr, argbuf);
-		(void) close(ns);
+		srvr->UsStop = 1;
+		for (i = 0; i < ntids; i++) {
+			int	cs;
+
+			if ((cs = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+				continue;
+			}
+			(void) connect(cs, (struct sockaddr *)&name, len);
+			(void) close(cs);
+		}
+		for (i = 0; i < ntids; i++) {
+			(void) pthread_join(tids[i], NULL);
+		}
+		errno = saveErrno;
 	}
 
 out:
 	if (sock >= 0) {
 		(void) close(sock);
 	}
+	if (tids != NULL) {
+		free(tids);
+	}
 	if (argbuf != NULL) {
 		free(argbuf);
 	}
@@ -354,6 +473,132 @@ catchSigpipe(
 }
 
 
+/*
+ * Connect to a server.
+ * Returns the connected socket, or -1 if error.
+ */
+static int
+connectServer(
+	struct UdsClient *clnt)	/* Client definitions */
+{
+	struct sockaddr_un name;
+	int len;
+	int sock;
+
+	/*
+	 * Create the address of the server.
+	 */
+	memset(&name, 0, sizeof (name));
+	name.sun_family = AF_UNIX;
+	sprintf(name.sun_path, "%s/uds/%s", SAM_VARIABLE_PATH,
+	    clnt->UcServerName);
+	len = sizeof (name.sun_family) + strlen(name.sun_path);
+
+	/*
+	 * Create the socket.
+	 */
+retry:
+	if ((sock = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+		if (errno == ENOMEM || errno == ENOBUFS) {
+			sleep(1);
+			goto retry;
+		}
+		return (-1);
+	}
+
+	/*
+	 * Connect to the server.
+	 */
+	if (connect(sock, (struct sockaddr *)&name, len) < 0) {
+		(void) close(sock);
+		return (-1);
+	}
+	return (sock);
+}
+
+
+/*
+ * Build a client message header.
+ */
+static void
+makeHeader(
+	struct UdsMsgHeader *hdr,
+	struct UdsClient *clnt,
+	const char *srcFile,
+	const int srcLine,
+	int srvrMsgType,
+	int arg_size)
+{
+	memset(hdr, 0, sizeof (*hdr));
+	hdr->UhMagic   = clnt->UcMagic;
+	hdr->UhType    = UM_max + srvrMsgType;
+	strncpy(hdr->UhName, clnt->UcClientName, sizeof (hdr->UhName)-1);
+	hdr->UhPid    = getpid();
+	strncpy(hdr->UhSrcFile, srcFile, sizeof (hdr->UhSrcFile)-1);
+	hdr->UhSrcLine = srcLine;
+	hdr->UhArgSize = arg_size;
+}
+
+
+/*
+ * Read one response from the server.
+ * Returns 0 if acked, UM_nak if naked, -1 if error.
+ */
+static int
+readResponse(
+	int sock,
+	struct UdsClient *clnt,	/* Client definitions */
+	void *rsp,		/* Where to put response */
+	int rsp_size,		/* Size of response buffer */
+	int *nakErrno)		/* Where to put the errno from a nak */
+{
+	struct UdsMsgHeader hdr;
+	struct UmNak nak;
+	char	c;
+	int	n;
+	int	rc;
+
+	n = sockRead(sock, &hdr, sizeof (hdr));
+	if (n != sizeof (hdr)) {
+		if (n >= 0) {
+			errno = EPIPE;
+		}
+		return (-1);
+	}
+	if (hdr.UhType == UM_nak) {
+		rsp = &nak;
+		rsp_size = sizeof (nak);
+	}
+
+	/*
+	 * Read response, discard what does not fit.
+	 */
+	rc = 0;
+	if (rsp != NULL && rsp_size > 0 && hdr.UhArgSize > 0) {
+		rc = (int)rsp_size;
+		if (rc > hdr.UhArgSize) {
+			rc = hdr.UhArgSize;
+		}
+		if (sockRead(sock, rsp, rc) != rc) {
+			return (-1);
+		}
+	}
+	while (rc++ < hdr.UhArgSize) {
+		if (sockRead(sock, &c, 1) != 1) {
+			return (-1);
+		}
+	}
+	if (hdr.UhType != UM_nak) {
+		return (0);
+	}
+	*nakErrno = nak.Errno;
+	if (clnt->UcLog != NULL) {
+		clnt->UcLog(nak.msg);
+	}
+	return (UM_nak);
+}
+
+
 /*
  * Log a communication error.
  */
@@ -418,8 +663,10 @@ samlog(
 
 /*
  * Read message from client.
+ * Returns 0 if another message may follow on the connection, -1 if the
+ * client closed it or the stream can no longer be trusted.
  */
-static void
+static int
 readClientMessage(
 	int sfd,
 	struct UdsServer *srvr,
@@ -427,6 +674,7 @@ readClientMessage(
 {
 	struct UdsMsgHeader hdr;
 	struct UmNak nak;
+	struct iovec iov[2];
 	void	*rsp = NULL;
 	int		msgtype;
 	int		n;
@@ -440,7 +688,10 @@ readClientMessage(
 	if (n < 0) {
 		nak.Errno = errno;
 		samlog(srvr->UsLog, &nak, NULL, "Message read error");
-		return;
+		return (-1);
+	}
+	if (n == 0) {
+		return (-1);		/* Client closed the connection */
 	}
 
 	/*
@@ -450,7 +701,7 @@ readClientMessage(
 	if (n != sizeof (hdr)) {
 		samlog(srvr->UsLog, &nak, &hdr,
 		    "read header: expected %d, got %d", sizeof (hdr), n);
-		return;
+		return (-1);
 	}
 	if (hdr.UhMagic != srvr->UsMagic) {
 		samlog(srvr->UsLog, &nak, &hdr, "Bad magic %o", hdr.UhMagic);
@@ -509,7 +760,13 @@ readClientMessage(
 	/*
 	 * Process message.
 	 */
+	if (srvr->UsBegin != NULL) {
+		srvr->UsBegin(msgtype, argbuf);
+	}
 	rsp = srvr->UsTable[msgtype].UmFunc(argbuf, &hdr);
+	if (srvr->UsEnd != NULL) {
+		srvr->UsEnd(msgtype, argbuf);
+	}
 	if (rsp != NULL && srvr->UsTable[msgtype].UmRspSize != 0) {
 		hdr.UhArgSize = srvr->UsTable[msgtype].UmRspSize;
 	}
@@ -519,31 +776,102 @@ readClientMessage(
 	 */
 ack:
 	hdr.UhType = UM_ack;
-	if (sockWrite(sfd, &hdr, sizeof (hdr)) < 0) {
+	iov[0].iov_base = (caddr_t)&hdr;
+	iov[0].iov_len = sizeof (hdr);
+	iov[1].iov_base = (caddr_t)rsp;
+	iov[1].iov_len = hdr.UhArgSize;
+	if (sockWritev(sfd, iov, (hdr.UhArgSize > 0) ? 2 : 1) < 0) {
 		nak.Errno = errno;
 		samlog(srvr->UsLog, &nak, &hdr, "Response send error");
+		return (-1);
 	}
-	if (hdr.UhArgSize > 0) {
-		if (sockWrite(sfd, rsp, hdr.UhArgSize) < 0) {
-			nak.Errno = errno;
-			samlog(srvr->UsLog, &nak, &hdr,
-			    "Response argument send error");
-		}
-	}
-	return;
+	return (0);
 
 nak:
+	/*
+	 * The rest of a rejected message is unread, end the connection.
+	 */
 	hdr.UhType = UM_nak;
 	hdr.UhArgSize = sizeof (nak);
-	if (sockWrite(sfd, &hdr, sizeof (hdr)) < 0) {
+	iov[0].iov_base = (caddr_t)&hdr;
+	iov[0].iov_len = sizeof (hdr);
+	iov[1].iov_base = (caddr_t)&nak;
+	iov[1].iov_len = sizeof (nak);
+	if (sockWritev(sfd, iov, 2) < 0) {
 		samlog(srvr->UsLog, &nak, &hdr, "Response send error");
 	}
-	if (sockWrite(sfd, &nak, sizeof (nak)) < 0) {
-		samlog(srvr->UsLog, &nak, &hdr, "Response send error");
+	return (-1);
+}
+
+
+/*
+ * Accept and serve connections.
+ * Several threads may accept on the same socket.
+ * Returns -1 if the accept failed, 0 if the server was stopped.
+ */
+static int
+serveConnections(
+	struct UdsServer *srvr,
+	int sock,
+	char *argbuf)
+{
+	while (!srvr->UsStop) {
+		struct sockaddr_un name;
+		unsigned int len;
+		int ns;
+#if defined(SIM_ERROR)
+		static int msgcount = 0;
+#endif /* defined(SIM_ERROR) */
+
+		/*
+		 * Accept a connection.
+		 * Read and process message.
+		 */
+		len = sizeof (name);
+		if ((ns = accept(sock, (struct sockaddr *)&name, &len)) < 0) {
+			return (-1);
+		}
+
+#if defined(SIM_ERROR)
+		fprintf(stderr, "\rMessage %d ", msgcount);
+		msgcount++;
+#endif /* defined(SIM_ERROR) */
+
+		/*
+		 * A client may send several messages on one connection.
+		 * Serve them until it closes or a message is rejected.
+		 */
+		while (!srvr->UsStop &&
+		    readClientMessage(ns, srvr, argbuf) == 0) {
+			;
+		}
+		(void) close(ns);
 	}
+	return (0);
 }
 
 
+/*
+ * Connection serving thread.
+ * Serves connections with its own argument buffer until the listening
+ * socket is closed.
+ */
+static void *
+serveThread(
+	void *arg)
+{
+	struct ServeArg *sa = (struct ServeArg *)arg;
+	char	*argbuf;
+
+	argbuf = malloc(sa->SaSrvr->UsArgbufSize);
+	if (argbuf != NULL) {
+		(void) serveConnections(sa->SaSrvr, sa->SaSock, argbuf);
+		free(argbuf);
+	}
+	free(sa);
+	return (NULL);
+}
+
 /*
  * Read from socket.
  * Read data and handle an EINTR.
@@ -616,6 +944,52 @@ sockWrite(
 }
 
 
+/*
+ * Write a vector to socket.
+ * Write data, handle an EINTR and short writes.
+ */
+static ssize_t
+sockWritev(
+	int fildes,
+	struct iovec *iov,
+	int iovcnt)
+{
+	ssize_t	total;
+
+	total = 0;
+	while (iovcnt > 0) {
+		ssize_t n;
+
+		errno = 0;
+		n = writev(fildes, iov, (iovcnt > IOV_MAX) ? IOV_MAX : iovcnt);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return (n);
+		}
+		if (n == 0) {
+			break;
+		}
+		total += n;
+
+		/*
+		 * Step over what was written.
+		 */
+		while (iovcnt > 0 && n >= (ssize_t)iov->iov_len) {
+			n -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if (n > 0) {
+			iov->iov_base = (caddr_t)iov->iov_base + n;
+			iov->iov_len -= n;
+		}
+	}
+	return (total);
+}
+
+
 #if defined(TEST)
 /*
  * Test section.
@@ -595,349 +595,7 @@ update_element_status(
 		}
 
 	case STORAGE_ELEMENT:
-		{
-			storage_element_t *storage_descrip;
-			storage_element_ext_t *extension;
-
-			last_element = 0;
-			current_element = library->range.storage_lower;
-
-			while (current_element <=
-			    library->range.storage_upper) {
-				if ((num_eles = library->range.storage_count -
-				    last_element) >
-				    MAX_STORE_STATUS)
-					num_eles = MAX_STORE_STATUS;
-
-		redo_storage:
-				buff_size = num_eles * library->ele_dest_len +
-				    sizeof (element_status_data_t) +
-				    sizeof (element_status_page_t) + 50;
-
-				buffer = malloc_wait(buff_size, 2, 0);
-				if (read_element_status(library, type,
-				    current_element, num_eles,
-				    buffer, buff_size) < 0) {
-					DevLog(DL_ERR(5062));
-					free(buffer);
-					return (1);
-				}
-				status_data = (element_status_data_t *)buffer;
-				BE16toH(&status_data->numb_elements, &count);
-
-				if (count != num_eles) {
-					DevLog(DL_ERR(5063), count, num_eles);
-					num_eles = count;
-				}
-				status_page = (element_status_page_t *)
-				    (buffer + sizeof (element_status_data_t));
-
-				/*
-				 * Check the size of the element and if
-				 * bigger than what we have set asside,
-				 * change the size free the old buffer and
-				 * try again.
-				 */
-				BE16toH(&status_page->ele_dest_len,
-				    &ele_dest_len);
-				if (ele_dest_len > library->ele_dest_len) {
-					library->ele_dest_len = ele_dest_len;
-					free(buffer);
-					goto redo_storage;
-				}
-				last_element += num_eles;
-
-				storage_descrip = (storage_element_t *)
-				    ((char *)status_page +
-				    sizeof (element_status_page_t));
-
-				if (status_page->type_code != STORAGE_ELEMENT) {
-					/* not correct element page */
-					DevLog(DL_ERR(5064),
-					    status_page->type_code);
-					free(buffer);
-					return (1);
-				}
-				for (i = 0; i < num_eles;
-				    i++, storage_descrip = (storage_element_t *)
-				    ((char *)storage_descrip + ele_dest_len)) {
-					struct VolId    vid;
-					ushort_t	ele_addr;
-					uint32_t	status;
-
-					if (ele_dest_len >
-					    sizeof (storage_element_t))
-						extension =
-						    (storage_element_ext_t *)
-						    ((char *)storage_descrip +
-						    sizeof (storage_element_t));
-					else
-						extension = NULL;
-
-					BE16toH(&storage_descrip->ele_addr,
-					    &ele_addr);
-
-					status = 0;
-					vid.ViFlags = VI_cart;
-					vid.ViEq = library->un->eq;
-					vid.ViSlot = SLOT_NUMBER(
-					    library, ele_addr);
-					vid.ViPart = 0;
-
-					/*
-					 * A Plasmon G library can have both
-					 * mo and udo drives and mo and udo
-					 * disks. If the media type on the
-					 * storage element descriptor is
-					 * unknown, set the media type from
-					 * the library.
-					 */
-					if (storage_descrip->full &&
-					    library->un->equ_type ==
-					    DT_PLASMON_G) {
-
-						int	media_offset;
-						int media_type;
-
-						if (status_page->PVol &&
-						    status_page->AVol) {
-							media_offset = 88;
-						} else if (status_page->PVol &&
-						    !status_page->AVol) {
-							media_offset = 52;
-						} else {
-							media_offset = 16;
-						}
-			media_type = ((uint8_t *)storage_descrip)
-			    [media_offset];
-
-					if (media_type ==
-					    PLASMON_MT_UNKNOWN) {
-						sam_syslog(LOG_DEBUG,
-						    "storage element 0x%4.4x,"
-						    "media type unknown\n",
-						    ele_addr);
-					}
-					sam_syslog(LOG_DEBUG,
-					    "storage element 0x%4.4x, "
-					    "media type 0x%2.2x\n",
-					    ele_addr, media_type);
-
-				if (media_type ==
-				    PLASMON_MT_UDO) {
-					memmove(vid.ViMtype,
-					    sam_mediatoa(DT_PLASMON_UDO),
-					    sizeof (vid.ViMtype));
-					if (library->un->media !=
-					    DT_PLASMON_UDO) {
-						status |= CES_bad_media;
-					}
-				} else if (media_type ==
-				    PLASMON_MT_MO) {
-					memmove(vid.ViMtype,
-					    sam_mediatoa(DT_ERASABLE),
-					    sizeof (vid.ViMtype));
-					if (library->un->media !=
-					    DT_ERASABLE) {
-						status |= CES_bad_media;
-					}
-				}
-				} else {
-					memmove(vid.ViMtype,
-					    sam_mediatoa(library->un->media),
-					    sizeof (vid.ViMtype));
-					}
-
-					if (ele_addr == current_element) {
-
-						if (!storage_descrip->access) {
-							status |= CES_unavail;
-							/*
-							 * If Plasmon DVD-RAM
-							 * library, the tray
-							 * for this storage
-							 * element may be in
-							 * a drive so we
-							 * don't want to flag
-							 * slot as
-							 * unavailable.
-							 */
-				/* cstyle indentation */
-				if (library->un->equ_type == DT_PLASMON_D ||
-				    library->un->equ_type ==
-				    DT_PLASMON_G) {
-				drive_state_t *drive = library->drive;
-				/*
-				 * Check for media.
-				 */
-					while (drive != NULL) {
-					/*
-					 * Storage element
-					 * in drive. Clear
-					 * unavailable.
-					 */
-					if (drive->media_element == ele_addr) {
-						status &= ~CES_unavail;
-						break;
-					}
-					drive = drive->next;
-					}
-				}
-				}
-				/*
-				 * The metrum library (D-28)
-				 * returns a 83,2 for code if
-				 * the 7 slot mag is not
-				 * installed. This is not
-				 * documented in the book.
-				 */
-				if (storage_descrip->except &&
-				    extension != NULL) {
-					switch (library->un->equ_type) {
-					case DT_METD28:
-					if (extension->add_sense_code == 0x83 &&
-					    extension->add_sense_qual == 0x02)
-						status |= CES_unavail;
-					break;
-
-					case DT_METD360:
-					if (extension->add_sense_code != 0) {
-						library->status.b.except = TRUE;
-						DevLog(DL_ERR(5065),
-						    extension->add_sense_code,
-						    extension->add_sense_qual);
-						return (0);
-					}
-					break;
-
-					case DT_3570C:
-						/*
-						 * if the
-						 * magazine
-						 * is not
-						 * available
-						 */
-					if (extension->add_sense_code == 0x3b &&
-					    extension->add_sense_qual == 0x11)
-						status |= CES_unavail;
-					break;
-
-					default:
-						break;
-					}
-				}
-				if (storage_descrip->full) {
-				/*
-				 * if occupied, it's
-				 * inuse
-				 */
-					status |= CES_inuse | CES_occupied;
-					if (status_page->PVol &&
-					    extension != NULL) {
-						dtb(&(extension->PVolTag[0]),
-						    BARCODE_LEN);
-						if (is_barcode(extension->PVolTag)) {
-							status |= CES_bar_code;
-						}
-						if (status_page->AVol &&
-					    	(extension->AVolTag[0] != '\0')) {
-							dtb(&(extension->AVolTag[0]),
-							    BARCODE_LEN);
-						}
-					}
-				}
-				}
-				if ((storage_descrip->full) &&
-				    (extension != NULL) &&
-				    (status_page->PVol) &&
-				    (extension->PVolTag[0] != '\0')) {
-					(void) CatalogSlotInit(&vid, status,
-					    (library->status.b.two_sided) ?
-					    2 : 0,
-					    (char *)extension->PVolTag,
-					    (char *)extension->AVolTag);
-				} else {
-					(void) CatalogSlotInit(&vid,
-					    status,
-					    (library->status.b.two_sided) ?
-					    2 : 0, "", "");
-				}
-				if ((library->un->dt.rb.status.b.barcodes) &&
-				    (status & CES_inuse)) {
-					struct CatalogEntry ced;
-					struct CatalogEntry *ce = &ced;
-					int		set_default = 1;
-
-						/*
-						 * If there is a catalog
-						 * entry, and the entry's
-						 * capacity is zero, and not
-						 * set to zero by the user,
-						 * set the capacity to
-						 * default.
-						 *
-						 * Cleaning tape capacity should
-						 * be zero. This code will
-						 * prevent a call to the
-						 * catserver if cleaning tape
-						 * capacity is zero, or set
-						 * it to zero if not.
-						 */
-					if ((ce = CatalogGetEntry(
-					    &vid, &ced)) != NULL) {
-						if ((ce->CeStatus &
-						    CES_capacity_set) ||
-						    (ce->CeCapacity &&
-						    !(ce->CeStatus &
-						    CES_cleaning)) ||
-						    (!ce->CeCapacity &&
-						    (ce->CeStatus &
-						    CES_cleaning))) {
-							set_default = 0;
-						}
-					}
-
-		/* indentation due to cstyle */
-			if (set_default) {
-				int		capacity;
-
-				if (!(ce->CeStatus & CES_cleaning)) {
-					capacity = DEFLT_CAPC(
-					    library->un->media);
-				} else {
-					capacity = 0;
-				}
-				if (library->status.b.two_sided) {
-					vid.ViPart = 1;
-				}
-				(void) CatalogSetFieldByLoc(library->un->eq,
-				    vid.ViSlot, vid.ViPart, CEF_Capacity,
-				    capacity, 0);
-				(void) CatalogSetFieldByLoc(library->un->eq,
-				    vid.ViSlot, vid.ViPart, CEF_Space,
-				    capacity, 0);
-				if (library->status.b.two_sided) {
-					vid.ViPart = 2;
-					(void) CatalogSetFieldByLoc(
-					    library->un->eq,
-					    vid.ViSlot, vid.ViPart,
-					    CEF_Capacity,
-					    capacity, 0);
-					(void) CatalogSetFieldByLoc(
-					    library->un->eq,
-					    vid.ViSlot, vid.ViPart,
-					    CEF_Space,
-					    capacity, 0);
-				}
-			}
-				}
-				current_element++;
-			}
-			free(buffer);
-		}
-
-			break;
-		}
+		return (inventory_storage(library, read_element_status));
 
 	case IMPORT_EXPORT_ELEMENT:
 		{
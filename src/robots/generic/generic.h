@@ -268,6 +268,9 @@ typedef struct library_s {
 	int		inc_free_running;
 }		library_t;
 
+/* Element status reader, read_element_status() or a simulated changer */
+typedef int (*inv_read_t)(library_t *, const int, const int, const int,
+		void *, const int);
 
 
 /* Function Prototypes */
@@ -294,6 +297,7 @@ int		flip_and_scan(int, drive_state_t *);
 int		init_elements(library_t *);
 int		initialize(library_t *, dev_ptr_tbl_t *);
 int		re_init_library(library_t *);
+int		inventory_storage(library_t *, inv_read_t);
 int		is_barcode(void *);
 int		is_cleaning(void *);
 int		is_flip_requested(library_t *, drive_state_t *);
@@ -0,0 +1,686 @@
+/*
+ * inventory.c - bulk inventory of the storage elements.
+ *
+ * The storage elements are read with as few READ ELEMENT STATUS commands
+ * as the library and the transfer size allow.  A reader thread issues
+ * the commands into a pair of buffers while the caller parses the other
+ * one.  The parsed slots are compared with the catalog, and only the
+ * slots that differ are sent to the catalog server, in one batch.
+ */
+
+/*
+ *    SAM-QFS_notice_begin
+ *
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at pkg/OPENSOLARIS.LICENSE
+ * or https://illumos.org/license/CDDL.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at pkg/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+/*
+ * Copyright 2009 Sun Microsystems, Inc.  All rights reserved.
+ * Use is subject to license terms.
+ *
+ *    SAM-QFS_notice_end
+ */
+
+#pragma ident "$Revision: 1.1 $"
+
+/* Using __FILE__ makes duplicate strings */
+static char *_SrcFile = __FILE__;
+
+#include <thread.h>
+#include <synch.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <syslog.h>
+#include <sys/types.h>
+
+#include "driver/samst_def.h"
+#include "sam/types.h"
+#include "aml/external_data.h"
+#include "sam/param.h"
+#include "aml/device.h"
+#include "aml/scsi.h"
+#include "aml/shm.h"
+#include "aml/robots.h"
+#include "aml/tapes.h"
+#include "sam/defaults.h"
+#include "sam/nl_samfs.h"
+#include "generic.h"
+#include "element.h"
+#include "aml/dev_log.h"
+#include "aml/proto.h"
+#include "sam/lib.h"
+#include "aml/catalog.h"
+#include "aml/catlib.h"
+
+#define	INV_BUFFERS	2		/* Buffers read ahead of the parser */
+#define	INV_MAX_BYTES	(128 * 1024)	/* Largest element status transfer */
+
+/* One READ ELEMENT STATUS response. */
+typedef struct inv_buf {
+	char		*data;
+	int		size;		/* Size of data */
+	uint_t		start;		/* First element requested */
+	int		count;		/* Elements returned */
+	int		ele_dest_len;	/* Length of an element descriptor */
+	int		status;		/* 0 ok, 1 all read, -1 error */
+} inv_buf_t;
+
+/* Inventory state. */
+typedef struct inventory {
+	library_t	*library;
+	inv_read_t	read;		/* Element status reader */
+	uint_t		next;		/* Next element to read */
+	int		chunk;		/* Elements per command */
+	int		commands;	/* Commands issued */
+	mutex_t		mutex;
+	cond_t		condit;
+	inv_buf_t	buf[INV_BUFFERS];
+	int		in;		/* Buffers read */
+	int		out;		/* Buffers parsed */
+	boolean_t	stop;		/* Parser stopped */
+	struct CatalogSlotUpdate *slots; /* Slots parsed */
+	int		numof;
+	int		size;
+} inventory_t;
+
+static void inv_fill(inventory_t *inv, inv_buf_t *b);
+static int inv_parse(inventory_t *inv, inv_buf_t *b);
+static void *inv_reader(void *arg);
+static boolean_t inv_unchanged(library_t *library,
+		struct CatalogSlotUpdate *cs);
+static void inv_set_capacity(library_t *library,
+		struct CatalogSlotUpdate *slots, int numof);
+
+
+/*
+ *	inventory_storage - read the status of all storage elements
+ * and update the catalog.
+ *
+ * entry -
+ *	  library - library_t *
+ *	  read - element status reader, read_element_status() unless the
+ *		 changer is simulated.
+ *
+ * exit -
+ *	  0 = ok
+ *	  1 = failure
+ */
+int
+inventory_storage(
+library_t *library,
+inv_read_t read)
+{
+	dev_ent_t	*un;
+	inventory_t	inv;
+	thread_t	reader;
+	struct CatalogSlotUpdate *updates;
+	boolean_t	threaded;
+	int		changed, i, n;
+	int		err = 0;
+
+	SANITY_CHECK(library != (library_t *)0);
+	un = library->un;
+	SANITY_CHECK(un != (dev_ent_t *)0);
+
+	memset(&inv, 0, sizeof (inv));
+	inv.library = library;
+	inv.read = read;
+	inv.next = library->range.storage_lower;
+	inv.chunk = INV_MAX_BYTES / library->ele_dest_len;
+	if (inv.chunk < MAX_STORE_STATUS)
+		inv.chunk = MAX_STORE_STATUS;
+	if (inv.chunk > 0xffff)
+		inv.chunk = 0xffff;
+	inv.size = library->range.storage_count;
+	inv.slots = (struct CatalogSlotUpdate *)malloc_wait(
+	    inv.size * sizeof (struct CatalogSlotUpdate), 2, 0);
+	(void) mutex_init(&inv.mutex, USYNC_THREAD, NULL);
+	(void) cond_init(&inv.condit, USYNC_THREAD, NULL);
+
+	/*
+	 * Parse each response while the next one is read.
+	 * Without the reader thread, read and parse in turn.
+	 */
+	threaded = (thr_create(NULL, SM_THR_STK, &inv_reader, (void *)&inv,
+	    THR_BOUND, &reader) == 0);
+	if (!threaded)
+		DevLog(DL_SYSERR(5117));
+
+	for (;;) {
+		inv_buf_t	*b;
+
+		if (threaded) {
+			mutex_lock(&inv.mutex);
+			while (inv.in == inv.out)
+				cond_wait(&inv.condit, &inv.mutex);
+			b = &inv.buf[inv.out % INV_BUFFERS];
+			mutex_unlock(&inv.mutex);
+		} else {
+			b = &inv.buf[0];
+			inv_fill(&inv, b);
+		}
+		if (b->status != 0) {
+			if (b->status < 0)
+				err = 1;
+			break;
+		}
+		n = inv_parse(&inv, b);
+
+		mutex_lock(&inv.mutex);
+		inv.out++;
+		if (n < 0)
+			inv.stop = TRUE;
+		cond_broadcast(&inv.condit);
+		mutex_unlock(&inv.mutex);
+		if (n < 0)
+			break;
+	}
+	if (threaded)
+		thr_join(reader, (void *) NULL, (void *) NULL);
+	for (i = 0; i < INV_BUFFERS; i++) {
+		if (inv.buf[i].data != NULL)
+			free(inv.buf[i].data);
+	}
+
+	/*
+	 * Send the slots that differ from the catalog.
+	 * After a failed read the slots read are still sent, as the
+	 * element by element update did.
+	 */
+	updates = (struct CatalogSlotUpdate *)malloc_wait(
+	    (inv.numof + 1) * sizeof (struct CatalogSlotUpdate), 2, 0);
+	changed = 0;
+	for (i = 0; i < inv.numof; i++) {
+		if (!inv_unchanged(library, &inv.slots[i])) {
+			updates[changed++] = inv.slots[i];
+		}
+	}
+	sam_syslog(LOG_DEBUG, "Inventory: %d storage elements, %d commands,"
+	    " %d changed", inv.numof, inv.commands, changed);
+
+	/*
+	 * The batch is not atomic, the catalog server applies each slot
+	 * as it arrives.  A slot that failed, or was not sent after the
+	 * batch stopped, still differs from the catalog and is sent
+	 * again by the next inventory.
+	 */
+	if (CatalogSlotInitList(updates, changed) != 0) {
+		n = 0;
+		for (i = 0; i < changed; i++) {
+			if (updates[i].CsStatus != 0)
+				n++;
+		}
+		sam_syslog(LOG_INFO, "Inventory: %d of %d slot updates"
+		    " failed", n, changed);
+	}
+	free(updates);
+
+	if (library->un->dt.rb.status.b.barcodes)
+		inv_set_capacity(library, inv.slots, inv.numof);
+	free(inv.slots);
+
+	(void) cond_destroy(&inv.condit);
+	(void) mutex_destroy(&inv.mutex);
+	if (err)
+		DevLog(DL_ERR(5062));
+	return (err);
+}
+
+
+/*
+ *	inv_reader - read the element status ahead of the parser.
+ */
+static void *
+inv_reader(
+void *arg)
+{
+	inventory_t	*inv = (inventory_t *)arg;
+
+	for (;;) {
+		inv_buf_t	*b;
+
+		mutex_lock(&inv->mutex);
+		while (!inv->stop && inv->in - inv->out >= INV_BUFFERS)
+			cond_wait(&inv->condit, &inv->mutex);
+		if (inv->stop) {
+			mutex_unlock(&inv->mutex);
+			break;
+		}
+		b = &inv->buf[inv->in % INV_BUFFERS];
+		mutex_unlock(&inv->mutex);
+
+		inv_fill(inv, b);
+
+		mutex_lock(&inv->mutex);
+		inv->in++;
+		cond_broadcast(&inv->condit);
+		mutex_unlock(&inv->mutex);
+		if (b->status != 0)
+			break;
+	}
+	return (NULL);
+}
+
+
+/*
+ *	inv_fill - read the status of the next range of storage elements.
+ * If the library rejects a large range, fall back to MAX_STORE_STATUS
+ * elements per command.
+ */
+static void
+inv_fill(
+inventory_t *inv,
+inv_buf_t *b)
+{
+	library_t	*library = inv->library;
+	dev_ent_t	*un = library->un;
+	element_status_data_t *status_data;
+	element_status_page_t *status_page;
+	uint16_t	count, ele_dest_len;
+	int		num_eles, buff_size;
+
+	if (inv->next > library->range.storage_upper) {
+		b->status = 1;
+		return;
+	}
+
+redo_storage:
+	num_eles = library->range.storage_upper - inv->next + 1;
+	if (num_eles > inv->chunk)
+		num_eles = inv->chunk;
+	buff_size = num_eles * library->ele_dest_len +
+	    sizeof (element_status_data_t) +
+	    sizeof (element_status_page_t) + 50;
+	if (b->size < buff_size) {
+		if (b->data != NULL)
+			free(b->data);
+		b->data = malloc_wait(buff_size, 2, 0);
+		b->size = buff_size;
+	}
+
+	inv->commands++;
+	if (inv->read(library, STORAGE_ELEMENT, inv->next, num_eles,
+	    b->data, buff_size) < 0) {
+		if (inv->chunk > MAX_STORE_STATUS) {
+			sam_syslog(LOG_DEBUG, "Inventory: %d elements per"
+			    " command failed, using %d", inv->chunk,
+			    MAX_STORE_STATUS);
+			inv->chunk = MAX_STORE_STATUS;
+			goto redo_storage;
+		}
+		b->status = -1;
+		return;
+	}
+
+	status_data = (element_status_data_t *)b->data;
+	BE16toH(&status_data->numb_elements, &count);
+	status_page = (element_status_page_t *)
+	    (b->data + sizeof (element_status_data_t));
+
+	/*
+	 * Check the size of the element and if bigger than what we
+	 * have set aside, change the size and try again.
+	 */
+	BE16toH(&status_page->ele_dest_len, &ele_dest_len);
+	if (ele_dest_len > library->ele_dest_len) {
+		library->ele_dest_len = ele_dest_len;
+		goto redo_storage;
+	}
+	if (status_page->type_code != STORAGE_ELEMENT) {
+		/* not correct element page */
+		DevLog(DL_ERR(5064), status_page->type_code);
+		b->status = -1;
+		return;
+	}
+	if (count != num_eles) {
+		DevLog(DL_ERR(5063), count, num_eles);
+		if (count == 0 || count > num_eles) {
+			b->status = -1;
+			return;
+		}
+	}
+	b->start = inv->next;
+	b->count = count;
+	b->ele_dest_len = ele_dest_len;
+	b->status = 0;
+	inv->next += count;
+}
+
+
+/*
+ *	inv_parse - parse the storage element descriptors of a response
+ * into catalog slot updates.
+ *
+ * exit -
+ *	  0 = ok
+ *	 -1 = stop, the library reported an exception.
+ */
+static int
+inv_parse(
+inventory_t *inv,
+inv_buf_t *b)
+{
+	library_t	*library = inv->library;
+	dev_ent_t	*un = library->un;
+	element_status_page_t *status_page;
+	storage_element_t *storage_descrip;
+	storage_element_ext_t *extension;
+	uint_t		current_element;
+	int		i;
+
+	status_page = (element_status_page_t *)
+	    (b->data + sizeof (element_status_data_t));
+	storage_descrip = (storage_element_t *)
+	    ((char *)status_page + sizeof (element_status_page_t));
+	current_element = b->start;
+
+	for (i = 0; i < b->count && inv->numof < inv->size;
+	    i++, current_element++,
+	    storage_descrip = (storage_element_t *)
+	    ((char *)storage_descrip + b->ele_dest_len)) {
+		struct CatalogSlotUpdate *cs;
+		ushort_t	ele_addr;
+		uint32_t	status;
+
+		if (b->ele_dest_len > sizeof (storage_element_t))
+			extension = (storage_element_ext_t *)
+			    ((char *)storage_descrip +
+			    sizeof (storage_element_t));
+		else
+			extension = NULL;
+
+		BE16toH(&storage_descrip->ele_addr, &ele_addr);
+
+		cs = &inv->slots[inv->numof];
+		memset(cs, 0, sizeof (struct CatalogSlotUpdate));
+		cs->CsVid.ViFlags = VI_cart;
+		cs->CsVid.ViEq = library->un->eq;
+		cs->CsVid.ViSlot = SLOT_NUMBER(library, ele_addr);
+		cs->CsTwoSided = (library->status.b.two_sided) ? 2 : 0;
+		status = 0;
+
+		/*
+		 * A Plasmon G library can have both mo and udo drives and
+		 * mo and udo disks.  Take the media type from the storage
+		 * element descriptor.
+		 */
+		memmove(cs->CsVid.ViMtype, sam_mediatoa(library->un->media),
+		    sizeof (cs->CsVid.ViMtype));
+		if (storage_descrip->full &&
+		    library->un->equ_type == DT_PLASMON_G) {
+			int	media_offset;
+			int	media_type;
+
+			if (status_page->PVol && status_page->AVol)
+				media_offset = 88;
+			else if (status_page->PVol && !status_page->AVol)
+				media_offset = 52;
+			else
+				media_offset = 16;
+			media_type = ((uint8_t *)storage_descrip)[media_offset];
+
+			if (media_type == PLASMON_MT_UDO) {
+				memmove(cs->CsVid.ViMtype,
+				    sam_mediatoa(DT_PLASMON_UDO),
+				    sizeof (cs->CsVid.ViMtype));
+				if (library->un->media != DT_PLASMON_UDO)
+					status |= CES_bad_media;
+			} else if (media_type == PLASMON_MT_MO) {
+				memmove(cs->CsVid.ViMtype,
+				    sam_mediatoa(DT_ERASABLE),
+				    sizeof (cs->CsVid.ViMtype));
+				if (library->un->media != DT_ERASABLE)
+					status |= CES_bad_media;
+			} else {
+				sam_syslog(LOG_DEBUG,
+				    "storage element 0x%4.4x, "
+				    "media type 0x%2.2x\n",
+				    ele_addr, media_type);
+			}
+		}
+
+		if (ele_addr == current_element) {
+			if (!storage_descrip->access) {
+				status |= CES_unavail;
+
+				/*
+				 * If Plasmon library, the tray for this
+				 * storage element may be in a drive so we
+				 * don't want to flag slot as unavailable.
+				 */
+				if (library->un->equ_type == DT_PLASMON_D ||
+				    library->un->equ_type == DT_PLASMON_G) {
+					drive_state_t *drive;
+
+					for (drive = library->drive;
+					    drive != NULL;
+					    drive = drive->next) {
+						if (drive->media_element ==
+						    ele_addr) {
+							status &= ~CES_unavail;
+							break;
+						}
+					}
+				}
+			}
+
+			/*
+			 * The metrum library (D-28) returns a 83,2 for code
+			 * if the 7 slot mag is not installed.  This is not
+			 * documented in the book.
+			 */
+			if (storage_descrip->except && extension != NULL) {
+				uchar_t asc = extension->add_sense_code;
+				uchar_t ascq = extension->add_sense_qual;
+
+				switch (library->un->equ_type) {
+				case DT_METD28:
+					if (asc == 0x83 && ascq == 0x02)
+						status |= CES_unavail;
+					break;
+
+				case DT_METD360:
+					if (asc != 0) {
+						library->status.b.except = TRUE;
+						DevLog(DL_ERR(5065), asc, ascq);
+						return (-1);
+					}
+					break;
+
+				case DT_3570C:
+					/* if the magazine is not available */
+					if (asc == 0x3b && ascq == 0x11)
+						status |= CES_unavail;
+					break;
+
+				default:
+					break;
+				}
+			}
+
+			if (storage_descrip->full) {
+				/* if occupied, it's inuse */
+				status |= CES_inuse | CES_occupied;
+				if (status_page->PVol && extension != NULL) {
+					dtb(&(extension->PVolTag[0]),
+					    BARCODE_LEN);
+					if (is_barcode(extension->PVolTag))
+						status |= CES_bar_code;
+					if (status_page->AVol &&
+					    extension->AVolTag[0] != '\0')
+						dtb(&(extension->AVolTag[0]),
+						    BARCODE_LEN);
+				}
+			}
+		}
+
+		if (storage_descrip->full && extension != NULL &&
+		    status_page->PVol && extension->PVolTag[0] != '\0') {
+			memmove(cs->CsBarCode, extension->PVolTag,
+			    BARCODE_LEN);
+			memmove(cs->CsAltBarCode, extension->AVolTag,
+			    BARCODE_LEN);
+		}
+		cs->CsCatStatus = status;
+		inv->numof++;
+	}
+	return (0);
+}
+
+
+/*
+ *	inv_unchanged - check if a slot update would change the catalog.
+ * Two sided media is always updated, as is a slot the catalog server
+ * would complete: a bar code to label, or a new cleaning cartridge.
+ */
+static boolean_t
+inv_unchanged(
+library_t *library,
+struct CatalogSlotUpdate *cs)
+{
+	struct CatalogEntry ced;
+	struct CatalogEntry *ce;
+	uint32_t	mask;
+
+	if (library->status.b.two_sided)
+		return (FALSE);
+	ce = CatalogGetCeByLoc(cs->CsVid.ViEq, cs->CsVid.ViSlot, 0, &ced);
+
+	if (!(cs->CsCatStatus & CES_inuse)) {
+		/*
+		 * Empty slot.  The catalog server only marks the entry
+		 * for the slot to be reconciled.
+		 */
+		return (ce == NULL || (ce->CeStatus & CES_reconcile));
+	}
+	if (ce == NULL ||
+	    strcmp(ce->CeMtype, cs->CsVid.ViMtype) != 0 ||
+	    strcmp(ce->CeBarCode, cs->CsBarCode) != 0) {
+		return (FALSE);
+	}
+	if (*cs->CsBarCode != '\0') {
+		struct CatalogEntry ceb;
+		int	cleaning;
+
+		/*
+		 * The bar code must not also be cataloged in another slot.
+		 */
+		if (CatalogGetCeByBarCode(cs->CsVid.ViEq, cs->CsVid.ViMtype,
+		    cs->CsBarCode, &ceb) == NULL ||
+		    ceb.CeSlot != cs->CsVid.ViSlot) {
+			return (FALSE);
+		}
+
+		/*
+		 * The catalog server sets the VSN from the bar code if
+		 * label = barcode, and marks a cleaning cartridge.
+		 */
+		if ((GetDefaults()->flags & DF_LABEL_BARCODE) &&
+		    *ce->CeVsn == '\0') {
+			return (FALSE);
+		}
+		cleaning = memcmp(cs->CsBarCode, CLEANING_BAR_CODE,
+		    CLEANING_BAR_LEN) == 0 ||
+		    memcmp(cs->CsBarCode, CLEANING_FULL_CODE,
+		    CLEANING_FULL_LEN) == 0;
+		if (cleaning && !(ce->CeStatus & CES_cleaning)) {
+			return (FALSE);
+		}
+	}
+
+	/*
+	 * Status as the catalog server would set it.
+	 */
+	mask = CES_inuse | CES_occupied | CES_bar_code | CES_reconcile;
+	if ((ce->CeStatus & mask) != (cs->CsCatStatus & mask) ||
+	    (cs->CsCatStatus & ~ce->CeStatus) != 0) {
+		return (FALSE);
+	}
+	if (*ce->CeVsn == '\0') {
+		return ((ce->CeStatus & (CES_labeled | CES_needs_audit)) ==
+		    CES_needs_audit);
+	}
+	return ((ce->CeStatus & (CES_labeled | CES_needs_audit)) ==
+	    CES_labeled);
+}
+
+
+/*
+ *	inv_set_capacity - set the default capacity of the occupied slots.
+ *
+ * If there is a catalog entry, and the entry's capacity is zero, and
+ * not set to zero by the user, set the capacity to default.  Cleaning
+ * tape capacity should be zero.  The changes are sent in one batch.
+ */
+static void
+inv_set_capacity(
+library_t *library,
+struct CatalogSlotUpdate *slots,
+int numof)
+{
+	struct CatalogFieldUpdate *cfu;
+	int		i, n;
+
+	cfu = (struct CatalogFieldUpdate *)malloc_wait(
+	    (4 * numof + 1) * sizeof (struct CatalogFieldUpdate), 2, 0);
+
+	n = 0;
+	for (i = 0; i < numof; i++) {
+		struct CatalogSlotUpdate *cs = &slots[i];
+		struct CatalogEntry ced;
+		struct CatalogEntry *ce;
+		int	capacity;
+		int	part;
+
+		if (!(cs->CsCatStatus & CES_inuse))
+			continue;
+		ce = CatalogGetEntry(&cs->CsVid, &ced);
+		if (ce != NULL &&
+		    ((ce->CeStatus & CES_capacity_set) ||
+		    (ce->CeCapacity && !(ce->CeStatus & CES_cleaning)) ||
+		    (!ce->CeCapacity && (ce->CeStatus & CES_cleaning)))) {
+			continue;
+		}
+		if (ce != NULL && (ce->CeStatus & CES_cleaning))
+			capacity = 0;
+		else
+			capacity = DEFLT_CAPC(library->un->media);
+
+		for (part = (library->status.b.two_sided) ? 1 : 0;
+		    part <= ((library->status.b.two_sided) ? 2 : 0); part++) {
+			memset(&cfu[n], 0,
+			    2 * sizeof (struct CatalogFieldUpdate));
+			cfu[n].CfVid = cs->CsVid;
+			cfu[n].CfVid.ViPart = part;
+			if (part != 0)
+				cfu[n].CfVid.ViFlags |= VI_part;
+			cfu[n + 1].CfVid = cfu[n].CfVid;
+			cfu[n].CfField = CEF_Capacity;
+			cfu[n].CfValue = capacity;
+			cfu[n + 1].CfField = CEF_Space;
+			cfu[n + 1].CfValue = capacity;
+			n += 2;
+		}
+	}
+	if (n > 0)
+		(void) CatalogSetFieldList(cfu, n);
+	free(cfu);
+}
@@ -0,0 +1,408 @@
+/*
+ * invsim.c - drive the storage element inventory with a simulated changer.
+ *
+ * invsim eq
+ *
+ * Runs inventory_storage() for the catalog of library 'eq' with the
+ * element status of a simulated changer instead of the library.  The
+ * changer has one storage element for each slot of the catalog and
+ * starts with the cartridges as cataloged.
+ *
+ * Each pass changes the simulated slots or the catalog, runs the
+ * inventory, and saves the catalog entries.  It then sends every slot
+ * to the catalog server, as the inventory did before it reconciled by
+ * difference, and compares the entries.  An entry that differs is a
+ * slot the inventory should have sent.
+ *
+ * The catalog entries of the library are changed.  Use a library that
+ * is not in production use, with at least four barcoded cartridges.
+ */
+
+/*
+ *    SAM-QFS_notice_begin
+ *
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at pkg/OPENSOLARIS.LICENSE
+ * or https://illumos.org/license/CDDL.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at pkg/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+/*
+ * Copyright 2009 Sun Microsystems, Inc.  All rights reserved.
+ * Use is subject to license terms.
+ *
+ *    SAM-QFS_notice_end
+ */
+
+#pragma ident "$Revision: 1.1 $"
+
+static char *_SrcFile = __FILE__;   /* Using __FILE__ makes duplicate strings */
+
+#include <thread.h>
+#include <synch.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "driver/samst_def.h"
+#include "sam/types.h"
+#include "aml/external_data.h"
+#include "sam/param.h"
+#include "aml/device.h"
+#include "aml/scsi.h"
+#include "aml/shm.h"
+#include "aml/robots.h"
+#include "sam/defaults.h"
+#include "sam/custmsg.h"
+#include "sam/exit.h"
+#include "generic.h"
+#include "element.h"
+#include "aml/proto.h"
+#include "sam/lib.h"
+#include "aml/catalog.h"
+#include "aml/catlib.h"
+
+#define	SIM_ELEMENT	0x400	/* Element address of the first slot */
+#define	SIM_DESCRIP_LEN	(sizeof (storage_element_t) + \
+	sizeof (storage_element_ext_t))
+
+/* Simulated storage element. */
+typedef struct sim_slot {
+	int		full;
+	char		barcode[BARCODE_LEN + 1];
+} sim_slot_t;
+
+char		*program_name = "invsim";
+shm_alloc_t	master_shm, preview_shm;
+
+static dev_ent_t	sim_un;
+static library_t	sim_library;
+static sim_slot_t	*sim_slots;
+static struct CatalogEntry *saved;
+static int		sim_eq;
+static int		sim_numof;
+
+static int	sim_read(library_t *library, const int type, const int start,
+		const int count, void *buf, const int size);
+static void	sim_save(void);
+static int	sim_check(char *name);
+static int	sim_find(int skip);
+
+
+int
+main(
+int argc,
+char **argv)
+{
+	struct CatalogEntry *entries;
+	int		a, b, c, d;
+	int		errors;
+	int		i, numof;
+
+	if (argc != 2) {
+		fprintf(stderr, "usage: %s eq\n", argv[0]);
+		exit(EXIT_USAGE);
+	}
+	sim_eq = atoi(argv[1]);
+	if (CatalogInit(program_name) == -1) {
+		LibFatal(CatalogInit, "");
+	}
+	entries = CatalogGetEntriesByLibrary(sim_eq, &numof);
+	if (entries == NULL || numof == 0) {
+		fprintf(stderr, "No catalog entries for eq %d\n", sim_eq);
+		exit(EXIT_FAILURE);
+	}
+
+	/*
+	 * One storage element for each slot, cartridges as cataloged.
+	 */
+	sim_numof = 0;
+	for (i = 0; i < numof; i++) {
+		if (entries[i].CeSlot != ROBOT_NO_SLOT &&
+		    entries[i].CeSlot >= sim_numof)
+			sim_numof = entries[i].CeSlot + 1;
+	}
+	sim_slots = (sim_slot_t *)calloc(sim_numof, sizeof (sim_slot_t));
+	saved = (struct CatalogEntry *)calloc(sim_numof,
+	    sizeof (struct CatalogEntry));
+	if (sim_slots == NULL || saved == NULL) {
+		perror("calloc");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < numof; i++) {
+		struct CatalogEntry *ce = &entries[i];
+
+		if (ce->CeSlot == ROBOT_NO_SLOT ||
+		    !(ce->CeStatus & CES_occupied))
+			continue;
+		sim_slots[ce->CeSlot].full = TRUE;
+		strncpy(sim_slots[ce->CeSlot].barcode, ce->CeBarCode,
+		    BARCODE_LEN);
+	}
+
+	sim_un.eq = sim_eq;
+	sim_un.media = sam_atomedia(entries[0].CeMtype);
+	sim_un.dt.rb.status.b.barcodes = TRUE;
+	sim_library.un = &sim_un;
+	sim_library.ele_dest_len = SIM_DESCRIP_LEN;
+	sim_library.range.storage_lower = SIM_ELEMENT;
+	sim_library.range.storage_count = sim_numof;
+	sim_library.range.storage_upper = SIM_ELEMENT + sim_numof - 1;
+
+	/* Cartridges changed by the passes. */
+	a = sim_find(-1);
+	b = sim_find(a);
+	c = sim_find(b);
+	d = sim_find(c);
+	if (a < 0 || b < 0 || c < 0 || d < 0) {
+		fprintf(stderr, "Need four barcoded cartridges in eq %d\n",
+		    sim_eq);
+		exit(EXIT_FAILURE);
+	}
+	printf("%d slots, label = barcode %s\n", sim_numof,
+	    (GetDefaults()->flags & DF_LABEL_BARCODE) ? "on" : "off");
+
+	errors = sim_check("as cataloged");
+	errors += sim_check("no change");
+
+	/* Swap two cartridges and empty two slots. */
+	{
+		sim_slot_t	tmp;
+
+		tmp = sim_slots[a];
+		sim_slots[a] = sim_slots[b];
+		sim_slots[b] = tmp;
+	}
+	memset(&sim_slots[c], 0, sizeof (sim_slot_t));
+	memset(&sim_slots[d], 0, sizeof (sim_slot_t));
+	errors += sim_check("swap and empty");
+
+	/* A cleaning cartridge, then its entry not marked cleaning. */
+	sim_slots[c].full = TRUE;
+	snprintf(sim_slots[c].barcode, sizeof (sim_slots[c].barcode),
+	    "%s%05d", CLEANING_BAR_CODE, (int)getpid() % 100000);
+	errors += sim_check("cleaning cartridge");
+	(void) CatalogSetFieldByLoc(sim_eq, c, 0, CEF_Status, 0,
+	    CES_cleaning);
+	errors += sim_check("cleaning not marked");
+
+	/* A new cartridge, then its entry without a VSN. */
+	sim_slots[d].full = TRUE;
+	snprintf(sim_slots[d].barcode, sizeof (sim_slots[d].barcode),
+	    "INV%05d", (int)getpid() % 100000);
+	errors += sim_check("new cartridge");
+	(void) CatalogSetStringByLoc(sim_eq, d, 0, CEF_Vsn, "");
+	(void) CatalogSetFieldByLoc(sim_eq, d, 0, CEF_Status,
+	    CES_needs_audit, CES_needs_audit | CES_labeled);
+	errors += sim_check("no VSN");
+
+	CatalogTerm();
+	printf("%d errors\n", errors);
+	return ((errors == 0) ? EXIT_SUCCESS : EXIT_FAILURE);
+}
+
+
+/*
+ *	slot_number - slot of a simulated storage element.
+ */
+uint_t
+slot_number(
+library_t *library,
+const uint_t element)
+{
+	if (element >= library->range.storage_lower &&
+	    element <= library->range.storage_upper)
+		return (element - library->range.storage_lower);
+	return (ROBOT_NO_SLOT);
+}
+
+
+/*
+ *	sim_read - element status of the simulated storage elements.
+ */
+static int
+sim_read(
+library_t *library,
+const int type,
+const int start,
+const int count,
+void *buf,
+const int size)
+{
+	element_status_data_t *status_data;
+	element_status_page_t *status_page;
+	char		*p;
+	uint16_t	val16;
+	uint32_t	val32;
+	int		i;
+
+	if (type != STORAGE_ELEMENT ||
+	    start < library->range.storage_lower ||
+	    start + count - 1 > library->range.storage_upper ||
+	    size < sizeof (element_status_data_t) +
+	    sizeof (element_status_page_t) + count * SIM_DESCRIP_LEN)
+		return (-1);
+
+	memset(buf, 0, size);
+	status_data = (element_status_data_t *)buf;
+	val16 = start;
+	HtoBE16(&val16, status_data->first_ele_addr);
+	val16 = count;
+	HtoBE16(&val16, status_data->numb_elements);
+	val32 = sizeof (element_status_page_t) + count * SIM_DESCRIP_LEN;
+	HtoBE24(&val32, status_data->count);
+
+	status_page = (element_status_page_t *)(status_data + 1);
+	status_page->type_code = STORAGE_ELEMENT;
+	status_page->PVol = 1;
+	val16 = SIM_DESCRIP_LEN;
+	HtoBE16(&val16, status_page->ele_dest_len);
+	val32 = count * SIM_DESCRIP_LEN;
+	HtoBE24(&val32, status_page->count);
+
+	p = (char *)(status_page + 1);
+	for (i = 0; i < count; i++, p += SIM_DESCRIP_LEN) {
+		storage_element_t *descrip = (storage_element_t *)p;
+		storage_element_ext_t *ext = (storage_element_ext_t *)
+		    (descrip + 1);
+		sim_slot_t *ss;
+
+		ss = &sim_slots[start + i - library->range.storage_lower];
+		val16 = start + i;
+		HtoBE16(&val16, descrip->ele_addr);
+		descrip->access = 1;
+		if (ss->full) {
+			descrip->full = 1;
+
+			/* Volume tags are blank filled. */
+			memset(ext->PVolTag, ' ', BARCODE_LEN);
+			memmove(ext->PVolTag, ss->barcode,
+			    strlen(ss->barcode));
+		}
+	}
+	return (0);
+}
+
+
+/*
+ *	sim_save - save the catalog entries of the slots.
+ */
+static void
+sim_save(void)
+{
+	int		i;
+
+	for (i = 0; i < sim_numof; i++) {
+		if (CatalogGetCeByLoc(sim_eq, i, 0, &saved[i]) == NULL)
+			memset(&saved[i], 0, sizeof (struct CatalogEntry));
+	}
+}
+
+
+/*
+ *	sim_check - run the inventory and compare the catalog with all
+ * slots sent.
+ *
+ * exit -
+ *	  number of entries that differ
+ */
+static int
+sim_check(
+char *name)
+{
+	struct CatalogSlotUpdate *csu;
+	int		errors;
+	int		i;
+
+	if (inventory_storage(&sim_library, sim_read) != 0) {
+		printf("%-20s inventory failed\n", name);
+		return (1);
+	}
+	sim_save();
+
+	/*
+	 * Every slot, as parsed by the inventory.
+	 */
+	csu = (struct CatalogSlotUpdate *)calloc(sim_numof,
+	    sizeof (struct CatalogSlotUpdate));
+	if (csu == NULL) {
+		perror("calloc");
+		exit(EXIT_FAILURE);
+	}
+	for (i = 0; i < sim_numof; i++) {
+		csu[i].CsVid.ViFlags = VI_cart;
+		csu[i].CsVid.ViEq = sim_eq;
+		csu[i].CsVid.ViSlot = i;
+		memmove(csu[i].CsVid.ViMtype, sam_mediatoa(sim_un.media),
+		    sizeof (csu[i].CsVid.ViMtype));
+		if (sim_slots[i].full) {
+			csu[i].CsCatStatus = CES_inuse | CES_occupied;
+			if (*sim_slots[i].barcode != '\0')
+				csu[i].CsCatStatus |= CES_bar_code;
+			strncpy(csu[i].CsBarCode, sim_slots[i].barcode,
+			    BARCODE_LEN);
+		}
+	}
+	(void) CatalogSlotInitList(csu, sim_numof);
+	free(csu);
+
+	errors = 0;
+	for (i = 0; i < sim_numof; i++) {
+		struct CatalogEntry ced;
+		struct CatalogEntry *ce;
+		struct CatalogEntry *sv = &saved[i];
+
+		ce = CatalogGetCeByLoc(sim_eq, i, 0, &ced);
+		if (ce == NULL) {
+			memset(&ced, 0, sizeof (ced));
+			ce = &ced;
+		}
+		if (ce->CeStatus == sv->CeStatus &&
+		    ce->CeCapacity == sv->CeCapacity &&
+		    ce->CeSpace == sv->CeSpace &&
+		    ce->CeAccess == sv->CeAccess &&
+		    strcmp(ce->CeVsn, sv->CeVsn) == 0 &&
+		    strcmp(ce->CeBarCode, sv->CeBarCode) == 0 &&
+		    strcmp(ce->CeMtype, sv->CeMtype) == 0)
+			continue;
+		printf("%-20s slot %d: inventory %08x '%s' '%s',"
+		    " all slots %08x '%s' '%s'\n", name, i,
+		    sv->CeStatus, sv->CeVsn, sv->CeBarCode,
+		    ce->CeStatus, ce->CeVsn, ce->CeBarCode);
+		errors++;
+	}
+	printf("%-20s %s\n", name, (errors == 0) ? "ok" : "FAILED");
+	return (errors);
+}
+
+
+/*
+ *	sim_find - find a slot after 'skip' that is full with a bar code.
+ */
+static int
+sim_find(
+int skip)
+{
+	int		i;
+
+	for (i = skip + 1; i < sim_numof; i++) {
+		if (sim_slots[i].full && *sim_slots[i].barcode != '\0')
+			return (i);
+	}
+	return (-1);
+}
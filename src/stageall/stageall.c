@@ -93,6 +93,7 @@ static struct {
 
 /* Private functions. */
 static void process_directory(struct stageall_entry *sp);
+static void stage_list(sam_fileop_t *list, int count);
 
 /* Signal catching functions. */
 static void sig_child(int sig);
@@ -287,6 +288,7 @@ char *argv[])
 
 /*
  * Process individual stageall directory.
+ * The files are staged SAM_FILEOPS_LIST_MAX at a time.
  */
 static void
 process_directory(
@@ -295,6 +297,14 @@ struct stageall_entry *sp)
 	DIR *dp;
 	struct dirent *dirp;
 	struct sam_stat sb;
+	sam_fileop_t *list;
+	int count = 0;
+
+	list = (sam_fileop_t *)malloc(SAM_FILEOPS_LIST_MAX * sizeof (*list));
+	if (list == NULL) {
+		error(0, errno, "Unable to malloc()");
+		return;
+	}
 
 	/*
 	 * Open the new directory.
@@ -302,11 +312,14 @@ struct stageall_entry *sp)
 	 */
 	if ((dp = opendir(".")) == NULL) {
 		error(0, errno, "opendir(%s)", sp->cwd);
+		free(list);
 		return;
 	}
 
 	while ((dirp = readdir(dp)) != NULL) {
 		char *name = dirp->d_name;
+		/* Read link buffer */
+		char path[MAXPATHLEN + 1];
 
 		/* Ignore dot and dot-dot. */
 		if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) {
@@ -324,8 +337,6 @@ struct stageall_entry *sp)
 		 * Get the target of the simlimk.
 		 */
 		if (S_ISLNK(sb.st_mode)) {
-			/* Read link buffer */
-			char path[MAXPATHLEN + 1];
 			int	linklen;
 
 			linklen = readlink(name, path, sizeof (path)-1);
@@ -354,18 +365,49 @@ struct stageall_entry *sp)
 		dsyslog((LOG_WARNING,
 		    "Stage %s/%s pid %d\n", sp->cwd, name, sp->pid));
 
-		/* Stage with no_assoc set */
-		if (sam_stage(name, "is") < 0) {
-			error(0, errno, "sam_stage(%s)", name);
+		memset(&list[count], 0, sizeof (*list));
+		if ((list[count].path = strdup(name)) == NULL) {
+			error(0, errno, "Unable to strdup()");
 			continue;
 		}
+		if (++count == SAM_FILEOPS_LIST_MAX) {
+			stage_list(list, count);
+			count = 0;
+		}
 	}
+	stage_list(list, count);
+	free(list);
 	if (closedir(dp) < 0) {
 		error(0, errno, "closedir(%s)", sp->cwd);
 	}
 }
 
 
+/*
+ * Stage a list of files and free their names.
+ */
+static void
+stage_list(
+sam_fileop_t *list,
+int count)
+{
+	int i;
+
+	if (count == 0) {
+		return;
+	}
+
+	/* Stage with no_assoc set, the errors are in the list */
+	(void) sam_stage_list(NULL, list, count, "is");
+	for (i = 0; i < count; i++) {
+		if (list[i].error != 0) {
+			error(0, list[i].error, "sam_stage(%s)", list[i].path);
+		}
+		free((void *)list[i].path);
+	}
+}
+
+
 /*
  * Catch child signal.
  */
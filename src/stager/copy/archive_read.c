@@ -118,13 +118,14 @@ static int readBlock(char *buf, int nbytes);
 
 static int validateTarHeader(char *in, int nbytes, int *residual);
 static size_t getTarHeaderSize(char *buffer);
-static boolean_t isTarHeader(char *ptr);
 
-static boolean_t isStarHeader(char *ptr, longlong_t reqSize);
-static boolean_t validateStarFileSize(struct header *tarHeader,
+static boolean_t isStarHeader(FileInfo_t *fi, char *ptr,
 	longlong_t reqSize);
-static boolean_t isPaxTarHeader(char *buffer, longlong_t reqSize);
-static boolean_t ifVerifyFileSizeInTarhdr();
+static boolean_t validateStarFileSize(FileInfo_t *fi,
+	struct header *tarHeader, longlong_t reqSize);
+static boolean_t isPaxTarHeader(FileInfo_t *fi, char *buffer,
+	longlong_t reqSize);
+static boolean_t ifVerifyFileSizeInTarhdr(FileInfo_t *fi);
 
 static void notifyWorkers();
 
@@ -760,7 +761,7 @@ validateTarHeader(
 	}
 
 	if (retval == 0) {
-		validHeader = isTarHeader(buffer);
+		validHeader = IsTarHeader(file, buffer, dataToRead);
 		if (validHeader == B_TRUE) {
 			/* Adjusting buffer pointer to start of file's data. */
 			fileOff += tarHeaderSize;
@@ -787,7 +788,22 @@ getTarHeaderSize(
 	if (noTarhdr) {
 		return (0);
 	}
-	if (paxTarhdr != 0) {
+	hdrSize = TarHeaderSize(file, buffer);
+	return (hdrSize);
+}
+
+/*
+ * Returns size of the tar header in buffer for a file archived
+ * with a tar header.
+ */
+size_t
+TarHeaderSize(
+	FileInfo_t *fi,
+	char *buffer)
+{
+	size_t hdrSize;
+
+	if (GET_FLAG(fi->flags, FI_PAX_TARHDR)) {
 		(void) ph_is_pax_hdr(buffer, &hdrSize);
 		hdrSize += PAX_HDR_BLK_SIZE;
 	} else {
@@ -800,16 +816,18 @@ getTarHeaderSize(
  * Returns true if valid tar header.  Validate magic and request
  * length against tar header's file size.
  */
-static boolean_t
-isTarHeader(
-	char *buffer)
+boolean_t
+IsTarHeader(
+	FileInfo_t *fi,
+	char *buffer,
+	longlong_t reqSize)
 {
 	boolean_t valid;
 
-	if (paxTarhdr != 0) {
-		valid = isPaxTarHeader(buffer, dataToRead);
+	if (GET_FLAG(fi->flags, FI_PAX_TARHDR)) {
+		valid = isPaxTarHeader(fi, buffer, reqSize);
 	} else {
-		valid = isStarHeader(buffer, dataToRead);
+		valid = isStarHeader(fi, buffer, reqSize);
 	}
 
 	if (valid == B_FALSE) {
@@ -817,14 +835,14 @@ isTarHeader(
 
 		SetErrno = 0;		/* set for trace */
 		Trace(TR_ERR, "Invalid tar header inode: %d.%d",
-		    file->id.ino, file->id.gen);
+		    fi->id.ino, fi->id.gen);
 
-		GetFileName(file, &pathBuffer[0], PATHBUF_SIZE, NULL);
+		GetFileName(fi, &pathBuffer[0], PATHBUF_SIZE, NULL);
 
-		SendCustMsg(HERE, 19032, pathBuffer, file->id.ino,
-		    file->id.gen, file->copy + 1);
+		SendCustMsg(HERE, 19032, pathBuffer, fi->id.ino,
+		    fi->id.gen, fi->copy + 1);
 
-		SET_FLAG(file->flags, FI_TAR_ERROR);
+		SET_FLAG(fi->flags, FI_TAR_ERROR);
 	}
 
 	return (valid);
@@ -835,6 +853,7 @@ isTarHeader(
  */
 static boolean_t
 isStarHeader(
+	FileInfo_t *fi,
 	char *ptr,
 	longlong_t reqSize)
 {
@@ -842,7 +861,7 @@ isStarHeader(
 	struct header *tarHeader;
 
 	Trace(TR_DEBUG, "Validate star header inode: %d.%d",
-	    file->id.ino, file->id.gen);
+	    fi->id.ino, fi->id.gen);
 
 	valid = B_TRUE;
 	tarHeader = (struct header *)ptr;
@@ -853,7 +872,7 @@ isStarHeader(
 	}
 
 	if (valid == B_TRUE) {
-		valid = validateStarFileSize(tarHeader, reqSize);
+		valid = validateStarFileSize(fi, tarHeader, reqSize);
 
 	}
 
@@ -865,6 +884,7 @@ isStarHeader(
  */
 static boolean_t
 validateStarFileSize(
+	FileInfo_t *fi,
 	struct header *tarHeader,
 	longlong_t reqSize)
 {
@@ -872,7 +892,7 @@ validateStarFileSize(
 	u_longlong_t tarFileSize;
 	boolean_t verifySize;
 
-	verifySize = ifVerifyFileSizeInTarhdr();
+	verifySize = ifVerifyFileSizeInTarhdr(fi);
 
 	if (verifySize == B_FALSE) {
 		/* Unable to validate size for this type of request. */
@@ -905,6 +925,7 @@ validateStarFileSize(
  */
 static boolean_t
 isPaxTarHeader(
+	FileInfo_t *fi,
 	char *buffer,
 	longlong_t reqSize)
 {
@@ -916,7 +937,7 @@ isPaxTarHeader(
 	offset_t tarFileSize;
 
 	Trace(TR_DEBUG, "Validate pax tar header inode: %d.%d",
-	    file->id.ino, file->id.gen);
+	    fi->id.ino, fi->id.gen);
 
 	valid = B_TRUE;
 	hdrSize = 0;
@@ -931,7 +952,7 @@ isPaxTarHeader(
 	}
 
 	/* Check if file size can be verified for this type of request. */
-	verifySize = ifVerifyFileSizeInTarhdr();
+	verifySize = ifVerifyFileSizeInTarhdr(fi);
 
 	if (valid == B_TRUE && verifySize == B_TRUE) {
 		int rval;
@@ -975,15 +996,16 @@ isPaxTarHeader(
  * stage request size.
  */
 static boolean_t
-ifVerifyFileSizeInTarhdr()
+ifVerifyFileSizeInTarhdr(
+	FileInfo_t *fi)
 {
 	boolean_t verifySize;
 
 	verifySize = B_TRUE;
 
-	if (GET_FLAG(file->flags, FI_MULTIVOL) ||
-	    GET_FLAG(file->flags, FI_STAGE_NEVER) ||
-	    GET_FLAG(file->flags, FI_STAGE_PARTIAL)) {
+	if (GET_FLAG(fi->flags, FI_MULTIVOL) ||
+	    GET_FLAG(fi->flags, FI_STAGE_NEVER) ||
+	    GET_FLAG(fi->flags, FI_STAGE_PARTIAL)) {
 
 		/* Unable to validate this type of request. */
 		verifySize = B_FALSE;
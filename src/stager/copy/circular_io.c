@@ -60,6 +60,7 @@ static char *_SrcFile = __FILE__; /* Using __FILE__ makes duplicate strings */
 
 /* SAM-FS headers. */
 #include "sam/types.h"
+#include "sam/iotune.h"
 #include "aml/stager.h"
 #include "aml/stager_defs.h"
 #include "sam/sam_malloc.h"
@@ -213,6 +214,7 @@ CircularIoWait(
 	int *len)
 {
 	char *buf;
+	hrtime_t start;
 
 	PthreadMutexLock(&buffer->cb_lock);
 
@@ -236,10 +238,14 @@ CircularIoWait(
 		/*
 		 * Buffer is full. Wait for space.
 		 */
+		start = gethrtime();
 		buffer->cb_notFull = B_FALSE;
 		while (buffer->cb_notFull == B_FALSE) {
 			PthreadCondWait(&buffer->cb_full, &buffer->cb_lock);
 		}
+		if (buffer->cb_fullStalls != NULL) {
+			IoTuneStall(buffer->cb_fullStalls, gethrtime() - start);
+		}
 	}
 
 	*len = buffer->cb_blockSize;
@@ -290,6 +296,7 @@ CircularIoAvail(
 {
 	char *buf;
 	int nbytes;
+	hrtime_t start;
 
 	PthreadMutexLock(&buffer->cb_lock);
 
@@ -308,10 +315,15 @@ CircularIoAvail(
 		/*
 		 * Wait for buffer.
 		 */
+		start = gethrtime();
 		buffer->cb_notEmpty = B_FALSE;
 		while (buffer->cb_notEmpty == B_FALSE) {
 			PthreadCondWait(&buffer->cb_empty, &buffer->cb_lock);
 		}
+		if (buffer->cb_emptyStalls != NULL) {
+			IoTuneStall(buffer->cb_emptyStalls,
+			    gethrtime() - start);
+		}
 	}
 
 	buf = buffer->cb_first + buffer->cb_out;
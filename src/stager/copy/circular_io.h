@@ -75,6 +75,13 @@ typedef struct CircularBuffer {
 	boolean_t	cb_notFull;	/* set true if buffer is not full */
 	pthread_cond_t	cb_full;
 
+	/*
+	 * Time the producer waited for a not full buffer and the
+	 * consumer for a not empty buffer.  Not recorded if NULL.
+	 */
+	struct IoTuneStalls *cb_fullStalls;
+	struct IoTuneStalls *cb_emptyStalls;
+
 	/*
 	 * State of data block. One entry for each data buffer.
 	 *
@@ -276,6 +276,7 @@ FindCopyInstanceInfo(
 	if (instance->ci_created == B_FALSE) {
 		instance->ci_media = media;
 		instance->ci_numBuffers = STAGER_DEFAULT_MC_BUFSIZE;
+		instance->ci_numBuffersMax = STAGER_DEFAULT_MC_BUFSIZE;
 	}
 	return (instance);
 }
@@ -51,6 +51,8 @@
  */
 void *ArchiveRead(void *arg);
 int SetPosition(int from_pos, int to_pos);
+size_t TarHeaderSize(FileInfo_t *fi, char *buffer);
+boolean_t IsTarHeader(FileInfo_t *fi, char *buffer, longlong_t reqSize);
 
 /*
  * Define prototypes in copy.c
@@ -64,6 +66,7 @@ void CopyFiles();
 void ResetBuffers();
 void SetFileError(FileInfo_t *file, int fd, offset_t write_off,
 	int error);
+boolean_t IfMaxStreamErrors(FileInfo_t *file);
 
 /*
  * Define prototypes in disk_cache.c
@@ -119,6 +122,8 @@ void DkEndArchiveFile();
 int DkSeekVolume(int to_pos);
 u_longlong_t DkGetPosition();
 void DkUnloadVolume();
+boolean_t DkRecallable(FileInfo_t *file);
+boolean_t DkRecall();
 
 /*
  * Define prototypes in hcstage.c
@@ -58,6 +58,7 @@ static char *_SrcFile = __FILE__; /* Using __FILE__ makes duplicate strings */
 
 /* SAM-FS headers. */
 #include "sam/types.h"
+#include "sam/iotune.h"
 #include "aml/shm.h"
 #include "aml/tar.h"
 #include "aml/tar_hdr.h"
@@ -130,11 +131,11 @@ static char *copyRequestPath;
 static void checkBuffers(char *new_vsn);
 static void allocBuffers();
 static void freeBuffers();
+static void tuneBuffers();
 
 static void copyStream();
 static void closeStream();
 static void removeDcachedFile(StreamInfo_t *stream, int error);
-static boolean_t ifMaxStreamErrors(FileInfo_t *file);
 static void rejectRequest(int error, boolean_t clean);
 
 static void initIoThread();
@@ -179,6 +180,7 @@ CopyFiles(void)
 
 		PthreadMutexLock(&Instance->ci_requestMutex);
 		Instance->ci_busy = B_FALSE;
+		Instance->ci_readers = 0;
 		Instance->ci_idletime = time(NULL);
 
 		/*
@@ -346,14 +348,18 @@ SetFileError(
 
 /*
  * Allocate i/o buffers for copy.  Size of each buffers is determined
- * from type of removable media file's block size.
+ * from type of removable media file's block size.  Number of buffers
+ * is the tuned depth, between the bufsize and the maximum bufsize
+ * for the media.
  */
 static void
 allocBuffers(void)
 {
 	int blockSize;
 	int numBuffers;
+	int numBuffersMax;
 	boolean_t lockbuf;
+	struct IoTune *it;
 
 	ASSERT(IoThread->io_numBuffers == 0);
 
@@ -365,13 +371,34 @@ allocBuffers(void)
 	}
 
 	lockbuf = Instance->ci_lockbuf;
-	numBuffers = Instance->ci_numBuffers;
+
+	/*
+	 * Read size is the media block size, only the depth is tuned.
+	 * Keep the tuned depth while the bounds are unchanged.
+	 */
+	it = &Instance->ci_tune;
+	numBuffersMax = Instance->ci_numBuffersMax;
+	if (numBuffersMax < Instance->ci_numBuffers) {
+		numBuffersMax = Instance->ci_numBuffers;
+	}
+	if (it->ItDepthMin != Instance->ci_numBuffers ||
+	    it->ItDepthMax != numBuffersMax) {
+		IoTuneInit(it, Instance->ci_numBuffers, numBuffersMax, 1, 1);
+	}
+	numBuffers = it->ItDepth;
 
 	IoThread->io_reader = CircularIoConstructor(numBuffers, blockSize,
 	    lockbuf);
 	IoThread->io_writer = CircularIoConstructor(numBuffers, blockSize,
 	    lockbuf);
 
+	/*
+	 * The archive read thread waits for room in the reader buffer,
+	 * the disk cache write thread waits for data in the writer buffer.
+	 */
+	IoThread->io_reader->cb_fullStalls = &it->ItProducer;
+	IoThread->io_writer->cb_emptyStalls = &it->ItConsumer;
+
 	Trace(TR_FILES, "Alloc buffers num: %d block size: %d %s",
 	    numBuffers, blockSize, lockbuf ? "(lock)" : "");
 
@@ -398,6 +425,32 @@ freeBuffers(void)
 	IoThread->io_blockSize = 0;
 }
 
+/*
+ * Adjust the tuned buffer depth from the stalls of the io threads.
+ * A new depth is used when the buffers are next allocated, at the
+ * next VSN load.
+ */
+static void
+tuneBuffers(void)
+{
+	struct IoTune *it;
+	boolean_t changed;
+
+	it = &Instance->ci_tune;
+	PthreadMutexLock(&IoThread->io_reader->cb_lock);
+	PthreadMutexLock(&IoThread->io_writer->cb_lock);
+	changed = IoTuneAdjust(it, gethrtime());
+	PthreadMutexUnlock(&IoThread->io_writer->cb_lock);
+	PthreadMutexUnlock(&IoThread->io_reader->cb_lock);
+
+	if (changed) {
+		Trace(TR_MISC, "Buffers tuned: %d stalls read: %lld "
+		    "write: %lld", it->ItDepth,
+		    (longlong_t)it->ItProducer.IsCount,
+		    (longlong_t)it->ItConsumer.IsCount);
+	}
+}
+
 /*
  * New media loaded.  Check if data in buffers
  * is validate and can be reused.
@@ -417,7 +470,12 @@ checkBuffers(
 
 	/* If disk archiving, invalidate buffers. */
 	if (IoThread->io_flags & IO_diskArchiving) {
-		ResetBuffers();
+		if (IoThread->io_numBuffers != Instance->ci_tune.ItDepth) {
+			freeBuffers();
+			allocBuffers();
+		} else {
+			ResetBuffers();
+		}
 		IoThread->io_position = 0;
 		strcpy(Instance->ci_vsn, new_vsn);
 		return;
@@ -441,10 +499,11 @@ checkBuffers(
 		/*
 		 * New media.  If block size has changed set new mau
 		 * information.  If necessary, reallocate buffers based
-		 * on the new block size.
+		 * on the new block size or tuned depth.
 		 */
 		blockSize = GetBlockSize();
-		if (IoThread->io_blockSize != blockSize) {
+		if (IoThread->io_blockSize != blockSize ||
+		    IoThread->io_numBuffers != Instance->ci_tune.ItDepth) {
 			freeBuffers();
 			allocBuffers();
 		} else {
@@ -539,6 +598,18 @@ copyStream()
 
 		file = GetFile(Stream->first);
 
+		/*
+		 * Disk archive files are recalled in parallel by the
+		 * readers, until the first file in the stream needs
+		 * the stage pipeline.
+		 */
+		if (DkRecallable(file)) {
+			PthreadMutexUnlock(&Stream->mutex);
+			reject = DkRecall();
+			PthreadMutexLock(&Stream->mutex);
+			continue;
+		}
+
 		PthreadMutexLock(&file->mutex);
 		PthreadMutexUnlock(&Stream->mutex);
 
@@ -610,7 +681,7 @@ copyStream()
 				SendErrorResponse(file);
 
 				/* Check if number of stream errors exceeded. */
-				reject = ifMaxStreamErrors(file);
+				reject = IfMaxStreamErrors(file);
 			}
 
 			ThreadStateWait(&IoThread->io_readDone);
@@ -622,6 +693,7 @@ copyStream()
 		}
 
 		EndArchiveFile();
+		tuneBuffers();
 
 		/* Remove file from stream before marking it as done. */
 		PthreadMutexLock(&Stream->mutex);
@@ -724,8 +796,8 @@ closeStream()
  * cancel current file and reject rest
  * of stages in this stream.
  */
-static boolean_t
-ifMaxStreamErrors(
+boolean_t
+IfMaxStreamErrors(
 	FileInfo_t *file)
 {
 	boolean_t rval;
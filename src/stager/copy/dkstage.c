@@ -49,6 +49,7 @@ static char *_SrcFile = __FILE__; /* Using __FILE__ makes duplicate strings */
 #include <fcntl.h>
 #include <signal.h>
 #include <sys/stat.h>
+#include <pthread.h>
 
 /* Solaris headers. */
 #include <sys/shm.h>
@@ -56,6 +57,7 @@ static char *_SrcFile = __FILE__; /* Using __FILE__ makes duplicate strings */
 /* SAM-FS headers. */
 #include "sam/types.h"
 #include "aml/shm.h"
+#include "aml/tar.h"
 #include "pub/stat.h"
 #include "sam/fioctl.h"
 #include "pub/rminfo.h"
@@ -81,15 +83,35 @@ static char *_SrcFile = __FILE__; /* Using __FILE__ makes duplicate strings */
 #include "rmedia.h"
 #include "stream.h"
 #include "copy_defs.h"
+#include "file_defs.h"
 
 #include "copy.h"
 #include "circular_io.h"
 
+/* Header bytes read with a recalled file's data. */
+#define	RECALL_HDR_READ	(4 * TAR_RECORDSIZE)
+
+/*
+ * Disk archive reader.
+ * Readers recall files from the disk volume in parallel.  Each has its
+ * own connection to the volume's host and reads its own tar file.
+ */
+typedef struct DkReader {
+	pthread_t	id;		/* thread id */
+	SamrftImpl_t	*rft;		/* file transfer handle */
+	boolean_t	open;		/* tar file is open */
+	DiskVolumeSeqnum_t seqnum;	/* open tar file */
+	off64_t		offset;		/* offset in open tar file, -1 unknown */
+	char		*buf;		/* read buffer */
+	int		bufSize;
+} DkReader_t;
+
 /* Public data */
 extern CopyInstanceInfo_t *Instance;
 extern IoThreadInfo_t *IoThread;
 extern StreamInfo_t *Stream;
 extern StagerStateInfo_t *State;
+extern int NumOpenFiles;
 
 /* Private data */
 static upath_t fullpath;
@@ -103,6 +125,24 @@ static DiskVolumeInfo_t *diskVolume = NULL;
 static DiskVolumeSeqnum_t seqnum;
 static boolean_t diskArchiveOpen;
 
+/*
+ * Readers take files from the stream under the stream's mutex.
+ * Opening and closing disk cache files, error responses and log
+ * events are serialized by the recall mutex.
+ */
+static pthread_mutex_t recallMutex = PTHREAD_MUTEX_INITIALIZER;
+static boolean_t recallReject;		/* reject rest of stream */
+static boolean_t recallDisabled;	/* readers unable to connect */
+
+static void *recallFiles(void *arg);
+static FileInfo_t *nextRecall();
+static void recallFile(DkReader_t *rd, FileInfo_t *file);
+static int openRecall(DkReader_t *rd, FileInfo_t *file);
+static int readRecall(DkReader_t *rd, FileInfo_t *file, char *buf,
+	int nbytes, off64_t offset);
+static void endRecall(FileInfo_t *file, int fd, offset_t write_off,
+	int error);
+
 /*
  * Init stage from disk file.
  */
@@ -143,6 +183,7 @@ DkLoadVolume(void)
 
 	diskArchiveOpen = B_FALSE;
 	IoThread->io_rftHandle = NULL;
+	recallDisabled = B_FALSE;
 
 	return (initRemoteStage());
 }
@@ -343,6 +384,113 @@ DkUnloadVolume(void)
 	}
 }
 
+/*
+ * Returns true if the file can be recalled by the disk archive readers.
+ * Multivolume, checksum, verify and error retry stages are left to the
+ * stage pipeline.
+ */
+boolean_t
+DkRecallable(
+	FileInfo_t *file)
+{
+	int copy;
+
+	if ((IoThread->io_flags & IO_disk) == 0 ||
+	    Instance->ci_readers < 2 || recallDisabled) {
+		return (B_FALSE);
+	}
+
+	copy = file->copy;
+	if (GET_FLAG(file->flags, (FI_MULTIVOL | FI_EXTENDED |
+	    FI_USE_CSUM | FI_RETRY | FI_DCACHE | FI_DATA_VERIFY)) ||
+	    GET_FLAG(file->ar[copy].flags, STAGE_COPY_VERIFY) ||
+	    file->ar[copy].n_vsns > 1) {
+		return (B_FALSE);
+	}
+	return (B_TRUE);
+}
+
+/*
+ * Recall files from the head of the stream with the disk archive
+ * readers.  Returns when the stream is empty or its first file is
+ * not recallable.  Returns true if the rest of the stream is to be
+ * rejected.
+ */
+boolean_t
+DkRecall(void)
+{
+	DkReader_t *readers;
+	char *hostname;
+	size_t size;
+	int blockSize;
+	int numReaders;
+	int i;
+	int rval;
+
+	size = Instance->ci_readers * sizeof (DkReader_t);
+	SamMalloc(readers, size);
+	memset(readers, 0, size);
+
+	blockSize = GetBlockSize();
+	hostname = DiskVolsGetHostname(diskVolume);
+
+	for (numReaders = 0; numReaders < Instance->ci_readers;
+	    numReaders++) {
+		DkReader_t *rd;
+
+		rd = &readers[numReaders];
+		rd->rft = SamrftConnect(hostname);
+		if (rd->rft == NULL) {
+			break;
+		}
+		rd->offset = -1;
+		rd->bufSize = blockSize;
+		SamMalloc(rd->buf, rd->bufSize);
+	}
+
+	/*
+	 * If no reader could connect, leave the stream to the
+	 * stage pipeline.
+	 */
+	if (numReaders == 0) {
+		SetErrno = 0;		/* set for trace */
+		Trace(TR_ERR, "No readers for dk volume: '%s'", Stream->vsn);
+		recallDisabled = B_TRUE;
+		SamFree(readers);
+		return (B_FALSE);
+	}
+
+	Trace(TR_MISC, "Recall dk volume: '%s' host: '%s' readers: %d",
+	    Stream->vsn, hostname, numReaders);
+
+	recallReject = B_FALSE;
+	for (i = 0; i < numReaders; i++) {
+		rval = pthread_create(&readers[i].id, NULL, recallFiles,
+		    &readers[i]);
+		if (rval != 0) {
+			LibFatal(pthread_create, "recallFiles");
+		}
+	}
+
+	for (i = 0; i < numReaders; i++) {
+		DkReader_t *rd;
+
+		rd = &readers[i];
+		(void) pthread_join(rd->id, NULL);
+		if (rd->open) {
+			(void) SamrftClose(rd->rft);
+		}
+		SamrftDisconnect(rd->rft);
+		SamFree(rd->buf);
+	}
+	SamFree(readers);
+
+	Trace(TR_MISC, "Recall dk volume: '%s' complete reject: %d",
+	    Stream->vsn, recallReject);
+
+	return (recallReject);
+}
+
 /*
  * Establish connection to remote host.  If connection fails,
  * the copy process will exit.
@@ -380,3 +528,416 @@ initRemoteStage(void)
 
 	return (rval);
 }
+
+/*
+ * Disk archive reader thread.
+ */
+static void *
+recallFiles(
+	void *arg)
+{
+	DkReader_t *rd = (DkReader_t *)arg;
+	FileInfo_t *file;
+
+	while ((file = nextRecall()) != NULL) {
+		recallFile(rd, file);
+	}
+	return (NULL);
+}
+
+/*
+ * Take the next file to recall from the head of the stream.
+ * Returns NULL if there is none.
+ */
+static FileInfo_t *
+nextRecall(void)
+{
+	FileInfo_t *file;
+
+	file = NULL;
+	PthreadMutexLock(&Stream->mutex);
+
+	if (Stream->first > EOS && recallReject == B_FALSE &&
+	    GET_FLAG(Stream->flags, (SR_ERROR | SR_CLEAR)) == 0 &&
+	    GET_FLAG(Instance->ci_flags, CI_failover) == 0) {
+
+		/* Stop staging if parent died. */
+		if (getppid() == 1) {
+			SetErrno = 0;		/* set for trace */
+			Trace(TR_ERR, "Detected stager daemon exit");
+
+			Stream->first = EOS;
+			SET_FLAG(Instance->ci_flags, CI_shutdown);
+
+		} else if (DkRecallable(GetFile(Stream->first))) {
+			/*
+			 * Remove file from stream while it is recalled.
+			 * The reader owns it until it is marked done.
+			 */
+			file = GetFile(Stream->first);
+			PthreadMutexLock(&file->mutex);
+			Stream->first = file->next;
+			Stream->count--;
+			if (Stream->first == EOS) {
+				Stream->last = EOS;
+			}
+
+			if (file->vsn_cnt == 0) {
+				file->read = 0;
+				file->residlen = 0;
+			}
+			SET_FLAG(file->flags, FI_ACTIVE);
+			PthreadMutexUnlock(&file->mutex);
+		}
+	}
+
+	PthreadMutexUnlock(&Stream->mutex);
+	return (file);
+}
+
+/*
+ * Recall a file.  Validate its tar header and write its data
+ * to the disk cache.
+ */
+static void
+recallFile(
+	DkReader_t *rd,
+	FileInfo_t *file)
+{
+	sam_ioctl_swrite_t swrite;
+	longlong_t dataToRead;
+	off64_t offset;
+	boolean_t cancel;
+	char *data;
+	int copy;
+	int error;
+	int fd;
+	int nbytes;
+
+	copy = file->copy;
+	file->eq = GetDriveNumber();
+
+	PthreadMutexLock(&recallMutex);
+	LogIt(LOG_STAGE_START, file);
+	PthreadMutexUnlock(&recallMutex);
+
+	if (openRecall(rd, file) != 0) {
+		/* Unable to open disk archive.  Error request. */
+		error = errno;
+		Trace(TR_ERR, "Unable to open disk archive "
+		    "copy: %d inode: %d.%d errno: %d",
+		    copy + 1, file->id.ino, file->id.gen, error);
+		PthreadMutexLock(&recallMutex);
+		file->error = error;
+		SendErrorResponse(file);
+		PthreadMutexUnlock(&recallMutex);
+		endRecall(file, -1, 0, 0);
+		return;
+	}
+
+	/* Prepare filesystem to receive staged file. */
+	PthreadMutexLock(&recallMutex);
+	fd = DiskCacheOpen(file);
+	PthreadMutexUnlock(&recallMutex);
+	if (fd < 0) {
+		endRecall(file, -1, 0, 0);
+		return;
+	}
+
+	if (file->len > file->ar[copy].section.length) {
+		dataToRead = file->ar[copy].section.length;
+	} else {
+		dataToRead = (longlong_t)file->len;
+	}
+
+	/*
+	 * Offset of the file's data in the tar file, or of its star
+	 * header.  A pax header starts at the data offset.
+	 */
+	offset = (file->ar[copy].section.offset * TAR_RECORDSIZE) +
+	    file->offset;
+	if (GET_FLAG(file->flags, (FI_NO_TARHDR | FI_PAX_TARHDR)) == 0) {
+		offset -= TAR_RECORDSIZE;
+	}
+
+	Trace(TR_FILES, "Recall inode: %d.%d pos: %llx.%llx len: %lld",
+	    file->id.ino, file->id.gen, file->ar[copy].section.position,
+	    file->ar[copy].section.offset, dataToRead);
+
+	memset(&swrite, 0, sizeof (sam_ioctl_swrite_t));
+	cancel = B_FALSE;
+	error = 0;
+	data = rd->buf;
+	nbytes = 0;
+
+	/*
+	 * Validate and skip the tar header.  The data of a small file
+	 * is read with its header.
+	 */
+	if (dataToRead > 0 && GET_FLAG(file->flags, FI_NO_TARHDR) == 0) {
+		int hdrSize;
+		int ngot;
+
+		nbytes = rd->bufSize;
+		if (nbytes > dataToRead + RECALL_HDR_READ) {
+			nbytes = dataToRead + RECALL_HDR_READ;
+		}
+		ngot = readRecall(rd, file, rd->buf, nbytes, offset);
+
+		hdrSize = 0;
+		if (ngot >= TAR_RECORDSIZE) {
+			hdrSize = TarHeaderSize(file, rd->buf);
+			if (hdrSize > ngot && hdrSize <= rd->bufSize) {
+				/* Read rest of a long pax header. */
+				nbytes = readRecall(rd, file, rd->buf + ngot,
+				    hdrSize - ngot, offset + ngot);
+				if (nbytes == hdrSize - ngot) {
+					ngot = hdrSize;
+				}
+			}
+		}
+
+		if (ngot < TAR_RECORDSIZE || hdrSize > ngot ||
+		    IsTarHeader(file, rd->buf, dataToRead) == B_FALSE) {
+			error = (ngot < 0 && errno != 0) ? errno : EIO;
+			ngot = 0;
+			hdrSize = 0;
+		}
+		offset += ngot;
+		data = rd->buf + hdrSize;
+		nbytes = ngot - hdrSize;
+	}
+
+	while (dataToRead > 0 && error == 0 && cancel == B_FALSE) {
+		/*
+		 * Read next data from the tar file.  The file is read
+		 * by its own reader, a short read is the end of file.
+		 */
+		if (nbytes == 0) {
+			nbytes = rd->bufSize;
+			if (nbytes > dataToRead) {
+				nbytes = dataToRead;
+			}
+			nbytes = readRecall(rd, file, rd->buf, nbytes, offset);
+			if (nbytes <= 0) {
+				error = (nbytes < 0 && errno != 0) ? errno : EIO;
+				break;
+			}
+			offset += nbytes;
+			data = rd->buf;
+		}
+		if (nbytes > dataToRead) {
+			nbytes = dataToRead;
+		}
+
+		swrite.buf.ptr = data;
+		swrite.nbyte = nbytes;
+		if (ioctl(fd, F_SWRITE, &swrite) != nbytes) {
+			Trace(TR_ERR, "Write error: %d fd: %d nbyte: %d "
+			    "offset: %lld",
+			    errno, fd, swrite.nbyte, swrite.offset);
+			Trace(TR_MISC, "Cancelled(write error) inode: %d.%d",
+			    file->id.ino, file->id.gen);
+
+			if (errno == ECANCELED) {
+				cancel = B_TRUE;
+				SET_FLAG(file->flags, FI_CANCEL);
+			} else {
+				error = errno;
+				SET_FLAG(file->flags, FI_WRITE_ERROR);
+			}
+			break;
+		}
+
+		file->stage_size += nbytes;
+		swrite.offset += nbytes;
+		dataToRead -= nbytes;
+		nbytes = 0;
+	}
+
+	Trace(TR_FILES, "Recall complete inode: %d.%d error: %d",
+	    file->id.ino, file->id.gen, error);
+
+	/*
+	 * Close the disk cache file, unless an error leaves it open
+	 * for a stage from another copy.
+	 */
+	if (error == 0) {
+		(void) close(fd);
+		PthreadMutexLock(&recallMutex);
+		CLEAR_FLAG(file->flags, FI_DCACHE);
+		NumOpenFiles--;
+		PthreadMutexUnlock(&recallMutex);
+	}
+	endRecall(file, fd, swrite.offset, error);
+}
+
+/*
+ * Open tar file holding the file's archive copy, unless it is
+ * the reader's open tar file.
+ * Returns 0 if open, or -1 and errno is set.
+ */
+static int
+openRecall(
+	DkReader_t *rd,
+	FileInfo_t *file)
+{
+	upath_t tarFileName;
+	upath_t path;
+	DiskVolumeSeqnum_t seq;
+	int error;
+	int retry;
+	int rc;
+
+	seq = file->ar[file->copy].section.position;
+	if (rd->open && rd->seqnum == seq) {
+		return (0);
+	}
+	if (rd->open) {
+		(void) SamrftClose(rd->rft);
+		rd->open = B_FALSE;
+	}
+
+	(void) DiskVolsGenFileName(seq, tarFileName, sizeof (tarFileName));
+	snprintf(path, sizeof (path), "%s/%s", diskVolume->DvPath,
+	    tarFileName);
+
+	Trace(TR_FILES, "Open file '%s' (0x%llx)", path, seq);
+
+	retry = file->retry;
+	for (;;) {
+		rc = SamrftOpen(rd->rft, path, O_RDONLY | O_LARGEFILE, NULL);
+		if (rc == 0 || --retry <= 0) {
+			break;
+		}
+		Trace(TR_ERR, "Unable to open file: %s errno: %d",
+		    path, errno);
+		sleep(5);
+	}
+
+	if (rc != 0) {
+		char errbuf[132];
+
+		error = (errno != 0) ? errno : EIO;
+
+		/*
+		 * Set ENODEV if disk archive volume is not available.
+		 */
+		PthreadMutexLock(&recallMutex);
+		if (error == ENOENT && DiskVolsIsAvail(NULL, diskVolume,
+		    B_FALSE, DVA_stager) != B_TRUE) {
+			error = ENODEV;
+			SetErrno = 0;		/* set for trace */
+			Trace(TR_ERR, "Diskvolume 'dk.%s' not available.",
+			    Stream->vsn);
+		}
+		PthreadMutexUnlock(&recallMutex);
+
+		if (diskVolume->DvHost[0] != '\0') {
+			snprintf(errbuf, sizeof (errbuf), "%s:%s",
+			    diskVolume->DvHost, path);
+		} else {
+			strncpy(errbuf, path, sizeof (errbuf));
+		}
+		SetErrno = error;
+		WarnSyscallError(HERE, "open", errbuf);
+		SetErrno = error;
+		return (-1);
+	}
+
+	rd->open = B_TRUE;
+	rd->seqnum = seq;
+	rd->offset = 0;
+	return (0);
+}
+
+/*
+ * Read from the reader's tar file at offset.  Read errors are retried
+ * as in the archive read thread.
+ * Returns number of bytes read, or -1 and errno is set.
+ */
+static int
+readRecall(
+	DkReader_t *rd,
+	FileInfo_t *file,
+	char *buf,
+	int nbytes,
+	off64_t offset)
+{
+	int ngot;
+
+	for (;;) {
+		SetErrno = 0;
+		ngot = -1;
+		if (rd->offset == offset ||
+		    SamrftSeek(rd->rft, offset, SEEK_SET, &rd->offset) == 0) {
+			ngot = SamrftRead(rd->rft, buf, nbytes);
+		}
+		if (ngot >= 0) {
+			rd->offset = offset + ngot;
+			file->read += ngot;
+			break;
+		}
+
+		/* Position after a failed read is unknown. */
+		rd->offset = -1;
+		if (errno == 0) {
+			SetErrno = EIO;
+		}
+		SysError(HERE, "Stager read failed inode: %d.%d "
+		    "expected: %d got: %d, %d",
+		    file->id.ino, file->id.gen, nbytes, ngot, errno);
+
+		if (IfRetry(file, errno) == B_FALSE) {
+			break;
+		}
+	}
+	return (ngot);
+}
+
+/*
+ * Recall of a file is done.  If it failed, send the error response.
+ * Mark the file done.
+ */
+static void
+endRecall(
+	FileInfo_t *file,
+	int fd,
+	offset_t write_off,
+	int error)
+{
+	boolean_t reject;
+
+	reject = B_FALSE;
+	if (error != 0) {
+		PthreadMutexLock(&recallMutex);
+		SetFileError(file, fd, write_off, error);
+		SendErrorResponse(file);
+
+		/* Check if number of stream errors exceeded. */
+		reject = IfMaxStreamErrors(file);
+		PthreadMutexUnlock(&recallMutex);
+	}
+
+	PthreadMutexLock(&Stream->mutex);
+
+	/* Device not available. */
+	if (file->error == ENODEV) {
+		SetErrno = 0;	/* set for trace */
+		Trace(TR_ERR, "No device available");
+
+		reject = B_TRUE;
+		if (NumOpenFiles <= 0 && Instance->ci_first == NULL) {
+			SET_FLAG(Instance->ci_flags, CI_shutdown);
+			Instance->ci_busy = B_TRUE;
+		}
+	}
+	if (reject) {
+		recallReject = B_TRUE;
+	}
+
+	/* Mark file staging as done. */
+	SetStageDone(file);
+
+	PthreadMutexUnlock(&Stream->mutex);
+}
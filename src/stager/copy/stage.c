@@ -358,6 +358,7 @@ switchInstance(
 
 		Instance->ci_media = from->ci_media;
 		Instance->ci_numBuffers = from->ci_numBuffers;
+		Instance->ci_numBuffersMax = from->ci_numBuffersMax;
 		Instance->ci_flags = from->ci_flags;
 		Instance->ci_eq = from->ci_eq;
 	} else {
@@ -374,6 +375,7 @@ switchInstance(
 
 		Instance->ci_media = saveInstance.ci_media;
 		Instance->ci_numBuffers = saveInstance.ci_numBuffers;
+		Instance->ci_numBuffersMax = saveInstance.ci_numBuffersMax;
 		Instance->ci_flags = saveInstance.ci_flags;
 		Instance->ci_eq = saveInstance.ci_eq;
 	}
@@ -36,6 +36,8 @@
 
 #pragma ident "$Revision: 1.35 $"
 
+#include "sam/iotune.h"
+
 /* Structures. */
 
 /*
@@ -74,7 +76,9 @@ typedef struct CopyInstanceInfo {
 					/*    number */
 
 	int		ci_numBuffers;	/* number of i/o buffers */
+	int		ci_numBuffersMax; /* maximum number of i/o buffers */
 	boolean_t	ci_lockbuf;	/* lock buffers */
+	struct IoTune	ci_tune;	/* i/o buffers, tuned by copy proc */
 
 	boolean_t	ci_created;	/* set if copy thread already created */
 	pid_t		ci_pid;		/* pid of running copy process */
@@ -97,10 +101,19 @@ typedef struct CopyInstanceInfo {
 
 	struct in6_addr	ci_hostAddr;	/* remote host address */
 	time_t		ci_idletime;	/* time copyproc finished request */
+
+	/*
+	 * Disk archive readers, set by the scheduler for each stream.
+	 * The readers of busy copy procs count against the limits for
+	 * the disk volume and its host.
+	 */
+	int		ci_readers;	/* number of readers */
+	vsn_t		ci_readVsn;	/* disk volume read */
+	host_t		ci_readHost;	/* host of the disk volume */
 } CopyInstanceInfo_t;
 
 #define	COPY_INSTANCE_LIST_MAGIC	05501531
-#define	COPY_INSTANCE_LIST_VERSION	80601	/* YMMDD */
+#define	COPY_INSTANCE_LIST_VERSION	261020	/* YYMMDD */
 
 /*
  * Copy instance list.
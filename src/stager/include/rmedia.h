@@ -157,6 +157,8 @@ typedef struct MediaParamsInfo {
 	int		mp_drives;	/* num of drives that can use media */
 	int		mp_bufsize;	/* size of stage buffer * device */
 					/*    mau size */
+	int		mp_bufsizeMax;	/* maximum mp_bufsize, copy proc */
+					/*    adjusts the buffer between */
 	boolean_t	mp_lockbuf;	/* lock buffer */
 	/* Timeout values for stage operations that may get stopped. */
 	int		mp_readTimeout;		/* media read */
@@ -182,9 +184,12 @@ int GetEqOrdinal(int drive);
 
 VsnInfo_t *FindVsn(vsn_t vsn, media_t media);
 boolean_t IsVsnAvail(VsnInfo_t *vi, boolean_t *attended);
+boolean_t GetDiskVolHost(vsn_t vsn, host_t host);
 
 void MakeMediaParamsTable();
-int GetMediaParamsBufsize(media_t type, boolean_t *lockbuf);
-void SetMediaParamsBufsize(char *name, int bufsize, boolean_t lockbuf);
+int GetMediaParamsBufsize(media_t type, int *bufsizeMax,
+	boolean_t *lockbuf);
+void SetMediaParamsBufsize(char *name, int bufsize, int bufsizeMax,
+	boolean_t lockbuf);
 
 #endif /* RMEDIA_H */
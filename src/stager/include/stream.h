@@ -57,6 +57,7 @@ boolean_t AddStream(StreamInfo_t *stream, int fid, int sort);
 void ErrorStream(StreamInfo_t *stream, int error);
 boolean_t CancelStream(StreamInfo_t *stream, int id);
 void ClearStream(StreamInfo_t *stream);
+void OrderStream(StreamInfo_t *stream);
 
 #ifdef __cplusplus
 }
@@ -131,10 +131,12 @@ main(int argc, char *argv[])
 	}
 
 	size = sizeof (CopyInstanceList_t);
-	size += (numDrives - 1) * sizeof (CopyInstanceInfo_t);
+	size += (CopyInstanceList->cl_entries - 1) *
+	    sizeof (CopyInstanceInfo_t);
 
 	if (CopyInstanceList->cl_magic != COPY_INSTANCE_LIST_MAGIC      ||
-	    CopyInstanceList->cl_version != COPY_INSTANCE_LIST_VERSION) {
+	    CopyInstanceList->cl_version != COPY_INSTANCE_LIST_VERSION ||
+	    CopyInstanceList->cl_size != size || size > len) {
 
 		fprintf(stderr, "Invalid %s found.\n",
 		    stdatapath);
@@ -174,6 +176,24 @@ main(int argc, char *argv[])
 		    CopyInstanceList->cl_data[i].ci_busy,
 		    idltime);
 	}
+
+	/* Buffer tuning, read thread waits for room, write thread for data. */
+	printf("\n  eq  bufs   min   max  adj  read stalls    read ms"
+	    "  write stalls   write ms\n");
+	for (i = 0; i < CopyInstanceList->cl_entries; i++) {
+		struct IoTune *it = &CopyInstanceList->cl_data[i].ci_tune;
+
+		if (CopyInstanceList->cl_data[i].ci_eq == 0)
+			continue;
+
+		printf("%4d %5d %5d %5d %4d %12llu %10llu %13llu %10llu\n",
+		    CopyInstanceList->cl_data[i].ci_eq,
+		    it->ItDepth, it->ItDepthMin, it->ItDepthMax, it->ItAdjusts,
+		    (u_longlong_t)it->ItProducer.IsCount,
+		    (u_longlong_t)it->ItProducer.IsTime / 1000000,
+		    (u_longlong_t)it->ItConsumer.IsCount,
+		    (u_longlong_t)it->ItConsumer.IsTime / 1000000);
+	}
 	munmap(CopyInstanceList, len);
 
 	return (0);
@@ -252,6 +252,8 @@ main(int argc, char *argv[])
 					flg[i++] = 'u';
 			if (StreamInfo->flags & SR_DCACHE_CLOSE)
 					flg[i++] = 'u';
+			if (StreamInfo->flags & SR_ORDERED)
+					flg[i++] = 'o';
 
 			printf("%s: %p %4d %3s %6d %s %p %6d %6d %6d\n",
 			   crtime,
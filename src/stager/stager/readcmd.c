@@ -38,6 +38,7 @@ static char *_SrcFile = __FILE__; /* Using __FILE__ makes duplicate strings */
 /*
  * ANSI C headers.
  */
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -107,6 +108,8 @@ static DirProc_t commands[] = {
 	{ "drives",		setDrivesParams,		DP_value },
 	{ "directio",		setDirectioParam,		DP_value },
 	{ "dio_min_size",	setSimpleParam,			DP_value },
+	{ "dk_readers",		setSimpleParam,			DP_value },
+	{ "dk_host_readers",	setSimpleParam,			DP_value },
 	{ "streams",		dirStreams,			DP_set },
 	{ "endstreams",		dirNoBegin,			DP_set },
 	{ NULL, NULL }
@@ -189,6 +192,24 @@ GetCfgDirectioMin(void)
 	return (config.dio_min_size);
 }
 
+/*
+ * Get dk_readers directive
+ */
+int
+GetCfgDkReaders(void)
+{
+	return (config.dk_readers);
+}
+
+/*
+ * Get dk_host_readers directive
+ */
+int
+GetCfgDkHostReaders(void)
+{
+	return (config.dk_host_readers);
+}
+
 /*
  * Get number of drives configuration parameters.
  */
@@ -246,6 +267,7 @@ setBufsizeParams(void)
 
 	char *p;
 	mtype_t media;
+	int64_t sizeMax;
 
 	/*
 	 *  Copy media to stager's parameters.
@@ -284,7 +306,24 @@ setBufsizeParams(void)
 				    maxBufsize);
 			}
 
-			if (ReadCfgGetToken() != 0) {
+			/*
+			 * Optional maximum buffer size, the copy process
+			 * adjusts the buffer between the two.
+			 */
+			sizeMax = config.bufsize.size;
+			if (ReadCfgGetToken() != 0 &&
+			    isdigit(*(unsigned char *)cfgToken)) {
+				sizeMax = strtoll(cfgToken, &p, 0);
+				if (*p != '\0' ||
+				    sizeMax < config.bufsize.size ||
+				    sizeMax > maxBufsize) {
+					ReadCfgError(CustMsg(14102), keyword,
+					    config.bufsize.size, maxBufsize);
+				}
+				(void) ReadCfgGetToken();
+			}
+
+			if (*cfgToken != '\0') {
 				if (strcmp(cfgToken, "lock") == 0) {
 					config.bufsize.lockbuf = B_TRUE;
 				} else {
@@ -293,7 +332,7 @@ setBufsizeParams(void)
 			}
 
 			SetMediaParamsBufsize(media, config.bufsize.size,
-			    config.bufsize.lockbuf);
+			    (int)sizeMax, config.bufsize.lockbuf);
 
 		} else {
 			ReadCfgError(CustMsg(14008), keyword);
@@ -0,0 +1,396 @@
+/*
+ * recall_order.c - order files in a stream for recall from tape.
+ *
+ * Files in a stream are sorted by position on the volume.  On linear
+ * serpentine media such as LTO, the data is written in wraps running
+ * end to end of the tape in alternate directions, so two files close
+ * in position may be a full tape length apart and files far apart in
+ * position may sit next to each other on adjacent wraps.
+ *
+ * The ordering here uses a model of the volume's wrap geometry to
+ * estimate the time to locate from the end of one file to the start
+ * of the next and builds a nearest neighbor tour from the beginning
+ * of the tape.  The tour is only used if its estimated locate time is
+ * less than the position order's.
+ */
+
+/*
+ *    SAM-QFS_notice_begin
+ *
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at pkg/OPENSOLARIS.LICENSE
+ * or https://illumos.org/license/CDDL.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at pkg/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+/*
+ * Copyright 2009 Sun Microsystems, Inc.  All rights reserved.
+ * Use is subject to license terms.
+ *
+ *    SAM-QFS_notice_end
+ */
+
+#pragma ident "$Revision: 1.1 $"
+
+static char *_SrcFile = __FILE__; /* Using __FILE__ makes duplicate strings */
+
+/* ANSI C headers. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* POSIX headers. */
+#include <sys/types.h>
+#include <pthread.h>
+
+/* SAM-FS headers. */
+#include "sam/types.h"
+#include "pub/devstat.h"
+#include "aml/catalog.h"
+#include "aml/tar.h"
+#include "aml/stager.h"
+#include "aml/stager_defs.h"
+#include "sam/sam_malloc.h"
+#include "sam/sam_trace.h"
+
+/* Local headers. */
+#include "stager_lib.h"
+#include "stager.h"
+
+/*
+ * Longitudinal positions are fractions of the tape length in
+ * these units.  Position 0 is the beginning of the tape.
+ */
+#define	LPOS_SCALE	65536
+
+/*
+ * Largest stream ordered.  The nearest neighbor tour is quadratic
+ * in the number of files and is built by the scheduler thread.
+ */
+#define	ORDER_MAX	8192
+
+#define	LOCATE_MS	2000	/* overhead of each locate */
+#define	WRAP_MS		1500	/* wrap change, head step and reverse */
+
+/*
+ * Volume geometry.
+ */
+typedef struct Geometry {
+	char	*GeName;		/* model name for trace */
+	int	GeWraps;		/* number of wraps */
+	int	GeWindMs;		/* time to wind the full length */
+	long long GeWrapBlocks;		/* blocks in each wrap */
+	uint32_t GeBlockSize;		/* block size in bytes */
+} Geometry_t;
+
+/*
+ * A file's extent on the volume.
+ */
+typedef struct Extent {
+	FileInfo_t *ExFile;
+	int	ExWrap;			/* first block's wrap */
+	int	ExLpos;			/* first block's longitudinal pos */
+	int	ExEndWrap;		/* wrap after the last block */
+	int	ExEndLpos;		/* longitudinal pos after last block */
+	long long ExBlock;		/* first block */
+	long long ExEndBlock;		/* block after the last block */
+} Extent_t;
+
+/*
+ * LTO generations.  Capacity is native in kilobytes.
+ */
+static struct {
+	char	*name;
+	uint64_t capacity;
+	int	wraps;
+	int	windMs;
+} ltoGenerations[] = {
+	{ "LTO-1",    100000000ULL,  48,  95000 },
+	{ "LTO-2",    200000000ULL,  64,  95000 },
+	{ "LTO-3",    400000000ULL,  44,  95000 },
+	{ "LTO-4",    800000000ULL,  56,  98000 },
+	{ "LTO-5",   1500000000ULL,  80, 100000 },
+	{ "LTO-6",   2500000000ULL, 136, 100000 },
+	{ "LTO-7",   6000000000ULL, 112, 110000 },
+	{ "LTO-8",  12000000000ULL, 208, 110000 },
+	{ "LTO-9",  18000000000ULL, 280, 110000 },
+	{ NULL }
+};
+
+/* Private functions. */
+static boolean_t ltoGeometry(struct CatalogEntry *ce, Geometry_t *geo);
+static void setExtent(Geometry_t *geo, FileInfo_t *file, Extent_t *ex);
+static long long locateMs(Geometry_t *geo, Extent_t *from, Extent_t *to);
+static long long orderMs(Geometry_t *geo, Extent_t *ex, int *order,
+	int count);
+static void nearestOrder(Geometry_t *geo, Extent_t *ex, int *order,
+	int count);
+
+/*
+ * Media with a wrap geometry model.
+ */
+static struct {
+	int	media;
+	boolean_t (*geometry)(struct CatalogEntry *ce, Geometry_t *geo);
+} models[] = {
+	{ DT_IBM3580, ltoGeometry },
+	{ 0, NULL }
+};
+
+/*
+ * Order files in a stream for recall.  The list is sorted by position
+ * on entry.  Returns TRUE if the list was reordered.
+ */
+boolean_t
+OrderRecall(
+	StreamInfo_t *stream,
+	FileInfo_t **sortList,
+	int count)
+{
+	Geometry_t geo;
+	Extent_t *ex;
+	int *order;
+	long long positionMs;
+	long long tourMs;
+	boolean_t reordered;
+	int i;
+
+	if (count < 3 || count > ORDER_MAX || stream->vi.ce == NULL) {
+		return (B_FALSE);
+	}
+
+	for (i = 0; models[i].geometry != NULL; i++) {
+		if (models[i].media == stream->media) {
+			break;
+		}
+	}
+	if (models[i].geometry == NULL) {
+		return (B_FALSE);
+	}
+	memset(&geo, 0, sizeof (geo));
+	if (models[i].geometry(stream->vi.ce, &geo) == B_FALSE) {
+		return (B_FALSE);
+	}
+
+	SamMalloc(ex, count * sizeof (Extent_t));
+	SamMalloc(order, count * sizeof (int));
+	for (i = 0; i < count; i++) {
+		setExtent(&geo, sortList[i], &ex[i]);
+		order[i] = i;
+	}
+	positionMs = orderMs(&geo, ex, order, count);
+
+	nearestOrder(&geo, ex, order, count);
+	tourMs = orderMs(&geo, ex, order, count);
+
+	reordered = B_FALSE;
+	if (tourMs < positionMs) {
+		for (i = 0; i < count; i++) {
+			sortList[i] = ex[order[i]].ExFile;
+		}
+		reordered = B_TRUE;
+	}
+
+	Trace(TR_MISC, "Recall order '%s.%d' %s files: %d "
+	    "locate est: position %lld.%03llds tour %lld.%03llds%s",
+	    stream->vsn, stream->seqnum, geo.GeName, count,
+	    positionMs / 1000, positionMs % 1000,
+	    tourMs / 1000, tourMs % 1000,
+	    reordered ? " (used)" : "");
+
+	SamFree(order);
+	SamFree(ex);
+	return (reordered);
+}
+
+
+/* Private functions. */
+
+
+/*
+ * LTO geometry from the catalog entry.  The generation is the
+ * smallest one holding the volume's capacity.
+ */
+static boolean_t
+ltoGeometry(
+	struct CatalogEntry *ce,
+	Geometry_t *geo)
+{
+	long long blocks;
+	int i;
+
+	if (ce->CeCapacity == 0) {
+		return (B_FALSE);
+	}
+	for (i = 0; ltoGenerations[i + 1].name != NULL; i++) {
+		if (ce->CeCapacity <= ltoGenerations[i].capacity +
+		    ltoGenerations[i].capacity / 20) {
+			break;
+		}
+	}
+	geo->GeName = ltoGenerations[i].name;
+	geo->GeWraps = ltoGenerations[i].wraps;
+	geo->GeWindMs = ltoGenerations[i].windMs;
+	geo->GeBlockSize = ce->CeBlockSize;
+	if (geo->GeBlockSize == 0) {
+		geo->GeBlockSize = 256 * 1024;
+	}
+
+	blocks = (ce->CeCapacity * 1024) / geo->GeBlockSize;
+	geo->GeWrapBlocks = blocks / geo->GeWraps;
+	if (geo->GeWrapBlocks == 0) {
+		return (B_FALSE);
+	}
+	return (B_TRUE);
+}
+
+/*
+ * Set file's extent on the volume.  Even wraps run from the beginning
+ * of the tape, odd wraps back towards it.
+ */
+static void
+setExtent(
+	Geometry_t *geo,
+	FileInfo_t *file,
+	Extent_t *ex)
+{
+	ArcopyInfo_t *ar;
+	long long lpos;
+	long long block;
+
+	ar = &file->ar[file->copy];
+	ex->ExFile = file;
+	ex->ExBlock = ar->section.position +
+	    ((ar->section.offset * TAR_RECORDSIZE) + file->offset) /
+	    geo->GeBlockSize;
+	ex->ExEndBlock = ex->ExBlock + 1 + file->len / geo->GeBlockSize;
+
+	block = ex->ExBlock;
+	ex->ExWrap = block / geo->GeWrapBlocks;
+	lpos = ((block % geo->GeWrapBlocks) * LPOS_SCALE) / geo->GeWrapBlocks;
+	ex->ExLpos = (ex->ExWrap & 1) ? LPOS_SCALE - lpos : lpos;
+
+	block = ex->ExEndBlock;
+	ex->ExEndWrap = block / geo->GeWrapBlocks;
+	lpos = ((block % geo->GeWrapBlocks) * LPOS_SCALE) / geo->GeWrapBlocks;
+	ex->ExEndLpos = (ex->ExEndWrap & 1) ? LPOS_SCALE - lpos : lpos;
+}
+
+/*
+ * Estimated time to locate from the end of one file to the start of
+ * another.  No locate if the next file follows on the tape.
+ */
+static long long
+locateMs(
+	Geometry_t *geo,
+	Extent_t *from,
+	Extent_t *to)
+{
+	long long ms;
+	int wind;
+
+	if (from == NULL) {
+		/* From the beginning of the tape. */
+		if (to->ExBlock == 0) {
+			return (0);
+		}
+		wind = to->ExLpos;
+		ms = LOCATE_MS;
+		if (to->ExWrap != 0) {
+			ms += WRAP_MS;
+		}
+	} else {
+		if (to->ExBlock >= from->ExBlock &&
+		    to->ExBlock <= from->ExEndBlock) {
+			return (0);
+		}
+		wind = to->ExLpos - from->ExEndLpos;
+		if (wind < 0) {
+			wind = -wind;
+		}
+		ms = LOCATE_MS;
+		if (to->ExWrap != from->ExEndWrap) {
+			ms += WRAP_MS;
+		}
+	}
+	ms += ((long long)wind * geo->GeWindMs) / LPOS_SCALE;
+	return (ms);
+}
+
+/*
+ * Total estimated locate time to read files in the given order,
+ * starting at the beginning of the tape.
+ */
+static long long
+orderMs(
+	Geometry_t *geo,
+	Extent_t *ex,
+	int *order,
+	int count)
+{
+	long long ms;
+	int i;
+
+	ms = locateMs(geo, NULL, &ex[order[0]]);
+	for (i = 1; i < count; i++) {
+		ms += locateMs(geo, &ex[order[i - 1]], &ex[order[i]]);
+	}
+	return (ms);
+}
+
+/*
+ * Nearest neighbor tour from the beginning of the tape.  Ties are
+ * broken by position, the order of the extents on entry.
+ */
+static void
+nearestOrder(
+	Geometry_t *geo,
+	Extent_t *ex,
+	int *order,
+	int count)
+{
+	Extent_t *from;
+	long long best;
+	long long ms;
+	int next;
+	int i;
+	int j;
+
+	from = NULL;
+	for (i = 0; i < count; i++) {
+		next = i;
+		best = locateMs(geo, from, &ex[order[i]]);
+		for (j = i + 1; j < count && best > 0; j++) {
+			ms = locateMs(geo, from, &ex[order[j]]);
+			if (ms < best) {
+				best = ms;
+				next = j;
+			}
+		}
+		if (next != i) {
+			int tmp;
+
+			/*
+			 * Keep the unvisited extents in position order.
+			 */
+			tmp = order[next];
+			memmove(&order[i + 1], &order[i],
+			    (next - i) * sizeof (int));
+			order[i] = tmp;
+		}
+		from = &ex[order[i]];
+	}
+}
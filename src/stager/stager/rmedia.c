@@ -444,6 +444,34 @@ IsVsnAvail(
 	return (avail);
 }
 
+/*
+ * Get host of a disk archive volume.
+ * Returns TRUE if the volume was found in the disk volume dictionary.
+ */
+boolean_t
+GetDiskVolHost(
+	vsn_t vsn,
+	host_t host)
+{
+	extern char *program_name;
+	DiskVolsDictionary_t *diskvols;
+	DiskVolumeInfo_t *dv;
+	boolean_t found = B_FALSE;
+
+	diskvols = DiskVolsNewHandle(program_name, DISKVOLS_VSN_DICT,
+	    DISKVOLS_RDONLY);
+	if (diskvols == NULL) {
+		return (B_FALSE);
+	}
+	(void) diskvols->Get(diskvols, vsn, &dv);
+	if (dv != NULL) {
+		(void) strlcpy(host, DiskVolsGetHostname(dv), sizeof (host_t));
+		found = B_TRUE;
+	}
+	(void) DiskVolsDeleteHandle(DISKVOLS_VSN_DICT);
+	return (found);
+}
+
 /*
  * Get removable media drive table.
  */
@@ -884,6 +912,7 @@ MakeMediaParamsTable(void)
 		(void) strcpy(mp->mp_name, dev->nm);
 		mp->mp_type = dev->dt;
 		mp->mp_bufsize = STAGER_DEFAULT_MC_BUFSIZE;
+		mp->mp_bufsizeMax = STAGER_DEFAULT_MC_BUFSIZE;
 
 		if (mp->mp_type == DT_OPTICAL) {
 			mp->mp_type = Defaults->optical;
@@ -903,6 +932,7 @@ void
 SetMediaParamsBufsize(
 	char *name,
 	int bufsize,
+	int bufsizeMax,
 	boolean_t lockbuf)
 {
 	int i;
@@ -921,6 +951,7 @@ SetMediaParamsBufsize(
 		 */
 		if (mp->mp_type == type) {
 			mp->mp_bufsize = bufsize;
+			mp->mp_bufsizeMax = bufsizeMax;
 			mp->mp_lockbuf = lockbuf;
 		}
 	}
@@ -932,6 +963,7 @@ SetMediaParamsBufsize(
 int
 GetMediaParamsBufsize(
 	media_t type,
+	int *bufsizeMax,
 	boolean_t *lockbuf)
 {
 	int i;
@@ -943,6 +975,7 @@ GetMediaParamsBufsize(
 		mp = &mediaParamsTable.data[i];
 		if (mp->mp_type == type) {
 			bufsize = mp->mp_bufsize;
+			*bufsizeMax = mp->mp_bufsizeMax;
 			*lockbuf = mp->mp_lockbuf;
 			break;
 		}
@@ -124,6 +124,7 @@ static void setLdCancelSig();
 static void catchLdCancelSig(int sig);
 static void restoreCopyProc(CopyInstanceInfo_t *copy);
 static boolean_t isStagingSuspended(media_t	media);
+static int dkReaders(StreamInfo_t *stream, host_t host);
 
 /*
  * Work queue.
@@ -1469,6 +1470,18 @@ findResources(
 		priority = SP_busy;
 	}
 
+	/*
+	 * Disk archive volume.  The readers of the volume and of its
+	 * host are limited.
+	 */
+	if (priority != SP_busy && stream->vi.media == DT_DISK) {
+		host_t host;
+
+		if (dkReaders(stream, host) <= 0) {
+			priority = SP_busy;
+		}
+	}
+
 	/*
 	 * FindVsn call above checked if requested VSN is loaded.  If so,
 	 * this is a good candidate to schedule now.
@@ -1659,12 +1672,28 @@ startCopy(
 	 * has a change to pick it up.
 	 */
 	PthreadMutexLock(&stream->mutex);
+	OrderStream(stream);
 	SET_FLAG(stream->flags, SR_ACTIVE);
 	PthreadMutexUnlock(&stream->mutex);
 
 	(void) strncpy(request->cr_vsn, stream->vsn, sizeof (request->cr_vsn));
 	request->cr_seqnum = stream->seqnum;
 
+	/*
+	 * Number of readers the copy process may use to recall
+	 * files from a disk archive volume.
+	 */
+	instance->ci_readers = 0;
+	if (vi->media == DT_DISK) {
+		host_t host;
+
+		instance->ci_readers = MAX(dkReaders(stream, host), 1);
+		(void) strncpy(instance->ci_readVsn, stream->vsn,
+		    sizeof (instance->ci_readVsn));
+		(void) strncpy(instance->ci_readHost, host,
+		    sizeof (instance->ci_readHost));
+	}
+
 	/*
 	 * Tell copy server that a request is available.  This call
 	 * unblocks the server thread waiting on the condition variable.
@@ -1824,10 +1853,12 @@ findCopy(
 	 */
 	if (instance->ci_created == 0) {
 		boolean_t lockbuf;
+		int bufsizeMax;
 
 		instance->ci_media = media;
 		instance->ci_numBuffers = GetMediaParamsBufsize(media,
-		    &lockbuf);
+		    &bufsizeMax, &lockbuf);
+		instance->ci_numBuffersMax = bufsizeMax;
 		instance->ci_lockbuf = lockbuf;
 
 		/*
@@ -3083,3 +3114,50 @@ KillCopyProc(
 	PthreadMutexattrDestroy(&mattr);
 	PthreadCondattrDestroy(&cattr);
 }
+
+/*
+ * Number of readers available to recall the files of a disk archive
+ * stream.  The readers of busy copy processes count against the
+ * dk_readers limit of the volume and the dk_host_readers limit of
+ * the host.  Returns the host of the volume in 'host'.
+ */
+static int
+dkReaders(
+	StreamInfo_t *stream,
+	host_t host)
+{
+	int hostReaders;
+	int i;
+	int readers;
+	int vsnReaders;
+
+	if (GetDiskVolHost(stream->vsn, host) == B_FALSE) {
+		(void) strcpy(host, "localhost");
+	}
+	vsnReaders = GetCfgDkReaders();
+	hostReaders = GetCfgDkHostReaders();
+
+	initCopyInstanceList(B_FALSE);
+	for (i = 0; i < CopyInstanceList->cl_entries; i++) {
+		CopyInstanceInfo_t *ci;
+
+		ci = &CopyInstanceList->cl_data[i];
+		if (ci->ci_busy == B_FALSE || ci->ci_readers == 0) {
+			continue;
+		}
+		if (strncmp(ci->ci_readVsn, stream->vsn, sizeof (vsn_t)) == 0) {
+			vsnReaders -= ci->ci_readers;
+		}
+		if (strncmp(ci->ci_readHost, host, sizeof (host_t)) == 0) {
+			hostReaders -= ci->ci_readers;
+		}
+	}
+
+	readers = MIN(vsnReaders, hostReaders);
+	if (readers > (int)stream->count) {
+		readers = (int)stream->count;
+	}
+	Trace(TR_DEBUG, "Disk readers '%s' host '%s': %d",
+	    stream->vsn, host, readers);
+	return (readers);
+}
@@ -40,6 +40,7 @@ static char *_SrcFile = __FILE__; /* Using __FILE__ makes duplicate strings */
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <unistd.h>
 #include <pthread.h>
 
@@ -92,12 +93,23 @@ static int addRequest(FileInfo_t *file);
 static void markFree(int index);
 static int getFree();
 static int isFree(int index);
+static size_t requestListSize(size_t alloc, size_t hashsize);
+static void setRequestIndex(void);
+static void initRequestIndex(void);
+static int hashRequestBucket(sam_id_t id, equ_t fseq);
+static void hashRequest(int index);
+static void unhashRequest(int index);
+static int findRequests(sam_id_t id, equ_t fseq, int **ids);
 static void createRequestMapFile(char *file_name);
 static int getFileExtent(sam_id_t id, int ext_ord, equ_t fseq,
 	sam_stage_request_t *req, FileExtentInfo_t *fe);
 static void recoverFileExtent();
 static void checkFileExtent();
 static void deleteFileExtent(sam_id_t id, int ext_ord, equ_t fseq);
+static int hashExtentBucket(sam_id_t id, int ext_ord, equ_t fseq);
+static void hashExtents(void);
+static void unhashExtents(void);
+static int findExtent(sam_id_t id, int ext_ord, equ_t fseq);
 static boolean_t createMultiVolume(sam_stage_request_t *req);
 static int waitForStageDone();
 static FileInfo_t *findNextRequest(FileInfo_t *file);
@@ -120,7 +132,7 @@ extern enum StartMode StartMode;
  * the process's address space.
  */
 StageReqs_t StageReqs = {
-	0, 0, NULL, -1, -1,
+	0, 0, NULL, 0, -1, NULL, NULL, 0,
 	PTHREAD_MUTEX_INITIALIZER,
 	PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
 	NULL, NULL
@@ -133,13 +145,25 @@ StageReqs_t StageReqs = {
  * are being used to reduce memory usage in the FileInfo structure.
  * From 4.6, this structure is written to the disk to allow sam-stagerd
  * to recover the pending requests, and to support HA-SAM.
+ * The hash table of extents is private, and is rebuilt whenever the
+ * file is mapped in.
  */
 
 static struct {
 	pthread_mutex_t		mutex;		/* protect access */
 	FileExtentHdrInfo_t	*hdr;
 	FileExtentInfo_t	*data;
-} stageExtents = { PTHREAD_MUTEX_INITIALIZER, NULL, NULL };
+	int			*hash;		/* hash table of extents */
+	int			*hashnext;	/* next extent in hash chain */
+	int			hashsize;	/* number of hash buckets */
+	int			freehint;	/* first extent that may be free */
+} stageExtents = { PTHREAD_MUTEX_INITIALIZER, NULL, NULL, NULL, NULL, 0, 0 };
+
+/* Extents follow the header in the file extents file. */
+#define	EXTENT_DATA(hdr) ((FileExtentInfo_t *)(void *)((hdr) + 1))
+
+/* Number of words in the free entry bitmap. */
+#define	FREE_WORDS(n) howmany(n, 32)
 
 /*
  * This structure is used for communicating stage completitions
@@ -450,6 +474,9 @@ CancelRequest(
 	sam_stage_request_t *req)
 {
 	int i;
+	int k;
+	int n;
+	int *ids;
 	int copy;
 	FileInfo_t *file;
 
@@ -457,10 +484,9 @@ CancelRequest(
 		int min_ext = INT_MAX;
 		int cid = -1;
 
-		/*
-		 * No choice but to scan complete list.  FIXME.
-		 */
-		for (i = 0; i < StageReqs.alloc; i++) {
+		n = findRequests(req->id, req->fseq, &ids);
+		for (k = 0; k < n; k++) {
+			i = ids[k];
 			file = &StageReqs.data[i];
 			copy = file->copy;
 
@@ -485,6 +511,9 @@ CancelRequest(
 				}
 			}
 		}
+		if (ids != NULL) {
+			SamFree(ids);
+		}
 		if (cid >= 0) {
 			CancelWork(cid);
 		}
@@ -957,6 +986,7 @@ addRequest(
 		 */
 		file->sort = index;
 		memcpy(&StageReqs.data[index], file, sizeof (FileInfo_t));
+		hashRequest(index);
 
 		if (State != NULL) {
 			State->reqEntries = StageReqs.entries;
@@ -976,6 +1006,7 @@ DeleteRequest(
 	extern StagerStateInfo_t *State;
 
 	if (id >= 0) {
+		unhashRequest(id);
 		(void) memset(&StageReqs.data[id], 0, sizeof (FileInfo_t));
 		markFree(id);
 		PthreadMutexLock(&StageReqs.entries_mutex);
@@ -1028,25 +1059,39 @@ static void
 markFree(
 	int index)
 {
+	int word = index / 32;
+
 	PthreadMutexLock(&StageReqs.free_list_mutex);
-	StageReqs.sp++;
-	StageReqs.free[StageReqs.sp] = index;
+	StageReqs.free[word] |= 1U << (index % 32);
+	if (word < StageReqs.freehint) {
+		StageReqs.freehint = word;
+	}
 	PthreadMutexUnlock(&StageReqs.free_list_mutex);
 }
 
 /*
  * Get a free entry from stage request list.
+ * The lowest numbered free entry is used.
  */
 static int
 getFree(void)
 {
 	int index = -1;
+	int words;
+	int w;
 
 	PthreadMutexLock(&StageReqs.free_list_mutex);
-	if (StageReqs.sp >= 0) {
-		index = StageReqs.free[StageReqs.sp];
-		StageReqs.sp--;
+	words = FREE_WORDS(StageReqs.alloc);
+	for (w = StageReqs.freehint; w < words; w++) {
+		if (StageReqs.free[w] != 0) {
+			int bit = ffs((int)StageReqs.free[w]) - 1;
+
+			StageReqs.free[w] &= ~(1U << bit);
+			index = w * 32 + bit;
+			break;
+		}
 	}
+	StageReqs.freehint = w;
 	PthreadMutexUnlock(&StageReqs.free_list_mutex);
 
 	return (index);
@@ -1058,17 +1103,160 @@ getFree(void)
 static int
 isFree(
 	int index)
+{
+	return ((StageReqs.free[index / 32] & (1U << (index % 32))) != 0);
+}
+
+/*
+ * Return size of the request list file.
+ */
+static size_t
+requestListSize(
+	size_t alloc,
+	size_t hashsize)
+{
+	size_t size;
+
+	size = alloc * sizeof (FileInfo_t);
+	size += roundup((FREE_WORDS(alloc) * sizeof (uint32_t)) +
+	    ((hashsize + alloc) * sizeof (int)), sizeof (uint64_t));
+	size += sizeof (StageReqFileVal_t);
+	return (size);
+}
+
+/*
+ * Set pointers to the request index and trailer in the request list.
+ */
+static void
+setRequestIndex(void)
+{
+	size_t size;
+
+	size = requestListSize(StageReqs.alloc, StageReqs.hashsize);
+	StageReqs.val = (StageReqFileVal_t *)(void *)
+	    (((char *)StageReqs.data + size) - sizeof (StageReqFileVal_t));
+	StageReqs.free = (uint32_t *)(void *)&StageReqs.data[StageReqs.alloc];
+	StageReqs.hash = (int *)(void *)
+	    (StageReqs.free + FREE_WORDS(StageReqs.alloc));
+	StageReqs.hashnext = StageReqs.hash + StageReqs.hashsize;
+}
+
+/*
+ * Initialize an empty request index.
+ * All entries are in use until marked free.
+ */
+static void
+initRequestIndex(void)
 {
 	int i;
-	int free = 0;
 
-	for (i = 0; i < StageReqs.sp; i++) {
-		if (StageReqs.free[i] == index) {
-			free = 1;
+	setRequestIndex();
+	(void) memset(StageReqs.free, 0,
+	    FREE_WORDS(StageReqs.alloc) * sizeof (uint32_t));
+	StageReqs.freehint = 0;
+	for (i = 0; i < StageReqs.hashsize; i++) {
+		StageReqs.hash[i] = -1;
+	}
+	for (i = 0; i < StageReqs.alloc; i++) {
+		StageReqs.hashnext[i] = -1;
+	}
+}
+
+/*
+ * Return hash table bucket for a file.
+ */
+static int
+hashRequestBucket(
+	sam_id_t id,
+	equ_t fseq)
+{
+	return ((int)((((uint_t)id.ino * 2654435761U) ^ (uint_t)fseq) %
+	    (uint_t)StageReqs.hashsize));
+}
+
+/*
+ * Enter request list entry in the hash table.
+ */
+static void
+hashRequest(
+	int index)
+{
+	FileInfo_t *file = &StageReqs.data[index];
+	int bucket;
+
+	bucket = hashRequestBucket(file->id, file->fseq);
+	PthreadMutexLock(&StageReqs.free_list_mutex);
+	StageReqs.hashnext[index] = StageReqs.hash[bucket];
+	StageReqs.hash[bucket] = index;
+	PthreadMutexUnlock(&StageReqs.free_list_mutex);
+}
+
+/*
+ * Remove request list entry from the hash table.
+ */
+static void
+unhashRequest(
+	int index)
+{
+	FileInfo_t *file = &StageReqs.data[index];
+	int *link;
+
+	PthreadMutexLock(&StageReqs.free_list_mutex);
+	link = &StageReqs.hash[hashRequestBucket(file->id, file->fseq)];
+	while (*link >= 0) {
+		if (*link == index) {
+			*link = StageReqs.hashnext[index];
 			break;
 		}
+		link = &StageReqs.hashnext[*link];
 	}
-	return (free);
+	StageReqs.hashnext[index] = -1;
+	PthreadMutexUnlock(&StageReqs.free_list_mutex);
+}
+
+/*
+ * Find the request list entries for a file's inode number and file
+ * system.  Returns the number of entries found and an allocated array
+ * of their identifiers in ascending order, or NULL if none found.
+ */
+static int
+findRequests(
+	sam_id_t id,
+	equ_t fseq,
+	int **ids)
+{
+	int count = 0;
+	int i;
+
+	*ids = NULL;
+	PthreadMutexLock(&StageReqs.free_list_mutex);
+	for (i = StageReqs.hash[hashRequestBucket(id, fseq)]; i >= 0;
+	    i = StageReqs.hashnext[i]) {
+		if (StageReqs.data[i].id.ino == id.ino &&
+		    StageReqs.data[i].fseq == fseq) {
+			count++;
+		}
+	}
+	if (count > 0) {
+		int n = 0;
+
+		SamMalloc(*ids, count * sizeof (int));
+		for (i = StageReqs.hash[hashRequestBucket(id, fseq)]; i >= 0;
+		    i = StageReqs.hashnext[i]) {
+			if (StageReqs.data[i].id.ino == id.ino &&
+			    StageReqs.data[i].fseq == fseq) {
+				int j;
+
+				/* Insertion sort, chains are short. */
+				for (j = n++; j > 0 && (*ids)[j - 1] > i; j--) {
+					(*ids)[j] = (*ids)[j - 1];
+				}
+				(*ids)[j] = i;
+			}
+		}
+	}
+	PthreadMutexUnlock(&StageReqs.free_list_mutex);
+	return (count);
 }
 
 /*
@@ -1101,19 +1289,19 @@ InitRequestList()
 			 *	Recover failed, allocate new list.
 			 */
 			StageReqs.alloc = max_active;
-			size = StageReqs.alloc * sizeof (FileInfo_t);
-			size += sizeof (StageReqFileVal_t);
+			StageReqs.hashsize = max_active;
+			size = requestListSize(StageReqs.alloc,
+			    StageReqs.hashsize);
 
 			SamMalloc(StageReqs.data, size);
 			(void) memset(StageReqs.data, 0, size);
 
-			StageReqs.val = (StageReqFileVal_t *)(void *)
-			    (((char *)StageReqs.data + size) -
-			    sizeof (StageReqFileVal_t));
+			setRequestIndex();
 			StageReqs.val->magic = STAGER_REQ_FILE_MAGIC;
 			StageReqs.val->version = STAGER_REQ_FILE_VERSION;
 			StageReqs.val->alloc = StageReqs.alloc;
 			StageReqs.val->size = size;
+			StageReqs.val->hashsize = StageReqs.hashsize;
 			StageReqs.val->create = time(NULL);
 			Trace(TR_DEBUG,
 			    "Malloc StageReqs.data: %0x size: %d val: %0x",
@@ -1122,13 +1310,13 @@ InitRequestList()
 			recovered = B_TRUE;
 		}
 
-		size = StageReqs.alloc * sizeof (int);
-		SamMalloc(StageReqs.free, size);
-
 		/*
-		 * Initialize free list indices.  Note the backward loop
-		 * index so we start allocating from top of event list.
+		 * Initialize free list and hash table.  Note the backward
+		 * loop index so we start allocating from top of event list.
+		 * The index of a recovered list is rebuilt from the requests
+		 * that are still valid.
 		 */
+		initRequestIndex();
 		if (recovered == B_FALSE) {
 			for (i = StageReqs.alloc-1; i >= 0; i--) {
 				markFree(i);
@@ -1143,6 +1331,7 @@ InitRequestList()
 				} else {
 					FileInfo_t *fi = &StageReqs.data[i];
 
+					hashRequest(i);
 					StageReqs.entries++;
 
 					Trace(TR_MISC,
@@ -1162,51 +1351,6 @@ InitRequestList()
 			Trace(TR_DEBUG, "# of pending requests: %d",
 			    StageReqs.entries);
 		}
-	} else {
-		/*
-		 * We'll never hit this pass, whenever InitRequestList called,
-		 * StageReqs.data = NULL. But leave it as it was.
-		 */
-
-		/*
-		 * Increase size of request list if list hasn't already exceeded
-		 * maximum number of active stages.
-		 */
-
-		if (StageReqs.alloc < max_active) {
-			int old = StageReqs.alloc;
-			StageReqFileVal_t *oval;
-
-			StageReqs.alloc += STAGE_REQUESTS_CHUNKSIZE;
-			if (StageReqs.alloc > max_active)
-				StageReqs.alloc = max_active;
-
-			size = StageReqs.alloc * sizeof (FileInfo_t);
-			size += sizeof (StageReqFileVal_t);
-			StageReqs.data = realloc(StageReqs.data, size);
-
-			oval = (StageReqFileVal_t *)(void *)
-			    ((StageReqs.data + StageReqs.val->size) -
-			    sizeof (StageReqFileVal_t));
-			StageReqs.val = (StageReqFileVal_t *)(void *)
-			    ((StageReqs.data + size) -
-			    sizeof (StageReqFileVal_t));
-			StageReqs.val->size = size;
-			ASSERT((long)StageReqs.val > (long)oval);
-			memmove(StageReqs.val, oval,
-			    sizeof (StageReqFileVal_t));
-			size = (size_t)(StageReqs.val - oval);
-			(void) memset(oval, 0, size);
-
-			size = StageReqs.alloc * sizeof (int);
-			StageReqs.free = realloc(StageReqs.free, size);
-
-			/*
-			 * Initialize new free list indices.
-			 */
-			for (i = StageReqs.alloc-1; i >= old; i--)
-				markFree(i);
-		}
 	}
 
 	if (recovered == B_FALSE) {
@@ -1214,6 +1358,9 @@ InitRequestList()
 		StageReqs.data =
 		    (FileInfo_t *)MapInFile(SharedInfo->si_stageReqsFile,
 		    O_RDWR, NULL);
+		if (StageReqs.data != NULL) {
+			setRequestIndex();
+		}
 	}
 
 	return (0);
@@ -1234,8 +1381,7 @@ createRequestMapFile(
 	fd = open(file_name, O_WRONLY | O_CREAT | O_TRUNC, 0664);
 	ASSERT(fd != -1);
 
-	size = StageReqs.alloc * sizeof (FileInfo_t);
-	size += sizeof (StageReqFileVal_t);
+	size = requestListSize(StageReqs.alloc, StageReqs.hashsize);
 	num_written = write(fd, StageReqs.data, size);
 	ASSERT(num_written == size);
 
@@ -1297,6 +1443,7 @@ getFileExtent(
 	FileExtentInfo_t *raddr)
 {
 	FileExtentInfo_t *extent = NULL;
+	int bucket;
 	int i;
 	int ret = -1;
 
@@ -1319,30 +1466,20 @@ getFileExtent(
 			PthreadMutexUnlock(&stageExtents.mutex);
 			return (-1);
 		}
-		stageExtents.data = (FileExtentInfo_t *)(void *)
-		    (stageExtents.hdr + sizeof (FileExtentHdrInfo_t));
-	} else {
-		if (stageExtents.hdr->fh_entries > 0) {
-			FileExtentInfo_t *entry;
-
-			for (i = 0; i < stageExtents.hdr->fh_alloc; i++) {
-				entry = &stageExtents.data[i];
-				if (entry != NULL &&
-				    entry->fe_id.ino == id.ino &&
-				    entry->fe_id.gen == id.gen &&
-				    entry->fe_fseq == fseq &&
-				    entry->fe_extOrd == ext_ord) {
-					extent = entry;
-					break;
-				}
-			}
+		stageExtents.data = EXTENT_DATA(stageExtents.hdr);
+		hashExtents();
+	} else if (stageExtents.hdr->fh_entries > 0) {
+		i = findExtent(id, ext_ord, fseq);
+		if (i >= 0) {
+			extent = &stageExtents.data[i];
 		}
 	}
 	if (req != NULL) {
-		i = 0;
+		i = stageExtents.freehint;
 		while (extent == NULL) {
 			size_t osz;
 			size_t nsz;
+			int grow;
 			FileExtentHdrInfo_t *nhdr;
 
 			/*
@@ -1390,6 +1527,10 @@ getFileExtent(
 				}
 				}
 				stageExtents.hdr->fh_entries++;
+				stageExtents.freehint = i + 1;
+				bucket = hashExtentBucket(id, ext_ord, fseq);
+				stageExtents.hashnext[i] = stageExtents.hash[bucket];
+				stageExtents.hash[bucket] = i;
 				break;
 			}
 			if (extent != NULL) {
@@ -1397,15 +1538,17 @@ getFileExtent(
 			}
 
 			/*
-			 * Increase size of file extension.
+			 * Increase size of file extension.  The size is
+			 * doubled so a large number of extents are added
+			 * in linear time.
 			 */
-
+			grow = MAX(STAGE_EXTENTS_CHUNKSIZE,
+			    stageExtents.hdr->fh_alloc);
 			osz = nsz = sizeof (FileExtentHdrInfo_t);
 			osz += sizeof (FileExtentInfo_t) *
 			    stageExtents.hdr->fh_alloc;
 			nsz += sizeof (FileExtentInfo_t) *
-			    (stageExtents.hdr->fh_alloc +
-			    STAGE_EXTENTS_CHUNKSIZE);
+			    (stageExtents.hdr->fh_alloc + grow);
 
 			SamMalloc(nhdr, nsz);
 			(void) memset(nhdr, 0, nsz);
@@ -1432,14 +1575,12 @@ getFileExtent(
 				return (-1);
 			}
 
-			stageExtents.data =
-			    (FileExtentInfo_t *)(void *)(stageExtents.hdr +
-			    sizeof (FileExtentHdrInfo_t));
+			stageExtents.data = EXTENT_DATA(stageExtents.hdr);
 
-			stageExtents.hdr->fh_alloc += STAGE_EXTENTS_CHUNKSIZE;
+			stageExtents.hdr->fh_alloc += grow;
 			Trace(TR_DEBUG, "Added %d extensions, current: %d",
-			    STAGE_EXTENTS_CHUNKSIZE,
-			    stageExtents.hdr->fh_alloc);
+			    grow, stageExtents.hdr->fh_alloc);
+			hashExtents();
 		}
 		if (extent != NULL) {
 			extent->fe_count++;
@@ -1501,25 +1642,28 @@ deleteFileExtent(
 	PthreadMutexLock(&stageExtents.mutex);
 	traceFileExtents(TR_MISC);
 
-	if (stageExtents.hdr->fh_entries > 0) {
+	if (stageExtents.hdr->fh_entries > 0 &&
+	    (i = findExtent(id, ext_ord, fseq)) >= 0) {
 		FileExtentInfo_t *entry;
-		for (i = 0; i < stageExtents.hdr->fh_alloc; i++) {
-			entry = &stageExtents.data[i];
-			if (entry->fe_id.ino == id.ino &&
-			    entry->fe_id.gen == id.gen &&
-			    entry->fe_fseq == fseq &&
-			    entry->fe_extOrd == ext_ord) {
-				Trace(TR_FILES, "Delete file extent: "
-				    "inode: %d.%d ext_ord: %d count: %d",
-				    entry->fe_id.ino, entry->fe_id.gen,
-				    entry->fe_extOrd, entry->fe_count);
-				if (--entry->fe_count > 0) {
-					break;
-				}
-				(void) memset(&stageExtents.data[i], 0,
-				    sizeof (FileExtentInfo_t));
-				stageExtents.hdr->fh_entries--;
-				break;
+		int *link;
+
+		entry = &stageExtents.data[i];
+		Trace(TR_FILES, "Delete file extent: "
+		    "inode: %d.%d ext_ord: %d count: %d",
+		    entry->fe_id.ino, entry->fe_id.gen,
+		    entry->fe_extOrd, entry->fe_count);
+		if (--entry->fe_count <= 0) {
+			link = &stageExtents.hash[
+			    hashExtentBucket(id, ext_ord, fseq)];
+			while (*link != i) {
+				link = &stageExtents.hashnext[*link];
+			}
+			*link = stageExtents.hashnext[i];
+			(void) memset(&stageExtents.data[i], 0,
+			    sizeof (FileExtentInfo_t));
+			stageExtents.hdr->fh_entries--;
+			if (i < stageExtents.freehint) {
+				stageExtents.freehint = i;
 			}
 		}
 	}
@@ -1534,10 +1678,98 @@ deleteFileExtent(
 		    stageExtents.hdr, sz);
 		stageExtents.hdr = NULL;
 		stageExtents.data = NULL;
+		unhashExtents();
 	}
 	PthreadMutexUnlock(&stageExtents.mutex);
 }
 
+/*
+ * Return hash table bucket for a file extent.
+ */
+static int
+hashExtentBucket(
+	sam_id_t id,
+	int ext_ord,
+	equ_t fseq)
+{
+	return ((int)((((uint_t)id.ino * 2654435761U) ^ (uint_t)fseq ^
+	    ((uint_t)ext_ord << 16)) % (uint_t)stageExtents.hashsize));
+}
+
+/*
+ * Build hash table for the mapped in file extents.
+ */
+static void
+hashExtents(void)
+{
+	int i;
+
+	unhashExtents();
+	stageExtents.hashsize = stageExtents.hdr->fh_alloc;
+	SamMalloc(stageExtents.hash, stageExtents.hashsize * sizeof (int));
+	SamMalloc(stageExtents.hashnext,
+	    stageExtents.hdr->fh_alloc * sizeof (int));
+	for (i = 0; i < stageExtents.hashsize; i++) {
+		stageExtents.hash[i] = -1;
+	}
+	stageExtents.freehint = stageExtents.hdr->fh_alloc;
+	for (i = stageExtents.hdr->fh_alloc - 1; i >= 0; i--) {
+		FileExtentInfo_t *entry = &stageExtents.data[i];
+		int bucket;
+
+		stageExtents.hashnext[i] = -1;
+		if (entry->fe_id.ino == 0) {
+			stageExtents.freehint = i;
+			continue;
+		}
+		bucket = hashExtentBucket(entry->fe_id, entry->fe_extOrd,
+		    entry->fe_fseq);
+		stageExtents.hashnext[i] = stageExtents.hash[bucket];
+		stageExtents.hash[bucket] = i;
+	}
+}
+
+/*
+ * Free hash table for file extents.
+ */
+static void
+unhashExtents(void)
+{
+	if (stageExtents.hash != NULL) {
+		SamFree(stageExtents.hash);
+		SamFree(stageExtents.hashnext);
+		stageExtents.hash = NULL;
+		stageExtents.hashnext = NULL;
+	}
+	stageExtents.hashsize = 0;
+	stageExtents.freehint = 0;
+}
+
+/*
+ * Find file extent.  Returns the extent's index or -1 if not found.
+ */
+static int
+findExtent(
+	sam_id_t id,
+	int ext_ord,
+	equ_t fseq)
+{
+	int i;
+
+	for (i = stageExtents.hash[hashExtentBucket(id, ext_ord, fseq)];
+	    i >= 0; i = stageExtents.hashnext[i]) {
+		FileExtentInfo_t *entry = &stageExtents.data[i];
+
+		if (entry->fe_id.ino == id.ino &&
+		    entry->fe_id.gen == id.gen &&
+		    entry->fe_fseq == fseq &&
+		    entry->fe_extOrd == ext_ord) {
+			break;
+		}
+	}
+	return (i);
+}
+
 /*
  * Initialize stage done list.
  */
@@ -1658,6 +1890,8 @@ findNextRequest(
 {
 	int copy;
 	int i;
+	int n;
+	int *ids;
 	FileInfo_t *entry;
 	FileInfo_t *next = NULL;
 
@@ -1665,22 +1899,22 @@ findNextRequest(
 
 	if (StageReqs.entries > 0) {
 
-		for (i = 0; i < StageReqs.alloc; i++) {
-			if (isFree(i) == 0) {
-				entry = &StageReqs.data[i];
-				if (GET_FLAG(entry->flags, FI_EXTENDED) &&
-				    file->id.ino == entry->id.ino &&
-				    file->id.gen == entry->id.gen &&
-				    file->fseq == entry->fseq) {
-
-					if (file->ar[copy].ext_ord + 1 ==
-					    entry->ar[copy].ext_ord) {
-						next = entry;
-						break;
-					}
+		n = findRequests(file->id, file->fseq, &ids);
+		for (i = 0; i < n; i++) {
+			entry = &StageReqs.data[ids[i]];
+			if (GET_FLAG(entry->flags, FI_EXTENDED) &&
+			    file->id.gen == entry->id.gen) {
+
+				if (file->ar[copy].ext_ord + 1 ==
+				    entry->ar[copy].ext_ord) {
+					next = entry;
+					break;
 				}
 			}
 		}
+		if (ids != NULL) {
+			SamFree(ids);
+		}
 	}
 	return (next);
 }
@@ -1693,7 +1927,7 @@ traceFileExtents(
 {
 	int i;
 
-	if (stageExtents.hdr == NULL) {
+	if (stageExtents.hdr == NULL || (*TraceFlags & (1 << flag)) == 0) {
 		return;
 	}
 
@@ -1723,7 +1957,6 @@ traceFileExtents(
 static int
 recoverRequestList(void)
 {
-	size_t count;
 	size_t size;
 	struct stat buf;
 
@@ -1744,18 +1977,17 @@ recoverRequestList(void)
 	if (size <= sizeof (StageReqFileVal_t)) {
 		goto out;
 	}
-	count = (size - sizeof (StageReqFileVal_t)) / sizeof (FileInfo_t);
-	if (count == 0 ||
-	    (count * sizeof (FileInfo_t) + sizeof (StageReqFileVal_t)) != size)
-		goto out;
 
 	StageReqs.val = (StageReqFileVal_t *)(void *)
 	    (((char *)StageReqs.data + size) - sizeof (StageReqFileVal_t));
 
 	if (StageReqs.val->magic != STAGER_REQ_FILE_MAGIC ||
 	    StageReqs.val->version != STAGER_REQ_FILE_VERSION ||
-	    StageReqs.val->alloc != count ||
-	    StageReqs.val->size != size) {
+	    StageReqs.val->alloc == 0 ||
+	    StageReqs.val->hashsize == 0 ||
+	    StageReqs.val->size != size ||
+	    requestListSize(StageReqs.val->alloc,
+	    StageReqs.val->hashsize) != size) {
 
 		Trace(TR_DEBUG, "Header error in old StageReqs.data, "
 		    "magic: %0x version: %0x alloc: %d size: %d",
@@ -1763,7 +1995,8 @@ recoverRequestList(void)
 		    StageReqs.val->alloc, (int)StageReqs.val->size);
 		goto out;
 	}
-	StageReqs.alloc = count;
+	StageReqs.alloc = StageReqs.val->alloc;
+	StageReqs.hashsize = StageReqs.val->hashsize;
 	Trace(TR_MISC, "Recovered request list: %s, alloc: %d",
 	    SharedInfo->si_stageReqsFile, (int)StageReqs.alloc);
 	return (0);
@@ -2069,8 +2302,8 @@ recoverFileExtent(void)
 		return;
 	}
 
-	stageExtents.data = (FileExtentInfo_t *)(void *)(stageExtents.hdr +
-	    sizeof (FileExtentHdrInfo_t));
+	stageExtents.data = EXTENT_DATA(stageExtents.hdr);
+	hashExtents();
 	Trace(TR_MISC, "Stage request extents recovered");
 }
 
@@ -2111,6 +2344,7 @@ checkFileExtent(void)
 			ASSERT(stageExtents.hdr->fh_entries >= 0);
 		}
 	}
+	hashExtents();
 
 	if (stageExtents.hdr->fh_entries == 0) {
 		size_t sz;
@@ -2124,6 +2358,7 @@ checkFileExtent(void)
 		    stageExtents.hdr, sz);
 		stageExtents.hdr = NULL;
 		stageExtents.data = NULL;
+		unhashExtents();
 	}
 	PthreadMutexUnlock(&stageExtents.mutex);
 }
@@ -45,7 +45,7 @@
 /* Structures. */
 
 #define	STAGER_REQ_FILE_MAGIC	05041536
-#define	STAGER_REQ_FILE_VERSION	60522	/* StageReq file version (YMMDD) */
+#define	STAGER_REQ_FILE_VERSION	261019	/* StageReq file (YYMMDD) */
 
 typedef struct StageReqFileVal {
 	uint32_t	magic;
@@ -53,21 +53,28 @@ typedef struct StageReqFileVal {
 	time_t		create;
 	size_t		alloc;
 	size_t		size;
+	size_t		hashsize;	/* number of request hash buckets */
 } StageReqFileVal_t;
 
 /*
  * This structure contains all stage requests in progress.
  * The request list is implemented as an index file that is mapped to
- * the process's address space.
+ * the process's address space.  The file holds the requests, then
+ * the request index: a bitmap of the free entries and a hash table of
+ * the entries by inode number and file system, chained through
+ * hashnext.  The StageReqFileVal trailer is last.
  */
 typedef struct StageReqs {
 	size_t		entries;	/* number of entries in use */
 	size_t		alloc;		/* size of allocated space */
-	int		*free;		/* free list pointer */
-	int		sp;		/* stack pointer for free list */
+	uint32_t	*free;		/* bitmap of free entries */
+	int		freehint;	/* first bitmap word with a free entry */
 	int		requeue;	/* requeue link pointer */
+	int		*hash;		/* hash table of entries */
+	int		*hashnext;	/* next entry in hash chain */
+	int		hashsize;	/* number of hash buckets */
 
-	pthread_mutex_t	free_list_mutex; /* protect access to free list */
+	pthread_mutex_t	free_list_mutex; /* protect free list and hash table */
 	pthread_mutex_t	entries_mutex;	/* protect access to num of entries */
 	pthread_cond_t	entries_cond;
 
@@ -109,6 +109,7 @@ static void removeSharedMapFile();
 static void makeStagerDirs();
 static int createFilesystemReader();
 static void *filesystemReader();
+static void receiveRequest(sam_stage_request_t *request);
 static int createScheduler();
 static int createMigrator();
 static void createState();
@@ -745,24 +746,22 @@ createFilesystemReader(void)
 /*
  * Filesystem reader thread.  This thread simply receives stage file
  * requests from the filesystem, adds request to list of active
- * stages and sends it to the scheduler.
+ * stages and sends it to the scheduler.  The requests of a file list
+ * stage are received in one batch.
  */
 static void*
 filesystemReader(void)
 {
-	static int maxActiveExceeded = 0;
+	static sam_stage_batch_t batch;
 	int syserr;
-	int status;
-	int id;
+	int i;
 	sam_stage_arg_t arg;
-	sam_stage_request_t request;
 
 	Trace(TR_DEBUG, "File system reader started");
 
-	(void) memset(&request, 0, sizeof (request));
 	(void) memset(&arg, 0, sizeof (arg));
-	arg.stager_cmd = STAGER_getrequest;
-	arg.p.request.ptr = &request;
+	arg.stager_cmd = STAGER_getrequests;
+	arg.p.batch.ptr = &batch;
 
 	while (infiniteLoop) {
 
@@ -775,7 +774,10 @@ filesystemReader(void)
 			}
 
 			if (IdleStager == B_TRUE) {
-				ErrorRequest(&request, ECANCELED);
+				for (i = 0; i < batch.count; i++) {
+					ErrorRequest(&batch.request[i],
+					    ECANCELED);
+				}
 				continue;
 			}
 
@@ -791,52 +793,66 @@ filesystemReader(void)
 			continue;
 		}
 
-		Trace(TR_FILES, "Received file inode: %d.%d fseq: %d",
-		    request.id.ino, request.id.gen, request.fseq);
+		for (i = 0; i < batch.count; i++) {
+			receiveRequest(&batch.request[i]);
+		}
+	}
 
-		/*
-		 * Check if request to cancel stage.
-		 */
-		if (request.flags & STAGE_CANCEL) {
-			CancelRequest(&request);
+	Trace(TR_DEBUG, "File system reader completed");
+	return (NULL);
+}
 
-		} else {
+/*
+ * Receive a stage file request from the filesystem.
+ */
+static void
+receiveRequest(
+	sam_stage_request_t *request)
+{
+	static int maxActiveExceeded = 0;
+	int status;
+	int id;
+
+	Trace(TR_FILES, "Received file inode: %d.%d fseq: %d",
+	    request->id.ino, request->id.gen, request->fseq);
+
+	/*
+	 * Check if request to cancel stage.
+	 */
+	if (request->flags & STAGE_CANCEL) {
+		CancelRequest(request);
+		return;
+	}
+
+	status = REQUEST_LIST_FULL;
+	/*
+	 * Add to request list.  If okay, send it to
+	 * scheduler.
+	 */
+	while (status == REQUEST_LIST_FULL) {
+		id = AddFile(request, &status);
 
-			status = REQUEST_LIST_FULL;
+		if (status == REQUEST_READY) {
+			ASSERT(id >= 0);
+			(void) SendToScheduler(id);
+		} else if (status == REQUEST_LIST_FULL) {
 			/*
-			 * Add to request list.  If okay, send it to
-			 * scheduler.
+			 * Request list full.  Wait for more
+			 * space to become available.  Another
+			 * thread is checking for files that
+			 * have finished staging and is freeing
+			 * up request space.
 			 */
-			while (status == REQUEST_LIST_FULL) {
-				id = AddFile(&request, &status);
-
-				if (status == REQUEST_READY) {
-					ASSERT(id >= 0);
-					(void) SendToScheduler(id);
-				} else if (status == REQUEST_LIST_FULL) {
-					/*
-					 * Request list full.  Wait for more
-					 * space to become available.  Another
-					 * thread is checking for files that
-					 * have finished staging and is freeing
-					 * up request space.
-					 */
-					maxActiveExceeded++;
-					if (maxActiveExceeded >
-					    MAX_ACTIVE_EXCEEDED_MSG) {
-						Trace(TR_DEBUG, "Max active "
-						    "stages exceeded");
-						SendCustMsg(HERE, 19010);
-						maxActiveExceeded = 0;
-					}
-					sleep(2);
-				}
+			maxActiveExceeded++;
+			if (maxActiveExceeded > MAX_ACTIVE_EXCEEDED_MSG) {
+				Trace(TR_DEBUG, "Max active "
+				    "stages exceeded");
+				SendCustMsg(HERE, 19010);
+				maxActiveExceeded = 0;
 			}
+			sleep(2);
 		}
 	}
-
-	Trace(TR_DEBUG, "File system reader completed");
-	return (NULL);
 }
 
 /*
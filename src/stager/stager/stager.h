@@ -94,6 +94,12 @@ void CheckLogFile(char *name);
 void LogIt(LogType_t type, FileInfo_t *file);
 void LogStageStart(FileInfo_t *file);
 
+/*
+ * Define prototypes in recall_order.c
+ */
+boolean_t OrderRecall(StreamInfo_t *stream, FileInfo_t **sortList,
+	int count);
+
 /*
  * Define prototypes in readcmd.c
  */
@@ -110,6 +116,8 @@ size_t GetCfgProbeBufsize();
 int GetCfgNumDrives();
 int GetCfgDirectio();
 int GetCfgDirectioMin();
+int GetCfgDkReaders();
+int GetCfgDkHostReaders();
 sam_stager_drives_t *GetCfgDrives();
 sam_stager_streams_t *GetCfgStreamParams(media_t media);
 
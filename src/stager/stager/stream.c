@@ -88,6 +88,7 @@ static void separatePositions(StreamInfo_t *stream, FileInfo_t **sortList);
 static void sortStream(StreamInfo_t *stream, FileInfo_t **sortList);
 static int comparePosition(const void *p1, const void *p2);
 static boolean_t addActiveStream(StreamInfo_t *stream, int id);
+static void markDuplicate(StreamInfo_t *stream, FileInfo_t *file);
 static boolean_t appendActiveStream(StreamInfo_t *stream, FileInfo_t *last,
     int id);
 static void checkStreamLimits(StreamInfo_t *stream, FileInfo_t *file);
@@ -303,6 +304,36 @@ DeleteStream(
 	RemoveMapFile(fullpath, stream, sizeof (StreamInfo_t));
 }
 
+/*
+ * Order inactive stream for recall before it is sent to a copy
+ * process.  The stream is sorted by position, which also marks
+ * duplicate requests, then reordered by the volume's geometry.
+ * Stream should be locked on entry to this function.
+ */
+void
+OrderStream(
+	StreamInfo_t *stream)
+{
+	FileInfo_t **sortList;
+
+	/*
+	 * Not reordered if the first file's disk cache is already open,
+	 * ie. multivolume or error retry, it must be staged first.
+	 */
+	if (stream->diskarch || stream->thirdparty || stream->context != 0 ||
+	    GET_FLAG(stream->flags, SR_DCACHE_CLOSE) ||
+	    stream->count < 3) {
+		return;
+	}
+
+	sortList = makeSortList(stream);
+	qsort(sortList, stream->count, sizeof (FileInfo_t *), comparePosition);
+	if (OrderRecall(stream, sortList, stream->count)) {
+		SET_FLAG(stream->flags, SR_ORDERED);
+	}
+	sortStream(stream, sortList);
+}
+
 /*
  * Add stage file request to an existing stream.  Returns TRUE
  * if the request was successfully added.  The existing stream can
@@ -547,9 +578,13 @@ addActiveStream(
 
 	/*
 	 * If disk archive its not necessary to sort, append to end
-	 * of the active stream.
+	 * of the active stream.  If the stream is in recall order
+	 * the files are no longer sorted by position, also append.
 	 */
-	if (stream->diskarch) {
+	if (stream->diskarch || GET_FLAG(stream->flags, SR_ORDERED)) {
+		if (stream->diskarch == B_FALSE) {
+			markDuplicate(stream, file);
+		}
 		PthreadMutexLock(&last->mutex);
 		added = appendActiveStream(stream, last, id);
 
@@ -672,6 +707,29 @@ appendActiveStream(
 	return (added);
 }
 
+/*
+ * Mark a request as duplicate if the same file at the same position
+ * is already in the stream.  The position insert does this through
+ * comparePosition(), a stream in recall order is not in position
+ * order so each file is checked.  Stream should be locked on entry
+ * to this function.
+ */
+static void
+markDuplicate(
+	StreamInfo_t *stream,
+	FileInfo_t *file)
+{
+	FileInfo_t *f;
+	int id;
+
+	id = stream->first;
+	while (id >= 0 && GET_FLAG(file->flags, FI_DUPLICATE) == 0) {
+		f = GetFile(id);
+		(void) comparePosition(&file, &f);
+		id = f->next;
+	}
+}
+
 /*
  * Construct list of stream pointers.  This list is used
  * in performing sorts.  The actual list is private to this
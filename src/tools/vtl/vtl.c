@@ -0,0 +1,832 @@
+/*
+ * vtl.c - virtual tape library.
+ *
+ * A file backed media changer and tape drives with modelled load,
+ * locate and transfer times.  See vtl.h.
+ *
+ * Each volume VSN is kept in the library directory as VSN.map, the end
+ * of data and the filemark addresses, and if data is kept, VSN holding
+ * the blocks at their address times the block size.  Calls must be
+ * serialized by the caller.
+ */
+
+/*
+ *    SAM-QFS_notice_begin
+ *
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at pkg/OPENSOLARIS.LICENSE
+ * or https://illumos.org/license/CDDL.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at pkg/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+/*
+ * Copyright 2009 Sun Microsystems, Inc.  All rights reserved.
+ * Use is subject to license terms.
+ *
+ *    SAM-QFS_notice_end
+ */
+
+#ifdef __STDC__
+#pragma ident "$Revision: 1.1 $"
+#endif /* __STDC__ */
+
+/* ANSI C headers. */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* POSIX headers. */
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* Local headers. */
+#include "vtl.h"
+
+/* Macros. */
+#define	VSN_LEN 16
+#define	VSN_FMT "VT%04d"
+
+/* Structures. */
+struct Volume {
+	char	VoVsn[VSN_LEN];
+	long long VoEod;		/* end of data block address */
+	long long *VoFm;		/* filemark addresses ascending */
+	int	VoFmCount;
+	int	VoFmAlloc;
+	int	VoDrive;		/* loaded in drive, -1 if in slot */
+	int	VoFd;			/* data file when loaded */
+};
+
+struct Drive {
+	int	DrVolume;		/* loaded volume, -1 if empty */
+	long long DrPos;		/* block address of the head */
+	double	DrClock;
+};
+
+struct Vtl {
+	char	*VtDir;
+	VtlParams_t VtParams;
+	long long VtBlocks;		/* blocks on a volume */
+	long long VtWrapBlocks;		/* blocks in a wrap */
+	double	VtChanger;		/* changer clock */
+	VtlStats_t VtStats;
+	struct Volume *VtVolumes;
+	int	VtVolumeCount;
+	struct Drive *VtDrives;
+	int	VtDriveCount;
+};
+
+/* Private functions. */
+static struct Drive *getDrive(Vtl_t *vtl, int drive, int loaded);
+static int readMap(Vtl_t *vtl, struct Volume *vo);
+static int writeMap(Vtl_t *vtl, struct Volume *vo);
+static void truncateVolume(struct Volume *vo, long long block);
+static int nextFilemark(struct Volume *vo, long long block);
+static double lpos(Vtl_t *vtl, long long block);
+static void locate(Vtl_t *vtl, struct Drive *dr, long long block);
+
+
+/*
+ * Open a library in a directory.  Volumes not in the directory are
+ * created empty.
+ */
+Vtl_t *
+VtlOpen(
+	char *dir,
+	int drives,
+	int volumes,
+	VtlParams_t *params)
+{
+	Vtl_t *vtl;
+	int i;
+
+	if (drives <= 0 || volumes <= 0 || params->VpBlockSize <= 0 ||
+	    params->VpWraps <= 0 || params->VpBandwidth <= 0 ||
+	    params->VpCapacity < params->VpBlockSize * params->VpWraps) {
+		errno = EINVAL;
+		return (NULL);
+	}
+	if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+		return (NULL);
+	}
+
+	vtl = calloc(1, sizeof (Vtl_t));
+	if (vtl == NULL) {
+		return (NULL);
+	}
+	vtl->VtDir = strdup(dir);
+	vtl->VtParams = *params;
+	vtl->VtBlocks = params->VpCapacity / params->VpBlockSize;
+	vtl->VtWrapBlocks = vtl->VtBlocks / params->VpWraps;
+	vtl->VtVolumes = calloc(volumes, sizeof (struct Volume));
+	vtl->VtDrives = calloc(drives, sizeof (struct Drive));
+	if (vtl->VtDir == NULL || vtl->VtVolumes == NULL ||
+	    vtl->VtDrives == NULL) {
+		VtlClose(vtl);
+		errno = ENOMEM;
+		return (NULL);
+	}
+
+	for (i = 0; i < volumes; i++) {
+		struct Volume *vo = &vtl->VtVolumes[i];
+
+		(void) snprintf(vo->VoVsn, sizeof (vo->VoVsn), VSN_FMT, i);
+		vo->VoDrive = -1;
+		vo->VoFd = -1;
+		vtl->VtVolumeCount++;
+		if (readMap(vtl, vo) != 0) {
+			VtlClose(vtl);
+			return (NULL);
+		}
+	}
+	for (i = 0; i < drives; i++) {
+		vtl->VtDrives[i].DrVolume = -1;
+	}
+	vtl->VtDriveCount = drives;
+	return (vtl);
+}
+
+
+/*
+ * Close library.  Loaded volumes are put back in their slots.
+ */
+void
+VtlClose(
+	Vtl_t *vtl)
+{
+	int i;
+
+	for (i = 0; i < vtl->VtDriveCount; i++) {
+		if (vtl->VtDrives[i].DrVolume >= 0) {
+			(void) VtlUnload(vtl, i);
+		}
+	}
+	for (i = 0; i < vtl->VtVolumeCount; i++) {
+		free(vtl->VtVolumes[i].VoFm);
+	}
+	free(vtl->VtVolumes);
+	free(vtl->VtDrives);
+	free(vtl->VtDir);
+	free(vtl);
+}
+
+
+/*
+ * Return volume's VSN.
+ */
+char *
+VtlVsn(
+	Vtl_t *vtl,
+	int volume)
+{
+	return (vtl->VtVolumes[volume].VoVsn);
+}
+
+
+/*
+ * Return operation counters.
+ */
+void
+VtlGetStats(
+	Vtl_t *vtl,
+	VtlStats_t *stats)
+{
+	*stats = vtl->VtStats;
+}
+
+
+/*
+ * Load a volume in a drive.  The changer starts the move when both the
+ * drive and the changer are free.  The volume is positioned at the
+ * beginning of the tape.
+ */
+int
+VtlLoad(
+	Vtl_t *vtl,
+	int drive,
+	int volume)
+{
+	struct Drive *dr;
+	struct Volume *vo;
+	double start;
+
+	if ((dr = getDrive(vtl, drive, 0)) == NULL) {
+		return (-1);
+	}
+	if (volume < 0 || volume >= vtl->VtVolumeCount) {
+		errno = EINVAL;
+		return (-1);
+	}
+	vo = &vtl->VtVolumes[volume];
+	if (dr->DrVolume >= 0 || vo->VoDrive >= 0) {
+		errno = EBUSY;
+		return (-1);
+	}
+
+	if (vtl->VtParams.VpData) {
+		char path[1024];
+
+		(void) snprintf(path, sizeof (path), "%s/%s",
+		    vtl->VtDir, vo->VoVsn);
+		vo->VoFd = open(path, O_RDWR | O_CREAT, 0644);
+		if (vo->VoFd < 0) {
+			return (-1);
+		}
+	}
+
+	start = dr->DrClock;
+	if (vtl->VtChanger > start) {
+		start = vtl->VtChanger;
+	}
+	dr->DrClock = start + vtl->VtParams.VpLoadTime;
+	vtl->VtChanger = dr->DrClock;
+	vtl->VtStats.VsLoads++;
+	vtl->VtStats.VsLoadTime += vtl->VtParams.VpLoadTime;
+
+	dr->DrVolume = volume;
+	dr->DrPos = 0;
+	vo->VoDrive = drive;
+	return (0);
+}
+
+
+/*
+ * Unload the volume in a drive.  The volume is rewound and then moved
+ * back to its slot.
+ */
+int
+VtlUnload(
+	Vtl_t *vtl,
+	int drive)
+{
+	struct Drive *dr;
+	struct Volume *vo;
+	double start;
+	int ret;
+
+	if ((dr = getDrive(vtl, drive, 1)) == NULL) {
+		return (-1);
+	}
+	vo = &vtl->VtVolumes[dr->DrVolume];
+
+	locate(vtl, dr, 0);
+	start = dr->DrClock;
+	if (vtl->VtChanger > start) {
+		start = vtl->VtChanger;
+	}
+	dr->DrClock = start + vtl->VtParams.VpUnloadTime;
+	vtl->VtChanger = dr->DrClock;
+	vtl->VtStats.VsLoadTime += vtl->VtParams.VpUnloadTime;
+
+	ret = writeMap(vtl, vo);
+	if (vo->VoFd >= 0) {
+		(void) close(vo->VoFd);
+		vo->VoFd = -1;
+	}
+	vo->VoDrive = -1;
+	dr->DrVolume = -1;
+	return (ret);
+}
+
+
+/*
+ * Return volume loaded in drive, -1 if none.
+ */
+int
+VtlLoaded(
+	Vtl_t *vtl,
+	int drive)
+{
+	struct Drive *dr;
+
+	if ((dr = getDrive(vtl, drive, 0)) == NULL) {
+		return (-1);
+	}
+	return (dr->DrVolume);
+}
+
+
+/*
+ * Return drive's clock.
+ */
+double
+VtlClock(
+	Vtl_t *vtl,
+	int drive)
+{
+	return (vtl->VtDrives[drive].DrClock);
+}
+
+
+/*
+ * Advance drive's clock, ie. the drive was idle.
+ */
+void
+VtlSetClock(
+	Vtl_t *vtl,
+	int drive,
+	double clock)
+{
+	if (clock > vtl->VtDrives[drive].DrClock) {
+		vtl->VtDrives[drive].DrClock = clock;
+	}
+}
+
+
+/*
+ * Rewind to the beginning of the tape.
+ */
+int
+VtlRewind(
+	Vtl_t *vtl,
+	int drive)
+{
+	struct Drive *dr;
+
+	if ((dr = getDrive(vtl, drive, 1)) == NULL) {
+		return (-1);
+	}
+	locate(vtl, dr, 0);
+	return (0);
+}
+
+
+/*
+ * Locate to a block address.  A locate past the end of data leaves
+ * the tape at the end of data.
+ */
+int
+VtlLocate(
+	Vtl_t *vtl,
+	int drive,
+	long long block)
+{
+	struct Drive *dr;
+	struct Volume *vo;
+
+	if ((dr = getDrive(vtl, drive, 1)) == NULL) {
+		return (-1);
+	}
+	vo = &vtl->VtVolumes[dr->DrVolume];
+	if (block < 0) {
+		errno = EINVAL;
+		return (-1);
+	}
+	if (block > vo->VoEod) {
+		locate(vtl, dr, vo->VoEod);
+		errno = EIO;
+		return (-1);
+	}
+	locate(vtl, dr, block);
+	return (0);
+}
+
+
+/*
+ * Space over filemarks.  Forward leaves the tape after the count'th
+ * filemark, backward leaves it before the count'th filemark.
+ */
+int
+VtlSpaceFile(
+	Vtl_t *vtl,
+	int drive,
+	int count)
+{
+	struct Drive *dr;
+	struct Volume *vo;
+	int i;
+
+	if ((dr = getDrive(vtl, drive, 1)) == NULL) {
+		return (-1);
+	}
+	vo = &vtl->VtVolumes[dr->DrVolume];
+
+	/* Index of first filemark at or after the head. */
+	i = nextFilemark(vo, dr->DrPos);
+	if (count > 0) {
+		i += count - 1;
+		if (i >= vo->VoFmCount) {
+			locate(vtl, dr, vo->VoEod);
+			errno = EIO;
+			return (-1);
+		}
+		locate(vtl, dr, vo->VoFm[i] + 1);
+	} else if (count < 0) {
+		i += count;
+		if (i < 0) {
+			locate(vtl, dr, 0);
+			errno = EIO;
+			return (-1);
+		}
+		locate(vtl, dr, vo->VoFm[i]);
+	}
+	return (0);
+}
+
+
+/*
+ * Return block address of the head.
+ */
+long long
+VtlPosition(
+	Vtl_t *vtl,
+	int drive)
+{
+	struct Drive *dr;
+
+	if ((dr = getDrive(vtl, drive, 1)) == NULL) {
+		return (-1);
+	}
+	return (dr->DrPos);
+}
+
+
+/*
+ * Return modelled time to locate from one block address to another.
+ */
+double
+VtlLocateCost(
+	Vtl_t *vtl,
+	long long from,
+	long long to)
+{
+	double wind;
+
+	if (from == to) {
+		return (0.0);
+	}
+	wind = lpos(vtl, to) - lpos(vtl, from);
+	if (wind < 0) {
+		wind = -wind;
+	}
+	return (vtl->VtParams.VpLocateTime + wind * vtl->VtParams.VpWindTime);
+}
+
+
+/*
+ * Read blocks.  The size must be a multiple of the block size.
+ * Reading stops at a filemark, a read at a filemark returns 0 and
+ * leaves the tape after it.  A read at end of data fails with EIO.
+ */
+ssize_t
+VtlRead(
+	Vtl_t *vtl,
+	int drive,
+	void *buf,
+	size_t size)
+{
+	struct Drive *dr;
+	struct Volume *vo;
+	long long blocks;
+	long long end;
+	size_t bytes;
+	int bs;
+	int i;
+
+	if ((dr = getDrive(vtl, drive, 1)) == NULL) {
+		return (-1);
+	}
+	vo = &vtl->VtVolumes[dr->DrVolume];
+	bs = vtl->VtParams.VpBlockSize;
+	blocks = size / bs;
+	if (blocks == 0 || size % bs != 0) {
+		errno = EINVAL;
+		return (-1);
+	}
+	if (dr->DrPos >= vo->VoEod) {
+		errno = EIO;
+		return (-1);
+	}
+
+	end = vo->VoEod;
+	i = nextFilemark(vo, dr->DrPos);
+	if (i < vo->VoFmCount) {
+		if (vo->VoFm[i] == dr->DrPos) {
+			dr->DrPos++;
+			return (0);
+		}
+		end = vo->VoFm[i];
+	}
+	if (blocks > end - dr->DrPos) {
+		blocks = end - dr->DrPos;
+	}
+	bytes = blocks * bs;
+
+	if (vo->VoFd >= 0) {
+		ssize_t n;
+
+		n = pread(vo->VoFd, buf, bytes, (off_t)dr->DrPos * bs);
+		if (n < 0) {
+			return (-1);
+		}
+		if (n < bytes) {
+			/* Sparse end of the data file. */
+			memset((char *)buf + n, 0, bytes - n);
+		}
+	} else {
+		memset(buf, 0, bytes);
+	}
+
+	dr->DrPos += blocks;
+	dr->DrClock += bytes / vtl->VtParams.VpBandwidth;
+	vtl->VtStats.VsBytesRead += bytes;
+	vtl->VtStats.VsXferTime += bytes / vtl->VtParams.VpBandwidth;
+	return (bytes);
+}
+
+
+/*
+ * Write blocks.  A short last block is padded with zeroes.  Writing
+ * ends the data on the volume after the blocks written.  Fails with
+ * ENOSPC if the blocks do not fit.
+ */
+ssize_t
+VtlWrite(
+	Vtl_t *vtl,
+	int drive,
+	void *buf,
+	size_t size)
+{
+	struct Drive *dr;
+	struct Volume *vo;
+	long long blocks;
+	size_t bytes;
+	int bs;
+
+	if ((dr = getDrive(vtl, drive, 1)) == NULL) {
+		return (-1);
+	}
+	vo = &vtl->VtVolumes[dr->DrVolume];
+	bs = vtl->VtParams.VpBlockSize;
+	blocks = (size + bs - 1) / bs;
+	if (blocks == 0) {
+		return (0);
+	}
+	if (dr->DrPos + blocks > vtl->VtBlocks) {
+		errno = ENOSPC;
+		return (-1);
+	}
+	bytes = blocks * bs;
+
+	if (vo->VoFd >= 0) {
+		if (pwrite(vo->VoFd, buf, size, (off_t)dr->DrPos * bs) !=
+		    size) {
+			return (-1);
+		}
+		if (bytes > size) {
+			static char zero[512];
+			size_t pad;
+			off_t off;
+
+			off = (off_t)dr->DrPos * bs + size;
+			for (pad = bytes - size; pad > 0; ) {
+				size_t n = pad < sizeof (zero) ?
+				    pad : sizeof (zero);
+
+				if (pwrite(vo->VoFd, zero, n, off) != n) {
+					return (-1);
+				}
+				off += n;
+				pad -= n;
+			}
+		}
+	}
+
+	truncateVolume(vo, dr->DrPos);
+	dr->DrPos += blocks;
+	vo->VoEod = dr->DrPos;
+	dr->DrClock += bytes / vtl->VtParams.VpBandwidth;
+	vtl->VtStats.VsBytesWritten += bytes;
+	vtl->VtStats.VsXferTime += bytes / vtl->VtParams.VpBandwidth;
+	return (size);
+}
+
+
+/*
+ * Write a filemark.
+ */
+int
+VtlWriteFilemark(
+	Vtl_t *vtl,
+	int drive)
+{
+	struct Drive *dr;
+	struct Volume *vo;
+
+	if ((dr = getDrive(vtl, drive, 1)) == NULL) {
+		return (-1);
+	}
+	vo = &vtl->VtVolumes[dr->DrVolume];
+	if (dr->DrPos + 1 > vtl->VtBlocks) {
+		errno = ENOSPC;
+		return (-1);
+	}
+	truncateVolume(vo, dr->DrPos);
+	if (vo->VoFmCount == vo->VoFmAlloc) {
+		long long *fm;
+		int alloc;
+
+		alloc = vo->VoFmAlloc ? vo->VoFmAlloc * 2 : 64;
+		fm = realloc(vo->VoFm, alloc * sizeof (long long));
+		if (fm == NULL) {
+			return (-1);
+		}
+		vo->VoFm = fm;
+		vo->VoFmAlloc = alloc;
+	}
+	vo->VoFm[vo->VoFmCount++] = dr->DrPos;
+	dr->DrPos++;
+	vo->VoEod = dr->DrPos;
+	return (0);
+}
+
+
+/* Private functions. */
+
+
+/*
+ * Return drive, if loaded is set the drive must have a volume loaded.
+ */
+static struct Drive *
+getDrive(
+	Vtl_t *vtl,
+	int drive,
+	int loaded)
+{
+	struct Drive *dr;
+
+	if (drive < 0 || drive >= vtl->VtDriveCount) {
+		errno = EINVAL;
+		return (NULL);
+	}
+	dr = &vtl->VtDrives[drive];
+	if (loaded && dr->DrVolume < 0) {
+		errno = ENXIO;
+		return (NULL);
+	}
+	return (dr);
+}
+
+
+/*
+ * Read volume's map.  A missing map is an empty volume.
+ */
+static int
+readMap(
+	Vtl_t *vtl,
+	struct Volume *vo)
+{
+	char path[1024];
+	char line[80];
+	FILE *st;
+
+	(void) snprintf(path, sizeof (path), "%s/%s.map",
+	    vtl->VtDir, vo->VoVsn);
+	if ((st = fopen(path, "r")) == NULL) {
+		return (errno == ENOENT ? 0 : -1);
+	}
+	while (fgets(line, sizeof (line), st) != NULL) {
+		long long block;
+
+		if (sscanf(line, "eod %lld", &block) == 1) {
+			vo->VoEod = block;
+		} else if (sscanf(line, "fm %lld", &block) == 1) {
+			if (vo->VoFmCount == vo->VoFmAlloc) {
+				long long *fm;
+				int alloc;
+
+				alloc = vo->VoFmAlloc ? vo->VoFmAlloc * 2 : 64;
+				fm = realloc(vo->VoFm,
+				    alloc * sizeof (long long));
+				if (fm == NULL) {
+					(void) fclose(st);
+					return (-1);
+				}
+				vo->VoFm = fm;
+				vo->VoFmAlloc = alloc;
+			}
+			vo->VoFm[vo->VoFmCount++] = block;
+		}
+	}
+	(void) fclose(st);
+	return (0);
+}
+
+
+/*
+ * Write volume's map.
+ */
+static int
+writeMap(
+	Vtl_t *vtl,
+	struct Volume *vo)
+{
+	char path[1024];
+	FILE *st;
+	int i;
+
+	(void) snprintf(path, sizeof (path), "%s/%s.map",
+	    vtl->VtDir, vo->VoVsn);
+	if ((st = fopen(path, "w")) == NULL) {
+		return (-1);
+	}
+	(void) fprintf(st, "eod %lld\n", vo->VoEod);
+	for (i = 0; i < vo->VoFmCount; i++) {
+		(void) fprintf(st, "fm %lld\n", vo->VoFm[i]);
+	}
+	return (fclose(st));
+}
+
+
+/*
+ * End the data on a volume at a block address.
+ */
+static void
+truncateVolume(
+	struct Volume *vo,
+	long long block)
+{
+	vo->VoFmCount = nextFilemark(vo, block);
+	vo->VoEod = block;
+}
+
+
+/*
+ * Return index of the first filemark at or after a block address.
+ */
+static int
+nextFilemark(
+	struct Volume *vo,
+	long long block)
+{
+	int lo;
+	int hi;
+
+	lo = 0;
+	hi = vo->VoFmCount;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+
+		if (vo->VoFm[mid] < block) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	return (lo);
+}
+
+
+/*
+ * Return longitudinal position of a block as a fraction of the tape
+ * length from the beginning of the tape.  Odd wraps run backward.
+ */
+static double
+lpos(
+	Vtl_t *vtl,
+	long long block)
+{
+	long long wrap;
+	double l;
+
+	wrap = block / vtl->VtWrapBlocks;
+	l = (double)(block % vtl->VtWrapBlocks) / vtl->VtWrapBlocks;
+	return ((wrap & 1) ? 1.0 - l : l);
+}
+
+
+/*
+ * Move drive's head.
+ */
+static void
+locate(
+	Vtl_t *vtl,
+	struct Drive *dr,
+	long long block)
+{
+	double cost;
+
+	cost = VtlLocateCost(vtl, dr->DrPos, block);
+	if (cost > 0) {
+		vtl->VtStats.VsLocates++;
+		vtl->VtStats.VsLocateTime += cost;
+		dr->DrClock += cost;
+	}
+	dr->DrPos = block;
+}
@@ -0,0 +1,116 @@
+/*
+ * vtl.h - virtual tape library definitions.
+ */
+
+/*
+ *    SAM-QFS_notice_begin
+ *
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at pkg/OPENSOLARIS.LICENSE
+ * or https://illumos.org/license/CDDL.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at pkg/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+/*
+ * Copyright 2009 Sun Microsystems, Inc.  All rights reserved.
+ * Use is subject to license terms.
+ *
+ *    SAM-QFS_notice_end
+ */
+
+#ifndef _VTL_H
+#define	_VTL_H
+
+#ifdef __STDC__
+#pragma ident "$Revision: 1.1 $"
+#endif /* __STDC__ */
+
+#include <sys/types.h>
+
+/*
+ * A virtual tape library is a media changer with a number of drives
+ * and a number of volumes.  Each volume is a file in the library's
+ * directory.  Blocks are addressed as on a tape, a filemark uses one
+ * block address and holds no data.
+ *
+ * The time of each operation is modelled, not spent.  Each drive and
+ * the changer keep a clock in seconds.  An operation on a drive starts
+ * at the drive's clock and advances it by the modelled time.  The
+ * changer moves one volume at a time so a load waits for the changer.
+ *
+ * Volumes are written in wraps running alternately from the beginning
+ * to the end of the tape and back, the time to locate depends on the
+ * distance along the tape, not on the distance between block addresses.
+ */
+
+/*
+ * Library parameters.
+ */
+typedef struct VtlParams {
+	long long VpCapacity;		/* volume capacity in bytes */
+	int	VpBlockSize;		/* block size in bytes */
+	int	VpWraps;		/* number of wraps */
+	double	VpBandwidth;		/* streaming rate in bytes/second */
+	double	VpLoadTime;		/* changer move and load */
+	double	VpUnloadTime;		/* unload and changer move */
+	double	VpLocateTime;		/* fixed time of each locate */
+	double	VpWindTime;		/* time to wind full tape length */
+	int	VpData;			/* keep data written to volumes */
+} VtlParams_t;
+
+/*
+ * Operation counters.
+ */
+typedef struct VtlStats {
+	long long VsLoads;
+	long long VsLocates;
+	long long VsBytesRead;
+	long long VsBytesWritten;
+	double	VsLoadTime;		/* loading and unloading */
+	double	VsLocateTime;		/* locating and rewinding */
+	double	VsXferTime;		/* reading and writing */
+} VtlStats_t;
+
+typedef struct Vtl Vtl_t;
+
+/* Library. */
+Vtl_t *VtlOpen(char *dir, int drives, int volumes, VtlParams_t *params);
+void VtlClose(Vtl_t *vtl);
+char *VtlVsn(Vtl_t *vtl, int volume);
+void VtlGetStats(Vtl_t *vtl, VtlStats_t *stats);
+
+/* Changer. */
+int VtlLoad(Vtl_t *vtl, int drive, int volume);
+int VtlUnload(Vtl_t *vtl, int drive);
+int VtlLoaded(Vtl_t *vtl, int drive);
+
+/* Drive clock. */
+double VtlClock(Vtl_t *vtl, int drive);
+void VtlSetClock(Vtl_t *vtl, int drive, double clock);
+
+/* Positioning. */
+int VtlRewind(Vtl_t *vtl, int drive);
+int VtlLocate(Vtl_t *vtl, int drive, long long block);
+int VtlSpaceFile(Vtl_t *vtl, int drive, int count);
+long long VtlPosition(Vtl_t *vtl, int drive);
+double VtlLocateCost(Vtl_t *vtl, long long from, long long to);
+
+/* Data transfer. */
+ssize_t VtlRead(Vtl_t *vtl, int drive, void *buf, size_t size);
+ssize_t VtlWrite(Vtl_t *vtl, int drive, void *buf, size_t size);
+int VtlWriteFilemark(Vtl_t *vtl, int drive);
+
+#endif /* _VTL_H */
@@ -0,0 +1,1039 @@
+/*
+ * vtlbench.c - archive and stage benchmark on a virtual tape library.
+ *
+ * vtlbench writes a set of files to the volumes of a virtual tape
+ * library the way arcopy writes archive files, then stages a random
+ * part of them back the way the stager's copy processes do, and
+ * reports the modelled times of both.
+ *
+ * Files are written in archive files.  Each archive file starts at the
+ * position recorded for its files and ends with a filemark.  A file is
+ * a 512 byte header record followed by its data rounded up to 512
+ * bytes, the offset of a file is the number of 512 byte records from
+ * the start of the archive file to its header.  These are the position
+ * and offset kept in the inode for an archive copy.
+ *
+ * The stage requests are grouped into a stream per volume.  A stream
+ * is staged by the drive that is free first.  Files in a stream are
+ * staged in position order or in the stager's recall order, by its
+ * OrderRecall().  OrderRecall() models the LTO generation holding the
+ * volume's capacity, not the -r and -w parameters.
+ *
+ * The mixed phase alternates stage streams with appending archive
+ * files, so archive volumes are chosen while stage volumes occupy the
+ * drives.  The archive volume is the first with space, the archiver's
+ * old policy, or the cheapest by the archiver scheduler's cost model:
+ * a loaded volume costs the wait for its drive, an unloaded one a load
+ * plus an unload if the drive is full, and each a locate to the end of
+ * data scaled by the space used.
+ *
+ * Usage: vtlbench [options]
+ *  [-D drives] -- Number of drives, default 2
+ *  [-V volumes] -- Number of volumes, default 8
+ *  [-n files] -- Number of files, default 1000
+ *  [-s min[-max] ] -- File size range, default 1M-16M
+ *  [-a size] -- Archive file size, default 512M
+ *  [-p percent] -- Percent of files staged, default 10
+ *  [-o position | recall] -- Stage order, default position
+ *  [-m rounds] -- Mixed stage and archive rounds, default 0
+ *  [-A first | cost] -- Mixed archive volume choice, default cost
+ *  [-S seed] -- Random seed, default 1
+ *  [-d dirname] -- Library directory, default ./vtl
+ *  [-x] -- Keep data on the volumes and check it when staged
+ *  [-b size] -- Block size, default 256k
+ *  [-c size] -- Volume capacity, default 2500G
+ *  [-r wraps] -- Number of wraps, default 136
+ *  [-W rate] -- Streaming rate per second, default 160M
+ *  [-L seconds] -- Load time, default 20
+ *  [-U seconds] -- Unload time, default 20
+ *  [-l seconds] -- Locate overhead, default 2
+ *  [-w seconds] -- Full length wind time, default 100
+ */
+
+/*
+ *    SAM-QFS_notice_begin
+ *
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at pkg/OPENSOLARIS.LICENSE
+ * or https://illumos.org/license/CDDL.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at pkg/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+/*
+ * Copyright 2009 Sun Microsystems, Inc.  All rights reserved.
+ * Use is subject to license terms.
+ *
+ *    SAM-QFS_notice_end
+ */
+
+#ifdef __STDC__
+#pragma ident "$Revision: 1.1 $"
+#endif /* __STDC__ */
+
+/* ANSI C headers. */
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* POSIX headers. */
+#include <sys/types.h>
+#include <unistd.h>
+
+/* SAM-FS headers. */
+#include "sam/types.h"
+#include "pub/devstat.h"
+#include "aml/catalog.h"
+#include "aml/tar.h"
+#include "aml/stager.h"
+#include "aml/stager_defs.h"
+
+/* Local headers. */
+#include "stager_lib.h"
+#include "stager.h"
+#include "vtl.h"
+
+/* Macros. */
+#define	RECORD 512		/* archive record size */
+#define	CHUNK_BLOCKS 16		/* blocks in each write or read */
+#define	STREAM_MAX 8		/* most files in a mixed stream */
+#define	MBYTE (1024.0 * 1024.0)
+
+/* Types. */
+typedef long long int64;
+typedef unsigned int uint32;
+
+/* Structures. */
+static struct File {
+	int64	FiSize;
+	int	FiVolume;
+	int64	FiPosition;		/* archive file's block address */
+	int64	FiOffset;		/* records to the header */
+	double	FiLatency;		/* stage completion */
+} *Files;
+
+static struct Writer {
+	char	*WrBuf;
+	size_t	WrFill;
+	size_t	WrSize;
+	int	WrDrive;
+} Writer;
+
+/* Private data. */
+static Vtl_t *Vtl;
+static VtlParams_t Params = {
+	2500LL * 1024 * 1024 * 1024,	/* VpCapacity */
+	256 * 1024,			/* VpBlockSize */
+	136,				/* VpWraps */
+	160.0 * MBYTE,			/* VpBandwidth */
+	20.0,				/* VpLoadTime */
+	20.0,				/* VpUnloadTime */
+	2.0,				/* VpLocateTime */
+	100.0,				/* VpWindTime */
+	0				/* VpData */
+};
+static char *program_name;
+static char *dir_name = "./vtl";
+static char *Buffer;
+static int Drives = 2;
+static int Volumes = 8;
+static int FileCount = 1000;
+static int Recall = 0;
+static int64 FileSizeRange[2] = { 1024 * 1024, 16 * 1024 * 1024 };
+static int64 ArchiveSize = 512 * 1024 * 1024;
+static double Percent = 10.0;
+static unsigned long long Seed = 1;
+static int Rounds = 0;
+static int CostPolicy = 1;
+static int64 *VolumeEod;		/* end of data of each volume */
+
+/* Private functions. */
+static void archive(void);
+static void stage(void);
+static void mixed(void);
+static int chooseVolume(int64 blocks);
+static int volumeDrive(int volume);
+static void stageFile(int drive, int fid);
+static int orderStream(int *ids, int count);
+static void putRecords(uint32 id, int64 count);
+static void flushWriter(void);
+static int freeDrive(void);
+static void report(char *phase, double start, double end, int files,
+	VtlStats_t *before);
+static void AsmSize(char *token, int64 *size);
+static unsigned long long Random(void);
+static void prerror(int status, int prerrno, char *fmt, ...);
+
+int
+main(int argc, char *argv[])
+{
+	int	c;
+	int	errors;
+	int64	value;
+
+	program_name = argv[0];
+	errors = 0;
+	while ((c = getopt(argc, argv,
+	    "A:D:L:S:U:V:W:a:b:c:d:l:m:n:o:p:r:s:w:x")) != EOF) {
+		switch (c) {
+		case 'A':
+			if (strcmp(optarg, "first") == 0) {
+				CostPolicy = 0;
+			} else if (strcmp(optarg, "cost") == 0) {
+				CostPolicy = 1;
+			} else {
+				errors++;
+			}
+			break;
+		case 'D':
+			Drives = atoi(optarg);
+			break;
+		case 'L':
+			Params.VpLoadTime = atof(optarg);
+			break;
+		case 'S':
+			Seed = strtoull(optarg, NULL, 0);
+			if (Seed == 0)  Seed = 1;
+			break;
+		case 'U':
+			Params.VpUnloadTime = atof(optarg);
+			break;
+		case 'V':
+			Volumes = atoi(optarg);
+			break;
+		case 'W':
+			AsmSize(optarg, &value);
+			Params.VpBandwidth = (double)value;
+			break;
+		case 'a':
+			AsmSize(optarg, &ArchiveSize);
+			break;
+		case 'b':
+			AsmSize(optarg, &value);
+			Params.VpBlockSize = (int)value;
+			break;
+		case 'c':
+			AsmSize(optarg, &Params.VpCapacity);
+			break;
+		case 'd':
+			dir_name = optarg;
+			break;
+		case 'l':
+			Params.VpLocateTime = atof(optarg);
+			break;
+		case 'm':
+			Rounds = atoi(optarg);
+			break;
+		case 'n':
+			FileCount = atoi(optarg);
+			break;
+		case 'o':
+			if (strcmp(optarg, "position") == 0) {
+				Recall = 0;
+			} else if (strcmp(optarg, "recall") == 0) {
+				Recall = 1;
+			} else {
+				errors++;
+			}
+			break;
+		case 'p':
+			Percent = atof(optarg);
+			break;
+		case 'r':
+			Params.VpWraps = atoi(optarg);
+			break;
+		case 's': {
+			char	*p;
+
+			if ((p = strchr(optarg, '-')) != NULL)  *p++ = '\0';
+			AsmSize(optarg, &FileSizeRange[0]);
+			if (p != NULL)  AsmSize(p, &FileSizeRange[1]);
+			else  FileSizeRange[1] = FileSizeRange[0];
+			}
+			break;
+		case 'w':
+			Params.VpWindTime = atof(optarg);
+			break;
+		case 'x':
+			Params.VpData = 1;
+			break;
+		default:
+			errors++;
+			break;
+		}
+	}
+	if (Drives <= 0 || Volumes <= 0 || FileCount <= 0 ||
+	    FileSizeRange[1] < FileSizeRange[0] ||
+	    Params.VpBlockSize % RECORD != 0 ||
+	    Percent < 0 || Percent > 100 || Rounds < 0) {
+		errors++;
+	}
+
+	if (errors != 0 || optind != argc) {
+		fprintf(stderr,
+"Usage: %s \n", program_name);
+		fprintf(stderr,
+"  [-D drives] [-V volumes] [-n files] [-s min[-max] ] [-a archive_size]\n");
+		fprintf(stderr,
+"  [-p percent] [-o position | recall] [-S seed] [-d dirname] [-x]\n");
+		fprintf(stderr,
+"  [-m rounds] [-A first | cost]\n");
+		fprintf(stderr,
+"  [-b block_size] [-c capacity] [-r wraps] [-W rate]\n");
+		fprintf(stderr,
+"  [-L load_seconds] [-U unload_seconds] [-l locate_seconds]\n");
+		fprintf(stderr,
+"  [-w wind_seconds]\n");
+		exit(2);
+	}
+
+	Vtl = VtlOpen(dir_name, Drives, Volumes, &Params);
+	if (Vtl == NULL) {
+		prerror(1, 1, "Cannot open library %s", dir_name);
+	}
+	Writer.WrSize = (size_t)CHUNK_BLOCKS * Params.VpBlockSize;
+	Files = calloc(FileCount, sizeof (struct File));
+	Buffer = calloc(1, Writer.WrSize);
+	Writer.WrBuf = calloc(1, Writer.WrSize);
+	VolumeEod = calloc(Volumes, sizeof (int64));
+	if (Files == NULL || Buffer == NULL || Writer.WrBuf == NULL ||
+	    VolumeEod == NULL) {
+		prerror(1, 0, "Out of memory");
+	}
+
+	archive();
+	stage();
+	if (Rounds > 0) {
+		mixed();
+	}
+
+	VtlClose(Vtl);
+	return (EXIT_SUCCESS);
+}
+
+
+/*
+ * Write files in archive files.  The drive free first writes the next
+ * archive file on its volume, if the archive file does not fit the
+ * drive loads the next empty volume.
+ */
+static void
+archive(void)
+{
+	VtlStats_t before;
+	double	start;
+	double	end;
+	int	fid;
+	int	next;
+	int	i;
+
+	VtlGetStats(Vtl, &before);
+	start = 0;
+	for (fid = 0; fid < FileCount; fid++) {
+		Files[fid].FiSize = FileSizeRange[0];
+		if (FileSizeRange[1] > FileSizeRange[0]) {
+			Files[fid].FiSize += Random() %
+			    (FileSizeRange[1] - FileSizeRange[0] + 1);
+		}
+	}
+
+	next = 0;
+	fid = 0;
+	while (fid < FileCount) {
+		int64	records;
+		int64	blocks;
+		int64	position;
+		int	drive;
+		int	last;
+
+		/*
+		 * Files in this archive file.
+		 */
+		records = 0;
+		last = fid;
+		do {
+			records += 1 + (Files[last].FiSize + RECORD - 1) /
+			    RECORD;
+			last++;
+		} while (last < FileCount &&
+		    (records + 1) * RECORD + Files[last].FiSize <=
+		    ArchiveSize);
+		blocks = (records * RECORD + Params.VpBlockSize - 1) /
+		    Params.VpBlockSize + 1;
+
+		drive = freeDrive();
+		for (;;) {
+			int	volume;
+
+			volume = VtlLoaded(Vtl, drive);
+			if (volume >= 0 &&
+			    VtlPosition(Vtl, drive) + blocks <=
+			    Params.VpCapacity / Params.VpBlockSize) {
+				break;
+			}
+			if (volume >= 0 && VtlUnload(Vtl, drive) != 0) {
+				prerror(1, 1, "Unload drive %d", drive);
+			}
+			if (next >= Volumes) {
+				prerror(1, 0, "Library full, %d of %d files "
+				    "archived", fid, FileCount);
+			}
+			if (VtlLoad(Vtl, drive, next) != 0) {
+				prerror(1, 1, "Load %s", VtlVsn(Vtl, next));
+			}
+			next++;
+		}
+
+		Writer.WrDrive = drive;
+		position = VtlPosition(Vtl, drive);
+		records = 0;
+		for (i = fid; i < last; i++) {
+			int64	data;
+
+			data = (Files[i].FiSize + RECORD - 1) / RECORD;
+			Files[i].FiVolume = VtlLoaded(Vtl, drive);
+			Files[i].FiPosition = position;
+			Files[i].FiOffset = records;
+			putRecords(i, 1 + data);
+			records += 1 + data;
+		}
+		flushWriter();
+		if (VtlWriteFilemark(Vtl, drive) != 0) {
+			prerror(1, 1, "Write filemark");
+		}
+		VolumeEod[VtlLoaded(Vtl, drive)] = VtlPosition(Vtl, drive);
+		fid = last;
+	}
+
+	end = 0;
+	for (i = 0; i < Drives; i++) {
+		if (VtlLoaded(Vtl, i) >= 0 && VtlUnload(Vtl, i) != 0) {
+			prerror(1, 1, "Unload drive %d", i);
+		}
+		if (VtlClock(Vtl, i) > end)  end = VtlClock(Vtl, i);
+	}
+	report("archive", start, end, FileCount, &before);
+}
+
+
+/*
+ * Stage a random part of the files.  All requests are made when the
+ * archiving is done.  Requests are grouped in a stream for each volume,
+ * the streams are staged in the order of their first request.
+ */
+static void
+stage(void)
+{
+	VtlStats_t before;
+	double	*latency;
+	double	start;
+	double	end;
+	double	sum;
+	int	*requests;
+	int	*streamIds;
+	int	count;
+	int	i;
+	int	v;
+
+	VtlGetStats(Vtl, &before);
+	start = 0;
+	for (i = 0; i < Drives; i++) {
+		if (VtlClock(Vtl, i) > start)  start = VtlClock(Vtl, i);
+	}
+	for (i = 0; i < Drives; i++) {
+		VtlSetClock(Vtl, i, start);
+	}
+
+	count = (int)(FileCount * Percent / 100.0 + 0.5);
+	requests = malloc(FileCount * sizeof (int));
+	streamIds = malloc(FileCount * sizeof (int));
+	latency = malloc(FileCount * sizeof (double));
+	if (requests == NULL || streamIds == NULL || latency == NULL) {
+		prerror(1, 0, "Out of memory");
+	}
+	for (i = 0; i < FileCount; i++) {
+		requests[i] = i;
+	}
+	for (i = 0; i < count; i++) {
+		int	j;
+		int	t;
+
+		j = i + (int)(Random() % (FileCount - i));
+		t = requests[i];
+		requests[i] = requests[j];
+		requests[j] = t;
+	}
+
+	for (i = 0; i < count; i++) {
+		int	n;
+		int	drive;
+		int	j;
+
+		v = Files[requests[i]].FiVolume;
+		if (v < 0) {
+			continue;	/* stream already staged */
+		}
+		n = 0;
+		for (j = i; j < count; j++) {
+			if (Files[requests[j]].FiVolume == v) {
+				streamIds[n++] = requests[j];
+			}
+		}
+		n = orderStream(streamIds, n);
+
+		drive = freeDrive();
+		if (VtlLoaded(Vtl, drive) != v) {
+			if (VtlLoaded(Vtl, drive) >= 0 &&
+			    VtlUnload(Vtl, drive) != 0) {
+				prerror(1, 1, "Unload drive %d", drive);
+			}
+			if (VtlLoad(Vtl, drive, v) != 0) {
+				prerror(1, 1, "Load %s", VtlVsn(Vtl, v));
+			}
+		}
+		for (j = 0; j < n; j++) {
+			stageFile(drive, streamIds[j]);
+			Files[streamIds[j]].FiLatency =
+			    VtlClock(Vtl, drive) - start;
+			Files[streamIds[j]].FiVolume = -1;
+		}
+	}
+
+	end = start;
+	for (i = 0; i < Drives; i++) {
+		if (VtlClock(Vtl, i) > end)  end = VtlClock(Vtl, i);
+	}
+	report("stage", start, end, count, &before);
+
+	if (count > 0) {
+		int	j;
+
+		sum = 0;
+		for (i = 0; i < count; i++) {
+			latency[i] = Files[requests[i]].FiLatency;
+			sum += latency[i];
+		}
+		/* Insertion sort, the latencies are mostly in order. */
+		for (i = 1; i < count; i++) {
+			double	t = latency[i];
+
+			for (j = i; j > 0 && latency[j - 1] > t; j--) {
+				latency[j] = latency[j - 1];
+			}
+			latency[j] = t;
+		}
+		printf("latency: mean %.1fs p50 %.1fs p95 %.1fs max %.1fs\n",
+		    sum / count, latency[count / 2],
+		    latency[(count * 95) / 100 < count ?
+		    (count * 95) / 100 : count - 1],
+		    latency[count - 1]);
+	}
+	free(latency);
+	free(streamIds);
+	free(requests);
+}
+
+
+/*
+ * Alternate stage streams and archive files.  Each round stages a
+ * stream of files not yet staged from a random volume, then appends an
+ * archive file to the volume chosen by the policy.
+ */
+static void
+mixed(void)
+{
+	VtlStats_t before;
+	double	start;
+	double	end;
+	int64	blocks;
+	int	round;
+	int	staged;
+	int	streams;
+	int	i;
+
+	VtlGetStats(Vtl, &before);
+	start = 0;
+	for (i = 0; i < Drives; i++) {
+		if (VtlClock(Vtl, i) > start)  start = VtlClock(Vtl, i);
+	}
+	for (i = 0; i < Drives; i++) {
+		VtlSetClock(Vtl, i, start);
+	}
+	blocks = (ArchiveSize + Params.VpBlockSize - 1) /
+	    Params.VpBlockSize + 1;
+
+	staged = 0;
+	streams = 0;
+	for (round = 0; round < Rounds; round++) {
+		int	ids[STREAM_MAX];
+		int	drive;
+		int	fid;
+		int	n;
+		int	v;
+
+		fid = (int)(Random() % FileCount);
+		for (i = 0; i < FileCount && Files[fid].FiVolume < 0; i++) {
+			fid = (fid + 1) % FileCount;
+		}
+		if (Files[fid].FiVolume >= 0) {
+			v = Files[fid].FiVolume;
+			n = 0;
+			ids[n++] = fid;
+			for (i = 0; i < 4 * STREAM_MAX && n < STREAM_MAX; i++) {
+				int	j;
+				int	k;
+
+				j = (int)(Random() % FileCount);
+				for (k = 0; k < n && ids[k] != j; k++)
+					;
+				if (k == n && Files[j].FiVolume == v) {
+					ids[n++] = j;
+				}
+			}
+			n = orderStream(ids, n);
+			if ((drive = volumeDrive(v)) < 0) {
+				drive = freeDrive();
+				if (VtlLoaded(Vtl, drive) >= 0 &&
+				    VtlUnload(Vtl, drive) != 0) {
+					prerror(1, 1, "Unload drive %d", drive);
+				}
+				if (VtlLoad(Vtl, drive, v) != 0) {
+					prerror(1, 1, "Load %s",
+					    VtlVsn(Vtl, v));
+				}
+			}
+			for (i = 0; i < n; i++) {
+				stageFile(drive, ids[i]);
+				Files[ids[i]].FiVolume = -1;
+			}
+			staged += n;
+			streams++;
+		}
+
+		/*
+		 * Append an archive file.
+		 */
+		if ((v = chooseVolume(blocks)) < 0) {
+			prerror(1, 0, "Library full, %d of %d rounds", round,
+			    Rounds);
+		}
+		if ((drive = volumeDrive(v)) < 0) {
+			drive = freeDrive();
+			if (VtlLoaded(Vtl, drive) >= 0 &&
+			    VtlUnload(Vtl, drive) != 0) {
+				prerror(1, 1, "Unload drive %d", drive);
+			}
+			if (VtlLoad(Vtl, drive, v) != 0) {
+				prerror(1, 1, "Load %s", VtlVsn(Vtl, v));
+			}
+		}
+		if (VtlPosition(Vtl, drive) != VolumeEod[v] &&
+		    VtlLocate(Vtl, drive, VolumeEod[v]) != 0) {
+			prerror(1, 1, "Locate end of data %s", VtlVsn(Vtl, v));
+		}
+		Writer.WrDrive = drive;
+		putRecords((uint32)-1, ArchiveSize / RECORD);
+		flushWriter();
+		if (VtlWriteFilemark(Vtl, drive) != 0) {
+			prerror(1, 1, "Write filemark");
+		}
+		VolumeEod[v] = VtlPosition(Vtl, drive);
+	}
+
+	end = start;
+	for (i = 0; i < Drives; i++) {
+		if (VtlClock(Vtl, i) > end)  end = VtlClock(Vtl, i);
+	}
+	printf("mixed: %s volume choice, %d stage streams, "
+	    "%d archive files\n", CostPolicy ? "cost" : "first", streams,
+	    Rounds);
+	report("mixed", start, end, staged, &before);
+}
+
+
+/*
+ * Choose the volume for an archive file of blocks.  Returns -1 if no
+ * volume has space.
+ */
+static int
+chooseVolume(
+	int64	blocks)
+{
+	double	best;
+	double	now;
+	int64	capacity;
+	int	choice;
+	int	idle;
+	int	v;
+
+	capacity = Params.VpCapacity / Params.VpBlockSize;
+	idle = freeDrive();
+	now = VtlClock(Vtl, idle);
+	choice = -1;
+	best = 0;
+	for (v = 0; v < Volumes; v++) {
+		double	cost;
+		int	drive;
+
+		if (VolumeEod[v] + blocks > capacity) {
+			continue;
+		}
+		if (!CostPolicy) {
+			return (v);
+		}
+		if ((drive = volumeDrive(v)) >= 0) {
+			/* Loaded, wait for the drive. */
+			cost = VtlClock(Vtl, drive) - now;
+			if (cost < 0)  cost = 0;
+		} else {
+			cost = Params.VpLoadTime;
+			if (VtlLoaded(Vtl, idle) >= 0) {
+				cost += Params.VpUnloadTime;
+			}
+		}
+		cost += Params.VpLocateTime + Params.VpWindTime *
+		    VolumeEod[v] / capacity;
+		if (choice < 0 || cost < best) {
+			best = cost;
+			choice = v;
+		}
+	}
+	return (choice);
+}
+
+
+/*
+ * Return the drive a volume is loaded in, -1 if not loaded.
+ */
+static int
+volumeDrive(
+	int	volume)
+{
+	int	i;
+
+	for (i = 0; i < Drives; i++) {
+		if (VtlLoaded(Vtl, i) == volume)  return (i);
+	}
+	return (-1);
+}
+
+
+/*
+ * Stage a file.  Locate to the block holding the file's header, read
+ * the header and data and check them if data is kept.
+ */
+static void
+stageFile(
+	int drive,
+	int fid)
+{
+	struct File *f;
+	int64	first;
+	int64	rec;
+	int64	records;
+	int64	remain;
+	int64	skip;
+	int64	at;
+
+	f = &Files[fid];
+	first = f->FiOffset * RECORD;
+	if (VtlLocate(Vtl, drive, f->FiPosition +
+	    first / Params.VpBlockSize) != 0) {
+		prerror(1, 1, "Locate file %d", fid);
+	}
+	skip = first % Params.VpBlockSize;
+	records = 1 + (f->FiSize + RECORD - 1) / RECORD;
+	remain = skip + records * RECORD;
+	remain = (remain + Params.VpBlockSize - 1) / Params.VpBlockSize *
+	    Params.VpBlockSize;
+
+	rec = 0;
+	at = 0;			/* byte offset of Buffer in the read */
+	while (remain > 0) {
+		ssize_t	n;
+		int64	off;
+
+		n = VtlRead(Vtl, drive, Buffer,
+		    remain < Writer.WrSize ? remain : Writer.WrSize);
+		if (n <= 0) {
+			prerror(1, n < 0, "Read file %d", fid);
+		}
+		if (Params.VpData) {
+			for (off = skip + rec * RECORD - at;
+			    off < n && rec < records; off += RECORD, rec++) {
+				uint32	hdr[2];
+
+				memcpy(hdr, Buffer + off, sizeof (hdr));
+				if (hdr[0] != (uint32)fid ||
+				    hdr[1] != (uint32)(rec - 1)) {
+					prerror(1, 0, "File %d record %lld "
+					    "bad data", fid, rec);
+				}
+			}
+		}
+		at += n;
+		remain -= n;
+	}
+}
+
+
+/*
+ * Order stream's files.  Returns the number of files.
+ */
+static int
+orderStream(
+	int	*ids,
+	int	count)
+{
+	struct CatalogEntry ce;
+	StreamInfo_t stream;
+	FileInfo_t *fi;
+	FileInfo_t **sortList;
+	int	i;
+	int	j;
+
+	/* Position order, insertion sort. */
+	for (i = 1; i < count; i++) {
+		int	t = ids[i];
+		int64	p = Files[t].FiPosition * Params.VpBlockSize +
+		    Files[t].FiOffset * RECORD;
+
+		for (j = i; j > 0 &&
+		    Files[ids[j - 1]].FiPosition * Params.VpBlockSize +
+		    Files[ids[j - 1]].FiOffset * RECORD > p; j--) {
+			ids[j] = ids[j - 1];
+		}
+		ids[j] = t;
+	}
+	if (!Recall || count == 0) {
+		return (count);
+	}
+
+	/*
+	 * Recall order as the stager makes it for an LTO volume.
+	 */
+	fi = calloc(count, sizeof (FileInfo_t));
+	sortList = malloc(count * sizeof (FileInfo_t *));
+	if (fi == NULL || sortList == NULL) {
+		prerror(1, 0, "Out of memory");
+	}
+	memset(&ce, 0, sizeof (ce));
+	ce.CeCapacity = Params.VpCapacity / 1024;
+	ce.CeBlockSize = Params.VpBlockSize;
+	memset(&stream, 0, sizeof (stream));
+	stream.vi.ce = &ce;
+	stream.media = DT_IBM3580;
+	(void) strncpy(stream.vsn, VtlVsn(Vtl, Files[ids[0]].FiVolume),
+	    sizeof (stream.vsn) - 1);
+	for (i = 0; i < count; i++) {
+		struct File *f = &Files[ids[i]];
+
+		fi[i].ar[0].section.position = f->FiPosition;
+		fi[i].ar[0].section.offset = f->FiOffset;
+		fi[i].len = f->FiSize;
+		fi[i].sort = ids[i];
+		sortList[i] = &fi[i];
+	}
+	if (OrderRecall(&stream, sortList, count)) {
+		for (i = 0; i < count; i++) {
+			ids[i] = sortList[i]->sort;
+		}
+	}
+	free(sortList);
+	free(fi);
+	return (count);
+}
+
+
+/*
+ * Put records of a file to the archive file being written.
+ * Record 0 is the header.
+ */
+static void
+putRecords(
+	uint32	id,
+	int64	count)
+{
+	uint32	rec;
+
+	rec = 0;
+	while (count > 0) {
+		int64	n;
+
+		n = (Writer.WrSize - Writer.WrFill) / RECORD;
+		if (n > count)  n = count;
+		if (Params.VpData) {
+			int64	i;
+
+			for (i = 0; i < n; i++) {
+				uint32	hdr[2];
+
+				hdr[0] = id;
+				hdr[1] = rec - 1;
+				memcpy(Writer.WrBuf + Writer.WrFill +
+				    i * RECORD, hdr, sizeof (hdr));
+				rec++;
+			}
+		}
+		Writer.WrFill += n * RECORD;
+		count -= n;
+		if (Writer.WrFill == Writer.WrSize) {
+			flushWriter();
+		}
+	}
+}
+
+
+/*
+ * Write buffered records.
+ */
+static void
+flushWriter(void)
+{
+	if (Writer.WrFill == 0) {
+		return;
+	}
+	if (VtlWrite(Vtl, Writer.WrDrive, Writer.WrBuf, Writer.WrFill) !=
+	    Writer.WrFill) {
+		prerror(1, 1, "Write %s", VtlVsn(Vtl,
+		    VtlLoaded(Vtl, Writer.WrDrive)));
+	}
+	Writer.WrFill = 0;
+}
+
+
+/*
+ * Return the drive free first.
+ */
+static int
+freeDrive(void)
+{
+	int	drive;
+	int	i;
+
+	drive = 0;
+	for (i = 1; i < Drives; i++) {
+		if (VtlClock(Vtl, i) < VtlClock(Vtl, drive))  drive = i;
+	}
+	return (drive);
+}
+
+
+/*
+ * Print phase's times.
+ */
+static void
+report(
+	char	*phase,
+	double	start,
+	double	end,
+	int	files,
+	VtlStats_t *before)
+{
+	VtlStats_t s;
+	double	bytes;
+	double	elapsed;
+
+	VtlGetStats(Vtl, &s);
+	bytes = (double)(s.VsBytesRead - before->VsBytesRead) +
+	    (double)(s.VsBytesWritten - before->VsBytesWritten);
+	elapsed = end - start;
+	printf("%s: %d files %.1fM in %.1fs %.1fM/s\n", phase, files,
+	    bytes / MBYTE, elapsed, elapsed > 0 ? bytes / MBYTE / elapsed : 0);
+	printf("    loads %lld %.1fs locates %lld %.1fs transfer %.1fs\n",
+	    s.VsLoads - before->VsLoads,
+	    s.VsLoadTime - before->VsLoadTime,
+	    s.VsLocates - before->VsLocates,
+	    s.VsLocateTime - before->VsLocateTime,
+	    s.VsXferTime - before->VsXferTime);
+}
+
+
+/*
+ *	Assemble size.
+ *	Size string in token.
+ */
+static void
+AsmSize(char *token, int64 *size)
+{
+	char	*p;
+	double	conv;
+
+	conv = strtod(token, &p);
+	if (conv < 0 || p == token)  prerror(2, 0, "Invalid size %s", token);
+	if ('k' == *p) {
+		p++;
+		conv *= 1024;
+	} else if ('M' == *p) {
+		p++;
+		conv *= 1024 * 1024;
+	} else if ('G' == *p) {
+		p++;
+		conv *= 1024.0 * 1024 * 1024;
+	} else if ('T' == *p) {
+		p++;
+		conv *= 1024.0 * 1024 * 1024 * 1024;
+	}
+	if (*p != '\0')  prerror(2, 0, "Invalid size %s", token);
+	*size = (int64)conv;
+}
+
+
+/*
+ *	Return random number, xorshift generator.
+ */
+static unsigned long long
+Random(void)
+{
+	Seed ^= Seed << 13;
+	Seed ^= Seed >> 7;
+	Seed ^= Seed << 17;
+	return (Seed);
+}
+
+
+/*
+ *	Print error message.
+ */
+static void
+prerror(
+	int status,
+	int prerrno,
+	char *fmt,
+	...)
+{
+	int	SaveErrno;
+	va_list	ap;
+
+	SaveErrno = errno;
+	fprintf(stderr, "%s: ", program_name);
+	if (fmt != NULL) {
+		va_start(ap, fmt);
+		vfprintf(stderr, fmt, ap);
+		va_end(ap);
+	}
+	if (prerrno) {
+		char *p;
+
+		if ((p = strerror(SaveErrno)) != NULL)
+			fprintf(stderr, ": %s", p);
+		else fprintf(stderr, ": Error number %d", SaveErrno);
+	}
+	fprintf(stderr, "\n");
+	fflush(stderr);
+	if (status)  exit(status);
+}
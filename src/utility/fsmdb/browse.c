@@ -68,12 +68,20 @@ static int filedetails_from_db(
 	uint32_t	which_details,
 	sqm_lst_t		*results);
 
+static size_t filter_prefix(restrict_t *filter, char *prefix, size_t len);
+
 static char *media_to_string(int mt);
 void free_details(filedetails_t *details);
 
 /*
  *  Extended listing - returns filedetails_t structures for the caller
  *  to interpret
+ *
+ *  The directory's entries are read from pathDB, keyed by parent
+ *  directory id and name, so a page costs a positioning lookup plus
+ *  the entries read.  Reading stops once one entry beyond the page
+ *  has matched, morefiles is then set.  If there is more, the position
+ *  is kept in a browse cursor for the request continuing the listing.
  */
 int
 db_list_files(
@@ -105,24 +113,67 @@ db_list_files(
 	uint32_t	found = 0;
 	int32_t		getnum;
 	boolean_t	start_is_dir = TRUE;
+	boolean_t	skip_start;
 	char		*namep;
+	char		*startName = NULL;
+	uint32_t	snapdate;
+	browse_cursor_t	*bc = NULL;
+	uint32_t	gen;
+	char		prefix[MAXPATHLEN];
+	size_t		plen;
+
+	if (howmany == -1) {
+		getnum = 0;
+	} else {
+		getnum = howmany;
+	}
+
+	if ((startFile != NULL) && (startFile[0] != '\0') &&
+	    (strcmp(startFile, ".") != 0)) {
+		startName = strrchr(startFile, '/');
+		startName = (startName == NULL) ? startFile : startName + 1;
+		start_is_dir = FALSE;
+	}
+
+	/*
+	 * read before the snapshot is found ready, a purge after this
+	 * means the cursor for the next page must not be kept
+	 */
+	gen = browse_generation();
+
+	/* a request continuing a listing picks up where it ended */
+	if ((startName != NULL) && !((getnum == 1) && includeStart)) {
+		bc = get_browse_cursor(fsent->fsname, snappath, startDir,
+		    startName, &restrictions);
+	}
+
+	/* set up the results list */
+	lstp = lst_create();
+	if (lstp == NULL) {
+		st = ENOMEM;
+		goto done;
+	}
+	*results = lstp;
+
+	if (bc != NULL) {
+		fid.snapid = bc->snapid;
+		snapdate = bc->snapdate;
+		dirid = bc->dirid;
+		strlcpy(fpath.pathname, startName, sizeof (fpath.pathname));
+		goto positioned;
+	}
 
 	st = get_snap_by_name(fsdb, snappath, &snapdata);
 
 	if (st != 0) {
-		return (ENOENT);
+		st = ENOENT;
+		goto done;
 	}
 
 	if (!(snapdata->flags & SNAPFLAG_READY)) {
 		/* what's a good error to indicate it exists, but is bad? */
-		free(snapdata);
-		return (EINVAL);
-	}
-
-	if (howmany == -1) {
-		getnum = 0;
-	} else {
-		getnum = howmany;
+		st = EINVAL;
+		goto done;
 	}
 
 	/* Get the directory id, if it's not NULL or "/" or "." or "" */
@@ -135,23 +186,14 @@ db_list_files(
 		strlcat(fpath.pathname, startDir, sizeof (fpath.pathname));
 	}
 
-	if ((startFile != NULL) && (startFile[0] != '\0') &&
-	    (strcmp(startFile, ".") != 0)) {
+	if (!start_is_dir) {
 		strlcat(fpath.pathname, "/", sizeof (fpath.pathname));
 		strlcat(fpath.pathname, startFile, sizeof (fpath.pathname));
-		start_is_dir = FALSE;
-	}
-
-	/* set up the results list */
-	lstp = lst_create();
-	if (lstp == NULL) {
-		st = ENOMEM;
-		goto done;
 	}
-	*results = lstp;
 
 	/* not changed through rest of function */
 	fid.snapid = snapdata->snapid;
+	snapdate = snapdata->snapdate;
 
 	/*
 	 * Try to get the requested file.  If it's not there, fail.
@@ -176,7 +218,7 @@ db_list_files(
 			namep = basename(fpath.pathname);
 		}
 		fid.fid = fileid;
-		st = add_file_info(fsdb, snapdata->snapdate, namep, &fid,
+		st = add_file_info(fsdb, snapdate, namep, &fid,
 		    &restrictions, getnum, which_details, lstp);
 
 		found++;
@@ -190,11 +232,22 @@ db_list_files(
 		fpath.pathname[0] = '\0';
 	} else {
 		/* for subsequent operations, we only want the file name */
-		namep = strrchr(startFile, '/');
-		if (namep == NULL) {
-			namep = startFile;
-		}
-		strlcpy(fpath.pathname, namep, sizeof (fpath.pathname));
+		strlcpy(fpath.pathname, startName, sizeof (fpath.pathname));
+	}
+
+positioned:
+	/* the start entry was returned by the previous page */
+	skip_start = (!start_is_dir && !includeStart);
+
+	/*
+	 * A file name pattern beginning with literal characters limits
+	 * the listing to the names sharing that prefix.  They are
+	 * adjacent in pathDB, so start from the first of them.
+	 */
+	plen = filter_prefix(&restrictions, prefix, sizeof (prefix));
+	if ((plen > 0) && (strncmp(fpath.pathname, prefix, plen) < 0)) {
+		strlcpy(fpath.pathname, prefix, sizeof (fpath.pathname));
+		skip_start = FALSE;
 	}
 
 	/* set up a cursor for the path database */
@@ -223,23 +276,28 @@ db_list_files(
 	data.flags = DB_DBT_USERMEM;
 
 	st = curs->c_pget(curs, &key, &pkey, &data, DB_SET_RANGE);
+
 	/*
-	 * We may have already included the first entry if includeStart is
-	 * TRUE.  SET_RANGE will only give us a new entry to include if
-	 * the starting point is the beginning of a directory, or the
-	 * requested starting point was not found.
+	 * SET_RANGE lands on the start entry if it's still in the
+	 * directory.  Skip it unless asked to include it.
 	 */
-	if ((st == 0) && (includeStart) && (!start_is_dir) && (found == 1)) {
+	if ((st == 0) && skip_start && (npath.parent == dirid) &&
+	    (strcmp(npath.pathname, startName) == 0)) {
 		st = curs->c_pget(curs, &key, &pkey, &data, DB_NEXT);
 	}
 
 	/* pathDB is already alphasorted, so we only need to count */
 	while ((st == 0) && (npath.parent == dirid)) {
-		/* this will always add the start entry.  fix later */
+		if ((plen > 0) &&
+		    (strncmp(npath.pathname, prefix, plen) != 0)) {
+			/* past the names matching the pattern's prefix */
+			break;
+		}
+
 		/* skip the root entry - it has no interesting data */
 		if (fileid != 0) {
 			fid.fid = fileid;
-			st = add_file_info(fsdb, snapdata->snapdate,
+			st = add_file_info(fsdb, snapdate,
 			    npath.pathname, &fid, &restrictions, getnum,
 			    which_details, lstp);
 			if (st == 0) {
@@ -250,6 +308,11 @@ db_list_files(
 			}
 		}
 
+		/* one match past the page is enough to know there's more */
+		if ((getnum != 0) && (found > getnum)) {
+			break;
+		}
+
 		st = curs->c_pget(curs, &key, &pkey, &data, DB_NEXT);
 	}
 
@@ -262,10 +325,40 @@ db_list_files(
 	}
 
 	*morefiles = found - lstp->length;
+
+	/* keep the position for the next page */
+	if ((st == 0) && (*morefiles != 0) && (lstp->tail != NULL)) {
+		if (bc == NULL) {
+			bc = calloc(1, sizeof (browse_cursor_t));
+		}
+		if (bc != NULL) {
+			strlcpy(bc->fsname, fsent->fsname,
+			    sizeof (bc->fsname));
+			strlcpy(bc->snapname, snappath,
+			    sizeof (bc->snapname));
+			strlcpy(bc->startDir,
+			    (startDir == NULL) ? "" : startDir,
+			    sizeof (bc->startDir));
+			strlcpy(bc->lastFile, ((filedetails_t *)
+			    lstp->tail->data)->file_name,
+			    sizeof (bc->lastFile));
+			memcpy(&bc->restrictions, &restrictions,
+			    sizeof (restrict_t));
+			bc->snapid = fid.snapid;
+			bc->snapdate = snapdate;
+			bc->dirid = dirid;
+			bc->gen = gen;
+			put_browse_cursor(bc);
+			bc = NULL;
+		}
+	}
 done:
 	if (curs != NULL) {
 		curs->c_close(curs);
 	}
+	if (bc != NULL) {
+		free(bc);
+	}
 	if (snapdata) {
 		free(snapdata);
 	}
@@ -278,6 +371,31 @@ done:
 	return (st);
 }
 
+/*
+ *  Copies the literal characters at the start of a file name pattern
+ *  to prefix.  Returns the length of the prefix, 0 if the listing is
+ *  not filtered by name or the pattern starts with a special character.
+ */
+static size_t
+filter_prefix(restrict_t *filter, char *prefix, size_t len)
+{
+	size_t		i;
+
+	if (!(filter->flags & fl_filename)) {
+		return (0);
+	}
+
+	for (i = 0; (i < len - 1) && (filter->filename[i] != '\0'); i++) {
+		if (strchr("*?[\\", filter->filename[i]) != NULL) {
+			break;
+		}
+		prefix[i] = filter->filename[i];
+	}
+	prefix[i] = '\0';
+
+	return (i);
+}
+
 static int
 check_restrict_filinfo(restrict_t *filter, filinfo_t *filinfo)
 {
@@ -28,6 +28,8 @@
  */
 #include <string.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
 #include <sys/stat.h>
 #include <libgen.h>
 #include <pwd.h>
@@ -42,11 +44,48 @@
 #define	HOUR	60 * 60
 #define	DAY	24 * HOUR
 
-/* Common argument structure for all metrics reports */
+/*
+ *  Metrics are aggregated by worker threads, each into its own set of
+ *  partial results.  The importing thread only copies the fields the
+ *  reports need into a batch and queues the batch.  When the import
+ *  is complete the partial results are merged, so the reports cover
+ *  exactly the entries of the snapshot regardless of which thread
+ *  counted them.
+ */
+#define	FM_BATCH	4096		/* entries in a batch */
+#define	FM_MAX_THREADS	8		/* most worker threads */
+#define	FM_QUEUE_DEPTH	2		/* queued batches per worker */
+#define	FM_TOPK		10		/* entries in a top 10 report */
+#define	FM_AGG_INIT	1024		/* initial slots in an id table */
+
+/* The fields of a file used by the reports */
 typedef struct {
-	uint32_t	snapdate;
-	boolean_t	done;
-} fmRptArg_t;
+	uint32_t	owner;
+	uint32_t	group;
+	uint32_t	mtime;
+	uint32_t	atime;
+	uint64_t	size;
+	uint64_t	osize;
+	int		media[4];
+	boolean_t	hasmedia;
+} fmEntry_t;
+
+typedef struct fmBatch_s {
+	struct fmBatch_s	*next;
+	int			count;
+	fmEntry_t		ent[FM_BATCH];
+} fmBatch_t;
+
+/*
+ *  Open addressed table of per-id totals for the top 10 reports.
+ *  A slot with a zero count is empty, every id entered has counted
+ *  at least one file.
+ */
+typedef struct {
+	agg_size_t	*slots;
+	uint32_t	size;			/* power of 2 */
+	uint32_t	used;
+} aggTable_t;
 
 /*
  * Struct to hold report results - filled in by the report functions
@@ -54,62 +93,114 @@ typedef struct {
  * for quick retrieval/report processing.
  */
 typedef struct {
-	DB			*rptDB;
+	aggTable_t		agg;
 	uint32_t		rptSize;
 	void			*result;
 } fmFuncRes_t;
 
+struct fmRptArg_s;
+
+typedef struct {
+	pthread_t		tid;
+	struct fmRptArg_s	*arg;
+	fmFuncRes_t		res[NUM_FM_RPTS];	/* partial results */
+} fmWorker_t;
+
+/* Common argument structure for all metrics reports */
+typedef struct fmRptArg_s {
+	uint32_t	snapdate;
+	boolean_t	done;
+	pthread_mutex_t	lock;
+	pthread_cond_t	work;		/* batch queued or quit */
+	pthread_cond_t	space;		/* batch taken from the queue */
+	fmBatch_t	*head;		/* queued batches */
+	fmBatch_t	*tail;
+	int		queued;
+	fmBatch_t	*freelist;	/* batches to reuse */
+	boolean_t	quit;		/* no more batches will be queued */
+	boolean_t	discard;	/* drop queued batches */
+	int		error;		/* first error from a worker */
+	fmBatch_t	*cur;		/* batch being filled */
+	int		nthreads;	/* running worker threads */
+	fmWorker_t	*workers;
+} fmRptArg_t;
+
 /*
  *  All file metrics functions conform to this prototype
  */
 typedef int (*file_metric_func_t)(
-	filinfo_t	*filinfo,
-	filvar_t	*filvar,
+	fmEntry_t	*ent,
 	fmRptArg_t	*arg,
-	int		*media,
 	fmFuncRes_t	*results
 );
 
-/*  Used to construct top 10 lists */
-typedef struct agg_list_s {
-	agg_size_t		*agg;
-	struct agg_list_s	*next;
-	struct agg_list_s	*prev;
-} agg_list_t;
+/*
+ *  Merge a worker's partial results into the totals.  Called with
+ *  a NULL part once all workers have been merged to complete the
+ *  report.
+ */
+typedef int (*file_metric_merge_t)(
+	fmFuncRes_t	*total,
+	fmFuncRes_t	*part
+);
 
 /*  Function Prototypes */
 static int
-do_file_age(filinfo_t *filinfo, filvar_t *filvar, fmRptArg_t *arg,
-	int *media, fmFuncRes_t *results);
+do_file_age(fmEntry_t *ent, fmRptArg_t *arg, fmFuncRes_t *results);
+
+static int
+do_file_useful(fmEntry_t *ent, fmRptArg_t *arg, fmFuncRes_t *results);
+
+static int
+do_top10_users(fmEntry_t *ent, fmRptArg_t *arg, fmFuncRes_t *results);
+
+static int
+do_top10_groups(fmEntry_t *ent, fmRptArg_t *arg, fmFuncRes_t *results);
+
+static int
+do_storage_tiers(fmEntry_t *ent, fmRptArg_t *arg, fmFuncRes_t *results);
 
 static int
-do_file_useful(filinfo_t *filinfo, filvar_t *filvar, fmRptArg_t *arg,
-	int *media, fmFuncRes_t *results);
+merge_file_age(fmFuncRes_t *total, fmFuncRes_t *part);
 
 static int
-do_top10_users(filinfo_t *filinfo, filvar_t *filvar, fmRptArg_t *arg,
-	int *media, fmFuncRes_t *results);
+merge_storage_tiers(fmFuncRes_t *total, fmFuncRes_t *part);
 
 static int
-do_top10_groups(filinfo_t *filinfo, filvar_t *filvar, fmRptArg_t *arg,
-	int *media, fmFuncRes_t *results);
+merge_top10(fmFuncRes_t *total, fmFuncRes_t *part);
 
 static int
-do_storage_tiers(filinfo_t *filinfo, filvar_t *filvar, fmRptArg_t *arg,
-	int *media, fmFuncRes_t *results);
+agg_add(aggTable_t *tbl, agg_size_t *agg);
+
+static boolean_t
+agg_ranks_lower(agg_size_t *a, agg_size_t *b);
+
+static int
+process_batch(fmBatch_t *batch, fmRptArg_t *arg, fmFuncRes_t *res);
 
 static int
-do_top10(filinfo_t *filinfo, filvar_t *filvar, boolean_t done,
-	fm_rptno_t which, fmFuncRes_t *results);
+queue_batch(fmRptArg_t *arg);
+
+static void *
+metrics_worker(void *warg);
+
+static void
+stop_workers(fmRptArg_t *arg, boolean_t discard);
+
+static void
+free_results(fmFuncRes_t *res);
 
 /* Globals */
 
-file_metric_func_t	rptFuncArr[NUM_FM_RPTS] = {
-	do_file_age,
-	do_file_useful,
-	do_top10_users,
-	do_top10_groups,
-	do_storage_tiers,
+struct {
+	file_metric_func_t	gather;
+	file_metric_merge_t	merge;
+} rptFuncArr[NUM_FM_RPTS] = {
+	{ do_file_age,		merge_file_age },
+	{ do_file_useful,	merge_file_age },
+	{ do_top10_users,	merge_top10 },
+	{ do_top10_groups,	merge_top10 },
+	{ do_storage_tiers,	merge_storage_tiers },
 };
 
 static char *xmlAgeStrs[6] = {
@@ -134,7 +225,8 @@ char *xmlRptName[] = {
  *
  *  Metrics are generated as data is being input.  While this may slow
  *  down the import slightly, it's faster than processing the same data
- *  twice.
+ *  twice.  The entry is copied into a batch which is counted by one of
+ *  the worker threads started on the first call.
  */
 int
 gather_snap_metrics(
@@ -147,10 +239,11 @@ gather_snap_metrics(
 	void		**rptRes		/* in/out, opaque */
 )
 {
-	int		st;
+	int		st = 0;
 	int		i;
+	int		ncpu;
 	fmRptArg_t	*rptArgp;
-	fmFuncRes_t	*rptResp;
+	fmEntry_t	*ent;
 
 	if ((fsdb == NULL) || (snapinfo == NULL) || (finfo == NULL) ||
 	    (filvar == NULL) || (rptArg == NULL) || (rptRes == NULL)) {
@@ -162,31 +255,83 @@ gather_snap_metrics(
 		if (rptArgp == NULL) {
 			return (ENOMEM);
 		}
-		*rptArg = rptArgp;
 		rptArgp->snapdate = snapinfo->snapdate;
 		rptArgp->done = FALSE;
 
+		ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+		if (ncpu > FM_MAX_THREADS + 1) {
+			ncpu = FM_MAX_THREADS + 1;
+		}
+
+		/* always one set of partial results, even without threads */
+		rptArgp->workers = calloc((ncpu > 2) ? ncpu - 1 : 1,
+		    sizeof (fmWorker_t));
+		if (rptArgp->workers == NULL) {
+			free(rptArgp);
+			return (ENOMEM);
+		}
+		(void) pthread_mutex_init(&rptArgp->lock, NULL);
+		(void) pthread_cond_init(&rptArgp->work, NULL);
+		(void) pthread_cond_init(&rptArgp->space, NULL);
+		*rptArg = rptArgp;
+
+		/*
+		 * Leave a processor for the import.  If no worker thread
+		 * can be started, batches are counted by this thread.
+		 */
+		for (i = 0; i < ncpu - 1; i++) {
+			rptArgp->workers[i].arg = rptArgp;
+			if (pthread_create(&rptArgp->workers[i].tid, NULL,
+			    metrics_worker, &rptArgp->workers[i]) != 0) {
+				break;
+			}
+			rptArgp->nthreads++;
+		}
 	} else {
 		rptArgp = *rptArg;
 	}
 
 	if (*rptRes == NULL) {
-		rptResp = calloc(NUM_FM_RPTS, sizeof (fmFuncRes_t));
-		if (rptResp == NULL) {
-			free(rptArgp);
+		*rptRes = calloc(NUM_FM_RPTS, sizeof (fmFuncRes_t));
+		if (*rptRes == NULL) {
+			free_metrics_results(rptArg, rptRes);
 			return (ENOMEM);
 		}
-		*rptRes = rptResp;
-	} else {
-		rptResp = *rptRes;
 	}
 
-	for (i = 0; i < NUM_FM_RPTS; i++) {
-		st = rptFuncArr[i](finfo, filvar, rptArgp, media,
-		    &(rptResp[i]));
-		if (st != 0) {
-			break;
+	if (rptArgp->cur == NULL) {
+		(void) pthread_mutex_lock(&rptArgp->lock);
+		rptArgp->cur = rptArgp->freelist;
+		if (rptArgp->cur != NULL) {
+			rptArgp->freelist = rptArgp->cur->next;
+		}
+		(void) pthread_mutex_unlock(&rptArgp->lock);
+
+		if (rptArgp->cur == NULL) {
+			rptArgp->cur = malloc(sizeof (fmBatch_t));
+			if (rptArgp->cur == NULL) {
+				free_metrics_results(rptArg, rptRes);
+				return (ENOMEM);
+			}
 		}
+		rptArgp->cur->next = NULL;
+		rptArgp->cur->count = 0;
+	}
+
+	ent = &rptArgp->cur->ent[rptArgp->cur->count++];
+	ent->owner = finfo->owner;
+	ent->group = finfo->group;
+	ent->mtime = filvar->mtime;
+	ent->atime = filvar->atime;
+	ent->size = finfo->size;
+	ent->osize = finfo->osize;
+	ent->hasmedia = (media != NULL);
+	for (i = 0; i < 4; i++) {
+		ent->media[i] = (media != NULL) ? media[i] : 0;
+	}
+
+	if (rptArgp->cur->count == FM_BATCH) {
+		st = queue_batch(rptArgp);
 	}
 
 	if (st != 0) {
@@ -212,6 +357,8 @@ finish_snap_metrics(
 	int		st;
 	DB		*dbp;
 	int		i;
+	int		w;
+	int		nparts;
 	DBT		key;
 	DBT		data;
 	fmrpt_key_t	rptKey;
@@ -231,11 +378,29 @@ finish_snap_metrics(
 		return (-1);
 	}
 
-	/*  If the specific reports need to post-process results, do it now */
+	/* count the last batch and wait for the workers to drain */
+	st = 0;
+	if ((rptArgp->cur != NULL) && (rptArgp->cur->count > 0)) {
+		st = queue_batch(rptArgp);
+	}
+	stop_workers(rptArgp, FALSE);
+	if ((st != 0) || ((st = rptArgp->error) != 0)) {
+		goto done;
+	}
+
+	/*  Merge the partial results, then post-process the reports */
 	rptArgp->done = TRUE;
+	nparts = ((rptArgp->nthreads > 0) ? rptArgp->nthreads : 1);
 
 	for (i = 0; i < NUM_FM_RPTS; i++) {
-		st = rptFuncArr[i](NULL, NULL, rptArgp, NULL, &(rptResp[i]));
+		for (w = 0; w < nparts; w++) {
+			st = rptFuncArr[i].merge(&(rptResp[i]),
+			    &(rptArgp->workers[w].res[i]));
+			if (st != 0) {
+				goto done;
+			}
+		}
+		st = rptFuncArr[i].merge(&(rptResp[i]), NULL);
 		if (st != 0) {
 			goto done;
 		}
@@ -296,11 +461,32 @@ free_metrics_results(
 	void		**rptRes		/* in/out, opaque */
 )
 {
+	fmRptArg_t	*rptArgp;
 	fmFuncRes_t	*rptResp;
+	fmBatch_t	*batch;
+	int		nparts;
 	int		i;
 
 	if ((rptArg != NULL) && (*rptArg != NULL)) {
-		free(*rptArg);
+		rptArgp = *rptArg;
+
+		/* abandoned import, drop anything still queued */
+		stop_workers(rptArgp, TRUE);
+
+		nparts = ((rptArgp->nthreads > 0) ? rptArgp->nthreads : 1);
+		for (i = 0; i < nparts; i++) {
+			free_results(rptArgp->workers[i].res);
+		}
+		while ((batch = rptArgp->freelist) != NULL) {
+			rptArgp->freelist = batch->next;
+			free(batch);
+		}
+		free(rptArgp->cur);
+		(void) pthread_cond_destroy(&rptArgp->space);
+		(void) pthread_cond_destroy(&rptArgp->work);
+		(void) pthread_mutex_destroy(&rptArgp->lock);
+		free(rptArgp->workers);
+		free(rptArgp);
 		*rptArg = NULL;
 	}
 
@@ -313,27 +499,174 @@ free_metrics_results(
 		return;
 	}
 
+	free_results(rptResp);
+
+	free(rptResp);
+	*rptRes = NULL;
+}
+
+/*
+ *  Frees the results of all reports in a set
+ */
+static void
+free_results(fmFuncRes_t *res)
+{
+	int		i;
+
 	for (i = 0; i < NUM_FM_RPTS; i++) {
-		/* some reports create in-memory databases, close them */
-		if (rptResp[i].rptDB != NULL) {
-			(rptResp[i].rptDB)->close(rptResp[i].rptDB, 0);
+		/* top 10 reports keep an id table while counting */
+		if (res[i].agg.slots != NULL) {
+			free(res[i].agg.slots);
+			res[i].agg.slots = NULL;
 		}
-		if (rptResp[i].result != NULL) {
-			free(rptResp[i].result);
+		if (res[i].result != NULL) {
+			free(res[i].result);
+			res[i].result = NULL;
 		}
+	}
+}
+
+/*
+ *  Queues the batch being filled.  Waits while the workers are
+ *  behind so a fast import doesn't buffer the whole snapshot.
+ *  Without workers the batch is counted here.
+ */
+static int
+queue_batch(fmRptArg_t *arg)
+{
+	fmBatch_t	*batch = arg->cur;
+	int		st = 0;
 
+	arg->cur = NULL;
+
+	if (arg->nthreads == 0) {
+		st = process_batch(batch, arg, arg->workers[0].res);
+		free(batch);
+		return (st);
 	}
 
-	free(rptResp);
-	*rptRes = NULL;
+	(void) pthread_mutex_lock(&arg->lock);
+	while ((arg->queued >= arg->nthreads * FM_QUEUE_DEPTH) &&
+	    (arg->error == 0)) {
+		(void) pthread_cond_wait(&arg->space, &arg->lock);
+	}
+	st = arg->error;
+	if (st == 0) {
+		if (arg->tail == NULL) {
+			arg->head = batch;
+		} else {
+			arg->tail->next = batch;
+		}
+		arg->tail = batch;
+		arg->queued++;
+		(void) pthread_cond_signal(&arg->work);
+	} else {
+		batch->next = arg->freelist;
+		arg->freelist = batch;
+	}
+	(void) pthread_mutex_unlock(&arg->lock);
+
+	return (st);
+}
+
+/*
+ *  Counts every entry in a batch into one set of results
+ */
+static int
+process_batch(fmBatch_t *batch, fmRptArg_t *arg, fmFuncRes_t *res)
+{
+	int		st;
+	int		i;
+	int		j;
+
+	for (j = 0; j < batch->count; j++) {
+		for (i = 0; i < NUM_FM_RPTS; i++) {
+			st = rptFuncArr[i].gather(&batch->ent[j], arg,
+			    &(res[i]));
+			if (st != 0) {
+				return (st);
+			}
+		}
+	}
+	return (0);
+}
+
+/*
+ *  Worker thread.  Counts queued batches into its partial results
+ *  until told to quit and the queue is empty.
+ */
+static void *
+metrics_worker(void *warg)
+{
+	fmWorker_t	*worker = (fmWorker_t *)warg;
+	fmRptArg_t	*arg = worker->arg;
+	fmBatch_t	*batch;
+	int		st;
+
+	(void) pthread_mutex_lock(&arg->lock);
+	for (;;) {
+		while ((arg->head == NULL) && (arg->quit == FALSE)) {
+			(void) pthread_cond_wait(&arg->work, &arg->lock);
+		}
+		if ((batch = arg->head) == NULL) {
+			break;
+		}
+		arg->head = batch->next;
+		if (arg->head == NULL) {
+			arg->tail = NULL;
+		}
+		arg->queued--;
+		(void) pthread_cond_signal(&arg->space);
+
+		st = 0;
+		if ((arg->error == 0) && (arg->discard == FALSE)) {
+			(void) pthread_mutex_unlock(&arg->lock);
+			st = process_batch(batch, arg, worker->res);
+			(void) pthread_mutex_lock(&arg->lock);
+		}
+		if ((st != 0) && (arg->error == 0)) {
+			arg->error = st;
+			/* wake the importer so it sees the error */
+			(void) pthread_cond_broadcast(&arg->space);
+		}
+		batch->next = arg->freelist;
+		arg->freelist = batch;
+	}
+	(void) pthread_mutex_unlock(&arg->lock);
+
+	return (NULL);
+}
+
+/*
+ *  Tells the workers no more batches are coming and waits for them
+ *  to exit.  If discard is set, queued batches are not counted.
+ */
+static void
+stop_workers(fmRptArg_t *arg, boolean_t discard)
+{
+	int		i;
+
+	if (arg->quit == TRUE) {
+		return;
+	}
+
+	(void) pthread_mutex_lock(&arg->lock);
+	arg->quit = TRUE;
+	if (discard == TRUE) {
+		arg->discard = TRUE;
+	}
+	(void) pthread_cond_broadcast(&arg->work);
+	(void) pthread_mutex_unlock(&arg->lock);
+
+	for (i = 0; i < arg->nthreads; i++) {
+		(void) pthread_join(arg->workers[i].tid, NULL);
+	}
 }
 
 static int
 do_file_age(
-	filinfo_t	*filinfo,
-	filvar_t	*filvar,
+	fmEntry_t	*ent,
 	fmRptArg_t	*arg,
-	int		*media,	/* ARGSUSED */
 	fmFuncRes_t	*results)
 {
 	file_age_t	*ageres = NULL;
@@ -343,15 +676,7 @@ do_file_age(
 	int32_t		start;
 	int32_t		end;
 
-	if (arg == NULL) {
-		return (-1);
-	}
-
-	if (arg->done == TRUE) {
-		return (0);
-	}
-
-	if ((results == NULL) || (filinfo == NULL) || (filvar == NULL)) {
+	if ((arg == NULL) || (ent == NULL) || (results == NULL)) {
 		return (-1);
 	}
 
@@ -376,7 +701,7 @@ do_file_age(
 		results->result = ageres;
 	}
 
-	age = arg->snapdate - filvar->mtime;
+	age = arg->snapdate - ent->mtime;
 
 	for (i = 0; i < 5; i++) {
 		start = (ageres[i].start == -1) ? -1 : ageres[i].start * DAY;
@@ -398,8 +723,8 @@ do_file_age(
 
 		if (match == TRUE) {
 			ageres[i].count++;
-			ageres[i].total_size += filinfo->size;
-			ageres[i].total_osize += filinfo->osize;
+			ageres[i].total_size += ent->size;
+			ageres[i].total_osize += ent->osize;
 			break;
 		}
 	}
@@ -409,10 +734,8 @@ do_file_age(
 
 static int
 do_file_useful(
-	filinfo_t	*filinfo,
-	filvar_t	*filvar,
+	fmEntry_t	*ent,
 	fmRptArg_t	*arg,
-	int		*media,	/* ARGSUSED */
 	fmFuncRes_t	*results)
 {
 	file_age_t	*ageres = NULL;
@@ -422,15 +745,7 @@ do_file_useful(
 	int32_t		start;
 	int32_t		end;
 
-	if (arg == NULL) {
-		return (-1);
-	}
-
-	if (arg->done == TRUE) {
-		return (0);
-	}
-
-	if ((filinfo == NULL) || (filvar == NULL) || (results == NULL)) {
+	if ((arg == NULL) || (ent == NULL) || (results == NULL)) {
 		return (-1);
 	}
 
@@ -456,7 +771,7 @@ do_file_useful(
 		results->result = ageres;
 	}
 
-	age = arg->snapdate - filvar->atime;
+	age = arg->snapdate - ent->atime;
 
 	for (i = 0; i < 5; i++) {
 		start = (ageres[i].start == -1) ? -1 : ageres[i].start * DAY;
@@ -478,8 +793,8 @@ do_file_useful(
 
 		if (match == TRUE) {
 			ageres[i].count++;
-			ageres[i].total_size += filinfo->size;
-			ageres[i].total_osize += filinfo->osize;
+			ageres[i].total_size += ent->size;
+			ageres[i].total_osize += ent->osize;
 			break;
 		}
 	}
@@ -487,22 +802,47 @@ do_file_useful(
 	return (0);
 }
 
+/*
+ *  Merge function shared by the file age and file useful reports.
+ *  The partial results have the same ranges, add up the totals.
+ */
 static int
-do_storage_tiers(filinfo_t *filinfo, filvar_t *filvar, fmRptArg_t *arg,
-	int *media, fmFuncRes_t *results)
+merge_file_age(fmFuncRes_t *total, fmFuncRes_t *part)
 {
-	tier_usage_t		*tiers = NULL;
-	int			i;
+	file_age_t	*to;
+	file_age_t	*from;
+	int		i;
 
-	if (arg == NULL) {
-		return (-1);
+	if ((part == NULL) || (part->result == NULL)) {
+		return (0);
 	}
 
-	if (arg->done == TRUE) {
+	if (total->result == NULL) {
+		/* first partial result, take it over */
+		total->result = part->result;
+		total->rptSize = part->rptSize;
+		part->result = NULL;
 		return (0);
 	}
 
-	if ((filinfo == NULL) || (filvar == NULL) || (results == NULL)) {
+	to = total->result;
+	from = part->result;
+	for (i = 0; i < total->rptSize / sizeof (file_age_t); i++) {
+		to[i].count += from[i].count;
+		to[i].total_size += from[i].total_size;
+		to[i].total_osize += from[i].total_osize;
+	}
+
+	return (0);
+}
+
+static int
+do_storage_tiers(fmEntry_t *ent, fmRptArg_t *arg, fmFuncRes_t *results)
+{
+	tier_usage_t		*tiers = NULL;
+	int			i;
+
+	if ((arg == NULL) || (ent == NULL) || (results == NULL)) {
 		return (-1);
 	}
 
@@ -525,16 +865,16 @@ do_storage_tiers(filinfo_t *filinfo, filvar_t *filvar, fmRptArg_t *arg,
 		tiers[3].mtype = DT_STK5800;	/* honeycomb archive */
 	}
 
-	tiers[0].used += filinfo->osize;
+	tiers[0].used += ent->osize;
 
-	if (media == NULL) {
+	if (ent->hasmedia == FALSE) {
 		/* nothing else to do */
 		return (0);
 	}
 
 	/* process all the archive copies */
 	for (i = 0; i < 4; i++) {
-		if (media[i] == 0) {
+		if (ent->media[i] == 0) {
 			continue;
 		}
 
@@ -542,14 +882,14 @@ do_storage_tiers(filinfo_t *filinfo, filvar_t *filvar, fmRptArg_t *arg,
 		 * Honeycomb masks out as DT_DISK with DT_CLASS_MASK so
 		 * call it out separately here.
 		 */
-		if (media[i] == DT_STK5800) {
-			tiers[3].used += filinfo->size;
+		if (ent->media[i] == DT_STK5800) {
+			tiers[3].used += ent->size;
 			continue;
 		}
 
-		switch (media[i] & DT_CLASS_MASK) {
+		switch (ent->media[i] & DT_CLASS_MASK) {
 			case DT_DISK:
-				tiers[1].used += filinfo->size;
+				tiers[1].used += ent->size;
 				break;
 			case DT_TAPE:
 			default:
@@ -557,294 +897,259 @@ do_storage_tiers(filinfo_t *filinfo, filvar_t *filvar, fmRptArg_t *arg,
 				 * for now, if it's not disk, or Honeycomb,
 				 * it's tape.
 				 */
-				tiers[2].used += filinfo->size;
+				tiers[2].used += ent->size;
 				break;
 		}
 	}
 	return (0);
 }
 
+static int
+merge_storage_tiers(fmFuncRes_t *total, fmFuncRes_t *part)
+{
+	tier_usage_t	*to;
+	tier_usage_t	*from;
+	int		i;
+
+	if ((part == NULL) || (part->result == NULL)) {
+		return (0);
+	}
+
+	if (total->result == NULL) {
+		total->result = part->result;
+		total->rptSize = part->rptSize;
+		part->result = NULL;
+		return (0);
+	}
+
+	to = total->result;
+	from = part->result;
+	for (i = 0; i < 4; i++) {
+		to[i].used += from[i].used;
+	}
+
+	return (0);
+}
+
 static int
 do_top10_users(
-	filinfo_t	*filinfo,
-	filvar_t	*filvar,
+	fmEntry_t	*ent,
 	fmRptArg_t	*arg,
-	int		*media,	/* ARGSUSED */
 	fmFuncRes_t	*results)
 {
-	int		st;
+	agg_size_t	agg;
 
-	if ((arg == NULL) || (results == NULL)) {
+	if ((arg == NULL) || (ent == NULL) || (results == NULL)) {
 		return (-1);
 	}
 
-	st = do_top10(filinfo, filvar, arg->done, TOP_USERS, results);
+	agg.id = ent->owner;
+	agg.count = 1;
+	agg.total_size = ent->size;
+	agg.total_osize = ent->osize;
 
-	return (st);
+	return (agg_add(&results->agg, &agg));
 }
 
 static int
 do_top10_groups(
-	filinfo_t	*filinfo,
-	filvar_t	*filvar,
+	fmEntry_t	*ent,
 	fmRptArg_t	*arg,
-	int		*media,	/* ARGSUSED */
 	fmFuncRes_t	*results)
 {
-	int		st;
+	agg_size_t	agg;
 
-	if ((arg == NULL) || (results == NULL)) {
+	if ((arg == NULL) || (ent == NULL) || (results == NULL)) {
 		return (-1);
 	}
 
-	st = do_top10(filinfo, filvar, arg->done, TOP_GROUPS,
-	    results);
+	agg.id = ent->group;
+	agg.count = 1;
+	agg.total_size = ent->size;
+	agg.total_osize = ent->osize;
 
-	return (st);
+	return (agg_add(&results->agg, &agg));
 }
 
 /*
- *  worker function shared between top10Users and top10Groups
- *
- *  Creates in-memory only database to store temporary results
- *  as long as done == FALSE.  As soon as done is set to TRUE,
- *  generate the top10 lists for the database.
- *
- *  The results parameter is used to pass the database pointer around
- *  while calculating, then changes to an agg_type_t when complete.
- *
+ *  Adds agg's counts to its id's totals in the table.  The table
+ *  is doubled when it becomes 3/4 full.
  */
 static int
-do_top10(filinfo_t *filinfo, filvar_t *filvar, boolean_t done,	/* ARGSUSED */
-	fm_rptno_t which, fmFuncRes_t *results)
+agg_add(aggTable_t *tbl, agg_size_t *agg)
 {
-	int		st = 0;
-	DB		*dbp;
-	DBC		*curs;
-	DBT		key;
-	DBT		data;
-	DB_TXN		*txn = NULL;
-	agg_size_t	agg;
-	agg_list_t	*agglist = NULL;
-	agg_size_t	*aggp;
-	int		i;
-	agg_size_t	*aggreport;
-
-	dbp = results->rptDB;
-
-	if (done == FALSE) {
-		if ((filinfo == NULL) || (filvar == NULL)) {
-			return (-1);
+	agg_size_t	*slot;
+	uint32_t	mask;
+	uint32_t	h;
+	uint32_t	i;
+
+	if ((tbl->used + 1) * 4 > tbl->size * 3) {
+		aggTable_t	grown;
+
+		grown.size = (tbl->size == 0) ? FM_AGG_INIT : tbl->size * 2;
+		grown.used = 0;
+		grown.slots = calloc(grown.size, sizeof (agg_size_t));
+		if (grown.slots == NULL) {
+			return (ENOMEM);
 		}
-
-		if (dbp == NULL) {
-			st = db_create(&dbp, dbEnv, 0);
-			if (st != 0) {
-				return (st);
+		for (i = 0; i < tbl->size; i++) {
+			if (tbl->slots[i].count != 0) {
+				(void) agg_add(&grown, &tbl->slots[i]);
 			}
-			/* no duplicates, sort on id */
-			st = dbp->set_bt_compare(dbp, bt_compare_uint64);
-			if (st != 0) {
-				dbp->remove(dbp, NULL, NULL, 0);
-				return (st);
-			}
-
-			st = dbp->open(dbp, NULL, NULL, NULL, DB_BTREE,
-			    db_fl, 0644);
-			if (st != 0) {
-				dbp->remove(dbp, NULL, NULL, 0);
-				return (st);
-			}
-
-			results->rptDB = dbp;
-		}
-
-		memset(&agg, 0, sizeof (agg_size_t));
-
-		if (which == TOP_USERS) {
-			agg.id = filinfo->owner;
-		} else {
-			agg.id = filinfo->group;
 		}
+		free(tbl->slots);
+		*tbl = grown;
+	}
 
-		/* fetch id info if it exists */
-		memset(&key, 0, sizeof (DBT));
-		memset(&data, 0, sizeof (DBT));
-
-		key.data = &agg.id;
-		key.size = sizeof (uint64_t);
-
-		data.data = &agg;
-		data.size = data.ulen = sizeof (agg_size_t);
-		data.flags = DB_DBT_USERMEM;
-
-		dbEnv->txn_begin(dbEnv, NULL, &txn, 0);
-		st = dbp->get(dbp, txn, &key, &data, 0);
-
-		if ((st != 0) && (st != DB_NOTFOUND)) {
-			txn->abort(txn);
-			return (st);
+	mask = tbl->size - 1;
+	h = (uint32_t)((agg->id * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+	for (;;) {
+		slot = &tbl->slots[h];
+		if (slot->count == 0) {
+			slot->id = agg->id;
+			tbl->used++;
+			break;
 		}
-
-		agg.count++;
-		agg.total_size += filinfo->size;
-		agg.total_osize += filinfo->osize;
-
-		st = dbp->put(dbp, txn, &key, &data, 0);
-		if (st == 0) {
-			st = txn->commit(txn, 0);
-		} else {
-			txn->abort(txn);
+		if (slot->id == agg->id) {
+			break;
 		}
+		h = (h + 1) & mask;
 	}
+	slot->count += agg->count;
+	slot->total_size += agg->total_size;
+	slot->total_osize += agg->total_osize;
 
-	/* final processing */
-	if (done == TRUE) {
-		uint64_t	aggid = 0;
-		int 		numids = 0;
-		agg_list_t	*aggent;
-		agg_list_t	*ptr;
-		agg_list_t	*last;
-
-		if (dbp == NULL) {
-			return (-1);
-		}
+	return (0);
+}
 
-		dbEnv->txn_begin(dbEnv, NULL, &txn, 0);
+/*
+ *  Ordering of the top 10 reports, by size used then by id so the
+ *  report doesn't depend on which worker counted which file.
+ */
+static boolean_t
+agg_ranks_lower(agg_size_t *a, agg_size_t *b)
+{
+	if (a->total_size != b->total_size) {
+		return (a->total_size < b->total_size);
+	}
+	return (a->id > b->id);
+}
 
-		st = dbp->cursor(dbp, txn, &curs, 0);
-		if (st != 0) {
-			/* blast db? */
-			txn->abort(txn);
-			return (st);
+/*
+ *  Merge function shared between top10Users and top10Groups
+ *
+ *  Each worker's id table is added into the totals.  When all are
+ *  merged, the 10 largest ids are selected with a min-heap of the
+ *  10 largest seen so far, and the table changes to an agg_size_t
+ *  report.
+ */
+static int
+merge_top10(fmFuncRes_t *total, fmFuncRes_t *part)
+{
+	agg_size_t	heap[FM_TOPK];
+	agg_size_t	tmp;
+	agg_size_t	*aggreport;
+	aggTable_t	*tbl = &total->agg;
+	int		n;
+	int		i;
+	int		c;
+	uint32_t	s;
+
+	if (part != NULL) {
+		if (total->agg.slots == NULL) {
+			total->agg = part->agg;
+			memset(&part->agg, 0, sizeof (aggTable_t));
+			return (0);
 		}
-
-		memset(&key, 0, sizeof (DBT));
-		memset(&data, 0, sizeof (DBT));
-
-		key.data = &aggid;
-		key.size = key.ulen = sizeof (uint64_t);
-		key.flags = DB_DBT_USERMEM;
-
-		data.flags = DB_DBT_MALLOC;
-
-		/* fetch first entry */
-		while ((st = curs->c_get(curs, &key, &data, DB_NEXT)) == 0) {
-			aggp = (agg_size_t *)data.data;
-			last = NULL;
-
-			if (agglist == NULL) {
-				aggent = malloc(sizeof (agg_list_t));
-				aggent->agg = aggp;
-
-				aggent->prev = NULL;
-				aggent->next = NULL;
-				agglist = aggent;
-
-				numids = 1;
+		for (s = 0; s < part->agg.size; s++) {
+			if (part->agg.slots[s].count == 0) {
 				continue;
 			}
-
-			ptr = agglist;
-
-			while (ptr != NULL) {
-				last = ptr;
-				if (aggp->total_size >
-				    ptr->agg->total_size) {
-					break;
-				}
-				ptr = ptr->next;
-			}
-
-			if ((ptr != NULL) || (numids < 10)) {
-				aggent = malloc(sizeof (agg_list_t));
-				if (aggent == NULL) {
-					st = ENOMEM;
-					goto done;
-				}
-				aggent->agg = aggp;
-				aggent->next = ptr;
-				if (ptr != NULL) {
-					aggent->prev = ptr->prev;
-					if (ptr->prev != NULL) {
-						ptr->prev->next = aggent;
-					}
-					ptr->prev = aggent;
-				} else {
-					aggent->prev = last;
-					if (last != NULL) {
-						last->next = aggent;
-					}
-				}
-
-				if (aggent->prev == NULL) {
-					agglist = aggent;
-				}
-				numids++;
-				aggp = NULL;
+			if (agg_add(tbl, &part->agg.slots[s]) != 0) {
+				return (ENOMEM);
 			}
+		}
+		return (0);
+	}
 
-			if (numids > 10) {
-				ptr = agglist;
-
-				while (ptr->next != NULL) {
-					ptr = ptr->next;
-				}
-
-				free(ptr->agg);
-				ptr->prev->next = NULL;
-				free(ptr);
-				numids--;
-			}
+	/* final processing */
+	if (tbl->slots == NULL) {
+		/* nothing counted */
+		return (-1);
+	}
 
-			if (aggp != NULL) {
-				free(aggp);
+	n = 0;
+	for (s = 0; s < tbl->size; s++) {
+		if (tbl->slots[s].count == 0) {
+			continue;
+		}
+		if (n < FM_TOPK) {
+			/* sift up */
+			i = n++;
+			heap[i] = tbl->slots[s];
+			while ((i > 0) &&
+			    agg_ranks_lower(&heap[i], &heap[(i - 1) / 2])) {
+				tmp = heap[i];
+				heap[i] = heap[(i - 1) / 2];
+				heap[(i - 1) / 2] = tmp;
+				i = (i - 1) / 2;
 			}
+			continue;
 		}
-
-		/* done with the in-mem database now */
-		(void) curs->c_close(curs);
-		(void) txn->commit(txn, 0);
-
-		(void) dbp->close(dbp, 0);
-		results->rptDB = NULL;
-
-		if ((st != 0) && (st != DB_NOTFOUND)) {
-			/* something bad happened */
-			goto done;
+		if (!agg_ranks_lower(&heap[0], &tbl->slots[s])) {
+			continue;
 		}
-
-		/* got the top 10, allocate the final structure */
-		results->rptSize = 10 * (sizeof (agg_size_t));
-		aggreport = calloc(1, results->rptSize);
-		results->result = (void *)aggreport;
-
-		if (aggreport == NULL) {
-			st = ENOMEM;
-			goto done;
+		/* replace the smallest of the top 10 and sift down */
+		heap[0] = tbl->slots[s];
+		i = 0;
+		while ((c = 2 * i + 1) < n) {
+			if ((c + 1 < n) &&
+			    agg_ranks_lower(&heap[c + 1], &heap[c])) {
+				c++;
+			}
+			if (!agg_ranks_lower(&heap[c], &heap[i])) {
+				break;
+			}
+			tmp = heap[i];
+			heap[i] = heap[c];
+			heap[c] = tmp;
+			i = c;
 		}
+	}
 
-		ptr = agglist;
+	free(tbl->slots);
+	memset(tbl, 0, sizeof (aggTable_t));
 
-		for (i = 0; ptr != NULL; i++) {
-			aggp = ptr->agg;
-			memcpy(&aggreport[i], aggp, sizeof (agg_size_t));
-			ptr = ptr->next;
-		}
+	/* got the top 10, allocate the final structure */
+	total->rptSize = FM_TOPK * (sizeof (agg_size_t));
+	aggreport = calloc(1, total->rptSize);
+	total->result = (void *)aggreport;
 
-		st = 0;
-done:
-		while (agglist != NULL) {
-			ptr = agglist;
-			agglist = ptr->next;
+	if (aggreport == NULL) {
+		return (ENOMEM);
+	}
 
-			free(ptr->agg);
-			free(ptr);
+	/* pop the heap into the report, largest first */
+	while (n > 0) {
+		aggreport[--n] = heap[0];
+		heap[0] = heap[n];
+		i = 0;
+		while ((c = 2 * i + 1) < n) {
+			if ((c + 1 < n) &&
+			    agg_ranks_lower(&heap[c + 1], &heap[c])) {
+				c++;
+			}
+			if (!agg_ranks_lower(&heap[c], &heap[i])) {
+				break;
+			}
+			tmp = heap[i];
+			heap[i] = heap[c];
+			heap[c] = tmp;
+			i = c;
 		}
-
 	}
 
-	return (st);
+	return (0);
 }
 
 /*
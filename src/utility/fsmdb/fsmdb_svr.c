@@ -83,6 +83,7 @@ static void fsm_free_file_details(filedetails_t *details);
 /* thread to clean up any aborted deletes */
 static void *finish_partial_deletes(void *arg);
 static void *do_checkpoint(void *arg);
+static void expire_browse_cursors(time_t now);
 extern int samcftime(char *s, const char *format, const time_t *clock);
 
 /*  Globals */
@@ -101,6 +102,12 @@ int			active = 0;
 fs_entry_t		*fs_entry_list = NULL;
 pthread_rwlock_t	fslistlock = PTHREAD_RWLOCK_INITIALIZER;
 
+/* browse cursors, most recently used first */
+static browse_cursor_t	*browse_list = NULL;
+static int		browse_count = 0;
+static uint32_t		browse_gen = 0;	/* advanced by each purge */
+static pthread_mutex_t	browselock = PTHREAD_MUTEX_INITIALIZER;
+
 /* error log file */
 static char		*fsmdb_errLog = "/var/opt/SUNWsamfs/fsmdb.log";
 FILE			*fsmdb_errFilep = stderr;
@@ -888,6 +895,8 @@ destroy_fsent(fs_entry_t *fsent, boolean_t delete_databases)
 	}
 	(void) pthread_mutex_unlock(&fsent->statlock);
 
+	purge_browse_cursors(fsent->fsname, NULL);
+
 	if (fsent->fsdb) {
 		close_fsdb(fsent->fsname, fsent->fsdb, delete_databases);
 		free(fsent->fsdb);
@@ -1147,6 +1156,160 @@ done_with_db_task(fs_entry_t *fsent)
 	(void) pthread_mutex_unlock(&fsent->statlock);
 }
 
+/*
+ *  Removes and returns the cursor left by a listing of startDir in
+ *  snapname that ended with lastFile.  Filtering options must match,
+ *  they determine which entries the listing has already passed over.
+ */
+browse_cursor_t *
+get_browse_cursor(
+	char		*fsname,
+	char		*snapname,
+	char		*startDir,
+	char		*lastFile,
+	restrict_t	*restrictions)
+{
+	browse_cursor_t	*bc;
+	browse_cursor_t	*prev = NULL;
+
+	if ((fsname == NULL) || (snapname == NULL) || (lastFile == NULL)) {
+		return (NULL);
+	}
+	if (startDir == NULL) {
+		startDir = "";
+	}
+
+	(void) pthread_mutex_lock(&browselock);
+	expire_browse_cursors(time(NULL));
+
+	for (bc = browse_list; bc != NULL; bc = bc->next) {
+		if ((strcmp(bc->lastFile, lastFile) == 0) &&
+		    (strcmp(bc->startDir, startDir) == 0) &&
+		    (strcmp(bc->snapname, snapname) == 0) &&
+		    (strcmp(bc->fsname, fsname) == 0) &&
+		    (memcmp(&bc->restrictions, restrictions,
+		    sizeof (restrict_t)) == 0)) {
+			break;
+		}
+		prev = bc;
+	}
+	if (bc != NULL) {
+		if (prev == NULL) {
+			browse_list = bc->next;
+		} else {
+			prev->next = bc->next;
+		}
+		bc->next = NULL;
+		browse_count--;
+	}
+	(void) pthread_mutex_unlock(&browselock);
+
+	return (bc);
+}
+
+/*
+ *  Keeps a cursor for the next page of a listing.  If the list is
+ *  full, the least recently used cursor is discarded.  The cursor is
+ *  discarded instead if a purge ran after the listing read bc->gen,
+ *  its snapshot may no longer be ready.
+ */
+void
+put_browse_cursor(browse_cursor_t *bc)
+{
+	browse_cursor_t	*last;
+	time_t		now = time(NULL);
+
+	if (bc == NULL) {
+		return;
+	}
+
+	(void) pthread_mutex_lock(&browselock);
+	if (bc->gen != browse_gen) {
+		(void) pthread_mutex_unlock(&browselock);
+		free(bc);
+		return;
+	}
+	expire_browse_cursors(now);
+
+	if (browse_count >= BROWSE_MAX) {
+		for (last = browse_list; last->next->next != NULL;
+		    last = last->next) {
+			;
+		}
+		free(last->next);
+		last->next = NULL;
+		browse_count--;
+	}
+
+	bc->expires = now + BROWSE_TTL;
+	bc->next = browse_list;
+	browse_list = bc;
+	browse_count++;
+	(void) pthread_mutex_unlock(&browselock);
+}
+
+/*
+ *  Returns the browse generation.  A listing reads it before it checks
+ *  that the snapshot is ready.
+ */
+uint32_t
+browse_generation(void)
+{
+	uint32_t	gen;
+
+	(void) pthread_mutex_lock(&browselock);
+	gen = browse_gen;
+	(void) pthread_mutex_unlock(&browselock);
+	return (gen);
+}
+
+/*
+ *  Discards the cursors for a snapshot of a filesystem, or for all of
+ *  its snapshots if snapid is NULL.  Called when the snapshot is no
+ *  longer ready, the generation is advanced so that listings already
+ *  past their snapshot check don't keep a cursor.
+ */
+void
+purge_browse_cursors(char *fsname, uint32_t *snapid)
+{
+	browse_cursor_t	*bc;
+	browse_cursor_t	**bcp;
+
+	(void) pthread_mutex_lock(&browselock);
+	browse_gen++;
+	bcp = &browse_list;
+	while ((bc = *bcp) != NULL) {
+		if (((fsname == NULL) || (strcmp(bc->fsname, fsname) == 0)) &&
+		    ((snapid == NULL) || (bc->snapid == *snapid))) {
+			*bcp = bc->next;
+			free(bc);
+			browse_count--;
+		} else {
+			bcp = &bc->next;
+		}
+	}
+	(void) pthread_mutex_unlock(&browselock);
+}
+
+/* Discards expired cursors.  Called with browselock held. */
+static void
+expire_browse_cursors(time_t now)
+{
+	browse_cursor_t	*bc;
+	browse_cursor_t	**bcp;
+
+	bcp = &browse_list;
+	while ((bc = *bcp) != NULL) {
+		if (bc->expires <= now) {
+			*bcp = bc->next;
+			free(bc);
+			browse_count--;
+		} else {
+			bcp = &bc->next;
+		}
+	}
+}
+
 /* Copied from file_details.h - remove if/when can link with libfsmgmt.so */
 static void
 fsm_free_file_details(filedetails_t *details)
@@ -1325,6 +1325,12 @@ db_delete_snapshot(void* arg)
 
 	(void) db_update_snapshot(fsent, snapinfo, snapsz);
 
+	/*
+	 * listings of this snapshot can't be continued.  Purged once it
+	 * is no longer ready, so no listing can keep a new cursor on it.
+	 */
+	purge_browse_cursors(fsent->fsname, &snapinfo->snapid);
+
 	for (;;) {
 		/*
 		 * If status is FSENT_DELETING break out.  If there are
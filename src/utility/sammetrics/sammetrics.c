@@ -0,0 +1,1373 @@
+/*
+ * sammetrics.c - export SAM-QFS metrics in a text exposition format.
+ *
+ * sammetrics samples the master and preview shared memory segments,
+ * the archiver and stager state files, the ArchReq files and the
+ * catalogs, and serves the last sample to scrapers.  It only reads.
+ * No daemon locks are taken, so a value may be read while it is being
+ * changed, the next sample corrects it.
+ *
+ * The segments and files are attached for each sample and detached
+ * after it.  A daemon restart is seen at the next sample.
+ *
+ * Counters and histograms are kept by sammetrics from the differences
+ * between samples.  Work that starts and ends between two samples is
+ * not seen by the stage counters.
+ *
+ * sammetrics [-i interval] [-p port [-A] | -s socket | -o]
+ */
+
+/*
+ *    SAM-QFS_notice_begin
+ *
+ * CDDL HEADER START
+ *
+ * The contents of this file are subject to the terms of the
+ * Common Development and Distribution License (the "License").
+ * You may not use this file except in compliance with the License.
+ *
+ * You can obtain a copy of the license at pkg/OPENSOLARIS.LICENSE
+ * or https://illumos.org/license/CDDL.
+ * See the License for the specific language governing permissions
+ * and limitations under the License.
+ *
+ * When distributing Covered Code, include this CDDL HEADER in each
+ * file and include the License file at pkg/OPENSOLARIS.LICENSE.
+ * If applicable, add the following below this CDDL HEADER, with the
+ * fields enclosed by brackets "[]" replaced with your own identifying
+ * information: Portions Copyright [yyyy] [name of copyright owner]
+ *
+ * CDDL HEADER END
+ */
+/*
+ * Copyright 2009 Sun Microsystems, Inc.  All rights reserved.
+ * Use is subject to license terms.
+ *
+ *    SAM-QFS_notice_end
+ */
+
+#pragma ident "$Revision: 1.1 $"
+
+static char *_SrcFile = __FILE__;   /* Using __FILE__ makes duplicate strings */
+
+/* ANSI C headers. */
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* POSIX headers. */
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/ipc.h>
+#include <sys/mman.h>
+#include <sys/shm.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+
+/* SAM-FS headers. */
+#define	DEC_INIT
+#include "sam/types.h"
+#include "sam/custmsg.h"
+#include "sam/exit.h"
+#include "sam/mount.h"
+#include "sam/lib.h"
+#include "aml/shm.h"
+#include "aml/archiver.h"
+#include "aml/archset.h"
+#include "aml/archreq.h"
+#include "aml/catalog.h"
+#include "aml/catlib.h"
+#include "aml/stager.h"
+#include "sam/sam_malloc.h"
+
+/* Macros. */
+#define	DEFAULT_INTERVAL 5		/* Seconds between samples */
+#define	DEFAULT_PORT	9581
+#define	IO_TIMEOUT	2000		/* Client read/write, milliseconds */
+#define	HIST_MAX	16		/* Histogram buckets, without +Inf */
+#define	LABEL_MAX	(2 * sizeof (upath_t))
+#define	PAGE_INCR	(64 * 1024)
+
+/* Types. */
+
+/*
+ * Histogram of observations in seconds.
+ */
+typedef struct Histogram {
+	char	*HiName;
+	char	*HiHelp;
+	int	HiNumof;			/* Buckets, without +Inf */
+	double	HiBounds[HIST_MAX];		/* Upper bounds */
+	uint64_t HiBuckets[HIST_MAX + 1];	/* Not cumulative */
+	uint64_t HiCount;
+	double	HiSum;
+} Histogram_t;
+
+/*
+ * Drive values for one sample.
+ */
+typedef struct DriveSample {
+	int	DsEq;
+	int	DsLibrary;			/* Library eq, 0 if manual */
+	char	*DsMedia;
+	vsn_t	DsVsn;				/* Loaded volume */
+	int	DsState;
+	boolean_t DsLoaded;
+	int	DsOpen;
+} DriveSample_t;
+
+/*
+ * An ArchReq seen in the last sample.
+ */
+typedef struct ArchReqSeen {
+	char	AsName[sizeof (uname_t) + sizeof (upath_t) + 1];
+	time_t	AsQueued;
+	boolean_t AsSeen;
+} ArchReqSeen_t;
+
+/* Public data. */
+shm_alloc_t master_shm, preview_shm;
+
+/* Private data. */
+static char *page = NULL;		/* Text of the last sample */
+static size_t pageLen = 0;
+static size_t pageAlloc = 0;
+
+static shm_ptr_tbl_t *shm = NULL;	/* Master segment, NULL if absent */
+static shm_preview_tbl_t *previewShm = NULL;
+static struct timeval lastSample;
+
+static double *driveBusy = NULL;	/* Busy seconds, indexed by eq */
+static int driveBusyNumof = 0;
+
+static struct PreviewSeen {
+	uint_t	PsSequence;
+	time_t	PsTime;
+	boolean_t PsInUse;
+} *previewSeen = NULL;
+static int previewSeenNumof = 0;
+
+static ArchReqSeen_t *archReqSeen = NULL;
+static int archReqSeenNumof = 0;
+
+static struct ArcopySeen {
+	upath_t	AcName;
+	fsize_t	AcBytes;
+	struct IoTune AcTune;		/* Archive buffer tuning */
+	boolean_t AcTuned;		/* AcTune valid */
+} *arcopySeen = NULL;
+static int arcopySeenNumof = 0;
+static uint64_t archiveBytes = 0;
+
+static struct StageSeen {
+	pid_t	SsPid;
+	sam_id_t SsId;
+	u_longlong_t SsLen;
+} stageSeen[STAGER_DISPLAY_ACTIVE];
+static uint64_t stageBytes = 0;
+static uint64_t stageFiles = 0;
+
+static Histogram_t mountWait = {
+	"sam_mount_wait_seconds",
+	"Time from mount request to removal from the preview queue",
+	10, { 1, 5, 15, 30, 60, 120, 300, 600, 1800, 3600 }
+};
+static Histogram_t archReqTime = {
+	"sam_archreq_seconds",
+	"Time from ArchReq queued to ArchReq file removed",
+	10, { 60, 300, 900, 1800, 3600, 7200, 14400, 28800, 43200,
+	    86400 }
+};
+
+/* Private functions. */
+static void attachSegments(void);
+static int cmp_archReqSeen(const void *p1, const void *p2);
+static void detachSegments(void);
+static void emit(const char *fmt, ...);
+static void emitHeader(char *name, char *type, char *help);
+static void emitHistogram(Histogram_t *hi);
+static void emitStalls(char *name, char *help, boolean_t producer);
+static char *escape(const char *s, char *buf);
+static boolean_t isRunning(pid_t pid);
+static int listenTcp(int port, boolean_t anyAddr);
+static int listenUnix(char *path);
+static void observe(Histogram_t *hi, double value);
+static void sample(void);
+static boolean_t sampleArchiver(time_t now);
+static void sampleArchReqs(time_t now);
+static void sampleCatalogs(void);
+static void sampleDrives(double elapsed);
+static void sampleFileSystems(void);
+static void samplePreview(time_t now);
+static boolean_t sampleStager(void);
+static void serve(int fd, boolean_t http);
+static int writeAll(int fd, char *buf, size_t len);
+
+
+int
+main(
+	int argc,	/* Number of arguments */
+	char *argv[])	/* Argument pointer list */
+{
+	extern int optind;
+	boolean_t anyAddr = FALSE;
+	boolean_t once = FALSE;
+	char	*sockPath = NULL;
+	int	c;
+	int	errflag = 0;
+	int	interval = DEFAULT_INTERVAL;
+	int	lfd;
+	int	port = DEFAULT_PORT;
+
+	program_name = "sammetrics";
+	while ((c = getopt(argc, argv, "Ai:op:s:")) != EOF) {
+		switch (c) {
+		case 'A':
+			anyAddr = TRUE;
+			break;
+		case 'i':
+			interval = atoi(optarg);
+			if (interval <= 0) {
+				errflag++;
+			}
+			break;
+		case 'o':
+			once = TRUE;
+			break;
+		case 'p':
+			port = atoi(optarg);
+			if (port <= 0 || port > 65535) {
+				errflag++;
+			}
+			break;
+		case 's':
+			sockPath = optarg;
+			break;
+		case '?':
+		default:
+			errflag++;
+			break;
+		}
+	}
+	if (optind != argc) {
+		errflag++;
+	}
+	if (errflag > 0) {
+		fprintf(stderr, GetCustMsg(13001), program_name,
+		    "[-i interval] [-p port [-A] | -s socket | -o]");
+		exit(EXIT_USAGE);
+	}
+
+	gettimeofday(&lastSample, NULL);
+	if (once) {
+		sample();
+		(void) writeAll(STDOUT_FILENO, page, pageLen);
+		return (EXIT_SUCCESS);
+	}
+
+	(void) signal(SIGPIPE, SIG_IGN);
+	if (sockPath != NULL) {
+		lfd = listenUnix(sockPath);
+	} else {
+		lfd = listenTcp(port, anyAddr);
+	}
+	if (lfd < 0) {
+		exit(EXIT_FATAL);
+	}
+
+	sample();
+	for (;;) {
+		struct pollfd pfd;
+		struct timeval tv;
+		long	ms;
+
+		gettimeofday(&tv, NULL);
+		ms = (lastSample.tv_sec + interval - tv.tv_sec) * 1000 +
+		    (lastSample.tv_usec - tv.tv_usec) / 1000;
+		if (ms <= 0) {
+			sample();
+			continue;
+		}
+		pfd.fd = lfd;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		if (poll(&pfd, 1, (int)ms) > 0 && (pfd.revents & POLLIN)) {
+			int	fd;
+
+			if ((fd = accept(lfd, NULL, NULL)) >= 0) {
+				serve(fd, sockPath == NULL);
+				(void) close(fd);
+			}
+		}
+	}
+	/* NOTREACHED */
+}
+
+
+/* Private functions. */
+
+
+/*
+ * Attach the shared memory segments.
+ */
+static void
+attachSegments(void)
+{
+	int	shmid;
+
+	shm = NULL;
+	previewShm = NULL;
+	master_shm.shared_memory = sam_mastershm_attach(0, SHM_RDONLY);
+	if (master_shm.shared_memory == (void *)-1) {
+		master_shm.shared_memory = NULL;
+		return;
+	}
+	shm = (shm_ptr_tbl_t *)master_shm.shared_memory;
+	if (!shm->valid || shm->dev_table == 0) {
+		detachSegments();
+		return;
+	}
+	if ((shmid = shmget(SHM_PREVIEW_KEY, 0, 0)) >= 0) {
+		preview_shm.shared_memory = shmat(shmid, NULL, SHM_RDONLY);
+		if (preview_shm.shared_memory != (void *)-1) {
+			previewShm =
+			    (shm_preview_tbl_t *)preview_shm.shared_memory;
+		} else {
+			preview_shm.shared_memory = NULL;
+		}
+	}
+}
+
+
+/*
+ * Compare ArchReqs seen by name.
+ */
+static int
+cmp_archReqSeen(
+	const void *p1,
+	const void *p2)
+{
+	ArchReqSeen_t *a1 = (ArchReqSeen_t *)p1;
+	ArchReqSeen_t *a2 = (ArchReqSeen_t *)p2;
+
+	return (strcmp(a1->AsName, a2->AsName));
+}
+
+
+/*
+ * Detach the shared memory segments.
+ */
+static void
+detachSegments(void)
+{
+	if (preview_shm.shared_memory != NULL) {
+		(void) shmdt(preview_shm.shared_memory);
+		preview_shm.shared_memory = NULL;
+	}
+	if (master_shm.shared_memory != NULL) {
+		(void) shmdt(master_shm.shared_memory);
+		master_shm.shared_memory = NULL;
+	}
+	shm = NULL;
+	previewShm = NULL;
+}
+
+
+/*
+ * Append to the page.
+ */
+static void
+emit(
+	const char *fmt,
+	...)
+{
+	va_list	args;
+	int	n;
+
+	for (;;) {
+		va_start(args, fmt);
+		n = vsnprintf(page + pageLen, pageAlloc - pageLen, fmt, args);
+		va_end(args);
+		if (n >= 0 && pageLen + n < pageAlloc) {
+			pageLen += n;
+			return;
+		}
+		pageAlloc += PAGE_INCR;
+		SamRealloc(page, pageAlloc);
+	}
+}
+
+
+/*
+ * Start a metric family.
+ */
+static void
+emitHeader(
+	char *name,
+	char *type,
+	char *help)
+{
+	emit("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+
+/*
+ * Append a histogram.
+ */
+static void
+emitHistogram(
+	Histogram_t *hi)
+{
+	uint64_t count;
+	int	i;
+
+	emitHeader(hi->HiName, "histogram", hi->HiHelp);
+	count = 0;
+	for (i = 0; i < hi->HiNumof; i++) {
+		count += hi->HiBuckets[i];
+		emit("%s_bucket{le=\"%g\"} %llu\n", hi->HiName,
+		    hi->HiBounds[i], (u_longlong_t)count);
+	}
+	emit("%s_bucket{le=\"+Inf\"} %llu\n", hi->HiName,
+	    (u_longlong_t)hi->HiCount);
+	emit("%s_sum %.3f\n", hi->HiName, hi->HiSum);
+	emit("%s_count %llu\n", hi->HiName, (u_longlong_t)hi->HiCount);
+}
+
+
+/*
+ * Append the archive buffer stalls of the arcopy processes.
+ * The stall histograms are kept by arcopy.
+ */
+static void
+emitStalls(
+	char	*name,
+	char	*help,
+	boolean_t producer)	/* Stalls waiting for room, else for data */
+{
+	char	lbl[LABEL_MAX];
+	int	i;
+
+	emitHeader(name, "histogram", help);
+	for (i = 0; i < arcopySeenNumof; i++) {
+		struct IoTuneStalls *is;
+		uint64_t count;
+		int	b;
+
+		if (!arcopySeen[i].AcTuned) {
+			continue;
+		}
+		is = (producer) ? &arcopySeen[i].AcTune.ItProducer :
+		    &arcopySeen[i].AcTune.ItConsumer;
+		(void) escape(arcopySeen[i].AcName, lbl);
+		count = 0;
+		for (b = 0; b < IOTUNE_BUCKETS; b++) {
+			count += is->IsBuckets[b];
+			emit("%s_bucket{arcopy=\"%s\",le=\"%g\"} %llu\n",
+			    name, lbl, IoTuneBound(b), (u_longlong_t)count);
+		}
+		emit("%s_bucket{arcopy=\"%s\",le=\"+Inf\"} %llu\n", name, lbl,
+		    (u_longlong_t)is->IsCount);
+		emit("%s_sum{arcopy=\"%s\"} %.6f\n", name, lbl,
+		    (double)is->IsTime / 1e9);
+		emit("%s_count{arcopy=\"%s\"} %llu\n", name, lbl,
+		    (u_longlong_t)is->IsCount);
+	}
+}
+
+
+/*
+ * Escape a label value.
+ * Returns buf.
+ */
+static char *
+escape(
+	const char *s,
+	char *buf)		/* LABEL_MAX bytes */
+{
+	char	*p;
+
+	for (p = buf; *s != '\0' && p < buf + LABEL_MAX - 3; s++) {
+		if (*s == '\\' || *s == '"') {
+			*p++ = '\\';
+			*p++ = *s;
+		} else if (*s == '\n') {
+			*p++ = '\\';
+			*p++ = 'n';
+		} else {
+			*p++ = *s;
+		}
+	}
+	*p = '\0';
+	return (buf);
+}
+
+
+/*
+ * Determine if a process is running.
+ */
+static boolean_t
+isRunning(
+	pid_t pid)
+{
+	if (pid <= 0) {
+		return (FALSE);
+	}
+	return ((kill(pid, 0) == 0 || errno == EPERM) ? TRUE : FALSE);
+}
+
+
+/*
+ * Listen on a TCP port.
+ * The loopback address is used unless anyAddr is set.
+ */
+static int
+listenTcp(
+	int port,
+	boolean_t anyAddr)
+{
+	struct sockaddr_in sin;
+	int	fd;
+	int	on = 1;
+
+	if ((fd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+		perror("socket");
+		return (-1);
+	}
+	(void) setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof (on));
+	memset(&sin, 0, sizeof (sin));
+	sin.sin_family = AF_INET;
+	sin.sin_port = htons(port);
+	sin.sin_addr.s_addr = htonl(anyAddr ? INADDR_ANY : INADDR_LOOPBACK);
+	if (bind(fd, (struct sockaddr *)&sin, sizeof (sin)) < 0 ||
+	    listen(fd, 8) < 0) {
+		perror("bind");
+		(void) close(fd);
+		return (-1);
+	}
+	return (fd);
+}
+
+
+/*
+ * Listen on a UNIX domain socket.
+ */
+static int
+listenUnix(
+	char *path)
+{
+	struct sockaddr_un sun;
+	int	fd;
+
+	if (strlen(path) >= sizeof (sun.sun_path)) {
+		errno = ENAMETOOLONG;
+		perror(path);
+		return (-1);
+	}
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0) {
+		perror("socket");
+		return (-1);
+	}
+	memset(&sun, 0, sizeof (sun));
+	sun.sun_family = AF_UNIX;
+	strncpy(sun.sun_path, path, sizeof (sun.sun_path) - 1);
+	(void) unlink(path);
+	if (bind(fd, (struct sockaddr *)&sun, sizeof (sun)) < 0 ||
+	    listen(fd, 8) < 0) {
+		perror(path);
+		(void) close(fd);
+		return (-1);
+	}
+	return (fd);
+}
+
+
+/*
+ * Add an observation to a histogram.
+ */
+static void
+observe(
+	Histogram_t *hi,
+	double value)
+{
+	int	i;
+
+	if (value < 0) {
+		value = 0;
+	}
+	for (i = 0; i < hi->HiNumof; i++) {
+		if (value <= hi->HiBounds[i]) {
+			break;
+		}
+	}
+	hi->HiBuckets[i]++;
+	hi->HiCount++;
+	hi->HiSum += value;
+}
+
+
+/*
+ * Take a sample.
+ */
+static void
+sample(void)
+{
+	struct timeval start;
+	struct timeval end;
+	boolean_t archiverUp;
+	boolean_t stagerUp;
+	double	elapsed;
+
+	gettimeofday(&start, NULL);
+	elapsed = (start.tv_sec - lastSample.tv_sec) +
+	    (start.tv_usec - lastSample.tv_usec) / 1e6;
+	lastSample = start;
+	pageLen = 0;
+	if (page == NULL) {
+		pageAlloc = PAGE_INCR;
+		SamMalloc(page, pageAlloc);
+	}
+	*page = '\0';
+
+	attachSegments();
+	archiverUp = sampleArchiver(start.tv_sec);
+	stagerUp = sampleStager();
+	emitHeader("sam_up", "gauge", "Daemon is running");
+	emit("sam_up{daemon=\"sam-amld\"} %d\n",
+	    (shm != NULL && isRunning(shm->sam_amld)) ? 1 : 0);
+	emit("sam_up{daemon=\"sam-archiverd\"} %d\n", archiverUp ? 1 : 0);
+	emit("sam_up{daemon=\"sam-stagerd\"} %d\n", stagerUp ? 1 : 0);
+	sampleDrives(elapsed);
+	samplePreview(start.tv_sec);
+	sampleArchReqs(start.tv_sec);
+	sampleFileSystems();
+	sampleCatalogs();
+	detachSegments();
+
+	emitHistogram(&mountWait);
+	emitHistogram(&archReqTime);
+
+	gettimeofday(&end, NULL);
+	emitHeader("sam_metrics_sample_seconds", "gauge",
+	    "Time taken by the last sample");
+	emit("sam_metrics_sample_seconds %.6f\n",
+	    (end.tv_sec - start.tv_sec) +
+	    (end.tv_usec - start.tv_usec) / 1e6);
+}
+
+
+/*
+ * Sample the archiver state file and the active arcopy-s.
+ * Returns TRUE if the archiver is running.
+ */
+static boolean_t
+sampleArchiver(
+	time_t now)
+{
+	struct ArchiverdState *ad;
+	boolean_t up;
+	char	lbl[LABEL_MAX];
+	int	active;
+	int	i;
+
+	ad = MapFileAttach(ARCHIVER_DIR"/"ARCHIVER_STATE, AD_MAGIC, O_RDONLY);
+	if (ad != NULL && ad->AdVersion != AD_VERSION) {
+		(void) MapFileDetach(ad);
+		ad = NULL;
+	}
+	if (ad == NULL) {
+		return (FALSE);
+	}
+	up = (isRunning(ad->AdPid) &&
+	    ad->AdLastAlarm + 2 * ALARM_TIME >= now) ? TRUE : FALSE;
+
+	if (ad->AdCount != arcopySeenNumof && ad->AdCount > 0) {
+		SamRealloc(arcopySeen,
+		    ad->AdCount * sizeof (struct ArcopySeen));
+		memset(arcopySeen, 0, ad->AdCount * sizeof (struct ArcopySeen));
+		arcopySeenNumof = ad->AdCount;
+	}
+
+	/*
+	 * Bytes written by each arcopy since the last sample.
+	 * AdArchReq entries are "fsname.arname.cpi".
+	 */
+	active = 0;
+	for (i = 0; i < ad->AdCount; i++) {
+		struct ArcopySeen *ac;
+		struct ArchReq *ar;
+		upath_t	name;
+		uname_t	fsname;
+		fsize_t	bytes;
+		char	*arname;
+		char	*p;
+		int	cpi;
+
+		ac = &arcopySeen[i];
+		ac->AcTuned = FALSE;
+		strncpy(name, ad->AdArchReq[i], sizeof (name));
+		name[sizeof (name) - 1] = '\0';
+		if (*name == '\0' || (p = strchr(name, '.')) == NULL) {
+			*ac->AcName = '\0';
+			continue;
+		}
+		active++;
+		if (strcmp(name, ac->AcName) != 0) {
+			strncpy(ac->AcName, name, sizeof (ac->AcName));
+			ac->AcBytes = 0;
+		}
+		*p++ = '\0';
+		strncpy(fsname, name, sizeof (fsname));
+		fsname[sizeof (fsname) - 1] = '\0';
+		arname = p;
+		if ((p = strrchr(arname, '.')) == NULL) {
+			continue;
+		}
+		*p++ = '\0';
+		cpi = atoi(p);
+		if ((ar = ArchReqAttach(fsname, arname, O_RDONLY)) == NULL) {
+			continue;
+		}
+		if (cpi >= 0 && cpi < ar->ArDrives) {
+			bytes = ar->ArCpi[cpi].CiBytesWritten;
+			if (bytes > ac->AcBytes) {
+				archiveBytes += bytes - ac->AcBytes;
+			}
+			ac->AcBytes = bytes;
+			ac->AcTune = ar->ArCpi[cpi].CiTune;
+			ac->AcTuned = TRUE;
+		}
+		(void) ArchReqDetach(ar);
+	}
+	(void) MapFileDetach(ad);
+
+	emitHeader("sam_arcopy_active", "gauge", "Active arcopy processes");
+	emit("sam_arcopy_active %d\n", active);
+	emitHeader("sam_archive_bytes_total", "counter",
+	    "Bytes written by arcopy processes");
+	emit("sam_archive_bytes_total %llu\n", (u_longlong_t)archiveBytes);
+
+	emitHeader("sam_arcopy_buffer_blocks", "gauge",
+	    "Archive buffer depth, in write blocks");
+	for (i = 0; i < arcopySeenNumof; i++) {
+		if (arcopySeen[i].AcTuned) {
+			emit("sam_arcopy_buffer_blocks{arcopy=\"%s\"} %d\n",
+			    escape(arcopySeen[i].AcName, lbl),
+			    arcopySeen[i].AcTune.ItDepth);
+		}
+	}
+	emitHeader("sam_arcopy_read_blocks", "gauge",
+	    "Archive file read size, in write blocks");
+	for (i = 0; i < arcopySeenNumof; i++) {
+		if (arcopySeen[i].AcTuned) {
+			emit("sam_arcopy_read_blocks{arcopy=\"%s\"} %d\n",
+			    escape(arcopySeen[i].AcName, lbl),
+			    arcopySeen[i].AcTune.ItRead);
+		}
+	}
+	emitStalls("sam_arcopy_producer_stall_seconds",
+	    "Time arcopy waited for room in the archive buffer", TRUE);
+	emitStalls("sam_arcopy_consumer_stall_seconds",
+	    "Time arcopy waited for data in the archive buffer", FALSE);
+	return (up);
+}
+
+
+/*
+ * Sample the ArchReq files of each file system.
+ * An ArchReq that is removed has been archived, or dropped.
+ */
+static void
+sampleArchReqs(
+	time_t now)
+{
+	static char *stateNames[] = {
+		"??", "create", "schedule", "archive", "done"
+	};
+	struct {
+		boolean_t valid;
+		int	states[ARS_done + 1];
+		int	selFiles;		/* Not yet archiving */
+		fsize_t	selSpace;
+	} *fq;
+	struct sam_fs_status *fsarray;
+	ArchReqSeen_t *seen;
+	int	numof;
+	int	alloc;
+	int	fsCount;
+	int	st;
+	int	i;
+
+	if ((fsCount = GetFsStatus(&fsarray)) <= 0) {
+		return;
+	}
+	SamMalloc(fq, fsCount * sizeof (*fq));
+	memset(fq, 0, fsCount * sizeof (*fq));
+	seen = NULL;
+	numof = 0;
+	alloc = 0;
+	for (i = 0; i < fsCount; i++) {
+		char	dirName[sizeof (ARCHIVER_DIR) + sizeof (uname_t) +
+		    sizeof (ARCHREQ_DIR) + 2];
+		struct dirent *dirent;
+		DIR	*dirp;
+
+		snprintf(dirName, sizeof (dirName),
+		    ARCHIVER_DIR"/%s/"ARCHREQ_DIR, fsarray[i].fs_name);
+		if ((dirp = opendir(dirName)) == NULL) {
+			continue;
+		}
+		fq[i].valid = TRUE;
+		while ((dirent = readdir(dirp)) != NULL) {
+			struct ArchReq *ar;
+			ArchReqSeen_t *as;
+			ArchReqSeen_t key;
+
+			if (*dirent->d_name == '.') {
+				continue;
+			}
+			ar = ArchReqAttach(fsarray[i].fs_name, dirent->d_name,
+			    O_RDONLY);
+			if (ar == NULL) {
+				continue;
+			}
+			st = ar->ArState;
+			if (st < 0 || st > ARS_done) {
+				st = 0;
+			}
+			fq[i].states[st]++;
+			if (st != ARS_archive) {
+				fq[i].selFiles += ar->ArSelFiles;
+				fq[i].selSpace += ar->ArSelSpace;
+			}
+
+			if (numof >= alloc) {
+				alloc += 64;
+				SamRealloc(seen,
+				    alloc * sizeof (ArchReqSeen_t));
+			}
+			as = &seen[numof++];
+			snprintf(as->AsName, sizeof (as->AsName), "%s/%s",
+			    fsarray[i].fs_name, dirent->d_name);
+			as->AsQueued = ar->ArTimeQueued;
+			as->AsSeen = FALSE;
+			(void) ArchReqDetach(ar);
+
+			/*
+			 * Mark it seen in the last sample.
+			 */
+			strncpy(key.AsName, as->AsName, sizeof (key.AsName));
+			if (archReqSeenNumof > 0 &&
+			    (as = bsearch(&key, archReqSeen, archReqSeenNumof,
+			    sizeof (ArchReqSeen_t), cmp_archReqSeen)) != NULL) {
+				as->AsSeen = TRUE;
+			}
+		}
+		(void) closedir(dirp);
+	}
+
+	emitHeader("sam_archreq_queued", "gauge", "ArchReqs by state");
+	for (i = 0; i < fsCount; i++) {
+		char	lbl[LABEL_MAX];
+
+		if (!fq[i].valid) {
+			continue;
+		}
+		(void) escape(fsarray[i].fs_name, lbl);
+		for (st = ARS_create; st <= ARS_done; st++) {
+			emit("sam_archreq_queued{fs=\"%s\",state=\"%s\"} %d\n",
+			    lbl, stateNames[st], fq[i].states[st]);
+		}
+	}
+	emitHeader("sam_archreq_files", "gauge",
+	    "Files selected by ArchReqs not yet archiving");
+	for (i = 0; i < fsCount; i++) {
+		char	lbl[LABEL_MAX];
+
+		if (fq[i].valid) {
+			emit("sam_archreq_files{fs=\"%s\"} %d\n",
+			    escape(fsarray[i].fs_name, lbl), fq[i].selFiles);
+		}
+	}
+	emitHeader("sam_archreq_bytes", "gauge",
+	    "Bytes selected by ArchReqs not yet archiving");
+	for (i = 0; i < fsCount; i++) {
+		char	lbl[LABEL_MAX];
+
+		if (fq[i].valid) {
+			emit("sam_archreq_bytes{fs=\"%s\"} %lld\n",
+			    escape(fsarray[i].fs_name, lbl),
+			    (long long)fq[i].selSpace);
+		}
+	}
+	SamFree(fq);
+	free(fsarray);
+
+	for (i = 0; i < archReqSeenNumof; i++) {
+		if (!archReqSeen[i].AsSeen && archReqSeen[i].AsQueued != 0) {
+			observe(&archReqTime,
+			    (double)(now - archReqSeen[i].AsQueued));
+		}
+	}
+	if (archReqSeen != NULL) {
+		SamFree(archReqSeen);
+	}
+	if (numof > 1) {
+		qsort(seen, numof, sizeof (ArchReqSeen_t), cmp_archReqSeen);
+	}
+	archReqSeen = seen;
+	archReqSeenNumof = numof;
+}
+
+
+/*
+ * Sample the library catalogs.
+ */
+static void
+sampleCatalogs(void)
+{
+	struct {
+		int	eq;
+		int	volumes;
+		int	full;
+		uint64_t capacity;
+		uint64_t space;
+	} *lib;
+	dev_ent_t *dev;
+	int	numof;
+	int	i;
+
+	if (shm == NULL) {
+		return;
+	}
+	if (CatalogInit(program_name) != 0) {
+		return;
+	}
+
+	numof = 0;
+	for (dev = (dev_ent_t *)SHM_REF_ADDR(shm->first_dev); dev != NULL;
+	    dev = (dev_ent_t *)SHM_REF_ADDR(dev->next)) {
+		if (is_robot(dev->type) || dev->type == DT_HISTORIAN) {
+			numof++;
+		}
+	}
+	if (numof == 0) {
+		return;
+	}
+	SamMalloc(lib, numof * sizeof (*lib));
+	memset(lib, 0, numof * sizeof (*lib));
+
+	numof = 0;
+	for (dev = (dev_ent_t *)SHM_REF_ADDR(shm->first_dev); dev != NULL;
+	    dev = (dev_ent_t *)SHM_REF_ADDR(dev->next)) {
+		struct CatalogEntry *ce;
+		int	n;
+
+		if (!is_robot(dev->type) && dev->type != DT_HISTORIAN) {
+			continue;
+		}
+		if ((n = CatalogGetEntries(dev->eq, 0, INT_MAX, &ce)) < 0) {
+			continue;
+		}
+		lib[numof].eq = dev->eq;
+		for (i = 0; i < n; i++, ce++) {
+			if (!(ce->CeStatus & CES_inuse) ||
+			    *ce->CeVsn == '\0') {
+				continue;
+			}
+			lib[numof].volumes++;
+			lib[numof].capacity += ce->CeCapacity;
+			lib[numof].space += ce->CeSpace;
+			if (ce->CeStatus & CES_archfull) {
+				lib[numof].full++;
+			}
+		}
+		numof++;
+	}
+
+	emitHeader("sam_library_volumes", "gauge", "Volumes in the catalog");
+	for (i = 0; i < numof; i++) {
+		emit("sam_library_volumes{library=\"%d\"} %d\n",
+		    lib[i].eq, lib[i].volumes);
+	}
+	emitHeader("sam_library_full_volumes", "gauge",
+	    "Volumes found full by the archiver");
+	for (i = 0; i < numof; i++) {
+		emit("sam_library_full_volumes{library=\"%d\"} %d\n",
+		    lib[i].eq, lib[i].full);
+	}
+	emitHeader("sam_library_capacity_bytes", "gauge",
+	    "Capacity of the volumes in the catalog");
+	for (i = 0; i < numof; i++) {
+		emit("sam_library_capacity_bytes{library=\"%d\"} %llu\n",
+		    lib[i].eq, (u_longlong_t)lib[i].capacity * 1024);
+	}
+	emitHeader("sam_library_free_bytes", "gauge",
+	    "Space remaining on the volumes in the catalog");
+	for (i = 0; i < numof; i++) {
+		emit("sam_library_free_bytes{library=\"%d\"} %llu\n",
+		    lib[i].eq, (u_longlong_t)lib[i].space * 1024);
+	}
+	SamFree(lib);
+}
+
+
+/*
+ * Sample the removable media drives.
+ * A drive is busy while it is open.
+ */
+static void
+sampleDrives(
+	double elapsed)
+{
+	DriveSample_t *ds;
+	dev_ent_t *dev;
+	int	maxEq;
+	int	numof;
+	int	i;
+
+	if (shm == NULL) {
+		return;
+	}
+	numof = 0;
+	maxEq = 0;
+	for (dev = (dev_ent_t *)SHM_REF_ADDR(shm->first_dev); dev != NULL;
+	    dev = (dev_ent_t *)SHM_REF_ADDR(dev->next)) {
+		if (is_tape(dev->type) || is_optical(dev->type)) {
+			numof++;
+			if (dev->eq > maxEq) {
+				maxEq = dev->eq;
+			}
+		}
+	}
+	if (maxEq >= driveBusyNumof) {
+		SamRealloc(driveBusy, (maxEq + 1) * sizeof (double));
+		for (i = driveBusyNumof; i <= maxEq; i++) {
+			driveBusy[i] = 0;
+		}
+		driveBusyNumof = maxEq + 1;
+	}
+	if (numof == 0) {
+		return;
+	}
+	SamMalloc(ds, numof * sizeof (DriveSample_t));
+
+	numof = 0;
+	for (dev = (dev_ent_t *)SHM_REF_ADDR(shm->first_dev); dev != NULL;
+	    dev = (dev_ent_t *)SHM_REF_ADDR(dev->next)) {
+		DriveSample_t *d;
+
+		if (!is_tape(dev->type) && !is_optical(dev->type)) {
+			continue;
+		}
+		d = &ds[numof++];
+		d->DsEq = dev->eq;
+		d->DsLibrary = dev->fseq;
+		d->DsMedia = sam_mediatoa(dev->type);
+		d->DsState = dev->state;
+		d->DsLoaded = (dev->status.b.ready && dev->status.b.present) ?
+		    TRUE : FALSE;
+		d->DsOpen = dev->open_count;
+		memmove(d->DsVsn, dev->vsn, sizeof (d->DsVsn));
+		d->DsVsn[sizeof (d->DsVsn) - 1] = '\0';
+		if (!d->DsLoaded) {
+			*d->DsVsn = '\0';
+		}
+		if (d->DsOpen != 0 && d->DsEq < driveBusyNumof) {
+			driveBusy[d->DsEq] += elapsed;
+		}
+	}
+
+#define	DRIVE_LABELS "eq=\"%d\",library=\"%d\",media=\"%s\""
+	emitHeader("sam_drive_state", "gauge",
+	    "Drive state, 0 on, 1 noalloc, 2 ro, 3 idle, 4 unavail, 5 off, "
+	    "6 down");
+	for (i = 0; i < numof; i++) {
+		emit("sam_drive_state{"DRIVE_LABELS"} %d\n", ds[i].DsEq,
+		    ds[i].DsLibrary, ds[i].DsMedia, ds[i].DsState);
+	}
+	emitHeader("sam_drive_loaded", "gauge", "Drive has a volume loaded");
+	for (i = 0; i < numof; i++) {
+		char	lbl[LABEL_MAX];
+
+		emit("sam_drive_loaded{"DRIVE_LABELS",vsn=\"%s\"} %d\n",
+		    ds[i].DsEq, ds[i].DsLibrary, ds[i].DsMedia,
+		    escape(ds[i].DsVsn, lbl), ds[i].DsLoaded ? 1 : 0);
+	}
+	emitHeader("sam_drive_open", "gauge", "Opens of the drive");
+	for (i = 0; i < numof; i++) {
+		emit("sam_drive_open{"DRIVE_LABELS"} %d\n", ds[i].DsEq,
+		    ds[i].DsLibrary, ds[i].DsMedia, ds[i].DsOpen);
+	}
+	emitHeader("sam_drive_busy_seconds_total", "counter",
+	    "Time the drive was seen open");
+	for (i = 0; i < numof; i++) {
+		emit("sam_drive_busy_seconds_total{"DRIVE_LABELS"} %.3f\n",
+		    ds[i].DsEq, ds[i].DsLibrary, ds[i].DsMedia,
+		    driveBusy[ds[i].DsEq]);
+	}
+#undef DRIVE_LABELS
+	SamFree(ds);
+}
+
+
+/*
+ * Sample the file systems.
+ */
+static void
+sampleFileSystems(void)
+{
+	struct sam_fs_status *fsarray;
+	struct sam_fs_info *fi;
+	int	fsCount;
+	int	i;
+
+	if ((fsCount = GetFsStatus(&fsarray)) <= 0) {
+		return;
+	}
+	SamMalloc(fi, fsCount * sizeof (struct sam_fs_info));
+	for (i = 0; i < fsCount; i++) {
+		if (GetFsInfo(fsarray[i].fs_name, &fi[i]) < 0) {
+			memset(&fi[i], 0, sizeof (struct sam_fs_info));
+			strncpy(fi[i].fi_name, fsarray[i].fs_name,
+			    sizeof (fi[i].fi_name));
+		}
+	}
+	free(fsarray);
+
+	emitHeader("sam_fs_mounted", "gauge", "File system is mounted");
+	for (i = 0; i < fsCount; i++) {
+		char	lbl[LABEL_MAX];
+
+		emit("sam_fs_mounted{fs=\"%s\"} %d\n", escape(fi[i].fi_name,
+		    lbl), (fi[i].fi_status & FS_MOUNTED) ? 1 : 0);
+	}
+	emitHeader("sam_fs_capacity_bytes", "gauge",
+	    "File system capacity");
+	for (i = 0; i < fsCount; i++) {
+		char	lbl[LABEL_MAX];
+
+		emit("sam_fs_capacity_bytes{fs=\"%s\"} %lld\n",
+		    escape(fi[i].fi_name, lbl), (long long)fi[i].fi_capacity);
+	}
+	emitHeader("sam_fs_free_bytes", "gauge", "File system free space");
+	for (i = 0; i < fsCount; i++) {
+		char	lbl[LABEL_MAX];
+
+		emit("sam_fs_free_bytes{fs=\"%s\"} %lld\n",
+		    escape(fi[i].fi_name, lbl), (long long)fi[i].fi_space);
+	}
+	SamFree(fi);
+}
+
+
+/*
+ * Sample the preview queue.
+ * A request that leaves the queue has been mounted, or cancelled.
+ */
+static void
+samplePreview(
+	time_t now)
+{
+	preview_tbl_t *pt;
+	int	i;
+
+	if (previewShm == NULL) {
+		return;
+	}
+	pt = &previewShm->preview_table;
+	if (pt->avail != previewSeenNumof && pt->avail > 0) {
+		SamRealloc(previewSeen,
+		    pt->avail * sizeof (struct PreviewSeen));
+		memset(previewSeen, 0, pt->avail * sizeof (struct PreviewSeen));
+		previewSeenNumof = pt->avail;
+	}
+	for (i = 0; i < pt->avail; i++) {
+		struct PreviewSeen *ps;
+		preview_t *p;
+
+		p = &pt->p[i];
+		ps = &previewSeen[i];
+		if (ps->PsInUse &&
+		    (!p->in_use || p->sequence != ps->PsSequence)) {
+			observe(&mountWait, (double)(now - ps->PsTime));
+		}
+		ps->PsInUse = p->in_use ? TRUE : FALSE;
+		ps->PsSequence = p->sequence;
+		ps->PsTime = p->ptime;
+	}
+
+	emitHeader("sam_mount_requests", "gauge",
+	    "Removable media mount requests in the preview queue");
+	emit("sam_mount_requests %d\n", pt->ptbl_count);
+}
+
+
+/*
+ * Sample the stager state file.
+ * A file is counted as staged when its entry in the active list is
+ * replaced.
+ * Returns TRUE if the stager is running.
+ */
+static boolean_t
+sampleStager(void)
+{
+	StagerStateInfo_t *state;
+	boolean_t up;
+	char	path[sizeof (SAM_VARIABLE_PATH) + sizeof (STAGER_DIRNAME) +
+	    sizeof (STAGER_STATE_FILENAME) + 2];
+	struct stat st;
+	int	active;
+	int	fd;
+	int	i;
+
+	snprintf(path, sizeof (path), "%s/%s/%s", SAM_VARIABLE_PATH,
+	    STAGER_DIRNAME, STAGER_STATE_FILENAME);
+	state = NULL;
+	if ((fd = open(path, O_RDONLY)) >= 0) {
+		if (fstat(fd, &st) == 0 &&
+		    st.st_size >= sizeof (StagerStateInfo_t)) {
+			state = mmap(NULL, sizeof (StagerStateInfo_t),
+			    PROT_READ, MAP_SHARED, fd, 0);
+			if (state == MAP_FAILED) {
+				state = NULL;
+			}
+		}
+		(void) close(fd);
+	}
+	if (state == NULL) {
+		return (FALSE);
+	}
+	up = isRunning(state->pid);
+
+	active = 0;
+	for (i = 0; i < STAGER_DISPLAY_ACTIVE; i++) {
+		StagerStateDetail_t *detail;
+		struct StageSeen *ss;
+		boolean_t valid;
+
+		detail = &state->active[i].detail;
+		ss = &stageSeen[i];
+		valid = (state->active[i].flags != 0 &&
+		    detail->pid != 0 && detail->id.ino != 0) ? TRUE : FALSE;
+		if (state->active[i].flags != 0) {
+			active++;
+		}
+		if (ss->SsPid != 0 &&
+		    (!valid || detail->pid != ss->SsPid ||
+		    detail->id.ino != ss->SsId.ino ||
+		    detail->id.gen != ss->SsId.gen)) {
+			stageFiles++;
+			stageBytes += ss->SsLen;
+			ss->SsPid = 0;
+		}
+		if (valid) {
+			ss->SsPid = detail->pid;
+			ss->SsId = detail->id;
+			ss->SsLen = detail->len;
+		}
+	}
+
+	emitHeader("sam_stage_requests", "gauge",
+	    "Stage requests held by the stager");
+	emit("sam_stage_requests %ld\n", state->reqEntries);
+	emitHeader("sam_stage_active", "gauge",
+	    "Stage streams loading, positioning or copying");
+	emit("sam_stage_active %d\n", active);
+	emitHeader("sam_stage_files_total", "counter", "Files staged");
+	emit("sam_stage_files_total %llu\n", (u_longlong_t)stageFiles);
+	emitHeader("sam_stage_bytes_total", "counter", "Bytes staged");
+	emit("sam_stage_bytes_total %llu\n", (u_longlong_t)stageBytes);
+	(void) munmap((void *)state, sizeof (StagerStateInfo_t));
+	return (up);
+}
+
+
+/*
+ * Serve the last sample to a client.
+ * An HTTP client gets a response to its request, a UNIX domain socket
+ * client gets the text alone.
+ */
+static void
+serve(
+	int fd,
+	boolean_t http)
+{
+	char	hdr[256];
+	char	req[1024];
+	struct pollfd pfd;
+	ssize_t	n;
+
+	if (!http) {
+		(void) writeAll(fd, page, pageLen);
+		return;
+	}
+
+	/*
+	 * Read the request line.  The rest of the request is ignored.
+	 */
+	pfd.fd = fd;
+	pfd.events = POLLIN;
+	if (poll(&pfd, 1, IO_TIMEOUT) <= 0) {
+		return;
+	}
+	if ((n = read(fd, req, sizeof (req) - 1)) <= 0) {
+		return;
+	}
+	req[n] = '\0';
+	if (strncmp(req, "GET ", 4) != 0 && strncmp(req, "HEAD ", 5) != 0) {
+		snprintf(hdr, sizeof (hdr),
+		    "HTTP/1.0 405 Method Not Allowed\r\n"
+		    "Allow: GET, HEAD\r\nContent-Length: 0\r\n\r\n");
+		(void) writeAll(fd, hdr, strlen(hdr));
+		return;
+	}
+	snprintf(hdr, sizeof (hdr), "HTTP/1.0 200 OK\r\n"
+	    "Content-Type: text/plain; version=0.0.4\r\n"
+	    "Content-Length: %lu\r\n\r\n", (ulong_t)pageLen);
+	if (writeAll(fd, hdr, strlen(hdr)) == 0 && *req == 'G') {
+		(void) writeAll(fd, page, pageLen);
+	}
+}
+
+
+/*
+ * Write all of a buffer.
+ * Returns -1 if the client stops reading.
+ */
+static int
+writeAll(
+	int fd,
+	char *buf,
+	size_t len)
+{
+	while (len > 0) {
+		struct pollfd pfd;
+		ssize_t	n;
+
+		pfd.fd = fd;
+		pfd.events = POLLOUT;
+		if (poll(&pfd, 1, IO_TIMEOUT) <= 0) {
+			return (-1);
+		}
+		if ((n = write(fd, buf, len)) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return (-1);
+		}
+		buf += n;
+		len -= n;
+	}
+	return (0);
+}
@@ -64,6 +64,7 @@ newnode(sqm_lst_t ** top)
 		(*top)->head = NULL;
 		(*top)->tail = NULL;
 		(*top)->length = 0;
+		(*top)->arena = NULL;
 	}
 	return (malloc(sizeof (struct node)));
 }